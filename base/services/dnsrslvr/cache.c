@@ -0,0 +1,792 @@
+/*
+ * PROJECT:     ReactOS DNS Resolver
+ * LICENSE:     GPL - See COPYING in the top level directory
+ * FILE:        base/services/dnsrslvr/cache.c
+ * PURPOSE:     Resolver cache
+ *
+ * Answers are kept in a hash table keyed by name and type until their TTL
+ * runs out. Names that do not exist are remembered for a shorter time, and
+ * callers asking for a name that is already being resolved wait for that
+ * query instead of sending their own. Entries loaded from the hosts file are
+ * permanent and are only dropped when the whole cache is flushed.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include "precomp.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(dnsrslvr);
+
+/* GLOBALS ******************************************************************/
+
+#define CACHE_HASH_BUCKETS          256
+#define CACHE_MAX_ENTRIES           1000
+#define DEFAULT_MAX_CACHE_TTL       86400
+#define DEFAULT_MAX_NEGATIVE_TTL    300
+#define MAX_NAME_LENGTH             255
+
+typedef struct _RESOLVER_CACHE_ENTRY
+{
+    LIST_ENTRY HashLink;
+    LIST_ENTRY LruLink;
+    LONG RefCount;
+    BOOL Linked;
+    BOOL Permanent;
+    BOOL Pending;
+    HANDLE Event;
+    DNS_STATUS Status;
+    DWORD ExpireTick;
+    PDNS_RECORDW Records;
+    WORD Type;
+    USHORT NameLength;
+    WCHAR Name[ANYSIZE_ARRAY];
+} RESOLVER_CACHE_ENTRY, *PRESOLVER_CACHE_ENTRY;
+
+/* Created once; RPC calls still in flight when the service stops use it */
+static CRITICAL_SECTION CacheLock;
+static BOOL CacheLockInitialized = FALSE;
+static BOOL CacheActive = FALSE;
+static LIST_ENTRY CacheHashTable[CACHE_HASH_BUCKETS];
+/* Entries that expire, most recently used first */
+static LIST_ENTRY CacheLruList;
+static ULONG CacheEntryCount;
+
+static DWORD MaxCacheTtl = DEFAULT_MAX_CACHE_TTL;
+static DWORD MaxNegativeCacheTtl = DEFAULT_MAX_NEGATIVE_TTL;
+
+/* FUNCTIONS *****************************************************************/
+
+static
+DWORD
+DnsIntReadParameter(
+    HKEY hKey,
+    LPCWSTR ValueName,
+    DWORD Default)
+{
+    DWORD dwValue, dwSize = sizeof(dwValue), dwType;
+
+    if (RegQueryValueExW(hKey, ValueName, NULL, &dwType, (LPBYTE)&dwValue, &dwSize) != ERROR_SUCCESS ||
+        dwType != REG_DWORD)
+    {
+        return Default;
+    }
+
+    return dwValue;
+}
+
+static
+VOID
+DnsIntReadParameters(VOID)
+{
+    HKEY hKey;
+
+    if (RegOpenKeyExW(HKEY_LOCAL_MACHINE,
+                      L"SYSTEM\\CurrentControlSet\\Services\\Dnscache\\Parameters",
+                      0,
+                      KEY_READ,
+                      &hKey) != ERROR_SUCCESS)
+    {
+        return;
+    }
+
+    MaxCacheTtl = DnsIntReadParameter(hKey, L"MaxCacheTtl", DEFAULT_MAX_CACHE_TTL);
+    MaxNegativeCacheTtl = DnsIntReadParameter(hKey, L"MaxNegativeCacheTtl", DEFAULT_MAX_NEGATIVE_TTL);
+
+    RegCloseKey(hKey);
+
+    /* Keep expiry times well inside the range of the tick count */
+    MaxCacheTtl = min(MaxCacheTtl, 7 * 86400);
+    MaxNegativeCacheTtl = min(MaxNegativeCacheTtl, MaxCacheTtl);
+}
+
+static
+BOOL
+DnsIntIsExpired(
+    PRESOLVER_CACHE_ENTRY Entry,
+    DWORD Now)
+{
+    if (Entry->Permanent || Entry->Pending)
+        return FALSE;
+
+    return (LONG)(Now - Entry->ExpireTick) >= 0;
+}
+
+/* "host" and "host." are the same name */
+static
+USHORT
+DnsIntNameLength(
+    LPCWSTR Name)
+{
+    SIZE_T Length = wcslen(Name);
+
+    if (Length > 1 && Name[Length - 1] == L'.')
+        Length--;
+
+    return (USHORT)min(Length, MAX_NAME_LENGTH);
+}
+
+static
+ULONG
+DnsIntHash(
+    LPCWSTR Name,
+    USHORT NameLength,
+    WORD Type)
+{
+    ULONG Hash = 2166136261UL;
+    USHORT i;
+
+    for (i = 0; i < NameLength; i++)
+    {
+        Hash = (Hash ^ RtlDowncaseUnicodeChar(Name[i])) * 16777619UL;
+    }
+
+    return (Hash ^ Type) % CACHE_HASH_BUCKETS;
+}
+
+static
+LPWSTR
+DnsIntDuplicateString(
+    LPCWSTR String)
+{
+    LPWSTR Copy;
+    SIZE_T Size;
+
+    if (String == NULL)
+        return NULL;
+
+    Size = (wcslen(String) + 1) * sizeof(WCHAR);
+    Copy = HeapAlloc(GetProcessHeap(), 0, Size);
+    if (Copy != NULL)
+        CopyMemory(Copy, String, Size);
+
+    return Copy;
+}
+
+static
+VOID
+DnsIntFreeRecordList(
+    PDNS_RECORDW Records)
+{
+    PDNS_RECORDW Next;
+
+    while (Records != NULL)
+    {
+        Next = Records->pNext;
+
+        switch (Records->wType)
+        {
+            case DNS_TYPE_NS:
+            case DNS_TYPE_MD:
+            case DNS_TYPE_MF:
+            case DNS_TYPE_CNAME:
+            case DNS_TYPE_MB:
+            case DNS_TYPE_MG:
+            case DNS_TYPE_MR:
+            case DNS_TYPE_PTR:
+                if (Records->Data.PTR.pNameHost != NULL)
+                    HeapFree(GetProcessHeap(), 0, Records->Data.PTR.pNameHost);
+                break;
+        }
+
+        if (Records->pName != NULL)
+            HeapFree(GetProcessHeap(), 0, Records->pName);
+        HeapFree(GetProcessHeap(), 0, Records);
+
+        Records = Next;
+    }
+}
+
+/*
+ * Copies a record list one allocation per node and per string, which is what
+ * the RPC stubs free. Only the types both ends know how to marshal are kept.
+ * Unless Ttl is -1 it replaces the TTL of every record; MinTtl receives the
+ * smallest TTL of the source records.
+ */
+static
+DNS_STATUS
+DnsIntCopyRecordList(
+    PDNS_RECORDW Source,
+    DWORD Ttl,
+    PDNS_RECORDW *Copy,
+    PDWORD RecordCount,
+    PDWORD MinTtl)
+{
+    PDNS_RECORDW Record, *Tail = Copy;
+    DWORD Count = 0, Lowest = MAXDWORD;
+
+    *Copy = NULL;
+
+    for (; Source != NULL; Source = Source->pNext)
+    {
+        switch (Source->wType)
+        {
+            case DNS_TYPE_A:
+            case DNS_TYPE_AAAA:
+            case DNS_TYPE_NS:
+            case DNS_TYPE_MD:
+            case DNS_TYPE_MF:
+            case DNS_TYPE_CNAME:
+            case DNS_TYPE_MB:
+            case DNS_TYPE_MG:
+            case DNS_TYPE_MR:
+            case DNS_TYPE_PTR:
+                break;
+
+            default:
+                continue;
+        }
+
+        Record = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DNS_RECORDW));
+        if (Record == NULL)
+            goto NoMemory;
+
+        *Tail = Record;
+        Tail = &Record->pNext;
+
+        Record->wType = Source->wType;
+        Record->wDataLength = Source->wDataLength;
+        Record->Flags.S.Section = DnsSectionAnswer;
+        Record->Flags.S.CharSet = DnsCharSetUnicode;
+        Record->dwTtl = (Ttl == (DWORD)-1) ? Source->dwTtl : Ttl;
+
+        Record->pName = DnsIntDuplicateString(Source->pName);
+        if (Source->pName != NULL && Record->pName == NULL)
+            goto NoMemory;
+
+        if (Source->wType == DNS_TYPE_A)
+        {
+            Record->Data.A = Source->Data.A;
+        }
+        else if (Source->wType == DNS_TYPE_AAAA)
+        {
+            Record->Data.AAAA = Source->Data.AAAA;
+        }
+        else
+        {
+            Record->Data.PTR.pNameHost = DnsIntDuplicateString(Source->Data.PTR.pNameHost);
+            if (Source->Data.PTR.pNameHost != NULL && Record->Data.PTR.pNameHost == NULL)
+                goto NoMemory;
+        }
+
+        Lowest = min(Lowest, Source->dwTtl);
+        Count++;
+    }
+
+    if (RecordCount != NULL)
+        *RecordCount = Count;
+    if (MinTtl != NULL)
+        *MinTtl = Count ? Lowest : 0;
+
+    return ERROR_SUCCESS;
+
+NoMemory:
+    DnsIntFreeRecordList(*Copy);
+    *Copy = NULL;
+    return ERROR_OUTOFMEMORY;
+}
+
+static
+PRESOLVER_CACHE_ENTRY
+DnsIntCreateEntry(
+    LPCWSTR Name,
+    USHORT NameLength,
+    WORD Type)
+{
+    PRESOLVER_CACHE_ENTRY Entry;
+
+    Entry = HeapAlloc(GetProcessHeap(),
+                      HEAP_ZERO_MEMORY,
+                      FIELD_OFFSET(RESOLVER_CACHE_ENTRY, Name[NameLength + 1]));
+    if (Entry == NULL)
+        return NULL;
+
+    CopyMemory(Entry->Name, Name, NameLength * sizeof(WCHAR));
+    Entry->Name[NameLength] = UNICODE_NULL;
+    Entry->NameLength = NameLength;
+    Entry->Type = Type;
+    Entry->RefCount = 1;
+    InitializeListHead(&Entry->HashLink);
+    InitializeListHead(&Entry->LruLink);
+
+    return Entry;
+}
+
+/* Called with the cache lock held */
+static
+VOID
+DnsIntDereferenceEntry(
+    PRESOLVER_CACHE_ENTRY Entry)
+{
+    if (--Entry->RefCount != 0)
+        return;
+
+    if (Entry->Event != NULL)
+        CloseHandle(Entry->Event);
+    DnsIntFreeRecordList(Entry->Records);
+    HeapFree(GetProcessHeap(), 0, Entry);
+}
+
+/* Called with the cache lock held */
+static
+VOID
+DnsIntInsertEntry(
+    PRESOLVER_CACHE_ENTRY Entry)
+{
+    ULONG Bucket = DnsIntHash(Entry->Name, Entry->NameLength, Entry->Type);
+
+    Entry->RefCount++;
+    Entry->Linked = TRUE;
+    InsertHeadList(&CacheHashTable[Bucket], &Entry->HashLink);
+
+    if (!Entry->Permanent)
+    {
+        InsertHeadList(&CacheLruList, &Entry->LruLink);
+        CacheEntryCount++;
+    }
+}
+
+/* Called with the cache lock held */
+static
+VOID
+DnsIntUnlinkEntry(
+    PRESOLVER_CACHE_ENTRY Entry)
+{
+    if (!Entry->Linked)
+        return;
+
+    RemoveEntryList(&Entry->HashLink);
+    InitializeListHead(&Entry->HashLink);
+
+    if (!Entry->Permanent)
+    {
+        RemoveEntryList(&Entry->LruLink);
+        InitializeListHead(&Entry->LruLink);
+        CacheEntryCount--;
+    }
+
+    Entry->Linked = FALSE;
+    DnsIntDereferenceEntry(Entry);
+}
+
+/* Called with the cache lock held */
+static
+VOID
+DnsIntTrimCache(VOID)
+{
+    PLIST_ENTRY ListEntry, Previous;
+    PRESOLVER_CACHE_ENTRY Entry;
+
+    /* Drop the least recently used answers, never a query still in flight */
+    for (ListEntry = CacheLruList.Blink;
+         ListEntry != &CacheLruList && CacheEntryCount >= CACHE_MAX_ENTRIES;
+         ListEntry = Previous)
+    {
+        Previous = ListEntry->Blink;
+        Entry = CONTAINING_RECORD(ListEntry, RESOLVER_CACHE_ENTRY, LruLink);
+
+        if (!Entry->Pending)
+            DnsIntUnlinkEntry(Entry);
+    }
+}
+
+/* Called with the cache lock held */
+static
+PRESOLVER_CACHE_ENTRY
+DnsIntLookupEntry(
+    LPCWSTR Name,
+    USHORT NameLength,
+    WORD Type,
+    BOOL UseHosts)
+{
+    PLIST_ENTRY ListHead, ListEntry, Next;
+    PRESOLVER_CACHE_ENTRY Entry, Found = NULL;
+    DWORD Now = GetTickCount();
+
+    ListHead = &CacheHashTable[DnsIntHash(Name, NameLength, Type)];
+    for (ListEntry = ListHead->Flink; ListEntry != ListHead; ListEntry = Next)
+    {
+        Next = ListEntry->Flink;
+        Entry = CONTAINING_RECORD(ListEntry, RESOLVER_CACHE_ENTRY, HashLink);
+
+        if (Entry->Type != Type ||
+            Entry->NameLength != NameLength ||
+            _wcsnicmp(Entry->Name, Name, NameLength) != 0)
+        {
+            continue;
+        }
+
+        if (DnsIntIsExpired(Entry, Now))
+        {
+            DnsIntUnlinkEntry(Entry);
+            continue;
+        }
+
+        /* The hosts file wins over anything learnt from the wire */
+        if (Entry->Permanent)
+        {
+            if (UseHosts)
+                return Entry;
+            continue;
+        }
+
+        Found = Entry;
+    }
+
+    if (Found != NULL)
+    {
+        RemoveEntryList(&Found->LruLink);
+        InsertHeadList(&CacheLruList, &Found->LruLink);
+    }
+
+    return Found;
+}
+
+static
+VOID
+DnsIntResolveEntry(
+    PRESOLVER_CACHE_ENTRY Entry,
+    DWORD Flags)
+{
+    PDNS_RECORDW Result = NULL, Records = NULL;
+    DNS_STATUS Status;
+    DWORD MinTtl = 0, Ttl = 0;
+
+    Status = DnsQuery_W(Entry->Name,
+                        Entry->Type,
+                        Flags | DNS_QUERY_BYPASS_CACHE | DNS_QUERY_NO_HOSTS_FILE,
+                        NULL,
+                        (PDNS_RECORD *)&Result,
+                        NULL);
+    if (Status == ERROR_SUCCESS)
+    {
+        Status = DnsIntCopyRecordList(Result, (DWORD)-1, &Records, NULL, &MinTtl);
+        if (Status == ERROR_SUCCESS && Records == NULL)
+            Status = DNS_INFO_NO_RECORDS;
+        else if (Status == ERROR_SUCCESS)
+            Ttl = min(MinTtl, MaxCacheTtl);
+    }
+
+    if (Result != NULL)
+        DnsRecordListFree((PDNS_RECORD)Result, DnsFreeRecordList);
+
+    if (Status == DNS_ERROR_RCODE_NAME_ERROR || Status == DNS_INFO_NO_RECORDS)
+        Ttl = MaxNegativeCacheTtl;
+
+    TRACE("%S type %u resolved, status %lu, TTL %lu\n", Entry->Name, Entry->Type, Status, Ttl);
+
+    EnterCriticalSection(&CacheLock);
+
+    Entry->Status = Status;
+    Entry->Records = Records;
+    Entry->ExpireTick = GetTickCount() + Ttl * 1000;
+    Entry->Pending = FALSE;
+
+    /* Failures other than a missing name say nothing about the next try */
+    if (Ttl == 0)
+        DnsIntUnlinkEntry(Entry);
+
+    SetEvent(Entry->Event);
+
+    LeaveCriticalSection(&CacheLock);
+}
+
+DNS_STATUS
+DnsIntCacheQuery(
+    LPCWSTR Name,
+    WORD Type,
+    DWORD Flags,
+    PDNS_RECORDW *Records,
+    PDWORD RecordCount)
+{
+    PRESOLVER_CACHE_ENTRY Entry;
+    USHORT NameLength = DnsIntNameLength(Name);
+    DNS_STATUS Status;
+    BOOL Resolve = FALSE;
+    DWORD Ttl;
+
+    *Records = NULL;
+    *RecordCount = 0;
+
+    EnterCriticalSection(&CacheLock);
+
+    if (!CacheActive)
+    {
+        LeaveCriticalSection(&CacheLock);
+        return ERROR_SERVICE_NOT_ACTIVE;
+    }
+
+    Entry = DnsIntLookupEntry(Name, NameLength, Type, !(Flags & DNS_QUERY_NO_HOSTS_FILE));
+    if (Entry != NULL)
+    {
+        Entry->RefCount++;
+    }
+    else if (Flags & DNS_QUERY_NO_WIRE_QUERY)
+    {
+        LeaveCriticalSection(&CacheLock);
+        return ERROR_FILE_NOT_FOUND;
+    }
+    else
+    {
+        /* Publish the query so that others asking the same wait for it */
+        Entry = DnsIntCreateEntry(Name, NameLength, Type);
+        if (Entry != NULL)
+            Entry->Event = CreateEventW(NULL, TRUE, FALSE, NULL);
+        if (Entry == NULL || Entry->Event == NULL)
+        {
+            if (Entry != NULL)
+                DnsIntDereferenceEntry(Entry);
+            LeaveCriticalSection(&CacheLock);
+            return ERROR_OUTOFMEMORY;
+        }
+
+        Entry->Pending = TRUE;
+        DnsIntTrimCache();
+        DnsIntInsertEntry(Entry);
+        Resolve = TRUE;
+    }
+
+    LeaveCriticalSection(&CacheLock);
+
+    if (Resolve)
+        DnsIntResolveEntry(Entry, Flags);
+    else if (Entry->Pending)
+        WaitForSingleObject(Entry->Event, INFINITE);
+
+    EnterCriticalSection(&CacheLock);
+
+    Status = Entry->Status;
+    if (Status == ERROR_SUCCESS)
+    {
+        /* Hand out the time left rather than the TTL the server gave */
+        if (Entry->Permanent)
+            Ttl = (DWORD)-1;
+        else if ((LONG)(Entry->ExpireTick - GetTickCount()) > 0)
+            Ttl = (Entry->ExpireTick - GetTickCount()) / 1000;
+        else
+            Ttl = 0;
+
+        Status = DnsIntCopyRecordList(Entry->Records, Ttl, Records, RecordCount, NULL);
+    }
+
+    DnsIntDereferenceEntry(Entry);
+
+    LeaveCriticalSection(&CacheLock);
+
+    return Status;
+}
+
+VOID
+DnsIntCacheAddHostsEntry(
+    LPCWSTR Name,
+    IP4_ADDRESS Address)
+{
+    PRESOLVER_CACHE_ENTRY Entry;
+    PDNS_RECORDW Record, *Tail;
+    USHORT NameLength = DnsIntNameLength(Name);
+
+    Record = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DNS_RECORDW));
+    if (Record == NULL)
+        return;
+
+    Record->pName = DnsIntDuplicateString(Name);
+    if (Record->pName == NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Record);
+        return;
+    }
+
+    Record->wType = DNS_TYPE_A;
+    Record->wDataLength = sizeof(DNS_A_DATA);
+    Record->Flags.S.Section = DnsSectionAnswer;
+    Record->Flags.S.CharSet = DnsCharSetUnicode;
+    Record->Data.A.IpAddress = Address;
+
+    EnterCriticalSection(&CacheLock);
+
+    if (!CacheActive)
+    {
+        LeaveCriticalSection(&CacheLock);
+        DnsIntFreeRecordList(Record);
+        return;
+    }
+
+    /* A name listed more than once gets all of its addresses */
+    Entry = DnsIntLookupEntry(Name, NameLength, DNS_TYPE_A, TRUE);
+    if (Entry == NULL || !Entry->Permanent)
+    {
+        Entry = DnsIntCreateEntry(Name, NameLength, DNS_TYPE_A);
+        if (Entry == NULL)
+        {
+            LeaveCriticalSection(&CacheLock);
+            DnsIntFreeRecordList(Record);
+            return;
+        }
+
+        Entry->Permanent = TRUE;
+        DnsIntInsertEntry(Entry);
+        DnsIntDereferenceEntry(Entry);
+    }
+
+    for (Tail = &Entry->Records; *Tail != NULL; Tail = &(*Tail)->pNext);
+    *Tail = Record;
+
+    LeaveCriticalSection(&CacheLock);
+}
+
+BOOL
+DnsIntCacheFlushEntry(
+    LPCWSTR Name,
+    WORD Type)
+{
+    PLIST_ENTRY ListEntry, Next;
+    PRESOLVER_CACHE_ENTRY Entry;
+    USHORT NameLength = DnsIntNameLength(Name);
+    BOOL Found = FALSE;
+
+    EnterCriticalSection(&CacheLock);
+
+    for (ListEntry = CacheLruList.Flink; ListEntry != &CacheLruList; ListEntry = Next)
+    {
+        Next = ListEntry->Flink;
+        Entry = CONTAINING_RECORD(ListEntry, RESOLVER_CACHE_ENTRY, LruLink);
+
+        if ((Type == 0 || Type == DNS_TYPE_ANY || Entry->Type == Type) &&
+            Entry->NameLength == NameLength &&
+            _wcsnicmp(Entry->Name, Name, NameLength) == 0)
+        {
+            DnsIntUnlinkEntry(Entry);
+            Found = TRUE;
+        }
+    }
+
+    LeaveCriticalSection(&CacheLock);
+
+    return Found;
+}
+
+static
+VOID
+DnsIntCacheRemoveAll(VOID)
+{
+    PRESOLVER_CACHE_ENTRY Entry;
+    ULONG i;
+
+    EnterCriticalSection(&CacheLock);
+
+    /* Queries in flight still complete for their callers */
+    for (i = 0; i < CACHE_HASH_BUCKETS; i++)
+    {
+        while (!IsListEmpty(&CacheHashTable[i]))
+        {
+            Entry = CONTAINING_RECORD(CacheHashTable[i].Flink, RESOLVER_CACHE_ENTRY, HashLink);
+            DnsIntUnlinkEntry(Entry);
+        }
+    }
+
+    LeaveCriticalSection(&CacheLock);
+}
+
+VOID
+DnsIntCacheFlush(VOID)
+{
+    DnsIntCacheRemoveAll();
+    DnsIntReadParameters();
+    DnsIntLoadHostsFile();
+}
+
+DNS_STATUS
+DnsIntCacheGetEntries(
+    PDNS_CACHE_ENTRY *Entries)
+{
+    PDNS_CACHE_ENTRY CacheEntry, *Tail = Entries;
+    PRESOLVER_CACHE_ENTRY Entry;
+    PLIST_ENTRY ListEntry;
+    DWORD Now = GetTickCount();
+    ULONG i;
+
+    *Entries = NULL;
+
+    EnterCriticalSection(&CacheLock);
+
+    for (i = 0; i < CACHE_HASH_BUCKETS; i++)
+    {
+        for (ListEntry = CacheHashTable[i].Flink;
+             ListEntry != &CacheHashTable[i];
+             ListEntry = ListEntry->Flink)
+        {
+            Entry = CONTAINING_RECORD(ListEntry, RESOLVER_CACHE_ENTRY, HashLink);
+
+            if (Entry->Pending || Entry->Status != ERROR_SUCCESS || DnsIntIsExpired(Entry, Now))
+                continue;
+
+            CacheEntry = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DNS_CACHE_ENTRY));
+            if (CacheEntry != NULL)
+                CacheEntry->pszName = DnsIntDuplicateString(Entry->Name);
+            if (CacheEntry == NULL || CacheEntry->pszName == NULL)
+            {
+                LeaveCriticalSection(&CacheLock);
+
+                if (CacheEntry != NULL)
+                    HeapFree(GetProcessHeap(), 0, CacheEntry);
+                while (*Entries != NULL)
+                {
+                    CacheEntry = (*Entries)->pNext;
+                    HeapFree(GetProcessHeap(), 0, (*Entries)->pszName);
+                    HeapFree(GetProcessHeap(), 0, *Entries);
+                    *Entries = CacheEntry;
+                }
+                return ERROR_OUTOFMEMORY;
+            }
+
+            CacheEntry->wType = Entry->Type;
+            if (Entry->Records != NULL)
+                CacheEntry->wDataLength = Entry->Records->wDataLength;
+
+            *Tail = CacheEntry;
+            Tail = &CacheEntry->pNext;
+        }
+    }
+
+    LeaveCriticalSection(&CacheLock);
+
+    return ERROR_SUCCESS;
+}
+
+VOID
+DnsIntCacheInitialize(VOID)
+{
+    ULONG i;
+
+    /* The service can be started again within the same svchost process */
+    if (!CacheLockInitialized)
+    {
+        InitializeCriticalSection(&CacheLock);
+        CacheLockInitialized = TRUE;
+    }
+
+    EnterCriticalSection(&CacheLock);
+
+    for (i = 0; i < CACHE_HASH_BUCKETS; i++)
+        InitializeListHead(&CacheHashTable[i]);
+    InitializeListHead(&CacheLruList);
+    CacheEntryCount = 0;
+    CacheActive = TRUE;
+
+    LeaveCriticalSection(&CacheLock);
+
+    DnsIntReadParameters();
+}
+
+VOID
+DnsIntCacheFree(VOID)
+{
+    /*
+     * Stopping the RPC server doesn't wait for the calls it is serving, so
+     * the lock stays around for them. Queries still resolving keep a
+     * reference to their entry and finish on their own.
+     */
+    EnterCriticalSection(&CacheLock);
+    CacheActive = FALSE;
+    DnsIntCacheRemoveAll();
+    LeaveCriticalSection(&CacheLock);
+}
@@ -0,0 +1 @@
+@ stdcall ServiceMain(long ptr)
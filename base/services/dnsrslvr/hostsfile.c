@@ -0,0 +1,148 @@
+/*
+ * PROJECT:     ReactOS DNS Resolver
+ * LICENSE:     GPL - See COPYING in the top level directory
+ * FILE:        base/services/dnsrslvr/hostsfile.c
+ * PURPOSE:     Preloads the hosts file into the cache
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include "precomp.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(dnsrslvr);
+
+/* FUNCTIONS *****************************************************************/
+
+static
+HANDLE
+OpenHostsFile(VOID)
+{
+    WCHAR DatabasePath[MAX_PATH], ExpandedPath[MAX_PATH];
+    DWORD RegSize = sizeof(DatabasePath), RegType;
+    HKEY DatabaseKey;
+    BOOL Found = FALSE;
+
+    if (RegOpenKeyExW(HKEY_LOCAL_MACHINE,
+                      L"System\\CurrentControlSet\\Services\\Tcpip\\Parameters",
+                      0,
+                      KEY_READ,
+                      &DatabaseKey) == ERROR_SUCCESS)
+    {
+        if (RegQueryValueExW(DatabaseKey,
+                             L"DatabasePath",
+                             NULL,
+                             &RegType,
+                             (LPBYTE)DatabasePath,
+                             &RegSize) == ERROR_SUCCESS &&
+            (RegType == REG_SZ || RegType == REG_EXPAND_SZ))
+        {
+            DatabasePath[MAX_PATH - 1] = UNICODE_NULL;
+            Found = TRUE;
+        }
+
+        RegCloseKey(DatabaseKey);
+    }
+
+    if (!Found)
+        wcscpy(DatabasePath, L"%SystemRoot%\\system32\\drivers\\etc");
+
+    if (!ExpandEnvironmentStringsW(DatabasePath, ExpandedPath, MAX_PATH - 7) ||
+        wcslen(ExpandedPath) >= MAX_PATH - 7)
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    if (ExpandedPath[wcslen(ExpandedPath) - 1] != L'\\')
+        wcscat(ExpandedPath, L"\\");
+    wcscat(ExpandedPath, L"hosts");
+
+    return CreateFileW(ExpandedPath,
+                       FILE_READ_DATA,
+                       FILE_SHARE_READ,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+}
+
+static
+VOID
+ParseHostsLine(
+    PCHAR Line)
+{
+    WCHAR Name[256];
+    struct in_addr Address;
+    PCSTR Terminator;
+    PCHAR Token;
+    PCHAR Comment;
+
+    Comment = strchr(Line, '#');
+    if (Comment != NULL)
+        *Comment = ANSI_NULL;
+
+    Token = strtok(Line, " \t\r");
+    if (Token == NULL)
+        return;
+
+    if (!NT_SUCCESS(RtlIpv4StringToAddressA(Token, TRUE, &Terminator, &Address)) ||
+        *Terminator != ANSI_NULL)
+    {
+        return;
+    }
+
+    /* The canonical name followed by its aliases */
+    while ((Token = strtok(NULL, " \t\r")) != NULL)
+    {
+        if (!MultiByteToWideChar(CP_ACP, 0, Token, -1, Name, ARRAYSIZE(Name)))
+            continue;
+
+        DnsIntCacheAddHostsEntry(Name, Address.S_un.S_addr);
+    }
+}
+
+VOID
+DnsIntLoadHostsFile(VOID)
+{
+    LARGE_INTEGER FileSize;
+    HANDLE HostsFile;
+    PCHAR Data, Line, NextLine;
+    DWORD Read;
+
+    HostsFile = OpenHostsFile();
+    if (HostsFile == INVALID_HANDLE_VALUE)
+    {
+        TRACE("No hosts file\n");
+        return;
+    }
+
+    /* The file is small, read it in one go */
+    if (!GetFileSizeEx(HostsFile, &FileSize) || FileSize.QuadPart > 16 * 1024 * 1024)
+    {
+        CloseHandle(HostsFile);
+        return;
+    }
+
+    Data = HeapAlloc(GetProcessHeap(), 0, FileSize.LowPart + 1);
+    if (Data == NULL)
+    {
+        CloseHandle(HostsFile);
+        return;
+    }
+
+    if (!ReadFile(HostsFile, Data, FileSize.LowPart, &Read, NULL))
+        Read = 0;
+    Data[Read] = ANSI_NULL;
+
+    CloseHandle(HostsFile);
+
+    for (Line = Data; Line != NULL; Line = NextLine)
+    {
+        NextLine = strchr(Line, '\n');
+        if (NextLine != NULL)
+            *NextLine++ = ANSI_NULL;
+
+        ParseHostsLine(Line);
+    }
+
+    HeapFree(GetProcessHeap(), 0, Data);
+}
@@ -0,0 +1,66 @@
+#ifndef _DNSRSLVR_PCH_
+#define _DNSRSLVR_PCH_
+
+#define WIN32_NO_STATUS
+#define _INC_WINDOWS
+#define COM_NO_WINDOWS_H
+#include <stdarg.h>
+#include <wchar.h>
+#include <windef.h>
+#include <winbase.h>
+#include <winreg.h>
+#include <winsvc.h>
+#include <windns.h>
+#define NTOS_MODE_USER
+#include <ndk/rtlfuncs.h>
+
+#include <dnsrslvr_s.h>
+
+#include <wine/debug.h>
+
+/* cache.c */
+
+VOID
+DnsIntCacheInitialize(VOID);
+
+VOID
+DnsIntCacheFree(VOID);
+
+VOID
+DnsIntCacheFlush(VOID);
+
+BOOL
+DnsIntCacheFlushEntry(
+    LPCWSTR Name,
+    WORD Type);
+
+VOID
+DnsIntCacheAddHostsEntry(
+    LPCWSTR Name,
+    IP4_ADDRESS Address);
+
+DNS_STATUS
+DnsIntCacheQuery(
+    LPCWSTR Name,
+    WORD Type,
+    DWORD Flags,
+    PDNS_RECORDW *Records,
+    PDWORD RecordCount);
+
+DNS_STATUS
+DnsIntCacheGetEntries(
+    PDNS_CACHE_ENTRY *Entries);
+
+/* hostsfile.c */
+
+VOID
+DnsIntLoadHostsFile(VOID);
+
+/* rpcserver.c */
+
+DWORD
+WINAPI
+RpcThreadRoutine(
+    LPVOID lpParameter);
+
+#endif /* _DNSRSLVR_PCH_ */
@@ -0,0 +1,131 @@
+/*
+ * PROJECT:     ReactOS DNS Resolver
+ * LICENSE:     GPL - See COPYING in the top level directory
+ * FILE:        base/services/dnsrslvr/rpcserver.c
+ * PURPOSE:     RPC server interface of the resolver cache
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include "precomp.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(dnsrslvr);
+
+/* FUNCTIONS *****************************************************************/
+
+DWORD
+WINAPI
+RpcThreadRoutine(
+    LPVOID lpParameter)
+{
+    RPC_STATUS Status;
+
+    /* Only local callers, dnsapi binds to this endpoint */
+    Status = RpcServerUseProtseqEpW(L"ncalrpc", 20, L"DNSResolver", NULL);
+    if (Status != RPC_S_OK)
+    {
+        ERR("RpcServerUseProtseqEpW() failed (Status %lx)\n", Status);
+        return 0;
+    }
+
+    Status = RpcServerRegisterIf(DnsResolver_v2_0_s_ifspec, NULL, NULL);
+    if (Status != RPC_S_OK)
+    {
+        ERR("RpcServerRegisterIf() failed (Status %lx)\n", Status);
+        return 0;
+    }
+
+    Status = RpcServerListen(1, RPC_C_LISTEN_MAX_CALLS_DEFAULT, FALSE);
+    if (Status != RPC_S_OK)
+    {
+        ERR("RpcServerListen() failed (Status %lx)\n", Status);
+    }
+
+    return 0;
+}
+
+
+void __RPC_FAR * __RPC_USER midl_user_allocate(SIZE_T len)
+{
+    return HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, len);
+}
+
+
+void __RPC_USER midl_user_free(void __RPC_FAR * ptr)
+{
+    HeapFree(GetProcessHeap(), 0, ptr);
+}
+
+
+/* Function 4 */
+DWORD
+__stdcall
+R_ResolverFlushCache(
+    DNSRSLVR_HANDLE pwszServerName)
+{
+    TRACE("R_ResolverFlushCache()\n");
+
+    DnsIntCacheFlush();
+    return ERROR_SUCCESS;
+}
+
+
+/* Function 5 */
+DWORD
+__stdcall
+R_ResolverFlushCacheEntry(
+    DNSRSLVR_HANDLE pwszServerName,
+    LPCWSTR pwszName,
+    WORD wType)
+{
+    TRACE("R_ResolverFlushCacheEntry(%S %u)\n", pwszName, wType);
+
+    if (pwszName == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    if (!DnsIntCacheFlushEntry(pwszName, wType))
+        return ERROR_NOT_FOUND;
+
+    return ERROR_SUCCESS;
+}
+
+
+/* Function 7 */
+DWORD
+__stdcall
+R_ResolverQuery(
+    DNSRSLVR_HANDLE pwszServerName,
+    LPCWSTR pwsName,
+    WORD wType,
+    DWORD Flags,
+    DWORD *dwRecords,
+    DNS_RECORDW **ppResultRecords)
+{
+    TRACE("R_ResolverQuery(%S %u %lx)\n", pwsName, wType, Flags);
+
+    if (pwsName == NULL || dwRecords == NULL || ppResultRecords == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    *dwRecords = 0;
+    *ppResultRecords = NULL;
+
+    return DnsIntCacheQuery(pwsName, wType, Flags, ppResultRecords, dwRecords);
+}
+
+
+/* Function 8 */
+DWORD
+__stdcall
+R_ResolverEnumCache(
+    DNSRSLVR_HANDLE pwszServerName,
+    PDNS_CACHE_ENTRY *ppCacheEntries)
+{
+    TRACE("R_ResolverEnumCache()\n");
+
+    if (ppCacheEntries == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    *ppCacheEntries = NULL;
+
+    return DnsIntCacheGetEntries(ppCacheEntries);
+}
@@ -25,6 +25,8 @@
 #define TAG_WLDR_DTE 'eDlW'
 #define TAG_WLDR_BDE 'dBlW'
 #define TAG_WLDR_NAME 'mNlW'
+#define TAG_WLDR_IMAGE 'mIlW'
+#define TAG_WLDR_PLAN 'pLlW'
 
 /* Entry-point to kernel */
 typedef VOID (NTAPI *KERNEL_ENTRY_POINT) (PLOADER_PARAMETER_BLOCK LoaderBlock);
@@ -33,6 +33,7 @@ BOOLEAN    FatGetFatEntry(PFAT_VOLUME_INFO Volume, ULONG Cluster, ULONG* Cluster
 ULONG    FatCountClustersInChain(PFAT_VOLUME_INFO Volume, ULONG StartCluster);
 ULONG*    FatGetClusterChainArray(PFAT_VOLUME_INFO Volume, ULONG StartCluster);
 BOOLEAN    FatReadClusterChain(PFAT_VOLUME_INFO Volume, ULONG StartClusterNumber, ULONG NumberOfClusters, PVOID Buffer);
+BOOLEAN    FatReadClusterArray(PFAT_VOLUME_INFO Volume, ULONG* ClusterArray, ULONG NumberOfClusters, PVOID Buffer);
 BOOLEAN    FatReadPartialCluster(PFAT_VOLUME_INFO Volume, ULONG ClusterNumber, ULONG StartingOffset, ULONG Length, PVOID Buffer);
 BOOLEAN    FatReadVolumeSectors(PFAT_VOLUME_INFO Volume, ULONG SectorNumber, ULONG SectorCount, PVOID Buffer);
 
@@ -41,6 +42,9 @@ BOOLEAN    FatReadVolumeSectors(PFAT_VOLUME_INFO Volume, ULONG SectorNumber, ULO
 #define TAG_FAT_VOLUME 'VtaF'
 #define TAG_FAT_BUFFER 'BtaF'
 
+/* Number of FAT sectors kept by FatGetFatEntry() */
+#define FAT_CACHE_SECTORS 8
+
 typedef struct _FAT_VOLUME_INFO
 {
     ULONG BytesPerSector; /* Number of bytes per sector */
@@ -55,6 +59,8 @@ typedef struct _FAT_VOLUME_INFO
     ULONG DataSectorStart; /* Starting sector of the data area */
     ULONG FatType; /* FAT12, FAT16, FAT32, FATX16 or FATX32 */
     ULONG DeviceId;
+    PUCHAR FatCache; /* FAT_CACHE_SECTORS sectors of the active FAT table */
+    ULONG FatCacheStart; /* First sector in FatCache, 0 if it holds nothing yet */
 } FAT_VOLUME_INFO;
 
 PFAT_VOLUME_INFO FatVolumes[MAX_FDS];
@@ -899,6 +905,38 @@ void FatParseShortFileName(PCHAR Buffer, PDIRENTRY DirEntry)
     //TRACE("FatParseShortFileName() ShortName = %s\n", Buffer);
 }
 
+/*
+ * FatReadFatSectors()
+ * Returns the given sectors of the active FAT table. Walking a cluster
+ * chain looks at the same FAT sector many times in a row, so the last
+ * FAT_CACHE_SECTORS sectors read are kept per volume.
+ */
+static PUCHAR FatReadFatSectors(PFAT_VOLUME_INFO Volume, ULONG SectorNumber, ULONG SectorCount)
+{
+    if (Volume->FatCache == NULL)
+    {
+        Volume->FatCache = FrLdrTempAlloc(FAT_CACHE_SECTORS * Volume->BytesPerSector, TAG_FAT_BUFFER);
+        if (Volume->FatCache == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    if (Volume->FatCacheStart == 0 ||
+        SectorNumber < Volume->FatCacheStart ||
+        SectorNumber + SectorCount > Volume->FatCacheStart + FAT_CACHE_SECTORS)
+    {
+        if (!FatReadVolumeSectors(Volume, SectorNumber, FAT_CACHE_SECTORS, Volume->FatCache))
+        {
+            Volume->FatCacheStart = 0;
+            return NULL;
+        }
+        Volume->FatCacheStart = SectorNumber;
+    }
+
+    return Volume->FatCache + (SectorNumber - Volume->FatCacheStart) * Volume->BytesPerSector;
+}
+
 /*
  * FatGetFatEntry()
  * returns the Fat entry for a given cluster number
@@ -915,13 +953,6 @@ BOOLEAN FatGetFatEntry(PFAT_VOLUME_INFO Volume, ULONG Cluster, ULONG* ClusterPoi
 
     //TRACE("FatGetFatEntry() Retrieving FAT entry for cluster %d.\n", Cluster);
 
-    // We need a buffer for 2 sectors
-    ReadBuffer = FrLdrTempAlloc(2 * Volume->BytesPerSector, TAG_FAT_BUFFER);
-    if (!ReadBuffer)
-    {
-        return FALSE;
-    }
-
     switch(Volume->FatType)
     {
     case FAT12:
@@ -943,7 +974,8 @@ BOOLEAN FatGetFatEntry(PFAT_VOLUME_INFO Volume, ULONG Cluster, ULONG* ClusterPoi
             SectorCount = 1;
         }
 
-        if (!FatReadVolumeSectors(Volume, ThisFatSecNum, SectorCount, ReadBuffer))
+        ReadBuffer = FatReadFatSectors(Volume, ThisFatSecNum, SectorCount);
+        if (!ReadBuffer)
         {
             Success = FALSE;
             break;
@@ -965,7 +997,8 @@ BOOLEAN FatGetFatEntry(PFAT_VOLUME_INFO Volume, ULONG Cluster, ULONG* ClusterPoi
         ThisFatSecNum = Volume->ActiveFatSectorStart + (FatOffset / Volume->BytesPerSector);
         ThisFatEntOffset = (FatOffset % Volume->BytesPerSector);
 
-        if (!FatReadVolumeSectors(Volume, ThisFatSecNum, 1, ReadBuffer))
+        ReadBuffer = FatReadFatSectors(Volume, ThisFatSecNum, 1);
+        if (!ReadBuffer)
         {
             Success = FALSE;
             break;
@@ -983,7 +1016,8 @@ BOOLEAN FatGetFatEntry(PFAT_VOLUME_INFO Volume, ULONG Cluster, ULONG* ClusterPoi
         ThisFatSecNum = Volume->ActiveFatSectorStart + (FatOffset / Volume->BytesPerSector);
         ThisFatEntOffset = (FatOffset % Volume->BytesPerSector);
 
-        if (!FatReadVolumeSectors(Volume, ThisFatSecNum, 1, ReadBuffer))
+        ReadBuffer = FatReadFatSectors(Volume, ThisFatSecNum, 1);
+        if (!ReadBuffer)
         {
             return FALSE;
         }
@@ -1002,8 +1036,6 @@ BOOLEAN FatGetFatEntry(PFAT_VOLUME_INFO Volume, ULONG Cluster, ULONG* ClusterPoi
 
     //TRACE("FAT entry is 0x%x.\n", fat);
 
-    FrLdrTempFree(ReadBuffer, TAG_FAT_BUFFER);
-
     *ClusterPointer = fat;
 
     return Success;
@@ -1161,6 +1193,46 @@ BOOLEAN FatReadClusterChain(PFAT_VOLUME_INFO Volume, ULONG StartClusterNumber, U
     return TRUE;
 }
 
+/*
+ * FatReadClusterArray()
+ * Reads the specified clusters of a file's cluster chain array into memory.
+ * Clusters that follow each other on the disk are read in one go.
+ */
+BOOLEAN FatReadClusterArray(PFAT_VOLUME_INFO Volume, ULONG* ClusterArray, ULONG NumberOfClusters, PVOID Buffer)
+{
+    ULONG        ClusterStartSector;
+    ULONG        RunLength;
+
+    TRACE("FatReadClusterArray() StartClusterNumber = %d NumberOfClusters = %d Buffer = 0x%x\n", ClusterArray[0], NumberOfClusters, Buffer);
+
+    while (NumberOfClusters > 0)
+    {
+        //
+        // Find out how many clusters are contiguous
+        //
+        for (RunLength = 1; RunLength < NumberOfClusters; RunLength++)
+        {
+            if (ClusterArray[RunLength] != ClusterArray[0] + RunLength)
+                break;
+        }
+
+        //
+        // Read them into memory
+        //
+        ClusterStartSector = ((ClusterArray[0] - 2) * Volume->SectorsPerCluster) + Volume->DataSectorStart;
+        if (!FatReadVolumeSectors(Volume, ClusterStartSector, RunLength * Volume->SectorsPerCluster, Buffer))
+        {
+            return FALSE;
+        }
+
+        ClusterArray += RunLength;
+        NumberOfClusters -= RunLength;
+        Buffer = (PVOID)((ULONG_PTR)Buffer + (RunLength * Volume->SectorsPerCluster * Volume->BytesPerSector));
+    }
+
+    return TRUE;
+}
+
 /*
  * FatReadPartialCluster()
  * Reads part of a cluster into memory
@@ -1316,12 +1388,11 @@ BOOLEAN FatReadFile(PFAT_FILE_INFO FatFileInfo, ULONG BytesToRead, ULONG* BytesR
         if (NumberOfClusters > 0)
         {
             ClusterNumber = (FatFileInfo->FilePointer / BytesPerCluster);
-            ClusterNumber = FatFileInfo->FileFatChain[ClusterNumber];
 
             //
             // Now do the read and update BytesRead, BytesToRead, FilePointer, & Buffer
             //
-            if (!FatReadClusterChain(Volume, ClusterNumber, NumberOfClusters, Buffer))
+            if (!FatReadClusterArray(Volume, &FatFileInfo->FileFatChain[ClusterNumber], NumberOfClusters, Buffer))
             {
                 return FALSE;
             }
@@ -1414,6 +1485,15 @@ ARC_STATUS FatGetFileInformation(ULONG FileId, FILEINFORMATION* Information)
     Information->EndingAddress.LowPart = FileHandle->FileSize;
     Information->CurrentAddress.LowPart = FileHandle->FilePointer;
 
+    /* Where the file starts on the volume, so that callers loading many
+       files can read them in disk order */
+    if (FileHandle->FileSize != 0 && FileHandle->FileFatChain[0] >= 2)
+    {
+        Information->StartingAddress.QuadPart =
+            (ULONGLONG)((FileHandle->FileFatChain[0] - 2) * FileHandle->Volume->SectorsPerCluster +
+                        FileHandle->Volume->DataSectorStart) * FileHandle->Volume->BytesPerSector;
+    }
+
     TRACE("FatGetFileInformation() FileSize = %d\n",
         Information->EndingAddress.LowPart);
     TRACE("FatGetFileInformation() FilePointer = %d\n",
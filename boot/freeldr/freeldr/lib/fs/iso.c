@@ -260,6 +260,10 @@ ARC_STATUS IsoGetFileInformation(ULONG FileId, FILEINFORMATION* Information)
     Information->EndingAddress.LowPart = FileHandle->FileSize;
     Information->CurrentAddress.LowPart = FileHandle->FilePointer;
 
+    /* Where the file starts on the disc, so that callers loading many
+       files can read them in disk order */
+    Information->StartingAddress.QuadPart = (ULONGLONG)FileHandle->FileStart * SECTORSIZE;
+
     return ESUCCESS;
 }
 
@@ -276,6 +276,8 @@ WinLdrLoadImage(IN PCHAR FileName,
     PIMAGE_NT_HEADERS NtHeaders;
     PIMAGE_SECTION_HEADER SectionHeader;
     ULONG VirtualSize, SizeOfRawData, NumberOfSections;
+    ULONG SizeOfHeaders, FileSpan, FileBufferLength;
+    PUCHAR FileBuffer = NULL;
     ARC_STATUS Status;
     LARGE_INTEGER Position;
     ULONG i, BytesRead;
@@ -366,6 +368,37 @@ WinLdrLoadImage(IN PCHAR FileName,
 
     /* Reload the NT Header */
     NtHeaders = RtlImageNtHeader(PhysicalBase);
+    SizeOfHeaders = NtHeaders->OptionalHeader.SizeOfHeaders;
+
+    /* Find where the raw data of the last section ends */
+    FileSpan = SizeOfHeaders;
+    SectionHeader = IMAGE_FIRST_SECTION(NtHeaders);
+    for (i = 0; i < NumberOfSections; i++)
+    {
+        if ((SectionHeader[i].PointerToRawData != 0) &&
+            (SectionHeader[i].PointerToRawData + SectionHeader[i].SizeOfRawData > FileSpan))
+        {
+            FileSpan = SectionHeader[i].PointerToRawData + SectionHeader[i].SizeOfRawData;
+        }
+    }
+
+    /* Read all sections with a single read, which the file system can turn
+       into a few large disk reads instead of a seek and read per section.
+       If there is no room for it, fall back to reading them one by one. */
+    FileBufferLength = 0;
+    if (FileSpan > SizeOfHeaders)
+    {
+        FileBuffer = FrLdrTempAlloc(FileSpan - SizeOfHeaders, TAG_WLDR_IMAGE);
+        if (FileBuffer)
+        {
+            Status = ArcRead(FileId, FileBuffer, FileSpan - SizeOfHeaders, &FileBufferLength);
+            if (Status != ESUCCESS)
+            {
+                FileBufferLength = 0;
+                Status = ESUCCESS;
+            }
+        }
+    }
 
     /* Load the first section */
     SectionHeader = IMAGE_FIRST_SECTION(NtHeaders);
@@ -396,8 +429,20 @@ WinLdrLoadImage(IN PCHAR FileName,
                 SizeOfRawData = VirtualSize;
         }
 
-        /* Actually read the section (if its size is not 0) */
-        if (SizeOfRawData != 0)
+        /* Copy the section from the file buffer if it holds all of it */
+        if ((SizeOfRawData != 0) &&
+            (SectionHeader->PointerToRawData >= SizeOfHeaders) &&
+            (SectionHeader->PointerToRawData - SizeOfHeaders + SizeOfRawData <= FileBufferLength))
+        {
+            TRACE("SH->VA: 0x%X\n", SectionHeader->VirtualAddress);
+
+            RtlCopyMemory((PUCHAR)PhysicalBase + SectionHeader->VirtualAddress,
+                          FileBuffer + SectionHeader->PointerToRawData - SizeOfHeaders,
+                          SizeOfRawData);
+            Status = ESUCCESS;
+        }
+        /* Otherwise actually read the section (if its size is not 0) */
+        else if (SizeOfRawData != 0)
         {
             /* Seek to the correct position */
             Position.LowPart = SectionHeader->PointerToRawData;
@@ -425,6 +470,8 @@ WinLdrLoadImage(IN PCHAR FileName,
     }
 
     /* We are done with the file - close it */
+    if (FileBuffer)
+        FrLdrTempFree(FileBuffer, TAG_WLDR_IMAGE);
     ArcClose(FileId);
 
     /* If loading failed - return right now */
@@ -291,55 +291,163 @@ WinLdrLoadDeviceDriver(PLIST_ENTRY LoadOrderListHead,
     return TRUE;
 }
 
+typedef struct _WINLDR_LOAD_PLAN_ENTRY
+{
+    PBOOT_DRIVER_LIST_ENTRY BootDriver;
+    ULONGLONG StartingAddress;
+} WINLDR_LOAD_PLAN_ENTRY, *PWINLDR_LOAD_PLAN_ENTRY;
+
+static ULONGLONG
+WinLdrpGetDriverStartingAddress(LPCSTR BootPath,
+                                PUNICODE_STRING FilePath)
+{
+    CHAR FullPath[1024];
+    FILEINFORMATION FileInfo;
+    ULONG FileId;
+    ARC_STATUS Status;
+
+    _snprintf(FullPath, sizeof(FullPath), "%s%wZ", BootPath, FilePath);
+    Status = ArcOpen(FullPath, OpenReadOnly, &FileId);
+    if (Status != ESUCCESS)
+        return 0;
+
+    // File systems that don't know where the file is report 0 here
+    Status = ArcGetFileInformation(FileId, &FileInfo);
+    ArcClose(FileId);
+    if (Status != ESUCCESS)
+        return 0;
+
+    return FileInfo.StartingAddress.QuadPart;
+}
+
+static BOOLEAN
+WinLdrpLoadBootDriver(PLOADER_PARAMETER_BLOCK LoaderBlock,
+                      LPCSTR BootPath,
+                      PBOOT_DRIVER_LIST_ENTRY BootDriver)
+{
+    BOOLEAN Success;
+
+    TRACE("BootDriver %wZ DTE %08X RegPath: %wZ\n", &BootDriver->FilePath,
+        BootDriver->LdrEntry, &BootDriver->RegistryPath);
+
+    // Paths are relative (FIXME: Are they always relative?)
+
+    // Load it
+    Success = WinLdrLoadDeviceDriver(&LoaderBlock->LoadOrderListHead,
+                                     BootPath,
+                                     &BootDriver->FilePath,
+                                     0,
+                                     &BootDriver->LdrEntry);
+
+    if (Success)
+    {
+        // Convert the RegistryPath and DTE addresses to VA since we are not going to use it anymore
+        BootDriver->RegistryPath.Buffer = PaToVa(BootDriver->RegistryPath.Buffer);
+        BootDriver->FilePath.Buffer = PaToVa(BootDriver->FilePath.Buffer);
+        BootDriver->LdrEntry = PaToVa(BootDriver->LdrEntry);
+    }
+    else
+    {
+        // Loading failed - cry loudly
+        ERR("Can't load boot driver '%wZ'!\n", &BootDriver->FilePath);
+        UiMessageBox("Can't load boot driver '%wZ'!", &BootDriver->FilePath);
+
+        // Remove it from the list and try to continue
+        RemoveEntryList(&BootDriver->Link);
+    }
+
+    return Success;
+}
+
 BOOLEAN
 WinLdrLoadBootDrivers(PLOADER_PARAMETER_BLOCK LoaderBlock,
                       LPCSTR BootPath)
 {
     PLIST_ENTRY NextBd;
     PBOOT_DRIVER_LIST_ENTRY BootDriver;
-    BOOLEAN Success;
+    PWINLDR_LOAD_PLAN_ENTRY LoadPlan;
+    WINLDR_LOAD_PLAN_ENTRY PlanEntry;
+    ULONG DriverCount, i, j;
     BOOLEAN ret = TRUE;
 
-    // Walk through the boot drivers list
-    NextBd = LoaderBlock->BootDriverListHead.Flink;
-
-    while (NextBd != &LoaderBlock->BootDriverListHead)
+    // Count the boot drivers
+    DriverCount = 0;
+    for (NextBd = LoaderBlock->BootDriverListHead.Flink;
+         NextBd != &LoaderBlock->BootDriverListHead;
+         NextBd = NextBd->Flink)
     {
-        BootDriver = CONTAINING_RECORD(NextBd, BOOT_DRIVER_LIST_ENTRY, Link);
-
-        TRACE("BootDriver %wZ DTE %08X RegPath: %wZ\n", &BootDriver->FilePath,
-            BootDriver->LdrEntry, &BootDriver->RegistryPath);
+        DriverCount++;
+    }
 
-        // Paths are relative (FIXME: Are they always relative?)
+    if (DriverCount == 0)
+        return TRUE;
 
-        // Load it
-        Success = WinLdrLoadDeviceDriver(&LoaderBlock->LoadOrderListHead,
-                                         BootPath,
-                                         &BootDriver->FilePath,
-                                         0,
-                                         &BootDriver->LdrEntry);
+    // Build a load plan, so that the drivers are read in the order they
+    // are stored on the disk instead of seeking back and forth for each.
+    // This only changes the load order, the list order is kept.
+    LoadPlan = FrLdrTempAlloc(DriverCount * sizeof(WINLDR_LOAD_PLAN_ENTRY), TAG_WLDR_PLAN);
+    if (LoadPlan)
+    {
+        BootDriver = CONTAINING_RECORD(LoaderBlock->BootDriverListHead.Flink, BOOT_DRIVER_LIST_ENTRY, Link);
+        LoadPlan[0].StartingAddress = WinLdrpGetDriverStartingAddress(BootPath, &BootDriver->FilePath);
 
-        if (Success)
+        // The file system doesn't report where files are (e.g. PXE, NTFS, ext2),
+        // so don't pay an extra open for each of the other drivers
+        if (LoadPlan[0].StartingAddress == 0)
         {
-            // Convert the RegistryPath and DTE addresses to VA since we are not going to use it anymore
-            BootDriver->RegistryPath.Buffer = PaToVa(BootDriver->RegistryPath.Buffer);
-            BootDriver->FilePath.Buffer = PaToVa(BootDriver->FilePath.Buffer);
-            BootDriver->LdrEntry = PaToVa(BootDriver->LdrEntry);
+            FrLdrTempFree(LoadPlan, TAG_WLDR_PLAN);
+            LoadPlan = NULL;
         }
-        else
+    }
+
+    if (!LoadPlan)
+    {
+        // Load them in list order
+        NextBd = LoaderBlock->BootDriverListHead.Flink;
+        while (NextBd != &LoaderBlock->BootDriverListHead)
         {
-            // Loading failed - cry loudly
-            ERR("Can't load boot driver '%wZ'!\n", &BootDriver->FilePath);
-            UiMessageBox("Can't load boot driver '%wZ'!", &BootDriver->FilePath);
-            ret = FALSE;
+            BootDriver = CONTAINING_RECORD(NextBd, BOOT_DRIVER_LIST_ENTRY, Link);
+            NextBd = NextBd->Flink;
 
-            // Remove it from the list and try to continue
-            RemoveEntryList(NextBd);
+            if (!WinLdrpLoadBootDriver(LoaderBlock, BootPath, BootDriver))
+                ret = FALSE;
         }
 
-        NextBd = BootDriver->Link.Flink;
+        return ret;
     }
 
+    i = 0;
+    for (NextBd = LoaderBlock->BootDriverListHead.Flink;
+         NextBd != &LoaderBlock->BootDriverListHead;
+         NextBd = NextBd->Flink)
+    {
+        BootDriver = CONTAINING_RECORD(NextBd, BOOT_DRIVER_LIST_ENTRY, Link);
+        LoadPlan[i].BootDriver = BootDriver;
+        if (i != 0)
+            LoadPlan[i].StartingAddress = WinLdrpGetDriverStartingAddress(BootPath, &BootDriver->FilePath);
+        i++;
+    }
+
+    // Sort it by position on the disk. A stable insertion sort keeps the list
+    // order for drivers at the same position, e.g. ones that failed to open.
+    for (i = 1; i < DriverCount; i++)
+    {
+        PlanEntry = LoadPlan[i];
+        for (j = i; (j > 0) && (LoadPlan[j - 1].StartingAddress > PlanEntry.StartingAddress); j--)
+        {
+            LoadPlan[j] = LoadPlan[j - 1];
+        }
+        LoadPlan[j] = PlanEntry;
+    }
+
+    // Walk through the load plan
+    for (i = 0; i < DriverCount; i++)
+    {
+        if (!WinLdrpLoadBootDriver(LoaderBlock, BootPath, LoadPlan[i].BootDriver))
+            ret = FALSE;
+    }
+
+    FrLdrTempFree(LoadPlan, TAG_WLDR_PLAN);
     return ret;
 }
 
@@ -770,6 +878,22 @@ LoadAndBootWindows(IN OperatingSystemItem* OperatingSystem,
                              FALSE);
 }
 
+static VOID
+WinLdrpTracePhase(PCSTR PhaseName,
+                  ULONGLONG *PhaseStart)
+{
+#if DBG && !defined(_M_ARM)
+    ULONGLONG Now = __rdtsc();
+
+    // There is no finer timer this early, so report TSC kilocycles
+    TRACE("%s took %I64u kcycles\n", PhaseName, (Now - *PhaseStart) / 1000);
+    *PhaseStart = Now;
+#else
+    UNREFERENCED_PARAMETER(PhaseName);
+    UNREFERENCED_PARAMETER(PhaseStart);
+#endif
+}
+
 VOID
 LoadAndBootWindowsCommon(
     USHORT OperatingSystemVersion,
@@ -783,8 +907,11 @@ LoadAndBootWindowsCommon(
     PLDR_DATA_TABLE_ENTRY KernelDTE;
     KERNEL_ENTRY_POINT KiSystemStartup;
     LPCSTR SystemRoot;
+    ULONGLONG PhaseStart = 0;
     TRACE("LoadAndBootWindowsCommon()\n");
 
+    WinLdrpTracePhase("Startup", &PhaseStart);
+
 #ifdef _M_IX86
     /* Setup redirection support */
     WinLdrSetupEms((PCHAR)BootOptions);
@@ -797,6 +924,7 @@ LoadAndBootWindowsCommon(
     UiDrawBackdrop();
     UiDrawProgressBarCenter(20, 100, "Detecting hardware...");
     LoaderBlock->ConfigurationRoot = MachHwDetect();
+    WinLdrpTracePhase("Hardware detection", &PhaseStart);
 
     if (OperatingSystemVersion == 0)
         OperatingSystemVersion = WinLdrDetectVersion();
@@ -812,12 +940,14 @@ LoadAndBootWindowsCommon(
         UiMessageBox("Error loading NTOS core.");
         return;
     }
+    WinLdrpTracePhase("NTOS core loading", &PhaseStart);
 
     /* Load boot drivers */
     UiDrawBackdrop();
     UiDrawProgressBarCenter(100, 100, "Loading boot drivers...");
     Success = WinLdrLoadBootDrivers(LoaderBlock, BootPath);
     TRACE("Boot drivers loading %s\n", Success ? "successful" : "failed");
+    WinLdrpTracePhase("Boot drivers loading", &PhaseStart);
 
     /* Initialize Phase 1 - no drivers loading anymore */
     WinLdrInitializePhase1(LoaderBlock,
@@ -825,6 +955,7 @@ LoadAndBootWindowsCommon(
                            SystemRoot,
                            BootPath,
                            OperatingSystemVersion);
+    WinLdrpTracePhase("Phase 1 initialization", &PhaseStart);
 
     /* Save entry-point pointer and Loader block VAs */
     KiSystemStartup = (KERNEL_ENTRY_POINT)KernelDTE->EntryPoint;
@@ -35,13 +35,13 @@
 @ stdcall DnsFindAuthoritativeZone()
 @ stdcall DnsFlushResolverCache()
 @ stdcall DnsFlushResolverCacheEntry_A(str)
-@ stdcall DnsFlushResolverCacheEntry_UTF8()
-@ stdcall DnsFlushResolverCacheEntry_W()
+@ stdcall DnsFlushResolverCacheEntry_UTF8(str)
+@ stdcall DnsFlushResolverCacheEntry_W(wstr)
 @ stdcall DnsFreeAdapterInformation()
 @ stdcall DnsFreeNetworkInformation()
 @ stdcall DnsFreeSearchInformation()
 @ stdcall DnsGetBufferLengthForStringCopy()
-@ stdcall DnsGetCacheDataTable()
+@ stdcall DnsGetCacheDataTable(ptr)
 @ stdcall DnsGetDnsServerList()
 @ stdcall DnsGetDomainName()
 @ stdcall DnsGetHostName_A()
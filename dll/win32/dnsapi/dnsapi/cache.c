@@ -0,0 +1,193 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS system libraries
+ * FILE:            dll/win32/dnsapi/dnsapi/cache.c
+ * PURPOSE:         DNS Resolver Cache service interface code
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include "precomp.h"
+
+#include <rpc.h>
+#include <dnsrslvr_c.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* FUNCTIONS *****************************************************************/
+
+handle_t __RPC_USER
+DNSRSLVR_HANDLE_bind(DNSRSLVR_HANDLE pszServerName)
+{
+    handle_t hBinding = NULL;
+    LPWSTR pszStringBinding;
+    RPC_STATUS status;
+
+    DPRINT("DNSRSLVR_HANDLE_bind() called\n");
+
+    /* The resolver only listens on the local machine */
+    status = RpcStringBindingComposeW(NULL,
+                                      L"ncalrpc",
+                                      NULL,
+                                      L"DNSResolver",
+                                      NULL,
+                                      &pszStringBinding);
+    if (status)
+    {
+        DPRINT1("RpcStringBindingCompose returned 0x%x\n", status);
+        return NULL;
+    }
+
+    /* Set the binding handle that will be used to bind to the server. */
+    status = RpcBindingFromStringBindingW(pszStringBinding,
+                                          &hBinding);
+    if (status)
+    {
+        DPRINT1("RpcBindingFromStringBinding returned 0x%x\n", status);
+    }
+
+    status = RpcStringFreeW(&pszStringBinding);
+    if (status)
+    {
+        DPRINT1("RpcStringFree returned 0x%x\n", status);
+    }
+
+    return hBinding;
+}
+
+void __RPC_USER
+DNSRSLVR_HANDLE_unbind(DNSRSLVR_HANDLE pszServerName,
+                       handle_t hBinding)
+{
+    RPC_STATUS status;
+
+    DPRINT("DNSRSLVR_HANDLE_unbind() called\n");
+
+    status = RpcBindingFree(&hBinding);
+    if (status)
+    {
+        DPRINT1("RpcBindingFree returned 0x%x\n", status);
+    }
+}
+
+/* Results are freed with DnsRecordListFree, which uses the process heap */
+void __RPC_FAR * __RPC_USER
+midl_user_allocate(SIZE_T len)
+{
+    return RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, len);
+}
+
+void __RPC_USER
+midl_user_free(void __RPC_FAR * ptr)
+{
+    RtlFreeHeap(RtlGetProcessHeap(), 0, ptr);
+}
+
+BOOL WINAPI
+DnsFlushResolverCache(VOID)
+{
+    DNS_STATUS Status;
+
+    DPRINT("DnsFlushResolverCache()\n");
+
+    RpcTryExcept
+    {
+        Status = R_ResolverFlushCache(NULL);
+    }
+    RpcExcept(EXCEPTION_EXECUTE_HANDLER)
+    {
+        Status = RpcExceptionCode();
+    }
+    RpcEndExcept;
+
+    return (Status == ERROR_SUCCESS);
+}
+
+BOOL WINAPI
+DnsFlushResolverCacheEntry_W(PCWSTR entry)
+{
+    DNS_STATUS Status;
+
+    DPRINT("DnsFlushResolverCacheEntry_W(%S)\n", entry);
+
+    if (entry == NULL)
+        return FALSE;
+
+    RpcTryExcept
+    {
+        Status = R_ResolverFlushCacheEntry(NULL, entry, DNS_TYPE_ANY);
+    }
+    RpcExcept(EXCEPTION_EXECUTE_HANDLER)
+    {
+        Status = RpcExceptionCode();
+    }
+    RpcEndExcept;
+
+    DPRINT("R_ResolverFlushCacheEntry() returned %lu\n", Status);
+    return (Status == ERROR_SUCCESS);
+}
+
+BOOL WINAPI
+DnsFlushResolverCacheEntry_A(PCSTR entry)
+{
+    LPWSTR Name;
+    BOOL Result;
+
+    if (entry == NULL)
+        return FALSE;
+
+    Name = dns_strdup_aw(entry);
+    if (Name == NULL)
+        return FALSE;
+
+    Result = DnsFlushResolverCacheEntry_W(Name);
+
+    HeapFree(GetProcessHeap(), 0, Name);
+    return Result;
+}
+
+BOOL WINAPI
+DnsFlushResolverCacheEntry_UTF8(PCSTR entry)
+{
+    LPWSTR Name;
+    BOOL Result;
+
+    if (entry == NULL)
+        return FALSE;
+
+    Name = dns_strdup_uw(entry);
+    if (Name == NULL)
+        return FALSE;
+
+    Result = DnsFlushResolverCacheEntry_W(Name);
+
+    HeapFree(GetProcessHeap(), 0, Name);
+    return Result;
+}
+
+/* The caller frees each entry and its name with DnsFree */
+BOOL WINAPI
+DnsGetCacheDataTable(PDNS_CACHE_ENTRY *DnsCacheEntries)
+{
+    DNS_STATUS Status;
+
+    DPRINT("DnsGetCacheDataTable(%p)\n", DnsCacheEntries);
+
+    if (DnsCacheEntries == NULL)
+        return FALSE;
+
+    *DnsCacheEntries = NULL;
+
+    RpcTryExcept
+    {
+        Status = R_ResolverEnumCache(NULL, DnsCacheEntries);
+    }
+    RpcExcept(EXCEPTION_EXECUTE_HANDLER)
+    {
+        Status = RpcExceptionCode();
+    }
+    RpcEndExcept;
+
+    return (Status == ERROR_SUCCESS);
+}
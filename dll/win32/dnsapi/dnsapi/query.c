@@ -12,6 +12,9 @@
 #include <winreg.h>
 #include <iphlpapi.h>
 #include <strsafe.h>
+#include <time.h>
+
+#include <dnsrslvr_c.h>
 
 #define NDEBUG
 #include <debug.h>
@@ -589,8 +592,8 @@ FindEntryInHosts(CONST CHAR * name)
     return Address;
 }
 
-DNS_STATUS WINAPI
-DnsQuery_W(LPCWSTR Name,
+static DNS_STATUS
+Query_Main(LPCWSTR Name,
            WORD Type,
            DWORD Options,
            PIP4_ARRAY Servers,
@@ -663,6 +666,7 @@ DnsQuery_W(LPCWSTR Name,
             (*QueryResultSet)->wType = Type;
             (*QueryResultSet)->wDataLength = sizeof(DNS_A_DATA);
             (*QueryResultSet)->Data.A.IpAddress = Address;
+            (*QueryResultSet)->dwTtl = 0;
 
             (*QueryResultSet)->pName = (LPSTR)xstrsave(Name);
 
@@ -708,6 +712,7 @@ DnsQuery_W(LPCWSTR Name,
                 (*QueryResultSet)->wType = Type;
                 (*QueryResultSet)->wDataLength = sizeof(DNS_A_DATA);
                 (*QueryResultSet)->Data.A.IpAddress = Address;
+                (*QueryResultSet)->dwTtl = 0;
 
                 (*QueryResultSet)->pName = (LPSTR)xstrsave(Name);
 
@@ -757,6 +762,7 @@ DnsQuery_W(LPCWSTR Name,
             (*QueryResultSet)->wType = Type;
             (*QueryResultSet)->wDataLength = sizeof(DNS_A_DATA);
             (*QueryResultSet)->Data.A.IpAddress = Address;
+            (*QueryResultSet)->dwTtl = 0;
 
             (*QueryResultSet)->pName = (LPSTR)DnsCToW(HostWithDomainName);
 
@@ -856,6 +862,7 @@ DnsQuery_W(LPCWSTR Name,
                 (*QueryResultSet)->wType = Type;
                 (*QueryResultSet)->wDataLength = sizeof(DNS_A_DATA);
                 (*QueryResultSet)->Data.A.IpAddress = answer->rrs.addr->addr.inet.sin_addr.s_addr;
+                (*QueryResultSet)->dwTtl = (answer->expires > time(NULL)) ? (DWORD)(answer->expires - time(NULL)) : 0;
 
                 adns_finish(astate);
 
@@ -872,6 +879,12 @@ DnsQuery_W(LPCWSTR Name,
                     RtlFreeHeap(RtlGetProcessHeap(), 0, CurrentName);
 
                 RtlFreeHeap(RtlGetProcessHeap(), 0, AnsiName);
+
+                /* Let the resolver cache tell a missing name from a failure */
+                if (answer && answer->status == adns_s_nxdomain)
+                    return DNS_ERROR_RCODE_NAME_ERROR;
+                if (answer && answer->status == adns_s_nodata)
+                    return DNS_INFO_NO_RECORDS;
                 return ERROR_FILE_NOT_FOUND;
             }
 
@@ -898,6 +911,61 @@ DnsQuery_W(LPCWSTR Name,
     }
 }
 
+DNS_STATUS WINAPI
+DnsQuery_W(LPCWSTR Name,
+           WORD Type,
+           DWORD Options,
+           PIP4_ARRAY Servers,
+           PDNS_RECORD *QueryResultSet,
+           PVOID *Reserved)
+{
+    DNS_STATUS Status;
+    DWORD dwRecords = 0;
+    BOOL Fallback = FALSE;
+
+    if (Name == NULL)
+        return ERROR_INVALID_PARAMETER;
+    if (QueryResultSet == NULL)
+        return ERROR_INVALID_PARAMETER;
+    if ((Options & DNS_QUERY_WIRE_ONLY) != 0 && (Options & DNS_QUERY_NO_WIRE_QUERY) != 0)
+        return ERROR_INVALID_PARAMETER;
+
+    /* Only plain lookups of what Query_Main can resolve go through the cache */
+    if (Servers != NULL || Type != DNS_TYPE_A ||
+        (Options & (DNS_QUERY_BYPASS_CACHE | DNS_QUERY_WIRE_ONLY)) != 0)
+    {
+        return Query_Main(Name, Type, Options, Servers, QueryResultSet, Reserved);
+    }
+
+    *QueryResultSet = NULL;
+
+    RpcTryExcept
+    {
+        Status = R_ResolverQuery(NULL,
+                                 Name,
+                                 Type,
+                                 Options,
+                                 &dwRecords,
+                                 (DNS_RECORDW **)QueryResultSet);
+    }
+    RpcExcept(EXCEPTION_EXECUTE_HANDLER)
+    {
+        DPRINT("Resolver cache unavailable (%lx)\n", RpcExceptionCode());
+        Status = ERROR_NOT_READY;
+        Fallback = TRUE;
+    }
+    RpcEndExcept;
+
+    /* Resolve in process when the resolver service is not running */
+    if (Fallback || Status == ERROR_SERVICE_NOT_ACTIVE)
+    {
+        *QueryResultSet = NULL;
+        Status = Query_Main(Name, Type, Options, Servers, QueryResultSet, Reserved);
+    }
+
+    return Status;
+}
+
 DNS_STATUS WINAPI
 DnsQuery_UTF8(LPCSTR Name,
               WORD Type,
@@ -561,11 +561,12 @@ static GpStatus alpha_blend_pixels(GpGraphics *graphics, INT dst_x, INT dst_y,
 static inline ARGB blend_colors_premult(ARGB start, ARGB end, REAL position)
 {
     UINT pos = position * 255.0f + 0.5f;
-    return
-        (((((start >> 24)       ) << 8) + (((end >> 24)       ) - ((start >> 24)       )) * pos) >> 8) << 24 |
-        (((((start >> 16) & 0xff) << 8) + (((end >> 16) & 0xff) - ((start >> 16) & 0xff)) * pos) >> 8) << 16 |
-        (((((start >>  8) & 0xff) << 8) + (((end >>  8) & 0xff) - ((start >>  8) & 0xff)) * pos) >> 8) <<  8 |
-        (((((start      ) & 0xff) << 8) + (((end      ) & 0xff) - ((start      ) & 0xff)) * pos) >> 8);
+    UINT inv = 256 - pos;
+
+    /* Blue/red and green/alpha are interpolated two channels per multiply;
+     * no lane can exceed 255 * 256, so they never carry into each other. */
+    return ((((start & 0x00ff00ff) * inv + (end & 0x00ff00ff) * pos) >> 8) & 0x00ff00ff) |
+           ((((start >> 8) & 0x00ff00ff) * inv + ((end >> 8) & 0x00ff00ff) * pos) & 0xff00ff00);
 }
 
 static ARGB blend_colors(ARGB start, ARGB end, REAL position)
@@ -875,10 +876,16 @@ static void get_bitmap_sample_size(InterpolationMode interpolation, WrapMode wra
 
     switch (interpolation)
     {
-    case InterpolationModeHighQualityBilinear:
     case InterpolationModeHighQualityBicubic:
-    /* FIXME: Include a greater range for the prefilter? */
     case InterpolationModeBicubic:
+        /* The cubic kernel reads one more pixel on each side */
+        left = (INT)(floorf(srcx)) - 1;
+        top = (INT)(floorf(srcy)) - 1;
+        right = (INT)(ceilf(srcx+srcwidth)) + 1;
+        bottom = (INT)(ceilf(srcy+srcheight)) + 1;
+        break;
+    case InterpolationModeHighQualityBilinear:
+    /* FIXME: Include a greater range for the prefilter? */
     case InterpolationModeBilinear:
         left = (INT)(floorf(srcx));
         top = (INT)(floorf(srcy));
@@ -1053,72 +1060,215 @@ static ARGB resample_bitmap_pixel(GDIPCONST GpRect *src_rect, LPBYTE bits, UINT
     }
 }
 
-static ARGB resample_bitmap_pixel_premult(GDIPCONST GpRect *src_rect, LPBYTE bits, UINT width,
-    UINT height, GpPointF *point, GDIPCONST GpImageAttributes *attributes,
-    InterpolationMode interpolation, PixelOffsetMode offset_mode)
+/* State shared by the span resamplers used when drawing a transformed image.
+ * The source point of each destination pixel is found by stepping along the
+ * scanline instead of transforming every pixel, and the interpolation kernel
+ * is chosen once per draw instead of once per pixel. */
+struct resample_span
 {
-    static int fixme;
+    GDIPCONST GpRect *src_rect;
+    LPBYTE bits;
+    UINT width;
+    UINT height;
+    GDIPCONST GpImageAttributes *attributes;
+    BOOL premult;
+    REAL pixel_offset;
+    /* Source rectangle that may be sampled */
+    REAL srcx, srcy, srcwidth, srcheight;
+    /* Source point of destination (0, 0) and the steps for one pixel in x */
+    REAL origin_x, origin_y;
+    REAL x_dx, x_dy;
+    /* Source offset contributed by the current destination row */
+    REAL row_x, row_y;
+};
 
-    switch (interpolation)
+typedef void (*resample_span_func)(const struct resample_span *span, ARGB *dst,
+    INT count, REAL delta_xx, REAL delta_xy);
+
+/* Fetch a source pixel, taking the direct path when it lies in the locked area */
+static inline ARGB fetch_span_pixel(const struct resample_span *span, INT x, INT y)
+{
+    GDIPCONST GpRect *src_rect = span->src_rect;
+
+    if ((UINT)(x - src_rect->X) < (UINT)src_rect->Width &&
+        (UINT)(y - src_rect->Y) < (UINT)src_rect->Height)
+        return ((DWORD*)span->bits)[(x - src_rect->X) + (y - src_rect->Y) * src_rect->Width];
+
+    return sample_bitmap_pixel(src_rect, span->bits, span->width, span->height,
+        x, y, span->attributes);
+}
+
+static inline BOOL span_point_in_source(const struct resample_span *span, REAL x, REAL y)
+{
+    return x >= span->srcx && x < span->srcx + span->srcwidth &&
+           y >= span->srcy && y < span->srcy + span->srcheight;
+}
+
+static void resample_span_nearest(const struct resample_span *span, ARGB *dst,
+    INT count, REAL delta_xx, REAL delta_xy)
+{
+    REAL x, y;
+
+    for (; count > 0; count--, dst++)
     {
-    default:
-        if (!fixme++)
-            FIXME("Unimplemented interpolation %i\n", interpolation);
-        /* fall-through */
-    case InterpolationModeBilinear:
+        x = span->origin_x + delta_xx + span->row_x;
+        y = span->origin_y + delta_xy + span->row_y;
+
+        if (span_point_in_source(span, x, y))
+            *dst = fetch_span_pixel(span, floorf(x + span->pixel_offset),
+                floorf(y + span->pixel_offset));
+        else
+            *dst = 0;
+
+        delta_xx += span->x_dx;
+        delta_xy += span->x_dy;
+    }
+}
+
+static void resample_span_bilinear(const struct resample_span *span, ARGB *dst,
+    INT count, REAL delta_xx, REAL delta_xy)
+{
+    REAL x, y, x_offset, y_offset;
+    INT leftx, rightx, topy, bottomy;
+    ARGB topleft, topright, bottomleft, bottomright;
+
+    for (; count > 0; count--, dst++)
     {
-        REAL leftxf, topyf;
-        INT leftx, rightx, topy, bottomy;
-        ARGB topleft, topright, bottomleft, bottomright;
-        ARGB top, bottom;
-        float x_offset;
+        x = span->origin_x + delta_xx + span->row_x;
+        y = span->origin_y + delta_xy + span->row_y;
+        delta_xx += span->x_dx;
+        delta_xy += span->x_dy;
 
-        leftx = (INT)point->X;
-        leftxf = (REAL)leftx;
-        rightx = positive_ceilf(point->X);
-        topy = (INT)point->Y;
-        topyf = (REAL)topy;
-        bottomy = positive_ceilf(point->Y);
+        if (!span_point_in_source(span, x, y))
+        {
+            *dst = 0;
+            continue;
+        }
+
+        leftx = (INT)x;
+        rightx = positive_ceilf(x);
+        topy = (INT)y;
+        bottomy = positive_ceilf(y);
 
+        topleft = fetch_span_pixel(span, leftx, topy);
         if (leftx == rightx && topy == bottomy)
-            return sample_bitmap_pixel(src_rect, bits, width, height,
-                leftx, topy, attributes);
+        {
+            *dst = topleft;
+            continue;
+        }
 
-        topleft = sample_bitmap_pixel(src_rect, bits, width, height,
-            leftx, topy, attributes);
-        topright = sample_bitmap_pixel(src_rect, bits, width, height,
-            rightx, topy, attributes);
-        bottomleft = sample_bitmap_pixel(src_rect, bits, width, height,
-            leftx, bottomy, attributes);
-        bottomright = sample_bitmap_pixel(src_rect, bits, width, height,
-            rightx, bottomy, attributes);
+        topright = fetch_span_pixel(span, rightx, topy);
+        bottomleft = fetch_span_pixel(span, leftx, bottomy);
+        bottomright = fetch_span_pixel(span, rightx, bottomy);
 
-        x_offset = point->X - leftxf;
-        top = blend_colors_premult(topleft, topright, x_offset);
-        bottom = blend_colors_premult(bottomleft, bottomright, x_offset);
+        x_offset = x - (REAL)leftx;
+        y_offset = y - (REAL)topy;
 
-        return blend_colors_premult(top, bottom, point->Y - topyf);
+        if (span->premult)
+            *dst = blend_colors_premult(blend_colors_premult(topleft, topright, x_offset),
+                                        blend_colors_premult(bottomleft, bottomright, x_offset), y_offset);
+        else
+            *dst = blend_colors(blend_colors(topleft, topright, x_offset),
+                                blend_colors(bottomleft, bottomright, x_offset), y_offset);
     }
-    case InterpolationModeNearestNeighbor:
+}
+
+/* Cubic convolution weights (a = -0.5) for the four taps around t in [0, 1) */
+static inline void bicubic_weights(REAL t, REAL weights[4])
+{
+    REAL t2 = t * t, t3 = t2 * t;
+
+    weights[0] = -0.5f * t3 + t2 - 0.5f * t;
+    weights[1] = 1.5f * t3 - 2.5f * t2 + 1.0f;
+    weights[2] = -1.5f * t3 + 2.0f * t2 + 0.5f * t;
+    weights[3] = 0.5f * t3 - 0.5f * t2;
+}
+
+static inline INT clamp_tap(INT value, INT first, INT count)
+{
+    if (value < first) return first;
+    if (value >= first + count) return first + count - 1;
+    return value;
+}
+
+static void resample_span_bicubic(const struct resample_span *span, ARGB *dst,
+    INT count, REAL delta_xx, REAL delta_xy)
+{
+    GDIPCONST GpRect *src_rect = span->src_rect;
+    REAL x, y, wx[4], wy[4], w, sum[4];
+    INT ix, iy, tx[4], i, j, c, a, value;
+    ARGB pixel;
+
+    for (; count > 0; count--, dst++)
     {
-        FLOAT pixel_offset;
-        switch (offset_mode)
+        x = span->origin_x + delta_xx + span->row_x;
+        y = span->origin_y + delta_xy + span->row_y;
+        delta_xx += span->x_dx;
+        delta_xy += span->x_dy;
+
+        if (!span_point_in_source(span, x, y))
         {
-        default:
-        case PixelOffsetModeNone:
-        case PixelOffsetModeHighSpeed:
-            pixel_offset = 0.5;
-            break;
+            *dst = 0;
+            continue;
+        }
 
-        case PixelOffsetModeHalf:
-        case PixelOffsetModeHighQuality:
-            pixel_offset = 0.0;
-            break;
+        ix = floorf(x);
+        iy = floorf(y);
+        bicubic_weights(x - (REAL)ix, wx);
+        bicubic_weights(y - (REAL)iy, wy);
+
+        /* Taps outside the locked area repeat its edge pixels */
+        for (i = 0; i < 4; i++)
+            tx[i] = clamp_tap(ix - 1 + i, src_rect->X, src_rect->Width);
+
+        sum[0] = sum[1] = sum[2] = sum[3] = 0.0f;
+        for (j = 0; j < 4; j++)
+        {
+            INT ty = clamp_tap(iy - 1 + j, src_rect->Y, src_rect->Height);
+
+            for (i = 0; i < 4; i++)
+            {
+                pixel = fetch_span_pixel(span, tx[i], ty);
+                w = wx[i] * wy[j];
+                a = pixel >> 24;
+
+                /* Filter premultiplied values so transparent pixels don't bleed */
+                sum[3] += w * a;
+                if (span->premult)
+                {
+                    sum[2] += w * ((pixel >> 16) & 0xff);
+                    sum[1] += w * ((pixel >> 8) & 0xff);
+                    sum[0] += w * (pixel & 0xff);
+                }
+                else
+                {
+                    w *= a / 255.0f;
+                    sum[2] += w * ((pixel >> 16) & 0xff);
+                    sum[1] += w * ((pixel >> 8) & 0xff);
+                    sum[0] += w * (pixel & 0xff);
+                }
+            }
         }
-        return sample_bitmap_pixel(src_rect, bits, width, height,
-            floorf(point->X + pixel_offset), point->Y + pixel_offset, attributes);
-    }
 
+        a = gdip_round(sum[3]);
+        if (a <= 0)
+        {
+            *dst = 0;
+            continue;
+        }
+        if (a > 255) a = 255;
+
+        pixel = (ARGB)a << 24;
+        for (c = 0; c < 3; c++)
+        {
+            value = gdip_round(sum[c]);
+            if (value < 0) value = 0;
+            if (value > a) value = a;
+            if (!span->premult)
+                value = (value * 255 + a / 2) / a;
+            pixel |= (ARGB)value << (c * 8);
+        }
+        *dst = pixel;
     }
 }
 
@@ -3148,7 +3298,7 @@ GpStatus WINGDIPAPI GdipDrawImagePointsRect(GpGraphics *graphics, GpImage *image
             RECT dst_area;
             GpRectF graphics_bounds;
             GpRect src_area;
-            int i, x, y, src_stride, dst_stride;
+            int i, y, src_stride, dst_stride;
             GpMatrix dst_to_src;
             REAL m11, m12, m21, m22, mdx, mdy;
             LPBYTE src_data, dst_data, dst_dyn_data=NULL;
@@ -3247,7 +3397,10 @@ GpStatus WINGDIPAPI GdipDrawImagePointsRect(GpGraphics *graphics, GpImage *image
 
             if (do_resampling)
             {
-                REAL delta_xx, delta_xy, delta_yx, delta_yy;
+                REAL delta_yx, delta_yy;
+                struct resample_span span;
+                resample_span_func resample;
+                static int fixme;
 
                 /* Transform the bits as needed to the destination. */
                 dst_data = dst_dyn_data = heap_alloc_zero(sizeof(ARGB) * (dst_area.right - dst_area.left) * (dst_area.bottom - dst_area.top));
@@ -3266,41 +3419,55 @@ GpStatus WINGDIPAPI GdipDrawImagePointsRect(GpGraphics *graphics, GpImage *image
                 y_dx = dst_to_src_points[2].X - dst_to_src_points[0].X;
                 y_dy = dst_to_src_points[2].Y - dst_to_src_points[0].Y;
 
+                switch (interpolation)
+                {
+                default:
+                    if (!fixme++)
+                        FIXME("Unimplemented interpolation %i\n", interpolation);
+                    /* fall-through */
+                case InterpolationModeBilinear:
+                case InterpolationModeHighQualityBilinear:
+                    resample = resample_span_bilinear;
+                    break;
+                case InterpolationModeBicubic:
+                case InterpolationModeHighQualityBicubic:
+                    resample = resample_span_bicubic;
+                    break;
+                case InterpolationModeNearestNeighbor:
+                    resample = resample_span_nearest;
+                    break;
+                }
+
+                span.src_rect = &src_area;
+                span.bits = src_data;
+                span.width = bitmap->width;
+                span.height = bitmap->height;
+                span.attributes = imageAttributes;
+                span.premult = (lockeddata.PixelFormat == PixelFormat32bppPARGB);
+                span.pixel_offset = (offset_mode == PixelOffsetModeHalf ||
+                                     offset_mode == PixelOffsetModeHighQuality) ? 0.0f : 0.5f;
+                span.srcx = srcx;
+                span.srcy = srcy;
+                span.srcwidth = srcwidth;
+                span.srcheight = srcheight;
+                span.origin_x = dst_to_src_points[0].X;
+                span.origin_y = dst_to_src_points[0].Y;
+                span.x_dx = x_dx;
+                span.x_dy = x_dy;
+
                 delta_yy = dst_area.top * y_dy;
                 delta_yx = dst_area.top * y_dx;
 
                 for (y=dst_area.top; y<dst_area.bottom; y++)
                 {
-                    delta_xx = dst_area.left * x_dx;
-                    delta_xy = dst_area.left * x_dy;
-
-                    for (x=dst_area.left; x<dst_area.right; x++)
-                    {
-                        GpPointF src_pointf;
-                        ARGB *dst_color;
+                    span.row_x = delta_yx;
+                    span.row_y = delta_yy;
 
-                        src_pointf.X = dst_to_src_points[0].X + delta_xx + delta_yx;
-                        src_pointf.Y = dst_to_src_points[0].Y + delta_xy + delta_yy;
-
-                        dst_color = (ARGB*)(dst_data + dst_stride * (y - dst_area.top) + sizeof(ARGB) * (x - dst_area.left));
-
-                        if (src_pointf.X >= srcx && src_pointf.X < srcx + srcwidth && src_pointf.Y >= srcy && src_pointf.Y < srcy+srcheight)
-                        {
-                            if (lockeddata.PixelFormat != PixelFormat32bppPARGB)
-                                *dst_color = resample_bitmap_pixel(&src_area, src_data, bitmap->width, bitmap->height, &src_pointf,
-                                                                   imageAttributes, interpolation, offset_mode);
-                            else
-                                *dst_color = resample_bitmap_pixel_premult(&src_area, src_data, bitmap->width, bitmap->height, &src_pointf,
-                                                                           imageAttributes, interpolation, offset_mode);
-                        }
-                        else
-                            *dst_color = 0;
-
-                        delta_xx += x_dx;
-                        delta_yx += y_dx;
-                    }
+                    resample(&span, (ARGB*)(dst_data + dst_stride * (y - dst_area.top)),
+                        dst_area.right - dst_area.left,
+                        dst_area.left * x_dx, dst_area.left * x_dy);
 
-                    delta_xy += x_dy;
+                    delta_yx += y_dx;
                     delta_yy += y_dy;
                 }
             }
@@ -19,9 +19,159 @@
 DEBUG_CHANNEL(kernel32file);
 #endif
 
+/* Number of buffers kept in flight and the bounds of their size */
+#define COPY_BUFFER_COUNT       4
+#define COPY_MIN_CHUNK_SIZE     0x10000
+#define COPY_MAX_CHUNK_SIZE     0x100000
+/* Don't call the progress routine more often than this, in milliseconds */
+#define COPY_PROGRESS_INTERVAL  100
+
+typedef struct _COPY_BUFFER
+{
+    PUCHAR Data;
+    HANDLE Event;
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Offset;
+    NTSTATUS Status;
+    ULONG Length;
+    BOOL Busy;
+    BOOL Writing;
+} COPY_BUFFER, *PCOPY_BUFFER;
+
 /* FUNCTIONS ****************************************************************/
 
 
+static NTSTATUS
+CopyWait(PCOPY_BUFFER Buffer)
+{
+    if (!Buffer->Busy)
+        return Buffer->Status;
+
+    if (Buffer->Status == STATUS_PENDING)
+    {
+        NtWaitForSingleObject(Buffer->Event, FALSE, NULL);
+        Buffer->Status = Buffer->IoStatusBlock.Status;
+    }
+
+    Buffer->Busy = FALSE;
+    return Buffer->Status;
+}
+
+static VOID
+CopyStartRead(HANDLE FileHandleSource,
+              PCOPY_BUFFER Buffer,
+              ULONG ChunkSize,
+              PLARGE_INTEGER ReadOffset)
+{
+    Buffer->Offset.QuadPart = ReadOffset->QuadPart;
+    Buffer->Writing = FALSE;
+    Buffer->Busy = TRUE;
+    Buffer->Status = NtReadFile(FileHandleSource,
+                                Buffer->Event,
+                                NULL,
+                                NULL,
+                                &Buffer->IoStatusBlock,
+                                Buffer->Data,
+                                ChunkSize,
+                                &Buffer->Offset,
+                                NULL);
+    ReadOffset->QuadPart += ChunkSize;
+}
+
+/*
+ * Picks the size of each buffer from the cluster size of both volumes, and
+ * the alignment unbuffered I/O needs from their sector size.
+ */
+static ULONG
+CopyChunkSize(HANDLE FileHandleSource,
+              HANDLE FileHandleDest,
+              LARGE_INTEGER SourceFileSize,
+              PULONG SectorSize)
+{
+    FILE_FS_SIZE_INFORMATION FileFsSize;
+    IO_STATUS_BLOCK IoStatusBlock;
+    HANDLE Handles[2] = { FileHandleSource, FileHandleDest };
+    ULONG ClusterSize = 0, ChunkSize, i;
+
+    *SectorSize = 512;
+
+    for (i = 0; i < 2; i++)
+    {
+        if (NT_SUCCESS(NtQueryVolumeInformationFile(Handles[i],
+                                                    &IoStatusBlock,
+                                                    &FileFsSize,
+                                                    sizeof(FileFsSize),
+                                                    FileFsSizeInformation)) &&
+            FileFsSize.BytesPerSector != 0 &&
+            (FileFsSize.BytesPerSector & (FileFsSize.BytesPerSector - 1)) == 0)
+        {
+            *SectorSize = max(*SectorSize, FileFsSize.BytesPerSector);
+            ClusterSize = max(ClusterSize, FileFsSize.BytesPerSector * FileFsSize.SectorsPerAllocationUnit);
+        }
+    }
+
+    ClusterSize = max(ClusterSize, *SectorSize);
+    ChunkSize = min(max(16 * ClusterSize, COPY_MIN_CHUNK_SIZE), COPY_MAX_CHUNK_SIZE);
+    ChunkSize = ROUND_UP(ChunkSize, ClusterSize);
+
+    /* Small files don't need big buffers */
+    if (SourceFileSize.QuadPart < ChunkSize)
+    {
+        ChunkSize = (ULONG)ROUND_UP(max(SourceFileSize.QuadPart, 1), *SectorSize);
+    }
+
+    return ChunkSize;
+}
+
+static NTSTATUS
+CopyProgress(LPPROGRESS_ROUTINE *lpProgressRoutine,
+             LARGE_INTEGER SourceFileSize,
+             LARGE_INTEGER BytesCopied,
+             DWORD CallbackReason,
+             HANDLE FileHandleSource,
+             HANDLE FileHandleDest,
+             LPVOID lpData,
+             BOOL *KeepDest)
+{
+    DWORD ProgressResult;
+
+    if (NULL == *lpProgressRoutine)
+        return STATUS_SUCCESS;
+
+    ProgressResult = (**lpProgressRoutine)(SourceFileSize,
+                                           BytesCopied,
+                                           SourceFileSize,
+                                           BytesCopied,
+                                           0,
+                                           CallbackReason,
+                                           FileHandleSource,
+                                           FileHandleDest,
+                                           lpData);
+    switch (ProgressResult)
+    {
+    case PROGRESS_CANCEL:
+        TRACE("Progress callback requested cancel\n");
+        return STATUS_REQUEST_ABORTED;
+    case PROGRESS_STOP:
+        TRACE("Progress callback requested stop\n");
+        *KeepDest = TRUE;
+        return STATUS_REQUEST_ABORTED;
+    case PROGRESS_QUIET:
+        *lpProgressRoutine = NULL;
+        break;
+    case PROGRESS_CONTINUE:
+    default:
+        break;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+/*
+ * Copies the data with COPY_BUFFER_COUNT overlapped buffers: while one
+ * buffer is written out the others are already being read, so the source
+ * and the destination are kept busy at the same time.
+ */
 static NTSTATUS
 CopyLoop (
     HANDLE			FileHandleSource,
@@ -30,135 +180,244 @@ CopyLoop (
     LPPROGRESS_ROUTINE	lpProgressRoutine,
     LPVOID			lpData,
     BOOL			*pbCancel,
+    BOOL                 NoBuffering,
     BOOL                 *KeepDest
 )
 {
     NTSTATUS errCode;
     IO_STATUS_BLOCK IoStatusBlock;
+    COPY_BUFFER Buffers[COPY_BUFFER_COUNT];
+    PCOPY_BUFFER Buffer, Previous;
     UCHAR *lpBuffer = NULL;
-    SIZE_T RegionSize = 0x10000;
-    LARGE_INTEGER BytesCopied;
-    DWORD CallbackReason;
-    DWORD ProgressResult;
+    SIZE_T RegionSize;
+    LARGE_INTEGER BytesCopied, ReadOffset;
+    FILE_ALLOCATION_INFORMATION FileAllocation;
+    FILE_END_OF_FILE_INFORMATION FileEndOfFile;
+    ULONG ChunkSize, SectorSize, BufferCount, Current, i;
+    DWORD LastProgress;
     BOOL EndOfFileFound;
 
     *KeepDest = FALSE;
+    BytesCopied.QuadPart = 0;
+
+    errCode = CopyProgress(&lpProgressRoutine,
+                           SourceFileSize,
+                           BytesCopied,
+                           CALLBACK_STREAM_SWITCH,
+                           FileHandleSource,
+                           FileHandleDest,
+                           lpData,
+                           KeepDest);
+    if (!NT_SUCCESS(errCode))
+    {
+        return errCode;
+    }
+
+    /* Reserve the space up front: fail early and keep the file contiguous */
+    if (SourceFileSize.QuadPart != 0)
+    {
+        FileAllocation.AllocationSize.QuadPart = SourceFileSize.QuadPart;
+        errCode = NtSetInformationFile(FileHandleDest,
+                                       &IoStatusBlock,
+                                       &FileAllocation,
+                                       sizeof(FILE_ALLOCATION_INFORMATION),
+                                       FileAllocationInformation);
+        if (errCode == STATUS_DISK_FULL)
+        {
+            WARN("Not enough space for 0x%I64x bytes\n", SourceFileSize.QuadPart);
+            return errCode;
+        }
+    }
+
+    ChunkSize = CopyChunkSize(FileHandleSource, FileHandleDest, SourceFileSize, &SectorSize);
+    BufferCount = (ULONG)min((SourceFileSize.QuadPart + ChunkSize - 1) / ChunkSize + 1, COPY_BUFFER_COUNT);
+
+    RegionSize = (SIZE_T)ChunkSize * BufferCount;
     errCode = NtAllocateVirtualMemory(NtCurrentProcess(),
                                       (PVOID *)&lpBuffer,
                                       0,
                                       &RegionSize,
                                       MEM_RESERVE | MEM_COMMIT,
                                       PAGE_READWRITE);
+    if (!NT_SUCCESS(errCode))
+    {
+        TRACE("Error 0x%08x allocating buffer of %lu bytes\n", errCode, RegionSize);
+        return errCode;
+    }
 
-    if (NT_SUCCESS(errCode))
+    RtlZeroMemory(Buffers, sizeof(Buffers));
+    for (i = 0; i < BufferCount; i++)
     {
-        BytesCopied.QuadPart = 0;
-        EndOfFileFound = FALSE;
-        CallbackReason = CALLBACK_STREAM_SWITCH;
-        while (! EndOfFileFound &&
-                NT_SUCCESS(errCode) &&
-                (NULL == pbCancel || ! *pbCancel))
+        Buffers[i].Data = lpBuffer + i * ChunkSize;
+        errCode = NtCreateEvent(&Buffers[i].Event, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE);
+        if (!NT_SUCCESS(errCode))
         {
-            if (NULL != lpProgressRoutine)
-            {
-                ProgressResult = (*lpProgressRoutine)(SourceFileSize,
-                                                      BytesCopied,
-                                                      SourceFileSize,
-                                                      BytesCopied,
-                                                      0,
-                                                      CallbackReason,
-                                                      FileHandleSource,
-                                                      FileHandleDest,
-                                                      lpData);
-                switch (ProgressResult)
-                {
-                case PROGRESS_CANCEL:
-                    TRACE("Progress callback requested cancel\n");
-                    errCode = STATUS_REQUEST_ABORTED;
-                    break;
-                case PROGRESS_STOP:
-                    TRACE("Progress callback requested stop\n");
-                    errCode = STATUS_REQUEST_ABORTED;
-                    *KeepDest = TRUE;
-                    break;
-                case PROGRESS_QUIET:
-                    lpProgressRoutine = NULL;
-                    break;
-                case PROGRESS_CONTINUE:
-                default:
-                    break;
-                }
-                CallbackReason = CALLBACK_CHUNK_FINISHED;
-            }
-            if (NT_SUCCESS(errCode))
-            {
-                errCode = NtReadFile(FileHandleSource,
-                                     NULL,
-                                     NULL,
+            TRACE("Error 0x%08x creating event\n", errCode);
+            break;
+        }
+    }
+
+    /* Get all the buffers reading */
+    ReadOffset.QuadPart = 0;
+    for (i = 0; NT_SUCCESS(errCode) && i < BufferCount; i++)
+    {
+        CopyStartRead(FileHandleSource, &Buffers[i], ChunkSize, &ReadOffset);
+    }
+
+    EndOfFileFound = FALSE;
+    LastProgress = GetTickCount();
+    Current = 0;
+    while (!EndOfFileFound &&
+           NT_SUCCESS(errCode) &&
+           (NULL == pbCancel || ! *pbCancel))
+    {
+        /* Buffers are written back in the order they were read */
+        Buffer = &Buffers[Current];
+        errCode = CopyWait(Buffer);
+
+        /* With a read at a given offset, EOF comes either as an error or as 0 bytes */
+        if (errCode == STATUS_END_OF_FILE ||
+            (NT_SUCCESS(errCode) && Buffer->IoStatusBlock.Information == 0))
+        {
+            EndOfFileFound = TRUE;
+            errCode = STATUS_SUCCESS;
+            break;
+        }
+        if (!NT_SUCCESS(errCode))
+        {
+            WARN("Error 0x%08x reading from source\n", errCode);
+            break;
+        }
+
+        /* A short read is the tail of the file */
+        Buffer->Length = (ULONG)Buffer->IoStatusBlock.Information;
+        if (Buffer->Length < ChunkSize)
+        {
+            EndOfFileFound = TRUE;
+        }
+
+        Buffer->Writing = TRUE;
+        Buffer->Busy = TRUE;
+        Buffer->Status = NtWriteFile(FileHandleDest,
+                                     Buffer->Event,
                                      NULL,
-                                     (PIO_STATUS_BLOCK)&IoStatusBlock,
-                                     lpBuffer,
-                                     RegionSize,
                                      NULL,
+                                     &Buffer->IoStatusBlock,
+                                     Buffer->Data,
+                                     NoBuffering ? ROUND_UP(Buffer->Length, SectorSize) : Buffer->Length,
+                                     &Buffer->Offset,
                                      NULL);
-                /* With sync read, 0 length + status success mean EOF:
-                 * https://msdn.microsoft.com/en-us/library/windows/desktop/aa365467(v=vs.85).aspx
-                 */
-                if (NT_SUCCESS(errCode) && IoStatusBlock.Information == 0)
-                {
-                    errCode = STATUS_END_OF_FILE;
-                }
-                if (NT_SUCCESS(errCode) && (NULL == pbCancel || ! *pbCancel))
-                {
-                    errCode = NtWriteFile(FileHandleDest,
-                                          NULL,
-                                          NULL,
-                                          NULL,
-                                          (PIO_STATUS_BLOCK)&IoStatusBlock,
-                                          lpBuffer,
-                                          IoStatusBlock.Information,
-                                          NULL,
-                                          NULL);
-                    if (NT_SUCCESS(errCode))
-                    {
-                        BytesCopied.QuadPart += IoStatusBlock.Information;
-                    }
-                    else
-                    {
-                        WARN("Error 0x%08x reading writing to dest\n", errCode);
-                    }
-                }
-                else if (!NT_SUCCESS(errCode))
-                {
-                    if (STATUS_END_OF_FILE == errCode)
-                    {
-                        EndOfFileFound = TRUE;
-                        errCode = STATUS_SUCCESS;
-                    }
-                    else
-                    {
-                        WARN("Error 0x%08x reading from source\n", errCode);
-                    }
-                }
+        if (!NT_SUCCESS(Buffer->Status))
+        {
+            Buffer->Busy = FALSE;
+            errCode = Buffer->Status;
+            WARN("Error 0x%08x writing to dest\n", errCode);
+            break;
+        }
+
+        /* Once the write before this one is done, its buffer can read ahead */
+        Previous = &Buffers[(Current + BufferCount - 1) % BufferCount];
+        if (Previous->Busy && Previous->Writing)
+        {
+            errCode = CopyWait(Previous);
+            if (!NT_SUCCESS(errCode))
+            {
+                WARN("Error 0x%08x writing to dest\n", errCode);
+                break;
+            }
+            BytesCopied.QuadPart += Previous->Length;
+
+            if (!EndOfFileFound)
+            {
+                CopyStartRead(FileHandleSource, Previous, ChunkSize, &ReadOffset);
+            }
+
+            if (NULL != lpProgressRoutine && GetTickCount() - LastProgress >= COPY_PROGRESS_INTERVAL)
+            {
+                LastProgress = GetTickCount();
+                errCode = CopyProgress(&lpProgressRoutine,
+                                       SourceFileSize,
+                                       BytesCopied,
+                                       CALLBACK_CHUNK_FINISHED,
+                                       FileHandleSource,
+                                       FileHandleDest,
+                                       lpData,
+                                       KeepDest);
             }
         }
 
-        if (! EndOfFileFound && (NULL != pbCancel && *pbCancel))
+        Current = (Current + 1) % BufferCount;
+    }
+
+    /* Let everything still in flight finish before the buffers go away */
+    for (i = 0; i < BufferCount; i++)
+    {
+        if (!Buffers[i].Busy)
+            continue;
+
+        if (Buffers[i].Writing)
         {
-            TRACE("User requested cancel\n");
-            errCode = STATUS_REQUEST_ABORTED;
+            if (NT_SUCCESS(CopyWait(&Buffers[i])))
+            {
+                BytesCopied.QuadPart += Buffers[i].Length;
+            }
+            else if (NT_SUCCESS(errCode))
+            {
+                errCode = Buffers[i].Status;
+                WARN("Error 0x%08x writing to dest\n", errCode);
+            }
         }
+        else
+        {
+            CopyWait(&Buffers[i]);
+        }
+    }
 
-        NtFreeVirtualMemory(NtCurrentProcess(),
-                            (PVOID *)&lpBuffer,
-                            &RegionSize,
-                            MEM_RELEASE);
+    if (! EndOfFileFound && NT_SUCCESS(errCode) && (NULL != pbCancel && *pbCancel))
+    {
+        TRACE("User requested cancel\n");
+        errCode = STATUS_REQUEST_ABORTED;
     }
-    else
+
+    /* Drop the padding of the last unbuffered write and unused preallocation */
+    if (NT_SUCCESS(errCode))
     {
-        TRACE("Error 0x%08x allocating buffer of %lu bytes\n", errCode, RegionSize);
+        FileEndOfFile.EndOfFile.QuadPart = BytesCopied.QuadPart;
+        errCode = NtSetInformationFile(FileHandleDest,
+                                       &IoStatusBlock,
+                                       &FileEndOfFile,
+                                       sizeof(FILE_END_OF_FILE_INFORMATION),
+                                       FileEndOfFileInformation);
+        if (!NT_SUCCESS(errCode))
+        {
+            WARN("Error 0x%08x setting the size of dest\n", errCode);
+        }
     }
 
+    if (NT_SUCCESS(errCode))
+    {
+        errCode = CopyProgress(&lpProgressRoutine,
+                               SourceFileSize,
+                               BytesCopied,
+                               CALLBACK_CHUNK_FINISHED,
+                               FileHandleSource,
+                               FileHandleDest,
+                               lpData,
+                               KeepDest);
+    }
+
+    for (i = 0; i < BufferCount; i++)
+    {
+        if (Buffers[i].Event != NULL)
+            NtClose(Buffers[i].Event);
+    }
+
+    RegionSize = 0;
+    NtFreeVirtualMemory(NtCurrentProcess(),
+                        (PVOID *)&lpBuffer,
+                        &RegionSize,
+                        MEM_RELEASE);
+
     return errCode;
 }
 
@@ -223,7 +482,8 @@ BasepCopyFileExW(IN LPCWSTR lpExistingFileName,
                                    FILE_SHARE_READ | FILE_SHARE_WRITE,
                                    NULL,
                                    OPEN_EXISTING,
-                                   FILE_ATTRIBUTE_NORMAL|FILE_FLAG_NO_BUFFERING,
+                                   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN |
+                                   ((dwCopyFlags & COPY_FILE_NO_BUFFERING) ? FILE_FLAG_NO_BUFFERING : 0),
                                    NULL);
     if (INVALID_HANDLE_VALUE != FileHandleSource)
     {
@@ -254,8 +514,9 @@ BasepCopyFileExW(IN LPCWSTR lpExistingFileName,
                                              GENERIC_WRITE,
                                              FILE_SHARE_WRITE,
                                              NULL,
-                                             dwCopyFlags ? CREATE_NEW : CREATE_ALWAYS,
-                                             FileBasic.FileAttributes,
+                                             (dwCopyFlags & COPY_FILE_FAIL_IF_EXISTS) ? CREATE_NEW : CREATE_ALWAYS,
+                                             FileBasic.FileAttributes | FILE_FLAG_OVERLAPPED |
+                                             ((dwCopyFlags & COPY_FILE_NO_BUFFERING) ? FILE_FLAG_NO_BUFFERING : 0),
                                              NULL);
                 if (INVALID_HANDLE_VALUE != FileHandleDest)
                 {
@@ -265,6 +526,7 @@ BasepCopyFileExW(IN LPCWSTR lpExistingFileName,
                                        lpProgressRoutine,
                                        lpData,
                                        pbCancel,
+                                       (dwCopyFlags & COPY_FILE_NO_BUFFERING) != 0,
                                        &KeepDestOnError);
                     if (!NT_SUCCESS(errCode))
                     {
@@ -178,6 +178,9 @@ RPC_STATUS RPCRT4_OpenBinding(RpcBinding* Binding, RpcConnection** Connection,
 RPC_STATUS RPCRT4_CloseBinding(RpcBinding* Binding, RpcConnection* Connection) DECLSPEC_HIDDEN;
 
 void rpcrt4_conn_release_and_wait(RpcConnection *connection) DECLSPEC_HIDDEN;
+#ifdef __REACTOS__
+RpcConnection *rpcrt4_spawn_connection(RpcConnection *old_connection) DECLSPEC_HIDDEN;
+#endif
 
 static inline const char *rpcrt4_conn_get_name(const RpcConnection *Connection)
 {
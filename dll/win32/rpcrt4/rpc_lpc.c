@@ -0,0 +1,1397 @@
+/*
+ * PROJECT:     ReactOS RPC runtime
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     ncalrpc transport over LPC ports
+ *
+ * Every client connects to the port \RPC Control\<endpoint> and maps a section
+ * shared with the server: the first half carries client to server data, the
+ * second half the other direction. Chunks that fit into a port message travel
+ * inline as datagrams, bigger ones go through the section and are acknowledged
+ * by the receiver before the sender reuses its half.
+ *
+ * The last fragment of a call is sent as a request that the server answers
+ * with the start of the response. This keeps the client blocked in the kernel
+ * for the duration of the call, which is what NtImpersonateClientOfPort needs.
+ *
+ * All client messages arrive on the listening port and are collected by one
+ * thread per endpoint, which hands connections with a complete message to a
+ * small completion port thread pool instead of running a thread per client.
+ * The pool threads never wait for a client: reads only take what is queued,
+ * and section data sent to a client is acknowledged with a datagram that the
+ * server waits for with a timeout.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#define WIN32_NO_STATUS
+#define _INC_WINDOWS
+#define COM_NO_WINDOWS_H
+#include <windef.h>
+#include <winbase.h>
+#include <winnls.h>
+#define NTOS_MODE_USER
+#include <ndk/lpcfuncs.h>
+#include <ndk/mmfuncs.h>
+#include <ndk/obfuncs.h>
+#include <ndk/rtlfuncs.h>
+
+#include "rpc.h"
+#include "rpcndr.h"
+
+#include "wine/debug.h"
+
+#include "rpc_binding.h"
+#include "rpc_message.h"
+#include "rpc_server.h"
+#include "rpc_lpc.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(rpc);
+
+/* set by the kernel on messages it generates */
+#define LPC_KERNELMODE_MESSAGE    0x8000
+
+/* one half of the shared section */
+#define RPC_LPC_HALF_SIZE         0x2000
+#define RPC_LPC_SECTION_SIZE      (2 * RPC_LPC_HALF_SIZE)
+/* section requests are acknowledged late once this much data is queued */
+#define RPC_LPC_ACK_THRESHOLD     0x10000
+/* a connection queueing more than this is dropped, a whole message has to fit */
+#define RPC_LPC_MAX_QUEUED        0x1000000
+/* how often a waiting client checks that the server is still there, in ms */
+#define RPC_LPC_PROBE_INTERVAL    5000
+/* how long the server waits for a client to take section data, in ms */
+#define RPC_LPC_SEND_TIMEOUT      30000
+/* the port context of a connection is its slot in the low bits and a
+ * sequence number above them */
+#define RPC_LPC_SLOT_BITS         16
+#define RPC_LPC_MAX_SLOTS         (1 << RPC_LPC_SLOT_BITS)
+
+/* message flags */
+#define RPC_LPC_SECTION           0x1 /* data is in the sender's half of the section */
+#define RPC_LPC_CALL              0x2 /* last fragment of a call, answered with the response */
+#define RPC_LPC_PROBE             0x4 /* liveness check, carries no data */
+#define RPC_LPC_ACK               0x8 /* the client has copied the server's section data */
+
+#define RPC_LPC_INLINE_SIZE       (PORT_MAXIMUM_MESSAGE_LENGTH - sizeof(PORT_MESSAGE) - 2 * sizeof(ULONG))
+
+typedef struct _RPC_LPC_MESSAGE
+{
+    PORT_MESSAGE Header;
+    ULONG Flags;
+    ULONG Length;
+    UCHAR Data[RPC_LPC_INLINE_SIZE];
+} RPC_LPC_MESSAGE;
+
+#define RPC_LPC_HEADER_SIZE       (FIELD_OFFSET(RPC_LPC_MESSAGE, Data) - sizeof(PORT_MESSAGE))
+
+C_ASSERT(sizeof(RPC_LPC_MESSAGE) <= PORT_MAXIMUM_MESSAGE_LENGTH);
+C_ASSERT(RPC_LPC_HALF_SIZE >= RPC_MAX_PACKET_SIZE);
+C_ASSERT(RPC_LPC_ACK_THRESHOLD >= 0xffff);
+
+typedef struct _RpcConnection_lpc
+{
+    RpcConnection common;
+    HANDLE port;
+    UCHAR *view;                /* the shared section */
+    SIZE_T view_size;
+    HANDLE client_pid;          /* server only */
+    ULONG_PTR cookie;           /* port context once accepted, 0 otherwise */
+
+    /* listeners only */
+    HANDLE listen_thread;
+    LONG stop_tid;              /* thread that wakes the listen thread to stop it */
+
+    /* received data not read yet and the state of the other side, CS cs */
+    CRITICAL_SECTION cs;
+    HANDLE ack_event;           /* set on send_acked or disconnected */
+    UCHAR *data;
+    ULONG data_size;
+    ULONG data_start;
+    ULONG data_end;
+    ULONG data_scanned;         /* fragments after data_start known not to end a message */
+    PORT_MESSAGE call;          /* held last fragment of a call */
+    PORT_MESSAGE ack;           /* section request waiting for the reader to catch up */
+    BOOL call_pending;
+    BOOL ack_pending;
+    BOOL send_acked;            /* the client took our last section data */
+    BOOL armed;                 /* idle, queued to the pool when a message is complete */
+    BOOL disconnected;
+    BOOL read_closed;
+    BOOL closed;
+} RpcConnection_lpc;
+
+typedef struct _RpcServerProtseq_lpc
+{
+    RpcServerProtseq common;
+    HANDLE mgr_event;
+} RpcServerProtseq_lpc;
+
+/**** dispatch pool ****/
+
+static CRITICAL_SECTION lpc_pool_cs;
+static CRITICAL_SECTION_DEBUG lpc_pool_cs_debug =
+{
+    0, 0, &lpc_pool_cs,
+    { &lpc_pool_cs_debug.ProcessLocksList, &lpc_pool_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": lpc_pool_cs") }
+};
+static CRITICAL_SECTION lpc_pool_cs = { &lpc_pool_cs_debug, -1, 0, 0, 0, 0 };
+
+/* accepted connections by slot, for the listen threads to find their messages' target */
+static RpcConnection_lpc **lpc_slots;   /* CS lpc_connections_cs */
+static ULONG lpc_slot_count;            /* CS lpc_connections_cs */
+static ULONG lpc_slot_seq;              /* CS lpc_connections_cs */
+
+static CRITICAL_SECTION lpc_connections_cs;
+static CRITICAL_SECTION_DEBUG lpc_connections_cs_debug =
+{
+    0, 0, &lpc_connections_cs,
+    { &lpc_connections_cs_debug.ProcessLocksList, &lpc_connections_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": lpc_connections_cs") }
+};
+static CRITICAL_SECTION lpc_connections_cs = { &lpc_connections_cs_debug, -1, 0, 0, 0, 0 };
+
+static HANDLE lpc_pool_port;    /* CS lpc_pool_cs */
+static LONG lpc_pool_threads;   /* CS lpc_pool_cs */
+static LONG lpc_pool_idle;
+
+/* whether the queued data holds a whole message, up to a fragment with
+ * RPC_FLG_LAST; a bad fragment length is left for the reader to reject */
+static BOOL rpcrt4_lpc_message_ready(RpcConnection_lpc *lpc)
+{
+    const RpcPktCommonHdr *hdr;
+    ULONG avail;
+
+    for (;;)
+    {
+        avail = lpc->data_end - lpc->data_start - lpc->data_scanned;
+        if (avail < sizeof(*hdr))
+            return FALSE;
+
+        hdr = (const RpcPktCommonHdr *)(lpc->data + lpc->data_start + lpc->data_scanned);
+        if (hdr->frag_len < sizeof(*hdr))
+            return TRUE;
+        if (avail < hdr->frag_len)
+            return FALSE;
+        if (hdr->flags & RPC_FLG_LAST)
+            return TRUE;
+
+        lpc->data_scanned += hdr->frag_len;
+    }
+}
+
+/* takes an armed connection off the listen thread once the pool has to
+ * look at it, CS lpc->cs */
+static BOOL rpcrt4_lpc_disarm(RpcConnection_lpc *lpc)
+{
+    if (!lpc->armed || (!lpc->disconnected && !rpcrt4_lpc_message_ready(lpc)))
+        return FALSE;
+
+    lpc->armed = FALSE;
+    return TRUE;
+}
+
+static NTSTATUS rpcrt4_lpc_reply(RpcConnection_lpc *lpc, const PORT_MESSAGE *request, const void *data, ULONG size);
+
+/* handles the messages of a connection until it runs out of complete ones */
+static void rpcrt4_lpc_process(RpcConnection_lpc *lpc)
+{
+    PORT_MESSAGE ack;
+    BOOL armed, send_ack;
+
+    do
+    {
+        if (RPCRT4_process_incoming_packet(&lpc->common) != RPC_S_OK)
+        {
+            RPCRT4_ReleaseConnection(&lpc->common);
+            return;
+        }
+
+        EnterCriticalSection(&lpc->cs);
+        armed = !lpc->read_closed && !lpc->disconnected && !rpcrt4_lpc_message_ready(lpc);
+        lpc->armed = armed;
+
+        /* nothing is read before the rest of the message is there, so stop
+         * holding the client back */
+        send_ack = armed && lpc->ack_pending;
+        if (send_ack)
+        {
+            ack = lpc->ack;
+            lpc->ack_pending = FALSE;
+        }
+        LeaveCriticalSection(&lpc->cs);
+
+        if (send_ack)
+            rpcrt4_lpc_reply(lpc, &ack, NULL, 0);
+    } while (!armed);
+}
+
+static DWORD CALLBACK rpcrt4_lpc_pool_thread(LPVOID arg)
+{
+    LPOVERLAPPED overlapped;
+    ULONG_PTR key;
+    DWORD bytes;
+    BOOL ret;
+
+    for (;;)
+    {
+        InterlockedIncrement(&lpc_pool_idle);
+        ret = GetQueuedCompletionStatus(lpc_pool_port, &bytes, &key, &overlapped, INFINITE);
+        InterlockedDecrement(&lpc_pool_idle);
+        if (!ret)
+        {
+            ERR("GetQueuedCompletionStatus failed with error %u\n", GetLastError());
+            break;
+        }
+        rpcrt4_lpc_process((RpcConnection_lpc *)key);
+    }
+
+    EnterCriticalSection(&lpc_pool_cs);
+    lpc_pool_threads--;
+    LeaveCriticalSection(&lpc_pool_cs);
+    return 0;
+}
+
+static LONG rpcrt4_lpc_pool_max_threads(void)
+{
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return max(4, 2 * (LONG)info.dwNumberOfProcessors);
+}
+
+/* hands a connection and its reference to the pool */
+static void rpcrt4_lpc_pool_queue(RpcConnection_lpc *lpc)
+{
+    HANDLE thread;
+    BOOL ret = FALSE;
+
+    EnterCriticalSection(&lpc_pool_cs);
+    if (!lpc_pool_port)
+        lpc_pool_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    if (lpc_pool_port)
+    {
+        if (!lpc_pool_idle && lpc_pool_threads < rpcrt4_lpc_pool_max_threads())
+        {
+            thread = CreateThread(NULL, 0, rpcrt4_lpc_pool_thread, NULL, 0, NULL);
+            if (thread)
+            {
+                lpc_pool_threads++;
+                CloseHandle(thread);
+            }
+        }
+        if (lpc_pool_threads)
+            ret = PostQueuedCompletionStatus(lpc_pool_port, 0, (ULONG_PTR)lpc, NULL);
+    }
+    LeaveCriticalSection(&lpc_pool_cs);
+
+    if (!ret)
+    {
+        WARN("couldn't queue connection %p to the pool, error %u\n", lpc, GetLastError());
+        RPCRT4_new_client(&lpc->common);
+    }
+}
+
+/**** messages ****/
+
+static void rpcrt4_lpc_init_message(RPC_LPC_MESSAGE *msg, ULONG flags, ULONG length, ULONG inline_size)
+{
+    RtlZeroMemory(&msg->Header, sizeof(msg->Header));
+    msg->Header.u1.s1.DataLength = (CSHORT)(RPC_LPC_HEADER_SIZE + inline_size);
+    msg->Header.u1.s1.TotalLength = (CSHORT)(sizeof(PORT_MESSAGE) + RPC_LPC_HEADER_SIZE + inline_size);
+    msg->Flags = flags;
+    msg->Length = length;
+}
+
+static UCHAR *rpcrt4_lpc_send_half(const RpcConnection_lpc *lpc)
+{
+    return lpc->view + (lpc->common.server ? RPC_LPC_HALF_SIZE : 0);
+}
+
+static UCHAR *rpcrt4_lpc_receive_half(const RpcConnection_lpc *lpc)
+{
+    return lpc->view + (lpc->common.server ? 0 : RPC_LPC_HALF_SIZE);
+}
+
+/* sends up to RPC_LPC_HALF_SIZE bytes as a single message */
+static NTSTATUS rpcrt4_lpc_send(RpcConnection_lpc *lpc, ULONG flags, const void *data, ULONG size,
+                                RPC_LPC_MESSAGE *reply)
+{
+    RPC_LPC_MESSAGE msg;
+    ULONG inline_size = 0;
+
+    if (size > RPC_LPC_INLINE_SIZE)
+    {
+        memcpy(rpcrt4_lpc_send_half(lpc), data, size);
+        flags |= RPC_LPC_SECTION;
+    }
+    else
+    {
+        memcpy(msg.Data, data, size);
+        inline_size = size;
+    }
+    rpcrt4_lpc_init_message(&msg, flags, size, inline_size);
+
+    /* the sender's half can only be reused once the receiver has copied it,
+     * the server waits for that outside the kernel in rpcrt4_lpc_server_send */
+    if (!lpc->common.server && (flags & (RPC_LPC_SECTION | RPC_LPC_CALL)))
+        return NtRequestWaitReplyPort(lpc->port, &msg.Header, &reply->Header);
+    return NtRequestPort(lpc->port, &msg.Header);
+}
+
+static NTSTATUS rpcrt4_lpc_reply(RpcConnection_lpc *lpc, const PORT_MESSAGE *request, const void *data, ULONG size)
+{
+    RPC_LPC_MESSAGE msg;
+
+    if (size)
+        memcpy(msg.Data, data, size);
+    rpcrt4_lpc_init_message(&msg, 0, size, size);
+    msg.Header.ClientId = request->ClientId;
+    msg.Header.MessageId = request->MessageId;
+    return NtReplyPort(lpc->port, &msg.Header);
+}
+
+static BOOL rpcrt4_lpc_append(RpcConnection_lpc *lpc, const void *data, ULONG size)
+{
+    ULONG avail = lpc->data_end - lpc->data_start;
+    ULONG new_size;
+    UCHAR *new_data;
+
+    if (avail + size > RPC_LPC_MAX_QUEUED)
+        return FALSE;
+
+    if (lpc->data_size - lpc->data_end < size)
+    {
+        if (lpc->data_start)
+        {
+            memmove(lpc->data, lpc->data + lpc->data_start, avail);
+            lpc->data_start = 0;
+            lpc->data_end = avail;
+        }
+        if (lpc->data_size - avail < size)
+        {
+            new_size = max(lpc->data_size * 2, RPC_LPC_HALF_SIZE);
+            while (new_size - avail < size)
+                new_size *= 2;
+            if (lpc->data)
+                new_data = HeapReAlloc(GetProcessHeap(), 0, lpc->data, new_size);
+            else
+                new_data = HeapAlloc(GetProcessHeap(), 0, new_size);
+            if (!new_data)
+                return FALSE;
+            lpc->data = new_data;
+            lpc->data_size = new_size;
+        }
+    }
+
+    memcpy(lpc->data + lpc->data_end, data, size);
+    lpc->data_end += size;
+    return TRUE;
+}
+
+static void rpcrt4_lpc_take(RpcConnection_lpc *lpc, void *buffer, ULONG count)
+{
+    memcpy(buffer, lpc->data + lpc->data_start, count);
+    lpc->data_start += count;
+    lpc->data_scanned = 0;
+    if (lpc->data_start == lpc->data_end)
+        lpc->data_start = lpc->data_end = 0;
+}
+
+/* queues the payload of a received message, checking it against the message
+ * and section sizes since the other side isn't trusted */
+static BOOL rpcrt4_lpc_queue_payload(RpcConnection_lpc *lpc, const RPC_LPC_MESSAGE *msg)
+{
+    const void *data;
+
+    if (msg->Header.u1.s1.DataLength < RPC_LPC_HEADER_SIZE)
+        return FALSE;
+
+    if (msg->Flags & RPC_LPC_SECTION)
+    {
+        if (!lpc->view || msg->Length > RPC_LPC_HALF_SIZE)
+            return FALSE;
+        data = rpcrt4_lpc_receive_half(lpc);
+    }
+    else
+    {
+        if (msg->Length > msg->Header.u1.s1.DataLength - RPC_LPC_HEADER_SIZE)
+            return FALSE;
+        data = msg->Data;
+    }
+
+    return !msg->Length || rpcrt4_lpc_append(lpc, data, msg->Length);
+}
+
+static WCHAR *ncalrpc_port_name(const char *endpoint)
+{
+    static const WCHAR prefix[] = L"\\RPC Control\\";
+    WCHAR *port_name;
+    int len;
+
+    len = MultiByteToWideChar(CP_ACP, 0, endpoint, -1, NULL, 0);
+    port_name = HeapAlloc(GetProcessHeap(), 0, sizeof(prefix) + len * sizeof(WCHAR));
+    if (!port_name)
+        return NULL;
+
+    memcpy(port_name, prefix, sizeof(prefix));
+    MultiByteToWideChar(CP_ACP, 0, endpoint, -1, port_name + sizeof(prefix) / sizeof(WCHAR) - 1, len);
+    return port_name;
+}
+
+static void rpcrt4_lpc_init_qos(const RpcConnection *conn, SECURITY_QUALITY_OF_SERVICE *qos)
+{
+    qos->Length = sizeof(*qos);
+    qos->ImpersonationLevel = SecurityImpersonation;
+    qos->ContextTrackingMode = SECURITY_DYNAMIC_TRACKING;
+    qos->EffectiveOnly = FALSE;
+
+    if (conn && conn->QOS)
+    {
+        switch (conn->QOS->qos->ImpersonationType)
+        {
+        case RPC_C_IMP_LEVEL_ANONYMOUS:
+            qos->ImpersonationLevel = SecurityAnonymous;
+            break;
+        case RPC_C_IMP_LEVEL_IDENTIFY:
+            qos->ImpersonationLevel = SecurityIdentification;
+            break;
+        case RPC_C_IMP_LEVEL_DELEGATE:
+            qos->ImpersonationLevel = SecurityDelegation;
+            break;
+        }
+        if (conn->QOS->qos->IdentityTracking != RPC_C_QOS_IDENTITY_DYNAMIC)
+            qos->ContextTrackingMode = SECURITY_STATIC_TRACKING;
+    }
+}
+
+/* connects without a section, which the listener always refuses */
+static NTSTATUS rpcrt4_lpc_probe_port(const char *endpoint)
+{
+    SECURITY_QUALITY_OF_SERVICE qos;
+    UNICODE_STRING name;
+    WCHAR *port_name;
+    HANDLE port;
+    NTSTATUS status;
+
+    port_name = ncalrpc_port_name(endpoint);
+    if (!port_name)
+        return STATUS_NO_MEMORY;
+
+    rpcrt4_lpc_init_qos(NULL, &qos);
+    RtlInitUnicodeString(&name, port_name);
+    status = NtConnectPort(&port, &name, &qos, NULL, NULL, NULL, NULL, NULL);
+    if (NT_SUCCESS(status))
+        NtClose(port);
+
+    HeapFree(GetProcessHeap(), 0, port_name);
+    return status;
+}
+
+/**** client side ****/
+
+/* waits for data from the server and queues it; -1 once the server is gone */
+static int rpcrt4_lpc_client_receive(RpcConnection_lpc *lpc)
+{
+    RPC_LPC_MESSAGE msg, ack;
+    LARGE_INTEGER timeout;
+    NTSTATUS status;
+    USHORT type;
+    BOOL ret;
+
+    timeout.QuadPart = -(LONGLONG)RPC_LPC_PROBE_INTERVAL * 10000;
+
+    for (;;)
+    {
+        status = NtReplyWaitReceivePortEx(lpc->port, NULL, NULL, &msg.Header, &timeout);
+        if (status == STATUS_TIMEOUT)
+        {
+            /* closing the server port doesn't wake us up, so check on it now and then */
+            rpcrt4_lpc_init_message(&msg, RPC_LPC_PROBE, 0, 0);
+            status = NtRequestPort(lpc->port, &msg.Header);
+            if (!NT_SUCCESS(status))
+            {
+                WARN("server is gone, status 0x%08x\n", status);
+                return -1;
+            }
+            continue;
+        }
+        if (!NT_SUCCESS(status))
+        {
+            WARN("NtReplyWaitReceivePortEx failed with status 0x%08x\n", status);
+            return -1;
+        }
+
+        type = msg.Header.u2.s2.Type & ~LPC_KERNELMODE_MESSAGE;
+        if (type == LPC_PORT_CLOSED || type == LPC_CLIENT_DIED)
+            return -1;
+        if (type == LPC_DATAGRAM)
+            break;
+    }
+
+    EnterCriticalSection(&lpc->cs);
+    ret = rpcrt4_lpc_queue_payload(lpc, &msg);
+    LeaveCriticalSection(&lpc->cs);
+
+    /* let the server reuse its half */
+    if (ret && (msg.Flags & RPC_LPC_SECTION))
+    {
+        rpcrt4_lpc_init_message(&ack, RPC_LPC_ACK, 0, 0);
+        NtRequestPort(lpc->port, &ack.Header);
+    }
+
+    if (!ret)
+    {
+        WARN("bad message from the server\n");
+        return -1;
+    }
+    return 0;
+}
+
+static NTSTATUS rpcrt4_lpc_client_send(RpcConnection_lpc *lpc, ULONG flags, const void *data, ULONG size)
+{
+    RPC_LPC_MESSAGE reply;
+    NTSTATUS status;
+    BOOL ret;
+
+    status = rpcrt4_lpc_send(lpc, flags, data, size, &reply);
+    if (!NT_SUCCESS(status) || !(flags & RPC_LPC_CALL))
+        return status;
+
+    /* the server answers a call with the start of the response */
+    EnterCriticalSection(&lpc->cs);
+    ret = rpcrt4_lpc_queue_payload(lpc, &reply);
+    LeaveCriticalSection(&lpc->cs);
+
+    return ret ? STATUS_SUCCESS : STATUS_INVALID_PARAMETER;
+}
+
+/* whether the server will answer this packet */
+static BOOL rpcrt4_lpc_is_call(const RpcConnection *conn, const void *buffer, unsigned int count)
+{
+    const RpcPktCommonHdr *hdr = buffer;
+
+    /* asynchronous calls collect the response from another thread */
+    if (conn->async_state || count < sizeof(*hdr) || !(hdr->flags & RPC_FLG_LAST))
+        return FALSE;
+
+    return hdr->ptype == PKT_REQUEST || hdr->ptype == PKT_BIND || hdr->ptype == PKT_ALTER_CONTEXT;
+}
+
+RPC_STATUS rpcrt4_conn_lpc_open(RpcConnection *Connection)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)Connection;
+    SECURITY_QUALITY_OF_SERVICE qos;
+    LARGE_INTEGER size;
+    UNICODE_STRING name;
+    PORT_VIEW view;
+    WCHAR *port_name;
+    ULONG max_length = 0;
+    HANDLE section;
+    NTSTATUS status;
+
+    /* already connected? */
+    if (lpc->port)
+        return RPC_S_OK;
+
+    port_name = ncalrpc_port_name(Connection->Endpoint);
+    if (!port_name)
+        return RPC_S_OUT_OF_RESOURCES;
+
+    size.QuadPart = RPC_LPC_SECTION_SIZE;
+    status = NtCreateSection(&section, SECTION_ALL_ACCESS, NULL, &size, PAGE_READWRITE, SEC_COMMIT, NULL);
+    if (!NT_SUCCESS(status))
+    {
+        WARN("NtCreateSection failed with status 0x%08x\n", status);
+        HeapFree(GetProcessHeap(), 0, port_name);
+        return RPC_S_OUT_OF_RESOURCES;
+    }
+
+    view.Length = sizeof(view);
+    view.SectionHandle = section;
+    view.SectionOffset = 0;
+    view.ViewSize = RPC_LPC_SECTION_SIZE;
+    view.ViewBase = NULL;
+    view.ViewRemoteBase = NULL;
+
+    TRACE("connecting to %s\n", debugstr_w(port_name));
+    rpcrt4_lpc_init_qos(Connection, &qos);
+    RtlInitUnicodeString(&name, port_name);
+    status = NtConnectPort(&lpc->port, &name, &qos, &view, NULL, &max_length, NULL, NULL);
+
+    /* the port keeps the section mapped */
+    NtClose(section);
+    HeapFree(GetProcessHeap(), 0, port_name);
+
+    if (!NT_SUCCESS(status))
+    {
+        WARN("NtConnectPort failed with status 0x%08x\n", status);
+        lpc->port = NULL;
+        return RPC_S_SERVER_UNAVAILABLE;
+    }
+    if (max_length < sizeof(RPC_LPC_MESSAGE))
+    {
+        ERR("port messages too small: %u\n", max_length);
+        NtClose(lpc->port);
+        lpc->port = NULL;
+        return RPC_S_SERVER_UNAVAILABLE;
+    }
+
+    lpc->view = view.ViewBase;
+    lpc->view_size = view.ViewSize;
+    return RPC_S_OK;
+}
+
+RPC_STATUS rpcrt4_conn_lpc_is_server_listening(const char *endpoint)
+{
+    NTSTATUS status = rpcrt4_lpc_probe_port(endpoint);
+
+    if (NT_SUCCESS(status) || status == STATUS_PORT_CONNECTION_REFUSED)
+        return RPC_S_OK;
+    return RPC_S_NOT_LISTENING;
+}
+
+int rpcrt4_conn_lpc_wait_for_incoming_data(RpcConnection *conn)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+    BOOL avail;
+
+    for (;;)
+    {
+        EnterCriticalSection(&lpc->cs);
+        avail = lpc->data_end != lpc->data_start;
+        LeaveCriticalSection(&lpc->cs);
+
+        if (avail)
+            return 0;
+        if (rpcrt4_lpc_client_receive(lpc) == -1)
+            return -1;
+    }
+}
+
+void rpcrt4_conn_lpc_cancel_call(RpcConnection *conn)
+{
+    /* LPC waits can't be interrupted from another thread, a waiting client
+     * finds out about a dead server with its next probe */
+    TRACE("(%p)\n", conn);
+}
+
+/**** server side ****/
+
+static int rpcrt4_lpc_server_read(RpcConnection_lpc *lpc, void *buffer, unsigned int count)
+{
+    PORT_MESSAGE ack;
+    BOOL send_ack = FALSE;
+
+    /* connections only reach the pool with a whole message queued, anything
+     * short of that is a bad message */
+    EnterCriticalSection(&lpc->cs);
+    if (lpc->read_closed || lpc->data_end - lpc->data_start < count)
+    {
+        LeaveCriticalSection(&lpc->cs);
+        return -1;
+    }
+
+    rpcrt4_lpc_take(lpc, buffer, count);
+    if (lpc->ack_pending && lpc->data_end - lpc->data_start <= RPC_LPC_ACK_THRESHOLD)
+    {
+        ack = lpc->ack;
+        lpc->ack_pending = FALSE;
+        send_ack = TRUE;
+    }
+    LeaveCriticalSection(&lpc->cs);
+
+    if (send_ack)
+        rpcrt4_lpc_reply(lpc, &ack, NULL, 0);
+    return count;
+}
+
+static NTSTATUS rpcrt4_lpc_server_send(RpcConnection_lpc *lpc, const void *data, ULONG size)
+{
+    PORT_MESSAGE call;
+    BOOL call_pending, acked, queue = FALSE;
+    DWORD start, elapsed;
+    NTSTATUS status;
+
+    EnterCriticalSection(&lpc->cs);
+    if (lpc->disconnected)
+    {
+        LeaveCriticalSection(&lpc->cs);
+        return STATUS_PORT_DISCONNECTED;
+    }
+    call_pending = lpc->call_pending;
+    call = lpc->call;
+    lpc->call_pending = FALSE;
+    lpc->send_acked = FALSE;
+    LeaveCriticalSection(&lpc->cs);
+
+    if (call_pending)
+    {
+        /* release the waiting client, handing it as much as fits */
+        if (size <= RPC_LPC_INLINE_SIZE)
+            return rpcrt4_lpc_reply(lpc, &call, data, size);
+
+        status = rpcrt4_lpc_reply(lpc, &call, NULL, 0);
+        if (!NT_SUCCESS(status))
+            return status;
+    }
+
+    status = rpcrt4_lpc_send(lpc, 0, data, size, NULL);
+    if (!NT_SUCCESS(status) || size <= RPC_LPC_INLINE_SIZE)
+        return status;
+
+    /* section data is acknowledged with a datagram, a client that stops
+     * reading must not keep this thread forever */
+    start = GetTickCount();
+    EnterCriticalSection(&lpc->cs);
+    while (!lpc->send_acked && !lpc->disconnected && !lpc->read_closed)
+    {
+        elapsed = GetTickCount() - start;
+        if (elapsed >= RPC_LPC_SEND_TIMEOUT)
+            break;
+
+        LeaveCriticalSection(&lpc->cs);
+        WaitForSingleObject(lpc->ack_event, RPC_LPC_SEND_TIMEOUT - elapsed);
+        EnterCriticalSection(&lpc->cs);
+    }
+    acked = lpc->send_acked;
+    if (!acked && !lpc->disconnected)
+    {
+        /* our half may still be in use, don't send anything else */
+        WARN("client of connection %p didn't take its data\n", lpc);
+        lpc->disconnected = TRUE;
+        queue = rpcrt4_lpc_disarm(lpc);
+    }
+    LeaveCriticalSection(&lpc->cs);
+
+    if (queue)
+        rpcrt4_lpc_pool_queue(lpc);
+    return acked ? STATUS_SUCCESS : STATUS_IO_TIMEOUT;
+}
+
+/* hands a message from the listening port to its connection */
+static void rpcrt4_lpc_dispatch(RpcConnection_lpc *lpc, RPC_LPC_MESSAGE *msg, USHORT type)
+{
+    BOOL ack = FALSE, queue;
+
+    EnterCriticalSection(&lpc->cs);
+    switch (type)
+    {
+    case LPC_DATAGRAM:
+    case LPC_REQUEST:
+        if (msg->Flags & RPC_LPC_PROBE)
+        {
+            ack = (type == LPC_REQUEST);
+            break;
+        }
+        if (msg->Flags & RPC_LPC_ACK)
+        {
+            lpc->send_acked = TRUE;
+            SetEvent(lpc->ack_event);
+            ack = (type == LPC_REQUEST);
+            break;
+        }
+        if (!rpcrt4_lpc_queue_payload(lpc, msg))
+        {
+            WARN("dropping connection %p after a bad message\n", lpc);
+            lpc->disconnected = TRUE;
+            SetEvent(lpc->ack_event);
+            ack = (type == LPC_REQUEST);
+            break;
+        }
+        if (type != LPC_REQUEST)
+            break;
+
+        if (msg->Flags & RPC_LPC_CALL)
+        {
+            lpc->call = msg->Header;
+            lpc->call_pending = TRUE;
+        }
+        else if (!lpc->armed && lpc->data_end - lpc->data_start > RPC_LPC_ACK_THRESHOLD)
+        {
+            /* keep the client waiting until the reader catches up */
+            lpc->ack = msg->Header;
+            lpc->ack_pending = TRUE;
+        }
+        else
+            ack = TRUE;
+        break;
+
+    case LPC_PORT_CLOSED:
+    case LPC_CLIENT_DIED:
+        TRACE("client of connection %p is gone\n", lpc);
+        lpc->disconnected = TRUE;
+        SetEvent(lpc->ack_event);
+        break;
+
+    default:
+        WARN("unexpected message type %u\n", type);
+        break;
+    }
+
+    queue = rpcrt4_lpc_disarm(lpc);
+    LeaveCriticalSection(&lpc->cs);
+
+    if (ack)
+        rpcrt4_lpc_reply(lpc, &msg->Header, NULL, 0);
+    if (queue)
+        rpcrt4_lpc_pool_queue(lpc);
+}
+
+/* gives a connection a slot and the cookie it is found by */
+static BOOL rpcrt4_lpc_add_connection(RpcConnection_lpc *lpc)
+{
+    RpcConnection_lpc **new_slots;
+    ULONG slot, new_count;
+
+    EnterCriticalSection(&lpc_connections_cs);
+    for (slot = 0; slot < lpc_slot_count; slot++)
+    {
+        if (!lpc_slots[slot])
+            break;
+    }
+    if (slot == lpc_slot_count)
+    {
+        new_count = min(max(lpc_slot_count * 2, 16), RPC_LPC_MAX_SLOTS);
+        if (slot == new_count)
+        {
+            LeaveCriticalSection(&lpc_connections_cs);
+            return FALSE;
+        }
+        if (lpc_slots)
+            new_slots = HeapReAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, lpc_slots, new_count * sizeof(*lpc_slots));
+        else
+            new_slots = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, new_count * sizeof(*lpc_slots));
+        if (!new_slots)
+        {
+            LeaveCriticalSection(&lpc_connections_cs);
+            return FALSE;
+        }
+        lpc_slots = new_slots;
+        lpc_slot_count = new_count;
+    }
+
+    /* a message still queued for the previous owner of the slot doesn't match */
+    do
+        lpc_slot_seq++;
+    while (!((ULONG_PTR)lpc_slot_seq << RPC_LPC_SLOT_BITS));
+
+    lpc->cookie = ((ULONG_PTR)lpc_slot_seq << RPC_LPC_SLOT_BITS) | slot;
+    lpc_slots[slot] = lpc;
+    LeaveCriticalSection(&lpc_connections_cs);
+    return TRUE;
+}
+
+/* waits for the listen thread to be done with the connection */
+static void rpcrt4_lpc_remove_connection(RpcConnection_lpc *lpc)
+{
+    EnterCriticalSection(&lpc_connections_cs);
+    lpc_slots[lpc->cookie & (RPC_LPC_MAX_SLOTS - 1)] = NULL;
+    LeaveCriticalSection(&lpc_connections_cs);
+    lpc->cookie = 0;
+}
+
+/* CS lpc_connections_cs */
+static RpcConnection_lpc *rpcrt4_lpc_find_connection(ULONG_PTR cookie)
+{
+    ULONG slot = cookie & (RPC_LPC_MAX_SLOTS - 1);
+
+    if (slot >= lpc_slot_count || !lpc_slots[slot] || lpc_slots[slot]->cookie != cookie)
+        return NULL;
+    return lpc_slots[slot];
+}
+
+static void rpcrt4_lpc_reject(PORT_MESSAGE *request)
+{
+    HANDLE port;
+
+    NtAcceptConnectPort(&port, NULL, request, FALSE, NULL, NULL);
+}
+
+typedef struct _RpcLpcAccept
+{
+    RpcConnection_lpc *listener;
+    RPC_LPC_MESSAGE request;
+} RpcLpcAccept;
+
+/* runs on a worker thread since creating the connection takes the protseq
+ * lock, which is held while the listen thread is being stopped */
+static DWORD CALLBACK rpcrt4_lpc_accept_proc(LPVOID arg)
+{
+    RpcLpcAccept *accept = arg;
+    REMOTE_PORT_VIEW client_view;
+    RpcConnection_lpc *lpc;
+    NTSTATUS status;
+    BOOL queue;
+
+    lpc = (RpcConnection_lpc *)rpcrt4_spawn_connection(&accept->listener->common);
+    if (lpc && accept->listener->stop_tid)
+    {
+        /* the server stopped listening before the connection was added */
+        RPCRT4_ReleaseConnection(&lpc->common);
+        lpc = NULL;
+    }
+    if (lpc && !rpcrt4_lpc_add_connection(lpc))
+    {
+        RPCRT4_ReleaseConnection(&lpc->common);
+        lpc = NULL;
+    }
+    if (!lpc)
+    {
+        rpcrt4_lpc_reject(&accept->request.Header);
+        HeapFree(GetProcessHeap(), 0, accept);
+        return 0;
+    }
+
+    /* no messages arrive before NtCompleteConnectPort */
+    client_view.Length = sizeof(client_view);
+    client_view.ViewSize = 0;
+    client_view.ViewBase = NULL;
+    status = NtAcceptConnectPort(&lpc->port, (PVOID)lpc->cookie, &accept->request.Header, TRUE, NULL, &client_view);
+    if (!NT_SUCCESS(status))
+    {
+        WARN("NtAcceptConnectPort failed with status 0x%08x\n", status);
+        lpc->port = NULL;
+        RPCRT4_ReleaseConnection(&lpc->common);
+        HeapFree(GetProcessHeap(), 0, accept);
+        return 0;
+    }
+
+    lpc->view = client_view.ViewBase;
+    lpc->view_size = client_view.ViewSize;
+    lpc->client_pid = accept->request.Header.ClientId.UniqueProcess;
+    HeapFree(GetProcessHeap(), 0, accept);
+
+    status = NtCompleteConnectPort(lpc->port);
+    if (!NT_SUCCESS(status))
+    {
+        WARN("NtCompleteConnectPort failed with status 0x%08x\n", status);
+        RPCRT4_ReleaseConnection(&lpc->common);
+        return 0;
+    }
+
+    /* our reference now belongs to the pool, which gets the connection once
+     * a message is complete */
+    EnterCriticalSection(&lpc->cs);
+    lpc->armed = !lpc->read_closed && !lpc->disconnected && !rpcrt4_lpc_message_ready(lpc);
+    queue = !lpc->armed;
+    LeaveCriticalSection(&lpc->cs);
+
+    if (queue)
+        rpcrt4_lpc_pool_queue(lpc);
+    return 0;
+}
+
+static void rpcrt4_lpc_accept(RpcConnection_lpc *listener, RPC_LPC_MESSAGE *request)
+{
+    RpcLpcAccept *accept;
+
+    /* connections without a section only check that we are listening */
+    if (request->Header.ClientViewSize < RPC_LPC_SECTION_SIZE)
+    {
+        rpcrt4_lpc_reject(&request->Header);
+        return;
+    }
+
+    accept = HeapAlloc(GetProcessHeap(), 0, sizeof(*accept));
+    if (!accept)
+    {
+        rpcrt4_lpc_reject(&request->Header);
+        return;
+    }
+    accept->listener = listener;
+    accept->request = *request;
+
+    if (!QueueUserWorkItem(rpcrt4_lpc_accept_proc, accept, 0))
+    {
+        ERR("couldn't queue work item, error %u\n", GetLastError());
+        rpcrt4_lpc_reject(&request->Header);
+        HeapFree(GetProcessHeap(), 0, accept);
+    }
+}
+
+static DWORD CALLBACK rpcrt4_lpc_listen_thread(LPVOID arg)
+{
+    RpcConnection_lpc *listener = arg;
+    RpcConnection_lpc *lpc;
+    RPC_LPC_MESSAGE msg;
+    void *context;
+    NTSTATUS status;
+    USHORT type;
+
+    TRACE("(%p)\n", listener);
+
+    for (;;)
+    {
+        context = NULL;
+        status = NtReplyWaitReceivePort(listener->port, &context, NULL, &msg.Header);
+        if (!NT_SUCCESS(status))
+        {
+            ERR("NtReplyWaitReceivePort failed with status 0x%08x\n", status);
+            break;
+        }
+
+        type = msg.Header.u2.s2.Type & ~LPC_KERNELMODE_MESSAGE;
+        if (type == LPC_CONNECTION_REQUEST)
+        {
+            if (!listener->stop_tid)
+            {
+                rpcrt4_lpc_accept(listener, &msg);
+                continue;
+            }
+            rpcrt4_lpc_reject(&msg.Header);
+            if (HandleToUlong(msg.Header.ClientId.UniqueThread) == (ULONG)listener->stop_tid)
+                break;
+            continue;
+        }
+
+        /* the context may belong to a connection that is gone, closing a
+         * connection waits for us to leave the lock */
+        EnterCriticalSection(&lpc_connections_cs);
+        lpc = rpcrt4_lpc_find_connection((ULONG_PTR)context);
+        if (lpc && lpc->client_pid == msg.Header.ClientId.UniqueProcess)
+            rpcrt4_lpc_dispatch(lpc, &msg, type);
+        LeaveCriticalSection(&lpc_connections_cs);
+    }
+
+    TRACE("listener %p stopped\n", listener);
+    return 0;
+}
+
+static void rpcrt4_lpc_init_port_sd(SECURITY_DESCRIPTOR *sd, ACL *acl, ULONG acl_size)
+{
+    static SID everyone = { SID_REVISION, 1, { SECURITY_WORLD_SID_AUTHORITY }, { SECURITY_WORLD_RID } };
+
+    /* anyone may connect, access checks are up to the server */
+    RtlCreateSecurityDescriptor(sd, SECURITY_DESCRIPTOR_REVISION);
+    RtlCreateAcl(acl, acl_size, ACL_REVISION);
+    RtlAddAccessAllowedAce(acl, ACL_REVISION, PORT_CONNECT, &everyone);
+    RtlSetDaclSecurityDescriptor(sd, TRUE, acl, FALSE);
+}
+
+static RPC_STATUS rpcrt4_lpc_listen(RpcConnection_lpc *listener)
+{
+    OBJECT_ATTRIBUTES attr;
+    SECURITY_DESCRIPTOR sd;
+    ULONG acl[16];
+    UNICODE_STRING name;
+    WCHAR *port_name;
+    NTSTATUS status;
+
+    port_name = ncalrpc_port_name(listener->common.Endpoint);
+    if (!port_name)
+        return RPC_S_OUT_OF_RESOURCES;
+
+    TRACE("listening on %s\n", debugstr_w(port_name));
+    rpcrt4_lpc_init_port_sd(&sd, (ACL *)acl, sizeof(acl));
+    RtlInitUnicodeString(&name, port_name);
+    InitializeObjectAttributes(&attr, &name, OBJ_CASE_INSENSITIVE, NULL, &sd);
+    status = NtCreatePort(&listener->port, &attr, 0, PORT_MAXIMUM_MESSAGE_LENGTH, 0);
+    HeapFree(GetProcessHeap(), 0, port_name);
+    if (!NT_SUCCESS(status))
+    {
+        WARN("NtCreatePort failed with status 0x%08x\n", status);
+        listener->port = NULL;
+        if (status == STATUS_OBJECT_NAME_COLLISION)
+            return RPC_S_DUPLICATE_ENDPOINT;
+        return RPC_S_CANT_CREATE_ENDPOINT;
+    }
+
+    listener->stop_tid = 0;
+    listener->listen_thread = CreateThread(NULL, 0, rpcrt4_lpc_listen_thread, listener, 0, NULL);
+    if (!listener->listen_thread)
+    {
+        ERR("failed to create thread, error %u\n", GetLastError());
+        NtClose(listener->port);
+        listener->port = NULL;
+        return RPC_S_OUT_OF_RESOURCES;
+    }
+    return RPC_S_OK;
+}
+
+static void rpcrt4_lpc_stop_listening(RpcConnection_lpc *listener)
+{
+    InterlockedExchange(&listener->stop_tid, GetCurrentThreadId());
+
+    /* wake the listen thread with a connection request it recognizes */
+    if (WaitForSingleObject(listener->listen_thread, 0) == WAIT_TIMEOUT &&
+        rpcrt4_lpc_probe_port(listener->common.Endpoint) == STATUS_NO_MEMORY)
+    {
+        ERR("couldn't stop the listen thread of %p\n", listener);
+    }
+    else
+    {
+        WaitForSingleObject(listener->listen_thread, INFINITE);
+    }
+
+    CloseHandle(listener->listen_thread);
+    listener->listen_thread = NULL;
+}
+
+/**** connection ops ****/
+
+RpcConnection *rpcrt4_conn_lpc_alloc(void)
+{
+    RpcConnection_lpc *lpc;
+
+    lpc = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(RpcConnection_lpc));
+    if (!lpc)
+        return NULL;
+
+    lpc->ack_event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    InitializeCriticalSection(&lpc->cs);
+    lpc->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": RpcConnection_lpc.cs");
+    return &lpc->common;
+}
+
+RPC_STATUS rpcrt4_conn_lpc_handoff(RpcConnection *old_conn, RpcConnection *new_conn)
+{
+    DWORD len = MAX_COMPUTERNAME_LENGTH + 1;
+
+    TRACE("%s\n", old_conn->Endpoint);
+
+    /* Store the local computer name as the NetworkAddr for ncalrpc. */
+    new_conn->NetworkAddr = HeapAlloc(GetProcessHeap(), 0, len);
+    if (!GetComputerNameA(new_conn->NetworkAddr, &len))
+    {
+        ERR("Failed to retrieve the computer name, error %u\n", GetLastError());
+        return RPC_S_OUT_OF_RESOURCES;
+    }
+
+    return RPC_S_OK;
+}
+
+int rpcrt4_conn_lpc_read(RpcConnection *conn, void *buffer, unsigned int count)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+    BOOL done;
+
+    if (conn->server)
+        return rpcrt4_lpc_server_read(lpc, buffer, count);
+
+    for (;;)
+    {
+        EnterCriticalSection(&lpc->cs);
+        done = lpc->data_end - lpc->data_start >= count;
+        if (done)
+            rpcrt4_lpc_take(lpc, buffer, count);
+        LeaveCriticalSection(&lpc->cs);
+
+        if (done)
+            return count;
+        if (rpcrt4_lpc_client_receive(lpc) == -1)
+            return -1;
+    }
+}
+
+int rpcrt4_conn_lpc_write(RpcConnection *conn, const void *buffer, unsigned int count)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+    const UCHAR *data = buffer;
+    unsigned int left = count;
+    ULONG call_flag = 0, size;
+    NTSTATUS status;
+
+    if (!lpc->port)
+        return -1;
+
+    if (!conn->server && rpcrt4_lpc_is_call(conn, buffer, count))
+        call_flag = RPC_LPC_CALL;
+
+    while (left)
+    {
+        size = min(left, RPC_LPC_HALF_SIZE);
+        if (conn->server)
+            status = rpcrt4_lpc_server_send(lpc, data, size);
+        else
+            status = rpcrt4_lpc_client_send(lpc, size == left ? call_flag : 0, data, size);
+        if (!NT_SUCCESS(status))
+        {
+            WARN("send failed with status 0x%08x\n", status);
+            return -1;
+        }
+        data += size;
+        left -= size;
+    }
+
+    return count;
+}
+
+int rpcrt4_conn_lpc_close(RpcConnection *conn)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+
+    if (lpc->listen_thread)
+        rpcrt4_lpc_stop_listening(lpc);
+    else if (lpc->cookie)
+        rpcrt4_lpc_remove_connection(lpc);
+
+    if (lpc->port)
+    {
+        NtClose(lpc->port);
+        lpc->port = NULL;
+    }
+
+    /* listeners are closed again after being restarted */
+    if (!lpc->closed)
+    {
+        lpc->closed = TRUE;
+        HeapFree(GetProcessHeap(), 0, lpc->data);
+        lpc->data = NULL;
+        lpc->data_size = lpc->data_start = lpc->data_end = lpc->data_scanned = 0;
+        if (lpc->ack_event)
+            CloseHandle(lpc->ack_event);
+        lpc->ack_event = NULL;
+        lpc->cs.DebugInfo->Spare[0] = 0;
+        DeleteCriticalSection(&lpc->cs);
+    }
+    return 0;
+}
+
+void rpcrt4_conn_lpc_close_read(RpcConnection *conn)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+    BOOL queue;
+
+    EnterCriticalSection(&lpc->cs);
+    lpc->read_closed = TRUE;
+    queue = lpc->armed;
+    lpc->armed = FALSE;
+    SetEvent(lpc->ack_event);
+    LeaveCriticalSection(&lpc->cs);
+
+    /* let the pool drop its reference */
+    if (queue)
+        rpcrt4_lpc_pool_queue(lpc);
+}
+
+RPC_STATUS rpcrt4_conn_lpc_impersonate_client(RpcConnection *conn)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+    PORT_MESSAGE call;
+    BOOL call_pending;
+    NTSTATUS status;
+
+    TRACE("(%p)\n", conn);
+
+    if (conn->AuthInfo && SecIsValidHandle(&conn->ctx))
+        return RPCRT4_default_impersonate_client(conn);
+
+    EnterCriticalSection(&lpc->cs);
+    call_pending = lpc->call_pending;
+    call = lpc->call;
+    LeaveCriticalSection(&lpc->cs);
+
+    /* the client can only be impersonated while it waits for the response */
+    if (!call_pending)
+        return RPC_S_NO_CONTEXT_AVAILABLE;
+
+    status = NtImpersonateClientOfPort(lpc->port, &call);
+    if (!NT_SUCCESS(status))
+    {
+        WARN("NtImpersonateClientOfPort failed with status 0x%08x\n", status);
+        return RPC_S_NO_CONTEXT_AVAILABLE;
+    }
+    return RPC_S_OK;
+}
+
+/**** protseq ops ****/
+
+RpcServerProtseq *rpcrt4_protseq_lpc_alloc(void)
+{
+    RpcServerProtseq_lpc *ps = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*ps));
+    if (!ps)
+        return NULL;
+
+    ps->mgr_event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    return &ps->common;
+}
+
+void rpcrt4_protseq_lpc_signal_state_changed(RpcServerProtseq *protseq)
+{
+    RpcServerProtseq_lpc *lpcps = CONTAINING_RECORD(protseq, RpcServerProtseq_lpc, common);
+    SetEvent(lpcps->mgr_event);
+}
+
+void *rpcrt4_protseq_lpc_get_wait_array(RpcServerProtseq *protseq, void *prev_array, unsigned int *count)
+{
+    RpcServerProtseq_lpc *lpcps = CONTAINING_RECORD(protseq, RpcServerProtseq_lpc, common);
+    RpcConnection_lpc *listener;
+    HANDLE *objs = prev_array;
+
+    /* listeners are closed when the server stops listening */
+    EnterCriticalSection(&protseq->cs);
+    LIST_FOR_EACH_ENTRY(listener, &protseq->listeners, RpcConnection_lpc, common.protseq_entry)
+    {
+        if (!listener->port)
+            rpcrt4_lpc_listen(listener);
+    }
+    LeaveCriticalSection(&protseq->cs);
+
+    /* connections are accepted by the listen threads, so only state changes
+     * are left to wait for */
+    if (!objs)
+        objs = HeapAlloc(GetProcessHeap(), 0, sizeof(HANDLE));
+    if (!objs)
+    {
+        ERR("couldn't allocate objs\n");
+        return NULL;
+    }
+
+    objs[0] = lpcps->mgr_event;
+    *count = 1;
+    return objs;
+}
+
+void rpcrt4_protseq_lpc_free_wait_array(RpcServerProtseq *protseq, void *array)
+{
+    HeapFree(GetProcessHeap(), 0, array);
+}
+
+int rpcrt4_protseq_lpc_wait_for_new_connection(RpcServerProtseq *protseq, unsigned int count, void *wait_array)
+{
+    HANDLE *objs = wait_array;
+
+    if (!objs)
+        return -1;
+
+    if (WaitForSingleObject(objs[0], INFINITE) == WAIT_FAILED)
+    {
+        ERR("wait failed %d\n", GetLastError());
+        return -1;
+    }
+    return 0;
+}
+
+RPC_STATUS rpcrt4_protseq_lpc_open_endpoint(RpcServerProtseq *protseq, const char *endpoint)
+{
+    RPC_STATUS r;
+    RpcConnection *Connection;
+    char generated_endpoint[22];
+
+    if (!endpoint)
+    {
+        static LONG lrpc_nameless_id;
+        DWORD process_id = GetCurrentProcessId();
+        ULONG id = InterlockedIncrement(&lrpc_nameless_id);
+        snprintf(generated_endpoint, sizeof(generated_endpoint),
+                 "LRPC%08x.%08x", process_id, id);
+        endpoint = generated_endpoint;
+    }
+
+    r = RPCRT4_CreateConnection(&Connection, TRUE, protseq->Protseq, NULL,
+                                endpoint, NULL, NULL, NULL, NULL);
+    if (r != RPC_S_OK)
+        return r;
+
+    /* the listen thread looks up connections through the protseq */
+    Connection->protseq = protseq;
+    r = rpcrt4_lpc_listen((RpcConnection_lpc *)Connection);
+
+    EnterCriticalSection(&protseq->cs);
+    list_add_head(&protseq->listeners, &Connection->protseq_entry);
+    LeaveCriticalSection(&protseq->cs);
+
+    return r;
+}
@@ -543,6 +543,93 @@ static DWORD CALLBACK RPCRT4_worker_thread(LPVOID the_arg)
   return 0;
 }
 
+#ifdef __REACTOS__
+/* receives and handles a single packet, requests are handed to a worker
+ * thread; returns something other than RPC_S_OK once the connection is done */
+RPC_STATUS RPCRT4_process_incoming_packet(RpcConnection *conn)
+{
+  RpcPktHdr *hdr;
+  RPC_MESSAGE *msg;
+  RPC_STATUS status;
+  RpcPacket *packet;
+  unsigned char *auth_data;
+  ULONG auth_length;
+
+  msg = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(RPC_MESSAGE));
+  if (!msg) return RPC_S_OUT_OF_RESOURCES;
+
+  status = RPCRT4_ReceiveWithAuth(conn, &hdr, msg, &auth_data, &auth_length);
+  if (status != RPC_S_OK) {
+    WARN("receive failed with error %x\n", status);
+    HeapFree(GetProcessHeap(), 0, msg);
+    return status;
+  }
+
+  switch (hdr->common.ptype) {
+  case PKT_BIND:
+    TRACE("got bind packet\n");
+
+    status = process_bind_packet(conn, &hdr->bind, msg, auth_data,
+                                 auth_length);
+    break;
+
+  case PKT_REQUEST:
+    TRACE("got request packet\n");
+
+    packet = HeapAlloc(GetProcessHeap(), 0, sizeof(RpcPacket));
+    if (!packet) {
+      status = RPC_S_OUT_OF_RESOURCES;
+      break;
+    }
+    packet->conn = RPCRT4_GrabConnection( conn );
+    packet->hdr = hdr;
+    packet->msg = msg;
+    packet->auth_data = auth_data;
+    packet->auth_length = auth_length;
+    if (!QueueUserWorkItem(RPCRT4_worker_thread, packet, WT_EXECUTELONGFUNCTION)) {
+      ERR("couldn't queue work item for worker thread, error was %d\n", GetLastError());
+      RPCRT4_ReleaseConnection(conn);
+      HeapFree(GetProcessHeap(), 0, packet);
+      status = RPC_S_OUT_OF_RESOURCES;
+    } else {
+      return RPC_S_OK;
+    }
+    break;
+
+  case PKT_AUTH3:
+    TRACE("got auth3 packet\n");
+
+    status = process_auth3_packet(conn, &hdr->common, msg, auth_data,
+                                  auth_length);
+    break;
+  default:
+    FIXME("unhandled packet type %u\n", hdr->common.ptype);
+    break;
+  }
+
+  I_RpcFree(msg->Buffer);
+  RPCRT4_FreeHeader(hdr);
+  HeapFree(GetProcessHeap(), 0, msg);
+  HeapFree(GetProcessHeap(), 0, auth_data);
+
+  if (status != RPC_S_OK)
+    WARN("processing packet failed with error %u\n", status);
+  return status;
+}
+
+static DWORD CALLBACK RPCRT4_io_thread(LPVOID the_arg)
+{
+  RpcConnection* conn = the_arg;
+
+  TRACE("(%p)\n", conn);
+
+  while (RPCRT4_process_incoming_packet(conn) == RPC_S_OK)
+    ;
+
+  RPCRT4_ReleaseConnection(conn);
+  return 0;
+}
+#else
 static DWORD CALLBACK RPCRT4_io_thread(LPVOID the_arg)
 {
   RpcConnection* conn = the_arg;
@@ -624,6 +711,7 @@ exit:
   RPCRT4_ReleaseConnection(conn);
   return 0;
 }
+#endif
 
 void RPCRT4_new_client(RpcConnection* conn)
 {
@@ -78,6 +78,9 @@ typedef struct _RpcServerInterface
 } RpcServerInterface;
 
 void RPCRT4_new_client(RpcConnection* conn) DECLSPEC_HIDDEN;
+#ifdef __REACTOS__
+RPC_STATUS RPCRT4_process_incoming_packet(RpcConnection *conn) DECLSPEC_HIDDEN;
+#endif
 const struct protseq_ops *rpcrt4_get_protseq_ops(const char *protseq) DECLSPEC_HIDDEN;
 
 void RPCRT4_destroy_all_protseqs(void) DECLSPEC_HIDDEN;
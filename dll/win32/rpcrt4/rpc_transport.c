@@ -55,6 +55,9 @@
 #include "rpc_assoc.h"
 #include "rpc_message.h"
 #include "rpc_server.h"
+#ifdef __REACTOS__
+#include "rpc_lpc.h"
+#endif
 #include "epm_towers.h"
 
 #define DEFAULT_NCACN_HTTP_TIMEOUT (60 * 1000)
@@ -79,7 +82,9 @@ BOOL WINAPI CancelIoEx(HANDLE handle, LPOVERLAPPED lpOverlapped)
 }
 #endif
 
+#ifndef __REACTOS__
 static RpcConnection *rpcrt4_spawn_connection(RpcConnection *old_connection);
+#endif
 
 /**** ncacn_np support ****/
 
@@ -197,6 +202,7 @@ static RPC_STATUS rpcrt4_conn_open_pipe(RpcConnection *Connection, LPCSTR pname,
   return RPC_S_OK;
 }
 
+#ifndef __REACTOS__
 static char *ncalrpc_pipe_name(const char *endpoint)
 {
   static const char prefix[] = "\\\\.\\pipe\\lrpc\\";
@@ -257,6 +263,7 @@ static RPC_STATUS rpcrt4_protseq_ncalrpc_open_endpoint(RpcServerProtseq* protseq
 
   return r;
 }
+#endif
 
 static char *ncacn_pipe_name(const char *endpoint)
 {
@@ -364,6 +371,7 @@ static RPC_STATUS rpcrt4_ncacn_np_is_server_listening(const char *endpoint)
   return status;
 }
 
+#ifndef __REACTOS__
 static RPC_STATUS rpcrt4_ncalrpc_np_is_server_listening(const char *endpoint)
 {
   char *pipe_name;
@@ -395,6 +403,7 @@ static RPC_STATUS rpcrt4_ncalrpc_handoff(RpcConnection *old_conn, RpcConnection
 
   return status;
 }
+#endif
 
 static int rpcrt4_conn_np_read(RpcConnection *conn, void *buffer, unsigned int count)
 {
@@ -3188,6 +3197,18 @@ static const struct connection_ops conn_protseq_list[] = {
   },
   { "ncalrpc",
     { EPM_PROTOCOL_NCALRPC, EPM_PROTOCOL_PIPE },
+#ifdef __REACTOS__
+    rpcrt4_conn_lpc_alloc,
+    rpcrt4_conn_lpc_open,
+    rpcrt4_conn_lpc_handoff,
+    rpcrt4_conn_lpc_read,
+    rpcrt4_conn_lpc_write,
+    rpcrt4_conn_lpc_close,
+    rpcrt4_conn_lpc_close_read,
+    rpcrt4_conn_lpc_cancel_call,
+    rpcrt4_conn_lpc_is_server_listening,
+    rpcrt4_conn_lpc_wait_for_incoming_data,
+#else
     rpcrt4_conn_np_alloc,
     rpcrt4_ncalrpc_open,
     rpcrt4_ncalrpc_handoff,
@@ -3198,13 +3219,18 @@ static const struct connection_ops conn_protseq_list[] = {
     rpcrt4_conn_np_cancel_call,
     rpcrt4_ncalrpc_np_is_server_listening,
     rpcrt4_conn_np_wait_for_incoming_data,
+#endif
     rpcrt4_ncalrpc_get_top_of_tower,
     rpcrt4_ncalrpc_parse_top_of_tower,
     NULL,
     rpcrt4_ncalrpc_is_authorized,
     rpcrt4_ncalrpc_authorize,
     rpcrt4_ncalrpc_secure_packet,
+#ifdef __REACTOS__
+    rpcrt4_conn_lpc_impersonate_client,
+#else
     rpcrt4_conn_np_impersonate_client,
+#endif
     rpcrt4_conn_np_revert_to_self,
     rpcrt4_ncalrpc_inquire_auth_client,
   },
@@ -3268,12 +3294,21 @@ static const struct protseq_ops protseq_list[] =
     },
     {
         "ncalrpc",
+#ifdef __REACTOS__
+        rpcrt4_protseq_lpc_alloc,
+        rpcrt4_protseq_lpc_signal_state_changed,
+        rpcrt4_protseq_lpc_get_wait_array,
+        rpcrt4_protseq_lpc_free_wait_array,
+        rpcrt4_protseq_lpc_wait_for_new_connection,
+        rpcrt4_protseq_lpc_open_endpoint,
+#else
         rpcrt4_protseq_np_alloc,
         rpcrt4_protseq_np_signal_state_changed,
         rpcrt4_protseq_np_get_wait_array,
         rpcrt4_protseq_np_free_wait_array,
         rpcrt4_protseq_np_wait_for_new_connection,
         rpcrt4_protseq_ncalrpc_open_endpoint,
+#endif
     },
     {
         "ncacn_ip_tcp",
@@ -3368,7 +3403,11 @@ RPC_STATUS RPCRT4_CreateConnection(RpcConnection** Connection, BOOL server,
   return RPC_S_OK;
 }
 
+#ifdef __REACTOS__
+RpcConnection *rpcrt4_spawn_connection(RpcConnection *old_connection)
+#else
 static RpcConnection *rpcrt4_spawn_connection(RpcConnection *old_connection)
+#endif
 {
     RpcConnection *connection;
     RPC_STATUS err;
@@ -52,6 +52,10 @@ typedef struct
 } LISTVIEW_SORT_INFO, *LPLISTVIEW_SORT_INFO;
 
 #define SHV_CHANGE_NOTIFY WM_USER + 0x1111
+#define SHV_FILLLIST_CONTINUE WM_USER + 0x1112
+
+/* Number of items FillList fetches and inserts before yielding to the message loop */
+#define FILLLIST_BATCH_SIZE 256
 
 /* For the context menu of the def view, the id of the items are based on 1 because we need
    to call TrackPopupMenu and let it use the 0 value as an indication that the menu was canceled */
@@ -105,6 +109,10 @@ class CDefView :
         DWORD                     m_grfKeyState;
         //
         CComPtr<IContextMenu>     m_pCM;
+        CComPtr<IEnumIDList>      m_pFillEnum;          /* Enumerator FillList has not drained yet */
+        HDPA                      m_hFillCreated;       /* Items created while m_pFillEnum was active */
+        PITEMID_CHILD             m_pidlFillSelect;     /* Item SelectItem was asked for before the fill reached it */
+        UINT                      m_uFillSelectFlags;
 
         BOOL                      m_isEditing;
 
@@ -114,6 +122,10 @@ class CDefView :
     private:
         HRESULT _MergeToolbar();
         BOOL _Sort();
+        int _FindInsertPosition(PCUITEMID_CHILD pidl);
+        HRESULT _FillListBatch();
+        VOID _FillListDone();
+        VOID _FillListFree();
         VOID _DoFolderViewCB(UINT uMsg, WPARAM wParam, LPARAM lParam);
 
     public:
@@ -134,11 +146,10 @@ class CDefView :
         PCUITEMID_CHILD _PidlByItem(int i);
         PCUITEMID_CHILD _PidlByItem(LVITEM& lvItem);
         int LV_FindItemByPidl(PCUITEMID_CHILD pidl);
-        BOOLEAN LV_AddItem(PCUITEMID_CHILD pidl);
+        BOOLEAN LV_AddItem(PCUITEMID_CHILD pidl, int nItem = -1);
         BOOLEAN LV_DeleteItem(PCUITEMID_CHILD pidl);
         BOOLEAN LV_RenameItem(PCUITEMID_CHILD pidlOld, PCUITEMID_CHILD pidlNew);
         BOOLEAN LV_ProdItem(PCUITEMID_CHILD pidl);
-        static INT CALLBACK fill_list(LPVOID ptr, LPVOID arg);
         HRESULT FillList();
         HRESULT FillFileMenu();
         HRESULT FillEditMenu();
@@ -270,6 +281,7 @@ class CDefView :
         LRESULT OnCommand(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
         LRESULT OnNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
         LRESULT OnChangeNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
+        LRESULT OnFillListContinue(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
         LRESULT OnCustomItem(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
         LRESULT OnSettingChange(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
         LRESULT OnInitMenuPopup(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
@@ -316,6 +328,7 @@ class CDefView :
         MESSAGE_HANDLER(WM_NOTIFY, OnNotify)
         MESSAGE_HANDLER(WM_COMMAND, OnCommand)
         MESSAGE_HANDLER(SHV_CHANGE_NOTIFY, OnChangeNotify)
+        MESSAGE_HANDLER(SHV_FILLLIST_CONTINUE, OnFillListContinue)
         MESSAGE_HANDLER(WM_CONTEXTMENU, OnContextMenu)
         MESSAGE_HANDLER(WM_DRAWITEM, OnCustomItem)
         MESSAGE_HANDLER(WM_MEASUREITEM, OnCustomItem)
@@ -377,6 +390,9 @@ CDefView::CDefView() :
     m_dwAdvf(0),
     m_iDragOverItem(0),
     m_cScrollDelay(0),
+    m_hFillCreated(NULL),
+    m_pidlFillSelect(NULL),
+    m_uFillSelectFlags(0),
     m_isEditing(FALSE),
     m_Destroyed(FALSE)
 {
@@ -395,6 +411,7 @@ CDefView::~CDefView()
         DestroyViewWindow();
     }
 
+    _FillListFree();
     SHFree(m_apidl);
 }
 
@@ -763,14 +780,17 @@ int CDefView::LV_FindItemByPidl(PCUITEMID_CHILD pidl)
 /**********************************************************
 * LV_AddItem()
 */
-BOOLEAN CDefView::LV_AddItem(PCUITEMID_CHILD pidl)
+BOOLEAN CDefView::LV_AddItem(PCUITEMID_CHILD pidl, int nItem)
 {
     LVITEMW lvItem;
 
     TRACE("(%p)(pidl=%p)\n", this, pidl);
 
+    if (nItem < 0)
+        nItem = m_ListView.GetItemCount();                /*add the item to the end of the list*/
+
     lvItem.mask = LVIF_TEXT | LVIF_IMAGE | LVIF_PARAM;    /*set the mask*/
-    lvItem.iItem = m_ListView.GetItemCount();             /*add the item to the end of the list*/
+    lvItem.iItem = nItem;
     lvItem.iSubItem = 0;
     lvItem.lParam = reinterpret_cast<LPARAM>(ILClone(pidl)); /*set the item's data*/
     lvItem.pszText = LPSTR_TEXTCALLBACKW;                 /*get text on a callback basis*/
@@ -857,37 +877,143 @@ BOOLEAN CDefView::LV_ProdItem(PCUITEMID_CHILD pidl)
 }
 
 /**********************************************************
-* ShellView_FillList()
+* _FindInsertPosition()
 *
-* - gets the objectlist from the shellfolder
-* - sorts the list
-* - fills the list into the view
+* Binary search for the index that keeps the list sorted by the
+* current sort column when pidl is inserted there.
 */
-INT CALLBACK CDefView::fill_list(LPVOID ptr, LPVOID arg)
+int CDefView::_FindInsertPosition(PCUITEMID_CHILD pidl)
 {
-    PITEMID_CHILD pidl = static_cast<PITEMID_CHILD>(ptr);
-    CDefView *pThis = static_cast<CDefView *>(arg);
+    int nLow = 0, nHigh = m_ListView.GetItemCount();
+
+    if (m_ListView.GetWindowLongPtr(GWL_STYLE) & LVS_NOSORTHEADER)
+        return nHigh;
+
+    while (nLow < nHigh)
+    {
+        int nMiddle = (nLow + nHigh) / 2;
+
+        if (ListViewCompareItems(reinterpret_cast<LPARAM>(pidl),
+                                 reinterpret_cast<LPARAM>(_PidlByItem(nMiddle)),
+                                 reinterpret_cast<LPARAM>(this)) < 0)
+            nHigh = nMiddle;
+        else
+            nLow = nMiddle + 1;
+    }
 
-    /* in a commdlg This works as a filemask*/
-    if (pThis->IncludeObject(pidl) == S_OK)
-        pThis->LV_AddItem(pidl);
+    return nLow;
+}
+
+/**********************************************************
+* _FillListBatch()
+*
+* Moves the next batch of items from m_pFillEnum into the view.
+* The first batch goes into an empty list and is sorted as a whole,
+* later ones are inserted at their sorted positions so the view
+* stays ordered while the folder is still being enumerated.
+* Returns S_FALSE once the enumerator is exhausted.
+*/
+HRESULT CDefView::_FillListBatch()
+{
+    PITEMID_CHILD apidl[FILLLIST_BATCH_SIZE];
+    ULONG         cFetched = 0;
+    HRESULT       hRes;
+    BOOL          bFirstBatch = (m_ListView.GetItemCount() == 0);
+
+    hRes = m_pFillEnum->Next(FILLLIST_BATCH_SIZE, apidl, &cFetched);
+    if (FAILED(hRes))
+        cFetched = 0;
+
+    /*turn the listview's redrawing off*/
+    m_ListView.SetRedraw(FALSE);
+
+    for (ULONG i = 0; i < cFetched; i++)
+    {
+        /* in a commdlg This works as a filemask*/
+        if (IncludeObject(apidl[i]) == S_OK)
+            LV_AddItem(apidl[i], bFirstBatch ? -1 : _FindInsertPosition(apidl[i]));
+
+        SHFree(apidl[i]);
+    }
 
-    SHFree(pidl);
+    if (bFirstBatch)
+        _Sort();
+
+    /*turn the listview's redrawing back on and force it to draw*/
+    m_ListView.SetRedraw(TRUE);
+
+    return (hRes == S_OK && cFetched == FILLLIST_BATCH_SIZE) ? S_OK : S_FALSE;
+}
+
+static INT CALLBACK FreeFillCreatedCallback(LPVOID p, LPVOID lParam)
+{
+    ILFree(static_cast<LPITEMIDLIST>(p));
     return TRUE;
 }
 
+/**********************************************************
+* _FillListDone()
+*
+* Called once m_pFillEnum is drained. Adds the items whose create
+* notifications came in meanwhile, unless the enumerator returned
+* them too, and applies a selection that was waiting for its item.
+*/
+VOID CDefView::_FillListDone()
+{
+    PCUITEMID_CHILD pidl;
+
+    if (m_hFillCreated)
+    {
+        for (INT i = 0; i < DPA_GetPtrCount(m_hFillCreated); i++)
+        {
+            pidl = static_cast<PCUITEMID_CHILD>(DPA_GetPtr(m_hFillCreated, i));
+            if (LV_FindItemByPidl(pidl) == -1)
+                LV_AddItem(pidl);
+            else
+                LV_ProdItem(pidl);
+        }
+    }
+
+    if (m_pidlFillSelect)
+        SelectItem(m_pidlFillSelect, m_uFillSelectFlags);
+
+    _FillListFree();
+}
+
+VOID CDefView::_FillListFree()
+{
+    if (m_hFillCreated)
+    {
+        DPA_DestroyCallback(m_hFillCreated, FreeFillCreatedCallback, NULL);
+        m_hFillCreated = NULL;
+    }
+
+    ILFree(m_pidlFillSelect);
+    m_pidlFillSelect = NULL;
+}
+
+/**********************************************************
+* ShellView_FillList()
+*
+* - gets the objectlist from the shellfolder
+* - fills the first batch into the view and sorts it
+* - posts SHV_FILLLIST_CONTINUE to add the rest batch by batch,
+*   so the view stays responsive on large folders
+*/
 HRESULT CDefView::FillList()
 {
     CComPtr<IEnumIDList> pEnumIDList;
-    PITEMID_CHILD pidl;
-    DWORD         dwFetched;
     HRESULT       hRes;
-    HDPA          hdpa;
     HKEY          hKey;
     DWORD         dFlags = SHCONTF_NONFOLDERS | SHCONTF_FOLDERS;
+    BOOL          bContinuePosted = (m_pFillEnum != NULL);
 
     TRACE("%p\n", this);
 
+    /* abandon a fill that is still in progress, its SHV_FILLLIST_CONTINUE
+       is still queued and will pick up the new enumerator instead */
+    m_pFillEnum.Release();
+
     /* determine if there is a setting to show all the hidden files/folders */
     if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\Microsoft\\Windows\\CurrentVersion\\Explorer\\Advanced", 0, KEY_QUERY_VALUE, &hKey) == ERROR_SUCCESS)
     {
@@ -917,28 +1043,7 @@ HRESULT CDefView::FillList()
         return(hRes);
     }
 
-    /* create a pointer array */
-    hdpa = DPA_Create(16);
-    if (!hdpa)
-    {
-        return(E_OUTOFMEMORY);
-    }
-
-    /* copy the items into the array*/
-    while((S_OK == pEnumIDList->Next(1, &pidl, &dwFetched)) && dwFetched)
-    {
-        if (DPA_InsertPtr(hdpa, 0x7fff, pidl) == -1)
-        {
-            SHFree(pidl);
-        }
-    }
-
-    /*turn the listview's redrawing off*/
-    m_ListView.SetRedraw(FALSE);
-
-    DPA_DestroyCallback( hdpa, fill_list, this);
-
-    /* sort the array */
+    /* set up the sort order the batches are inserted in */
     if (m_pSF2Parent)
     {
         m_pSF2Parent->GetDefaultColumn(NULL, (ULONG*)&m_sortInfo.nHeaderID, NULL);
@@ -948,16 +1053,43 @@ HRESULT CDefView::FillList()
         FIXME("no m_pSF2Parent\n");
     }
     m_sortInfo.bIsAscending = TRUE;
-    _Sort();
 
-    /*turn the listview's redrawing back on and force it to draw*/
-    m_ListView.SetRedraw(TRUE);
+    m_pFillEnum = pEnumIDList;
+    if (_FillListBatch() == S_OK)
+    {
+        /* more to come, let the view paint what it has first */
+        if (!bContinuePosted)
+            PostMessageW(SHV_FILLLIST_CONTINUE, 0, 0);
+        return S_OK;
+    }
 
+    m_pFillEnum.Release();
+    _FillListDone();
     _DoFolderViewCB(SFVM_LISTREFRESHED, NULL, NULL);
 
     return S_OK;
 }
 
+LRESULT CDefView::OnFillListContinue(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+{
+    /* the fill may have been restarted or abandoned meanwhile */
+    if (!m_pFillEnum)
+        return 0;
+
+    if (_FillListBatch() == S_OK)
+    {
+        PostMessageW(SHV_FILLLIST_CONTINUE, 0, 0);
+        return 0;
+    }
+
+    m_pFillEnum.Release();
+    _FillListDone();
+    _DoFolderViewCB(SFVM_LISTREFRESHED, NULL, NULL);
+    UpdateStatusbar();
+
+    return 0;
+}
+
 LRESULT CDefView::OnShowWindow(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
 {
     m_ListView.UpdateWindow();
@@ -985,6 +1117,8 @@ LRESULT CDefView::OnDestroy(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHand
         m_hNotify = NULL;
         SHFree(m_pidlParent);
         m_pidlParent = NULL;
+        m_pFillEnum.Release();
+        _FillListFree();
     }
     bHandled = FALSE;
     return 0;
@@ -1919,7 +2053,15 @@ LRESULT CDefView::OnChangeNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &
     {
         case SHCNE_MKDIR:
         case SHCNE_CREATE:
-            if (bParent0)
+            if (bParent0 && m_pFillEnum)
+            {
+                /* the enumerator may still return this item, add it after the fill */
+                if (!m_hFillCreated)
+                    m_hFillCreated = DPA_Create(4);
+                if (m_hFillCreated)
+                    DPA_AppendPtr(m_hFillCreated, ILClone(ILFindLastID(Pidls[0])));
+            }
+            else if (bParent0)
             {
                 if (LV_FindItemByPidl(ILFindLastID(Pidls[0])) == -1)
                 {
@@ -1934,6 +2076,20 @@ LRESULT CDefView::OnChangeNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &
 
         case SHCNE_RMDIR:
         case SHCNE_DELETE:
+            if (bParent0 && m_hFillCreated)
+            {
+                for (INT i = DPA_GetPtrCount(m_hFillCreated) - 1; i >= 0; i--)
+                {
+                    PITEMID_CHILD pidl = static_cast<PITEMID_CHILD>(DPA_GetPtr(m_hFillCreated, i));
+                    HRESULT hr = m_pSFParent->CompareIDs(0, ILFindLastID(Pidls[0]), pidl);
+
+                    if (SUCCEEDED(hr) && !HRESULT_CODE(hr))
+                    {
+                        DPA_DeletePtr(m_hFillCreated, i);
+                        ILFree(pidl);
+                    }
+                }
+            }
             if (bParent0)
                 LV_DeleteItem(ILFindLastID(Pidls[0]));
             break;
@@ -2229,7 +2385,16 @@ HRESULT WINAPI CDefView::SelectItem(PCUITEMID_CHILD pidl, UINT uFlags)
 
     i = LV_FindItemByPidl(pidl);
     if (i == -1)
+    {
+        /* a new item may only show up once the fill is done */
+        if (m_pFillEnum)
+        {
+            ILFree(m_pidlFillSelect);
+            m_pidlFillSelect = ILClone(pidl);
+            m_uFillSelectFlags = uFlags;
+        }
         return S_OK;
+    }
 
     if(uFlags & SVSI_ENSUREVISIBLE)
         m_ListView.EnsureVisible(i, FALSE);
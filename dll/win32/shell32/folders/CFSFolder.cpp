@@ -277,10 +277,11 @@ HRESULT CFSExtractIcon_CreateInstance(IShellFolder * psf, LPCITEMIDLIST pidl, RE
 }
 
 /*
-CFileSysEnum should do an initial FindFirstFile and do a FindNextFile as each file is
-returned by Next. When the enumerator is created, it can do numerous additional operations
-including formatting a drive, reconnecting a network share drive, and requesting a disk
-be inserted in a removable drive.
+CFileSysEnum does an initial FindFirstFile and a FindNextFile as each file is
+returned by Next, so large directories are not read up front. When the enumerator
+is created, it can do numerous additional operations including formatting a drive,
+reconnecting a network share drive, and requesting a disk be inserted in a
+removable drive.
 */
 
 /***********************************************************************
@@ -291,83 +292,197 @@ class CFileSysEnum :
     public CEnumIDListBase
 {
     private:
+        WCHAR m_szSearch[MAX_PATH];
+        DWORD m_dwFlags;
+        HANDLE m_hFind;
+        WIN32_FIND_DATAW m_FindData;
+        BOOL m_bPending;    /* m_FindData holds an entry Next has not looked at yet */
+
+        void _Open();
+        void _Close();
+        BOOL _Include();
+        HRESULT _Fetch(LPITEMIDLIST *ppidl);
     public:
         CFileSysEnum();
         ~CFileSysEnum();
         HRESULT WINAPI Initialize(LPWSTR sPathTarget, DWORD dwFlags);
 
+        // *** IEnumIDList methods ***
+        virtual HRESULT STDMETHODCALLTYPE Next(ULONG celt, LPITEMIDLIST *rgelt, ULONG *pceltFetched);
+        virtual HRESULT STDMETHODCALLTYPE Skip(ULONG celt);
+        virtual HRESULT STDMETHODCALLTYPE Reset();
+
         BEGIN_COM_MAP(CFileSysEnum)
         COM_INTERFACE_ENTRY_IID(IID_IEnumIDList, IEnumIDList)
         END_COM_MAP()
 };
 
-CFileSysEnum::CFileSysEnum()
+CFileSysEnum::CFileSysEnum() :
+    m_dwFlags(0),
+    m_hFind(INVALID_HANDLE_VALUE),
+    m_bPending(FALSE)
 {
+    m_szSearch[0] = UNICODE_NULL;
 }
 
 CFileSysEnum::~CFileSysEnum()
 {
+    _Close();
 }
 
-HRESULT WINAPI CFileSysEnum::Initialize(LPWSTR lpszPath, DWORD dwFlags)
+void CFileSysEnum::_Open()
+{
+    _Close();
+
+    if (!m_szSearch[0])
+        return;
+
+    m_hFind = FindFirstFileW(m_szSearch, &m_FindData);
+    m_bPending = (m_hFind != INVALID_HANDLE_VALUE);
+}
+
+void CFileSysEnum::_Close()
+{
+    if (m_hFind != INVALID_HANDLE_VALUE)
+    {
+        FindClose(m_hFind);
+        m_hFind = INVALID_HANDLE_VALUE;
+    }
+    m_bPending = FALSE;
+}
+
+BOOL CFileSysEnum::_Include()
 {
-    WIN32_FIND_DATAW stffile;
-    HANDLE hFile;
-    WCHAR  szPath[MAX_PATH];
-    BOOL succeeded = TRUE;
-    static const WCHAR stars[] = { '*','.','*',0 };
     static const WCHAR dot[] = { '.',0 };
     static const WCHAR dotdot[] = { '.','.',0 };
 
-    TRACE("(%p)->(path=%s flags=0x%08x)\n", this, debugstr_w(lpszPath), dwFlags);
+    if ((m_FindData.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN) &&
+        !(m_dwFlags & SHCONTF_INCLUDEHIDDEN))
+        return FALSE;
 
-    if(!lpszPath || !lpszPath[0]) return FALSE;
+    if (m_FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+    {
+        return (m_dwFlags & SHCONTF_FOLDERS) &&
+               strcmpW(m_FindData.cFileName, dot) &&
+               strcmpW(m_FindData.cFileName, dotdot);
+    }
 
-    wcscpy(szPath, lpszPath);
-    PathAddBackslashW(szPath);
-    wcscat(szPath,stars);
+    return (m_dwFlags & SHCONTF_NONFOLDERS) != 0;
+}
 
-    hFile = FindFirstFileW(szPath,&stffile);
-    if ( hFile != INVALID_HANDLE_VALUE )
-    {
-        BOOL findFinished = FALSE;
+/*
+ * Returns the next matching entry of the directory, S_FALSE at its end.
+ */
+HRESULT CFileSysEnum::_Fetch(LPITEMIDLIST *ppidl)
+{
+    *ppidl = NULL;
 
-        do
+    while (m_hFind != INVALID_HANDLE_VALUE)
+    {
+        if (!m_bPending)
         {
-            if ( !(stffile.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN)
-             || (dwFlags & SHCONTF_INCLUDEHIDDEN) )
-            {
-                LPITEMIDLIST pidl = NULL;
-
-                if ( (stffile.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
-                 dwFlags & SHCONTF_FOLDERS &&
-                 strcmpW(stffile.cFileName, dot) && strcmpW(stffile.cFileName, dotdot))
-                {
-                    pidl = _ILCreateFromFindDataW(&stffile);
-                    succeeded = succeeded && AddToEnumList(pidl);
-                }
-                else if (!(stffile.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-                 && dwFlags & SHCONTF_NONFOLDERS)
-                {
-                    pidl = _ILCreateFromFindDataW(&stffile);
-                    succeeded = succeeded && AddToEnumList(pidl);
-                }
-            }
-            if (succeeded)
+            if (!FindNextFileW(m_hFind, &m_FindData))
             {
-                if (!FindNextFileW(hFile, &stffile))
-                {
-                    if (GetLastError() == ERROR_NO_MORE_FILES)
-                        findFinished = TRUE;
-                    else
-                        succeeded = FALSE;
-                }
+                if (GetLastError() != ERROR_NO_MORE_FILES)
+                    ERR("FindNextFileW failed, error %lu\n", GetLastError());
+                _Close();
+                break;
             }
-        } while (succeeded && !findFinished);
-        FindClose(hFile);
+        }
+        m_bPending = FALSE;
+
+        if (_Include())
+        {
+            *ppidl = _ILCreateFromFindDataW(&m_FindData);
+            if (!*ppidl)
+                return E_OUTOFMEMORY;
+            return S_OK;
+        }
+    }
+
+    return S_FALSE;
+}
+
+HRESULT WINAPI CFileSysEnum::Initialize(LPWSTR lpszPath, DWORD dwFlags)
+{
+    static const WCHAR stars[] = { '*','.','*',0 };
+
+    TRACE("(%p)->(path=%s flags=0x%08x)\n", this, debugstr_w(lpszPath), dwFlags);
+
+    m_dwFlags = dwFlags;
+
+    if(!lpszPath || !lpszPath[0]) return S_OK;
+
+    if (FAILED(StringCchCopyW(m_szSearch, _countof(m_szSearch), lpszPath)) ||
+        !PathAddBackslashW(m_szSearch) ||
+        FAILED(StringCchCatW(m_szSearch, _countof(m_szSearch), stars)))
+    {
+        m_szSearch[0] = UNICODE_NULL;
+        return E_INVALIDARG;
+    }
+
+    _Open();
+
+    return S_OK;
+}
+
+HRESULT WINAPI CFileSysEnum::Next(ULONG celt, LPITEMIDLIST *rgelt, ULONG *pceltFetched)
+{
+    ULONG i;
+    HRESULT hr = S_OK;
+
+    TRACE("(%p)->(%d,%p, %p)\n", this, celt, rgelt, pceltFetched);
+
+    if (pceltFetched)
+        *pceltFetched = 0;
+
+    if (celt > 1 && !pceltFetched)
+        return E_INVALIDARG;
+
+    for (i = 0; i < celt; i++)
+    {
+        hr = _Fetch(&rgelt[i]);
+        if (hr != S_OK)
+            break;
     }
 
-    return succeeded;
+    if (FAILED(hr))
+    {
+        while (i > 0)
+            SHFree(rgelt[--i]);
+        return hr;
+    }
+
+    if (pceltFetched)
+        *pceltFetched = i;
+
+    return (i == celt) ? S_OK : S_FALSE;
+}
+
+HRESULT WINAPI CFileSysEnum::Skip(ULONG celt)
+{
+    LPITEMIDLIST pidl;
+    HRESULT hr;
+
+    TRACE("(%p)->(%u)\n", this, celt);
+
+    while (celt--)
+    {
+        hr = _Fetch(&pidl);
+        if (hr != S_OK)
+            return FAILED(hr) ? hr : S_FALSE;
+        SHFree(pidl);
+    }
+
+    return S_OK;
+}
+
+HRESULT WINAPI CFileSysEnum::Reset()
+{
+    TRACE("(%p)\n", this);
+
+    _Open();
+    return S_OK;
 }
 
 CFSFolder::CFSFolder()
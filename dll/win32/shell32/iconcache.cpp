@@ -381,6 +381,500 @@ leave:
     LeaveCriticalSection(&SHELL32_SicCS);
     return ret;
 }
+/********************** THE PERSISTENT ICON CACHE *************************/
+
+/* Icons extracted from files are also written to IconCache.db in the local
+ * application data folder, so other processes and later sessions can skip
+ * parsing the file again. The file is a header followed by appended records;
+ * it is mapped once per process and indexed by the key below. A record is
+ * only used while the size and time stamp of its source file still match.
+ */
+
+#define SIC_SMALL_SIZE          16
+#define SIC_LARGE_SIZE          32
+#define SIC_CACHE_SIGNATURE     0x43495348  /* 'HSIC' */
+#define SIC_CACHE_VERSION       1
+#define SIC_CACHE_MAX_SIZE      (16 * 1024 * 1024)
+#define SIC_CACHE_LOCK_TIMEOUT  1000
+
+typedef struct
+{
+    DWORD dwSignature;
+    DWORD dwVersion;
+    DWORD cxSmall;
+    DWORD cxLarge;
+} SIC_CACHE_HEADER;
+
+typedef struct
+{
+    DWORD cbRecord;         /* size of the record, path and icon bits included */
+    INT dwSourceIndex;
+    DWORD dwFlags;          /* GIL_* flags */
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+    DWORD cchPath;          /* length of the path following the record, NULL included */
+    /* WCHAR path[cchPath] padded to a DWORD, then the small and the large icon */
+} SIC_CACHE_RECORD, *LPSIC_CACHE_RECORD;
+
+static BOOL   sic_cache_opened = FALSE;
+static HANDLE sic_cache_file = INVALID_HANDLE_VALUE;
+static HANDLE sic_cache_mutex = NULL;   /* serializes writers of all processes */
+static LPBYTE sic_cache_view = NULL;
+static HDPA   sic_cache_index = NULL;   /* records of the view, sorted by key */
+
+#define SIC_CACHE_PATH(rec) ((LPCWSTR)((rec) + 1))
+#define SIC_CACHE_PATH_SIZE(cch) (((cch) * sizeof(WCHAR) + 3) & ~3)
+#define SIC_CACHE_BITS(rec) ((LPBYTE)((rec) + 1) + SIC_CACHE_PATH_SIZE((rec)->cchPath))
+
+/* An icon is stored as 32bpp top-down color bits followed by its 1bpp mask */
+static DWORD SIC_CacheIconSize(INT cx)
+{
+    return cx * cx * 4 + ((cx + 31) / 32) * 4 * cx;
+}
+
+static INT CALLBACK SIC_CompareCacheRecords(LPVOID p1, LPVOID p2, LPARAM lparam)
+{
+    LPSIC_CACHE_RECORD r1 = (LPSIC_CACHE_RECORD)p1, r2 = (LPSIC_CACHE_RECORD)p2;
+    LONG diff;
+
+    if (r1->dwSourceIndex != r2->dwSourceIndex)
+        return (r1->dwSourceIndex < r2->dwSourceIndex) ? -1 : 1;
+    if (r1->dwFlags != r2->dwFlags)
+        return (r1->dwFlags < r2->dwFlags) ? -1 : 1;
+    if (r1->nFileSizeLow != r2->nFileSizeLow)
+        return (r1->nFileSizeLow < r2->nFileSizeLow) ? -1 : 1;
+    if (r1->nFileSizeHigh != r2->nFileSizeHigh)
+        return (r1->nFileSizeHigh < r2->nFileSizeHigh) ? -1 : 1;
+    diff = CompareFileTime(&r1->ftLastWriteTime, &r2->ftLastWriteTime);
+    if (diff)
+        return diff;
+
+    return wcsicmp(SIC_CACHE_PATH(r1), SIC_CACHE_PATH(r2));
+}
+
+static BOOL SIC_CacheLock(void)
+{
+    DWORD dwWait = WaitForSingleObject(sic_cache_mutex, SIC_CACHE_LOCK_TIMEOUT);
+
+    /* A writer that died mid-record leaves a record the reader skips */
+    return (dwWait == WAIT_OBJECT_0 || dwWait == WAIT_ABANDONED);
+}
+
+/* Cuts the file back to cbKeep bytes. Must be called with the mutex held and
+   no view of the file in this process; it fails while other processes still
+   map the file. */
+static BOOL SIC_CacheTruncate(DWORD cbKeep)
+{
+    LARGE_INTEGER pos;
+
+    pos.QuadPart = cbKeep;
+    if (!SetFilePointerEx(sic_cache_file, pos, NULL, FILE_BEGIN) || !SetEndOfFile(sic_cache_file))
+    {
+        WARN("Failed to truncate the icon cache, error %lu\n", GetLastError());
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Maps the first cbView bytes of the file and indexes the records in them,
+   stopping at the first one that is cut short or damaged. Returns the offset
+   indexing stopped at, or 0 on failure. */
+static DWORD SIC_CacheMap(DWORD cbView)
+{
+    HANDLE hMapping;
+    DWORD cbIcons, offset;
+    LPSIC_CACHE_RECORD lprec;
+
+    hMapping = CreateFileMappingW(sic_cache_file, NULL, PAGE_READONLY, 0, cbView, NULL);
+    if (!hMapping)
+        return 0;
+
+    sic_cache_view = (LPBYTE)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, cbView);
+    CloseHandle(hMapping);
+    if (!sic_cache_view)
+        return 0;
+
+    sic_cache_index = DPA_Create(64);
+    if (!sic_cache_index)
+    {
+        UnmapViewOfFile(sic_cache_view);
+        sic_cache_view = NULL;
+        return 0;
+    }
+
+    cbIcons = SIC_CacheIconSize(SIC_SMALL_SIZE) + SIC_CacheIconSize(SIC_LARGE_SIZE);
+    for (offset = sizeof(SIC_CACHE_HEADER); offset + sizeof(SIC_CACHE_RECORD) <= cbView; offset += lprec->cbRecord)
+    {
+        lprec = (LPSIC_CACHE_RECORD)(sic_cache_view + offset);
+
+        if (lprec->cchPath == 0 || lprec->cchPath > MAX_PATH ||
+            lprec->cbRecord != sizeof(SIC_CACHE_RECORD) + SIC_CACHE_PATH_SIZE(lprec->cchPath) + cbIcons ||
+            lprec->cbRecord > cbView - offset ||
+            SIC_CACHE_PATH(lprec)[lprec->cchPath - 1] != UNICODE_NULL)
+        {
+            break;
+        }
+
+        DPA_InsertPtr(sic_cache_index,
+                      DPA_Search(sic_cache_index, lprec, 0, SIC_CompareCacheRecords, 0, DPAS_SORTED | DPAS_INSERTAFTER),
+                      lprec);
+    }
+
+    return offset;
+}
+
+static void SIC_CacheUnmap(void)
+{
+    if (sic_cache_index)
+        DPA_Destroy(sic_cache_index);
+    if (sic_cache_view)
+        UnmapViewOfFile(sic_cache_view);
+
+    sic_cache_index = NULL;
+    sic_cache_view = NULL;
+}
+
+/*****************************************************************************
+ * SIC_CacheOpen            [internal]
+ *
+ * Opens the cache file, maps what is in it and builds the index. A file that
+ * is over the size limit is started over and a damaged tail is cut off, so
+ * that new records are not appended where no reader finds them. Failures
+ * just leave the cache disabled for this process. Must be called with
+ * SHELL32_SicCS held.
+ */
+static void SIC_CacheOpen(void)
+{
+    WCHAR path[MAX_PATH];
+    SIC_CACHE_HEADER header;
+    LARGE_INTEGER size;
+    DWORD cbDone, cbValid;
+    BOOL bValid;
+
+    if (FAILED(SHGetFolderPathW(NULL, CSIDL_LOCAL_APPDATA | CSIDL_FLAG_CREATE, NULL, SHGFP_TYPE_CURRENT, path)) ||
+        !PathAppendW(path, L"IconCache.db"))
+    {
+        return;
+    }
+
+    sic_cache_mutex = CreateMutexW(NULL, FALSE, L"Local\\ShellIconCacheMutex");
+    if (!sic_cache_mutex)
+        return;
+
+    sic_cache_file = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_HIDDEN, NULL);
+    if (sic_cache_file == INVALID_HANDLE_VALUE)
+    {
+        WARN("Failed to open %s, error %lu\n", debugstr_w(path), GetLastError());
+        return;
+    }
+
+    if (!SIC_CacheLock())
+        goto fail;
+
+    bValid = ReadFile(sic_cache_file, &header, sizeof(header), &cbDone, NULL) &&
+             cbDone == sizeof(header) &&
+             header.dwSignature == SIC_CACHE_SIGNATURE &&
+             header.dwVersion == SIC_CACHE_VERSION &&
+             header.cxSmall == SIC_SMALL_SIZE &&
+             header.cxLarge == SIC_LARGE_SIZE;
+    if (!bValid)
+    {
+        /* Start over; this fails while other processes still map the old file */
+        header.dwSignature = SIC_CACHE_SIGNATURE;
+        header.dwVersion = SIC_CACHE_VERSION;
+        header.cxSmall = SIC_SMALL_SIZE;
+        header.cxLarge = SIC_LARGE_SIZE;
+
+        if (SetFilePointer(sic_cache_file, 0, NULL, FILE_BEGIN) != 0 ||
+            !SetEndOfFile(sic_cache_file) ||
+            !WriteFile(sic_cache_file, &header, sizeof(header), &cbDone, NULL) ||
+            cbDone != sizeof(header))
+        {
+            ReleaseMutex(sic_cache_mutex);
+            goto fail;
+        }
+    }
+
+    if (!GetFileSizeEx(sic_cache_file, &size))
+    {
+        ReleaseMutex(sic_cache_mutex);
+        goto fail;
+    }
+
+    if (size.QuadPart > SIC_CACHE_MAX_SIZE)
+    {
+        if (!SIC_CacheTruncate(sizeof(header)))
+        {
+            ReleaseMutex(sic_cache_mutex);
+            goto fail;
+        }
+        size.QuadPart = sizeof(header);
+    }
+
+    /* Writers append under the mutex, so everything up to size is complete
+       unless a writer died in the middle of a record */
+    cbValid = SIC_CacheMap(size.LowPart);
+    if (cbValid && cbValid < size.LowPart)
+    {
+        SIC_CacheUnmap();
+        if (SIC_CacheTruncate(cbValid))
+            size.LowPart = cbValid;
+        cbValid = SIC_CacheMap(size.LowPart);
+    }
+    ReleaseMutex(sic_cache_mutex);
+    if (!cbValid)
+        goto fail;
+
+    TRACE("%d icons in the persistent cache\n", DPA_GetPtrCount(sic_cache_index));
+    return;
+
+fail:
+    CloseHandle(sic_cache_file);
+    sic_cache_file = INVALID_HANDLE_VALUE;
+}
+
+static void SIC_CacheClose(void)
+{
+    SIC_CacheUnmap();
+    if (sic_cache_file != INVALID_HANDLE_VALUE)
+        CloseHandle(sic_cache_file);
+    if (sic_cache_mutex)
+        CloseHandle(sic_cache_mutex);
+
+    sic_cache_file = INVALID_HANDLE_VALUE;
+    sic_cache_mutex = NULL;
+    sic_cache_opened = FALSE;
+}
+
+static void SIC_CacheInitBitmapInfo(BITMAPINFO *lpbmi, INT cx, WORD wBitCount)
+{
+    ZeroMemory(lpbmi, sizeof(BITMAPINFOHEADER) + 2 * sizeof(RGBQUAD));
+    lpbmi->bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    lpbmi->bmiHeader.biWidth = cx;
+    lpbmi->bmiHeader.biHeight = -cx;
+    lpbmi->bmiHeader.biPlanes = 1;
+    lpbmi->bmiHeader.biBitCount = wBitCount;
+    lpbmi->bmiHeader.biCompression = BI_RGB;
+    lpbmi->bmiColors[1].rgbBlue = lpbmi->bmiColors[1].rgbGreen = lpbmi->bmiColors[1].rgbRed = 0xFF;
+}
+
+static BOOL SIC_CacheGetIconBits(HDC hDC, HICON hIcon, INT cx, LPBYTE lpBits)
+{
+    BYTE buffer[sizeof(BITMAPINFOHEADER) + 2 * sizeof(RGBQUAD)];
+    BITMAPINFO *lpbmi = (BITMAPINFO*)buffer;
+    ICONINFO IconInfo;
+    BITMAP bm;
+    BOOL ret = FALSE;
+
+    if (!GetIconInfo(hIcon, &IconInfo))
+        return FALSE;
+
+    /* Monochrome icons keep both images in the mask, leave them out */
+    if (IconInfo.hbmColor &&
+        GetObjectW(IconInfo.hbmColor, sizeof(bm), &bm) &&
+        bm.bmWidth == cx && bm.bmHeight == cx)
+    {
+        SIC_CacheInitBitmapInfo(lpbmi, cx, 32);
+        if (GetDIBits(hDC, IconInfo.hbmColor, 0, cx, lpBits, lpbmi, DIB_RGB_COLORS) == cx)
+        {
+            SIC_CacheInitBitmapInfo(lpbmi, cx, 1);
+            ret = (GetDIBits(hDC, IconInfo.hbmMask, 0, cx, lpBits + cx * cx * 4, lpbmi, DIB_RGB_COLORS) == cx);
+        }
+    }
+
+    if (IconInfo.hbmColor) DeleteObject(IconInfo.hbmColor);
+    if (IconInfo.hbmMask) DeleteObject(IconInfo.hbmMask);
+    return ret;
+}
+
+static HICON SIC_CacheCreateIcon(HDC hDC, INT cx, const BYTE *lpBits)
+{
+    BYTE buffer[sizeof(BITMAPINFOHEADER) + 2 * sizeof(RGBQUAD)];
+    BITMAPINFO *lpbmi = (BITMAPINFO*)buffer;
+    ICONINFO IconInfo;
+    PVOID pvColor;
+    HICON hIcon = NULL;
+
+    ZeroMemory(&IconInfo, sizeof(IconInfo));
+    IconInfo.fIcon = TRUE;
+
+    SIC_CacheInitBitmapInfo(lpbmi, cx, 32);
+    IconInfo.hbmColor = CreateDIBSection(hDC, lpbmi, DIB_RGB_COLORS, &pvColor, NULL, 0);
+    IconInfo.hbmMask = CreateBitmap(cx, cx, 1, 1, NULL);
+
+    if (IconInfo.hbmColor && IconInfo.hbmMask)
+    {
+        CopyMemory(pvColor, lpBits, cx * cx * 4);
+
+        SIC_CacheInitBitmapInfo(lpbmi, cx, 1);
+        if (SetDIBits(hDC, IconInfo.hbmMask, 0, cx, lpBits + cx * cx * 4, lpbmi, DIB_RGB_COLORS) == cx)
+            hIcon = CreateIconIndirect(&IconInfo);
+    }
+
+    if (IconInfo.hbmColor) DeleteObject(IconInfo.hbmColor);
+    if (IconInfo.hbmMask) DeleteObject(IconInfo.hbmMask);
+    return hIcon;
+}
+
+/* Fills a record header, followed by the path, for the given source */
+static DWORD SIC_CacheInitRecord(LPSIC_CACHE_RECORD lprec, LPCWSTR sSourceFile, INT dwSourceIndex,
+                                 DWORD dwFlags, const WIN32_FILE_ATTRIBUTE_DATA *lpSourceData)
+{
+    DWORD cchPath = wcslen(sSourceFile) + 1;
+
+    lprec->cbRecord = sizeof(SIC_CACHE_RECORD) + SIC_CACHE_PATH_SIZE(cchPath) +
+                      SIC_CacheIconSize(SIC_SMALL_SIZE) + SIC_CacheIconSize(SIC_LARGE_SIZE);
+    lprec->dwSourceIndex = dwSourceIndex;
+    lprec->dwFlags = dwFlags;
+    lprec->ftLastWriteTime = lpSourceData->ftLastWriteTime;
+    lprec->nFileSizeHigh = lpSourceData->nFileSizeHigh;
+    lprec->nFileSizeLow = lpSourceData->nFileSizeLow;
+    lprec->cchPath = cchPath;
+    ZeroMemory((LPBYTE)(lprec + 1), SIC_CACHE_PATH_SIZE(cchPath));
+    CopyMemory((LPBYTE)(lprec + 1), sSourceFile, cchPath * sizeof(WCHAR));
+
+    return lprec->cbRecord;
+}
+
+/*****************************************************************************
+ * SIC_CacheLookup            [internal]
+ *
+ * Recreates the icon pair for a source from the persistent cache.
+ */
+static BOOL SIC_CacheLookup(LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags,
+                            const WIN32_FILE_ATTRIBUTE_DATA *lpSourceData,
+                            HICON *phiconSmall, HICON *phiconLarge)
+{
+    DWORD key[(sizeof(SIC_CACHE_RECORD) + SIC_CACHE_PATH_SIZE(MAX_PATH)) / sizeof(DWORD)];
+    LPSIC_CACHE_RECORD lprec;
+    INT index;
+    HDC hDC;
+    BOOL ret = FALSE;
+
+    if (wcslen(sSourceFile) >= MAX_PATH)
+        return FALSE;
+
+    /* The index and the view go away in SIC_CacheClose */
+    EnterCriticalSection(&SHELL32_SicCS);
+
+    if (!sic_cache_opened)
+    {
+        SIC_CacheOpen();
+        sic_cache_opened = TRUE;
+    }
+
+    if (sic_cache_index && DPA_GetPtrCount(sic_cache_index))
+    {
+        SIC_CacheInitRecord((LPSIC_CACHE_RECORD)key, sSourceFile, dwSourceIndex, dwFlags, lpSourceData);
+        index = DPA_Search(sic_cache_index, key, 0, SIC_CompareCacheRecords, 0, DPAS_SORTED);
+        if (index != -1)
+        {
+            lprec = (LPSIC_CACHE_RECORD)DPA_GetPtr(sic_cache_index, index);
+
+            hDC = CreateCompatibleDC(NULL);
+            if (hDC)
+            {
+                *phiconSmall = SIC_CacheCreateIcon(hDC, SIC_SMALL_SIZE, SIC_CACHE_BITS(lprec));
+                *phiconLarge = SIC_CacheCreateIcon(hDC, SIC_LARGE_SIZE, SIC_CACHE_BITS(lprec) + SIC_CacheIconSize(SIC_SMALL_SIZE));
+                DeleteDC(hDC);
+                ret = TRUE;
+            }
+        }
+    }
+
+    LeaveCriticalSection(&SHELL32_SicCS);
+
+    if (!ret)
+        return FALSE;
+
+    if (!*phiconSmall || !*phiconLarge)
+    {
+        if (*phiconSmall) DestroyIcon(*phiconSmall);
+        if (*phiconLarge) DestroyIcon(*phiconLarge);
+        *phiconSmall = *phiconLarge = NULL;
+        return FALSE;
+    }
+
+    TRACE("-- %s %i from the persistent cache\n", debugstr_w(sSourceFile), dwSourceIndex);
+    return TRUE;
+}
+
+/*****************************************************************************
+ * SIC_CacheStore            [internal]
+ *
+ * Appends a freshly extracted icon pair to the cache file. The record only
+ * becomes visible to processes that open the cache afterwards. A full file
+ * is started over.
+ */
+static void SIC_CacheStore(LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags,
+                           const WIN32_FILE_ATTRIBUTE_DATA *lpSourceData,
+                           HICON hiconSmall, HICON hiconLarge)
+{
+    LPSIC_CACHE_RECORD lprec;
+    LARGE_INTEGER size;
+    DWORD cbRecord, cbWritten;
+    LPBYTE lpBits;
+    HDC hDC;
+    BOOL bDone;
+
+    if (wcslen(sSourceFile) >= MAX_PATH)
+        return;
+
+    lprec = (LPSIC_CACHE_RECORD)HeapAlloc(GetProcessHeap(), 0,
+                                          sizeof(SIC_CACHE_RECORD) + SIC_CACHE_PATH_SIZE(MAX_PATH) +
+                                          SIC_CacheIconSize(SIC_SMALL_SIZE) + SIC_CacheIconSize(SIC_LARGE_SIZE));
+    if (!lprec)
+        return;
+
+    /* The file and the mutex go away in SIC_CacheClose */
+    EnterCriticalSection(&SHELL32_SicCS);
+    if (sic_cache_file == INVALID_HANDLE_VALUE)
+    {
+        LeaveCriticalSection(&SHELL32_SicCS);
+        HeapFree(GetProcessHeap(), 0, lprec);
+        return;
+    }
+
+    cbRecord = SIC_CacheInitRecord(lprec, sSourceFile, dwSourceIndex, dwFlags, lpSourceData);
+    lpBits = SIC_CACHE_BITS(lprec);
+
+    hDC = CreateCompatibleDC(NULL);
+    bDone = hDC &&
+            SIC_CacheGetIconBits(hDC, hiconSmall, SIC_SMALL_SIZE, lpBits) &&
+            SIC_CacheGetIconBits(hDC, hiconLarge, SIC_LARGE_SIZE, lpBits + SIC_CacheIconSize(SIC_SMALL_SIZE));
+    if (hDC)
+        DeleteDC(hDC);
+
+    if (bDone && SIC_CacheLock())
+    {
+        size.QuadPart = 0;
+        bDone = SetFilePointerEx(sic_cache_file, size, &size, FILE_END);
+        if (bDone && size.QuadPart + cbRecord > SIC_CACHE_MAX_SIZE)
+        {
+            /* Our own view has to go for the file to shrink. If another
+               process still maps it, keep using what is there. */
+            SIC_CacheUnmap();
+            if (SIC_CacheTruncate(sizeof(SIC_CACHE_HEADER)))
+                size.QuadPart = sizeof(SIC_CACHE_HEADER);
+            else
+                SIC_CacheMap(size.LowPart);
+        }
+
+        if (bDone && size.QuadPart + cbRecord <= SIC_CACHE_MAX_SIZE)
+        {
+            if (!WriteFile(sic_cache_file, lprec, cbRecord, &cbWritten, NULL) || cbWritten != cbRecord)
+                WARN("Failed to write the icon cache, error %lu\n", GetLastError());
+        }
+        ReleaseMutex(sic_cache_mutex);
+    }
+
+    LeaveCriticalSection(&SHELL32_SicCS);
+    HeapFree(GetProcessHeap(), 0, lprec);
+}
+
 /****************************************************************************
  * SIC_LoadIcon                [internal]
  *
@@ -392,9 +886,26 @@ static INT SIC_LoadIcon (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags)
     HICON hiconLarge=0;
     HICON hiconSmall=0;
     UINT ret;
+    WCHAR path[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA SourceData;
+    DWORD cchPath;
+    BOOL bCacheable;
 
-    PrivateExtractIconsW(sSourceFile, dwSourceIndex, 32, 32, &hiconLarge, NULL, 1, LR_COPYFROMRESOURCE);
-    PrivateExtractIconsW(sSourceFile, dwSourceIndex, 16, 16, &hiconSmall, NULL, 1, LR_COPYFROMRESOURCE);
+    /* The persistent cache is keyed by the full path and the state of the file */
+    cchPath = GetFullPathNameW(sSourceFile, MAX_PATH, path, NULL);
+    bCacheable = cchPath > 0 && cchPath < MAX_PATH &&
+                 GetFileAttributesExW(path, GetFileExInfoStandard, &SourceData);
+
+    if (bCacheable && SIC_CacheLookup(path, dwSourceIndex, dwFlags, &SourceData, &hiconSmall, &hiconLarge))
+    {
+        ret = SIC_IconAppend (sSourceFile, dwSourceIndex, hiconSmall, hiconLarge, dwFlags);
+        DestroyIcon(hiconLarge);
+        DestroyIcon(hiconSmall);
+        return ret;
+    }
+
+    PrivateExtractIconsW(sSourceFile, dwSourceIndex, SIC_LARGE_SIZE, SIC_LARGE_SIZE, &hiconLarge, NULL, 1, LR_COPYFROMRESOURCE);
+    PrivateExtractIconsW(sSourceFile, dwSourceIndex, SIC_SMALL_SIZE, SIC_SMALL_SIZE, &hiconSmall, NULL, 1, LR_COPYFROMRESOURCE);
 
     if ( !hiconLarge ||  !hiconSmall)
     {
@@ -424,6 +935,9 @@ static INT SIC_LoadIcon (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags)
         }
     }
 
+    if (bCacheable)
+        SIC_CacheStore(path, dwSourceIndex, dwFlags, &SourceData, hiconSmall, hiconLarge);
+
     ret = SIC_IconAppend (sSourceFile, dwSourceIndex, hiconSmall, hiconLarge, dwFlags);
     DestroyIcon(hiconLarge);
     DestroyIcon(hiconSmall);
@@ -643,6 +1157,8 @@ void SIC_Destroy(void)
     ImageList_Destroy(ShellBigIconList);
     ShellBigIconList = 0;
 
+    SIC_CacheClose();
+
     LeaveCriticalSection(&SHELL32_SicCS);
     //DeleteCriticalSection(&SHELL32_SicCS); //static
 }
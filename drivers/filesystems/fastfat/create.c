@@ -176,6 +176,17 @@ FindFile(
             ExFreePool(PathNameBuffer);
             return Status;
         }
+
+        /* Large directories are indexed, try that before scanning */
+        if (First && DirContext->DirIndex == 0)
+        {
+            Status = vfatNameIndexFind(DeviceExt, Parent, FileToFindU, DirContext);
+            if (Status != STATUS_MORE_PROCESSING_REQUIRED)
+            {
+                ExFreePool(PathNameBuffer);
+                return Status;
+            }
+        }
     }
 
     /* FsRtlIsNameInExpression need the searched string to be upcase,
@@ -0,0 +1,523 @@
+/*
+ * COPYRIGHT:        See COPYING in the top level directory
+ * PROJECT:          ReactOS kernel
+ * FILE:             drivers/filesystems/fastfat/dirindex.c
+ * PURPOSE:          VFAT Filesystem : name index of large directories
+ *
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include "vfat.h"
+
+#define NDEBUG
+#include <debug.h>
+
+/* GLOBALS ******************************************************************/
+
+/* Smaller directories are scanned, 256 slots are 8KB */
+#define VFAT_NAME_INDEX_MIN_SLOTS   256
+
+/* Memory all indexes together may use */
+#define VFAT_NAME_INDEX_BUDGET      (8 * 1024 * 1024)
+
+/* FUNCTIONS ****************************************************************/
+
+/* Case insensitive, like the name compares done on lookups */
+static
+ULONG
+vfatNameIndexHash(
+    PUNICODE_STRING NameU)
+{
+    ULONG Hash = 0;
+    USHORT i;
+
+    for (i = 0; i < NameU->Length / sizeof(WCHAR); i++)
+    {
+        Hash = Hash * 31 + RtlUpcaseUnicodeChar(NameU->Buffer[i]);
+    }
+
+    return Hash ^ (Hash >> 16);
+}
+
+static
+BOOLEAN
+vfatChargeNameIndex(
+    PVFAT_NAME_INDEX Index,
+    LONG Bytes)
+{
+    if (InterlockedExchangeAdd(&VfatGlobalData->NameIndexBytes, Bytes) + Bytes > VFAT_NAME_INDEX_BUDGET)
+    {
+        InterlockedExchangeAdd(&VfatGlobalData->NameIndexBytes, -Bytes);
+        return FALSE;
+    }
+
+    Index->Bytes += Bytes;
+    return TRUE;
+}
+
+static
+VOID
+vfatUnchargeNameIndex(
+    PVFAT_NAME_INDEX Index,
+    LONG Bytes)
+{
+    InterlockedExchangeAdd(&VfatGlobalData->NameIndexBytes, -Bytes);
+    Index->Bytes -= Bytes;
+}
+
+/*
+ * Doubles the number of chains once they get long. Failing to do so only
+ * makes lookups slower.
+ */
+static
+VOID
+vfatGrowNameIndex(
+    PVFAT_NAME_INDEX Index)
+{
+    PVFAT_NAME_INDEX_ENTRY *Buckets, Entry, Next;
+    ULONG BucketCount, Mask, i;
+    LONG Bytes;
+
+    BucketCount = Index->BucketCount * 2;
+    Bytes = 2 * BucketCount * sizeof(PVFAT_NAME_INDEX_ENTRY);
+    if (!vfatChargeNameIndex(Index, Bytes))
+    {
+        return;
+    }
+
+    Buckets = ExAllocatePoolWithTag(PagedPool, Bytes, TAG_INDEX);
+    if (Buckets == NULL)
+    {
+        vfatUnchargeNameIndex(Index, Bytes);
+        return;
+    }
+    RtlZeroMemory(Buckets, Bytes);
+
+    /* Every entry is on exactly one long chain and one short chain */
+    Mask = BucketCount - 1;
+    for (i = 0; i < Index->BucketCount; i++)
+    {
+        for (Entry = Index->Buckets[i]; Entry != NULL; Entry = Next)
+        {
+            Next = Entry->NextLong;
+            Entry->NextLong = Buckets[Entry->LongHash & Mask];
+            Buckets[Entry->LongHash & Mask] = Entry;
+        }
+
+        for (Entry = Index->Buckets[Index->BucketCount + i]; Entry != NULL; Entry = Next)
+        {
+            Next = Entry->NextShort;
+            Entry->NextShort = Buckets[BucketCount + (Entry->ShortHash & Mask)];
+            Buckets[BucketCount + (Entry->ShortHash & Mask)] = Entry;
+        }
+    }
+
+    ExFreePoolWithTag(Index->Buckets, TAG_INDEX);
+    vfatUnchargeNameIndex(Index, 2 * Index->BucketCount * sizeof(PVFAT_NAME_INDEX_ENTRY));
+    Index->Buckets = Buckets;
+    Index->BucketCount = BucketCount;
+}
+
+static
+BOOLEAN
+vfatInsertNameIndex(
+    PVFAT_NAME_INDEX Index,
+    PVFAT_DIRENTRY_CONTEXT DirContext)
+{
+    PVFAT_NAME_INDEX_ENTRY Entry;
+    ULONG Mask = Index->BucketCount - 1;
+
+    if (!vfatChargeNameIndex(Index, sizeof(VFAT_NAME_INDEX_ENTRY)))
+    {
+        return FALSE;
+    }
+
+    Entry = ExAllocateFromPagedLookasideList(&VfatGlobalData->NameIndexLookasideList);
+    if (Entry == NULL)
+    {
+        vfatUnchargeNameIndex(Index, sizeof(VFAT_NAME_INDEX_ENTRY));
+        return FALSE;
+    }
+
+    Entry->LongHash = vfatNameIndexHash(&DirContext->LongNameU);
+    Entry->ShortHash = vfatNameIndexHash(&DirContext->ShortNameU);
+    Entry->StartIndex = DirContext->StartIndex;
+    Entry->DirIndex = DirContext->DirIndex;
+
+    Entry->NextLong = Index->Buckets[Entry->LongHash & Mask];
+    Index->Buckets[Entry->LongHash & Mask] = Entry;
+    Entry->NextShort = Index->Buckets[Index->BucketCount + (Entry->ShortHash & Mask)];
+    Index->Buckets[Index->BucketCount + (Entry->ShortHash & Mask)] = Entry;
+
+    Index->EntryCount++;
+    if (Index->EntryCount > 2 * Index->BucketCount)
+    {
+        vfatGrowNameIndex(Index);
+    }
+
+    return TRUE;
+}
+
+VOID
+vfatDestroyNameIndex(
+    PVFATFCB DirFcb)
+{
+    PVFAT_NAME_INDEX Index = DirFcb->NameIndex;
+    PVFAT_NAME_INDEX_ENTRY Entry, Next;
+    ULONG i;
+
+    if (Index == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < Index->BucketCount; i++)
+    {
+        for (Entry = Index->Buckets[i]; Entry != NULL; Entry = Next)
+        {
+            Next = Entry->NextLong;
+            ExFreeToPagedLookasideList(&VfatGlobalData->NameIndexLookasideList, Entry);
+        }
+    }
+
+    InterlockedExchangeAdd(&VfatGlobalData->NameIndexBytes, -Index->Bytes);
+    ExFreePoolWithTag(Index->Buckets, TAG_INDEX);
+    ExFreePoolWithTag(Index, TAG_INDEX);
+    DirFcb->NameIndex = NULL;
+}
+
+/*
+ * Reads the whole directory once and indexes every name in it. Returns NULL
+ * when the directory is small enough to scan, or when there isn't memory to
+ * spare for it.
+ */
+static
+PVFAT_NAME_INDEX
+vfatBuildNameIndex(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb)
+{
+    PVFAT_NAME_INDEX Index;
+    VFAT_DIRENTRY_CONTEXT DirContext;
+    WCHAR LongNameBuffer[LONGNAME_MAX_LENGTH + 1];
+    WCHAR ShortNameBuffer[13];
+    PVOID Context = NULL;
+    PVOID Page;
+    ULONG Slots, BucketCount, Next = 0;
+    BOOLEAN First = TRUE;
+    NTSTATUS Status;
+
+    Slots = DirFcb->RFCB.FileSize.u.LowPart / sizeof(FAT_DIR_ENTRY);
+    if (Slots < VFAT_NAME_INDEX_MIN_SLOTS)
+    {
+        return NULL;
+    }
+
+    /* Don't even read the directory if it can't fit with one entry per slot */
+    for (BucketCount = 64; BucketCount < Slots / 4; BucketCount *= 2);
+    if (VfatGlobalData->NameIndexBytes + Slots * sizeof(VFAT_NAME_INDEX_ENTRY) +
+        2 * BucketCount * sizeof(PVFAT_NAME_INDEX_ENTRY) > VFAT_NAME_INDEX_BUDGET)
+    {
+        DPRINT("No room to index '%wZ'\n", &DirFcb->PathNameU);
+        return NULL;
+    }
+
+    Index = ExAllocatePoolWithTag(PagedPool, sizeof(VFAT_NAME_INDEX), TAG_INDEX);
+    if (Index == NULL)
+    {
+        return NULL;
+    }
+    RtlZeroMemory(Index, sizeof(VFAT_NAME_INDEX));
+    Index->BucketCount = BucketCount;
+    Index->FirstFree = MAXULONG;
+
+    if (!vfatChargeNameIndex(Index, 2 * BucketCount * sizeof(PVFAT_NAME_INDEX_ENTRY)))
+    {
+        ExFreePoolWithTag(Index, TAG_INDEX);
+        return NULL;
+    }
+
+    Index->Buckets = ExAllocatePoolWithTag(PagedPool, 2 * BucketCount * sizeof(PVFAT_NAME_INDEX_ENTRY), TAG_INDEX);
+    if (Index->Buckets == NULL)
+    {
+        vfatUnchargeNameIndex(Index, Index->Bytes);
+        ExFreePoolWithTag(Index, TAG_INDEX);
+        return NULL;
+    }
+    RtlZeroMemory(Index->Buckets, 2 * BucketCount * sizeof(PVFAT_NAME_INDEX_ENTRY));
+    DirFcb->NameIndex = Index;
+
+    DirContext.DirIndex = 0;
+    DirContext.DeviceExt = DeviceExt;
+    DirContext.LongNameU.Buffer = LongNameBuffer;
+    DirContext.LongNameU.MaximumLength = sizeof(LongNameBuffer);
+    DirContext.ShortNameU.Buffer = ShortNameBuffer;
+    DirContext.ShortNameU.MaximumLength = sizeof(ShortNameBuffer);
+
+    while (TRUE)
+    {
+        Status = VfatGetNextDirEntry(DeviceExt, &Context, &Page, DirFcb, &DirContext, First);
+        First = FALSE;
+        if (Status == STATUS_NO_MORE_ENTRIES)
+        {
+            break;
+        }
+        if (!NT_SUCCESS(Status))
+        {
+            if (Context)
+            {
+                CcUnpinData(Context);
+            }
+            vfatDestroyNameIndex(DirFcb);
+            return NULL;
+        }
+
+        /* Entries only skip slots that were deleted */
+        if (DirContext.StartIndex > Next && Index->FirstFree == MAXULONG)
+        {
+            Index->FirstFree = Next;
+        }
+        Next = DirContext.DirIndex + 1;
+
+        /* Index what FindFile can find */
+        if (!ENTRY_VOLUME(FALSE, &DirContext.DirEntry) &&
+            DirContext.LongNameU.Length != 0 &&
+            DirContext.ShortNameU.Length != 0)
+        {
+            if (!vfatInsertNameIndex(Index, &DirContext))
+            {
+                CcUnpinData(Context);
+                vfatDestroyNameIndex(DirFcb);
+                return NULL;
+            }
+        }
+
+        DirContext.DirIndex++;
+    }
+
+    if (Index->FirstFree == MAXULONG)
+    {
+        Index->FirstFree = Next;
+    }
+
+    DPRINT("Indexed %u names of '%wZ'\n", Index->EntryCount, &DirFcb->PathNameU);
+    return Index;
+}
+
+/*
+ * Reads an indexed entry back and compares its names, FindFile doesn't
+ * trust hashes. Anything but a match or a mismatch means the index is
+ * stale.
+ */
+static
+NTSTATUS
+vfatCheckNameIndexEntry(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    PVFAT_NAME_INDEX_ENTRY Entry,
+    PUNICODE_STRING FileToFindU,
+    PVFAT_DIRENTRY_CONTEXT DirContext)
+{
+    PVOID Context = NULL;
+    PVOID Page;
+    NTSTATUS Status;
+
+    DirContext->DirIndex = Entry->StartIndex;
+    Status = VfatGetNextDirEntry(DeviceExt, &Context, &Page, DirFcb, DirContext, FALSE);
+    if (Context)
+    {
+        CcUnpinData(Context);
+    }
+    if (!NT_SUCCESS(Status))
+    {
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    if (DirContext->StartIndex != Entry->StartIndex ||
+        DirContext->DirIndex != Entry->DirIndex)
+    {
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    if (RtlEqualUnicodeString(FileToFindU, &DirContext->LongNameU, TRUE) ||
+        RtlEqualUnicodeString(FileToFindU, &DirContext->ShortNameU, TRUE))
+    {
+        return STATUS_SUCCESS;
+    }
+
+    return STATUS_OBJECT_NAME_NOT_FOUND;
+}
+
+/*
+ * Looks a name up like a FindFile from the start of the directory would.
+ * Returns STATUS_MORE_PROCESSING_REQUIRED when the directory has to be
+ * scanned instead.
+ */
+NTSTATUS
+vfatNameIndexFind(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    PUNICODE_STRING FileToFindU,
+    PVFAT_DIRENTRY_CONTEXT DirContext)
+{
+    PVFAT_NAME_INDEX Index;
+    PVFAT_NAME_INDEX_ENTRY Entry, Best = NULL, Current = NULL;
+    ULONG Hash, Mask;
+    NTSTATUS Status;
+
+    if (vfatVolumeIsFatX(DeviceExt))
+    {
+        return STATUS_MORE_PROCESSING_REQUIRED;
+    }
+
+    Index = DirFcb->NameIndex;
+    if (Index == NULL)
+    {
+        Index = vfatBuildNameIndex(DeviceExt, DirFcb);
+        if (Index == NULL)
+        {
+            return STATUS_MORE_PROCESSING_REQUIRED;
+        }
+    }
+
+    Hash = vfatNameIndexHash(FileToFindU);
+    Mask = Index->BucketCount - 1;
+
+    /* A scan returns the first match, so keep the lowest one */
+    for (Entry = Index->Buckets[Hash & Mask]; Entry != NULL; Entry = Entry->NextLong)
+    {
+        if (Entry->LongHash != Hash || (Best && Entry->StartIndex > Best->StartIndex))
+        {
+            continue;
+        }
+
+        Status = vfatCheckNameIndexEntry(DeviceExt, DirFcb, Entry, FileToFindU, DirContext);
+        if (Status == STATUS_UNSUCCESSFUL)
+        {
+            vfatDestroyNameIndex(DirFcb);
+            return STATUS_MORE_PROCESSING_REQUIRED;
+        }
+        Current = Entry;
+        if (NT_SUCCESS(Status))
+        {
+            Best = Entry;
+        }
+    }
+
+    for (Entry = Index->Buckets[Index->BucketCount + (Hash & Mask)]; Entry != NULL; Entry = Entry->NextShort)
+    {
+        /* Checked on the long chain already */
+        if (Entry->ShortHash != Hash || Entry->LongHash == Hash ||
+            (Best && Entry->StartIndex > Best->StartIndex))
+        {
+            continue;
+        }
+
+        Status = vfatCheckNameIndexEntry(DeviceExt, DirFcb, Entry, FileToFindU, DirContext);
+        if (Status == STATUS_UNSUCCESSFUL)
+        {
+            vfatDestroyNameIndex(DirFcb);
+            return STATUS_MORE_PROCESSING_REQUIRED;
+        }
+        Current = Entry;
+        if (NT_SUCCESS(Status))
+        {
+            Best = Entry;
+        }
+    }
+
+    if (Best == NULL)
+    {
+        /* Leave the context where a scan would have */
+        DirContext->DirIndex = DirFcb->RFCB.FileSize.u.LowPart / sizeof(FAT_DIR_ENTRY);
+        return STATUS_NO_MORE_ENTRIES;
+    }
+
+    if (Best != Current &&
+        vfatCheckNameIndexEntry(DeviceExt, DirFcb, Best, FileToFindU, DirContext) != STATUS_SUCCESS)
+    {
+        vfatDestroyNameIndex(DirFcb);
+        return STATUS_MORE_PROCESSING_REQUIRED;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+/*
+ * Called once a new entry is on disk. If it can't be indexed, the index
+ * goes away and lookups scan again.
+ */
+VOID
+vfatNameIndexAdd(
+    PVFATFCB DirFcb,
+    PVFAT_DIRENTRY_CONTEXT DirContext)
+{
+    PVFAT_NAME_INDEX Index = DirFcb->NameIndex;
+
+    if (Index == NULL)
+    {
+        return;
+    }
+
+    if (!vfatInsertNameIndex(Index, DirContext))
+    {
+        vfatDestroyNameIndex(DirFcb);
+        return;
+    }
+
+    /* The slots after the new entry may be used too, that's fine */
+    if (DirContext->StartIndex == Index->FirstFree)
+    {
+        Index->FirstFree = DirContext->DirIndex + 1;
+    }
+}
+
+/*
+ * Called once the entry of Fcb is deleted on disk.
+ */
+VOID
+vfatNameIndexRemove(
+    PVFATFCB DirFcb,
+    PVFATFCB Fcb)
+{
+    PVFAT_NAME_INDEX Index = DirFcb->NameIndex;
+    PVFAT_NAME_INDEX_ENTRY Entry, *Link;
+    ULONG Mask;
+
+    if (Index == NULL)
+    {
+        return;
+    }
+
+    Mask = Index->BucketCount - 1;
+    for (Link = &Index->Buckets[vfatNameIndexHash(&Fcb->LongNameU) & Mask];
+         *Link != NULL && (*Link)->DirIndex != Fcb->dirIndex;
+         Link = &(*Link)->NextLong);
+
+    if (*Link == NULL)
+    {
+        DPRINT1("'%wZ' is missing from the name index\n", &Fcb->PathNameU);
+        vfatDestroyNameIndex(DirFcb);
+        return;
+    }
+
+    Entry = *Link;
+    *Link = Entry->NextLong;
+
+    for (Link = &Index->Buckets[Index->BucketCount + (Entry->ShortHash & Mask)];
+         *Link != Entry;
+         Link = &(*Link)->NextShort);
+    *Link = Entry->NextShort;
+
+    if (Entry->StartIndex < Index->FirstFree)
+    {
+        Index->FirstFree = Entry->StartIndex;
+    }
+
+    ExFreeToPagedLookasideList(&VfatGlobalData->NameIndexLookasideList, Entry);
+    vfatUnchargeNameIndex(Index, sizeof(VFAT_NAME_INDEX_ENTRY));
+    Index->EntryCount--;
+}
+
+/* EOF */
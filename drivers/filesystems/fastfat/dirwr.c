@@ -264,11 +264,12 @@ vfatFindDirSpace(
     OUT PULONG start)
 {
     LARGE_INTEGER FileOffset;
-    ULONG i, count, size, nbFree = 0;
+    ULONG i, first, count, size, nbFree = 0;
     PDIR_ENTRY pFatEntry = NULL;
     PVOID Context = NULL;
     NTSTATUS Status;
     ULONG SizeDirEntry;
+    BOOLEAN FreeFound = FALSE;
     BOOLEAN IsFatX = vfatVolumeIsFatX(DeviceExt);
     FileOffset.QuadPart = 0;
 
@@ -285,7 +286,16 @@ vfatFindDirSpace(
 
     count = pDirFcb->RFCB.FileSize.u.LowPart / SizeDirEntry;
     size = DeviceExt->FatInfo.BytesPerCluster / SizeDirEntry;
-    for (i = 0; i < count; i++, pFatEntry = (PDIR_ENTRY)((ULONG_PTR)pFatEntry + SizeDirEntry))
+
+    /* An indexed directory knows where its first free slot is */
+    first = 0;
+    if (pDirFcb->NameIndex != NULL)
+    {
+        first = min(pDirFcb->NameIndex->FirstFree, count);
+        FileOffset.u.LowPart = ROUND_DOWN(first * SizeDirEntry, DeviceExt->FatInfo.BytesPerCluster);
+    }
+
+    for (i = first; i < count; i++, pFatEntry = (PDIR_ENTRY)((ULONG_PTR)pFatEntry + SizeDirEntry))
     {
         if (Context == NULL || (i % size) == 0)
         {
@@ -303,6 +313,7 @@ vfatFindDirSpace(
             }
             _SEH2_END;
 
+            pFatEntry = (PDIR_ENTRY)((ULONG_PTR)pFatEntry + (i % size) * SizeDirEntry);
             FileOffset.u.LowPart += DeviceExt->FatInfo.BytesPerCluster;
         }
         if (ENTRY_END(IsFatX, pFatEntry))
@@ -311,6 +322,11 @@ vfatFindDirSpace(
         }
         if (ENTRY_DELETED(IsFatX, pFatEntry))
         {
+            if (!FreeFound && pDirFcb->NameIndex != NULL)
+            {
+                pDirFcb->NameIndex->FirstFree = i;
+            }
+            FreeFound = TRUE;
             nbFree++;
         }
         else
@@ -327,6 +343,11 @@ vfatFindDirSpace(
         CcUnpinData(Context);
         Context = NULL;
     }
+    if (!FreeFound && pDirFcb->NameIndex != NULL)
+    {
+        /* No deleted entry, the first free one is at the end */
+        pDirFcb->NameIndex->FirstFree = i;
+    }
     if (nbFree == nbSlots)
     {
         /* found enough contiguous free slots */
@@ -763,6 +784,8 @@ FATAddEntry(
     CcSetDirtyPinnedData(Context, NULL);
     CcUnpinData(Context);
 
+    vfatNameIndexAdd(ParentFcb, &DirContext);
+
     if (MoveContext != NULL)
     {
         /* We're modifying an existing FCB - likely rename/move */
@@ -1023,6 +1046,8 @@ FATDelEntry(
         CcUnpinData(Context);
     }
 
+    vfatNameIndexRemove(pFcb->parentFcb, pFcb);
+
     /* In case of moving, don't delete data */
     if (MoveContext == NULL)
     {
@@ -279,6 +279,7 @@ vfatDestroyFCB(
 #endif
 
     FsRtlUninitializeFileLock(&pFCB->FileLock);
+    vfatDestroyNameIndex(pFCB);
     if (!vfatFCBIsRoot(pFCB) &&
         !BooleanFlagOn(pFCB->Flags, FCB_IS_FAT) && !BooleanFlagOn(pFCB->Flags, FCB_IS_VOLUME))
     {
@@ -816,6 +817,16 @@ vfatDirFindFile(
     DirContext.ShortNameU.MaximumLength = sizeof(ShortNameBuffer);
     DirContext.DeviceExt = pDeviceExt;
 
+    status = vfatNameIndexFind(pDeviceExt, pDirectoryFCB, FileToFindU, &DirContext);
+    if (status == STATUS_SUCCESS)
+    {
+        return vfatMakeFCBFromDirEntry(pDeviceExt, pDirectoryFCB, &DirContext, pFoundFCB);
+    }
+    if (status == STATUS_NO_MORE_ENTRIES)
+    {
+        return STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+
     while (TRUE)
     {
         status = VfatGetNextDirEntry(pDeviceExt,
@@ -408,12 +408,37 @@ typedef struct
     NPAGED_LOOKASIDE_LIST FcbLookasideList;
     NPAGED_LOOKASIDE_LIST CcbLookasideList;
     NPAGED_LOOKASIDE_LIST IrpContextLookasideList;
+    PAGED_LOOKASIDE_LIST NameIndexLookasideList;
+    LONG NameIndexBytes;
     FAST_IO_DISPATCH FastIoDispatch;
     CACHE_MANAGER_CALLBACKS CacheMgrCallbacks;
 } VFAT_GLOBAL_DATA, *PVFAT_GLOBAL_DATA;
 
 extern PVFAT_GLOBAL_DATA VfatGlobalData;
 
+/* Directory name index entry, one per file */
+typedef struct _VFAT_NAME_INDEX_ENTRY
+{
+    struct _VFAT_NAME_INDEX_ENTRY *NextLong;
+    struct _VFAT_NAME_INDEX_ENTRY *NextShort;
+    ULONG LongHash;
+    ULONG ShortHash;
+    ULONG StartIndex;
+    ULONG DirIndex;
+} VFAT_NAME_INDEX_ENTRY, *PVFAT_NAME_INDEX_ENTRY;
+
+typedef struct _VFAT_NAME_INDEX
+{
+    /* Long name chains followed by short name chains */
+    PVFAT_NAME_INDEX_ENTRY *Buckets;
+    ULONG BucketCount;
+    ULONG EntryCount;
+    /* Every slot below this one is in use */
+    ULONG FirstFree;
+    /* Charged against VfatGlobalData->NameIndexBytes */
+    LONG Bytes;
+} VFAT_NAME_INDEX, *PVFAT_NAME_INDEX;
+
 #define FCB_CACHE_INITIALIZED   0x0001
 #define FCB_DELETE_PENDING      0x0002
 #define FCB_IS_FAT              0x0004
@@ -487,6 +512,9 @@ typedef struct _VFATFCB
     /* Directory index where the long name starts */
     ULONG startIndex;
 
+    /* Name index of a large directory, built on first lookup */
+    PVFAT_NAME_INDEX NameIndex;
+
     /* Share access for the file object */
     SHARE_ACCESS FCBShareAccess;
 
@@ -528,6 +556,7 @@ typedef struct _VFATCCB
 #define TAG_FCB  'BCFV'
 #define TAG_IRP  'PRIV'
 #define TAG_VFAT 'TAFV'
+#define TAG_INDEX 'XDIV'
 
 #define ENTRIES_PER_SECTOR (BLOCKSIZE / sizeof(FATDirEntry))
 
@@ -749,6 +778,29 @@ vfatDirEntryGetFirstCluster(
     PDEVICE_EXTENSION pDeviceExt,
     PDIR_ENTRY pDirEntry);
 
+/* dirindex.c */
+
+NTSTATUS
+vfatNameIndexFind(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    PUNICODE_STRING FileToFindU,
+    PVFAT_DIRENTRY_CONTEXT DirContext);
+
+VOID
+vfatNameIndexAdd(
+    PVFATFCB DirFcb,
+    PVFAT_DIRENTRY_CONTEXT DirContext);
+
+VOID
+vfatNameIndexRemove(
+    PVFATFCB DirFcb,
+    PVFATFCB Fcb);
+
+VOID
+vfatDestroyNameIndex(
+    PVFATFCB DirFcb);
+
 /* dirwr.c */
 
 NTSTATUS
@@ -306,6 +306,9 @@ MiniIndicateReceivePacket(
     PADAPTER_BINDING AdapterBinding;
     KIRQL OldIrql;
     UINT i;
+    PVOID LookAheadBuffer = NULL;
+    UINT LookAheadBufferSize = 0;
+    BOOLEAN IndicatedLegacy;
 
     KeAcquireSpinLock(&Adapter->NdisMiniportBlock.Lock, &OldIrql);
 
@@ -314,6 +317,7 @@ MiniIndicateReceivePacket(
     while (CurrentEntry != &Adapter->ProtocolListHead)
     {
         AdapterBinding = CONTAINING_RECORD(CurrentEntry, ADAPTER_BINDING, AdapterListEntry);
+        IndicatedLegacy = FALSE;
 
         for (i = 0; i < NumberOfPackets; i++)
         {
@@ -333,7 +337,7 @@ MiniIndicateReceivePacket(
             {
                 UINT FirstBufferLength, TotalBufferLength, LookAheadSize, HeaderSize;
                 PNDIS_BUFFER NdisBuffer;
-                PVOID NdisBufferVA, LookAheadBuffer;
+                PVOID NdisBufferVA;
 
                 NdisGetFirstBufferFromPacket(PacketArray[i],
                                              &NdisBuffer,
@@ -345,12 +349,21 @@ MiniIndicateReceivePacket(
 
                 LookAheadSize = TotalBufferLength - HeaderSize;
 
-                LookAheadBuffer = ExAllocatePool(NonPagedPool, LookAheadSize);
-                if (!LookAheadBuffer)
+                /* One lookahead buffer serves the whole packet array */
+                if (LookAheadSize > LookAheadBufferSize)
                 {
-                    NDIS_DbgPrint(MIN_TRACE, ("Failed to allocate lookahead buffer!\n"));
-                    KeReleaseSpinLock(&Adapter->NdisMiniportBlock.Lock, OldIrql);
-                    return;
+                    if (LookAheadBuffer)
+                        ExFreePool(LookAheadBuffer);
+
+                    LookAheadBuffer = ExAllocatePool(NonPagedPool, LookAheadSize);
+                    if (!LookAheadBuffer)
+                    {
+                        NDIS_DbgPrint(MIN_TRACE, ("Failed to allocate lookahead buffer!\n"));
+                        LookAheadBufferSize = 0;
+                        continue;
+                    }
+
+                    LookAheadBufferSize = LookAheadSize;
                 }
 
                 CopyBufferChainToBuffer(LookAheadBuffer,
@@ -368,13 +381,23 @@ MiniIndicateReceivePacket(
                      LookAheadSize,
                      TotalBufferLength - HeaderSize);
 
-                ExFreePool(LookAheadBuffer);
+                IndicatedLegacy = TRUE;
             }
         }
 
+        /* Legacy receivers expect a single ReceiveComplete per indication burst */
+        if (IndicatedLegacy && AdapterBinding->ProtocolBinding->Chars.ReceiveCompleteHandler)
+        {
+            (*AdapterBinding->ProtocolBinding->Chars.ReceiveCompleteHandler)(
+                 AdapterBinding->NdisOpenBlock.ProtocolBindingContext);
+        }
+
         CurrentEntry = CurrentEntry->Flink;
     }
 
+    if (LookAheadBuffer)
+        ExFreePool(LookAheadBuffer);
+
     /* Loop the packet array to get everything
      * set up for return the packets to the miniport */
     for (i = 0; i < NumberOfPackets; i++)
@@ -565,66 +565,191 @@ ProSend(
     }
 }
 
-VOID NTAPI
-ProSendPackets(
-    IN  NDIS_HANDLE     NdisBindingHandle,
-    IN  PPNDIS_PACKET   PacketArray,
-    IN  UINT            NumberOfPackets)
+static VOID
+proQueueSendPackets(
+    PLOGICAL_ADAPTER Adapter,
+    PPNDIS_PACKET    PacketArray,
+    UINT             NumberOfPackets)
+/*
+ * FUNCTION: Moves a run of packets to the adapter's work queue
+ * ARGUMENTS:
+ *     Adapter         = Pointer to logical adapter
+ *     PacketArray     = Array of packets, all already tagged with their binding
+ *     NumberOfPackets = Number of packets in PacketArray
+ * NOTES:
+ *     - Only queues, like the busy path of proSendPacketToMiniport. The
+ *       worker is already running or is restarted by the next send
+ *       completion or MiniSendResourcesAvailable
+ */
+{
+    UINT i;
+
+    for (i = 0; i < NumberOfPackets; i++)
+        MiniQueueWorkItem(Adapter, NdisWorkItemSend, PacketArray[i], FALSE);
+}
+
+static VOID
+proSendPacketsToMiniport(
+    PLOGICAL_ADAPTER Adapter,
+    PPNDIS_PACKET    PacketArray,
+    UINT             NumberOfPackets)
+/*
+ * FUNCTION: Hands a run of packets to the miniport in as few calls as possible
+ * ARGUMENTS:
+ *     Adapter         = Pointer to logical adapter
+ *     PacketArray     = Array of packets, all already tagged with their binding
+ *     NumberOfPackets = Number of packets in PacketArray
+ * NOTES:
+ *     - Every packet is either pending in the miniport, queued for the worker
+ *       or completed through MiniSendComplete when this returns
+ *     - If a serialized miniport runs out of resources, the failed packet
+ *       and everything after it are requeued in order
+ */
 {
-    PADAPTER_BINDING AdapterBinding = NdisBindingHandle;
-    PLOGICAL_ADAPTER Adapter = AdapterBinding->Adapter;
     KIRQL RaiseOldIrql;
     NDIS_STATUS NdisStatus;
     UINT i;
 
+    if (MiniIsBusy(Adapter, NdisWorkItemSend)) {
+        proQueueSendPackets(Adapter, PacketArray, NumberOfPackets);
+        return;
+    }
+
     if(Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)
     {
-       if(Adapter->NdisMiniportBlock.Flags & NDIS_ATTRIBUTE_DESERIALIZE)
-       {
-          (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)(
-           Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray, NumberOfPackets);
-       }
-       else
-       {
-          /* SendPackets is called at DISPATCH_LEVEL for all serialized miniports */
-          KeRaiseIrql(DISPATCH_LEVEL, &RaiseOldIrql);
-          (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)(
-           Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray, NumberOfPackets);
-          KeLowerIrql(RaiseOldIrql);
-          for (i = 0; i < NumberOfPackets; i++)
-          {
-             NdisStatus = NDIS_GET_PACKET_STATUS(PacketArray[i]);
-             if (NdisStatus != NDIS_STATUS_PENDING)
-                 MiniSendComplete(Adapter, PacketArray[i], NdisStatus);
-          }
-       }
-     }
-     else
-     {
-       if(Adapter->NdisMiniportBlock.Flags & NDIS_ATTRIBUTE_DESERIALIZE)
-       {
-          for (i = 0; i < NumberOfPackets; i++)
-          {
-             NdisStatus = (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendHandler)(
-                           Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray[i], PacketArray[i]->Private.Flags);
-             if (NdisStatus != NDIS_STATUS_PENDING)
-                 MiniSendComplete(Adapter, PacketArray[i], NdisStatus);
-          }
-       }
-       else
-       {
-         /* Send is called at DISPATCH_LEVEL for all serialized miniports */
-         KeRaiseIrql(DISPATCH_LEVEL, &RaiseOldIrql);
-         for (i = 0; i < NumberOfPackets; i++)
-         {
-            NdisStatus = (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendHandler)(
-                           Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray[i], PacketArray[i]->Private.Flags);
+        if(Adapter->NdisMiniportBlock.Flags & NDIS_ATTRIBUTE_DESERIALIZE)
+        {
+            /* Deserialized miniports complete every packet themselves */
+            NDIS_DbgPrint(MAX_TRACE, ("Calling miniport's SendPackets handler (%d packets)\n", NumberOfPackets));
+            (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)(
+             Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray, NumberOfPackets);
+            return;
+        }
+
+        /* SendPackets is called at DISPATCH_LEVEL for all serialized miniports */
+        KeRaiseIrql(DISPATCH_LEVEL, &RaiseOldIrql);
+        NDIS_DbgPrint(MAX_TRACE, ("Calling miniport's SendPackets handler (%d packets)\n", NumberOfPackets));
+        (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)(
+         Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray, NumberOfPackets);
+        KeLowerIrql(RaiseOldIrql);
+
+        for (i = 0; i < NumberOfPackets; i++)
+        {
+            NdisStatus = NDIS_GET_PACKET_STATUS(PacketArray[i]);
+            if (NdisStatus == NDIS_STATUS_RESOURCES)
+            {
+                MiniQueueWorkItem(Adapter, NdisWorkItemSend, PacketArray[i], TRUE);
+                proQueueSendPackets(Adapter, &PacketArray[i + 1], NumberOfPackets - i - 1);
+                break;
+            }
+
             if (NdisStatus != NDIS_STATUS_PENDING)
                 MiniSendComplete(Adapter, PacketArray[i], NdisStatus);
-         }
-         KeLowerIrql(RaiseOldIrql);
-       }
-     }
+        }
+    }
+    else
+    {
+        if(Adapter->NdisMiniportBlock.Flags & NDIS_ATTRIBUTE_DESERIALIZE)
+        {
+            for (i = 0; i < NumberOfPackets; i++)
+            {
+                NDIS_DbgPrint(MAX_TRACE, ("Calling miniport's Send handler\n"));
+                NdisStatus = (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendHandler)(
+                              Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray[i], PacketArray[i]->Private.Flags);
+                if (NdisStatus != NDIS_STATUS_PENDING)
+                    MiniSendComplete(Adapter, PacketArray[i], NdisStatus);
+            }
+        }
+        else
+        {
+            /* Send is called at DISPATCH_LEVEL for all serialized miniports */
+            KeRaiseIrql(DISPATCH_LEVEL, &RaiseOldIrql);
+            for (i = 0; i < NumberOfPackets; i++)
+            {
+                NDIS_DbgPrint(MAX_TRACE, ("Calling miniport's Send handler\n"));
+                NdisStatus = (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendHandler)(
+                              Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray[i], PacketArray[i]->Private.Flags);
+                if (NdisStatus == NDIS_STATUS_RESOURCES)
+                {
+                    MiniQueueWorkItem(Adapter, NdisWorkItemSend, PacketArray[i], TRUE);
+                    proQueueSendPackets(Adapter, &PacketArray[i + 1], NumberOfPackets - i - 1);
+                    break;
+                }
+
+                if (NdisStatus != NDIS_STATUS_PENDING)
+                    MiniSendComplete(Adapter, PacketArray[i], NdisStatus);
+            }
+            KeLowerIrql(RaiseOldIrql);
+        }
+    }
+}
+
+VOID NTAPI
+ProSendPackets(
+    IN  NDIS_HANDLE     NdisBindingHandle,
+    IN  PPNDIS_PACKET   PacketArray,
+    IN  UINT            NumberOfPackets)
+/*
+ * FUNCTION: Forwards an array of packets to an NDIS miniport
+ * ARGUMENTS:
+ *     NdisBindingHandle = Adapter binding handle
+ *     PacketArray       = Array of pointers to NDIS packet descriptors
+ *     NumberOfPackets   = Number of packets in PacketArray
+ * NOTES:
+ *     - Completion of every packet is reported through the protocol's
+ *       SendComplete handler, never through a return value
+ *     - Runs of ordinary packets reach the miniport in a single call; MAC
+ *       loopback packets and scatter/gather adapters go through ProSend
+ */
+{
+    PADAPTER_BINDING AdapterBinding;
+    PLOGICAL_ADAPTER Adapter;
+    NDIS_STATUS NdisStatus;
+    KIRQL OldIrql;
+    UINT i, RunStart;
+
+    NDIS_DbgPrint(MAX_TRACE, ("Called. (%d packets)\n", NumberOfPackets));
+
+    ASSERT(NdisBindingHandle);
+    AdapterBinding = GET_ADAPTER_BINDING(NdisBindingHandle);
+
+    ASSERT(AdapterBinding->Adapter);
+    Adapter = AdapterBinding->Adapter;
+
+    ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+
+    RunStart = 0;
+    for (i = 0; i < NumberOfPackets; i++)
+    {
+        PacketArray[i]->Reserved[1] = (ULONG_PTR)NdisBindingHandle;
+
+        if (Adapter->NdisMiniportBlock.ScatterGatherListSize == 0 &&
+            !((Adapter->NdisMiniportBlock.MacOptions & NDIS_MAC_OPTION_NO_LOOPBACK) &&
+              MiniAdapterHasAddress(Adapter, PacketArray[i])))
+        {
+            /* Part of the current run */
+            continue;
+        }
+
+        /* Flush the run collected so far to keep the packets in order */
+        if (i != RunStart)
+            proSendPacketsToMiniport(Adapter, &PacketArray[RunStart], i - RunStart);
+        RunStart = i + 1;
+
+        NdisStatus = ProSend(NdisBindingHandle, PacketArray[i]);
+        if (NdisStatus != NDIS_STATUS_PENDING)
+        {
+            KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+            (*AdapterBinding->ProtocolBinding->Chars.SendCompleteHandler)(
+                AdapterBinding->NdisOpenBlock.ProtocolBindingContext,
+                PacketArray[i],
+                NdisStatus);
+            KeLowerIrql(OldIrql);
+        }
+    }
+
+    if (i != RunStart)
+        proSendPacketsToMiniport(Adapter, &PacketArray[RunStart], i - RunStart);
 }
 
 NDIS_STATUS NTAPI
@@ -951,6 +951,69 @@ VOID NTAPI ProtocolBindAdapter(
 }
 
 
+static VOID LanQueueXmitPacket(
+    PLAN_ADAPTER Adapter,
+    PNDIS_PACKET XmitPacket)
+/*
+ * FUNCTION: Queues a framed packet for the adapter and drains the queue
+ * ARGUMENTS:
+ *     Adapter    = Pointer to LAN_ADAPTER structure
+ *     XmitPacket = Pointer to a framed NDIS packet owned by us
+ * NOTES:
+ *     Only one caller drains the queue at a time. Packets queued while a
+ *     batch is inside NdisSendPackets are sent by the draining caller, so
+ *     bursts reach the miniport in arrays of up to MaxSendPackets packets.
+ *     NDIS reports completion of every packet through ProtocolSendComplete.
+ */
+{
+    PNDIS_PACKET PacketArray[LAN_MAX_SEND_BATCH];
+    UINT BatchSize, Count;
+    KIRQL OldIrql;
+
+    /* The packet context of our own transmit packets links the queue */
+    PC(XmitPacket)->Context = NULL;
+
+    BatchSize = min(max(Adapter->MaxSendPackets, 1), LAN_MAX_SEND_BATCH);
+
+    TcpipAcquireSpinLock(&Adapter->Lock, &OldIrql);
+
+    if (Adapter->XmitQueueTail)
+        PC(Adapter->XmitQueueTail)->Context = XmitPacket;
+    else
+        Adapter->XmitQueueHead = XmitPacket;
+    Adapter->XmitQueueTail = XmitPacket;
+
+    if (Adapter->XmitBusy) {
+        /* Whoever is sending right now picks this packet up */
+        TcpipReleaseSpinLock(&Adapter->Lock, OldIrql);
+        return;
+    }
+
+    Adapter->XmitBusy = TRUE;
+
+    while (Adapter->XmitQueueHead) {
+        for (Count = 0; Count < BatchSize && Adapter->XmitQueueHead; Count++) {
+            PacketArray[Count] = Adapter->XmitQueueHead;
+            Adapter->XmitQueueHead = PC(PacketArray[Count])->Context;
+        }
+
+        if (!Adapter->XmitQueueHead)
+            Adapter->XmitQueueTail = NULL;
+
+        TcpipReleaseSpinLock(&Adapter->Lock, OldIrql);
+
+        TI_DbgPrint(MID_TRACE, ("NdisSendPackets (%d packets)\n", Count));
+        NdisSendPackets(Adapter->NdisHandle, PacketArray, Count);
+
+        TcpipAcquireSpinLock(&Adapter->Lock, &OldIrql);
+    }
+
+    Adapter->XmitBusy = FALSE;
+
+    TcpipReleaseSpinLock(&Adapter->Lock, OldIrql);
+}
+
+
 VOID LANTransmit(
     PVOID Context,
     PNDIS_PACKET NdisPacket,
@@ -972,7 +1035,6 @@ VOID LANTransmit(
     PCHAR Data, OldData;
     UINT Size, OldSize;
     PLAN_ADAPTER Adapter = (PLAN_ADAPTER)Context;
-    KIRQL OldIrql;
     PNDIS_PACKET XmitPacket;
     PIP_INTERFACE Interface = Adapter->Context;
 
@@ -1065,20 +1127,7 @@ VOID LANTransmit(
     /* Update interface stats */
     Interface->Stats.OutBytes += Size;
 
-	TcpipAcquireSpinLock( &Adapter->Lock, &OldIrql );
-	TI_DbgPrint(MID_TRACE, ("NdisSend\n"));
-	NdisSend(&NdisStatus, Adapter->NdisHandle, XmitPacket);
-	TI_DbgPrint(MID_TRACE, ("NdisSend %s\n",
-				NdisStatus == NDIS_STATUS_PENDING ?
-				"Pending" : "Complete"));
-	TcpipReleaseSpinLock( &Adapter->Lock, OldIrql );
-
-	/* I had a talk with vizzini: these really ought to be here.
-	 * we're supposed to see these completed by ndis *only* when
-	 * status_pending is returned.  Note that this is different from
-	 * the situation with IRPs. */
-        if (NdisStatus != NDIS_STATUS_PENDING)
-            ProtocolSendComplete((NDIS_HANDLE)Context, XmitPacket, NdisStatus);
+    LanQueueXmitPacket(Adapter, XmitPacket);
 }
 
 static NTSTATUS
@@ -35,6 +35,9 @@ typedef struct ETH_HEADER {
 /* Max packets queued for a single adapter */
 #define IP_MAX_RECV_BACKLOG 0x20
 
+/* Max packets handed to NdisSendPackets in one call */
+#define LAN_MAX_SEND_BATCH 0x10
+
 /* Per adapter information */
 typedef struct LAN_ADAPTER {
     LIST_ENTRY ListEntry;                   /* Entry on list */
@@ -59,6 +62,9 @@ typedef struct LAN_ADAPTER {
     UINT MacOptions;                        /* MAC options for NIC driver/adapter */
     UINT Speed;                             /* Link speed */
     UINT PacketFilter;                      /* Packet filter for this adapter */
+    PNDIS_PACKET XmitQueueHead;             /* Framed packets waiting for NdisSendPackets */
+    PNDIS_PACKET XmitQueueTail;             /* Last packet on the transmit queue */
+    BOOLEAN XmitBusy;                       /* A caller is draining the transmit queue */
 } LAN_ADAPTER, *PLAN_ADAPTER;
 
 /* LAN adapter state constants */
@@ -118,6 +118,16 @@ AhciPortInitialize (
                                                                                   PortExtension->IdentifyDeviceData,
                                                                                   &mappedLength);
 
+    PortExtension->RecoveryCommandTablePhysicalAddress = StorPortGetPhysicalAddress(adapterExtension,
+                                                                                    NULL,
+                                                                                    PortExtension->RecoveryCommandTable,
+                                                                                    &mappedLength);
+
+    PortExtension->NcqErrorLogPhysicalAddress = StorPortGetPhysicalAddress(adapterExtension,
+                                                                           NULL,
+                                                                           PortExtension->NcqErrorLog,
+                                                                           &mappedLength);
+
     // set device power state flag to D0
     PortExtension->DevicePowerState = StorPowerDeviceD0;
 
@@ -172,7 +182,9 @@ AhciAllocateResourceForAdapter (
     AdapterExtension->PortCount = portCount;
     nonCachedExtensionSize =    sizeof(AHCI_COMMAND_HEADER) * AlignedNCS + //should be 1K aligned
                                 sizeof(AHCI_RECEIVED_FIS) +
-                                sizeof(IDENTIFY_DEVICE_DATA);
+                                sizeof(IDENTIFY_DEVICE_DATA) +
+                                sizeof(AHCI_COMMAND_TABLE) + // should be 128 byte aligned
+                                DEVICE_ATA_BLOCK_SIZE;       // NCQ command error log
 
     // align nonCachedExtensionSize to 1024
     nonCachedExtensionSize = ROUND_UP(nonCachedExtensionSize, 1024);
@@ -206,6 +218,11 @@ AhciAllocateResourceForAdapter (
 
             PortExtension->ReceivedFIS = (PAHCI_RECEIVED_FIS)tmp;
             PortExtension->IdentifyDeviceData = (PIDENTIFY_DEVICE_DATA)(tmp + sizeof(AHCI_RECEIVED_FIS));
+
+            tmp = (PCHAR)(PortExtension->IdentifyDeviceData + 1);
+
+            PortExtension->RecoveryCommandTable = (PAHCI_COMMAND_TABLE)tmp;
+            PortExtension->NcqErrorLog = (PUCHAR)(tmp + sizeof(AHCI_COMMAND_TABLE));
             PortExtension->MaxPortQueueDepth = NCS;
             nonCachedExtension += nonCachedExtensionSize;
         }
@@ -499,6 +516,7 @@ AhciHwPassiveInitialize (
             PortExtension = &AdapterExtension->PortExtension[index];
             PortExtension->DeviceParams.IsActive = AhciStartPort(PortExtension);
             StorPortInitializeDpc(AdapterExtension, &PortExtension->CommandCompletion, AhciCommandCompletionDpcRoutine);
+            StorPortInitializeDpc(AdapterExtension, &PortExtension->PortRecovery, AhciPortRecoveryDpcRoutine);
         }
     }
 
@@ -591,6 +609,9 @@ AhciCompleteIssuedSrb (
             SrbExtension = GetSrbExtension(Srb);
             NT_ASSERT(SrbExtension != NULL);
 
+            PortExtension->Slot[i] = NULL;
+            PortExtension->NcqSlots &= ~(1 << i);
+
             if (SrbExtension->CompletionRoutine != NULL)
             {
                 AddQueue(&PortExtension->CompletionQueue, Srb);
@@ -608,6 +629,398 @@ AhciCompleteIssuedSrb (
     return;
 }// -- AhciCompleteIssuedSrb();
 
+/**
+ * @name AhciAbortSlots
+ * @implemented
+ *
+ * Take Srbs out of their command slots, either to complete them with
+ * the given status or, for SRB_STATUS_PENDING, to issue them again later
+ *
+ * @param PortExtension
+ * @param Slots
+ * @param SrbStatus
+ *
+ */
+VOID
+AhciAbortSlots (
+    __in PAHCI_PORT_EXTENSION PortExtension,
+    __in ULONG Slots,
+    __in UCHAR SrbStatus
+    )
+{
+    ULONG i;
+    PSCSI_REQUEST_BLOCK Srb;
+
+    AhciDebugPrint("AhciAbortSlots()\n");
+    AhciDebugPrint("\tSlots: %x SrbStatus: %x\n", Slots, SrbStatus);
+
+    for (i = 0; i < MAXIMUM_AHCI_PORT_NCS; i++)
+    {
+        if (((1 << i) & Slots) == 0)
+        {
+            continue;
+        }
+
+        Srb = PortExtension->Slot[i];
+        PortExtension->Slot[i] = NULL;
+
+        if (Srb == NULL)
+        {
+            continue;
+        }
+
+        if (SrbStatus == SRB_STATUS_PENDING)
+        {
+            // AhciProcessSrb will rebuild the command (and the NCQ tag) for its new slot
+            AddQueue(&PortExtension->SrbQueue, Srb);
+        }
+        else
+        {
+            Srb->SrbStatus = SrbStatus;
+            StorPortNotification(RequestComplete, PortExtension->AdapterExtension, Srb);
+        }
+    }
+
+    PortExtension->QueueSlots &= ~Slots;
+    PortExtension->CommandIssuedSlots &= ~Slots;
+    PortExtension->NcqSlots &= ~Slots;
+
+    return;
+}// -- AhciAbortSlots();
+
+/**
+ * @name AhciPortRestart
+ * @implemented
+ *
+ * 6.2.2.1 Non-Queued Error Recovery / 6.2.2.2 Native Command Queuing Error Recovery
+ * Stop the port, clear the error and start it again
+ *
+ * @param PortExtension
+ *
+ * @return
+ * return TRUE if the port is running again
+ */
+BOOLEAN
+AhciPortRestart (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    ULONG ticks;
+    AHCI_PORT_CMD cmd;
+    AHCI_TASK_FILE_DATA tfd;
+    PAHCI_ADAPTER_EXTENSION AdapterExtension;
+
+    AhciDebugPrint("AhciPortRestart()\n");
+
+    AdapterExtension = PortExtension->AdapterExtension;
+
+    // clearing PxCMD.ST resets PxCI and PxSACT, wait for PxCMD.CR (at most 500 milliseconds)
+    cmd.Status = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->CMD);
+    cmd.ST = 0;
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CMD, cmd.Status);
+
+    ticks = 0;
+    do
+    {
+        StorPortStallExecution(1000);
+        cmd.Status = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->CMD);
+        ticks++;
+    }
+    while((cmd.CR != 0) && (ticks < 500));
+
+    if (cmd.CR != 0)
+    {
+        AhciDebugPrint("\tPxCMD.CR did not clear\n");
+        return FALSE;
+    }
+
+    // clear error bits
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->SERR, (ULONG)~0);
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->IS, (ULONG)~0);
+
+    // if BSY or DRQ are still set the device must be freed with command list override
+    tfd.Status = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->TFD);
+    if ((tfd.STS.BSY) || (tfd.STS.DRQ))
+    {
+        if ((AdapterExtension->CAP & AHCI_Global_HBA_CAP_SCLO) == 0)
+        {
+            AhciDebugPrint("\tBSY-DRQ without CAP.SCLO\n");
+            return FALSE;
+        }
+
+        cmd.CLO = 1;
+        StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CMD, cmd.Status);
+
+        ticks = 0;
+        do
+        {
+            StorPortStallExecution(1000);
+            cmd.Status = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->CMD);
+            ticks++;
+        }
+        while((cmd.CLO != 0) && (ticks < 500));
+
+        if (cmd.CLO != 0)
+        {
+            AhciDebugPrint("\tPxCMD.CLO did not clear\n");
+            return FALSE;
+        }
+    }
+
+    cmd.ST = 1;
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CMD, cmd.Status);
+
+    return TRUE;
+}// -- AhciPortRestart();
+
+/**
+ * @name AhciReadNcqErrorLog
+ * @implemented
+ *
+ * Issue READ LOG EXT for the NCQ Command Error log (10h) in slot 0.
+ * The port must have been restarted and have no outstanding commands.
+ *
+ * @param PortExtension
+ *
+ */
+VOID
+AhciReadNcqErrorLog (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    PAHCI_COMMAND_TABLE cmdTable;
+    PAHCI_COMMAND_HEADER CommandHeader;
+    PAHCI_ADAPTER_EXTENSION AdapterExtension;
+
+    AhciDebugPrint("AhciReadNcqErrorLog()\n");
+
+    AdapterExtension = PortExtension->AdapterExtension;
+    cmdTable = PortExtension->RecoveryCommandTable;
+
+    NT_ASSERT(PortExtension->CommandIssuedSlots == 0);
+    NT_ASSERT(PortExtension->QueueSlots == 0);
+
+    AhciZeroMemory((PCHAR)cmdTable, sizeof(AHCI_COMMAND_TABLE));
+
+    cmdTable->CFIS[AHCI_ATA_CFIS_FisType] = FIS_TYPE_REG_H2D;
+    cmdTable->CFIS[AHCI_ATA_CFIS_PMPort_C] = (1 << 7);
+    cmdTable->CFIS[AHCI_ATA_CFIS_CommandReg] = IDE_COMMAND_READ_LOG_EXT;
+    cmdTable->CFIS[AHCI_ATA_CFIS_LBA0] = IDE_LOG_NCQ_COMMAND_ERROR; // log address
+    cmdTable->CFIS[AHCI_ATA_CFIS_Device] = (0xA0 | IDE_LBA_MODE);
+    cmdTable->CFIS[AHCI_ATA_CFIS_SectorCountLow] = 1;               // one page
+
+    cmdTable->PRDT[0].DBA = PortExtension->NcqErrorLogPhysicalAddress.LowPart;
+    if (IsAdapterCAPS64(AdapterExtension->CAP))
+    {
+        cmdTable->PRDT[0].DBAU = PortExtension->NcqErrorLogPhysicalAddress.HighPart;
+    }
+    cmdTable->PRDT[0].DBC = DEVICE_ATA_BLOCK_SIZE - 1;
+
+    CommandHeader = &PortExtension->CommandList[0];
+    CommandHeader->DI.Status = 0;
+    CommandHeader->DI.CFL = 5;
+    CommandHeader->DI.PRDTL = 1;
+    CommandHeader->PRDBC = 0;
+    CommandHeader->CTBA = PortExtension->RecoveryCommandTablePhysicalAddress.LowPart;
+
+    if (IsAdapterCAPS64(AdapterExtension->CAP))
+    {
+        CommandHeader->CTBA_U = PortExtension->RecoveryCommandTablePhysicalAddress.HighPart;
+    }
+
+    PortExtension->DeviceParams.ErrorRecovery = TRUE;
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, 1);
+
+    return;
+}// -- AhciReadNcqErrorLog();
+
+/**
+ * @name AhciNcqErrorLogCompletion
+ * @implemented
+ *
+ * The NCQ Command Error log has been read, fail the command it names
+ * and issue all other aborted commands again
+ *
+ * @param PortExtension
+ *
+ */
+VOID
+AhciNcqErrorLogCompletion (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    ULONG tag, aborted;
+    UCHAR *log;
+
+    AhciDebugPrint("AhciNcqErrorLogCompletion()\n");
+
+    log = PortExtension->NcqErrorLog;
+    aborted = PortExtension->AbortedSlots;
+
+    PortExtension->AbortedSlots = 0;
+    PortExtension->DeviceParams.ErrorRecovery = FALSE;
+
+    tag = log[0] & IDE_LOG_NCQ_ERROR_TAG;
+    AhciDebugPrint("\tLog: %x Status: %x Error: %x\n", log[0], log[2], log[3]);
+
+    if (((log[0] & IDE_LOG_NCQ_ERROR_NQ) == 0) && ((aborted & (1 << tag)) != 0))
+    {
+        AhciAbortSlots(PortExtension, (1 << tag), SRB_STATUS_ERROR);
+        AhciAbortSlots(PortExtension, aborted & ~(1 << tag), SRB_STATUS_PENDING);
+    }
+    else
+    {
+        // the log does not name one of our commands
+        AhciAbortSlots(PortExtension, aborted, SRB_STATUS_ERROR);
+    }
+
+    return;
+}// -- AhciNcqErrorLogCompletion();
+
+/**
+ * @name AhciPortErrorRecovery
+ * @implemented
+ *
+ * 6.2.2 Software Error Recovery
+ * Complete what has finished, restart the port and decide the fate of the
+ * commands which were outstanding when the error was raised.
+ * Runs at DISPATCH_LEVEL, the interrupt lock is dropped while the port restarts.
+ *
+ * @param PortExtension
+ *
+ */
+VOID
+AhciPortErrorRecovery (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    AHCI_PORT_CMD cmd;
+    AHCI_INTERRUPT_STATUS PxIS;
+    PSCSI_REQUEST_BLOCK Srb;
+    BOOLEAN readingErrorLog, restarted;
+    ULONG ci, sact, outstanding, failed, failedSlot;
+    STOR_LOCK_HANDLE lockhandle = {0};
+    PAHCI_ADAPTER_EXTENSION AdapterExtension;
+
+    AhciDebugPrint("AhciPortErrorRecovery()\n");
+
+    AdapterExtension = PortExtension->AdapterExtension;
+
+    StorPortAcquireSpinLock(AdapterExtension, InterruptLock, NULL, &lockhandle);
+    PxIS = PortExtension->RecoveryIS;
+
+    ci = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->CI);
+    sact = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->SACT);
+    cmd.Status = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->CMD);
+
+    // PxCI and PxSACT are still valid, commands that have left them did complete
+    outstanding = ci | sact;
+    if ((PortExtension->CommandIssuedSlots & (~outstanding)) != 0)
+    {
+        AhciCompleteIssuedSrb(PortExtension, (PortExtension->CommandIssuedSlots & (~outstanding)));
+        PortExtension->CommandIssuedSlots &= outstanding;
+    }
+
+    // PxCMD.CCS is only meaningful for non-queued commands
+    failedSlot = cmd.CCS;
+    failed = PortExtension->CommandIssuedSlots;
+    readingErrorLog = PortExtension->DeviceParams.ErrorRecovery;
+    PortExtension->DeviceParams.ErrorRecovery = FALSE;
+
+    // slots which were assigned but not issued go back to the queue, slot 0 may be needed
+    AhciAbortSlots(PortExtension, PortExtension->QueueSlots, SRB_STATUS_PENDING);
+    StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
+
+    // the interrupt handler has masked the port and AhciIssueQueuedSrbs
+    // leaves it alone as long as RecoveryIS is set
+    restarted = AhciPortRestart(PortExtension);
+
+    StorPortAcquireSpinLock(AdapterExtension, InterruptLock, NULL, &lockhandle);
+    PortExtension->RecoveryIS.Status = 0;
+
+    if (!restarted)
+    {
+        // give up on this port
+        AhciDebugPrint("\tPort %d is unusable\n", PortExtension->PortNumber);
+        PortExtension->DeviceParams.IsActive = FALSE;
+        AhciAbortSlots(PortExtension, failed | PortExtension->AbortedSlots, SRB_STATUS_NO_DEVICE);
+        PortExtension->AbortedSlots = 0;
+
+        while ((Srb = RemoveQueue(&PortExtension->SrbQueue)) != NULL)
+        {
+            Srb->SrbStatus = SRB_STATUS_NO_DEVICE;
+            StorPortNotification(RequestComplete, AdapterExtension, Srb);
+        }
+
+        StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
+        return;
+    }
+
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->IE, PortExtension->RecoveryIE.Status);
+
+    if (readingErrorLog)
+    {
+        // READ LOG EXT failed too, we cannot tell which command was bad
+        AhciAbortSlots(PortExtension, PortExtension->AbortedSlots, SRB_STATUS_ERROR);
+        PortExtension->AbortedSlots = 0;
+    }
+    else if (PxIS.TFES && ((failed & PortExtension->NcqSlots) != 0))
+    {
+        // the device aborted every queued command, the log tells which one failed
+        PortExtension->AbortedSlots = failed;
+        PortExtension->CommandIssuedSlots = 0;
+        AhciReadNcqErrorLog(PortExtension);
+    }
+    else if (PxIS.TFES && ((failed & (1 << failedSlot)) != 0))
+    {
+        AhciAbortSlots(PortExtension, (1 << failedSlot), SRB_STATUS_ERROR);
+        AhciAbortSlots(PortExtension, failed & ~(1 << failedSlot), SRB_STATUS_PENDING);
+    }
+    else
+    {
+        // host bus or interface error, let the class driver retry
+        AhciAbortSlots(PortExtension, failed, SRB_STATUS_BUS_RESET);
+    }
+
+    AhciIssueQueuedSrbs(PortExtension);
+    StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
+
+    return;
+}// -- AhciPortErrorRecovery();
+
+/**
+ * @name AhciPortRecoveryDpcRoutine
+ * @implemented
+ *
+ * Recovers a port after the interrupt handler has seen a fatal error
+ *
+ * @param Dpc
+ * @param AdapterExtension
+ * @param SystemArgument1
+ * @param SystemArgument2
+ */
+VOID
+AhciPortRecoveryDpcRoutine (
+    __in PSTOR_DPC Dpc,
+    __in PVOID HwDeviceExtension,
+    __in PVOID SystemArgument1,
+    __in PVOID SystemArgument2
+  )
+{
+    PAHCI_PORT_EXTENSION PortExtension;
+
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(HwDeviceExtension);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    AhciDebugPrint("AhciPortRecoveryDpcRoutine()\n");
+
+    PortExtension = (PAHCI_PORT_EXTENSION)SystemArgument1;
+    AhciPortErrorRecovery(PortExtension);
+
+    return;
+}// -- AhciPortRecoveryDpcRoutine();
+
 /**
  * @name AhciInterruptHandler
  * @not_implemented
@@ -663,6 +1076,21 @@ AhciInterruptHandler (
         // non-queued commands were being issued or native command queuing commands were being issued.
 
         AhciDebugPrint("\tFatal Error: %x\n", PxIS.Status);
+
+        // restarting the port stalls for up to a second, far too long at DIRQL.
+        // Mask the port and leave the recovery to AhciPortRecoveryDpcRoutine
+        if (PortExtension->RecoveryIS.Status == 0)
+        {
+            PortExtension->RecoveryIE.Status = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->IE);
+            StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->IE, 0);
+            StorPortIssueDpc(AdapterExtension, &PortExtension->PortRecovery, PortExtension, NULL);
+        }
+        PortExtension->RecoveryIS.Status |= PxIS.Status;
+
+        StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->IS, PxIS.Status);
+        is = (1 << PortExtension->PortNumber);
+        StorPortWriteRegisterUlong(AdapterExtension, AdapterExtension->IS, is);
+        return;
     }
 
     // Normal Command Completion
@@ -693,12 +1121,22 @@ AhciInterruptHandler (
     sact = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->SACT);
 
     outstanding = ci | sact; // NOTE: Including both non-NCQ and NCQ based commands
-    if ((PortExtension->CommandIssuedSlots & (~outstanding)) != 0)
+    if (PortExtension->DeviceParams.ErrorRecovery)
+    {
+        if ((ci & 1) == 0)
+        {
+            AhciNcqErrorLogCompletion(PortExtension);
+        }
+    }
+    else if ((PortExtension->CommandIssuedSlots & (~outstanding)) != 0)
     {
         AhciCompleteIssuedSrb(PortExtension, (PortExtension->CommandIssuedSlots & (~outstanding)));
         PortExtension->CommandIssuedSlots &= outstanding;
     }
 
+    // reuse the slots which have just been freed
+    AhciIssueQueuedSrbs(PortExtension);
+
     return;
 }// -- AhciInterruptHandler();
 
@@ -1403,6 +1841,12 @@ AhciProcessSrb (
     NT_ASSERT(SlotIndex < AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
     SrbExtension->SlotIndex = SlotIndex;
 
+    if (IsNcqCommand(SrbExtension))
+    {
+        // FPDMA QUEUED carries the tag in Count(7:3), we use the slot number
+        SrbExtension->SectorCountLow = (UCHAR)(SlotIndex << 3);
+    }
+
     // program the CFIS in the CommandTable
     CommandHeader = &PortExtension->CommandList[SlotIndex];
 
@@ -1468,6 +1912,11 @@ AhciProcessSrb (
     // mark this slot
     PortExtension->Slot[SlotIndex] = Srb;
     PortExtension->QueueSlots |= 1 << SlotIndex;
+
+    if (IsNcqCommand(SrbExtension))
+    {
+        PortExtension->NcqSlots |= 1 << SlotIndex;
+    }
     return;
 }// -- AhciProcessSrb();
 
@@ -1486,7 +1935,7 @@ AhciActivatePort (
     )
 {
     AHCI_PORT_CMD cmd;
-    ULONG QueueSlots, slotToActivate, tmp;
+    ULONG QueueSlots, ncqSlots;
     PAHCI_ADAPTER_EXTENSION AdapterExtension;
 
     AhciDebugPrint("AhciActivatePort()\n");
@@ -1508,27 +1957,91 @@ AhciActivatePort (
         return;
     }
 
-    // get the lowest set bit
-    tmp = QueueSlots & (QueueSlots - 1);
-
-    if (tmp == 0)
-        slotToActivate = QueueSlots;
-    else
-        slotToActivate = (QueueSlots & (~tmp));
-
-    // mark that bit off in QueueSlots
+    // issue every assigned slot at once
+    // mark them off in QueueSlots
     // so we can know we it is really needed to activate port or not
-    PortExtension->QueueSlots &= ~slotToActivate;
-    // mark this CommandIssuedSlots
+    PortExtension->QueueSlots = 0;
+    // mark them in CommandIssuedSlots
     // to validate in completeIssuedCommand
-    PortExtension->CommandIssuedSlots |= slotToActivate;
+    PortExtension->CommandIssuedSlots |= QueueSlots;
 
-    // tell the HBA to issue this Command Slot to the given port
-    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, slotToActivate);
+    // 3.3.13 -- software shall set the PxSACT bit of a native queued command before setting its PxCI bit
+    ncqSlots = QueueSlots & PortExtension->NcqSlots;
+    if (ncqSlots != 0)
+    {
+        StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->SACT, ncqSlots);
+    }
+
+    // tell the HBA to issue these Command Slots to the given port
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, QueueSlots);
 
     return;
 }// -- AhciActivatePort();
 
+/**
+ * @name AhciIssueQueuedSrbs
+ * @implemented
+ *
+ * Populate pending commands to free slots of the command list and
+ * program controller's port to process them. Caller holds the interrupt lock.
+ *
+ * @param PortExtension
+ *
+ */
+VOID
+AhciIssueQueuedSrbs (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    PSCSI_REQUEST_BLOCK tmpSrb;
+    PAHCI_SRB_EXTENSION SrbExtension;
+    ULONG occupiedSlots, slotIndex;
+
+    AhciDebugPrint("AhciIssueQueuedSrbs()\n");
+
+    if ((PortExtension->DeviceParams.IsActive == FALSE) ||
+        (PortExtension->DeviceParams.ErrorRecovery) ||
+        (PortExtension->RecoveryIS.Status != 0))
+    {
+        return; // we should wait for device to get active
+    }
+
+    occupiedSlots = (PortExtension->QueueSlots | PortExtension->CommandIssuedSlots); // Busy command slots for given port
+
+    // iterate over HBA port slots, MaxPortQueueDepth also bounds the NCQ tags
+    for (slotIndex = 0; slotIndex < PortExtension->MaxPortQueueDepth; slotIndex++)
+    {
+        if ((occupiedSlots & (1 << slotIndex)) != 0)
+        {
+            continue;
+        }
+
+        tmpSrb = PeekQueue(&PortExtension->SrbQueue);
+        if (tmpSrb == NULL)
+        {
+            break;
+        }
+
+        // native queued and non-queued commands must not be outstanding at the same time
+        SrbExtension = GetSrbExtension(tmpSrb);
+        if ((occupiedSlots != 0) &&
+            ((IsNcqCommand(SrbExtension) != 0) != (PortExtension->NcqSlots != 0)))
+        {
+            break;
+        }
+
+        RemoveQueue(&PortExtension->SrbQueue);
+        NT_ASSERT(tmpSrb->PathId == PortExtension->PortNumber);
+        AhciProcessSrb(PortExtension, tmpSrb, slotIndex);
+        occupiedSlots |= (1 << slotIndex);
+    }
+
+    // program HBA port
+    AhciActivatePort(PortExtension);
+
+    return;
+}// -- AhciIssueQueuedSrbs();
+
 /**
  * @name AhciProcessIO
  * @implemented
@@ -1548,10 +2061,8 @@ AhciProcessIO (
     __in PSCSI_REQUEST_BLOCK Srb
     )
 {
-    PSCSI_REQUEST_BLOCK tmpSrb;
     STOR_LOCK_HANDLE lockhandle = {0};
     PAHCI_PORT_EXTENSION PortExtension;
-    ULONG commandSlotMask, occupiedSlots, slotIndex, NCS;
 
     AhciDebugPrint("AhciProcessIO()\n");
     AhciDebugPrint("\tPathId: %d\n", PathId);
@@ -1566,46 +2077,7 @@ AhciProcessIO (
     // add Srb to queue
     AddQueue(&PortExtension->SrbQueue, Srb);
 
-    if (PortExtension->DeviceParams.IsActive == FALSE)
-    {
-        // Release Lock
-        StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
-        return; // we should wait for device to get active
-    }
-
-    occupiedSlots = (PortExtension->QueueSlots | PortExtension->CommandIssuedSlots); // Busy command slots for given port
-    NCS = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
-    commandSlotMask = (1 << NCS) - 1; // available slots mask
-
-    commandSlotMask = (commandSlotMask & ~occupiedSlots);
-    if(commandSlotMask != 0)
-    {
-        // iterate over HBA port slots
-        for (slotIndex = 0; slotIndex < NCS; slotIndex++)
-        {
-            // find first free slot
-            if ((commandSlotMask & (1 << slotIndex)) != 0)
-            {
-                tmpSrb = RemoveQueue(&PortExtension->SrbQueue);
-                if (tmpSrb != NULL)
-                {
-                    NT_ASSERT(tmpSrb->PathId == PathId);
-                    AhciProcessSrb(PortExtension, tmpSrb, slotIndex);
-                }
-                else
-                {
-                    break;
-                }
-            }
-            else
-            {
-                break;
-            }
-        }
-    }
-
-    // program HBA port
-    AhciActivatePort(PortExtension);
+    AhciIssueQueuedSrbs(PortExtension);
 
     // Release Lock
     StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
@@ -1756,6 +2228,24 @@ InquiryCompletion (
 
         PortExtension->DeviceParams.BytesPerPhysicalSector = DEVICE_ATA_BLOCK_SIZE;
 
+        /* Native Command Queuing, both HBA (CAP.SNCQ) and device (word 76) must support it */
+        PortExtension->DeviceParams.NcqEnabled = 0;
+        if (IsAdapterCAPSNCQ(AdapterExtension->CAP) &&
+            (PortExtension->DeviceParams.Lba48BitMode) &&
+            (IdentifyDeviceData->ReservedWords76[0] != 0xFFFF) &&
+            ((IdentifyDeviceData->ReservedWords76[0] & IDENTIFY_SATA_CAPABILITIES_NCQ) != 0))
+        {
+            PortExtension->DeviceParams.NcqEnabled = 1;
+
+            // QueueDepth is 0's based, tags must stay below it
+            if ((ULONG)IdentifyDeviceData->QueueDepth + 1 < PortExtension->MaxPortQueueDepth)
+            {
+                PortExtension->MaxPortQueueDepth = IdentifyDeviceData->QueueDepth + 1;
+            }
+
+            AhciDebugPrint("\tNCQ QueueDepth: %d\n", PortExtension->MaxPortQueueDepth);
+        }
+
         // last byte should be NULL
         StorPortCopyMemory(PortExtension->DeviceParams.VendorId, IdentifyDeviceData->ModelNumber, sizeof(PortExtension->DeviceParams.VendorId) - 1);
         StorPortCopyMemory(PortExtension->DeviceParams.RevisionID, IdentifyDeviceData->FirmwareRevision, sizeof(PortExtension->DeviceParams.RevisionID) - 1);
@@ -1788,7 +2278,7 @@ InquiryCompletion (
     // prepare data to send
     InquiryData->Versions = 2;
     InquiryData->Wide32Bit = 1;
-    InquiryData->CommandQueue = 0; // NCQ not supported
+    InquiryData->CommandQueue = PortExtension->DeviceParams.NcqEnabled;
     InquiryData->ResponseDataFormat = 0x2;
     InquiryData->DeviceTypeModifier = 0;
     InquiryData->DeviceTypeQualifier = DEVICE_CONNECTED;
@@ -1810,7 +2300,7 @@ InquiryCompletion (
                                          Srb->PathId,
                                          Srb->TargetId,
                                          Srb->Lun,
-                                         AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
+                                         PortExtension->MaxPortQueueDepth);
 
     NT_ASSERT(status == TRUE);
     return;
@@ -2017,7 +2507,7 @@ DeviceRequestReadWrite (
     NT_ASSERT(SectorCount > 0);
 
     SrbExtension->AtaFunction = ATA_FUNCTION_ATA_READ;
-    SrbExtension->Flags |= ATA_FLAGS_USE_DMA;
+    SrbExtension->Flags = ATA_FLAGS_USE_DMA;
     SrbExtension->CompletionRoutine = NULL;
 
     if (IsReading)
@@ -2064,6 +2554,19 @@ DeviceRequestReadWrite (
     SrbExtension->SectorCountLow = (SectorCount >> 0) & 0xFF;
     SrbExtension->SectorCountHigh = (SectorCount >> 8) & 0xFF;
 
+    if (PortExtension->DeviceParams.NcqEnabled)
+    {
+        // FPDMA QUEUED: sector count moves to Features, AhciProcessSrb puts the tag in Count
+        SrbExtension->Flags |= ATA_FLAGS_NCQ;
+        SrbExtension->CommandReg = IsReading ? IDE_COMMAND_READ_FPDMA_QUEUED : IDE_COMMAND_WRITE_FPDMA_QUEUED;
+
+        SrbExtension->FeaturesLow = SrbExtension->SectorCountLow;
+        SrbExtension->FeaturesHigh = SrbExtension->SectorCountHigh;
+        SrbExtension->SectorCountLow = 0;
+        SrbExtension->SectorCountHigh = 0;
+        SrbExtension->Device = IDE_LBA_MODE;
+    }
+
     NT_ASSERT(SectorCount < 0x100);
 
     SrbExtension->pSgl = (PLOCAL_SCATTER_GATHER_LIST)StorPortGetScatterGatherList(AdapterExtension, Srb);
@@ -2274,7 +2777,7 @@ DeviceInquiryRequest (
         NT_ASSERT(SrbExtension != NULL);
 
         SrbExtension->AtaFunction = ATA_FUNCTION_ATA_IDENTIFY;
-        SrbExtension->Flags |= ATA_FLAGS_DATA_IN;
+        SrbExtension->Flags = ATA_FLAGS_DATA_IN;
         SrbExtension->CompletionRoutine = InquiryCompletion;
         SrbExtension->CommandReg = IDE_COMMAND_NOT_VALID;
 
@@ -2537,6 +3040,33 @@ RemoveQueue (
     return Srb;
 }// -- RemoveQueue();
 
+/**
+ * @name PeekQueue
+ * @implemented
+ *
+ * Return the Srb RemoveQueue would return, without removing it
+ *
+ * @param Queue
+ *
+ * @return
+ * return Srb
+ *
+ */
+__inline
+PVOID
+PeekQueue (
+    __in PAHCI_QUEUE Queue
+    )
+{
+    NT_ASSERT(Queue->Head < MAXIMUM_QUEUE_BUFFER_SIZE);
+    NT_ASSERT(Queue->Tail < MAXIMUM_QUEUE_BUFFER_SIZE);
+
+    if (Queue->Head == Queue->Tail)
+        return NULL;
+
+    return Queue->Buffer[Queue->Tail];
+}// -- PeekQueue();
+
 /**
  * @name GetSrbExtension
  * @implemented
@@ -20,7 +20,7 @@
 
 #define MAXIMUM_AHCI_PORT_COUNT             32
 #define MAXIMUM_AHCI_PRDT_ENTRIES           32
-#define MAXIMUM_AHCI_PORT_NCS               30
+#define MAXIMUM_AHCI_PORT_NCS               32
 #define MAXIMUM_QUEUE_BUFFER_SIZE           255
 #define MAXIMUM_TRANSFER_LENGTH             (128*1024) // 128 KB
 
@@ -33,6 +33,17 @@
 
 // section 3.1.2
 #define AHCI_Global_HBA_CAP_S64A            (1 << 31)
+#define AHCI_Global_HBA_CAP_SNCQ            (1 << 30)
+#define AHCI_Global_HBA_CAP_SCLO            (1 << 24)
+
+// native command queuing (SATA 3.x, ATA8-ACS)
+#define IDE_COMMAND_READ_LOG_EXT            0x2F
+#define IDE_COMMAND_READ_FPDMA_QUEUED       0x60
+#define IDE_COMMAND_WRITE_FPDMA_QUEUED      0x61
+#define IDE_LOG_NCQ_COMMAND_ERROR           0x10    // NCQ Command Error log page
+#define IDE_LOG_NCQ_ERROR_NQ                (1 << 7)// last command was not a queued command
+#define IDE_LOG_NCQ_ERROR_TAG               0x1F
+#define IDENTIFY_SATA_CAPABILITIES_NCQ      (1 << 8)// IDENTIFY word 76
 
 // FIS Types : http://wiki.osdev.org/AHCI
 #define FIS_TYPE_REG_H2D        0x27 // Register FIS - host to device
@@ -71,14 +82,17 @@
 #define ATA_FLAGS_DATA_OUT                  (1 << 2)
 #define ATA_FLAGS_48BIT_COMMAND             (1 << 3)
 #define ATA_FLAGS_USE_DMA                   (1 << 4)
+#define ATA_FLAGS_NCQ                       (1 << 5)
 
 #define IsAtaCommand(AtaFunction)           (AtaFunction & ATA_FUNCTION_ATA_COMMAND)
 #define IsAtapiCommand(AtaFunction)         (AtaFunction & ATA_FUNCTION_ATAPI_COMMAND)
 #define IsDataTransferNeeded(SrbExtension)  (SrbExtension->Flags & (ATA_FLAGS_DATA_IN | ATA_FLAGS_DATA_OUT))
 #define IsAdapterCAPS64(CAP)                (CAP & AHCI_Global_HBA_CAP_S64A)
+#define IsAdapterCAPSNCQ(CAP)               (CAP & AHCI_Global_HBA_CAP_SNCQ)
+#define IsNcqCommand(SrbExtension)          (SrbExtension->Flags & ATA_FLAGS_NCQ)
 
-// 3.1.1 NCS = CAP[12:08] -> Align
-#define AHCI_Global_Port_CAP_NCS(x)         (((x) & 0xF00) >> 8)
+// 3.1.1 NCS = CAP[12:08] -> 0's based value
+#define AHCI_Global_Port_CAP_NCS(x)         ((((x) & 0x1F00) >> 8) + 1)
 
 #define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
 //#define AhciDebugPrint(format, ...) StorPortDebugPrint(0, format, __VA_ARGS__)
@@ -464,6 +478,8 @@ typedef struct _AHCI_PORT_EXTENSION
     ULONG PortNumber;
     ULONG QueueSlots;                                   // slots which we have already assigned task (Slot)
     ULONG CommandIssuedSlots;                           // slots which has been programmed
+    ULONG NcqSlots;                                     // slots (assigned or programmed) holding FPDMA QUEUED commands
+    ULONG AbortedSlots;                                 // NCQ slots waiting for the error log to be read
     ULONG MaxPortQueueDepth;
 
     struct
@@ -473,6 +489,8 @@ typedef struct _AHCI_PORT_EXTENSION
         UCHAR AccessType;
         UCHAR DeviceType;
         UCHAR IsActive;
+        UCHAR NcqEnabled;
+        UCHAR ErrorRecovery;                            // READ LOG EXT 10h is in flight
         LARGE_INTEGER MaxLba;
         ULONG BytesPerLogicalSector;
         ULONG BytesPerPhysicalSector;
@@ -482,6 +500,9 @@ typedef struct _AHCI_PORT_EXTENSION
     } DeviceParams;
 
     STOR_DPC CommandCompletion;
+    STOR_DPC PortRecovery;
+    AHCI_INTERRUPT_STATUS RecoveryIS;                   // fatal errors PortRecovery has yet to handle
+    AHCI_INTERRUPT_ENABLE RecoveryIE;                   // PxIE while the port is masked for recovery
     PAHCI_PORT Port;                                    // AHCI Port Infomation
     AHCI_QUEUE SrbQueue;                                // pending Srbs
     AHCI_QUEUE CompletionQueue;
@@ -491,6 +512,10 @@ typedef struct _AHCI_PORT_EXTENSION
     STOR_DEVICE_POWER_STATE DevicePowerState;           // Device Power State
     PIDENTIFY_DEVICE_DATA IdentifyDeviceData;
     STOR_PHYSICAL_ADDRESS IdentifyDeviceDataPhysicalAddress;
+    PAHCI_COMMAND_TABLE RecoveryCommandTable;           // used to read the NCQ error log
+    STOR_PHYSICAL_ADDRESS RecoveryCommandTablePhysicalAddress;
+    PUCHAR NcqErrorLog;
+    STOR_PHYSICAL_ADDRESS NcqErrorLogPhysicalAddress;
     struct _AHCI_ADAPTER_EXTENSION* AdapterExtension;   // Port's Adapter Information
 } AHCI_PORT_EXTENSION, *PAHCI_PORT_EXTENSION;
 
@@ -576,6 +601,19 @@ AhciProcessIO (
     __in PSCSI_REQUEST_BLOCK Srb
     );
 
+VOID
+AhciIssueQueuedSrbs (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    );
+
+VOID
+AhciPortRecoveryDpcRoutine (
+    __in PSTOR_DPC Dpc,
+    __in PVOID HwDeviceExtension,
+    __in PVOID SystemArgument1,
+    __in PVOID SystemArgument2
+    );
+
 BOOLEAN
 AhciAdapterReset (
     __in PAHCI_ADAPTER_EXTENSION AdapterExtension
@@ -645,6 +683,12 @@ RemoveQueue (
     __inout PAHCI_QUEUE Queue
     );
 
+__inline
+PVOID
+PeekQueue (
+    __in PAHCI_QUEUE Queue
+    );
+
 __inline
 PAHCI_SRB_EXTENSION
 GetSrbExtension(
@@ -702,6 +746,7 @@ C_ASSERT(FIELD_OFFSET(AHCI_PORT, RSV1)   == 0x44);
 C_ASSERT(FIELD_OFFSET(AHCI_PORT, Vendor) == 0x70);
 
 C_ASSERT((sizeof(AHCI_COMMAND_TABLE) % 128) == 0);
+C_ASSERT(sizeof(AHCI_RECEIVED_FIS) == 0x100);
 
 C_ASSERT(sizeof(AHCI_GHC)                        == sizeof(ULONG));
 C_ASSERT(sizeof(AHCI_PORT_CMD)                   == sizeof(ULONG));
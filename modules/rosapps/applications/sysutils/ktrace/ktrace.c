@@ -0,0 +1,197 @@
+/*
+ * PROJECT:         ReactOS Kernel Event Tracer
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            modules/rosapps/applications/sysutils/ktrace/ktrace.c
+ * PURPOSE:         Records kernel trace events to a file
+ */
+
+#define WIN32_NO_STATUS
+#include <windows.h>
+#define NTOS_MODE_USER
+#include <ndk/ntndk.h>
+#include <reactos/perftrace.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DRAIN_BUFFER_SIZE   (1024 * 1024)
+#define DRAIN_INTERVAL      100
+#define DEFAULT_DURATION    10
+
+static volatile LONG StopRequested;
+
+static BOOL WINAPI CtrlHandler(DWORD CtrlType)
+{
+    /* Stop tracing cleanly so the end of the trace isn't lost */
+    InterlockedExchange(&StopRequested, TRUE);
+    return TRUE;
+}
+
+static NTSTATUS SetTracing(ULONG Groups, ULONG BufferSize)
+{
+    PERFTRACE_CONTROL Control;
+    NTSTATUS Status;
+
+    Control.Groups = Groups;
+    Control.BufferSize = BufferSize;
+
+    Status = NtSetSystemInformation(SystemPerformanceTraceInformation, &Control, sizeof(Control));
+    if (!NT_SUCCESS(Status))
+    {
+        fprintf(stderr, "ktrace: cannot %s tracing (0x%08lx)\n", Groups ? "start" : "stop", Status);
+    }
+    return Status;
+}
+
+/* Moves everything the kernel has buffered into the file, or drops it */
+static BOOL Drain(FILE *File, PPERFTRACE_BUFFER_HEADER Buffer, PULONGLONG Bytes, PULONG Lost)
+{
+    NTSTATUS Status;
+    ULONG Length;
+
+    /* Keep going while the buffer comes back more than half full */
+    do
+    {
+        Status = NtQuerySystemInformation(SystemPerformanceTraceInformation,
+                                          Buffer,
+                                          DRAIN_BUFFER_SIZE,
+                                          &Length);
+        if (!NT_SUCCESS(Status))
+        {
+            fprintf(stderr, "ktrace: cannot read the trace (0x%08lx)\n", Status);
+            return FALSE;
+        }
+
+        *Lost += Buffer->EventsLost;
+        if (!Buffer->DataLength && !Buffer->EventsLost) break;
+
+        /* Each chunk keeps its header, the decoder needs the frequency */
+        if (File && fwrite(Buffer, sizeof(PERFTRACE_BUFFER_HEADER) + Buffer->DataLength, 1, File) != 1)
+        {
+            fprintf(stderr, "ktrace: cannot write the trace file\n");
+            return FALSE;
+        }
+        *Bytes += Buffer->DataLength;
+    } while (Buffer->DataLength > DRAIN_BUFFER_SIZE / 2);
+
+    return TRUE;
+}
+
+static void Usage(void)
+{
+    printf("Usage: ktrace [-g groups] [-b kb] [-t seconds] file\n"
+           "       ktrace -d\n"
+           "  -g groups   events to trace (default 0x%x):\n"
+           "              1 context switches, 2 page faults, 4 disk I/O,\n"
+           "              8 registry, 0x10 processes and threads\n"
+           "  -b kb       size of each processor's buffer in KB (default %d)\n"
+           "  -t seconds  how long to trace (default %d, 0 until Ctrl+C)\n"
+           "  -d          stop tracing left running by an earlier ktrace\n"
+           "Decode the file with ktrdump on the build host.\n",
+           PERFTRACE_GROUP_ALL,
+           PERFTRACE_DEFAULT_BUFFER_SIZE / 1024,
+           DEFAULT_DURATION);
+}
+
+int main(int argc, char *argv[])
+{
+    PPERFTRACE_BUFFER_HEADER Buffer;
+    ULONG Groups = PERFTRACE_GROUP_ALL, BufferSize = 0, Duration = DEFAULT_DURATION, Lost = 0;
+    ULONGLONG Bytes = 0;
+    DWORD Start;
+    const char *FileName = NULL;
+    FILE *File;
+    NTSTATUS Status;
+    BOOLEAN Old;
+    BOOL Success;
+    int arg;
+
+    /* Both controlling and reading the trace need it */
+    Status = RtlAdjustPrivilege(SE_SYSTEM_PROFILE_PRIVILEGE, TRUE, FALSE, &Old);
+    if (!NT_SUCCESS(Status))
+    {
+        fprintf(stderr, "ktrace: cannot enable the profile privilege (0x%08lx)\n", Status);
+        return 1;
+    }
+
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (!strcmp(argv[arg], "-d")) return NT_SUCCESS(SetTracing(0, 0)) ? 0 : 1;
+
+        if (!strcmp(argv[arg], "-g") && arg + 1 < argc)
+        {
+            Groups = strtoul(argv[++arg], NULL, 0);
+        }
+        else if (!strcmp(argv[arg], "-b") && arg + 1 < argc)
+        {
+            BufferSize = strtoul(argv[++arg], NULL, 0) * 1024;
+        }
+        else if (!strcmp(argv[arg], "-t") && arg + 1 < argc)
+        {
+            Duration = strtoul(argv[++arg], NULL, 0);
+        }
+        else if (argv[arg][0] != '-' && !FileName)
+        {
+            FileName = argv[arg];
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (!FileName || !(Groups & PERFTRACE_GROUP_ALL))
+    {
+        Usage();
+        return 1;
+    }
+
+    Buffer = malloc(DRAIN_BUFFER_SIZE);
+    if (!Buffer) return 1;
+
+    File = fopen(FileName, "wb");
+    if (!File)
+    {
+        fprintf(stderr, "ktrace: cannot create %s\n", FileName);
+        free(Buffer);
+        return 1;
+    }
+
+    /* Throw away whatever an earlier run left behind */
+    Success = Drain(NULL, Buffer, &Bytes, &Lost);
+    Bytes = 0;
+    Lost = 0;
+
+    if (!Success || !NT_SUCCESS(SetTracing(Groups, BufferSize)))
+    {
+        fclose(File);
+        free(Buffer);
+        return 1;
+    }
+
+    SetConsoleCtrlHandler(CtrlHandler, TRUE);
+    printf("Tracing events 0x%lx to %s, press Ctrl+C to stop\n", Groups, FileName);
+
+    Start = GetTickCount();
+    while (Success && !StopRequested)
+    {
+        if (Duration && GetTickCount() - Start >= Duration * 1000) break;
+
+        Sleep(DRAIN_INTERVAL);
+        Success = Drain(File, Buffer, &Bytes, &Lost);
+    }
+
+    /* Pick up what was logged until tracing actually stopped */
+    SetTracing(0, 0);
+    if (Success) Success = Drain(File, Buffer, &Bytes, &Lost);
+
+    fclose(File);
+    free(Buffer);
+
+    printf("%I64u bytes of events written, %lu events lost\n", Bytes, Lost);
+    return Success ? 0 : 1;
+}
+
+/* EOF */
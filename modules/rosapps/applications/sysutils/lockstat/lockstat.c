@@ -0,0 +1,279 @@
+/*
+ * PROJECT:         ReactOS Kernel Lock Contention Viewer
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            modules/rosapps/applications/sysutils/lockstat/lockstat.c
+ * PURPOSE:         Ranks the most contended kernel locks
+ */
+
+#define WIN32_NO_STATUS
+#include <windows.h>
+#define NTOS_MODE_USER
+#include <ndk/ntndk.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_TOP 20
+
+static PRTL_PROCESS_MODULES Modules;
+
+static int SortByWaits;
+
+static PVOID QueryInformation(SYSTEM_INFORMATION_CLASS InfoClass, PULONG ReturnedLength)
+{
+    NTSTATUS Status;
+    PVOID Buffer = NULL;
+    ULONG Length = 0x4000;
+
+    /* The lists can grow between two calls, so retry until it fits */
+    for (;;)
+    {
+        Buffer = malloc(Length);
+        if (!Buffer) return NULL;
+
+        Status = NtQuerySystemInformation(InfoClass, Buffer, Length, &Length);
+        if (NT_SUCCESS(Status)) break;
+
+        free(Buffer);
+        if (Status != STATUS_INFO_LENGTH_MISMATCH)
+        {
+            fprintf(stderr, "lockstat: class %d query failed with 0x%08lx\n", InfoClass, Status);
+            return NULL;
+        }
+        Length += 0x1000;
+    }
+
+    if (ReturnedLength) *ReturnedLength = Length;
+    return Buffer;
+}
+
+static void FormatAddress(PVOID Address, char *Text, size_t Size)
+{
+    PRTL_PROCESS_MODULE_INFORMATION Module;
+    ULONG i;
+
+    for (i = 0; Modules && i < Modules->NumberOfModules; i++)
+    {
+        Module = &Modules->Modules[i];
+        if ((ULONG_PTR)Address >= (ULONG_PTR)Module->ImageBase &&
+            (ULONG_PTR)Address < (ULONG_PTR)Module->ImageBase + Module->ImageSize)
+        {
+            _snprintf(Text, Size, "%s+0x%lx",
+                      Module->FullPathName + Module->OffsetToFileName,
+                      (ULONG)((ULONG_PTR)Address - (ULONG_PTR)Module->ImageBase));
+            Text[Size - 1] = '\0';
+            return;
+        }
+    }
+
+    _snprintf(Text, Size, "%p", Address);
+    Text[Size - 1] = '\0';
+}
+
+static const char *TypeName(USHORT Type)
+{
+    switch (Type)
+    {
+        case RTL_RESOURCE_TYPE: return "ERESOURCE";
+        case LOCK_PROFILE_TYPE_PUSH_LOCK: return "PushLock";
+        case LOCK_PROFILE_TYPE_FAST_MUTEX: return "FastMutex";
+        default: return "?";
+    }
+}
+
+static int __cdecl CompareResources(const void *a, const void *b)
+{
+    const RTL_PROCESS_LOCK_INFORMATION *Left = a, *Right = b;
+
+    if (Left->ContentionCount != Right->ContentionCount)
+        return (Left->ContentionCount < Right->ContentionCount) ? 1 : -1;
+    return 0;
+}
+
+static int __cdecl CompareProfiles(const void *a, const void *b)
+{
+    const SYSTEM_LOCK_PROFILE_ENTRY *Left = a, *Right = b;
+
+    if (SortByWaits && Left->Waits != Right->Waits)
+        return (Left->Waits < Right->Waits) ? 1 : -1;
+    if (Left->TotalWaitTime != Right->TotalWaitTime)
+        return (Left->TotalWaitTime < Right->TotalWaitTime) ? 1 : -1;
+    if (Left->Waits != Right->Waits)
+        return (Left->Waits < Right->Waits) ? 1 : -1;
+    return 0;
+}
+
+static void ShowResources(PRTL_PROCESS_LOCKS Locks, ULONG Top)
+{
+    PRTL_PROCESS_LOCK_INFORMATION Lock;
+    char Name[80];
+    ULONG i;
+
+    qsort(Locks->Locks, Locks->NumberOfLocks, sizeof(RTL_PROCESS_LOCK_INFORMATION), CompareResources);
+    if (!Top || Top > Locks->NumberOfLocks) Top = Locks->NumberOfLocks;
+
+    printf("%lu resources, most contended first:\n", Locks->NumberOfLocks);
+    printf("%-40s %10s %6s %6s %6s %8s\n", "Resource", "Contention", "Active", "ShWait", "ExWait", "Owner");
+    for (i = 0; i < Top && Locks->Locks[i].ContentionCount; i++)
+    {
+        Lock = &Locks->Locks[i];
+        FormatAddress(Lock->Address, Name, sizeof(Name));
+        printf("%-40s %10lu %6lu %6lu %6lu %8lx\n",
+               Name,
+               Lock->ContentionCount,
+               Lock->ActiveCount,
+               Lock->NumberOfSharedWaiters,
+               Lock->NumberOfExclusiveWaiters,
+               Lock->OwnerThreadId);
+    }
+}
+
+static void ShowProfile(PSYSTEM_LOCK_PROFILE_INFORMATION Profile, ULONG Top, BOOL Histogram)
+{
+    PSYSTEM_LOCK_PROFILE_ENTRY Entry;
+    char Name[80], Caller[80];
+    ULONG i, j, Best;
+
+    qsort(Profile->Entries, Profile->NumberOfEntries, sizeof(SYSTEM_LOCK_PROFILE_ENTRY), CompareProfiles);
+    if (!Top || Top > Profile->NumberOfEntries) Top = Profile->NumberOfEntries;
+
+    printf("\n%lu profiled locks (%lu waits dropped), hottest first:\n",
+           Profile->NumberOfEntries, Profile->DroppedWaits);
+    printf("%-10s %-40s %8s %12s %10s %10s  %s\n",
+           "Type", "Lock", "Waits", "Total(us)", "Avg(us)", "Max(us)", "Top owner");
+    for (i = 0; i < Top; i++)
+    {
+        Entry = &Profile->Entries[i];
+        FormatAddress(Entry->Address, Name, sizeof(Name));
+
+        /* Show the caller that held the lock most often */
+        Best = 0;
+        for (j = 1; j < LOCK_PROFILE_CALLERS; j++)
+        {
+            if (Entry->OwnerCallerHits[j] > Entry->OwnerCallerHits[Best]) Best = j;
+        }
+        if (Entry->OwnerCallers[Best])
+            FormatAddress(Entry->OwnerCallers[Best], Caller, sizeof(Caller));
+        else
+            strcpy(Caller, "-");
+
+        printf("%-10s %-40s %8lu %12I64u %10I64u %10I64u  %s\n",
+               TypeName(Entry->Type),
+               Name,
+               Entry->Waits,
+               Entry->TotalWaitTime,
+               Entry->Waits ? Entry->TotalWaitTime / Entry->Waits : 0,
+               Entry->MaxWaitTime,
+               Caller);
+
+        if (Histogram)
+        {
+            printf("           ");
+            for (j = 0; j < LOCK_PROFILE_BUCKETS; j++)
+            {
+                if (Entry->Histogram[j]) printf(" <%luus:%lu", 2UL << j, Entry->Histogram[j]);
+            }
+            printf("\n");
+        }
+    }
+}
+
+static int SetProfiling(ULONG Flags)
+{
+    NTSTATUS Status;
+    BOOLEAN Old;
+
+    Status = RtlAdjustPrivilege(SE_SYSTEM_PROFILE_PRIVILEGE, TRUE, FALSE, &Old);
+    if (NT_SUCCESS(Status))
+    {
+        Status = NtSetSystemInformation(SystemLocksInformation, &Flags, sizeof(Flags));
+    }
+    if (!NT_SUCCESS(Status))
+    {
+        fprintf(stderr, "lockstat: cannot change lock profiling (0x%08lx)\n", Status);
+        return 1;
+    }
+
+    if (Flags)
+        printf("Lock profiling started (flags 0x%lx)\n", Flags);
+    else
+        printf("Lock profiling stopped\n");
+    return 0;
+}
+
+static void Usage(void)
+{
+    printf("Usage: lockstat [-e [flags] | -d] [-w] [-h] [-n count]\n"
+           "  -e [flags] start profiling lock waits, clearing the previous profile;\n"
+           "             flags: 1 resources, 2 push locks, 4 fast mutexes (default 7)\n"
+           "  -d         stop profiling\n"
+           "  -w         rank profiled locks by number of waits instead of wait time\n"
+           "  -h         show the wait time histogram of every profiled lock\n"
+           "  -n count   number of locks to show (default %d, 0 for all)\n",
+           DEFAULT_TOP);
+}
+
+int main(int argc, char *argv[])
+{
+    PRTL_PROCESS_LOCKS Locks;
+    PSYSTEM_LOCK_PROFILE_INFORMATION Profile = NULL;
+    ULONG Length, Offset, Top = DEFAULT_TOP;
+    BOOL Histogram = FALSE;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (!strcmp(argv[arg], "-e"))
+        {
+            if (arg + 1 < argc && argv[arg + 1][0] != '-')
+                return SetProfiling(strtoul(argv[arg + 1], NULL, 0));
+            return SetProfiling(LOCK_PROFILE_ALL);
+        }
+        if (!strcmp(argv[arg], "-d")) return SetProfiling(0);
+
+        if (!strcmp(argv[arg], "-w"))
+        {
+            SortByWaits = TRUE;
+        }
+        else if (!strcmp(argv[arg], "-h"))
+        {
+            Histogram = TRUE;
+        }
+        else if (!strcmp(argv[arg], "-n") && arg + 1 < argc)
+        {
+            Top = strtoul(argv[++arg], NULL, 0);
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    Locks = QueryInformation(SystemLocksInformation, &Length);
+    if (!Locks) return 1;
+    Modules = QueryInformation(SystemModuleInformation, NULL);
+
+    /* The profile, if any, follows the lock array on an 8-byte boundary */
+    Offset = FIELD_OFFSET(RTL_PROCESS_LOCKS, Locks) +
+             Locks->NumberOfLocks * sizeof(RTL_PROCESS_LOCK_INFORMATION);
+    Offset = (Offset + 7) & ~7;
+    if (Offset + FIELD_OFFSET(SYSTEM_LOCK_PROFILE_INFORMATION, Entries) <= Length)
+    {
+        Profile = (PSYSTEM_LOCK_PROFILE_INFORMATION)((PUCHAR)Locks + Offset);
+        if (Profile->Signature != LOCK_PROFILE_SIGNATURE) Profile = NULL;
+    }
+
+    ShowResources(Locks, Top);
+    if (Profile)
+        ShowProfile(Profile, Top, Histogram);
+    else
+        printf("\nLock waits are not being profiled; use -e to start.\n");
+
+    free(Modules);
+    free(Locks);
+    return 0;
+}
+
+/* EOF */
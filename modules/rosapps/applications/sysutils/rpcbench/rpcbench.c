@@ -0,0 +1,281 @@
+/*
+ * PROJECT:         ReactOS RPC Benchmark
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            modules/rosapps/applications/sysutils/rpcbench/rpcbench.c
+ * PURPOSE:         Measures latency and throughput of local echo calls
+ */
+
+#include <windows.h>
+#include <rpc.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rpcbench_c.h"
+#include "rpcbench_s.h"
+
+#define DEFAULT_ENDPOINT "rpcbench"
+#define DEFAULT_CALLS    2000
+#define WARMUP_CALLS     20
+
+static const unsigned long Sizes[] = { 0, 64, 200, 1024, 4096, 16384, 65536 };
+
+void __RPC_FAR * __RPC_USER midl_user_allocate(SIZE_T Size)
+{
+    return malloc(Size);
+}
+
+void __RPC_USER midl_user_free(void __RPC_FAR *Ptr)
+{
+    free(Ptr);
+}
+
+void s_Echo(handle_t Binding, unsigned long Size, const unsigned char *Input, unsigned char *Output)
+{
+    memcpy(Output, Input, Size);
+}
+
+void s_Shutdown(handle_t Binding)
+{
+    RpcMgmtStopServerListening(NULL);
+}
+
+static void Usage(void)
+{
+    printf("Usage: rpcbench [-s | -c] [-e endpoint] [-n calls]\n"
+           "  -s  only run the server, until a client sends -x\n"
+           "  -c  only run the client against a running server\n"
+           "  -x  stop a server started with -s\n"
+           "  -e  ncalrpc endpoint, \"%s\" by default\n"
+           "  -n  calls per message size, %u by default\n"
+           "Without -s or -c both sides run in this process.\n",
+           DEFAULT_ENDPOINT, DEFAULT_CALLS);
+}
+
+static RPC_STATUS StartServer(const char *Endpoint)
+{
+    RPC_STATUS Status;
+
+    Status = RpcServerUseProtseqEpA((RPC_CSTR)"ncalrpc", RPC_C_PROTSEQ_MAX_REQS_DEFAULT,
+                                    (RPC_CSTR)Endpoint, NULL);
+    if (Status != RPC_S_OK)
+    {
+        fprintf(stderr, "rpcbench: RpcServerUseProtseqEp failed with %lu\n", Status);
+        return Status;
+    }
+
+    Status = RpcServerRegisterIf(s_RpcBench_v1_0_s_ifspec, NULL, NULL);
+    if (Status != RPC_S_OK)
+        fprintf(stderr, "rpcbench: RpcServerRegisterIf failed with %lu\n", Status);
+    return Status;
+}
+
+static handle_t Bind(const char *Endpoint)
+{
+    RPC_CSTR StringBinding;
+    handle_t Binding = NULL;
+    RPC_STATUS Status;
+
+    Status = RpcStringBindingComposeA(NULL, (RPC_CSTR)"ncalrpc", NULL, (RPC_CSTR)Endpoint,
+                                      NULL, &StringBinding);
+    if (Status == RPC_S_OK)
+    {
+        Status = RpcBindingFromStringBindingA(StringBinding, &Binding);
+        RpcStringFreeA(&StringBinding);
+    }
+    if (Status != RPC_S_OK)
+        fprintf(stderr, "rpcbench: binding to %s failed with %lu\n", Endpoint, Status);
+    return Binding;
+}
+
+static RPC_STATUS EchoCalls(handle_t Binding, unsigned long Size, unsigned char *Input,
+                            unsigned char *Output, unsigned long Calls)
+{
+    RPC_STATUS Status = RPC_S_OK;
+    unsigned long i;
+
+    RpcTryExcept
+    {
+        for (i = 0; i < Calls; i++)
+            Echo(Binding, Size, Input, Output);
+    }
+    RpcExcept(EXCEPTION_EXECUTE_HANDLER)
+    {
+        Status = RpcExceptionCode();
+    }
+    RpcEndExcept;
+
+    return Status;
+}
+
+static int RunClient(const char *Endpoint, unsigned long Calls)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    unsigned char *Input, *Output;
+    unsigned long i, Max = Sizes[ARRAYSIZE(Sizes) - 1];
+    handle_t Binding;
+    RPC_STATUS Status;
+    double Seconds;
+    int Result = 0;
+
+    Binding = Bind(Endpoint);
+    if (!Binding) return 1;
+
+    Input = malloc(Max);
+    Output = malloc(Max);
+    if (!Input || !Output)
+    {
+        fprintf(stderr, "rpcbench: out of memory\n");
+        free(Input);
+        free(Output);
+        RpcBindingFree(&Binding);
+        return 1;
+    }
+    for (i = 0; i < Max; i++)
+        Input[i] = (unsigned char)(i * 7 + 1);
+
+    QueryPerformanceFrequency(&Frequency);
+    printf("%10s %10s %14s %12s %12s\n", "size", "calls", "latency (us)", "calls/s", "MB/s");
+
+    for (i = 0; i < ARRAYSIZE(Sizes); i++)
+    {
+        /* The first calls also bind and warm up the server */
+        Status = EchoCalls(Binding, Sizes[i], Input, Output, WARMUP_CALLS);
+        if (Status == RPC_S_OK && memcmp(Input, Output, Sizes[i]))
+        {
+            fprintf(stderr, "rpcbench: echo of %lu bytes came back wrong\n", Sizes[i]);
+            Result = 1;
+            break;
+        }
+
+        QueryPerformanceCounter(&Start);
+        if (Status == RPC_S_OK)
+            Status = EchoCalls(Binding, Sizes[i], Input, Output, Calls);
+        QueryPerformanceCounter(&End);
+
+        if (Status != RPC_S_OK)
+        {
+            fprintf(stderr, "rpcbench: call failed with %lu\n", Status);
+            Result = 1;
+            break;
+        }
+
+        Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+        if (Seconds <= 0) Seconds = 1.0 / Frequency.QuadPart;
+
+        /* Both directions carry the payload */
+        printf("%10lu %10lu %14.1f %12.0f %12.2f\n",
+               Sizes[i], Calls,
+               Seconds * 1000000.0 / Calls,
+               Calls / Seconds,
+               2.0 * Sizes[i] * Calls / Seconds / (1024.0 * 1024.0));
+    }
+
+    free(Input);
+    free(Output);
+    RpcBindingFree(&Binding);
+    return Result;
+}
+
+static int StopServer(const char *Endpoint)
+{
+    handle_t Binding;
+    RPC_STATUS Status = RPC_S_OK;
+
+    Binding = Bind(Endpoint);
+    if (!Binding) return 1;
+
+    RpcTryExcept
+    {
+        Shutdown(Binding);
+    }
+    RpcExcept(EXCEPTION_EXECUTE_HANDLER)
+    {
+        Status = RpcExceptionCode();
+    }
+    RpcEndExcept;
+
+    RpcBindingFree(&Binding);
+    if (Status != RPC_S_OK)
+    {
+        fprintf(stderr, "rpcbench: stopping the server failed with %lu\n", Status);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *Endpoint = DEFAULT_ENDPOINT;
+    unsigned long Calls = DEFAULT_CALLS;
+    BOOL Server = TRUE, Client = TRUE;
+    RPC_STATUS Status;
+    int Result, arg;
+
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (!strcmp(argv[arg], "-s"))
+        {
+            Client = FALSE;
+        }
+        else if (!strcmp(argv[arg], "-c"))
+        {
+            Server = FALSE;
+        }
+        else if (!strcmp(argv[arg], "-x"))
+        {
+            Server = Client = FALSE;
+        }
+        else if (!strcmp(argv[arg], "-e") && arg + 1 < argc)
+        {
+            Endpoint = argv[++arg];
+        }
+        else if (!strcmp(argv[arg], "-n") && arg + 1 < argc)
+        {
+            Calls = strtoul(argv[++arg], NULL, 0);
+            if (!Calls) Calls = 1;
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (!Server && !Client)
+        return StopServer(Endpoint);
+
+    if (!Server)
+        return RunClient(Endpoint, Calls);
+
+    if (StartServer(Endpoint) != RPC_S_OK)
+        return 1;
+
+    if (!Client)
+    {
+        printf("rpcbench: serving ncalrpc:[%s]\n", Endpoint);
+        Status = RpcServerListen(1, RPC_C_LISTEN_MAX_CALLS_DEFAULT, FALSE);
+        if (Status != RPC_S_OK)
+        {
+            fprintf(stderr, "rpcbench: RpcServerListen failed with %lu\n", Status);
+            return 1;
+        }
+        return 0;
+    }
+
+    Status = RpcServerListen(1, RPC_C_LISTEN_MAX_CALLS_DEFAULT, TRUE);
+    if (Status != RPC_S_OK)
+    {
+        fprintf(stderr, "rpcbench: RpcServerListen failed with %lu\n", Status);
+        return 1;
+    }
+
+    Result = RunClient(Endpoint, Calls);
+
+    RpcMgmtStopServerListening(NULL);
+    RpcMgmtWaitServerListen();
+    return Result;
+}
+
+/* EOF */
@@ -0,0 +1,226 @@
+/*
+ * PROJECT:         ReactOS System Call Counter
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            modules/rosapps/applications/sysutils/syscount/syscount.c
+ * PURPOSE:         Dumps the busiest system services by call count or time
+ */
+
+#define WIN32_NO_STATUS
+#include <windows.h>
+#define NTOS_MODE_USER
+#include <ndk/ntndk.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_TOP 20
+
+#define SVC_(name, argcount) "Nt" #name,
+static const char *NtosServiceNames[] = {
+#include <sysfuncs.h>
+};
+static const char *Win32kServiceNames[] = {
+#include <w32ksvc.h>
+};
+#undef SVC_
+
+typedef struct _SERVICE_ENTRY
+{
+    const char *Name;
+    ULONG Table;
+    ULONG Id;
+    ULONG Count;
+    ULONGLONG Cycles;
+} SERVICE_ENTRY, *PSERVICE_ENTRY;
+
+static int __cdecl CompareByCount(const void *a, const void *b)
+{
+    const SERVICE_ENTRY *Left = a, *Right = b;
+
+    if (Left->Count != Right->Count) return (Left->Count < Right->Count) ? 1 : -1;
+    if (Left->Cycles != Right->Cycles) return (Left->Cycles < Right->Cycles) ? 1 : -1;
+    return 0;
+}
+
+static int __cdecl CompareByTime(const void *a, const void *b)
+{
+    const SERVICE_ENTRY *Left = a, *Right = b;
+
+    if (Left->Cycles != Right->Cycles) return (Left->Cycles < Right->Cycles) ? 1 : -1;
+    if (Left->Count != Right->Count) return (Left->Count < Right->Count) ? 1 : -1;
+    return 0;
+}
+
+static const char *GetServiceName(ULONG Table, ULONG Id)
+{
+    if (Table == 0 && Id < _countof(NtosServiceNames)) return NtosServiceNames[Id];
+    if (Table == 1 && Id < _countof(Win32kServiceNames)) return Win32kServiceNames[Id];
+    return NULL;
+}
+
+static PVOID QueryInformation(SYSTEM_INFORMATION_CLASS InfoClass)
+{
+    NTSTATUS Status;
+    PVOID Buffer;
+    ULONG Length = 0;
+
+    /* Ask for the size first; the tables don't change while we run */
+    Status = NtQuerySystemInformation(InfoClass, &Length, sizeof(Length), &Length);
+    if (Status != STATUS_INFO_LENGTH_MISMATCH || !Length)
+    {
+        fprintf(stderr, "syscount: class %d query failed with 0x%08lx\n", InfoClass, Status);
+        return NULL;
+    }
+
+    Buffer = malloc(Length);
+    if (!Buffer) return NULL;
+
+    Status = NtQuerySystemInformation(InfoClass, Buffer, Length, NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        fprintf(stderr, "syscount: class %d query failed with 0x%08lx\n", InfoClass, Status);
+        free(Buffer);
+        return NULL;
+    }
+
+    return Buffer;
+}
+
+static int SetCounting(ULONG Enable)
+{
+    NTSTATUS Status;
+    BOOLEAN Old;
+
+    Status = RtlAdjustPrivilege(SE_SYSTEM_PROFILE_PRIVILEGE, TRUE, FALSE, &Old);
+    if (NT_SUCCESS(Status))
+    {
+        Status = NtSetSystemInformation(SystemCallCountInformation, &Enable, sizeof(Enable));
+    }
+    if (!NT_SUCCESS(Status))
+    {
+        fprintf(stderr, "syscount: cannot %s counting (0x%08lx)\n", Enable ? "enable" : "disable", Status);
+        return 1;
+    }
+
+    printf("System call counting %s\n", Enable ? "enabled, counters cleared" : "disabled");
+    return 0;
+}
+
+static void Usage(void)
+{
+    printf("Usage: syscount [-e | -d] [-t] [-n count]\n"
+           "  -e        enable counting and clear the counters\n"
+           "  -d        disable counting\n"
+           "  -t        sort by time spent instead of call count\n"
+           "  -n count  number of services to show (default %d, 0 for all)\n",
+           DEFAULT_TOP);
+}
+
+int main(int argc, char *argv[])
+{
+    PSYSTEM_CALL_COUNT_INFORMATION CountInfo;
+    PSYSTEM_CALL_TIME_INFORMATION TimeInfo;
+    PSERVICE_ENTRY Entries;
+    PULONG TableLimit, TableCounts;
+    ULONG Table, Id, Services, i, Top = DEFAULT_TOP;
+    ULONGLONG TotalCalls = 0, TotalCycles = 0;
+    BOOL ByTime = FALSE;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (!strcmp(argv[arg], "-e")) return SetCounting(TRUE);
+        if (!strcmp(argv[arg], "-d")) return SetCounting(FALSE);
+
+        if (!strcmp(argv[arg], "-t"))
+        {
+            ByTime = TRUE;
+        }
+        else if (!strcmp(argv[arg], "-n") && arg + 1 < argc)
+        {
+            Top = strtoul(argv[++arg], NULL, 0);
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    CountInfo = QueryInformation(SystemCallCountInformation);
+    TimeInfo = QueryInformation(SystemCallTimeInformation);
+    if (!CountInfo || !TimeInfo)
+    {
+        free(CountInfo);
+        free(TimeInfo);
+        return 1;
+    }
+
+    /* Both classes list the tables in the same order */
+    Services = TimeInfo->TotalCalls;
+    Entries = calloc(Services ? Services : 1, sizeof(SERVICE_ENTRY));
+    if (!Entries)
+    {
+        free(CountInfo);
+        free(TimeInfo);
+        return 1;
+    }
+
+    TableLimit = (PULONG)(CountInfo + 1);
+    TableCounts = TableLimit + CountInfo->NumberOfTables;
+    i = 0;
+    for (Table = 0; Table < CountInfo->NumberOfTables; Table++)
+    {
+        for (Id = 0; Id < TableLimit[Table] && i < Services; Id++, i++)
+        {
+            Entries[i].Name = GetServiceName(Table, Id);
+            Entries[i].Table = Table;
+            Entries[i].Id = Id;
+            Entries[i].Count = TableCounts[i];
+            Entries[i].Cycles = TimeInfo->TimeOfCalls[i].QuadPart;
+            TotalCalls += Entries[i].Count;
+            TotalCycles += Entries[i].Cycles;
+        }
+    }
+
+    qsort(Entries, Services, sizeof(SERVICE_ENTRY), ByTime ? CompareByTime : CompareByCount);
+
+    if (!TotalCalls)
+    {
+        printf("No system calls were counted; use -e to enable counting.\n");
+    }
+    else
+    {
+        if (!Top || Top > Services) Top = Services;
+
+        printf("%-48s %12s %6s %16s %6s %10s\n",
+               "Service", "Calls", "%", "Cycles", "%", "Cyc/Call");
+        for (i = 0; i < Top && (Entries[i].Count || Entries[i].Cycles); i++)
+        {
+            char Name[64];
+
+            if (Entries[i].Name)
+                _snprintf(Name, sizeof(Name), "%s", Entries[i].Name);
+            else
+                _snprintf(Name, sizeof(Name), "Table%lu!0x%03lx", Entries[i].Table, Entries[i].Id);
+            Name[sizeof(Name) - 1] = '\0';
+
+            printf("%-48s %12lu %6.2f %16I64u %6.2f %10I64u\n",
+                   Name,
+                   Entries[i].Count,
+                   100.0 * Entries[i].Count / TotalCalls,
+                   Entries[i].Cycles,
+                   TotalCycles ? 100.0 * (LONGLONG)Entries[i].Cycles / (LONGLONG)TotalCycles : 0.0,
+                   Entries[i].Count ? Entries[i].Cycles / Entries[i].Count : 0);
+        }
+        printf("%-48s %12I64u %6s %16I64u\n", "Total", TotalCalls, "", TotalCycles);
+    }
+
+    free(Entries);
+    free(CountInfo);
+    free(TimeInfo);
+    return 0;
+}
+
+/* EOF */
@@ -0,0 +1,123 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for PtInRegion and RectInRegion
+ */
+
+#include "precomp.h"
+
+#define CELLS 16
+#define CELL_SIZE 10
+
+/* Builds a checkerboard region, which has one band per row of cells and
+   CELLS / 2 rectangles per band */
+static HRGN CreateCheckerRgn(void)
+{
+    HRGN hrgn, hrgnCell;
+    INT x, y;
+
+    hrgn = CreateRectRgn(0, 0, 0, 0);
+    ok(hrgn != NULL, "CreateRectRgn failed\n");
+    for (y = 0; y < CELLS; y++)
+    {
+        for (x = (y & 1); x < CELLS; x += 2)
+        {
+            hrgnCell = CreateRectRgn(x * CELL_SIZE, y * CELL_SIZE,
+                                     (x + 1) * CELL_SIZE, (y + 1) * CELL_SIZE);
+            CombineRgn(hrgn, hrgn, hrgnCell, RGN_OR);
+            DeleteObject(hrgnCell);
+        }
+    }
+
+    return hrgn;
+}
+
+void Test_PtInRegion()
+{
+    HRGN hrgn;
+    INT x, y;
+    BOOL bExpected, bMismatch = FALSE;
+
+    hrgn = CreateRectRgn(0, 0, 0, 0);
+    ok(hrgn != NULL, "CreateRectRgn failed\n");
+    ok_int(PtInRegion(hrgn, 0, 0), FALSE);
+    DeleteObject(hrgn);
+
+    hrgn = CreateCheckerRgn();
+    ok_int(PtInRegion(hrgn, 0, 0), TRUE);
+    ok_int(PtInRegion(hrgn, CELL_SIZE - 1, CELL_SIZE - 1), TRUE);
+    ok_int(PtInRegion(hrgn, CELL_SIZE, 0), FALSE);
+    ok_int(PtInRegion(hrgn, 0, CELL_SIZE), FALSE);
+    ok_int(PtInRegion(hrgn, CELL_SIZE, CELL_SIZE), TRUE);
+    ok_int(PtInRegion(hrgn, -1, 0), FALSE);
+    ok_int(PtInRegion(hrgn, 0, -1), FALSE);
+    ok_int(PtInRegion(hrgn, CELLS * CELL_SIZE, CELLS * CELL_SIZE - 1), FALSE);
+    ok_int(PtInRegion(hrgn, CELLS * CELL_SIZE - 1, CELLS * CELL_SIZE - 1), TRUE);
+    ok_int(PtInRegion(hrgn, CELLS * CELL_SIZE - 1, CELLS * CELL_SIZE), FALSE);
+
+    /* Every pixel must match the checkerboard pattern */
+    for (y = -1; y <= CELLS * CELL_SIZE; y++)
+    {
+        for (x = -1; x <= CELLS * CELL_SIZE; x++)
+        {
+            bExpected = (x >= 0) && (y >= 0) &&
+                        (x < CELLS * CELL_SIZE) && (y < CELLS * CELL_SIZE) &&
+                        !(((x / CELL_SIZE) ^ (y / CELL_SIZE)) & 1);
+            if (PtInRegion(hrgn, x, y) != bExpected)
+            {
+                ok(0, "PtInRegion(%d, %d) should return %d\n", x, y, bExpected);
+                bMismatch = TRUE;
+                break;
+            }
+        }
+        if (bMismatch) break;
+    }
+
+    DeleteObject(hrgn);
+}
+
+void Test_RectInRegion()
+{
+    HRGN hrgn;
+    RECT rc;
+
+    hrgn = CreateCheckerRgn();
+
+    /* Inside a filled cell */
+    SetRect(&rc, 2, 2, 5, 5);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+
+    /* Inside a hole */
+    SetRect(&rc, CELL_SIZE + 2, 2, CELL_SIZE + 5, 5);
+    ok_int(RectInRegion(hrgn, &rc), FALSE);
+
+    /* A hole touching filled cells only at its edges */
+    SetRect(&rc, CELL_SIZE, 0, 2 * CELL_SIZE, CELL_SIZE);
+    ok_int(RectInRegion(hrgn, &rc), FALSE);
+
+    /* Spanning two bands, only the lower one intersects */
+    SetRect(&rc, CELL_SIZE + 2, CELL_SIZE - 2, CELL_SIZE + 5, CELL_SIZE + 2);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+
+    /* Unordered coordinates are normalized */
+    SetRect(&rc, 5, 5, 2, 2);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+
+    /* Outside the bounding box */
+    SetRect(&rc, CELLS * CELL_SIZE, 0, CELLS * CELL_SIZE + 10, 10);
+    ok_int(RectInRegion(hrgn, &rc), FALSE);
+    SetRect(&rc, 0, CELLS * CELL_SIZE, 10, CELLS * CELL_SIZE + 10);
+    ok_int(RectInRegion(hrgn, &rc), FALSE);
+
+    /* Covering the whole region */
+    SetRect(&rc, -10, -10, CELLS * CELL_SIZE + 10, CELLS * CELL_SIZE + 10);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+
+    DeleteObject(hrgn);
+}
+
+START_TEST(PtInRegion)
+{
+    Test_PtInRegion();
+    Test_RectInRegion();
+}
@@ -0,0 +1,192 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for StretchBlt
+ */
+
+#include "precomp.h"
+
+static HDC
+CreateDIBDC(
+    _In_ ULONG cBitsPerPixel,
+    _In_ LONG cx,
+    _In_ LONG cy,
+    _Out_ PVOID *ppvBits,
+    _Out_ HBITMAP *phbmp)
+{
+    BITMAPINFO bmi;
+    HDC hdc;
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = cx;
+    bmi.bmiHeader.biHeight = -cy;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = cBitsPerPixel;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    hdc = CreateCompatibleDC(NULL);
+    if (!hdc)
+        return NULL;
+
+    *phbmp = CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, ppvBits, NULL, 0);
+    if (!*phbmp)
+    {
+        DeleteDC(hdc);
+        return NULL;
+    }
+
+    SelectObject(hdc, *phbmp);
+    return hdc;
+}
+
+static void
+Test_StretchBlt_SrcCopy(ULONG cSrcBits, ULONG cDstBits)
+{
+    HDC hdcSrc, hdcDst = NULL;
+    HBITMAP hbmpSrc = NULL, hbmpDst = NULL;
+    PVOID pvSrc, pvDst;
+    LONG x, y;
+    COLORREF crExpected, crActual;
+    BOOL bMismatch = FALSE;
+
+    hdcSrc = CreateDIBDC(cSrcBits, 7, 5, &pvSrc, &hbmpSrc);
+    hdcDst = CreateDIBDC(cDstBits, 23, 17, &pvDst, &hbmpDst);
+    if (!hdcSrc || !hdcDst)
+    {
+        skip("Failed to create DIB sections\n");
+        goto Cleanup;
+    }
+
+    for (y = 0; y < 5; y++)
+        for (x = 0; x < 7; x++)
+            SetPixel(hdcSrc, x, y, RGB(x * 0x20, y * 0x30, (x + y) * 0x10));
+
+    SetStretchBltMode(hdcDst, COLORONCOLOR);
+    ok(StretchBlt(hdcDst, 0, 0, 23, 17, hdcSrc, 0, 0, 7, 5, SRCCOPY), "StretchBlt failed\n");
+
+    /* Every destination pixel samples source pixel (x * 7 / 23, y * 5 / 17) */
+    for (y = 0; y < 17 && !bMismatch; y++)
+    {
+        for (x = 0; x < 23 && !bMismatch; x++)
+        {
+            crExpected = GetPixel(hdcSrc, x * 7 / 23, y * 5 / 17);
+            crActual = GetPixel(hdcDst, x, y);
+            if (crActual != crExpected)
+            {
+                ok(0, "%lu->%lu bpp: pixel (%ld,%ld) is 0x%06lx, expected 0x%06lx\n",
+                   cSrcBits, cDstBits, x, y, crActual, crExpected);
+                bMismatch = TRUE;
+            }
+        }
+    }
+
+    /* Shrinking picks every third column and row */
+    ok(StretchBlt(hdcSrc, 0, 0, 7, 5, hdcDst, 0, 0, 21, 15, SRCCOPY), "StretchBlt failed\n");
+    ok_long(GetPixel(hdcSrc, 1, 1), GetPixel(hdcDst, 3, 3));
+
+Cleanup:
+    if (hdcSrc) DeleteDC(hdcSrc);
+    if (hdcDst) DeleteDC(hdcDst);
+    if (hbmpSrc) DeleteObject(hbmpSrc);
+    if (hbmpDst) DeleteObject(hbmpDst);
+}
+
+static void
+Test_StretchBlt_Halftone(ULONG cBitsPerPixel)
+{
+    HDC hdcSrc, hdcDst = NULL;
+    HBITMAP hbmpSrc = NULL, hbmpDst = NULL;
+    PVOID pvSrc, pvDst;
+    COLORREF cr;
+
+    hdcSrc = CreateDIBDC(cBitsPerPixel, 4, 4, &pvSrc, &hbmpSrc);
+    hdcDst = CreateDIBDC(cBitsPerPixel, 2, 2, &pvDst, &hbmpDst);
+    if (!hdcSrc || !hdcDst)
+    {
+        skip("Failed to create DIB sections\n");
+        goto Cleanup;
+    }
+
+    /* 2x2 checker of black and white in every quadrant */
+    PatBlt(hdcSrc, 0, 0, 4, 4, BLACKNESS);
+    SetPixel(hdcSrc, 0, 0, RGB(255, 255, 255));
+    SetPixel(hdcSrc, 1, 1, RGB(255, 255, 255));
+    SetPixel(hdcSrc, 2, 0, RGB(255, 255, 255));
+    SetPixel(hdcSrc, 3, 1, RGB(255, 255, 255));
+
+    SetStretchBltMode(hdcDst, HALFTONE);
+    ok(StretchBlt(hdcDst, 0, 0, 2, 2, hdcSrc, 0, 0, 4, 4, SRCCOPY), "StretchBlt failed\n");
+
+    /* Shrinking averages, so the checker turns into mid grey */
+    cr = GetPixel(hdcDst, 0, 0);
+    ok(GetRValue(cr) >= 0x70 && GetRValue(cr) <= 0x90, "%lu bpp: got 0x%06lx\n", cBitsPerPixel, cr);
+    ok(GetGValue(cr) >= 0x70 && GetGValue(cr) <= 0x90, "%lu bpp: got 0x%06lx\n", cBitsPerPixel, cr);
+    cr = GetPixel(hdcDst, 0, 1);
+    ok_long(cr, RGB(0, 0, 0));
+
+Cleanup:
+    if (hdcSrc) DeleteDC(hdcSrc);
+    if (hdcDst) DeleteDC(hdcDst);
+    if (hbmpSrc) DeleteObject(hbmpSrc);
+    if (hbmpDst) DeleteObject(hbmpDst);
+}
+
+static void
+Test_StretchBlt_Timing(ULONG cBitsPerPixel, INT iMode, LONG cxSrc, LONG cySrc, LONG cxDst, LONG cyDst)
+{
+    HDC hdcSrc, hdcDst = NULL;
+    HBITMAP hbmpSrc = NULL, hbmpDst = NULL;
+    PVOID pvSrc, pvDst;
+    LARGE_INTEGER liFreq, liStart, liEnd;
+    ULONG i, cIterations = 20;
+
+    hdcSrc = CreateDIBDC(cBitsPerPixel, cxSrc, cySrc, &pvSrc, &hbmpSrc);
+    hdcDst = CreateDIBDC(cBitsPerPixel, cxDst, cyDst, &pvDst, &hbmpDst);
+    if (!hdcSrc || !hdcDst)
+    {
+        skip("Failed to create DIB sections\n");
+        goto Cleanup;
+    }
+
+    SetStretchBltMode(hdcDst, iMode);
+    QueryPerformanceFrequency(&liFreq);
+    QueryPerformanceCounter(&liStart);
+    for (i = 0; i < cIterations; i++)
+        StretchBlt(hdcDst, 0, 0, cxDst, cyDst, hdcSrc, 0, 0, cxSrc, cySrc, SRCCOPY);
+    QueryPerformanceCounter(&liEnd);
+
+    trace("%lu bpp %s %ldx%ld -> %ldx%ld: %lu us per StretchBlt\n",
+          cBitsPerPixel, (iMode == HALFTONE) ? "HALFTONE" : "COLORONCOLOR",
+          cxSrc, cySrc, cxDst, cyDst,
+          (ULONG)((liEnd.QuadPart - liStart.QuadPart) * 1000000 / liFreq.QuadPart / cIterations));
+
+Cleanup:
+    if (hdcSrc) DeleteDC(hdcSrc);
+    if (hdcDst) DeleteDC(hdcDst);
+    if (hbmpSrc) DeleteObject(hbmpSrc);
+    if (hbmpDst) DeleteObject(hbmpDst);
+}
+
+START_TEST(StretchBlt)
+{
+    ULONG i;
+
+    /* Pairs without colour quantization, so GetPixel compares exactly */
+    Test_StretchBlt_SrcCopy(16, 16);
+    Test_StretchBlt_SrcCopy(24, 24);
+    Test_StretchBlt_SrcCopy(32, 32);
+    Test_StretchBlt_SrcCopy(24, 32);
+    Test_StretchBlt_SrcCopy(32, 24);
+
+    Test_StretchBlt_Halftone(24);
+    Test_StretchBlt_Halftone(32);
+
+    for (i = 24; i <= 32; i += 8)
+    {
+        Test_StretchBlt_Timing(i, COLORONCOLOR, 256, 256, 640, 480);
+        Test_StretchBlt_Timing(i, COLORONCOLOR, 1024, 768, 96, 96);
+        Test_StretchBlt_Timing(i, HALFTONE, 256, 256, 640, 480);
+        Test_StretchBlt_Timing(i, HALFTONE, 1024, 768, 96, 96);
+    }
+}
@@ -61,6 +61,7 @@ extern void func_OffsetClipRgn(void);
 extern void func_OffsetRgn(void);
 extern void func_PaintRgn(void);
 extern void func_PatBlt(void);
+extern void func_PtInRegion(void);
 extern void func_Rectangle(void);
 extern void func_RealizePalette(void);
 extern void func_SelectObject(void);
@@ -74,6 +75,7 @@ extern void func_SetPixel(void);
 extern void func_SetSysColors(void);
 extern void func_SetWindowExtEx(void);
 extern void func_SetWorldTransform(void);
+extern void func_StretchBlt(void);
 
 const struct test winetest_testlist[] =
 {
@@ -135,6 +137,7 @@ const struct test winetest_testlist[] =
     { "OffsetRgn", func_OffsetRgn },
     { "PaintRgn", func_PaintRgn },
     { "PatBlt", func_PatBlt },
+    { "PtInRegion", func_PtInRegion },
     { "Rectangle", func_Rectangle },
     { "RealizePalette", func_RealizePalette },
     { "SelectObject", func_SelectObject },
@@ -148,6 +151,7 @@ const struct test winetest_testlist[] =
     { "SetSysColors", func_SetSysColors },
     { "SetWindowExtEx", func_SetWindowExtEx },
     { "SetWorldTransform", func_SetWorldTransform },
+    { "StretchBlt", func_StretchBlt },
 
     { 0, 0 }
 };
@@ -0,0 +1,155 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for GdipDrawImagePointsRect
+ */
+
+#include <apitest.h>
+
+#include <wingdi.h>
+#include <objbase.h>
+#include <gdiplus.h>
+
+#define SRC_SIZE 256
+
+static const ARGB QuadrantColors[4] =
+{
+    0xffff0000, 0xff00ff00, 0xff0000ff, 0xffffffff
+};
+
+/* Creates a source bitmap with one solid color per quadrant */
+static GpBitmap *CreateQuadrantBitmap(void)
+{
+    GpBitmap *bitmap = NULL;
+    GpStatus status;
+    INT x, y;
+
+    status = GdipCreateBitmapFromScan0(SRC_SIZE, SRC_SIZE, 0, PixelFormat32bppARGB, NULL, &bitmap);
+    ok(status == Ok, "GdipCreateBitmapFromScan0 failed: %d\n", status);
+    if (status != Ok)
+        return NULL;
+
+    for (y = 0; y < SRC_SIZE; y++)
+    {
+        for (x = 0; x < SRC_SIZE; x++)
+        {
+            GdipBitmapSetPixel(bitmap, x, y,
+                QuadrantColors[(x >= SRC_SIZE / 2) + 2 * (y >= SRC_SIZE / 2)]);
+        }
+    }
+
+    return bitmap;
+}
+
+static ARGB GetPixelColor(GpBitmap *bitmap, INT x, INT y)
+{
+    ARGB color = 0;
+    GdipBitmapGetPixel(bitmap, x, y, &color);
+    return color;
+}
+
+/* Draws the source rotated by 90 degrees clockwise and checks that every
+   quadrant ended up where it belongs */
+static void Test_Rotate90(GpBitmap *src, InterpolationMode mode)
+{
+    GpBitmap *dst = NULL;
+    GpGraphics *graphics = NULL;
+    GpPointF points[3];
+    GpStatus status;
+
+    status = GdipCreateBitmapFromScan0(SRC_SIZE, SRC_SIZE, 0, PixelFormat32bppARGB, NULL, &dst);
+    ok(status == Ok, "GdipCreateBitmapFromScan0 failed: %d\n", status);
+    if (status != Ok)
+        return;
+
+    GdipGetImageGraphicsContext((GpImage *)dst, &graphics);
+    GdipSetInterpolationMode(graphics, mode);
+
+    /* upper-left, upper-right and lower-left corners of the destination */
+    points[0].X = SRC_SIZE; points[0].Y = 0;
+    points[1].X = SRC_SIZE; points[1].Y = SRC_SIZE;
+    points[2].X = 0;        points[2].Y = 0;
+
+    status = GdipDrawImagePointsRect(graphics, (GpImage *)src, points, 3,
+                                     0, 0, SRC_SIZE, SRC_SIZE, UnitPixel, NULL, NULL, NULL);
+    ok(status == Ok, "GdipDrawImagePointsRect failed: %d\n", status);
+
+    /* Sample the middle of each destination quadrant, away from the edges */
+    ok_hex(GetPixelColor(dst, 3 * SRC_SIZE / 4, SRC_SIZE / 4), QuadrantColors[0]);
+    ok_hex(GetPixelColor(dst, 3 * SRC_SIZE / 4, 3 * SRC_SIZE / 4), QuadrantColors[1]);
+    ok_hex(GetPixelColor(dst, SRC_SIZE / 4, SRC_SIZE / 4), QuadrantColors[2]);
+    ok_hex(GetPixelColor(dst, SRC_SIZE / 4, 3 * SRC_SIZE / 4), QuadrantColors[3]);
+
+    GdipDeleteGraphics(graphics);
+    GdipDisposeImage((GpImage *)dst);
+}
+
+/* Times a scaled and a rotated draw of the source */
+static void Benchmark_DrawImage(GpBitmap *src, InterpolationMode mode)
+{
+    GpBitmap *dst = NULL;
+    GpGraphics *graphics = NULL;
+    LARGE_INTEGER Frequency, Start, Scale, Rotate;
+    GpStatus status;
+
+    status = GdipCreateBitmapFromScan0(4 * SRC_SIZE, 4 * SRC_SIZE, 0, PixelFormat32bppARGB, NULL, &dst);
+    ok(status == Ok, "GdipCreateBitmapFromScan0 failed: %d\n", status);
+    if (status != Ok)
+        return;
+
+    GdipGetImageGraphicsContext((GpImage *)dst, &graphics);
+    GdipSetInterpolationMode(graphics, mode);
+
+    QueryPerformanceFrequency(&Frequency);
+
+    QueryPerformanceCounter(&Start);
+    status = GdipDrawImageRectI(graphics, (GpImage *)src, 0, 0, 4 * SRC_SIZE, 4 * SRC_SIZE);
+    ok(status == Ok, "GdipDrawImageRectI failed: %d\n", status);
+    QueryPerformanceCounter(&Scale);
+
+    GdipTranslateWorldTransform(graphics, 2 * SRC_SIZE, 2 * SRC_SIZE, MatrixOrderPrepend);
+    GdipRotateWorldTransform(graphics, 30.0f, MatrixOrderPrepend);
+    status = GdipDrawImageRectI(graphics, (GpImage *)src, -SRC_SIZE, -SRC_SIZE, 2 * SRC_SIZE, 2 * SRC_SIZE);
+    ok(status == Ok, "GdipDrawImageRectI failed: %d\n", status);
+    QueryPerformanceCounter(&Rotate);
+
+    trace("Interpolation %d: scale x4 %lu us, rotate 30 x2 %lu us\n", mode,
+          (ULONG)((Scale.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart),
+          (ULONG)((Rotate.QuadPart - Scale.QuadPart) * 1000000 / Frequency.QuadPart));
+
+    GdipDeleteGraphics(graphics);
+    GdipDisposeImage((GpImage *)dst);
+}
+
+START_TEST(DrawImage)
+{
+    static const InterpolationMode Modes[] =
+    {
+        InterpolationModeNearestNeighbor,
+        InterpolationModeBilinear,
+        InterpolationModeHighQualityBicubic
+    };
+    struct GdiplusStartupInput input;
+    ULONG_PTR token;
+    GpBitmap *src;
+    ULONG i;
+
+    input.GdiplusVersion = 1;
+    input.DebugEventCallback = NULL;
+    input.SuppressBackgroundThread = FALSE;
+    input.SuppressExternalCodecs = FALSE;
+    GdiplusStartup(&token, &input, NULL);
+
+    src = CreateQuadrantBitmap();
+    if (src)
+    {
+        for (i = 0; i < sizeof(Modes) / sizeof(Modes[0]); i++)
+        {
+            Test_Rotate90(src, Modes[i]);
+            Benchmark_DrawImage(src, Modes[i]);
+        }
+        GdipDisposeImage((GpImage *)src);
+    }
+
+    GdiplusShutdown(token);
+}
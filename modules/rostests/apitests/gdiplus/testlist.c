@@ -0,0 +1,12 @@
+#define __ROS_LONG64__
+
+#define STANDALONE
+#include <apitest.h>
+
+extern void func_DrawImage(void);
+
+const struct test winetest_testlist[] =
+{
+    { "DrawImage", func_DrawImage },
+    { 0, 0 }
+};
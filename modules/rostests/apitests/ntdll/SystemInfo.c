@@ -7,6 +7,7 @@
  */
 
 #include "precomp.h"
+#include <reactos/perftrace.h>
 
 #define ntv6(x) (LOBYTE(LOWORD(GetVersion())) >= 6 ? (x) : 0)
 
@@ -314,6 +315,195 @@ Test_KernelDebugger(void)
     ok(Status == STATUS_INVALID_INFO_CLASS, "NtSetSystemInformation returned %lx\n", Status);
 }
 
+static
+void
+Test_CallCount(void)
+{
+    NTSTATUS Status;
+    ULONG ReturnLength, Length;
+    PSYSTEM_CALL_COUNT_INFORMATION CountInfo;
+    PULONG TableLimit;
+
+    ReturnLength = 0x55555555;
+    Status = NtQuerySystemInformation(SystemCallCountInformation, NULL, 0, &ReturnLength);
+    if (Status == STATUS_NOT_IMPLEMENTED)
+    {
+        skip("SystemCallCountInformation not supported\n");
+        return;
+    }
+    ok(Status == STATUS_INFO_LENGTH_MISMATCH, "NtQuerySystemInformation returned %lx\n", Status);
+    ok(ReturnLength > sizeof(SYSTEM_CALL_COUNT_INFORMATION), "ReturnLength = %lu\n", ReturnLength);
+
+    Length = ReturnLength;
+    CountInfo = HeapAlloc(GetProcessHeap(), 0, Length);
+    if (!CountInfo)
+    {
+        skip("Out of memory\n");
+        return;
+    }
+
+    ReturnLength = 0x55555555;
+    Status = NtQuerySystemInformation(SystemCallCountInformation, CountInfo, Length, &ReturnLength);
+    ok(Status == STATUS_SUCCESS, "NtQuerySystemInformation returned %lx\n", Status);
+    ok(ReturnLength == Length, "ReturnLength = %lu\n", ReturnLength);
+    if (NT_SUCCESS(Status))
+    {
+        ok(CountInfo->Length == Length, "Length = %lu\n", CountInfo->Length);
+        ok(CountInfo->NumberOfTables >= 1, "NumberOfTables = %lu\n", CountInfo->NumberOfTables);
+        TableLimit = (PULONG)(CountInfo + 1);
+        ok(TableLimit[0] != 0, "TableLimit[0] = %lu\n", TableLimit[0]);
+    }
+
+    /* Toggling counts needs the profile privilege */
+    Length = 0;
+    Status = NtSetSystemInformation(SystemCallCountInformation, &Length, sizeof(Length) - 1);
+    ok(Status == STATUS_INFO_LENGTH_MISMATCH || Status == STATUS_INVALID_INFO_CLASS,
+       "NtSetSystemInformation returned %lx\n", Status);
+
+    HeapFree(GetProcessHeap(), 0, CountInfo);
+}
+
+static
+void
+Test_Locks(void)
+{
+    NTSTATUS Status;
+    ULONG ReturnLength, Length;
+    PRTL_PROCESS_LOCKS Locks = NULL;
+
+    ReturnLength = 0x55555555;
+    Status = NtQuerySystemInformation(SystemLocksInformation, NULL, 0, &ReturnLength);
+    ok(Status == STATUS_INFO_LENGTH_MISMATCH, "NtQuerySystemInformation returned %lx\n", Status);
+    ok(ReturnLength >= FIELD_OFFSET(RTL_PROCESS_LOCKS, Locks), "ReturnLength = %lu\n", ReturnLength);
+
+    /* Resources come and go, leave some room */
+    Length = ReturnLength + 64 * sizeof(RTL_PROCESS_LOCK_INFORMATION);
+    Locks = HeapAlloc(GetProcessHeap(), 0, Length);
+    if (!Locks)
+    {
+        skip("Out of memory\n");
+        return;
+    }
+
+    Status = NtQuerySystemInformation(SystemLocksInformation, Locks, Length, &ReturnLength);
+    ok(Status == STATUS_SUCCESS, "NtQuerySystemInformation returned %lx\n", Status);
+    if (NT_SUCCESS(Status))
+    {
+        ok(Locks->NumberOfLocks != 0, "NumberOfLocks = %lu\n", Locks->NumberOfLocks);
+        ok(ReturnLength >= FIELD_OFFSET(RTL_PROCESS_LOCKS, Locks) +
+                           Locks->NumberOfLocks * sizeof(RTL_PROCESS_LOCK_INFORMATION),
+           "ReturnLength = %lu\n", ReturnLength);
+        if (Locks->NumberOfLocks)
+        {
+            ok(Locks->Locks[0].Type == RTL_RESOURCE_TYPE, "Type = %u\n", Locks->Locks[0].Type);
+            ok(Locks->Locks[0].Address != NULL, "Address = %p\n", Locks->Locks[0].Address);
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, Locks);
+}
+
+static
+DWORD
+WINAPI
+TraceThreadProc(LPVOID Parameter)
+{
+    return 0;
+}
+
+static
+void
+Test_PerformanceTrace(void)
+{
+    NTSTATUS Status;
+    ULONG ReturnLength, Length, Offset;
+    PERFTRACE_CONTROL Control;
+    PPERFTRACE_BUFFER_HEADER Trace;
+    PPERFTRACE_EVENT_HEADER Event;
+    PPERFTRACE_THREAD_EVENT ThreadEvent;
+    HANDLE Thread;
+    DWORD ThreadId;
+    BOOLEAN Old, Found = FALSE;
+
+    Status = RtlAdjustPrivilege(SE_SYSTEM_PROFILE_PRIVILEGE, TRUE, FALSE, &Old);
+    if (!NT_SUCCESS(Status))
+    {
+        skip("Cannot enable the profile privilege\n");
+        return;
+    }
+
+    Control.Groups = PERFTRACE_GROUP_PROCESS;
+    Control.BufferSize = 0;
+    Status = NtSetSystemInformation(SystemPerformanceTraceInformation, &Control, sizeof(Control));
+    if (!NT_SUCCESS(Status))
+    {
+        skip("SystemPerformanceTraceInformation not supported\n");
+        RtlAdjustPrivilege(SE_SYSTEM_PROFILE_PRIVILEGE, Old, FALSE, &Old);
+        return;
+    }
+
+    Length = 0x10000;
+    Trace = HeapAlloc(GetProcessHeap(), 0, Length);
+    if (!Trace)
+    {
+        skip("Out of memory\n");
+        goto Stop;
+    }
+
+    ReturnLength = 0x55555555;
+    Status = NtQuerySystemInformation(SystemPerformanceTraceInformation,
+                                      Trace,
+                                      sizeof(PERFTRACE_BUFFER_HEADER) - 1,
+                                      &ReturnLength);
+    ok(Status == STATUS_INFO_LENGTH_MISMATCH, "NtQuerySystemInformation returned %lx\n", Status);
+    ok(ReturnLength == sizeof(PERFTRACE_BUFFER_HEADER), "ReturnLength = %lu\n", ReturnLength);
+
+    /* A new thread has to show up in the trace */
+    Thread = CreateThread(NULL, 0, TraceThreadProc, NULL, 0, &ThreadId);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (Thread)
+    {
+        WaitForSingleObject(Thread, INFINITE);
+        CloseHandle(Thread);
+    }
+
+    do
+    {
+        ReturnLength = 0x55555555;
+        Status = NtQuerySystemInformation(SystemPerformanceTraceInformation, Trace, Length, &ReturnLength);
+        ok(Status == STATUS_SUCCESS, "NtQuerySystemInformation returned %lx\n", Status);
+        if (!NT_SUCCESS(Status)) break;
+
+        ok(Trace->Magic == PERFTRACE_MAGIC, "Magic = %lx\n", Trace->Magic);
+        ok(ReturnLength == sizeof(PERFTRACE_BUFFER_HEADER) + Trace->DataLength,
+           "ReturnLength = %lu, DataLength = %lu\n", ReturnLength, Trace->DataLength);
+
+        for (Offset = 0; Offset < Trace->DataLength; Offset += Event->Size)
+        {
+            Event = (PPERFTRACE_EVENT_HEADER)((PUCHAR)(Trace + 1) + Offset);
+            ok(Event->Size >= sizeof(PERFTRACE_EVENT_HEADER) && !(Event->Size & 7),
+               "Size = %u\n", Event->Size);
+            if (Event->Size < sizeof(PERFTRACE_EVENT_HEADER)) break;
+
+            ThreadEvent = (PPERFTRACE_THREAD_EVENT)Event;
+            if (Event->Type == PERFTRACE_EVENT_THREAD_CREATE && ThreadEvent->ThreadId == ThreadId)
+            {
+                ok(ThreadEvent->ProcessId == GetCurrentProcessId(), "ProcessId = %lu\n", ThreadEvent->ProcessId);
+                Found = TRUE;
+            }
+        }
+    } while (Trace->DataLength);
+    ok(Found, "Thread %lu was not traced\n", ThreadId);
+
+    HeapFree(GetProcessHeap(), 0, Trace);
+
+Stop:
+    Control.Groups = 0;
+    Status = NtSetSystemInformation(SystemPerformanceTraceInformation, &Control, sizeof(Control));
+    ok(Status == STATUS_SUCCESS, "NtSetSystemInformation returned %lx\n", Status);
+    RtlAdjustPrivilege(SE_SYSTEM_PROFILE_PRIVILEGE, Old, FALSE, &Old);
+}
+
 START_TEST(NtSystemInformation)
 {
     NTSTATUS Status;
@@ -353,6 +543,9 @@ START_TEST(NtSystemInformation)
        ntv6(Status == STATUS_INVALID_INFO_CLASS), "NtQuerySystemInformation returned %lx\n", Status);
 
     Test_Flags();
+    Test_CallCount();
+    Test_Locks();
+    Test_PerformanceTrace();
     Test_TimeAdjustment();
     Test_KernelDebugger();
 }
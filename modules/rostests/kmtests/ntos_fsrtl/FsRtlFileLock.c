@@ -0,0 +1,209 @@
+/*
+ * PROJECT:         ReactOS kernel-mode tests
+ * LICENSE:         LGPLv2+ - See COPYING.LIB in the top level directory
+ * PURPOSE:         Kernel-Mode Test Suite FsRtl File Lock Test
+ */
+
+#include <kmt_test.h>
+
+#define NDEBUG
+#include <debug.h>
+
+#define HAMMER_LOCKS    4096
+#define HAMMER_STRIDE   32
+#define HAMMER_LENGTH   16
+
+static FILE_OBJECT TestFileObject;
+
+static BOOLEAN TestLock(PFILE_LOCK FileLock, LONGLONG Offset, LONGLONG Length, ULONG Key, BOOLEAN Exclusive, PNTSTATUS Status)
+{
+    BOOLEAN Result;
+    LARGE_INTEGER FileOffset, LockLength;
+    IO_STATUS_BLOCK IoStatus;
+
+    FileOffset.QuadPart = Offset;
+    LockLength.QuadPart = Length;
+    IoStatus.Status = STATUS_UNSUCCESSFUL;
+    Result = FsRtlFastLock(FileLock, &TestFileObject, &FileOffset, &LockLength,
+                           PsGetCurrentProcess(), Key, TRUE, Exclusive,
+                           &IoStatus, NULL, FALSE);
+    *Status = IoStatus.Status;
+    return Result;
+}
+
+static NTSTATUS TestUnlock(PFILE_LOCK FileLock, LONGLONG Offset, LONGLONG Length, ULONG Key)
+{
+    LARGE_INTEGER FileOffset, LockLength;
+
+    FileOffset.QuadPart = Offset;
+    LockLength.QuadPart = Length;
+    return FsRtlFastUnlockSingle(FileLock, &TestFileObject, &FileOffset, &LockLength,
+                                 PsGetCurrentProcess(), Key, NULL, FALSE);
+}
+
+static BOOLEAN TestRead(PFILE_LOCK FileLock, LONGLONG Offset, LONGLONG Length, ULONG Key)
+{
+    LARGE_INTEGER FileOffset, ReadLength;
+
+    FileOffset.QuadPart = Offset;
+    ReadLength.QuadPart = Length;
+    return FsRtlFastCheckLockForRead(FileLock, &FileOffset, &ReadLength, Key,
+                                     &TestFileObject, PsGetCurrentProcess());
+}
+
+static BOOLEAN TestWrite(PFILE_LOCK FileLock, LONGLONG Offset, LONGLONG Length, ULONG Key)
+{
+    LARGE_INTEGER FileOffset, WriteLength;
+
+    FileOffset.QuadPart = Offset;
+    WriteLength.QuadPart = Length;
+    return FsRtlFastCheckLockForWrite(FileLock, &FileOffset, &WriteLength, Key,
+                                      &TestFileObject, PsGetCurrentProcess());
+}
+
+static VOID FsRtlFileLockTest(VOID)
+{
+    FILE_LOCK FileLock;
+    NTSTATUS Status;
+    BOOLEAN Result;
+    PFILE_LOCK_INFO LockInfo;
+    ULONG Count;
+
+    FsRtlInitializeFileLock(&FileLock, NULL, NULL);
+    ok_bool_false(FsRtlAreThereCurrentFileLocks(&FileLock), "FsRtlAreThereCurrentFileLocks returned");
+    ok_bool_true(TestRead(&FileLock, 0, 100, 1), "TestRead returned");
+    ok_bool_true(TestWrite(&FileLock, 0, 100, 1), "TestWrite returned");
+    ok_eq_hex(TestUnlock(&FileLock, 0, 100, 1), STATUS_RANGE_NOT_LOCKED);
+
+    /* Exclusive lock conflicts with any overlapping lock */
+    Result = TestLock(&FileLock, 0, 100, 1, TRUE, &Status);
+    ok_bool_true(Result, "TestLock returned");
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_bool_true(FsRtlAreThereCurrentFileLocks(&FileLock), "FsRtlAreThereCurrentFileLocks returned");
+    Result = TestLock(&FileLock, 50, 100, 2, TRUE, &Status);
+    ok_bool_false(Result, "TestLock returned");
+    ok_eq_hex(Status, STATUS_FILE_LOCK_CONFLICT);
+    Result = TestLock(&FileLock, 99, 1, 2, FALSE, &Status);
+    ok_bool_false(Result, "TestLock returned");
+    ok_eq_hex(Status, STATUS_FILE_LOCK_CONFLICT);
+
+    /* Shared locks stack */
+    Result = TestLock(&FileLock, 100, 100, 1, FALSE, &Status);
+    ok_bool_true(Result, "TestLock returned");
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    Result = TestLock(&FileLock, 150, 100, 2, FALSE, &Status);
+    ok_bool_true(Result, "TestLock returned");
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    Result = TestLock(&FileLock, 120, 10, 2, TRUE, &Status);
+    ok_bool_false(Result, "TestLock returned");
+    ok_eq_hex(Status, STATUS_FILE_LOCK_CONFLICT);
+
+    /* Access checks */
+    ok_bool_true(TestRead(&FileLock, 50, 10, 1), "TestRead returned");
+    ok_bool_false(TestRead(&FileLock, 50, 10, 2), "TestRead returned");
+    ok_bool_true(TestRead(&FileLock, 150, 10, 2), "TestRead returned");
+    ok_bool_true(TestWrite(&FileLock, 50, 10, 1), "TestWrite returned");
+    ok_bool_false(TestWrite(&FileLock, 50, 10, 2), "TestWrite returned");
+    ok_bool_false(TestWrite(&FileLock, 150, 10, 1), "TestWrite returned");
+    ok_bool_true(TestWrite(&FileLock, 250, 10, 2), "TestWrite returned");
+
+    /* Enumeration is ordered by offset */
+    Count = 0;
+    for (LockInfo = FsRtlGetNextFileLock(&FileLock, TRUE);
+         LockInfo;
+         LockInfo = FsRtlGetNextFileLock(&FileLock, FALSE))
+    {
+        if (Count == 0) ok_eq_longlong(LockInfo->StartingByte.QuadPart, 0LL);
+        if (Count == 1) ok_eq_longlong(LockInfo->StartingByte.QuadPart, 100LL);
+        if (Count == 2) ok_eq_longlong(LockInfo->StartingByte.QuadPart, 150LL);
+        Count++;
+    }
+    ok_eq_ulong(Count, 3UL);
+
+    /* Unlocking needs the exact range and owner */
+    ok_eq_hex(TestUnlock(&FileLock, 0, 50, 1), STATUS_RANGE_NOT_LOCKED);
+    ok_eq_hex(TestUnlock(&FileLock, 0, 100, 2), STATUS_RANGE_NOT_LOCKED);
+    ok_eq_hex(TestUnlock(&FileLock, 0, 100, 1), STATUS_SUCCESS);
+    ok_bool_true(TestRead(&FileLock, 50, 10, 2), "TestRead returned");
+    ok_eq_hex(TestUnlock(&FileLock, 150, 100, 2), STATUS_SUCCESS);
+    Result = TestLock(&FileLock, 220, 10, 2, TRUE, &Status);
+    ok_bool_true(Result, "TestLock returned");
+    ok_eq_hex(Status, STATUS_SUCCESS);
+
+    ok_eq_hex(FsRtlFastUnlockAll(&FileLock, &TestFileObject, PsGetCurrentProcess(), NULL), STATUS_SUCCESS);
+    ok_bool_false(FsRtlAreThereCurrentFileLocks(&FileLock), "FsRtlAreThereCurrentFileLocks returned");
+    ok(FsRtlGetNextFileLock(&FileLock, TRUE) == NULL, "Expected no lock left\n");
+
+    FsRtlUninitializeFileLock(&FileLock);
+}
+
+static VOID FsRtlFileLockHammerTest(VOID)
+{
+    FILE_LOCK FileLock;
+    NTSTATUS Status;
+    ULONG i, Failures;
+    LARGE_INTEGER Frequency, Start, Stop;
+    ULONGLONG LockTime, CheckTime, UnlockTime;
+
+    FsRtlInitializeFileLock(&FileLock, NULL, NULL);
+
+    Failures = 0;
+    Start = KeQueryPerformanceCounter(&Frequency);
+    for (i = 0; i < HAMMER_LOCKS; i++)
+    {
+        /* Interleave from both ends so the tree has to rebalance */
+        ULONG Slot = (i & 1) ? HAMMER_LOCKS - 1 - i / 2 : i / 2;
+        if (!TestLock(&FileLock, (LONGLONG)Slot * HAMMER_STRIDE, HAMMER_LENGTH, Slot, (Slot & 3) == 0, &Status))
+            Failures++;
+    }
+    Stop = KeQueryPerformanceCounter(NULL);
+    LockTime = Stop.QuadPart - Start.QuadPart;
+    ok_eq_ulong(Failures, 0UL);
+
+    Failures = 0;
+    Start = KeQueryPerformanceCounter(NULL);
+    for (i = 0; i < HAMMER_LOCKS; i++)
+    {
+        /* Every lock blocks writes from another key, reads only if exclusive */
+        if (TestWrite(&FileLock, (LONGLONG)i * HAMMER_STRIDE + 1, 1, i + 1))
+            Failures++;
+        if (TestRead(&FileLock, (LONGLONG)i * HAMMER_STRIDE + 1, 1, i + 1) == ((i & 3) == 0))
+            Failures++;
+        if (!TestWrite(&FileLock, (LONGLONG)i * HAMMER_STRIDE + HAMMER_LENGTH, HAMMER_STRIDE - HAMMER_LENGTH, i + 1))
+            Failures++;
+    }
+    Stop = KeQueryPerformanceCounter(NULL);
+    CheckTime = Stop.QuadPart - Start.QuadPart;
+    ok_eq_ulong(Failures, 0UL);
+
+    Failures = 0;
+    Start = KeQueryPerformanceCounter(NULL);
+    for (i = 0; i < HAMMER_LOCKS; i++)
+    {
+        ULONG Slot = (i * 7919) % HAMMER_LOCKS;
+        if (TestUnlock(&FileLock, (LONGLONG)Slot * HAMMER_STRIDE, HAMMER_LENGTH, Slot) != STATUS_SUCCESS)
+            Failures++;
+    }
+    Stop = KeQueryPerformanceCounter(NULL);
+    UnlockTime = Stop.QuadPart - Start.QuadPart;
+    ok_eq_ulong(Failures, 0UL);
+    ok_bool_false(FsRtlAreThereCurrentFileLocks(&FileLock), "FsRtlAreThereCurrentFileLocks returned");
+
+    if (Frequency.QuadPart)
+    {
+        trace("%lu locks: lock %I64u ns, check %I64u ns, unlock %I64u ns per operation\n",
+              (ULONG)HAMMER_LOCKS,
+              LockTime * 1000000000ULL / Frequency.QuadPart / HAMMER_LOCKS,
+              CheckTime * 1000000000ULL / Frequency.QuadPart / (3 * HAMMER_LOCKS),
+              UnlockTime * 1000000000ULL / Frequency.QuadPart / HAMMER_LOCKS);
+    }
+
+    FsRtlUninitializeFileLock(&FileLock);
+}
+
+START_TEST(FsRtlFileLock)
+{
+    RtlInitUnicodeString(&TestFileObject.FileName, L"FsRtlFileLock");
+    FsRtlFileLockTest();
+    FsRtlFileLockHammerTest();
+}
@@ -715,10 +715,67 @@ static VOID FsRtlLargeMcbTestsFastFat()
     FsRtlUninitializeLargeMcb(&FirstMcb);
 }
 
+static VOID FsRtlLargeMcbBenchmark()
+{
+    LARGE_MCB LargeMcb;
+    ULONG i, NbRuns, Failures;
+    LONGLONG Vbn, Lbn, SectorCount;
+    LARGE_INTEGER Frequency, Start, Stop;
+    ULONGLONG AddTime, LookupTime, EnumTime;
+    const ULONG Fragments = 8192;
+
+    FsRtlInitializeLargeMcb(&LargeMcb, PagedPool);
+
+    /* One sector mapped out of two, none of them contiguous on disk */
+    Failures = 0;
+    Start = KeQueryPerformanceCounter(&Frequency);
+    for (i = 0; i < Fragments; i++)
+    {
+        if (!FsRtlAddLargeMcbEntry(&LargeMcb, 2 * i + 1, 3 * i + 100, 1))
+            Failures++;
+    }
+    Stop = KeQueryPerformanceCounter(NULL);
+    AddTime = Stop.QuadPart - Start.QuadPart;
+    ok_eq_ulong(Failures, 0);
+    NbRuns = FsRtlNumberOfRunsInLargeMcb(&LargeMcb);
+    ok_eq_ulong(NbRuns, 2 * Fragments);
+
+    Failures = 0;
+    Start = KeQueryPerformanceCounter(NULL);
+    for (i = 0; i < Fragments; i++)
+    {
+        ULONG Fragment = (i * 7919) % Fragments;
+        if (!FsRtlLookupLargeMcbEntry(&LargeMcb, 2 * Fragment + 1, &Lbn, NULL, NULL, NULL, NULL) ||
+            Lbn != 3 * Fragment + 100)
+            Failures++;
+    }
+    Stop = KeQueryPerformanceCounter(NULL);
+    LookupTime = Stop.QuadPart - Start.QuadPart;
+    ok_eq_ulong(Failures, 0);
+
+    Start = KeQueryPerformanceCounter(NULL);
+    for (i = 0; FsRtlGetNextLargeMcbEntry(&LargeMcb, i, &Vbn, &Lbn, &SectorCount); i++);
+    Stop = KeQueryPerformanceCounter(NULL);
+    EnumTime = Stop.QuadPart - Start.QuadPart;
+    ok_eq_ulong(i, 2 * Fragments);
+
+    if (Frequency.QuadPart)
+    {
+        trace("%lu runs: add %I64u ns, lookup %I64u ns, enumerate %I64u ns per run\n",
+              NbRuns,
+              AddTime * 1000000000ULL / Frequency.QuadPart / Fragments,
+              LookupTime * 1000000000ULL / Frequency.QuadPart / Fragments,
+              EnumTime * 1000000000ULL / Frequency.QuadPart / NbRuns);
+    }
+
+    FsRtlUninitializeLargeMcb(&LargeMcb);
+}
+
 START_TEST(FsRtlMcb)
 {
     FsRtlMcbTest();
     FsRtlLargeMcbTest();
     FsRtlLargeMcbTestsExt2();
     FsRtlLargeMcbTestsFastFat();
+    FsRtlLargeMcbBenchmark();
 }
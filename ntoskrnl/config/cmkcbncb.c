@@ -150,6 +150,7 @@ CmpGetNameControlBlock(IN PUNICODE_STRING NodeName)
     PCM_NAME_CONTROL_BLOCK Ncb = NULL;
     ULONG ConvKey = 0;
     PWCHAR p, pp;
+    WCHAR Char;
     ULONG i;
     BOOLEAN IsCompressed = TRUE, Found = FALSE;
     PCM_NAME_HASH HashEntry;
@@ -201,14 +202,29 @@ CmpGetNameControlBlock(IN PUNICODE_STRING NodeName)
             /* Assume success */
             Found = TRUE;
 
-            /* If the NCB is compressed, do a compressed name compare */
-            if (Ncb->Compressed)
+            /*
+             * Uncompressed NCB names are stored upcased, so only the name we
+             * are looking for needs to be converted. Compressed names keep
+             * characters whose upcased form doesn't fit in a byte as they
+             * are, so both sides get upcased there.
+             */
+            if (Ncb->Compressed != IsCompressed)
             {
-                /* Compare names */
-                if (CmpCompareCompressedName(NodeName, Ncb->Name, Length))
+                /* The lengths don't count the same units */
+                Found = FALSE;
+            }
+            else if (Ncb->Compressed)
+            {
+                /* Compare each character against the compressed name */
+                for (i = 0; i < Length; i++)
                 {
-                    /* We failed */
-                    Found = FALSE;
+                    if (RtlUpcaseUnicodeChar(NodeName->Buffer[i]) !=
+                        RtlUpcaseUnicodeChar((WCHAR)((PUCHAR)Ncb->Name)[i]))
+                    {
+                        /* Failed */
+                        Found = FALSE;
+                        break;
+                    }
                 }
             }
             else
@@ -219,7 +235,7 @@ CmpGetNameControlBlock(IN PUNICODE_STRING NodeName)
                 for (i = 0; i < Ncb->NameLength; i += sizeof(WCHAR))
                 {
                     /* Compare the character */
-                    if (RtlUpcaseUnicodeChar(*p) != RtlUpcaseUnicodeChar(*pp))
+                    if (RtlUpcaseUnicodeChar(*p) != *pp)
                     {
                         /* Failed */
                         Found = FALSE;
@@ -268,8 +284,10 @@ CmpGetNameControlBlock(IN PUNICODE_STRING NodeName)
             /* Copy the compressed name */
             for (i = 0; i < NodeName->Length / sizeof(WCHAR); i++)
             {
-                /* Copy Unicode to ANSI */
-                ((PCHAR)Ncb->Name)[i] = (CHAR)RtlUpcaseUnicodeChar(NodeName->Buffer[i]);
+                /* Copy Unicode to ANSI, upcased if that still fits */
+                Char = RtlUpcaseUnicodeChar(NodeName->Buffer[i]);
+                if (Char > (UCHAR)-1) Char = NodeName->Buffer[i];
+                ((PCHAR)Ncb->Name)[i] = (CHAR)Char;
             }
         }
         else
@@ -193,6 +193,7 @@ NtDeleteKey(IN HANDLE KeyHandle)
 {
     PCM_KEY_BODY KeyObject;
     NTSTATUS Status;
+    ULONGLONG StartTime;
     REG_DELETE_KEY_INFORMATION DeleteKeyInfo;
     REG_POST_OPERATION_INFORMATION PostOperationInfo;
     PAGED_CODE();
@@ -223,7 +224,12 @@ NtDeleteKey(IN HANDLE KeyHandle)
         else
         {
             /* Call the internal API */
+            StartTime = PerfInfoStartRegistryOperation();
             Status = CmDeleteKey(KeyObject);
+            PerfInfoEndRegistryOperation(StartTime,
+                                         PERFTRACE_REG_DELETE_KEY,
+                                         KeyObject->KeyControlBlock,
+                                         Status);
         }
 
         /* Do post callback */
@@ -247,6 +253,7 @@ NtEnumerateKey(IN HANDLE KeyHandle,
 {
     KPROCESSOR_MODE PreviousMode = ExGetPreviousMode();
     NTSTATUS Status;
+    ULONGLONG StartTime;
     PCM_KEY_BODY KeyObject;
     REG_ENUMERATE_KEY_INFORMATION EnumerateKeyInfo;
     REG_POST_OPERATION_INFORMATION PostOperationInfo;
@@ -303,12 +310,17 @@ NtEnumerateKey(IN HANDLE KeyHandle,
     if (NT_SUCCESS(Status))
     {
         /* Call the internal API */
+        StartTime = PerfInfoStartRegistryOperation();
         Status = CmEnumerateKey(KeyObject->KeyControlBlock,
                                 Index,
                                 KeyInformationClass,
                                 KeyInformation,
                                 Length,
                                 ResultLength);
+        PerfInfoEndRegistryOperation(StartTime,
+                                     PERFTRACE_REG_ENUMERATE_KEY,
+                                     KeyObject->KeyControlBlock,
+                                     Status);
 
         /* Do the post callback */
         PostOperationInfo.Status = Status;
@@ -332,6 +344,7 @@ NtEnumerateValueKey(IN HANDLE KeyHandle,
 {
     KPROCESSOR_MODE PreviousMode = ExGetPreviousMode();
     NTSTATUS Status;
+    ULONGLONG StartTime;
     PCM_KEY_BODY KeyObject;
     REG_ENUMERATE_VALUE_KEY_INFORMATION EnumerateValueKeyInfo;
     REG_POST_OPERATION_INFORMATION PostOperationInfo;
@@ -390,12 +403,17 @@ NtEnumerateValueKey(IN HANDLE KeyHandle,
     if (NT_SUCCESS(Status))
     {
         /* Call the internal API */
+        StartTime = PerfInfoStartRegistryOperation();
         Status = CmEnumerateValueKey(KeyObject->KeyControlBlock,
                                      Index,
                                      KeyValueInformationClass,
                                      KeyValueInformation,
                                      Length,
                                      ResultLength);
+        PerfInfoEndRegistryOperation(StartTime,
+                                     PERFTRACE_REG_ENUMERATE_VALUE,
+                                     KeyObject->KeyControlBlock,
+                                     Status);
 
         /* Do the post callback */
         PostOperationInfo.Status = Status;
@@ -416,6 +434,7 @@ NtQueryKey(IN HANDLE KeyHandle,
 {
     KPROCESSOR_MODE PreviousMode = ExGetPreviousMode();
     NTSTATUS Status;
+    ULONGLONG StartTime;
     PCM_KEY_BODY KeyObject;
     REG_QUERY_KEY_INFORMATION QueryKeyInfo;
     REG_POST_OPERATION_INFORMATION PostOperationInfo;
@@ -502,11 +521,16 @@ NtQueryKey(IN HANDLE KeyHandle,
     if (NT_SUCCESS(Status))
     {
         /* Call the internal API */
+        StartTime = PerfInfoStartRegistryOperation();
         Status = CmQueryKey(KeyObject->KeyControlBlock,
                             KeyInformationClass,
                             KeyInformation,
                             Length,
                             ResultLength);
+        PerfInfoEndRegistryOperation(StartTime,
+                                     PERFTRACE_REG_QUERY_KEY,
+                                     KeyObject->KeyControlBlock,
+                                     Status);
 
         /* Do the post callback */
         PostOperationInfo.Status = Status;
@@ -529,6 +553,7 @@ NtQueryValueKey(IN HANDLE KeyHandle,
 {
     KPROCESSOR_MODE PreviousMode = ExGetPreviousMode();
     NTSTATUS Status;
+    ULONGLONG StartTime;
     PCM_KEY_BODY KeyObject;
     REG_QUERY_VALUE_KEY_INFORMATION QueryValueKeyInfo;
     REG_POST_OPERATION_INFORMATION PostOperationInfo;
@@ -595,12 +620,17 @@ NtQueryValueKey(IN HANDLE KeyHandle,
     if (NT_SUCCESS(Status))
     {
         /* Call the internal API */
+        StartTime = PerfInfoStartRegistryOperation();
         Status = CmQueryValueKey(KeyObject->KeyControlBlock,
                                  ValueNameCopy,
                                  KeyValueInformationClass,
                                  KeyValueInformation,
                                  Length,
                                  ResultLength);
+        PerfInfoEndRegistryOperation(StartTime,
+                                     PERFTRACE_REG_QUERY_VALUE,
+                                     KeyObject->KeyControlBlock,
+                                     Status);
 
         /* Do the post callback */
         PostOperationInfo.Status = Status;
@@ -622,6 +652,7 @@ NtSetValueKey(IN HANDLE KeyHandle,
               IN ULONG DataSize)
 {
     NTSTATUS Status = STATUS_SUCCESS;
+    ULONGLONG StartTime;
     PCM_KEY_BODY KeyObject = NULL;
     REG_SET_VALUE_KEY_INFORMATION SetValueKeyInfo;
     REG_POST_OPERATION_INFORMATION PostOperationInfo;
@@ -718,11 +749,16 @@ NtSetValueKey(IN HANDLE KeyHandle,
     if (NT_SUCCESS(Status))
     {
         /* Call the internal API */
+        StartTime = PerfInfoStartRegistryOperation();
         Status = CmSetValueKey(KeyObject->KeyControlBlock,
                                &ValueNameCopy,
                                Type,
                                Data,
                                DataSize);
+        PerfInfoEndRegistryOperation(StartTime,
+                                     PERFTRACE_REG_SET_VALUE,
+                                     KeyObject->KeyControlBlock,
+                                     Status);
     }
 
     /* Do the post-callback */
@@ -746,6 +782,7 @@ NtDeleteValueKey(IN HANDLE KeyHandle,
 {
     PCM_KEY_BODY KeyObject;
     NTSTATUS Status;
+    ULONGLONG StartTime;
     REG_DELETE_VALUE_KEY_INFORMATION DeleteValueKeyInfo;
     REG_POST_OPERATION_INFORMATION PostOperationInfo;
     KPROCESSOR_MODE PreviousMode = ExGetPreviousMode();
@@ -785,7 +822,12 @@ NtDeleteValueKey(IN HANDLE KeyHandle,
     if (NT_SUCCESS(Status))
     {
         /* Call the internal API */
+        StartTime = PerfInfoStartRegistryOperation();
         Status = CmDeleteValueKey(KeyObject->KeyControlBlock, ValueNameCopy);
+        PerfInfoEndRegistryOperation(StartTime,
+                                     PERFTRACE_REG_DELETE_VALUE,
+                                     KeyObject->KeyControlBlock,
+                                     Status);
 
         /* Do the post callback */
         PostOperationInfo.Object = (PVOID)KeyObject;
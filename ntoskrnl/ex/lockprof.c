@@ -0,0 +1,226 @@
+/*
+ * PROJECT:         ReactOS Kernel
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            ntoskrnl/ex/lockprof.c
+ * PURPOSE:         Lock Contention Profiler
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <ntoskrnl.h>
+#define NDEBUG
+#include <debug.h>
+
+#define TAG_LOCK_PROFILE        'fPkL'
+
+/* Power of two, and only ever filled up to three quarters */
+#define LOCK_PROFILE_TABLE_SIZE 1024
+#define LOCK_PROFILE_TABLE_MAX  (LOCK_PROFILE_TABLE_SIZE * 3 / 4)
+
+/* GLOBALS *******************************************************************/
+
+ULONG ExpLockProfileFlags;
+static PSYSTEM_LOCK_PROFILE_ENTRY ExpLockProfileTable;
+static ULONG ExpLockProfileEntries;
+static ULONG ExpLockProfileDropped;
+static LONGLONG ExpLockProfileFrequency;
+static KSPIN_LOCK ExpLockProfileLock;
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+static
+PSYSTEM_LOCK_PROFILE_ENTRY
+ExpLookupLockProfileEntry(IN PVOID Lock,
+                          IN USHORT Type)
+{
+    PSYSTEM_LOCK_PROFILE_ENTRY Entry;
+    ULONG Index;
+
+    /* Open addressing with linear probing; entries are never removed */
+    Index = (ULONG)(((ULONG_PTR)Lock >> 3) * 2654435761u) & (LOCK_PROFILE_TABLE_SIZE - 1);
+    for (;;)
+    {
+        Entry = &ExpLockProfileTable[Index];
+        if ((Entry->Address == Lock) && (Entry->Type == Type)) return Entry;
+        if (!Entry->Address) break;
+        Index = (Index + 1) & (LOCK_PROFILE_TABLE_SIZE - 1);
+    }
+
+    /* Claim the empty slot unless the table is as full as we let it get */
+    if (ExpLockProfileEntries >= LOCK_PROFILE_TABLE_MAX) return NULL;
+    ExpLockProfileEntries++;
+    Entry->Address = Lock;
+    Entry->Type = Type;
+    return Entry;
+}
+
+static
+VOID
+ExpRecordOwnerCaller(IN PSYSTEM_LOCK_PROFILE_ENTRY Entry,
+                     IN PVOID OwnerCaller)
+{
+    ULONG i, Min = 0;
+
+    for (i = 0; i < LOCK_PROFILE_CALLERS; i++)
+    {
+        if (Entry->OwnerCallers[i] == OwnerCaller)
+        {
+            Entry->OwnerCallerHits[i]++;
+            return;
+        }
+
+        if (Entry->OwnerCallerHits[i] < Entry->OwnerCallerHits[Min]) Min = i;
+    }
+
+    /*
+     * Evict the least hit caller but keep its count, so a site that keeps
+     * showing up can still overtake the ones that were seen first.
+     */
+    Entry->OwnerCallers[Min] = OwnerCaller;
+    Entry->OwnerCallerHits[Min]++;
+}
+
+/* FUNCTIONS *****************************************************************/
+
+/*
+ * Turns profiling on for the given LOCK_PROFILE_* classes, or off if Flags is
+ * zero. Turning it on always starts over with an empty table.
+ */
+NTSTATUS
+NTAPI
+ExpSetLockProfiling(IN ULONG Flags)
+{
+    PSYSTEM_LOCK_PROFILE_ENTRY NewTable = NULL, OldTable;
+    LARGE_INTEGER Frequency;
+    KIRQL OldIrql;
+
+    PAGED_CODE();
+
+    Frequency.QuadPart = 1;
+    Flags &= LOCK_PROFILE_ALL;
+    if (Flags)
+    {
+        NewTable = ExAllocatePoolWithTag(NonPagedPool,
+                                         LOCK_PROFILE_TABLE_SIZE * sizeof(SYSTEM_LOCK_PROFILE_ENTRY),
+                                         TAG_LOCK_PROFILE);
+        if (!NewTable) return STATUS_INSUFFICIENT_RESOURCES;
+        RtlZeroMemory(NewTable, LOCK_PROFILE_TABLE_SIZE * sizeof(SYSTEM_LOCK_PROFILE_ENTRY));
+
+        KeQueryPerformanceCounter(&Frequency);
+        if (!Frequency.QuadPart) Frequency.QuadPart = 1;
+    }
+
+    KeAcquireSpinLock(&ExpLockProfileLock, &OldIrql);
+    OldTable = ExpLockProfileTable;
+    ExpLockProfileTable = NewTable;
+    ExpLockProfileEntries = 0;
+    ExpLockProfileDropped = 0;
+    ExpLockProfileFrequency = Frequency.QuadPart;
+    ExpLockProfileFlags = Flags;
+    KeReleaseSpinLock(&ExpLockProfileLock, OldIrql);
+
+    if (OldTable) ExFreePoolWithTag(OldTable, TAG_LOCK_PROFILE);
+    return STATUS_SUCCESS;
+}
+
+/*
+ * Charges a finished wait to its lock. WaitStart is the performance counter
+ * value sampled just before the waiter blocked, OwnerCaller the code address
+ * that acquired the lock the waiter ran into, when it is known.
+ */
+VOID
+NTAPI
+ExpRecordLockWait(IN PVOID Lock,
+                  IN USHORT Type,
+                  IN PVOID OwnerCaller OPTIONAL,
+                  IN LONGLONG WaitStart)
+{
+    PSYSTEM_LOCK_PROFILE_ENTRY Entry;
+    ULONGLONG WaitTime;
+    ULONG Bucket;
+    KIRQL OldIrql;
+
+    WaitTime = KeQueryPerformanceCounter(NULL).QuadPart - WaitStart;
+
+    KeAcquireSpinLock(&ExpLockProfileLock, &OldIrql);
+
+    /* Profiling could have been turned off while we were waiting */
+    if (!ExpLockProfileTable)
+    {
+        KeReleaseSpinLock(&ExpLockProfileLock, OldIrql);
+        return;
+    }
+
+    Entry = ExpLookupLockProfileEntry(Lock, Type);
+    if (!Entry)
+    {
+        ExpLockProfileDropped++;
+        KeReleaseSpinLock(&ExpLockProfileLock, OldIrql);
+        return;
+    }
+
+    WaitTime = WaitTime * 1000000 / ExpLockProfileFrequency;
+    for (Bucket = 0; (Bucket < LOCK_PROFILE_BUCKETS - 1) && (WaitTime >> (Bucket + 1)); Bucket++);
+
+    Entry->Waits++;
+    Entry->TotalWaitTime += WaitTime;
+    if (WaitTime > Entry->MaxWaitTime) Entry->MaxWaitTime = WaitTime;
+    Entry->Histogram[Bucket]++;
+    if (OwnerCaller) ExpRecordOwnerCaller(Entry, OwnerCaller);
+
+    KeReleaseSpinLock(&ExpLockProfileLock, OldIrql);
+}
+
+/*
+ * Copies the profile out into a locked down buffer. Only the entries that fit
+ * are copied, ReturnLength always gets the size of the whole profile.
+ */
+NTSTATUS
+NTAPI
+ExpQueryLockProfile(OUT PSYSTEM_LOCK_PROFILE_INFORMATION ProfileInformation OPTIONAL,
+                    IN ULONG ProfileInformationLength,
+                    OUT PULONG ReturnLength)
+{
+    PSYSTEM_LOCK_PROFILE_ENTRY Entry;
+    ULONG i, Count = 0, Required;
+    BOOLEAN Header;
+    KIRQL OldIrql;
+
+    Header = (ProfileInformation != NULL) &&
+             (ProfileInformationLength >= FIELD_OFFSET(SYSTEM_LOCK_PROFILE_INFORMATION, Entries));
+
+    KeAcquireSpinLock(&ExpLockProfileLock, &OldIrql);
+
+    Required = FIELD_OFFSET(SYSTEM_LOCK_PROFILE_INFORMATION, Entries) +
+               ExpLockProfileEntries * sizeof(SYSTEM_LOCK_PROFILE_ENTRY);
+
+    if (Header)
+    {
+        ProfileInformation->Signature = LOCK_PROFILE_SIGNATURE;
+        ProfileInformation->Flags = ExpLockProfileFlags;
+        ProfileInformation->DroppedWaits = ExpLockProfileDropped;
+
+        for (i = 0; ExpLockProfileTable && (i < LOCK_PROFILE_TABLE_SIZE); i++)
+        {
+            Entry = &ExpLockProfileTable[i];
+            if (!Entry->Address) continue;
+
+            if (FIELD_OFFSET(SYSTEM_LOCK_PROFILE_INFORMATION, Entries) +
+                (Count + 1) * sizeof(SYSTEM_LOCK_PROFILE_ENTRY) > ProfileInformationLength)
+            {
+                break;
+            }
+
+            ProfileInformation->Entries[Count++] = *Entry;
+        }
+
+        ProfileInformation->NumberOfEntries = Count;
+    }
+
+    KeReleaseSpinLock(&ExpLockProfileLock, OldIrql);
+
+    *ReturnLength = Required;
+    return (ProfileInformationLength < Required) ? STATUS_INFO_LENGTH_MISMATCH : STATUS_SUCCESS;
+}
+
+/* EOF */
@@ -474,6 +474,7 @@ ExfAcquirePushLockExclusive(PEX_PUSH_LOCK PushLock)
     BOOLEAN NeedWake;
     EX_PUSH_LOCK_WAIT_BLOCK Block;
     PEX_PUSH_LOCK_WAIT_BLOCK WaitBlock = &Block;
+    LONGLONG WaitStart;
 
     /* Start main loop */
     for (;;)
@@ -611,9 +612,15 @@ ExfAcquirePushLockExclusive(PEX_PUSH_LOCK PushLock)
             /* Now try to remove the wait bit */
             if (InterlockedBitTestAndReset(&WaitBlock->Flags, 1))
             {
+                /* Sample the wait if push locks are being profiled */
+                WaitStart = (ExpLockProfileFlags & LOCK_PROFILE_PUSH_LOCKS) ?
+                            KeQueryPerformanceCounter(NULL).QuadPart : 0;
+
                 /* Nobody removed it already, let's do a full wait */
                 KeWaitForGate(&WaitBlock->WakeGate, WrPushLock, KernelMode);
                 ASSERT(WaitBlock->Signaled);
+
+                if (WaitStart) ExpRecordLockWait(PushLock, LOCK_PROFILE_TYPE_PUSH_LOCK, NULL, WaitStart);
             }
 
             /* We shouldn't be shared anymore */
@@ -648,6 +655,7 @@ ExfAcquirePushLockShared(PEX_PUSH_LOCK PushLock)
     BOOLEAN NeedWake;
     EX_PUSH_LOCK_WAIT_BLOCK Block;
     PEX_PUSH_LOCK_WAIT_BLOCK WaitBlock = &Block;
+    LONGLONG WaitStart;
 
     /* Start main loop */
     for (;;)
@@ -778,9 +786,15 @@ ExfAcquirePushLockShared(PEX_PUSH_LOCK PushLock)
             /* Now try to remove the wait bit */
             if (InterlockedBitTestAndReset(&WaitBlock->Flags, 1))
             {
+                /* Sample the wait if push locks are being profiled */
+                WaitStart = (ExpLockProfileFlags & LOCK_PROFILE_PUSH_LOCKS) ?
+                            KeQueryPerformanceCounter(NULL).QuadPart : 0;
+
                 /* Fast-path did not work, we need to do a full wait */
                 KeWaitForGate(&WaitBlock->WakeGate, WrPushLock, KernelMode);
                 ASSERT(WaitBlock->Signaled);
+
+                if (WaitStart) ExpRecordLockWait(PushLock, LOCK_PROFILE_TYPE_PUSH_LOCK, NULL, WaitStart);
             }
 
             /* We shouldn't be shared anymore */
@@ -625,10 +625,19 @@ ExpWaitForResource(IN PERESOURCE Resource,
     NTSTATUS Status;
     LARGE_INTEGER Timeout;
     PKTHREAD Thread, OwnerThread;
+    LONGLONG WaitStart = 0;
+    PVOID OwnerCaller = NULL;
 #if DBG
     KLOCK_QUEUE_HANDLE LockHandle;
 #endif
 
+    /* Remember when we blocked and who had the resource exclusively */
+    if (ExpLockProfileFlags & LOCK_PROFILE_RESOURCES)
+    {
+        if (IsOwnedExclusive(Resource)) OwnerCaller = Resource->Address;
+        WaitStart = KeQueryPerformanceCounter(NULL).QuadPart;
+    }
+
     /* Increase contention count and use a 5 second timeout */
     Resource->ContentionCount++;
     Timeout.QuadPart = 500 * -10000;
@@ -727,6 +736,87 @@ ExpWaitForResource(IN PERESOURCE Resource,
             }
         }
     }
+
+    /* Charge the wait to the resource */
+    if (WaitStart) ExpRecordLockWait(Resource, RTL_RESOURCE_TYPE, OwnerCaller, WaitStart);
+}
+
+/*++
+ * @name ExQuerySystemLockInformation
+ *
+ *     The ExQuerySystemLockInformation routine takes a snapshot of every
+ *     resource in the system resource list.
+ *
+ * @param LockInformation
+ *        Optional pointer to a locked down buffer receiving the snapshot.
+ *
+ * @param LockInformationLength
+ *        Size of the buffer, in bytes.
+ *
+ * @param ReturnLength
+ *        Receives the size needed to describe all resources.
+ *
+ * @return STATUS_SUCCESS, or STATUS_INFO_LENGTH_MISMATCH if only part of the
+ *         resources fit into the buffer.
+ *
+ * @remarks The buffer is written to at DISPATCH_LEVEL.
+ *
+ *--*/
+NTSTATUS
+NTAPI
+ExQuerySystemLockInformation(OUT PRTL_PROCESS_LOCKS LockInformation OPTIONAL,
+                             IN ULONG LockInformationLength,
+                             OUT PULONG ReturnLength)
+{
+    PRTL_PROCESS_LOCK_INFORMATION LockEntry;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PLIST_ENTRY NextEntry;
+    PERESOURCE Resource;
+    ERESOURCE_THREAD OwnerThread;
+    ULONG Count = 0, Required;
+
+    Required = FIELD_OFFSET(RTL_PROCESS_LOCKS, Locks);
+    if (LockInformationLength < Required) LockInformation = NULL;
+
+    KeAcquireInStackQueuedSpinLock(&ExpResourceSpinLock, &LockHandle);
+
+    for (NextEntry = ExpSystemResourcesList.Flink;
+         NextEntry != &ExpSystemResourcesList;
+         NextEntry = NextEntry->Flink)
+    {
+        Resource = CONTAINING_RECORD(NextEntry, ERESOURCE, SystemResourcesList);
+        Required += sizeof(RTL_PROCESS_LOCK_INFORMATION);
+
+        /* Keep counting once the buffer is full, to report the needed size */
+        if (!LockInformation || (Required > LockInformationLength)) continue;
+
+        LockEntry = &LockInformation->Locks[Count++];
+        LockEntry->Address = Resource;
+        LockEntry->Type = RTL_RESOURCE_TYPE;
+        LockEntry->CreatorBackTraceIndex = 0;
+        LockEntry->OwnerThreadId = 0;
+        LockEntry->RecursionCount = 0;
+
+        /* Owner pointers set by ExSetResourceOwnerPointer aren't threads */
+        OwnerThread = Resource->OwnerEntry.OwnerThread;
+        if (IsOwnedExclusive(Resource) && OwnerThread && !(OwnerThread & 3))
+        {
+            LockEntry->OwnerThreadId = HandleToUlong(((PETHREAD)OwnerThread)->Cid.UniqueThread);
+            LockEntry->RecursionCount = Resource->OwnerEntry.OwnerCount;
+        }
+
+        LockEntry->ActiveCount = Resource->ActiveCount;
+        LockEntry->ContentionCount = Resource->ContentionCount;
+        LockEntry->EntryCount = Resource->ActiveEntries;
+        LockEntry->NumberOfSharedWaiters = Resource->NumberOfSharedWaiters;
+        LockEntry->NumberOfExclusiveWaiters = Resource->NumberOfExclusiveWaiters;
+    }
+
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    if (LockInformation) LockInformation->NumberOfLocks = Count;
+    *ReturnLength = Required;
+    return (LockInformationLength < Required) ? STATUS_INFO_LENGTH_MISMATCH : STATUS_SUCCESS;
 }
 
 /* FUNCTIONS *****************************************************************/
@@ -828,6 +918,7 @@ TryAcquire:
 
                 /* Set owner and return success */
                 Resource->OwnerEntry.OwnerThread = ExGetCurrentResourceThread();
+                if (ExpLockProfileFlags & LOCK_PROFILE_RESOURCES) Resource->Address = _ReturnAddress();
                 return TRUE;
             }
         }
@@ -843,6 +934,9 @@ TryAcquire:
         Resource->OwnerEntry.OwnerThread = Thread;
         Resource->OwnerEntry.OwnerCount = 1;
         Success = TRUE;
+
+        /* Remember where it was acquired for the lock profiler */
+        if (ExpLockProfileFlags & LOCK_PROFILE_RESOURCES) Resource->Address = _ReturnAddress();
     }
 
     /* Release the lock and return */
@@ -1900,6 +1994,9 @@ ExReleaseResourceForThreadLite(IN PERESOURCE Resource,
             Resource->OwnerEntry.OwnerCount = 1;
             Resource->ActiveEntries = 1;
             Resource->NumberOfExclusiveWaiters--;
+
+            /* The waiter records its own caller once it runs */
+            if (ExpLockProfileFlags & LOCK_PROFILE_RESOURCES) Resource->Address = NULL;
             
             /* Release the lock and give it away */
             ASSERT(Resource->ActiveCount == 1);
@@ -1994,6 +2091,9 @@ ExReleaseResourceForThreadLite(IN PERESOURCE Resource,
                 Resource->ActiveEntries = 1;
                 Resource->NumberOfExclusiveWaiters--;
 
+                /* The waiter records its own caller once it runs */
+                if (ExpLockProfileFlags & LOCK_PROFILE_RESOURCES) Resource->Address = NULL;
+
                 /* Release the lock and give it away */
                 ASSERT(Resource->ActiveCount == 1);
                 ExReleaseResourceLock(Resource, &LockHandle);
@@ -2155,6 +2255,7 @@ ExTryToAcquireResourceExclusiveLite(IN PERESOURCE Resource)
         Resource->ActiveCount = 1;
         Resource->ActiveEntries = 1;
         Acquired = TRUE;
+        if (ExpLockProfileFlags & LOCK_PROFILE_RESOURCES) Resource->Address = _ReturnAddress();
     }
     else if ((IsOwnedExclusive(Resource)) &&
              (Resource->OwnerEntry.OwnerThread == Thread))
@@ -1011,9 +1011,60 @@ Skip:
 /* Class 6 - Call Count Information */
 QSI_DEF(SystemCallCountInformation)
 {
-    /* FIXME */
-    DPRINT1("NtQuerySystemInformation - SystemCallCountInformation not implemented\n");
-    return STATUS_NOT_IMPLEMENTED;
+    PSYSTEM_CALL_COUNT_INFORMATION Sci = (PSYSTEM_CALL_COUNT_INFORMATION)Buffer;
+    PULONG TableLimit, TableCounts;
+    ULONGLONG Cycles;
+    ULONG i, Id, Limit, TotalServices = 0;
+
+    /*
+     * The header is followed by the limit of every service table and then by
+     * the call counts of all the tables, one after the other.
+     */
+    for (i = 0; i < NUMBER_SERVICE_TABLES; i++)
+    {
+        TotalServices += KeServiceDescriptorTableShadow[i].Limit;
+    }
+
+    *ReqSize = sizeof(SYSTEM_CALL_COUNT_INFORMATION) +
+               (NUMBER_SERVICE_TABLES + TotalServices) * sizeof(ULONG);
+    if (Size < *ReqSize)
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    Sci->Length = *ReqSize;
+    Sci->NumberOfTables = NUMBER_SERVICE_TABLES;
+    TableLimit = (PULONG)(Sci + 1);
+    TableCounts = TableLimit + NUMBER_SERVICE_TABLES;
+
+    for (i = 0; i < NUMBER_SERVICE_TABLES; i++)
+    {
+        Limit = KeServiceDescriptorTableShadow[i].Limit;
+        *TableLimit++ = Limit;
+
+        for (Id = 0; Id < Limit; Id++)
+        {
+            KeQuerySystemCallStatistics(i, Id, TableCounts++, &Cycles);
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+SSI_DEF(SystemCallCountInformation)
+{
+    if (Size != sizeof(ULONG))
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    if (!SeSinglePrivilegeCheck(SeSystemProfilePrivilege, ExGetPreviousMode()))
+    {
+        return STATUS_PRIVILEGE_NOT_HELD;
+    }
+
+    /* Any non-zero value (re)starts counting, zero stops it */
+    return KeEnableSystemCallCounts(*(PULONG)Buffer != 0);
 }
 
 /* Class 7 - Device Information */
@@ -1119,9 +1170,42 @@ SSI_DEF(SystemFlagsInformation)
 /* Class 10 - Call Time Information */
 QSI_DEF(SystemCallTimeInformation)
 {
-    /* FIXME */
-    DPRINT1("NtQuerySystemInformation - SystemCallTimeInformation not implemented\n");
-    return STATUS_NOT_IMPLEMENTED;
+    PSYSTEM_CALL_TIME_INFORMATION Sti = (PSYSTEM_CALL_TIME_INFORMATION)Buffer;
+    ULONG i, Id, Limit, Count, TotalServices = 0;
+    ULONGLONG Cycles;
+    PLARGE_INTEGER Time;
+
+    /*
+     * TimeOfCalls holds the cycles spent in every service, in the same table
+     * order as SystemCallCountInformation; TotalCalls is its element count.
+     */
+    for (i = 0; i < NUMBER_SERVICE_TABLES; i++)
+    {
+        TotalServices += KeServiceDescriptorTableShadow[i].Limit;
+    }
+
+    *ReqSize = FIELD_OFFSET(SYSTEM_CALL_TIME_INFORMATION, TimeOfCalls) +
+               TotalServices * sizeof(LARGE_INTEGER);
+    if (Size < *ReqSize)
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    Sti->Length = *ReqSize;
+    Sti->TotalCalls = TotalServices;
+    Time = Sti->TimeOfCalls;
+
+    for (i = 0; i < NUMBER_SERVICE_TABLES; i++)
+    {
+        Limit = KeServiceDescriptorTableShadow[i].Limit;
+        for (Id = 0; Id < Limit; Id++)
+        {
+            KeQuerySystemCallStatistics(i, Id, &Count, &Cycles);
+            (Time++)->QuadPart = Cycles;
+        }
+    }
+
+    return STATUS_SUCCESS;
 }
 
 /* Class 11 - Module Information */
@@ -1149,9 +1233,60 @@ QSI_DEF(SystemModuleInformation)
 /* Class 12 - Locks Information */
 QSI_DEF(SystemLocksInformation)
 {
-    /* FIXME */
-    DPRINT1("NtQuerySystemInformation - SystemLocksInformation not implemented\n");
-    return STATUS_NOT_IMPLEMENTED;
+    PRTL_PROCESS_LOCKS LockInformation = NULL;
+    ULONG LockLength, ProfileOffset, ProfileLength;
+    NTSTATUS Status, ProfileStatus;
+    PMDL Mdl = NULL;
+
+    /* The snapshot is taken under a spin lock, lock down the buffer */
+    if (Size)
+    {
+        Status = ExLockUserBuffer(Buffer,
+                                  Size,
+                                  ExGetPreviousMode(),
+                                  IoWriteAccess,
+                                  (PVOID*)&LockInformation,
+                                  &Mdl);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to lock the user buffer: 0x%lx\n", Status);
+            return Status;
+        }
+    }
+
+    Status = ExQuerySystemLockInformation(LockInformation, Size, &LockLength);
+    *ReqSize = LockLength;
+
+    /* Append the contention profile when it is being collected */
+    if (ExpLockProfileFlags)
+    {
+        ProfileOffset = ALIGN_UP_BY(LockLength, sizeof(ULONGLONG));
+        ProfileStatus = ExpQueryLockProfile(((Size > ProfileOffset) && LockInformation) ?
+                                            (PVOID)((PUCHAR)LockInformation + ProfileOffset) : NULL,
+                                            (Size > ProfileOffset) ? Size - ProfileOffset : 0,
+                                            &ProfileLength);
+        *ReqSize = ProfileOffset + ProfileLength;
+        if (NT_SUCCESS(Status)) Status = ProfileStatus;
+    }
+
+    if (Mdl) ExUnlockUserBuffer(Mdl);
+    return Status;
+}
+
+SSI_DEF(SystemLocksInformation)
+{
+    if (Size != sizeof(ULONG))
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    if (!SeSinglePrivilegeCheck(SeSystemProfilePrivilege, ExGetPreviousMode()))
+    {
+        return STATUS_PRIVILEGE_NOT_HELD;
+    }
+
+    /* LOCK_PROFILE_* flags of the locks to profile, zero stops profiling */
+    return ExpSetLockProfiling(*(PULONG)Buffer);
 }
 
 /* Class 13 - Stack Trace Information */
@@ -1629,12 +1764,59 @@ QSI_DEF(SystemNextEventIdInformation)
     return STATUS_NOT_IMPLEMENTED;
 }
 
-/* Class 31 */
+/* Class 31 - Performance Trace Information */
 QSI_DEF(SystemPerformanceTraceInformation)
 {
-    /* FIXME */
-    DPRINT1("NtQuerySystemInformation - SystemPerformanceTraceInformation not implemented\n");
-    return STATUS_NOT_IMPLEMENTED;
+    PPERFTRACE_BUFFER_HEADER TraceBuffer;
+    NTSTATUS Status;
+    PMDL Mdl;
+
+    if (!SeSinglePrivilegeCheck(SeSystemProfilePrivilege, ExGetPreviousMode()))
+    {
+        return STATUS_PRIVILEGE_NOT_HELD;
+    }
+
+    if (Size < sizeof(PERFTRACE_BUFFER_HEADER))
+    {
+        *ReqSize = sizeof(PERFTRACE_BUFFER_HEADER);
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    /* The rings are drained under a spin lock, lock down the buffer */
+    Status = ExLockUserBuffer(Buffer,
+                              Size,
+                              ExGetPreviousMode(),
+                              IoWriteAccess,
+                              (PVOID*)&TraceBuffer,
+                              &Mdl);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to lock the user buffer: 0x%lx\n", Status);
+        return Status;
+    }
+
+    Status = PerfInfoQueryTrace(TraceBuffer, Size, ReqSize);
+
+    ExUnlockUserBuffer(Mdl);
+    return Status;
+}
+
+SSI_DEF(SystemPerformanceTraceInformation)
+{
+    PPERFTRACE_CONTROL Control = (PPERFTRACE_CONTROL)Buffer;
+
+    if (Size != sizeof(PERFTRACE_CONTROL))
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    if (!SeSinglePrivilegeCheck(SeSystemProfilePrivilege, ExGetPreviousMode()))
+    {
+        return STATUS_PRIVILEGE_NOT_HELD;
+    }
+
+    /* PERFTRACE_GROUP_* events to trace, zero stops tracing */
+    return PerfInfoStartTrace(Control->Groups, Control->BufferSize);
 }
 
 /* Class 32 - Crash Dump Information */
@@ -2531,13 +2713,13 @@ CallQS [] =
     SI_QX(SystemTimeOfDayInformation),
     SI_QX(SystemPathInformation), /* should be SI_XX */
     SI_QX(SystemProcessInformation),
-    SI_QX(SystemCallCountInformation),
+    SI_QS(SystemCallCountInformation),
     SI_QX(SystemDeviceInformation),
     SI_QX(SystemProcessorPerformanceInformation),
     SI_QS(SystemFlagsInformation),
     SI_QX(SystemCallTimeInformation), /* should be SI_XX */
     SI_QX(SystemModuleInformation),
-    SI_QX(SystemLocksInformation),
+    SI_QS(SystemLocksInformation),
     SI_QX(SystemStackTraceInformation), /* should be SI_XX */
     SI_QX(SystemPagedPoolInformation), /* should be SI_XX */
     SI_QX(SystemNonPagedPoolInformation), /* should be SI_XX */
@@ -2556,7 +2738,7 @@ CallQS [] =
     SI_QS(SystemTimeAdjustmentInformation),
     SI_QX(SystemSummaryMemoryInformation), /* it should be SI_XX */
     SI_QX(SystemNextEventIdInformation), /* it should be SI_XX */
-    SI_QX(SystemPerformanceTraceInformation), /* it should be SI_XX */
+    SI_QS(SystemPerformanceTraceInformation),
     SI_QX(SystemCrashDumpInformation),
     SI_QX(SystemExceptionInformation),
     SI_QX(SystemCrashDumpStateInformation),
@@ -15,43 +15,37 @@
 /* GLOBALS *******************************************************************/
 
 PAGED_LOOKASIDE_LIST FsRtlFileLockLookasideList;
+static NPAGED_LOOKASIDE_LIST FsRtlLockRangeLookasideList;
 
-/* Note: this aligns the two types of lock entry structs so we can access the 
-   FILE_LOCK_INFO part in common.  Add elements after Shared if new stuff is needed.
+/* Note: every granted lock, shared or exclusive, gets its own node in an AVL
+   tree ordered by starting byte.  Each node also remembers the highest ending
+   byte found in its subtree, so that overlap queries can skip any subtree
+   lying entirely before the range they look for.
 */
-typedef union _COMBINED_LOCK_ELEMENT
+typedef struct _LOCK_RANGE
 {
-    struct
-    {
-        LIST_ENTRY dummy;
-        FILE_SHARED_LOCK_ENTRY Shared;
-    };
-    FILE_EXCLUSIVE_LOCK_ENTRY Exclusive;
+    struct _LOCK_RANGE *Left;
+    struct _LOCK_RANGE *Right;
+    ULONGLONG MaxEnd;
+    LONG Height;
+    FILE_LOCK_INFO FileLock;
 }
-    COMBINED_LOCK_ELEMENT, *PCOMBINED_LOCK_ELEMENT;
+    LOCK_RANGE, *PLOCK_RANGE;
 
 typedef struct _LOCK_INFORMATION
 {
-    RTL_GENERIC_TABLE RangeTable;
+    PLOCK_RANGE RangeRoot;
+    ULONG RangeCount;
     IO_CSQ Csq;
     KSPIN_LOCK CsqLock;
     LIST_ENTRY CsqList;
     PFILE_LOCK BelongsTo;
-    LIST_ENTRY SharedLocks;
     ULONG Generation;
 }
     LOCK_INFORMATION, *PLOCK_INFORMATION;
 
-typedef struct _LOCK_SHARED_RANGE
-{
-    LIST_ENTRY Entry;
-    LARGE_INTEGER Start, End;
-    ULONG Key;
-    PVOID ProcessId;
-}
-    LOCK_SHARED_RANGE, *PLOCK_SHARED_RANGE;
+typedef BOOLEAN (*PLOCK_RANGE_FILTER)(PFILE_LOCK_INFO Granted, PFILE_LOCK_INFO Request);
 
-#define TAG_TABLE 'LTAB'
 #define TAG_RANGE 'FSRA'
 #define TAG_FLOCK 'FLCK'
 
@@ -66,57 +60,245 @@ FsRtlCompleteLockIrpReal(IN PCOMPLETE_LOCK_IRP_ROUTINE CompleteRoutine,
                          OUT PNTSTATUS NewStatus,
                          IN PFILE_OBJECT FileObject OPTIONAL);
 
-/* Generic table methods */
+/* Range tree methods */
 
-static PVOID NTAPI LockAllocate(PRTL_GENERIC_TABLE Table, CLONG Bytes)
+static BOOLEAN LockRangesOverlap(PFILE_LOCK_INFO A, PFILE_LOCK_INFO B)
 {
-    PVOID Result;
-    Result = ExAllocatePoolWithTag(NonPagedPool, Bytes, TAG_TABLE);
-    DPRINT("LockAllocate(%lu) => %p\n", Bytes, Result);
-    return Result;
+    ULONGLONG StartA = A->StartingByte.QuadPart, EndA = A->EndingByte.QuadPart;
+    ULONGLONG StartB = B->StartingByte.QuadPart, EndB = B->EndingByte.QuadPart;
+    /* Match if either range starts inside the other one */
+    return (StartA < EndB && StartA >= StartB) ||
+           (StartB < EndA && StartB >= StartA);
 }
 
-static VOID NTAPI LockFree(PRTL_GENERIC_TABLE Table, PVOID Buffer)
+static BOOLEAN LockOwnedBy(PFILE_LOCK_INFO Granted, PFILE_LOCK_INFO Request)
 {
-    DPRINT("LockFree(%p)\n", Buffer);
-    ExFreePoolWithTag(Buffer, TAG_TABLE);
+    return Granted->Key == Request->Key &&
+           Granted->ProcessId == Request->ProcessId;
 }
 
-static RTL_GENERIC_COMPARE_RESULTS NTAPI LockCompare
-(PRTL_GENERIC_TABLE Table, PVOID PtrA, PVOID PtrB)
+/* A new lock conflicts with anything exclusive, or with anything if it is
+   itself exclusive */
+static BOOLEAN LockBlocksLock(PFILE_LOCK_INFO Granted, PFILE_LOCK_INFO Request)
 {
-    PCOMBINED_LOCK_ELEMENT A = PtrA, B = PtrB;
-    RTL_GENERIC_COMPARE_RESULTS Result;
-#if 0
-    DPRINT("Starting to compare element %x to element %x\n", PtrA, PtrB);
-#endif
-    /* Match if we overlap */
-    if (((A->Exclusive.FileLock.StartingByte.QuadPart <
-          B->Exclusive.FileLock.EndingByte.QuadPart) &&
-         (A->Exclusive.FileLock.StartingByte.QuadPart >=
-          B->Exclusive.FileLock.StartingByte.QuadPart)) ||
-        ((B->Exclusive.FileLock.StartingByte.QuadPart <
-          A->Exclusive.FileLock.EndingByte.QuadPart) &&
-         (B->Exclusive.FileLock.StartingByte.QuadPart >=
-          A->Exclusive.FileLock.StartingByte.QuadPart)))
-        return GenericEqual;
-    /* Otherwise, key on the starting byte */
-    Result =
-        (A->Exclusive.FileLock.StartingByte.QuadPart < 
-         B->Exclusive.FileLock.StartingByte.QuadPart) ? GenericLessThan :
-        (A->Exclusive.FileLock.StartingByte.QuadPart > 
-         B->Exclusive.FileLock.StartingByte.QuadPart) ? GenericGreaterThan :
-        GenericEqual;
-#if 0
-    DPRINT("Compare(%x:%x) %x-%x to %x-%x => %d\n",
-           A,B,
-           A->Exclusive.FileLock.StartingByte.LowPart, 
-           A->Exclusive.FileLock.EndingByte.LowPart,
-           B->Exclusive.FileLock.StartingByte.LowPart, 
-           B->Exclusive.FileLock.EndingByte.LowPart,
-           Result);
-#endif
-    return Result;
+    return Granted->ExclusiveLock || Request->ExclusiveLock;
+}
+
+/* Reads are only denied by somebody else's exclusive lock */
+static BOOLEAN LockBlocksRead(PFILE_LOCK_INFO Granted, PFILE_LOCK_INFO Request)
+{
+    return Granted->ExclusiveLock && !LockOwnedBy(Granted, Request);
+}
+
+/* Writes are denied by any shared lock, and by somebody else's exclusive lock */
+static BOOLEAN LockBlocksWrite(PFILE_LOCK_INFO Granted, PFILE_LOCK_INFO Request)
+{
+    return !Granted->ExclusiveLock || !LockOwnedBy(Granted, Request);
+}
+
+/* Order by starting byte, then ending byte, then node address, so that
+   identical ranges held by several owners still sort deterministically */
+static LONG LockRangeCompare(PFILE_LOCK_INFO A, PVOID RangeA,
+                             PFILE_LOCK_INFO B, PVOID RangeB)
+{
+    if ((ULONGLONG)A->StartingByte.QuadPart != (ULONGLONG)B->StartingByte.QuadPart)
+        return (ULONGLONG)A->StartingByte.QuadPart < (ULONGLONG)B->StartingByte.QuadPart ? -1 : 1;
+    if ((ULONGLONG)A->EndingByte.QuadPart != (ULONGLONG)B->EndingByte.QuadPart)
+        return (ULONGLONG)A->EndingByte.QuadPart < (ULONGLONG)B->EndingByte.QuadPart ? -1 : 1;
+    if (RangeA != RangeB)
+        return (ULONG_PTR)RangeA < (ULONG_PTR)RangeB ? -1 : 1;
+    return 0;
+}
+
+static LONG LockRangeHeight(PLOCK_RANGE Range)
+{
+    return Range ? Range->Height : 0;
+}
+
+static VOID LockRangeUpdate(PLOCK_RANGE Range)
+{
+    LONG LeftHeight = LockRangeHeight(Range->Left);
+    LONG RightHeight = LockRangeHeight(Range->Right);
+    Range->Height = 1 + max(LeftHeight, RightHeight);
+    Range->MaxEnd = Range->FileLock.EndingByte.QuadPart;
+    if (Range->Left && Range->Left->MaxEnd > Range->MaxEnd)
+        Range->MaxEnd = Range->Left->MaxEnd;
+    if (Range->Right && Range->Right->MaxEnd > Range->MaxEnd)
+        Range->MaxEnd = Range->Right->MaxEnd;
+}
+
+static PLOCK_RANGE LockRangeRotateRight(PLOCK_RANGE Range)
+{
+    PLOCK_RANGE Pivot = Range->Left;
+    Range->Left = Pivot->Right;
+    Pivot->Right = Range;
+    LockRangeUpdate(Range);
+    LockRangeUpdate(Pivot);
+    return Pivot;
+}
+
+static PLOCK_RANGE LockRangeRotateLeft(PLOCK_RANGE Range)
+{
+    PLOCK_RANGE Pivot = Range->Right;
+    Range->Right = Pivot->Left;
+    Pivot->Left = Range;
+    LockRangeUpdate(Range);
+    LockRangeUpdate(Pivot);
+    return Pivot;
+}
+
+static PLOCK_RANGE LockRangeBalance(PLOCK_RANGE Range)
+{
+    LONG Balance;
+    LockRangeUpdate(Range);
+    Balance = LockRangeHeight(Range->Left) - LockRangeHeight(Range->Right);
+    if (Balance > 1)
+    {
+        if (LockRangeHeight(Range->Left->Left) < LockRangeHeight(Range->Left->Right))
+            Range->Left = LockRangeRotateLeft(Range->Left);
+        return LockRangeRotateRight(Range);
+    }
+    if (Balance < -1)
+    {
+        if (LockRangeHeight(Range->Right->Right) < LockRangeHeight(Range->Right->Left))
+            Range->Right = LockRangeRotateRight(Range->Right);
+        return LockRangeRotateLeft(Range);
+    }
+    return Range;
+}
+
+/* The tree is height balanced, so recursion depth stays logarithmic */
+static PLOCK_RANGE LockRangeInsert(PLOCK_RANGE Root, PLOCK_RANGE New)
+{
+    if (!Root) return New;
+    if (LockRangeCompare(&New->FileLock, New, &Root->FileLock, Root) < 0)
+        Root->Left = LockRangeInsert(Root->Left, New);
+    else
+        Root->Right = LockRangeInsert(Root->Right, New);
+    return LockRangeBalance(Root);
+}
+
+static PLOCK_RANGE LockRangeRemoveMin(PLOCK_RANGE Root, PLOCK_RANGE *Min)
+{
+    if (!Root->Left)
+    {
+        *Min = Root;
+        return Root->Right;
+    }
+    Root->Left = LockRangeRemoveMin(Root->Left, Min);
+    return LockRangeBalance(Root);
+}
+
+static PLOCK_RANGE LockRangeDelete(PLOCK_RANGE Root, PLOCK_RANGE Range)
+{
+    LONG Result;
+    PLOCK_RANGE Min, Right;
+    ASSERT(Root);
+    Result = LockRangeCompare(&Range->FileLock, Range, &Root->FileLock, Root);
+    if (Result < 0)
+        Root->Left = LockRangeDelete(Root->Left, Range);
+    else if (Result > 0)
+        Root->Right = LockRangeDelete(Root->Right, Range);
+    else
+    {
+        if (!Root->Left) return Root->Right;
+        if (!Root->Right) return Root->Left;
+        Right = LockRangeRemoveMin(Root->Right, &Min);
+        Min->Left = Root->Left;
+        Min->Right = Right;
+        return LockRangeBalance(Min);
+    }
+    return LockRangeBalance(Root);
+}
+
+/* Returns the lowest granted lock overlapping Request for which Filter
+   holds.  Subtrees whose ranges all end before Request starts, and nodes
+   starting after Request ends, are never visited. */
+static PLOCK_RANGE LockRangeFindOverlap
+(PLOCK_RANGE Root,
+ PFILE_LOCK_INFO Request,
+ PLOCK_RANGE_FILTER Filter)
+{
+    ULONGLONG Start = Request->StartingByte.QuadPart;
+    ULONGLONG End = Request->EndingByte.QuadPart;
+    PLOCK_RANGE Found;
+    while (Root && Root->MaxEnd >= Start)
+    {
+        Found = LockRangeFindOverlap(Root->Left, Request, Filter);
+        if (Found) return Found;
+        if ((ULONGLONG)Root->FileLock.StartingByte.QuadPart > Start &&
+            (ULONGLONG)Root->FileLock.StartingByte.QuadPart >= End)
+            return NULL;
+        if (LockRangesOverlap(&Root->FileLock, Request) &&
+            Filter(&Root->FileLock, Request))
+            return Root;
+        Root = Root->Right;
+    }
+    return NULL;
+}
+
+/* Returns a granted lock covering exactly Start..End for the given owner */
+static PLOCK_RANGE LockRangeFindExact
+(PLOCK_RANGE Root,
+ ULONGLONG Start,
+ ULONGLONG End,
+ ULONG Key,
+ PVOID ProcessId)
+{
+    PLOCK_RANGE Found;
+    while (Root)
+    {
+        ULONGLONG RootStart = Root->FileLock.StartingByte.QuadPart;
+        ULONGLONG RootEnd = Root->FileLock.EndingByte.QuadPart;
+        if (Start < RootStart || (Start == RootStart && End < RootEnd))
+            Root = Root->Left;
+        else if (Start > RootStart || End > RootEnd)
+            Root = Root->Right;
+        else
+        {
+            if (Root->FileLock.Key == Key && Root->FileLock.ProcessId == ProcessId)
+                return Root;
+            /* Same range held by somebody else, ours may be on either side */
+            Found = LockRangeFindExact(Root->Left, Start, End, Key, ProcessId);
+            if (Found) return Found;
+            Root = Root->Right;
+        }
+    }
+    return NULL;
+}
+
+/* Returns the first granted lock sorting after Previous, or the first one
+   overall if Previous is NULL */
+static PLOCK_RANGE LockRangeNext
+(PLOCK_RANGE Root,
+ PFILE_LOCK_INFO Previous,
+ PVOID PreviousRange)
+{
+    PLOCK_RANGE Next = NULL;
+    while (Root)
+    {
+        if (!Previous ||
+            LockRangeCompare(&Root->FileLock, Root, Previous, PreviousRange) > 0)
+        {
+            Next = Root;
+            Root = Root->Left;
+        }
+        else
+            Root = Root->Right;
+    }
+    return Next;
+}
+
+static VOID LockRangeFreeAll(PLOCK_RANGE Root)
+{
+    PLOCK_RANGE Right;
+    while (Root)
+    {
+        LockRangeFreeAll(Root->Left);
+        Right = Root->Right;
+        ExFreeToNPagedLookasideList(&FsRtlLockRangeLookasideList, Root);
+        Root = Right;
+    }
 }
 
 /* CSQ methods */
@@ -138,11 +320,11 @@ static VOID NTAPI LockRemoveIrp(PIO_CSQ Csq, PIRP Irp)
 
 static PIRP NTAPI LockPeekNextIrp(PIO_CSQ Csq, PIRP Irp, PVOID PeekContext)
 {
-    // Context will be a COMBINED_LOCK_ELEMENT.  We're looking for a 
+    // Context will be a FILE_LOCK_INFO.  We're looking for a
     // lock that can be acquired, now that the lock matching PeekContext
     // has been removed.
-    COMBINED_LOCK_ELEMENT LockElement;
-    PCOMBINED_LOCK_ELEMENT WhereUnlock = PeekContext;
+    FILE_LOCK_INFO LockElement;
+    PFILE_LOCK_INFO WhereUnlock = PeekContext;
     PLOCK_INFORMATION LockInfo = CONTAINING_RECORD(Csq, LOCK_INFORMATION, Csq);
     PLIST_ENTRY Following;
     DPRINT("PeekNextIrp(IRP %p, Context %p)\n", Irp, PeekContext);
@@ -152,7 +334,7 @@ static PIRP NTAPI LockPeekNextIrp(PIO_CSQ Csq, PIRP Irp, PVOID PeekContext)
     }
     else
         Following = Irp->Tail.Overlay.ListEntry.Flink;
-    
+
     DPRINT("ListEntry %p Head %p\n", Following, &LockInfo->CsqList);
     for (;
          Following != &LockInfo->CsqList;
@@ -163,16 +345,15 @@ static PIRP NTAPI LockPeekNextIrp(PIO_CSQ Csq, PIRP Irp, PVOID PeekContext)
         Irp = CONTAINING_RECORD(Following, IRP, Tail.Overlay.ListEntry);
         DPRINT("Irp %p\n", Irp);
         IoStack = IoGetCurrentIrpStackLocation(Irp);
-        LockElement.Exclusive.FileLock.StartingByte = 
+        LockElement.StartingByte =
             IoStack->Parameters.LockControl.ByteOffset;
-        LockElement.Exclusive.FileLock.EndingByte.QuadPart = 
-            LockElement.Exclusive.FileLock.StartingByte.QuadPart + 
+        LockElement.EndingByte.QuadPart =
+            LockElement.StartingByte.QuadPart +
             IoStack->Parameters.LockControl.Length->QuadPart;
         /* If a context was specified, it's a range to check to unlock */
         if (WhereUnlock)
         {
-            Matching = LockCompare
-                (&LockInfo->RangeTable, &LockElement, WhereUnlock) != GenericEqual;
+            Matching = !LockRangesOverlap(&LockElement, WhereUnlock);
         }
         /* Else get any completable IRP */
         else
@@ -249,75 +430,93 @@ FsRtlCompleteLockIrpReal(IN PCOMPLETE_LOCK_IRP_ROUTINE CompleteRoutine,
     }
 }
 
+/* Removes one granted lock and retries the pending lock IRPs it may have
+   been holding up */
+static VOID
+FsRtlpUnlockRange(IN PFILE_LOCK FileLock,
+                  IN PLOCK_INFORMATION InternalInfo,
+                  IN PLOCK_RANGE Range)
+{
+    FILE_LOCK_INFO Find;
+    PIRP NextMatchingLockIrp;
+
+    DPRINT("Removing lock entry: Exclusive %u %08x%08x:%08x%08x\n",
+           Range->FileLock.ExclusiveLock,
+           Range->FileLock.StartingByte.HighPart,
+           Range->FileLock.StartingByte.LowPart,
+           Range->FileLock.EndingByte.HighPart,
+           Range->FileLock.EndingByte.LowPart);
+
+    /* Remember what was in there and remove it from the tree */
+    Find = Range->FileLock;
+    InternalInfo->RangeRoot = LockRangeDelete(InternalInfo->RangeRoot, Range);
+    InternalInfo->RangeCount--;
+    ExFreeToNPagedLookasideList(&FsRtlLockRangeLookasideList, Range);
+    if (!InternalInfo->RangeRoot) FileLock->FastIoIsQuestionable = FALSE;
+
+    // this is definitely the thing we want
+    InternalInfo->Generation++;
+    while ((NextMatchingLockIrp = IoCsqRemoveNextIrp(&InternalInfo->Csq, &Find)))
+    {
+        if (NextMatchingLockIrp->IoStatus.Information == InternalInfo->Generation)
+        {
+            // We've already looked at this one, meaning that we looped.
+            // Put it back and exit.
+            IoCsqInsertIrpEx
+                (&InternalInfo->Csq,
+                 NextMatchingLockIrp,
+                 NULL,
+                 NULL);
+            break;
+        }
+        // Got a new lock irp... try to do the new lock operation
+        // Note that we pick an operation that would succeed at the time
+        // we looked, but can't guarantee that it won't just be re-queued
+        // because somebody else snatched part of the range in a new thread.
+        DPRINT("Locking another IRP %p for %p\n",
+               NextMatchingLockIrp, FileLock);
+        FsRtlProcessFileLock(InternalInfo->BelongsTo, NextMatchingLockIrp, NULL);
+    }
+}
+
 /* PUBLIC FUNCTIONS **********************************************************/
 
 /*
  * @implemented
  */
-PFILE_LOCK_INFO
-NTAPI
-FsRtlGetNextFileLock(IN PFILE_LOCK FileLock,
-                     IN BOOLEAN Restart)
-{
-    PCOMBINED_LOCK_ELEMENT Entry;
-    if (!FileLock->LockInformation) return NULL;
-    Entry = RtlEnumerateGenericTable(FileLock->LockInformation, Restart);
-    if (!Entry) return NULL;
-    else return &Entry->Exclusive.FileLock;
-}
-
+INIT_FUNCTION
 VOID
 NTAPI
-FsRtlpExpandLockElement
-(PCOMBINED_LOCK_ELEMENT ToExpand,
- PCOMBINED_LOCK_ELEMENT Conflict)
+FsRtlInitializeFileLocks(VOID)
 {
-    if (ToExpand->Exclusive.FileLock.StartingByte.QuadPart >
-        Conflict->Exclusive.FileLock.StartingByte.QuadPart)
-    {
-        ToExpand->Exclusive.FileLock.StartingByte = 
-            Conflict->Exclusive.FileLock.StartingByte;
-    }
-    if (ToExpand->Exclusive.FileLock.EndingByte.QuadPart <
-        Conflict->Exclusive.FileLock.EndingByte.QuadPart)
-    {
-        ToExpand->Exclusive.FileLock.EndingByte =
-            Conflict->Exclusive.FileLock.EndingByte;
-    }
+    /* Initialize the list for granted lock ranges */
+    ExInitializeNPagedLookasideList(&FsRtlLockRangeLookasideList,
+                                    NULL,
+                                    NULL,
+                                    0,
+                                    sizeof(LOCK_RANGE),
+                                    TAG_RANGE,
+                                    0);
 }
 
-/* This function expands the conflicting range Conflict by removing and reinserting it,
-   then adds a shared range of the same size */
-PCOMBINED_LOCK_ELEMENT
+/*
+ * @implemented
+ */
+PFILE_LOCK_INFO
 NTAPI
-FsRtlpRebuildSharedLockRange
-(PFILE_LOCK FileLock,
- PLOCK_INFORMATION LockInfo,
- PCOMBINED_LOCK_ELEMENT Conflict)
+FsRtlGetNextFileLock(IN PFILE_LOCK FileLock,
+                     IN BOOLEAN Restart)
 {
-    /* Starting at Conflict->StartingByte and going to Conflict->EndingByte
-     * capture and expand a shared range from the shared range list.
-     * Finish when we've incorporated all overlapping shared regions.
-     */
-    BOOLEAN InsertedNew = FALSE, RemovedOld;
-    COMBINED_LOCK_ELEMENT NewElement = *Conflict;
-    PCOMBINED_LOCK_ELEMENT Entry;
-    while ((Entry = RtlLookupElementGenericTable
-            (FileLock->LockInformation, &NewElement)))
-    {
-        FsRtlpExpandLockElement(&NewElement, Entry);
-        RemovedOld = RtlDeleteElementGenericTable
-            (&LockInfo->RangeTable,
-             Entry);
-        ASSERT(RemovedOld);
-    }
-    Conflict = RtlInsertElementGenericTable
-        (&LockInfo->RangeTable,
-         &NewElement,
-         sizeof(NewElement),
-         &InsertedNew);
-    ASSERT(InsertedNew);
-    return Conflict;
+    PLOCK_RANGE Range;
+    PLOCK_INFORMATION LockInfo = FileLock->LockInformation;
+    if (!LockInfo) return NULL;
+    Range = LockRangeNext(LockInfo->RangeRoot,
+                          Restart ? NULL : &FileLock->LastReturnedLockInfo,
+                          FileLock->LastReturnedLock);
+    if (!Range) return NULL;
+    FileLock->LastReturnedLockInfo = Range->FileLock;
+    FileLock->LastReturnedLock = Range;
+    return &Range->FileLock;
 }
 
 /*
@@ -339,26 +538,25 @@ FsRtlPrivateLock(IN PFILE_LOCK FileLock,
                  IN BOOLEAN AlreadySynchronized)
 {
     NTSTATUS Status;
-    COMBINED_LOCK_ELEMENT ToInsert;
-    PCOMBINED_LOCK_ELEMENT Conflict;
+    FILE_LOCK_INFO ToInsert;
+    PLOCK_RANGE Conflict;
+    PLOCK_RANGE NewRange;
     PLOCK_INFORMATION LockInfo;
-    PLOCK_SHARED_RANGE NewSharedRange;
-    BOOLEAN InsertedNew;
     ULARGE_INTEGER UnsignedStart;
     ULARGE_INTEGER UnsignedEnd;
-    
-    DPRINT("FsRtlPrivateLock(%wZ, Offset %08x%08x (%d), Length %08x%08x (%d), Key %x, FailImmediately %u, Exclusive %u)\n", 
-           &FileObject->FileName, 
+
+    DPRINT("FsRtlPrivateLock(%wZ, Offset %08x%08x (%d), Length %08x%08x (%d), Key %x, FailImmediately %u, Exclusive %u)\n",
+           &FileObject->FileName,
            FileOffset->HighPart,
-           FileOffset->LowPart, 
+           FileOffset->LowPart,
            (int)FileOffset->QuadPart,
            Length->HighPart,
-           Length->LowPart, 
+           Length->LowPart,
            (int)Length->QuadPart,
            Key,
-           FailImmediately, 
+           FailImmediately,
            ExclusiveLock);
-    
+
     UnsignedStart.QuadPart = FileOffset->QuadPart;
     UnsignedEnd.QuadPart = FileOffset->QuadPart + Length->QuadPart;
 
@@ -379,7 +577,7 @@ FsRtlPrivateLock(IN PFILE_LOCK FileLock,
         }
         return FALSE;
     }
-    
+
     /* Initialize the lock, if necessary */
     if (!FileLock->LockInformation)
     {
@@ -392,20 +590,15 @@ FsRtlPrivateLock(IN PFILE_LOCK FileLock,
         FileLock->LockInformation = LockInfo;
 
         LockInfo->BelongsTo = FileLock;
-        InitializeListHead(&LockInfo->SharedLocks);
-        
-        RtlInitializeGenericTable
-            (&LockInfo->RangeTable,
-             LockCompare,
-             LockAllocate,
-             LockFree,
-             NULL);
-        
+        LockInfo->RangeRoot = NULL;
+        LockInfo->RangeCount = 0;
+        LockInfo->Generation = 0;
+
         KeInitializeSpinLock(&LockInfo->CsqLock);
         InitializeListHead(&LockInfo->CsqList);
-        
+
         IoCsqInitializeEx
-            (&LockInfo->Csq, 
+            (&LockInfo->Csq,
              LockInsertIrpEx,
              LockRemoveIrp,
              LockPeekNextIrp,
@@ -413,176 +606,32 @@ FsRtlPrivateLock(IN PFILE_LOCK FileLock,
              LockReleaseQueueLock,
              LockCompleteCanceledIrp);
     }
-    
+
     LockInfo = FileLock->LockInformation;
-    ToInsert.Exclusive.FileLock.FileObject = FileObject;
-    ToInsert.Exclusive.FileLock.StartingByte = *FileOffset;
-    ToInsert.Exclusive.FileLock.EndingByte.QuadPart = FileOffset->QuadPart + Length->QuadPart;
-    ToInsert.Exclusive.FileLock.ProcessId = Process;
-    ToInsert.Exclusive.FileLock.Key = Key;
-    ToInsert.Exclusive.FileLock.ExclusiveLock = ExclusiveLock;
-
-    Conflict = RtlInsertElementGenericTable
-        (FileLock->LockInformation,
-         &ToInsert,
-         sizeof(ToInsert),
-         &InsertedNew);
-
-    if (Conflict && !InsertedNew)
+    ToInsert.FileObject = FileObject;
+    ToInsert.StartingByte = *FileOffset;
+    ToInsert.EndingByte.QuadPart = FileOffset->QuadPart + Length->QuadPart;
+    ToInsert.ProcessId = Process;
+    ToInsert.Key = Key;
+    ToInsert.ExclusiveLock = ExclusiveLock;
+
+    Conflict = LockRangeFindOverlap(LockInfo->RangeRoot, &ToInsert, LockBlocksLock);
+    if (Conflict)
     {
-        if (Conflict->Exclusive.FileLock.ExclusiveLock || ExclusiveLock)
-        {
-            DPRINT("Conflict %08x%08x:%08x%08x Exc %u (Want Exc %u)\n",
-                   Conflict->Exclusive.FileLock.StartingByte.HighPart,
-                   Conflict->Exclusive.FileLock.StartingByte.LowPart,
-                   Conflict->Exclusive.FileLock.EndingByte.HighPart,
-                   Conflict->Exclusive.FileLock.EndingByte.LowPart,
-                   Conflict->Exclusive.FileLock.ExclusiveLock,
-                   ExclusiveLock);
-            if (FailImmediately)
-            {
-                DPRINT("STATUS_FILE_LOCK_CONFLICT\n");
-                IoStatus->Status = STATUS_FILE_LOCK_CONFLICT;
-                if (Irp)
-                {
-                    DPRINT("STATUS_FILE_LOCK_CONFLICT: Complete\n");
-                    FsRtlCompleteLockIrpReal
-                        (FileLock->CompleteLockIrpRoutine,
-                         Context,
-                         Irp,
-                         IoStatus->Status,
-                         &Status,
-                         FileObject);
-                }
-                return FALSE;
-            }
-            else
-            {
-                IoStatus->Status = STATUS_PENDING;
-                if (Irp)
-                {
-                    Irp->IoStatus.Information = LockInfo->Generation;
-                    IoMarkIrpPending(Irp);
-                    IoCsqInsertIrpEx
-                        (&LockInfo->Csq,
-                         Irp,
-                         NULL,
-                         NULL);
-                }
-            }
-            return FALSE;
-        }
-        else
+        DPRINT("Conflict %08x%08x:%08x%08x Exc %u (Want Exc %u)\n",
+               Conflict->FileLock.StartingByte.HighPart,
+               Conflict->FileLock.StartingByte.LowPart,
+               Conflict->FileLock.EndingByte.HighPart,
+               Conflict->FileLock.EndingByte.LowPart,
+               Conflict->FileLock.ExclusiveLock,
+               ExclusiveLock);
+        if (FailImmediately)
         {
-            ULONG i;
-            /* We know of at least one lock in range that's shared.  We need to
-             * find out if any more exist and any are exclusive. */
-            for (i = 0; i < RtlNumberGenericTableElements(&LockInfo->RangeTable); i++)
-            {
-                Conflict = RtlGetElementGenericTable(&LockInfo->RangeTable, i);
-
-                /* The first argument will be inserted as a shared range */
-                if (Conflict && (LockCompare(&LockInfo->RangeTable, Conflict, &ToInsert) == GenericEqual))
-                {
-                    if (Conflict->Exclusive.FileLock.ExclusiveLock)
-                    {
-                        /* Found an exclusive match */
-                        if (FailImmediately)
-                        {
-                            IoStatus->Status = STATUS_FILE_LOCK_CONFLICT;
-                            DPRINT("STATUS_FILE_LOCK_CONFLICT\n");
-                            if (Irp)
-                            {
-                                DPRINT("STATUS_FILE_LOCK_CONFLICT: Complete\n");
-                                FsRtlCompleteLockIrpReal
-                                    (FileLock->CompleteLockIrpRoutine,
-                                     Context,
-                                     Irp,
-                                     IoStatus->Status,
-                                     &Status,
-                                     FileObject);
-                            }
-                        }
-                        else
-                        {
-                            IoStatus->Status = STATUS_PENDING;
-                            if (Irp)
-                            {
-                                IoMarkIrpPending(Irp);
-                                IoCsqInsertIrpEx
-                                    (&LockInfo->Csq,
-                                     Irp,
-                                     NULL,
-                                     NULL);
-                            }
-                        }
-                        return FALSE;
-                    }
-                }
-            }
-            
-            DPRINT("Overlapping shared lock %wZ %08x%08x %08x%08x\n",
-                   &FileObject->FileName,
-                   Conflict->Exclusive.FileLock.StartingByte.HighPart,
-                   Conflict->Exclusive.FileLock.StartingByte.LowPart,
-                   Conflict->Exclusive.FileLock.EndingByte.HighPart,
-                   Conflict->Exclusive.FileLock.EndingByte.LowPart);
-            Conflict = FsRtlpRebuildSharedLockRange(FileLock,
-                                                    LockInfo,
-                                                    &ToInsert);
-            if (!Conflict)
-            {
-                IoStatus->Status = STATUS_NO_MEMORY;
-                if (Irp)
-                {
-                    FsRtlCompleteLockIrpReal
-                        (FileLock->CompleteLockIrpRoutine,
-                         Context,
-                         Irp,
-                         IoStatus->Status,
-                         &Status,
-                         FileObject);
-                }
-            }
-
-            /* We got here because there were only overlapping shared locks */
-            /* A shared lock is both a range *and* a list entry.  Insert the
-               entry here. */
-            
-            DPRINT("Adding shared lock %wZ\n", &FileObject->FileName);
-            NewSharedRange = 
-                ExAllocatePoolWithTag(NonPagedPool, sizeof(*NewSharedRange), TAG_RANGE);
-            if (!NewSharedRange)
-            {
-                IoStatus->Status = STATUS_NO_MEMORY;
-                if (Irp)
-                {
-                    FsRtlCompleteLockIrpReal
-                        (FileLock->CompleteLockIrpRoutine,
-                         Context,
-                         Irp,
-                         IoStatus->Status,
-                         &Status,
-                         FileObject);
-                }
-                return FALSE;
-            }
-            DPRINT("Adding shared lock %wZ\n", &FileObject->FileName);
-            NewSharedRange->Start = *FileOffset;
-            NewSharedRange->End.QuadPart = FileOffset->QuadPart + Length->QuadPart;
-            NewSharedRange->Key = Key;
-            NewSharedRange->ProcessId = ToInsert.Exclusive.FileLock.ProcessId;
-            InsertTailList(&LockInfo->SharedLocks, &NewSharedRange->Entry);
-
-            DPRINT("Acquired shared lock %wZ %08x%08x %08x%08x\n",
-                   &FileObject->FileName,
-                   Conflict->Exclusive.FileLock.StartingByte.HighPart,
-                   Conflict->Exclusive.FileLock.StartingByte.LowPart,
-                   Conflict->Exclusive.FileLock.EndingByte.HighPart,
-                   Conflict->Exclusive.FileLock.EndingByte.LowPart);
-            IoStatus->Status = STATUS_SUCCESS;
+            DPRINT("STATUS_FILE_LOCK_CONFLICT\n");
+            IoStatus->Status = STATUS_FILE_LOCK_CONFLICT;
             if (Irp)
             {
+                DPRINT("STATUS_FILE_LOCK_CONFLICT: Complete\n");
                 FsRtlCompleteLockIrpReal
                     (FileLock->CompleteLockIrpRoutine,
                      Context,
@@ -591,13 +640,27 @@ FsRtlPrivateLock(IN PFILE_LOCK FileLock,
                      &Status,
                      FileObject);
             }
-            return TRUE;
         }
+        else
+        {
+            IoStatus->Status = STATUS_PENDING;
+            if (Irp)
+            {
+                Irp->IoStatus.Information = LockInfo->Generation;
+                IoMarkIrpPending(Irp);
+                IoCsqInsertIrpEx
+                    (&LockInfo->Csq,
+                     Irp,
+                     NULL,
+                     NULL);
+            }
+        }
+        return FALSE;
     }
-    else if (!Conflict)
+
+    NewRange = ExAllocateFromNPagedLookasideList(&FsRtlLockRangeLookasideList);
+    if (!NewRange)
     {
-        /* Conflict here is (or would be) the newly inserted element, but we ran
-         * out of space probably. */
         IoStatus->Status = STATUS_NO_MEMORY;
         if (Irp)
         {
@@ -611,60 +674,41 @@ FsRtlPrivateLock(IN PFILE_LOCK FileLock,
         }
         return FALSE;
     }
-    else
+
+    NewRange->Left = NULL;
+    NewRange->Right = NULL;
+    NewRange->Height = 1;
+    NewRange->MaxEnd = UnsignedEnd.QuadPart;
+    NewRange->FileLock = ToInsert;
+    LockInfo->RangeRoot = LockRangeInsert(LockInfo->RangeRoot, NewRange);
+    LockInfo->RangeCount++;
+    FileLock->FastIoIsQuestionable = TRUE;
+
+    DPRINT("Inserted new lock %wZ %08x%08x %08x%08x exclusive %u\n",
+           &FileObject->FileName,
+           NewRange->FileLock.StartingByte.HighPart,
+           NewRange->FileLock.StartingByte.LowPart,
+           NewRange->FileLock.EndingByte.HighPart,
+           NewRange->FileLock.EndingByte.LowPart,
+           NewRange->FileLock.ExclusiveLock);
+
+    /* Assume all is cool, and lock is set */
+    IoStatus->Status = STATUS_SUCCESS;
+
+    if (Irp)
     {
-        DPRINT("Inserted new lock %wZ %08x%08x %08x%08x exclusive %u\n",
-               &FileObject->FileName,
-               Conflict->Exclusive.FileLock.StartingByte.HighPart,
-               Conflict->Exclusive.FileLock.StartingByte.LowPart,
-               Conflict->Exclusive.FileLock.EndingByte.HighPart,
-               Conflict->Exclusive.FileLock.EndingByte.LowPart,
-               Conflict->Exclusive.FileLock.ExclusiveLock);
-        if (!ExclusiveLock)
-        {
-            NewSharedRange = 
-                ExAllocatePoolWithTag(NonPagedPool, sizeof(*NewSharedRange), TAG_RANGE);
-            if (!NewSharedRange)
-            {
-                IoStatus->Status = STATUS_NO_MEMORY;
-                if (Irp)
-                {
-                    FsRtlCompleteLockIrpReal
-                        (FileLock->CompleteLockIrpRoutine,
-                         Context,
-                         Irp,
-                         IoStatus->Status,
-                         &Status,
-                         FileObject);
-                }
-                return FALSE;
-            }
-            DPRINT("Adding shared lock %wZ\n", &FileObject->FileName);
-            NewSharedRange->Start = *FileOffset;
-            NewSharedRange->End.QuadPart = FileOffset->QuadPart + Length->QuadPart;
-            NewSharedRange->Key = Key;
-            NewSharedRange->ProcessId = Process;
-            InsertTailList(&LockInfo->SharedLocks, &NewSharedRange->Entry);
-        }
-        
-        /* Assume all is cool, and lock is set */
-        IoStatus->Status = STATUS_SUCCESS;
-        
-        if (Irp)
-        {
-            /* Complete the request */
-            FsRtlCompleteLockIrpReal(FileLock->CompleteLockIrpRoutine,
-                                     Context,
-                                     Irp,
-                                     IoStatus->Status,
-                                     &Status,
-                                     FileObject);
-            
-            /* Update the status */
-            IoStatus->Status = Status;
-        }
+        /* Complete the request */
+        FsRtlCompleteLockIrpReal(FileLock->CompleteLockIrpRoutine,
+                                 Context,
+                                 Irp,
+                                 IoStatus->Status,
+                                 &Status,
+                                 FileObject);
+
+        /* Update the status */
+        IoStatus->Status = Status;
     }
-    
+
     return TRUE;
 }
 
@@ -677,31 +721,20 @@ FsRtlCheckLockForReadAccess(IN PFILE_LOCK FileLock,
                             IN PIRP Irp)
 {
     BOOLEAN Result;
+    LARGE_INTEGER Length;
     PIO_STACK_LOCATION IoStack = IoGetCurrentIrpStackLocation(Irp);
-    COMBINED_LOCK_ELEMENT ToFind;
-    PCOMBINED_LOCK_ELEMENT Found;
-    DPRINT("CheckLockForReadAccess(%wZ, Offset %08x%08x, Length %x)\n", 
+    DPRINT("CheckLockForReadAccess(%wZ, Offset %08x%08x, Length %x)\n",
            &IoStack->FileObject->FileName,
            IoStack->Parameters.Read.ByteOffset.HighPart,
            IoStack->Parameters.Read.ByteOffset.LowPart,
            IoStack->Parameters.Read.Length);
-    if (!FileLock->LockInformation) {
-        DPRINT("CheckLockForReadAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
-        return TRUE;
-    }
-    ToFind.Exclusive.FileLock.StartingByte = IoStack->Parameters.Read.ByteOffset;
-    ToFind.Exclusive.FileLock.EndingByte.QuadPart = 
-        ToFind.Exclusive.FileLock.StartingByte.QuadPart + 
-        IoStack->Parameters.Read.Length;
-    Found = RtlLookupElementGenericTable
-        (FileLock->LockInformation,
-         &ToFind);
-    if (!Found) {
-        DPRINT("CheckLockForReadAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
-        return TRUE;
-    }
-    Result = !Found->Exclusive.FileLock.ExclusiveLock || 
-        IoStack->Parameters.Read.Key == Found->Exclusive.FileLock.Key;
+    Length.QuadPart = IoStack->Parameters.Read.Length;
+    Result = FsRtlFastCheckLockForRead(FileLock,
+                                       &IoStack->Parameters.Read.ByteOffset,
+                                       &Length,
+                                       IoStack->Parameters.Read.Key,
+                                       IoStack->FileObject,
+                                       IoGetRequestorProcess(Irp));
     DPRINT("CheckLockForReadAccess(%wZ) => %s\n", &IoStack->FileObject->FileName, Result ? "TRUE" : "FALSE");
     return Result;
 }
@@ -715,31 +748,20 @@ FsRtlCheckLockForWriteAccess(IN PFILE_LOCK FileLock,
                              IN PIRP Irp)
 {
     BOOLEAN Result;
+    LARGE_INTEGER Length;
     PIO_STACK_LOCATION IoStack = IoGetCurrentIrpStackLocation(Irp);
-    COMBINED_LOCK_ELEMENT ToFind;
-    PCOMBINED_LOCK_ELEMENT Found;
-    PEPROCESS Process = Irp->Tail.Overlay.Thread->ThreadsProcess;
-    DPRINT("CheckLockForWriteAccess(%wZ, Offset %08x%08x, Length %x)\n", 
+    DPRINT("CheckLockForWriteAccess(%wZ, Offset %08x%08x, Length %x)\n",
            &IoStack->FileObject->FileName,
            IoStack->Parameters.Write.ByteOffset.HighPart,
            IoStack->Parameters.Write.ByteOffset.LowPart,
            IoStack->Parameters.Write.Length);
-    if (!FileLock->LockInformation) {
-        DPRINT("CheckLockForWriteAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
-        return TRUE;
-    }
-    ToFind.Exclusive.FileLock.StartingByte = IoStack->Parameters.Write.ByteOffset;
-    ToFind.Exclusive.FileLock.EndingByte.QuadPart = 
-        ToFind.Exclusive.FileLock.StartingByte.QuadPart + 
-        IoStack->Parameters.Write.Length;
-    Found = RtlLookupElementGenericTable
-        (FileLock->LockInformation,
-         &ToFind);
-    if (!Found) {
-        DPRINT("CheckLockForWriteAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
-        return TRUE;
-    }
-    Result = Process == Found->Exclusive.FileLock.ProcessId;
+    Length.QuadPart = IoStack->Parameters.Write.Length;
+    Result = FsRtlFastCheckLockForWrite(FileLock,
+                                        &IoStack->Parameters.Write.ByteOffset,
+                                        &Length,
+                                        IoStack->Parameters.Write.Key,
+                                        IoStack->FileObject,
+                                        IoGetRequestorProcess(Irp));
     DPRINT("CheckLockForWriteAccess(%wZ) => %s\n", &IoStack->FileObject->FileName, Result ? "TRUE" : "FALSE");
     return Result;
 }
@@ -756,26 +778,22 @@ FsRtlFastCheckLockForRead(IN PFILE_LOCK FileLock,
                           IN PFILE_OBJECT FileObject,
                           IN PVOID Process)
 {
-    PEPROCESS EProcess = Process;
-    COMBINED_LOCK_ELEMENT ToFind;
-    PCOMBINED_LOCK_ELEMENT Found;
-    DPRINT("FsRtlFastCheckLockForRead(%wZ, Offset %08x%08x, Length %08x%08x, Key %x)\n", 
-           &FileObject->FileName, 
+    FILE_LOCK_INFO ToFind;
+    PLOCK_INFORMATION LockInfo = FileLock->LockInformation;
+    DPRINT("FsRtlFastCheckLockForRead(%wZ, Offset %08x%08x, Length %08x%08x, Key %x)\n",
+           &FileObject->FileName,
            FileOffset->HighPart,
-           FileOffset->LowPart, 
+           FileOffset->LowPart,
            Length->HighPart,
            Length->LowPart,
            Key);
-    ToFind.Exclusive.FileLock.StartingByte = *FileOffset;
-    ToFind.Exclusive.FileLock.EndingByte.QuadPart = 
-        FileOffset->QuadPart + Length->QuadPart;
-    if (!FileLock->LockInformation) return TRUE;
-    Found = RtlLookupElementGenericTable
-        (FileLock->LockInformation,
-         &ToFind);
-    if (!Found || !Found->Exclusive.FileLock.ExclusiveLock) return TRUE;
-    return Found->Exclusive.FileLock.Key == Key && 
-        Found->Exclusive.FileLock.ProcessId == EProcess;
+    /* Fast path: nothing is locked */
+    if (!LockInfo || !LockInfo->RangeRoot) return TRUE;
+    ToFind.StartingByte = *FileOffset;
+    ToFind.EndingByte.QuadPart = FileOffset->QuadPart + Length->QuadPart;
+    ToFind.Key = Key;
+    ToFind.ProcessId = Process;
+    return !LockRangeFindOverlap(LockInfo->RangeRoot, &ToFind, LockBlocksRead);
 }
 
 /*
@@ -791,32 +809,25 @@ FsRtlFastCheckLockForWrite(IN PFILE_LOCK FileLock,
                            IN PVOID Process)
 {
     BOOLEAN Result;
-    PEPROCESS EProcess = Process;
-    COMBINED_LOCK_ELEMENT ToFind;
-    PCOMBINED_LOCK_ELEMENT Found;
-    DPRINT("FsRtlFastCheckLockForWrite(%wZ, Offset %08x%08x, Length %08x%08x, Key %x)\n", 
-           &FileObject->FileName, 
+    FILE_LOCK_INFO ToFind;
+    PLOCK_INFORMATION LockInfo = FileLock->LockInformation;
+    DPRINT("FsRtlFastCheckLockForWrite(%wZ, Offset %08x%08x, Length %08x%08x, Key %x)\n",
+           &FileObject->FileName,
            FileOffset->HighPart,
-           FileOffset->LowPart, 
+           FileOffset->LowPart,
            Length->HighPart,
            Length->LowPart,
            Key);
-    ToFind.Exclusive.FileLock.StartingByte = *FileOffset;
-    ToFind.Exclusive.FileLock.EndingByte.QuadPart = 
-        FileOffset->QuadPart + Length->QuadPart;
-    if (!FileLock->LockInformation) {
+    /* Fast path: nothing is locked */
+    if (!LockInfo || !LockInfo->RangeRoot) {
         DPRINT("CheckForWrite(%wZ) => TRUE\n", &FileObject->FileName);
         return TRUE;
     }
-    Found = RtlLookupElementGenericTable
-        (FileLock->LockInformation,
-         &ToFind);
-    if (!Found) {
-        DPRINT("CheckForWrite(%wZ) => TRUE\n", &FileObject->FileName);
-        return TRUE;
-    }
-    Result = Found->Exclusive.FileLock.Key == Key && 
-        Found->Exclusive.FileLock.ProcessId == EProcess;
+    ToFind.StartingByte = *FileOffset;
+    ToFind.EndingByte.QuadPart = FileOffset->QuadPart + Length->QuadPart;
+    ToFind.Key = Key;
+    ToFind.ProcessId = Process;
+    Result = !LockRangeFindOverlap(LockInfo->RangeRoot, &ToFind, LockBlocksWrite);
     DPRINT("CheckForWrite(%wZ) => %s\n", &FileObject->FileName, Result ? "TRUE" : "FALSE");
     return Result;
 }
@@ -835,17 +846,12 @@ FsRtlFastUnlockSingle(IN PFILE_LOCK FileLock,
                       IN PVOID Context OPTIONAL,
                       IN BOOLEAN AlreadySynchronized)
 {
-    BOOLEAN FoundShared = FALSE;
-    PLIST_ENTRY SharedEntry;
-    PLOCK_SHARED_RANGE SharedRange = NULL;
-    COMBINED_LOCK_ELEMENT Find;
-    PCOMBINED_LOCK_ELEMENT Entry;
-    PIRP NextMatchingLockIrp;
+    PLOCK_RANGE Range;
     PLOCK_INFORMATION InternalInfo = FileLock->LockInformation;
-    DPRINT("FsRtlFastUnlockSingle(%wZ, Offset %08x%08x (%d), Length %08x%08x (%d), Key %x)\n", 
-           &FileObject->FileName, 
+    DPRINT("FsRtlFastUnlockSingle(%wZ, Offset %08x%08x (%d), Length %08x%08x (%d), Key %x)\n",
+           &FileObject->FileName,
            FileOffset->HighPart,
-           FileOffset->LowPart, 
+           FileOffset->LowPart,
            (int)FileOffset->QuadPart,
            Length->HighPart,
            Length->LowPart,
@@ -855,165 +861,22 @@ FsRtlFastUnlockSingle(IN PFILE_LOCK FileLock,
     // -- msdn
     // But Windows 2003 doesn't assert on it and simply ignores that parameter
     // ASSERT(AlreadySynchronized);
-    Find.Exclusive.FileLock.StartingByte = *FileOffset;
-    Find.Exclusive.FileLock.EndingByte.QuadPart = 
-        FileOffset->QuadPart + Length->QuadPart;
     if (!InternalInfo) {
         DPRINT("File not previously locked (ever)\n");
         return STATUS_RANGE_NOT_LOCKED;
     }
-    Entry = RtlLookupElementGenericTable(&InternalInfo->RangeTable, &Find);
-    if (!Entry) {
+    Range = LockRangeFindExact(InternalInfo->RangeRoot,
+                               FileOffset->QuadPart,
+                               FileOffset->QuadPart + Length->QuadPart,
+                               Key,
+                               Process);
+    if (!Range) {
         DPRINT("Range not locked %wZ\n", &FileObject->FileName);
         return STATUS_RANGE_NOT_LOCKED;
     }
 
-    DPRINT("Found lock entry: Exclusive %u %08x%08x:%08x%08x %wZ\n",
-           Entry->Exclusive.FileLock.ExclusiveLock,
-           Entry->Exclusive.FileLock.StartingByte.HighPart,
-           Entry->Exclusive.FileLock.StartingByte.LowPart,
-           Entry->Exclusive.FileLock.EndingByte.HighPart,
-           Entry->Exclusive.FileLock.EndingByte.LowPart,
-           &FileObject->FileName);
-    
-    if (Entry->Exclusive.FileLock.ExclusiveLock)
-    {
-        if (Entry->Exclusive.FileLock.Key != Key ||
-            Entry->Exclusive.FileLock.ProcessId != Process ||
-            Entry->Exclusive.FileLock.StartingByte.QuadPart != FileOffset->QuadPart ||
-            Entry->Exclusive.FileLock.EndingByte.QuadPart != 
-            FileOffset->QuadPart + Length->QuadPart)
-        {
-            DPRINT("Range not locked %wZ\n", &FileObject->FileName);
-            return STATUS_RANGE_NOT_LOCKED;
-        }
-        RtlCopyMemory(&Find, Entry, sizeof(Find));
-        // Remove the old exclusive lock region
-        RtlDeleteElementGenericTable(&InternalInfo->RangeTable, Entry);
-    }
-    else
-    {
-        DPRINT("Shared lock %wZ Start %08x%08x End %08x%08x\n", 
-               &FileObject->FileName,
-               Entry->Exclusive.FileLock.StartingByte.HighPart,
-               Entry->Exclusive.FileLock.StartingByte.LowPart,
-               Entry->Exclusive.FileLock.EndingByte.HighPart,
-               Entry->Exclusive.FileLock.EndingByte.LowPart);
-        for (SharedEntry = InternalInfo->SharedLocks.Flink;
-             SharedEntry != &InternalInfo->SharedLocks;
-             SharedEntry = SharedEntry->Flink)
-        {
-            SharedRange = CONTAINING_RECORD(SharedEntry, LOCK_SHARED_RANGE, Entry);
-            if (SharedRange->Start.QuadPart == FileOffset->QuadPart &&
-                SharedRange->End.QuadPart == FileOffset->QuadPart + Length->QuadPart &&
-                SharedRange->Key == Key &&
-                SharedRange->ProcessId == Process)
-            {
-                FoundShared = TRUE;
-                DPRINT("Found shared element to delete %wZ Start %08x%08x End %08x%08x Key %x\n",
-                       &FileObject->FileName,
-                       SharedRange->Start.HighPart,
-                       SharedRange->Start.LowPart,
-                       SharedRange->End.HighPart,
-                       SharedRange->End.LowPart,
-                       SharedRange->Key);
-                break;
-            }
-        }
-        if (FoundShared)
-        {
-            /* Remove the found range from the shared range lists */
-            RemoveEntryList(&SharedRange->Entry);
-            ExFreePoolWithTag(SharedRange, TAG_RANGE);
-            /* We need to rebuild the list of shared ranges. */
-            DPRINT("Removing the lock entry %wZ (%08x%08x:%08x%08x)\n", 
-                   &FileObject->FileName, 
-                   Entry->Exclusive.FileLock.StartingByte.HighPart, 
-                   Entry->Exclusive.FileLock.StartingByte.LowPart,
-                   Entry->Exclusive.FileLock.EndingByte.HighPart, 
-                   Entry->Exclusive.FileLock.EndingByte.LowPart);
-               
-            /* Remember what was in there and remove it from the table */
-            Find = *Entry;
-            RtlDeleteElementGenericTable(&InternalInfo->RangeTable, &Find);
-            /* Put shared locks back in place */
-            for (SharedEntry = InternalInfo->SharedLocks.Flink;
-                 SharedEntry != &InternalInfo->SharedLocks;
-                 SharedEntry = SharedEntry->Flink)
-            {
-                COMBINED_LOCK_ELEMENT LockElement;
-                SharedRange = CONTAINING_RECORD(SharedEntry, LOCK_SHARED_RANGE, Entry);
-                LockElement.Exclusive.FileLock.FileObject = FileObject;
-                LockElement.Exclusive.FileLock.StartingByte = SharedRange->Start;
-                LockElement.Exclusive.FileLock.EndingByte = SharedRange->End;
-                LockElement.Exclusive.FileLock.ProcessId = SharedRange->ProcessId;
-                LockElement.Exclusive.FileLock.Key = SharedRange->Key;
-                LockElement.Exclusive.FileLock.ExclusiveLock = FALSE;
-                
-                if (LockCompare(&InternalInfo->RangeTable, &Find, &LockElement) != GenericEqual)
-                {
-                    DPRINT("Skipping range %08x%08x:%08x%08x\n",
-                           LockElement.Exclusive.FileLock.StartingByte.HighPart,
-                           LockElement.Exclusive.FileLock.StartingByte.LowPart,
-                           LockElement.Exclusive.FileLock.EndingByte.HighPart,
-                           LockElement.Exclusive.FileLock.EndingByte.LowPart);
-                    continue;
-                }
-                DPRINT("Re-creating range %08x%08x:%08x%08x\n",
-                       LockElement.Exclusive.FileLock.StartingByte.HighPart,
-                       LockElement.Exclusive.FileLock.StartingByte.LowPart,
-                       LockElement.Exclusive.FileLock.EndingByte.HighPart,
-                       LockElement.Exclusive.FileLock.EndingByte.LowPart);
-                FsRtlpRebuildSharedLockRange(FileLock, InternalInfo, &LockElement);
-            }
-        }
-        else
-        {
-            return STATUS_RANGE_NOT_LOCKED;
-        }
-    }
+    FsRtlpUnlockRange(FileLock, InternalInfo, Range);
 
-#ifndef NDEBUG    
-    DPRINT("Lock still has:\n");
-    for (SharedEntry = InternalInfo->SharedLocks.Flink;
-         SharedEntry != &InternalInfo->SharedLocks;
-         SharedEntry = SharedEntry->Flink)
-    {
-        SharedRange = CONTAINING_RECORD(SharedEntry, LOCK_SHARED_RANGE, Entry);
-        DPRINT("Shared element %wZ Offset %08x%08x Length %08x%08x Key %x\n",
-               &FileObject->FileName,
-               SharedRange->Start.HighPart,
-               SharedRange->Start.LowPart,
-               SharedRange->End.HighPart,
-               SharedRange->End.LowPart,
-               SharedRange->Key);
-    }
-#endif
-    
-    // this is definitely the thing we want
-    InternalInfo->Generation++;
-    while ((NextMatchingLockIrp = IoCsqRemoveNextIrp(&InternalInfo->Csq, &Find)))
-    {
-        if (NextMatchingLockIrp->IoStatus.Information == InternalInfo->Generation)
-        {
-            // We've already looked at this one, meaning that we looped.  
-            // Put it back and exit.
-            IoCsqInsertIrpEx
-                (&InternalInfo->Csq,
-                 NextMatchingLockIrp,
-                 NULL,
-                 NULL);
-            break;
-        }
-        // Got a new lock irp... try to do the new lock operation
-        // Note that we pick an operation that would succeed at the time
-        // we looked, but can't guarantee that it won't just be re-queued
-        // because somebody else snatched part of the range in a new thread.
-        DPRINT("Locking another IRP %p for %p %wZ\n", 
-               NextMatchingLockIrp, FileLock, &FileObject->FileName);
-        FsRtlProcessFileLock(InternalInfo->BelongsTo, NextMatchingLockIrp, NULL);
-    }
-    
     DPRINT("Success %wZ\n", &FileObject->FileName);
     return STATUS_SUCCESS;
 }
@@ -1028,8 +891,8 @@ FsRtlFastUnlockAll(IN PFILE_LOCK FileLock,
                    IN PEPROCESS Process,
                    IN PVOID Context OPTIONAL)
 {
-    PLIST_ENTRY ListEntry;
-    PCOMBINED_LOCK_ELEMENT Entry;
+    FILE_LOCK_INFO Current;
+    PLOCK_RANGE Range, Next;
     PLOCK_INFORMATION InternalInfo = FileLock->LockInformation;
     DPRINT("FsRtlFastUnlockAll(%wZ)\n", &FileObject->FileName);
     // XXX Synchronize somehow
@@ -1037,43 +900,16 @@ FsRtlFastUnlockAll(IN PFILE_LOCK FileLock,
         DPRINT("Not locked %wZ\n", &FileObject->FileName);
         return STATUS_RANGE_NOT_LOCKED; // no locks
     }
-    for (ListEntry = InternalInfo->SharedLocks.Flink;
-         ListEntry != &InternalInfo->SharedLocks;)
-    {
-        LARGE_INTEGER Length;
-        PLOCK_SHARED_RANGE Range = CONTAINING_RECORD(ListEntry, LOCK_SHARED_RANGE, Entry);
-        Length.QuadPart = Range->End.QuadPart - Range->Start.QuadPart;
-        ListEntry = ListEntry->Flink;
-        if (Range->ProcessId != Process)
-            continue;
-        FsRtlFastUnlockSingle
-            (FileLock,
-             FileObject,
-             &Range->Start,
-             &Length,
-             Range->ProcessId,
-             Range->Key,
-             Context,
-             TRUE);
-    }
-    for (Entry = RtlEnumerateGenericTable(&InternalInfo->RangeTable, TRUE);
-         Entry;
-         Entry = RtlEnumerateGenericTable(&InternalInfo->RangeTable, FALSE))
+    /* Walk the tree in order; unlocking may grant queued requests, so find
+       the successor by key again after every removal */
+    for (Range = LockRangeNext(InternalInfo->RangeRoot, NULL, NULL);
+         Range;
+         Range = Next)
     {
-        LARGE_INTEGER Length;
-        // We'll take the first one to be the list head, and free the others first...
-        Length.QuadPart = 
-            Entry->Exclusive.FileLock.EndingByte.QuadPart - 
-            Entry->Exclusive.FileLock.StartingByte.QuadPart;
-        FsRtlFastUnlockSingle
-            (FileLock, 
-             Entry->Exclusive.FileLock.FileObject,
-             &Entry->Exclusive.FileLock.StartingByte,
-             &Length,
-             Entry->Exclusive.FileLock.ProcessId,
-             Entry->Exclusive.FileLock.Key,
-             Context,
-             TRUE);
+        Current = Range->FileLock;
+        if (Current.ProcessId == Process && Current.FileObject == FileObject)
+            FsRtlpUnlockRange(FileLock, InternalInfo, Range);
+        Next = LockRangeNext(InternalInfo->RangeRoot, &Current, Range);
     }
     DPRINT("Done %wZ\n", &FileObject->FileName);
     return STATUS_SUCCESS;
@@ -1090,58 +926,28 @@ FsRtlFastUnlockAllByKey(IN PFILE_LOCK FileLock,
                         IN ULONG Key,
                         IN PVOID Context OPTIONAL)
 {
-    PLIST_ENTRY ListEntry;
-    PCOMBINED_LOCK_ELEMENT Entry;
+    FILE_LOCK_INFO Current;
+    PLOCK_RANGE Range, Next;
     PLOCK_INFORMATION InternalInfo = FileLock->LockInformation;
-    
+
     DPRINT("FsRtlFastUnlockAllByKey(%wZ,Key %x)\n", &FileObject->FileName, Key);
-    
+
     // XXX Synchronize somehow
     if (!FileLock->LockInformation) return STATUS_RANGE_NOT_LOCKED; // no locks
-    for (ListEntry = InternalInfo->SharedLocks.Flink;
-         ListEntry != &InternalInfo->SharedLocks;)
-    {
-        PLOCK_SHARED_RANGE Range = CONTAINING_RECORD(ListEntry, LOCK_SHARED_RANGE, Entry);
-        LARGE_INTEGER Length;
-        Length.QuadPart = Range->End.QuadPart - Range->Start.QuadPart;
-        ListEntry = ListEntry->Flink;
-        if (Range->ProcessId != Process ||
-            Range->Key != Key)
-            continue;
-        FsRtlFastUnlockSingle
-            (FileLock,
-             FileObject,
-             &Range->Start,
-             &Length,
-             Range->ProcessId,
-             Range->Key,
-             Context,
-             TRUE);
-    }
-    for (Entry = RtlEnumerateGenericTable(&InternalInfo->RangeTable, TRUE);
-         Entry;
-         Entry = RtlEnumerateGenericTable(&InternalInfo->RangeTable, FALSE))
+    for (Range = LockRangeNext(InternalInfo->RangeRoot, NULL, NULL);
+         Range;
+         Range = Next)
     {
-        LARGE_INTEGER Length;
-        // We'll take the first one to be the list head, and free the others first...
-        Length.QuadPart = 
-            Entry->Exclusive.FileLock.EndingByte.QuadPart - 
-            Entry->Exclusive.FileLock.StartingByte.QuadPart;
-        if (Entry->Exclusive.FileLock.Key == Key && 
-            Entry->Exclusive.FileLock.ProcessId == Process)
+        Current = Range->FileLock;
+        if (Current.ProcessId == Process &&
+            Current.FileObject == FileObject &&
+            Current.Key == Key)
         {
-            FsRtlFastUnlockSingle
-                (FileLock, 
-                 Entry->Exclusive.FileLock.FileObject,
-                 &Entry->Exclusive.FileLock.StartingByte,
-                 &Length,
-                 Entry->Exclusive.FileLock.ProcessId,
-                 Entry->Exclusive.FileLock.Key,
-                 Context,
-                 TRUE);
+            FsRtlpUnlockRange(FileLock, InternalInfo, Range);
         }
+        Next = LockRangeNext(InternalInfo->RangeRoot, &Current, Range);
     }
-    
+
     return STATUS_SUCCESS;
 }
 
@@ -1280,29 +1086,22 @@ FsRtlUninitializeFileLock(IN PFILE_LOCK FileLock)
     if (FileLock->LockInformation)
     {
         PIRP Irp;
+        NTSTATUS Status;
         PLOCK_INFORMATION InternalInfo = FileLock->LockInformation;
-        PCOMBINED_LOCK_ELEMENT Entry;
-        PLIST_ENTRY SharedEntry;
-        PLOCK_SHARED_RANGE SharedRange;
         // MSDN: this completes any remaining lock IRPs
-        for (SharedEntry = InternalInfo->SharedLocks.Flink;
-             SharedEntry != &InternalInfo->SharedLocks;)
-        {
-            SharedRange = CONTAINING_RECORD(SharedEntry, LOCK_SHARED_RANGE, Entry);
-            SharedEntry = SharedEntry->Flink;
-            RemoveEntryList(&SharedRange->Entry);
-            ExFreePoolWithTag(SharedRange, TAG_RANGE);
-        }
-        while ((Entry = RtlGetElementGenericTable(&InternalInfo->RangeTable, 0)) != NULL)
-        {
-            RtlDeleteElementGenericTable(&InternalInfo->RangeTable, Entry);
-        }
         while ((Irp = IoCsqRemoveNextIrp(&InternalInfo->Csq, NULL)) != NULL)
         {
-            FsRtlProcessFileLock(FileLock, Irp, NULL);
+            FsRtlCompleteLockIrpReal(FileLock->CompleteLockIrpRoutine,
+                                     NULL,
+                                     Irp,
+                                     STATUS_RANGE_NOT_LOCKED,
+                                     &Status,
+                                     NULL);
         }
+        LockRangeFreeAll(InternalInfo->RangeRoot);
         ExFreePoolWithTag(InternalInfo, TAG_FLOCK);
         FileLock->LockInformation = NULL;
+        FileLock->FastIoIsQuestionable = FALSE;
     }
 }
 
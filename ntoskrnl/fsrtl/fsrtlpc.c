@@ -171,6 +171,7 @@ FsRtlInitSystem(VOID)
                                    IFS_POOL_TAG,
                                    0);
 
+    FsRtlInitializeFileLocks();
     FsRtlInitializeTunnels();
     FsRtlInitializeLargeMcbs();
     KeInitializeSemaphore(&FsRtlpUncSemaphore, 1, MAXLONG);
@@ -22,17 +22,21 @@
 PAGED_LOOKASIDE_LIST FsRtlFirstMappingLookasideList;
 NPAGED_LOOKASIDE_LIST FsRtlFastMutexLookasideList;
 
-/* We use only real 'mapping' runs; we do not store 'holes' to our GTree. */
+/* Every run, including 'holes', is an entry of a VBN-sorted array covering
+ * [0, end of the last mapped run) without gaps. Holes have StartingLbn -1.
+ * The array index is the run index reported to callers, and lookups are
+ * a binary search that never modifies the mapping. */
 typedef struct _LARGE_MCB_MAPPING_ENTRY // run
 {
     LARGE_INTEGER RunStartVbn;
     LARGE_INTEGER RunEndVbn;   /* RunStartVbn+SectorCount; that means +1 after the last sector */
-    LARGE_INTEGER StartingLbn; /* Lbn of 'RunStartVbn' */
+    LARGE_INTEGER StartingLbn; /* Lbn of 'RunStartVbn', -1 for a hole */
 } LARGE_MCB_MAPPING_ENTRY, *PLARGE_MCB_MAPPING_ENTRY;
 
 typedef struct _LARGE_MCB_MAPPING // mcb_priv
 {
-    RTL_GENERIC_TABLE Table;
+    PLARGE_MCB_MAPPING_ENTRY Runs;
+    LARGE_MCB_MAPPING_ENTRY InitialRuns[MAXIMUM_PAIR_COUNT];
 } LARGE_MCB_MAPPING, *PLARGE_MCB_MAPPING;
 
 typedef struct _BASE_MCB_INTERNAL {
@@ -43,76 +47,89 @@ typedef struct _BASE_MCB_INTERNAL {
     PLARGE_MCB_MAPPING Mapping;
 } BASE_MCB_INTERNAL, *PBASE_MCB_INTERNAL;
 
-/*
-static LARGE_MCB_MAPPING_ENTRY StaticRunBelow0 = {
-    {{-1}}, // ignored
-    {{0}},
-    {{-1}}, // ignored
-};
-*/
-
-static PVOID NTAPI McbMappingAllocate(PRTL_GENERIC_TABLE Table, CLONG Bytes)
+#define McbRuns(Mcb)        ((Mcb)->Mapping->Runs)
+#define McbIsHole(Run)      ((Run)->StartingLbn.QuadPart == -1)
+#define McbRunLength(Run)   ((Run)->RunEndVbn.QuadPart - (Run)->RunStartVbn.QuadPart)
+#define McbEndVbn(Mcb)      ((Mcb)->PairCount ? McbRuns(Mcb)[(Mcb)->PairCount - 1].RunEndVbn.QuadPart : 0)
+
+/* Returns the index of the first run ending after Vbn, PairCount if none */
+static ULONG McbFindRun(PBASE_MCB_INTERNAL Mcb, LONGLONG Vbn)
 {
-    PVOID Result;
-    PBASE_MCB Mcb = (PBASE_MCB)Table->TableContext;
-    Result = ExAllocatePoolWithTag(Mcb->PoolType, Bytes, 'LMCB');
-    DPRINT("McbMappingAllocate(%lu) => %p\n", Bytes, Result);
-    return Result;
+    PLARGE_MCB_MAPPING_ENTRY Runs = McbRuns(Mcb);
+    ULONG Low = 0, High = Mcb->PairCount, Middle;
+
+    while (Low < High)
+    {
+        Middle = Low + (High - Low) / 2;
+        if (Runs[Middle].RunEndVbn.QuadPart > Vbn)
+            High = Middle;
+        else
+            Low = Middle + 1;
+    }
+
+    return Low;
 }
 
-static VOID NTAPI McbMappingFree(PRTL_GENERIC_TABLE Table, PVOID Buffer)
+/* Makes room for Count more runs, doubling the array as needed */
+static BOOLEAN McbReserveRuns(PBASE_MCB_INTERNAL Mcb, ULONG Count)
 {
-    DPRINT("McbMappingFree(%p)\n", Buffer);
-    ExFreePoolWithTag(Buffer, 'LMCB');
+    PLARGE_MCB_MAPPING_ENTRY NewRuns;
+    ULONG NewMaximum = Mcb->MaximumPairCount;
+
+    if (Mcb->PairCount + Count <= Mcb->MaximumPairCount)
+        return TRUE;
+
+    while (NewMaximum < Mcb->PairCount + Count)
+        NewMaximum *= 2;
+
+    NewRuns = ExAllocatePoolWithTag(Mcb->PoolType, NewMaximum * sizeof(LARGE_MCB_MAPPING_ENTRY), 'LMCB');
+    DPRINT("McbReserveRuns(%p, %lu) => %p (%lu)\n", Mcb, Count, NewRuns, NewMaximum);
+    if (!NewRuns)
+        return FALSE;
+
+    RtlCopyMemory(NewRuns, McbRuns(Mcb), Mcb->PairCount * sizeof(LARGE_MCB_MAPPING_ENTRY));
+    if (McbRuns(Mcb) != Mcb->Mapping->InitialRuns)
+        ExFreePoolWithTag(McbRuns(Mcb), 'LMCB');
+
+    McbRuns(Mcb) = NewRuns;
+    Mcb->MaximumPairCount = NewMaximum;
+    return TRUE;
 }
 
-static
-RTL_GENERIC_COMPARE_RESULTS
-NTAPI
-McbMappingCompare(PRTL_GENERIC_TABLE Table,
-                  PVOID PtrA,
-                  PVOID PtrB)
+/* Opens Count uninitialized slots at Index; room must have been reserved */
+static VOID McbInsertRuns(PBASE_MCB_INTERNAL Mcb, ULONG Index, ULONG Count)
 {
-    PLARGE_MCB_MAPPING_ENTRY A = PtrA, B = PtrB;
-    RTL_GENERIC_COMPARE_RESULTS Res;
-
-    ASSERT(A);
-    ASSERT(B);
-
-    if (A->RunStartVbn.QuadPart == B->RunStartVbn.QuadPart && A->RunEndVbn.QuadPart == B->RunEndVbn.QuadPart)
-        Res = GenericEqual;
-    else if (A->RunEndVbn.QuadPart <= B->RunStartVbn.QuadPart)
-        Res = GenericLessThan;
-    else if (A->RunEndVbn.QuadPart >= B->RunStartVbn.QuadPart)
-        Res = GenericGreaterThan;
-    else
-    {
-        ASSERT(FALSE);
-        Res = GenericEqual;
-    }
+    ASSERT(Mcb->PairCount + Count <= Mcb->MaximumPairCount);
+    RtlMoveMemory(&McbRuns(Mcb)[Index + Count],
+                  &McbRuns(Mcb)[Index],
+                  (Mcb->PairCount - Index) * sizeof(LARGE_MCB_MAPPING_ENTRY));
+    Mcb->PairCount += Count;
+}
 
-    return Res;
+static VOID McbDeleteRuns(PBASE_MCB_INTERNAL Mcb, ULONG Index, ULONG Count)
+{
+    ASSERT(Index + Count <= Mcb->PairCount);
+    RtlMoveMemory(&McbRuns(Mcb)[Index],
+                  &McbRuns(Mcb)[Index + Count],
+                  (Mcb->PairCount - Index - Count) * sizeof(LARGE_MCB_MAPPING_ENTRY));
+    Mcb->PairCount -= Count;
 }
 
-static RTL_GENERIC_COMPARE_RESULTS NTAPI McbMappingIntersectCompare(PRTL_GENERIC_TABLE Table, PVOID PtrA, PVOID PtrB)
+/* Cuts run Index in two at Vbn; room for one run must have been reserved */
+static VOID McbSplitRun(PBASE_MCB_INTERNAL Mcb, ULONG Index, LONGLONG Vbn)
 {
-    PLARGE_MCB_MAPPING_ENTRY A = PtrA, B = PtrB;
-    RTL_GENERIC_COMPARE_RESULTS Res;
-
-    if (A->RunStartVbn.QuadPart <= B->RunStartVbn.QuadPart && A->RunEndVbn.QuadPart > B->RunStartVbn.QuadPart)
-        Res = GenericEqual;
-    else if (A->RunStartVbn.QuadPart >= B->RunStartVbn.QuadPart && B->RunEndVbn.QuadPart > A->RunStartVbn.QuadPart)
-        Res = GenericEqual;
-    else if (A->RunStartVbn.QuadPart < B->RunStartVbn.QuadPart)
-        Res = GenericLessThan;
-    else if (A->RunStartVbn.QuadPart > B->RunStartVbn.QuadPart)
-        Res = GenericGreaterThan;
-    else
-        Res = GenericEqual;
+    PLARGE_MCB_MAPPING_ENTRY Run;
 
-    return Res;
-}
+    McbInsertRuns(Mcb, Index + 1, 1);
+    Run = &McbRuns(Mcb)[Index];
+    ASSERT(Run->RunStartVbn.QuadPart < Vbn && Vbn < Run->RunEndVbn.QuadPart);
 
+    Run[1] = Run[0];
+    Run[0].RunEndVbn.QuadPart = Vbn;
+    Run[1].RunStartVbn.QuadPart = Vbn;
+    if (!McbIsHole(&Run[1]))
+        Run[1].StartingLbn.QuadPart += Vbn - Run[0].RunStartVbn.QuadPart;
+}
 
 /* PUBLIC FUNCTIONS **********************************************************/
 
@@ -140,10 +157,9 @@ FsRtlAddBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
     BOOLEAN Result = TRUE;
     BOOLEAN IntResult;
     PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
-    LARGE_MCB_MAPPING_ENTRY Node, NeedleRun;
-    PLARGE_MCB_MAPPING_ENTRY LowerRun, HigherRun;
-    BOOLEAN NewElement;
-    LONGLONG IntLbn;
+    PLARGE_MCB_MAPPING_ENTRY Runs;
+    LONGLONG IntLbn, EndVbn;
+    ULONG Index;
 
     DPRINT("FsRtlAddBaseMcbEntry(%p, %I64d, %I64d, %I64d)\n", OpaqueMcb, Vbn, Lbn, SectorCount);
 
@@ -170,104 +186,68 @@ FsRtlAddBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
     }
 
     /* clean any possible previous entries in our range */
-    FsRtlRemoveBaseMcbEntry(OpaqueMcb, Vbn, SectorCount);
-
-    // We need to map [Vbn, Vbn+SectorCount) to [Lbn, Lbn+SectorCount),
-    // taking in account the fact that we need to merge these runs if
-    // they are adjacent or overlap, but fail if new run fully fits into another run
-
-    /* initially we think we will be inserted as a separate run */
-    Node.RunStartVbn.QuadPart = Vbn;
-    Node.RunEndVbn.QuadPart = Vbn + SectorCount;
-    Node.StartingLbn.QuadPart = Lbn;
-
-    /* optionally merge with lower run */
-    NeedleRun.RunStartVbn.QuadPart = Node.RunStartVbn.QuadPart - 1;
-    NeedleRun.RunEndVbn.QuadPart = NeedleRun.RunStartVbn.QuadPart + 1;
-    NeedleRun.StartingLbn.QuadPart = ~0ULL;
-    Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
-    if ((LowerRun = RtlLookupElementGenericTable(&Mcb->Mapping->Table, &NeedleRun)) &&
-        (LowerRun->StartingLbn.QuadPart + (LowerRun->RunEndVbn.QuadPart - LowerRun->RunStartVbn.QuadPart) == Node.StartingLbn.QuadPart))
+    if (!FsRtlRemoveBaseMcbEntry(OpaqueMcb, Vbn, SectorCount) ||
+        !McbReserveRuns(Mcb, 2))
     {
-        ASSERT(LowerRun->RunEndVbn.QuadPart == Node.RunStartVbn.QuadPart);
-        Node.RunStartVbn.QuadPart = LowerRun->RunStartVbn.QuadPart;
-        Node.StartingLbn.QuadPart = LowerRun->StartingLbn.QuadPart;
-        Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
-        RtlDeleteElementGenericTable(&Mcb->Mapping->Table, LowerRun);
-        --Mcb->PairCount;
-        DPRINT("Intersecting lower run found (%I64d,%I64d) Lbn: %I64d\n", LowerRun->RunStartVbn.QuadPart, LowerRun->RunEndVbn.QuadPart, LowerRun->StartingLbn.QuadPart);
+        Result = FALSE;
+        goto quit;
     }
 
-    /* optionally merge with higher run */
-    NeedleRun.RunStartVbn.QuadPart = Node.RunEndVbn.QuadPart;
-    NeedleRun.RunEndVbn.QuadPart = NeedleRun.RunStartVbn.QuadPart + 1;
-    Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
-    if ((HigherRun = RtlLookupElementGenericTable(&Mcb->Mapping->Table, &NeedleRun)) &&
-        (Node.StartingLbn.QuadPart <= HigherRun->StartingLbn.QuadPart))
+    // We need to map [Vbn, Vbn+SectorCount) to [Lbn, Lbn+SectorCount).
+    // The range is now either past the last run or inside a single hole.
+    EndVbn = McbEndVbn(Mcb);
+    Runs = McbRuns(Mcb);
+    if (Vbn >= EndVbn)
     {
-        ASSERT(HigherRun->RunStartVbn.QuadPart == Node.RunEndVbn.QuadPart);
-        Node.RunEndVbn.QuadPart = HigherRun->RunEndVbn.QuadPart;
-        Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
-        RtlDeleteElementGenericTable(&Mcb->Mapping->Table, HigherRun);
-        --Mcb->PairCount;
-        DPRINT("Intersecting higher run found (%I64d,%I64d) Lbn: %I64d\n", HigherRun->RunStartVbn.QuadPart, HigherRun->RunEndVbn.QuadPart, HigherRun->StartingLbn.QuadPart);
+        /* append, preceded by a hole if there is a gap */
+        if (Vbn > EndVbn)
+        {
+            Index = Mcb->PairCount++;
+            Runs[Index].RunStartVbn.QuadPart = EndVbn;
+            Runs[Index].RunEndVbn.QuadPart = Vbn;
+            Runs[Index].StartingLbn.QuadPart = -1;
+        }
+        Index = Mcb->PairCount++;
+        Runs[Index].RunStartVbn.QuadPart = Vbn;
+        Runs[Index].RunEndVbn.QuadPart = Vbn + SectorCount;
     }
-    Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
-
-    /* finally insert the resulting run */
-    RtlInsertElementGenericTable(&Mcb->Mapping->Table, &Node, sizeof(Node), &NewElement);
-    ++Mcb->PairCount;
-    ASSERT(NewElement);
+    else
+    {
+        /* carve our run out of the hole */
+        Index = McbFindRun(Mcb, Vbn);
+        ASSERT(McbIsHole(&Runs[Index]));
+        ASSERT(Runs[Index].RunEndVbn.QuadPart >= Vbn + SectorCount);
+        if (Runs[Index].RunStartVbn.QuadPart < Vbn)
+        {
+            McbSplitRun(Mcb, Index, Vbn);
+            Index++;
+        }
+        if (Runs[Index].RunEndVbn.QuadPart > Vbn + SectorCount)
+            McbSplitRun(Mcb, Index, Vbn + SectorCount);
+    }
+    Runs[Index].StartingLbn.QuadPart = Lbn;
 
     // NB: Two consecutive runs can only be merged, if actual LBNs also match!
 
-    /* 1.
-            Existing->RunStartVbn
-            |
-            |///////|
-                |/////////////|
-                |
-                Node->RunStartVbn
-
-        2.
-            Existing->RunStartVbn
-            |
-            |///////|
-        |//////|
-        |
-        Node->RunStartVbn
-
-        3.
-            Existing->RunStartVbn
-            |
-            |///////|
-                |///|
-                |
-                Node->RunStartVbn
-
-        4.
-            Existing->RunStartVbn
-            |
-            |///////|
-        |///////////////|
-        |
-        Node->RunStartVbn
-
-
-    Situation with holes:
-    1. Holes at both ends
-    2. Hole at the right, new run merged with the previous run
-    3. Hole at the right, new run is not merged with the previous run
-    4. Hole at the left, new run merged with the next run
-    5. Hole at the left, new run is not merged with the next run
-    6. No holes, exact fit to merge with both previous and next runs
-    7. No holes, merges only with the next run
-    8. No holes, merges only with the previous run
-    9. No holes, does not merge with next or prev runs
-
-
-    Overwriting existing mapping is not possible and results in FALSE being returned
-    */
+    /* optionally merge with higher run */
+    if (Index + 1 < Mcb->PairCount &&
+        !McbIsHole(&Runs[Index + 1]) &&
+        Runs[Index].StartingLbn.QuadPart + McbRunLength(&Runs[Index]) == Runs[Index + 1].StartingLbn.QuadPart)
+    {
+        DPRINT("Merging higher run (%I64d,%I64d) Lbn: %I64d\n", Runs[Index + 1].RunStartVbn.QuadPart, Runs[Index + 1].RunEndVbn.QuadPart, Runs[Index + 1].StartingLbn.QuadPart);
+        Runs[Index].RunEndVbn = Runs[Index + 1].RunEndVbn;
+        McbDeleteRuns(Mcb, Index + 1, 1);
+    }
+
+    /* optionally merge with lower run */
+    if (Index > 0 &&
+        !McbIsHole(&Runs[Index - 1]) &&
+        Runs[Index - 1].StartingLbn.QuadPart + McbRunLength(&Runs[Index - 1]) == Runs[Index].StartingLbn.QuadPart)
+    {
+        DPRINT("Merging lower run (%I64d,%I64d) Lbn: %I64d\n", Runs[Index - 1].RunStartVbn.QuadPart, Runs[Index - 1].RunEndVbn.QuadPart, Runs[Index - 1].StartingLbn.QuadPart);
+        Runs[Index - 1].RunEndVbn = Runs[Index].RunEndVbn;
+        McbDeleteRuns(Mcb, Index, 1);
+    }
 
 quit:
     DPRINT("FsRtlAddBaseMcbEntry(%p, %I64d, %I64d, %I64d) = %d\n", Mcb, Vbn, Lbn, SectorCount, Result);
@@ -331,46 +311,18 @@ FsRtlGetNextBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
 {
     BOOLEAN Result = FALSE;
     PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
-    PLARGE_MCB_MAPPING_ENTRY Run = NULL;
-    ULONG CurrentIndex = 0;
-    ULONGLONG LastVbn = 0;
-    ULONGLONG LastSectorCount = 0;
-
-    // Traverse the tree 
-    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, TRUE);
-    Run;
-        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, FALSE))
-    {
-        // is the current index a hole?
-        if (Run->RunStartVbn.QuadPart > (LastVbn + LastSectorCount))
-        {
-            // Is this the index we're looking for?
-            if (RunIndex == CurrentIndex)
-            {
-                *Vbn = LastVbn + LastSectorCount;
-                *Lbn = -1;
-                *SectorCount = Run->RunStartVbn.QuadPart - *Vbn;
-
-                Result = TRUE;
-                goto quit;
-            }
-
-            CurrentIndex++;
-        }
-
-        if (RunIndex == CurrentIndex)
-        {
-            *Vbn = Run->RunStartVbn.QuadPart;
-            *Lbn = Run->StartingLbn.QuadPart;
-            *SectorCount = Run->RunEndVbn.QuadPart - Run->RunStartVbn.QuadPart;
+    PLARGE_MCB_MAPPING_ENTRY Run;
 
-            Result = TRUE;
-            goto quit;
-        }
+    // Holes are stored too, so the run index is the array index
+    if (RunIndex < Mcb->PairCount)
+    {
+        Run = &McbRuns(Mcb)[RunIndex];
+        *Vbn = Run->RunStartVbn.QuadPart;
+        *Lbn = Run->StartingLbn.QuadPart;
+        *SectorCount = McbRunLength(Run);
 
-        CurrentIndex++;
-        LastVbn = Run->RunStartVbn.QuadPart;
-        LastSectorCount = Run->RunEndVbn.QuadPart - Run->RunStartVbn.QuadPart;
+        Result = TRUE;
+        goto quit;
     }
 
     // these values are meaningless when returning false (but setting them can be helpful for debugging purposes)
@@ -435,11 +387,7 @@ FsRtlInitializeBaseMcb(IN PBASE_MCB OpaqueMcb,
     Mcb->PoolType = PoolType;
     Mcb->PairCount = 0;
     Mcb->MaximumPairCount = MAXIMUM_PAIR_COUNT;
-    RtlInitializeGenericTable(&Mcb->Mapping->Table,
-                              McbMappingCompare,
-                              McbMappingAllocate,
-                              McbMappingFree,
-                              Mcb);
+    Mcb->Mapping->Runs = Mcb->Mapping->InitialRuns;
 }
 
 /*
@@ -510,36 +458,38 @@ FsRtlLookupBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
     OUT PULONG Index OPTIONAL)
 {
     BOOLEAN Result = FALSE;
+    PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
+    PLARGE_MCB_MAPPING_ENTRY Run;
     ULONG i;
-    LONGLONG LastVbn = 0, LastLbn = 0, Count = 0;   // the last values we've found during traversal
 
     DPRINT("FsRtlLookupBaseMcbEntry(%p, %I64d, %p, %p, %p, %p, %p)\n", OpaqueMcb, Vbn, Lbn, SectorCountFromLbn, StartingLbn, SectorCountFromStartingLbn, Index);
 
-    for (i = 0; FsRtlGetNextBaseMcbEntry(OpaqueMcb, i, &LastVbn, &LastLbn, &Count); i++)
+    i = McbFindRun(Mcb, Vbn);
+
+    // have we reached the target mapping?
+    if (i < Mcb->PairCount)
     {
-        // have we reached the target mapping?
-        if (Vbn < LastVbn + Count)
+        Run = &McbRuns(Mcb)[i];
+
+        if (Lbn)
         {
-            if (Lbn)
-            {
-                if (LastLbn == -1)
-                    *Lbn = -1;
-                else
-                    *Lbn = LastLbn + (Vbn - LastVbn);
-            }
-
-            if (SectorCountFromLbn)
-                *SectorCountFromLbn = LastVbn + Count - Vbn;
-            if (StartingLbn)
-                *StartingLbn = LastLbn;
-            if (SectorCountFromStartingLbn)
-                *SectorCountFromStartingLbn = LastVbn + Count - LastVbn;
-            if (Index)
-                *Index = i;
-
-            Result = TRUE;
-            goto quit;
+            if (McbIsHole(Run))
+                *Lbn = -1;
+            else
+                *Lbn = Run->StartingLbn.QuadPart + (Vbn - Run->RunStartVbn.QuadPart);
         }
+
+        if (SectorCountFromLbn)
+            *SectorCountFromLbn = Run->RunEndVbn.QuadPart - Vbn;
+        if (StartingLbn)
+            *StartingLbn = Run->StartingLbn.QuadPart;
+        if (SectorCountFromStartingLbn)
+            *SectorCountFromStartingLbn = McbRunLength(Run);
+        if (Index)
+            *Index = i;
+
+        Result = TRUE;
+        goto quit;
     }
 
     if (Lbn)
@@ -598,47 +548,28 @@ FsRtlLookupLastLargeMcbEntryAndIndex_internal(IN PBASE_MCB_INTERNAL Mcb,
                                               OUT PLONGLONG Lbn,
                                               OUT PULONG Index OPTIONAL)
 {
-    ULONG RunIndex = 0;
-    PLARGE_MCB_MAPPING_ENTRY Run, RunFound = NULL;
-    LONGLONG LastVbn = 0;
+    PLARGE_MCB_MAPPING_ENTRY RunFound;
 
-    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, TRUE);
-        Run;
-        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, FALSE))
-    {
-        /* Take care when we must emulate missing 'hole' runs. */
-        if (Run->RunStartVbn.QuadPart > LastVbn)
-        {
-            RunIndex++;
-        }
-        LastVbn = Run->RunEndVbn.QuadPart;
-        RunIndex++;
-        RunFound = Run;
-    }
-
-    if (!RunFound)
+    /* The last run is always a real one */
+    if (!Mcb->PairCount)
     {
         return FALSE;
     }
 
+    RunFound = &McbRuns(Mcb)[Mcb->PairCount - 1];
+    ASSERT(!McbIsHole(RunFound));
+
     if (Vbn)
     {
         *Vbn = RunFound->RunEndVbn.QuadPart - 1;
     }
     if (Lbn)
     {
-        if (1)
-        {
-            *Lbn = RunFound->StartingLbn.QuadPart + (RunFound->RunEndVbn.QuadPart - RunFound->RunStartVbn.QuadPart) - 1;
-        }
-        else
-        {
-            *Lbn = ~0ULL;
-        }
+        *Lbn = RunFound->StartingLbn.QuadPart + McbRunLength(RunFound) - 1;
     }
     if (Index)
     {
-        *Index = RunIndex - 1;
+        *Index = Mcb->PairCount - 1;
     }
 
     return TRUE;
@@ -745,17 +676,13 @@ ULONG
 NTAPI
 FsRtlNumberOfRunsInBaseMcb(IN PBASE_MCB OpaqueMcb)
 {
-    ULONG NumberOfRuns = 0;
-    LONGLONG Vbn, Lbn, Count;
-    int i;
+    ULONG NumberOfRuns;
+    PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
 
     DPRINT("FsRtlNumberOfRunsInBaseMcb(%p)\n", OpaqueMcb);
 
-    // Count how many Mcb entries there are
-    for (i = 0; FsRtlGetNextBaseMcbEntry(OpaqueMcb, i, &Vbn, &Lbn, &Count); i++)
-    {
-        NumberOfRuns++;
-    }
+    // Holes are stored as runs too
+    NumberOfRuns = Mcb->PairCount;
 
     DPRINT("FsRtlNumberOfRunsInBaseMcb(%p) = %d\n", OpaqueMcb, NumberOfRuns);
     return NumberOfRuns;
@@ -801,8 +728,9 @@ FsRtlRemoveBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
                         IN LONGLONG SectorCount)
 {
     PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
-    LARGE_MCB_MAPPING_ENTRY NeedleRun;
-    PLARGE_MCB_MAPPING_ENTRY HaystackRun;
+    PLARGE_MCB_MAPPING_ENTRY Runs;
+    LONGLONG EndVbn;
+    ULONG First, Last;
     BOOLEAN Result = TRUE;
 
     DPRINT("FsRtlRemoveBaseMcbEntry(%p, %I64d, %I64d)\n", OpaqueMcb, Vbn, SectorCount);
@@ -819,35 +747,48 @@ FsRtlRemoveBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
         goto quit;
     }
 
-    NeedleRun.RunStartVbn.QuadPart = Vbn;
-    NeedleRun.RunEndVbn.QuadPart = Vbn + SectorCount;
-    NeedleRun.StartingLbn.QuadPart = ~0ULL;
+    /* nothing mapped there */
+    if (Vbn >= McbEndVbn(Mcb))
+        goto quit;
+    EndVbn = MIN(Vbn + SectorCount, McbEndVbn(Mcb));
 
-    /* adjust/destroy all intersecting ranges */
-    Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
-    while ((HaystackRun = RtlLookupElementGenericTable(&Mcb->Mapping->Table, &NeedleRun)))
+    if (!McbReserveRuns(Mcb, 2))
     {
-        if (HaystackRun->RunStartVbn.QuadPart < NeedleRun.RunStartVbn.QuadPart)
-        {
-            ASSERT(HaystackRun->RunEndVbn.QuadPart > NeedleRun.RunStartVbn.QuadPart);
-            HaystackRun->RunEndVbn.QuadPart = NeedleRun.RunStartVbn.QuadPart;
-        }
-        else if (HaystackRun->RunEndVbn.QuadPart > NeedleRun.RunEndVbn.QuadPart)
-        {
-            ASSERT(HaystackRun->RunStartVbn.QuadPart < NeedleRun.RunEndVbn.QuadPart);
-            HaystackRun->RunStartVbn.QuadPart = NeedleRun.RunEndVbn.QuadPart;
-        }
-        else
-        {
-            //ASSERT(NeedleRun.RunStartVbn.QuadPart >= HaystackRun->RunStartVbn.QuadPart);
-            //ASSERT(NeedleRun.RunEndVbn.QuadPart <= HaystackRun->RunEndVbn.QuadPart);
-            Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
-            RtlDeleteElementGenericTable(&Mcb->Mapping->Table, HaystackRun);
-            --Mcb->PairCount;
-            Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
-        }
+        Result = FALSE;
+        goto quit;
     }
-    Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
+
+    /* cut the runs crossing either end of the range */
+    Runs = McbRuns(Mcb);
+    First = McbFindRun(Mcb, Vbn);
+    if (Runs[First].RunStartVbn.QuadPart < Vbn)
+    {
+        McbSplitRun(Mcb, First, Vbn);
+        First++;
+    }
+    Last = McbFindRun(Mcb, EndVbn - 1);
+    if (Runs[Last].RunEndVbn.QuadPart > EndVbn)
+        McbSplitRun(Mcb, Last, EndVbn);
+
+    /* replace everything in between by a single hole */
+    Runs[First].RunEndVbn.QuadPart = EndVbn;
+    Runs[First].StartingLbn.QuadPart = -1;
+    McbDeleteRuns(Mcb, First + 1, Last - First);
+
+    /* holes never touch each other, and are never last */
+    if (First + 1 < Mcb->PairCount && McbIsHole(&Runs[First + 1]))
+    {
+        Runs[First].RunEndVbn = Runs[First + 1].RunEndVbn;
+        McbDeleteRuns(Mcb, First + 1, 1);
+    }
+    if (First > 0 && McbIsHole(&Runs[First - 1]))
+    {
+        Runs[First - 1].RunEndVbn = Runs[First].RunEndVbn;
+        McbDeleteRuns(Mcb, First, 1);
+        First--;
+    }
+    if (First == Mcb->PairCount - 1)
+        McbDeleteRuns(Mcb, First, 1);
 
 quit:
     DPRINT("FsRtlRemoveBaseMcbEntry(%p, %I64d, %I64d) = %d\n", OpaqueMcb, Vbn, SectorCount, Result);
@@ -878,18 +819,17 @@ NTAPI
 FsRtlResetBaseMcb(IN PBASE_MCB OpaqueMcb)
 {
     PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
-    PLARGE_MCB_MAPPING_ENTRY Element;
 
     DPRINT("FsRtlResetBaseMcb(%p)\n", OpaqueMcb);
 
-    while (RtlNumberGenericTableElements(&Mcb->Mapping->Table) &&
-           (Element = (PLARGE_MCB_MAPPING_ENTRY)RtlGetElementGenericTable(&Mcb->Mapping->Table, 0)))
+    if (McbRuns(Mcb) != Mcb->Mapping->InitialRuns)
     {
-        RtlDeleteElementGenericTable(&Mcb->Mapping->Table, Element);
+        ExFreePoolWithTag(McbRuns(Mcb), 'LMCB');
+        McbRuns(Mcb) = Mcb->Mapping->InitialRuns;
     }
 
     Mcb->PairCount = 0;
-    Mcb->MaximumPairCount = 0;
+    Mcb->MaximumPairCount = MAXIMUM_PAIR_COUNT;
 }
 
 /*
@@ -912,7 +852,7 @@ FsRtlResetLargeMcb(IN PLARGE_MCB Mcb,
 }
 
 /*
- * @unimplemented
+ * @implemented
  */
 BOOLEAN
 NTAPI
@@ -921,51 +861,61 @@ FsRtlSplitBaseMcb(IN PBASE_MCB OpaqueMcb,
                   IN LONGLONG Amount)
 {
     PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
-    PLARGE_MCB_MAPPING_ENTRY Run, InsertLowerRun = NULL, ExistingRun = NULL;
-    BOOLEAN NewElement;
+    PLARGE_MCB_MAPPING_ENTRY Runs;
+    ULONG Index, i;
 
     DPRINT("FsRtlSplitBaseMcb(%p, %I64d, %I64d)\n", OpaqueMcb, Vbn, Amount);
 
-    /* Traverse the tree */
-    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, TRUE);
-        Run;
-        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, FALSE))
+    /* nothing mapped after Vbn, nothing to shift */
+    if (Vbn >= McbEndVbn(Mcb))
+        goto quit;
+
+    if (!McbReserveRuns(Mcb, 2))
     {
-        /* unaffected run? */
-        /* FIXME: performance: effective skip of all 'lower' runs without traversing them */
-        if (Vbn >= Run->RunEndVbn.QuadPart) { DPRINT("Skipping it\n"); continue; }
-
-        /* crossing run to be split?
-        * 'lower_run' is created on the original place; just shortened.
-        * current 'run' is shifted up later
-        */
-        if (Vbn < Run->RunEndVbn.QuadPart)
-        {
-            /* FIXME: shift 'run->Lbn_start' ? */
-            Run->RunStartVbn.QuadPart = Vbn;
+        DPRINT("FsRtlSplitBaseMcb(%p, %I64d, %I64d) = %d\n", OpaqueMcb, Vbn, Amount, FALSE);
+        return FALSE;
+    }
 
-            InsertLowerRun = NULL;
+    Runs = McbRuns(Mcb);
+    Index = McbFindRun(Mcb, Vbn);
+    if (McbIsHole(&Runs[Index]))
+    {
+        /* a hole crossing Vbn just grows */
+        Runs[Index].RunEndVbn.QuadPart += Amount;
+        Index++;
+    }
+    else
+    {
+        /* a mapped run crossing Vbn is cut, its upper part moves up with the rest */
+        if (Runs[Index].RunStartVbn.QuadPart < Vbn)
+        {
+            McbSplitRun(Mcb, Index, Vbn);
+            Index++;
         }
 
-        /* Shift the current 'run'.
-        * Ordering is not changed in Generic Tree so I hope I do not need to reinsert it.
-        */
-        Run->RunStartVbn.QuadPart += Amount;
-        ASSERT(Run->RunEndVbn.QuadPart + Amount > Run->RunEndVbn.QuadPart); /* overflow? */
-        Run->RunEndVbn.QuadPart += Amount;
-        /* FIXME: shift 'run->Lbn_start' ? */
-
-        /* continue the traversal */
+        /* and the gap becomes a hole, joined with a preceding one */
+        if (Index > 0 && McbIsHole(&Runs[Index - 1]))
+        {
+            Runs[Index - 1].RunEndVbn.QuadPart += Amount;
+        }
+        else
+        {
+            McbInsertRuns(Mcb, Index, 1);
+            Runs[Index].RunStartVbn.QuadPart = Vbn;
+            Runs[Index].RunEndVbn.QuadPart = Vbn + Amount;
+            Runs[Index].StartingLbn.QuadPart = -1;
+            Index++;
+        }
     }
 
-    if (InsertLowerRun)
+    for (i = Index; i < Mcb->PairCount; i++)
     {
-        ExistingRun = RtlInsertElementGenericTable(&Mcb->Mapping->Table, InsertLowerRun, sizeof(*InsertLowerRun), &NewElement);
-        ++Mcb->PairCount;
+        ASSERT(Runs[i].RunEndVbn.QuadPart + Amount > Runs[i].RunEndVbn.QuadPart); /* overflow? */
+        Runs[i].RunStartVbn.QuadPart += Amount;
+        Runs[i].RunEndVbn.QuadPart += Amount;
     }
 
-    ASSERT(ExistingRun == NULL);
-
+quit:
     DPRINT("FsRtlSplitBaseMcb(%p, %I64d, %I64d) = %d\n", OpaqueMcb, Vbn, Amount, TRUE);
 
     return TRUE;
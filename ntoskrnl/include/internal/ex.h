@@ -14,6 +14,7 @@ extern ERESOURCE ExpFirmwareTableResource;
 extern LIST_ENTRY ExpFirmwareTableProviderListHead;
 extern BOOLEAN ExpIsWinPEMode;
 extern LIST_ENTRY ExpSystemResourcesList;
+extern ULONG ExpLockProfileFlags;
 extern ULONG ExpAnsiCodePageDataOffset, ExpOemCodePageDataOffset;
 extern ULONG ExpUnicodeCaseTableDataOffset;
 extern PVOID ExpNlsSectionPointer;
@@ -271,6 +272,39 @@ VOID
 NTAPI
 ExInitPoolLookasidePointers(VOID);
 
+/* Lock Profiling ************************************************************/
+
+NTSTATUS
+NTAPI
+ExQuerySystemLockInformation(
+    OUT PRTL_PROCESS_LOCKS LockInformation OPTIONAL,
+    IN ULONG LockInformationLength,
+    OUT PULONG ReturnLength
+);
+
+NTSTATUS
+NTAPI
+ExpSetLockProfiling(
+    IN ULONG Flags
+);
+
+NTSTATUS
+NTAPI
+ExpQueryLockProfile(
+    OUT PSYSTEM_LOCK_PROFILE_INFORMATION ProfileInformation OPTIONAL,
+    IN ULONG ProfileInformationLength,
+    OUT PULONG ReturnLength
+);
+
+VOID
+NTAPI
+ExpRecordLockWait(
+    IN PVOID Lock,
+    IN USHORT Type,
+    IN PVOID OwnerCaller OPTIONAL,
+    IN LONGLONG WaitStart
+);
+
 /* Callback Functions ********************************************************/
 
 VOID
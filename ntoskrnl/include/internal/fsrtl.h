@@ -120,6 +120,12 @@ FsRtlInitializeTunnels(
     VOID
 );
 
+VOID
+NTAPI
+FsRtlInitializeFileLocks(
+    VOID
+);
+
 //
 // File contexts Routines
 //
@@ -78,6 +78,16 @@ typedef struct _KNMI_HANDLER_CALLBACK
     PVOID Handle;
 } KNMI_HANDLER_CALLBACK, *PKNMI_HANDLER_CALLBACK;
 
+//
+// Per-processor, per-service system call statistics. Each service table gets
+// one array of Limit entries for every processor, indexed [Cpu * Limit + Id].
+//
+typedef struct _KSERVICE_STATISTICS
+{
+    ULONG Count;
+    ULONGLONG Cycles;
+} KSERVICE_STATISTICS, *PKSERVICE_STATISTICS;
+
 typedef PCHAR
 (NTAPI *PKE_BUGCHECK_UNICODE_TO_ANSI)(
     IN PUNICODE_STRING Unicode,
@@ -120,6 +130,10 @@ extern LARGE_INTEGER KiTimeIncrementReciprocal;
 extern UCHAR KiTimeIncrementShiftCount;
 extern ULONG KiTimeLimitIsrMicroseconds;
 extern ULONG KiServiceLimit;
+extern BOOLEAN KiSystemCallCountEnabled;
+extern PKSERVICE_STATISTICS KiServiceStatistics[NUMBER_SERVICE_TABLES];
+extern ULONG KiServiceStatisticsLimit[NUMBER_SERVICE_TABLES];
+extern ULONG KiServiceStatisticsProcessors;
 extern LIST_ENTRY KeBugcheckCallbackListHead, KeBugcheckReasonCallbackListHead;
 extern KSPIN_LOCK BugCheckCallbackLock;
 extern KDPC KiTimerExpireDpc;
@@ -722,6 +736,17 @@ NTAPI
 KeQueryValuesProcess(IN PKPROCESS Process,
                      PPROCESS_VALUES Values);
 
+NTSTATUS
+NTAPI
+KeEnableSystemCallCounts(IN BOOLEAN Enable);
+
+VOID
+NTAPI
+KeQuerySystemCallStatistics(IN ULONG TableIndex,
+                            IN ULONG Id,
+                            OUT PULONG Count,
+                            OUT PULONGLONG Cycles);
+
 /* INITIALIZATION FUNCTIONS *************************************************/
 
 BOOLEAN
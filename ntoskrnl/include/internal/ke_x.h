@@ -1677,6 +1677,31 @@ KiReleaseNmiListLock(IN KIRQL OldIrql)
     KeReleaseSpinLock(&KiNmiCallbackListLock, OldIrql);
 }
 
+//
+// Charges a system call to the current processor's slot. The slots are never
+// shared between processors, so no interlocked operation is needed; like
+// KeSystemCalls, a preemption in the middle can only lose a single update.
+//
+FORCEINLINE
+VOID
+KiIncreaseSystemCallCount(IN ULONG TableIndex,
+                          IN ULONG Id,
+                          IN ULONGLONG Cycles)
+{
+    PKSERVICE_STATISTICS Statistics;
+    ULONG Limit, Cpu;
+
+    /* Tables registered after counting was enabled have no counters */
+    Statistics = KiServiceStatistics[TableIndex];
+    Limit = KiServiceStatisticsLimit[TableIndex];
+    Cpu = KeGetCurrentPrcb()->Number;
+    if (!Statistics || (Id >= Limit) || (Cpu >= KiServiceStatisticsProcessors)) return;
+
+    Statistics += Cpu * Limit + Id;
+    Statistics->Count++;
+    Statistics->Cycles += Cycles;
+}
+
 #if defined(_M_IX86) || defined(_M_AMD64)
 FORCEINLINE
 VOID
@@ -59,6 +59,7 @@
 #define KeTryToAcquireGuardedMutex _KeTryToAcquireGuardedMutex
 
 #include "tag.h"
+#include "perfinfo.h"
 #include "ke.h"
 #include "ob.h"
 #include "mm.h"
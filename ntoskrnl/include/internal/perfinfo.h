@@ -0,0 +1,116 @@
+/*
+ * PROJECT:         ReactOS Kernel
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            ntoskrnl/include/internal/perfinfo.h
+ * PURPOSE:         Internal header for the Kernel Event Tracer
+ */
+
+#pragma once
+
+#include <reactos/perftrace.h>
+
+/* PERFTRACE_GROUP_* flags of the events being traced right now */
+extern ULONG PerfGlobalGroupMask;
+
+//
+// Trace Timestamps
+//
+FORCEINLINE
+ULONGLONG
+PerfInfoTimestamp(VOID)
+{
+#if defined(_M_IX86) || defined(_M_AMD64)
+    return __rdtsc();
+#else
+    return KeQueryInterruptTime();
+#endif
+}
+
+//
+// Trace Control
+//
+NTSTATUS
+NTAPI
+PerfInfoStartTrace(
+    IN ULONG Groups,
+    IN ULONG BufferSize
+);
+
+NTSTATUS
+NTAPI
+PerfInfoQueryTrace(
+    OUT PPERFTRACE_BUFFER_HEADER TraceBuffer,
+    IN ULONG Length,
+    OUT PULONG ReturnLength
+);
+
+//
+// Event Logging
+//
+VOID
+FASTCALL
+PerfInfoLogContextSwitch(
+    IN PKTHREAD OldThread,
+    IN PKTHREAD NewThread
+);
+
+VOID
+NTAPI
+PerfInfoLogPageFault(
+    IN PVOID Address,
+    IN ULONG FaultCode,
+    IN KPROCESSOR_MODE Mode,
+    IN NTSTATUS Status,
+    IN ULONGLONG StartTime
+);
+
+BOOLEAN
+NTAPI
+PerfInfoLogDiskIo(
+    IN PIRP Irp,
+    IN PIO_STACK_LOCATION StackPtr
+);
+
+VOID
+NTAPI
+PerfInfoLogRegistry(
+    IN USHORT Operation,
+    IN PVOID KeyControlBlock,
+    IN NTSTATUS Status,
+    IN ULONGLONG StartTime
+);
+
+VOID
+NTAPI
+PerfInfoLogProcess(
+    IN PEPROCESS Process,
+    IN BOOLEAN Create
+);
+
+VOID
+NTAPI
+PerfInfoLogThread(
+    IN PETHREAD Thread,
+    IN BOOLEAN Create,
+    IN NTSTATUS ExitStatus
+);
+
+//
+// Registry operations are timed by their caller
+//
+FORCEINLINE
+ULONGLONG
+PerfInfoStartRegistryOperation(VOID)
+{
+    return (PerfGlobalGroupMask & PERFTRACE_GROUP_REGISTRY) ? PerfInfoTimestamp() : 0;
+}
+
+FORCEINLINE
+VOID
+PerfInfoEndRegistryOperation(IN ULONGLONG StartTime,
+                             IN USHORT Operation,
+                             IN PVOID KeyControlBlock,
+                             IN NTSTATUS Status)
+{
+    if (StartTime) PerfInfoLogRegistry(Operation, KeyControlBlock, Status, StartTime);
+}
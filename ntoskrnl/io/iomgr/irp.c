@@ -1319,6 +1319,7 @@ IofCompleteRequest(IN PIRP Irp,
     ULONG Flags;
     NTSTATUS ErrorCode = STATUS_SUCCESS;
     PREPARSE_DATA_BUFFER DataBuffer = NULL;
+    BOOLEAN DiskIoLogged = FALSE;
     IOTRACE(IO_IRP_DEBUG,
             "%s - Completing IRP %p\n",
             __FUNCTION__,
@@ -1361,6 +1362,13 @@ IofCompleteRequest(IN PIRP Irp,
          Irp->CurrentLocation++,
          Irp->Tail.Overlay.CurrentStackLocation++)
     {
+        /* Check if disk transfers are being traced */
+        if ((PerfGlobalGroupMask & PERFTRACE_GROUP_DISK_IO) && !(DiskIoLogged))
+        {
+            /* Log the transfer if this is the disk's stack location */
+            DiskIoLogged = PerfInfoLogDiskIo(Irp, StackPtr);
+        }
+
         /* Set Pending Returned */
         Irp->PendingReturned = StackPtr->Control & SL_PENDING_RETURNED;
 
@@ -354,6 +354,12 @@ KiSystemCallHandler(
     /* Get descriptor table */
     DescriptorTable = (PVOID)((ULONG_PTR)Thread->ServiceTable + Offset);
 
+    /* The service is called from assembly, so only the call is counted */
+    if (KiSystemCallCountEnabled)
+    {
+        KiIncreaseSystemCallCount(Offset >> BITS_PER_ENTRY, ServiceNumber, 0);
+    }
+
     /* Get stack bytes and calculate argument count */
     Count = DescriptorTable->Number[ServiceNumber] / 8;
 
@@ -172,6 +172,13 @@ KiSwapContextResume(
     Pcr->ContextSwitches++;
     NewThread->ContextSwitches++;
 
+    /* Check if tracing is enabled */
+    if (PerfGlobalGroupMask & PERFTRACE_GROUP_CSWITCH)
+    {
+        /* Log the switch */
+        PerfInfoLogContextSwitch(OldThread, NewThread);
+    }
+
     /* DPCs shouldn't be active */
     if (Pcr->Prcb.DpcRoutineActive)
     {
@@ -422,19 +422,20 @@ KiSwapContextEntry(IN PKSWITCHFRAME SwitchFrame,
     SwitchFrame->ApcBypassDisable = OldThreadAndApcFlag & 3;
     SwitchFrame->ExceptionList = Pcr->NtTib.ExceptionList;
 
-    /* Increase context switch count and check if tracing is enabled */
+    /* Increase context switch count */
     Pcr->ContextSwitches++;
-    if (Pcr->PerfGlobalGroupMask)
-    {
-        /* We don't support this yet on x86 either */
-        DPRINT1("WMI Tracing not supported\n");
-        ASSERT(FALSE);
-    }
 
     /* Get thread pointers */
     OldThread = (PKTHREAD)(OldThreadAndApcFlag & ~3);
     NewThread = Pcr->PrcbData.CurrentThread;
 
+    /* Check if tracing is enabled */
+    if (PerfGlobalGroupMask & PERFTRACE_GROUP_CSWITCH)
+    {
+        /* Log the switch */
+        PerfInfoLogContextSwitch(OldThread, NewThread);
+    }
+
     /* Get the old thread and set its kernel stack */
     OldThread->KernelStack = SwitchFrame;
 
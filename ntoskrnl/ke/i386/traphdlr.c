@@ -1700,6 +1700,7 @@ KiSystemServiceHandler(IN PKTRAP_FRAME TrapFrame,
     ULONG Id, Offset, StackBytes;
     NTSTATUS Status;
     PVOID Handler;
+    ULONGLONG StartCycles;
     ULONG SystemCallNumber = TrapFrame->Eax;
 
     /* Get the current thread */
@@ -1792,9 +1793,6 @@ KiSystemServiceHandler(IN PKTRAP_FRAME TrapFrame,
     /* Increase system call count */
     KeGetCurrentPrcb()->KeSystemCalls++;
 
-    /* FIXME: Increase individual counts on debug systems */
-    //KiIncreaseSystemCallCount(DescriptorTable, Id);
-
     /* Get stack bytes */
     StackBytes = DescriptorTable->Number[Id];
 
@@ -1810,7 +1808,17 @@ KiSystemServiceHandler(IN PKTRAP_FRAME TrapFrame,
 
     /* Get the handler and make the system call */
     Handler = (PVOID)DescriptorTable->Base[Id];
-    Status = KiSystemCallTrampoline(Handler, Arguments, StackBytes);
+    if (__builtin_expect(KiSystemCallCountEnabled, 0))
+    {
+        /* Charge the call and the cycles it took to this service */
+        StartCycles = __rdtsc();
+        Status = KiSystemCallTrampoline(Handler, Arguments, StackBytes);
+        KiIncreaseSystemCallCount(Offset >> BITS_PER_ENTRY, Id, __rdtsc() - StartCycles);
+    }
+    else
+    {
+        Status = KiSystemCallTrampoline(Handler, Arguments, StackBytes);
+    }
 
     /* Call post-service debug hook */
     Status = KiDbgPostServiceHook(SystemCallNumber, Status);
@@ -0,0 +1,110 @@
+/*
+ * PROJECT:         ReactOS Kernel
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            ntoskrnl/ke/syscount.c
+ * PURPOSE:         Per-service system call counters
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <ntoskrnl.h>
+#define NDEBUG
+#include <debug.h>
+
+#define TAG_SERVICE_STATISTICS 'tSeK'
+
+/* GLOBALS *******************************************************************/
+
+BOOLEAN KiSystemCallCountEnabled;
+PKSERVICE_STATISTICS KiServiceStatistics[NUMBER_SERVICE_TABLES];
+ULONG KiServiceStatisticsLimit[NUMBER_SERVICE_TABLES];
+ULONG KiServiceStatisticsProcessors;
+
+/* FUNCTIONS *****************************************************************/
+
+/*
+ * Turns per-service counting on or off. The counter arrays are allocated the
+ * first time a table is counted and never freed, since a system call that
+ * sampled them may still be running on another processor; re-enabling just
+ * clears them.
+ */
+NTSTATUS
+NTAPI
+KeEnableSystemCallCounts(IN BOOLEAN Enable)
+{
+    PKSERVICE_STATISTICS Statistics;
+    ULONG i, Limit;
+    SIZE_T Size;
+
+    PAGED_CODE();
+
+    if (!Enable)
+    {
+        KiSystemCallCountEnabled = FALSE;
+        return STATUS_SUCCESS;
+    }
+
+    /* Processors don't come and go, so the first count sticks */
+    InterlockedCompareExchange((PLONG)&KiServiceStatisticsProcessors,
+                               KeNumberProcessors,
+                               0);
+
+    for (i = 0; i < NUMBER_SERVICE_TABLES; i++)
+    {
+        /* The shadow table is a superset of the regular one */
+        Limit = KeServiceDescriptorTableShadow[i].Limit;
+        if (!Limit) continue;
+
+        Size = (SIZE_T)Limit * KiServiceStatisticsProcessors * sizeof(KSERVICE_STATISTICS);
+        if (KiServiceStatistics[i])
+        {
+            RtlZeroMemory(KiServiceStatistics[i], Size);
+            continue;
+        }
+
+        Statistics = ExAllocatePoolWithTag(NonPagedPool, Size, TAG_SERVICE_STATISTICS);
+        if (!Statistics) return STATUS_INSUFFICIENT_RESOURCES;
+        RtlZeroMemory(Statistics, Size);
+
+        /* Publish the limit before the array that it describes */
+        KiServiceStatisticsLimit[i] = Limit;
+        if (InterlockedCompareExchangePointer((PVOID*)&KiServiceStatistics[i],
+                                              Statistics,
+                                              NULL))
+        {
+            /* Somebody else enabled counting at the same time */
+            ExFreePoolWithTag(Statistics, TAG_SERVICE_STATISTICS);
+        }
+    }
+
+    KiSystemCallCountEnabled = TRUE;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+KeQuerySystemCallStatistics(IN ULONG TableIndex,
+                            IN ULONG Id,
+                            OUT PULONG Count,
+                            OUT PULONGLONG Cycles)
+{
+    PKSERVICE_STATISTICS Statistics;
+    ULONG Cpu, Limit;
+
+    *Count = 0;
+    *Cycles = 0;
+
+    if (TableIndex >= NUMBER_SERVICE_TABLES) return;
+    Statistics = KiServiceStatistics[TableIndex];
+    Limit = KiServiceStatisticsLimit[TableIndex];
+    if (!Statistics || (Id >= Limit)) return;
+
+    /* Sum up every processor's slot */
+    for (Cpu = 0; Cpu < KiServiceStatisticsProcessors; Cpu++)
+    {
+        *Count += Statistics[Cpu * Limit + Id].Count;
+        *Cycles += Statistics[Cpu * Limit + Id].Cycles;
+    }
+}
+
+/* EOF */
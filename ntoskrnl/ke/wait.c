@@ -106,15 +106,23 @@ VOID
 FASTCALL
 KiAcquireFastMutex(IN PFAST_MUTEX FastMutex)
 {
+    LONGLONG WaitStart;
+
     /* Increase contention count */
     FastMutex->Contention++;
 
+    /* Sample the wait if fast mutexes are being profiled */
+    WaitStart = (ExpLockProfileFlags & LOCK_PROFILE_FAST_MUTEXES) ?
+                KeQueryPerformanceCounter(NULL).QuadPart : 0;
+
     /* Wait for the event */
     KeWaitForSingleObject(&FastMutex->Event,
                           WrMutex,
                           KernelMode,
                           FALSE,
                           NULL);
+
+    if (WaitStart) ExpRecordLockWait(FastMutex, LOCK_PROFILE_TYPE_FAST_MUTEX, NULL, WaitStart);
 }
 
 VOID
@@ -199,12 +199,12 @@ MmNotPresentFault(KPROCESSOR_MODE Mode,
 
 extern BOOLEAN Mmi386MakeKernelPageTableGlobal(PVOID Address);
 
+static
 NTSTATUS
-NTAPI
-MmAccessFault(IN ULONG FaultCode,
-              IN PVOID Address,
-              IN KPROCESSOR_MODE Mode,
-              IN PVOID TrapInformation)
+MiDispatchAccessFault(IN ULONG FaultCode,
+                      IN PVOID Address,
+                      IN KPROCESSOR_MODE Mode,
+                      IN PVOID TrapInformation)
 {
     PMEMORY_AREA MemoryArea = NULL;
 
@@ -264,3 +264,27 @@ MmAccessFault(IN ULONG FaultCode,
     }
 }
 
+NTSTATUS
+NTAPI
+MmAccessFault(IN ULONG FaultCode,
+              IN PVOID Address,
+              IN KPROCESSOR_MODE Mode,
+              IN PVOID TrapInformation)
+{
+    ULONGLONG StartTime;
+    NTSTATUS Status;
+
+    /* Check if tracing is enabled */
+    if (!(PerfGlobalGroupMask & PERFTRACE_GROUP_PAGE_FAULT))
+    {
+        /* It isn't, just handle the fault */
+        return MiDispatchAccessFault(FaultCode, Address, Mode, TrapInformation);
+    }
+
+    /* Time the fault and log it */
+    StartTime = PerfInfoTimestamp();
+    Status = MiDispatchAccessFault(FaultCode, Address, Mode, TrapInformation);
+    PerfInfoLogPageFault(Address, FaultCode, Mode, Status, StartTime);
+    return Status;
+}
+
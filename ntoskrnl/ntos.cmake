@@ -87,6 +87,7 @@ list(APPEND SOURCE
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/interlocked.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/keyedevt.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/locale.c
+    ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/lockprof.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/lookas.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/mutant.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/profile.c
@@ -180,6 +181,7 @@ list(APPEND SOURCE
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/queue.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/semphobj.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/spinlock.c
+    ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/syscount.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/thrdobj.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/thrdschd.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/time.c
@@ -269,6 +271,7 @@ list(APPEND SOURCE
     ${REACTOS_SOURCE_DIR}/ntoskrnl/se/token.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/vf/driver.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/wmi/guidobj.c
+    ${REACTOS_SOURCE_DIR}/ntoskrnl/wmi/perfinfo.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/wmi/smbios.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/wmi/wmi.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/wmi/wmidrv.c)
@@ -511,7 +511,11 @@ PspExitThread(IN NTSTATUS ExitStatus)
     PopCleanupPowerState((PPOWER_STATE)&Thread->Tcb.PowerState);
 
     /* Call the WMI Callback for Threads */
-    //WmiTraceThread(Thread, NULL, FALSE);
+    if (PerfGlobalGroupMask & PERFTRACE_GROUP_PROCESS)
+    {
+        /* Log the thread exit */
+        PerfInfoLogThread(Thread, FALSE, ExitStatus);
+    }
 
     /* Run Thread Notify Routines before we desintegrate the thread */
     PspRunCreateThreadNotifyRoutines(Thread, FALSE);
@@ -1087,7 +1091,11 @@ PspExitProcess(IN BOOLEAN LastThread,
     if (LastThread)
     {
         /* Notify the WMI Process Callback */
-        //WmiTraceProcess(Process, FALSE);
+        if (PerfGlobalGroupMask & PERFTRACE_GROUP_PROCESS)
+        {
+            /* Log the process exit */
+            PerfInfoLogProcess(Process, FALSE);
+        }
 
         /* Run the Notification Routines */
         PspRunCreateProcessNotifyRoutines(Process, FALSE);
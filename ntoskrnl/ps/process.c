@@ -866,6 +866,13 @@ PspCreateProcess(OUT PHANDLE ProcessHandle,
     }
     _SEH2_END;
 
+    /* Notify WMI */
+    if (PerfGlobalGroupMask & PERFTRACE_GROUP_PROCESS)
+    {
+        /* Log the new process */
+        PerfInfoLogProcess(Process, TRUE);
+    }
+
     /* Run the Notification Routines */
     PspRunCreateProcessNotifyRoutines(Process, TRUE);
 
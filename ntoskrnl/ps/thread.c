@@ -406,8 +406,11 @@ PspCreateThread(OUT PHANDLE ThreadHandle,
     ExReleaseRundownProtection(&Process->RundownProtect);
 
     /* Notify WMI */
-    //WmiTraceProcess(Process, TRUE);
-    //WmiTraceThread(Thread, InitialTeb, TRUE);
+    if (PerfGlobalGroupMask & PERFTRACE_GROUP_PROCESS)
+    {
+        /* Log the new thread */
+        PerfInfoLogThread(Thread, TRUE, STATUS_SUCCESS);
+    }
 
     /* Notify Thread Creation */
     PspRunCreateThreadNotifyRoutines(Thread, TRUE);
@@ -0,0 +1,391 @@
+/*
+ * PROJECT:         ReactOS Kernel
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            ntoskrnl/wmi/perfinfo.c
+ * PURPOSE:         Kernel Event Tracer
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <ntoskrnl.h>
+#define NDEBUG
+#include <debug.h>
+
+#define TAG_PERF_TRACE 'rTfP'
+
+/*
+ * One ring per processor. Head and Tail are free running byte counts, the
+ * record at Tail is found at Tail & (Size - 1). Writers claim space by moving
+ * Head forward and never wait: when the ring is full the event is dropped.
+ */
+typedef struct _PERFINFO_TRACE_BUFFER
+{
+    volatile LONG Head;
+    volatile LONG Tail;
+    volatile LONG EventsLost;
+    ULONG Size;
+    UCHAR Data[ANYSIZE_ARRAY];
+} PERFINFO_TRACE_BUFFER, *PPERFINFO_TRACE_BUFFER;
+
+/* GLOBALS *******************************************************************/
+
+ULONG PerfGlobalGroupMask;
+static PPERFINFO_TRACE_BUFFER PerfInfoBuffers[MAXIMUM_PROCESSORS];
+static ULONGLONG PerfInfoFrequency;
+static KSPIN_LOCK PerfInfoReaderLock;
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+static
+PVOID
+PerfInfoReserveEvent(IN USHORT Size)
+{
+    PPERFINFO_TRACE_BUFFER Buffer;
+    PPERFTRACE_EVENT_HEADER Header;
+    ULONG Processor, Head, Tail, Offset, Padding;
+
+    /*
+     * Moving to another processor from here on only costs a little ordering
+     * inside the ring, the timestamp is taken once the space is ours.
+     */
+    Processor = KeGetCurrentProcessorNumber();
+    Buffer = PerfInfoBuffers[Processor];
+    if (!Buffer) return NULL;
+
+    for (;;)
+    {
+        Head = Buffer->Head;
+        Tail = Buffer->Tail;
+
+        /* Records don't wrap, a padding record fills the end of the ring */
+        Offset = Head & (Buffer->Size - 1);
+        Padding = (Buffer->Size - Offset < Size) ? Buffer->Size - Offset : 0;
+        if (Head + Padding + Size - Tail > Buffer->Size)
+        {
+            InterlockedIncrement(&Buffer->EventsLost);
+            return NULL;
+        }
+
+        if ((ULONG)InterlockedCompareExchange(&Buffer->Head,
+                                              Head + Padding + Size,
+                                              Head) == Head)
+        {
+            break;
+        }
+    }
+
+    if (Padding)
+    {
+        InterlockedExchange((PLONG)&Buffer->Data[Offset],
+                            Padding | (PERFTRACE_EVENT_PADDING << 16));
+        Offset = 0;
+    }
+
+    /* The reader zeroes what it consumes, so only the header needs filling */
+    Header = (PPERFTRACE_EVENT_HEADER)&Buffer->Data[Offset];
+    Header->Processor = (USHORT)Processor;
+    Header->Timestamp = PerfInfoTimestamp();
+    return Header;
+}
+
+static
+VOID
+PerfInfoCommitEvent(IN PVOID Event,
+                    IN USHORT Size,
+                    IN USHORT Type)
+{
+    /* Size and Type go in last and in one go, this publishes the record */
+    InterlockedExchange((PLONG)Event, Size | (Type << 16));
+}
+
+/* FUNCTIONS *****************************************************************/
+
+/*
+ * Starts tracing the given PERFTRACE_GROUP_* events, or stops if Groups is
+ * zero. Each processor gets its ring the first time tracing starts; the rings
+ * are never freed, since a writer may still be using them when tracing stops,
+ * so a different BufferSize on a later start is ignored.
+ */
+NTSTATUS
+NTAPI
+PerfInfoStartTrace(IN ULONG Groups,
+                   IN ULONG BufferSize)
+{
+    PPERFINFO_TRACE_BUFFER Buffer;
+    ULONG i, Size;
+
+    PAGED_CODE();
+
+    Groups &= PERFTRACE_GROUP_ALL;
+    if (!Groups)
+    {
+        PerfGlobalGroupMask = 0;
+        return STATUS_SUCCESS;
+    }
+
+    /* Round up to a power of two so the ring offsets are a simple mask */
+    if (!BufferSize) BufferSize = PERFTRACE_DEFAULT_BUFFER_SIZE;
+    BufferSize = max(BufferSize, PERFTRACE_MIN_BUFFER_SIZE);
+    BufferSize = min(BufferSize, PERFTRACE_MAX_BUFFER_SIZE);
+    for (Size = PERFTRACE_MIN_BUFFER_SIZE; Size < BufferSize; Size <<= 1);
+
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++)
+    {
+        if (PerfInfoBuffers[i]) continue;
+
+        Buffer = ExAllocatePoolWithTag(NonPagedPool,
+                                       FIELD_OFFSET(PERFINFO_TRACE_BUFFER, Data[Size]),
+                                       TAG_PERF_TRACE);
+        if (!Buffer) return STATUS_INSUFFICIENT_RESOURCES;
+        RtlZeroMemory(Buffer, FIELD_OFFSET(PERFINFO_TRACE_BUFFER, Data[Size]));
+        Buffer->Size = Size;
+
+        if (InterlockedCompareExchangePointer((PVOID*)&PerfInfoBuffers[i],
+                                              Buffer,
+                                              NULL))
+        {
+            /* Somebody else started tracing at the same time */
+            ExFreePoolWithTag(Buffer, TAG_PERF_TRACE);
+        }
+    }
+
+#if defined(_M_IX86) || defined(_M_AMD64)
+    /* Timestamps are in processor cycles */
+    PerfInfoFrequency = (ULONGLONG)KeGetCurrentPrcb()->MHz * 1000000;
+#else
+    /* Timestamps are in interrupt time, 100ns units */
+    PerfInfoFrequency = 10000000;
+#endif
+
+    PerfGlobalGroupMask = Groups;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * Moves as many whole records as fit out of the rings into a locked down
+ * buffer, freeing their space for new events. Every processor's records come
+ * out in order, one processor after the other.
+ */
+NTSTATUS
+NTAPI
+PerfInfoQueryTrace(OUT PPERFTRACE_BUFFER_HEADER TraceBuffer,
+                   IN ULONG Length,
+                   OUT PULONG ReturnLength)
+{
+    PPERFINFO_TRACE_BUFFER Buffer;
+    PUCHAR Record, Output;
+    ULONG i, Head, Tail, Word, RecordSize, Copied = 0, Lost = 0;
+    KIRQL OldIrql;
+
+    if (Length < sizeof(PERFTRACE_BUFFER_HEADER))
+    {
+        *ReturnLength = sizeof(PERFTRACE_BUFFER_HEADER);
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    Output = (PUCHAR)(TraceBuffer + 1);
+    Length -= sizeof(PERFTRACE_BUFFER_HEADER);
+
+    KeAcquireSpinLock(&PerfInfoReaderLock, &OldIrql);
+
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++)
+    {
+        Buffer = PerfInfoBuffers[i];
+        if (!Buffer) continue;
+
+        Lost += InterlockedExchange(&Buffer->EventsLost, 0);
+        Tail = Buffer->Tail;
+        Head = Buffer->Head;
+        while (Tail != Head)
+        {
+            /* Stop at the first record whose writer isn't done yet */
+            Record = &Buffer->Data[Tail & (Buffer->Size - 1)];
+            Word = *(volatile ULONG*)Record;
+            if (!Word) break;
+            KeMemoryBarrier();
+
+            RecordSize = Word & 0xFFFF;
+            if ((Word >> 16) != PERFTRACE_EVENT_PADDING)
+            {
+                if (RecordSize > Length - Copied) break;
+                RtlCopyMemory(Output + Copied, Record, RecordSize);
+                Copied += RecordSize;
+            }
+
+            RtlZeroMemory(Record, RecordSize);
+            Tail += RecordSize;
+        }
+
+        /* Hand the space back only once it has been cleared */
+        KeMemoryBarrier();
+        InterlockedExchange(&Buffer->Tail, Tail);
+    }
+
+    KeReleaseSpinLock(&PerfInfoReaderLock, OldIrql);
+
+    TraceBuffer->Magic = PERFTRACE_MAGIC;
+    TraceBuffer->Version = PERFTRACE_VERSION;
+    TraceBuffer->NumberOfProcessors = (USHORT)KeNumberProcessors;
+    TraceBuffer->Groups = PerfGlobalGroupMask;
+    TraceBuffer->DataLength = Copied;
+    TraceBuffer->TimestampFrequency = PerfInfoFrequency;
+    TraceBuffer->EventsLost = Lost;
+    TraceBuffer->Reserved = 0;
+
+    *ReturnLength = sizeof(PERFTRACE_BUFFER_HEADER) + Copied;
+    return STATUS_SUCCESS;
+}
+
+VOID
+FASTCALL
+PerfInfoLogContextSwitch(IN PKTHREAD OldThread,
+                         IN PKTHREAD NewThread)
+{
+    PPERFTRACE_CSWITCH_EVENT Event;
+
+    Event = PerfInfoReserveEvent(sizeof(PERFTRACE_CSWITCH_EVENT));
+    if (!Event) return;
+
+    Event->OldThreadId = HandleToUlong(((PETHREAD)OldThread)->Cid.UniqueThread);
+    Event->OldProcessId = HandleToUlong(((PETHREAD)OldThread)->Cid.UniqueProcess);
+    Event->NewThreadId = HandleToUlong(((PETHREAD)NewThread)->Cid.UniqueThread);
+    Event->NewProcessId = HandleToUlong(((PETHREAD)NewThread)->Cid.UniqueProcess);
+    Event->OldThreadState = OldThread->State;
+    Event->OldWaitReason = OldThread->WaitReason;
+    Event->OldPriority = OldThread->Priority;
+    Event->NewPriority = NewThread->Priority;
+
+    PerfInfoCommitEvent(Event, sizeof(PERFTRACE_CSWITCH_EVENT), PERFTRACE_EVENT_CSWITCH);
+}
+
+VOID
+NTAPI
+PerfInfoLogPageFault(IN PVOID Address,
+                     IN ULONG FaultCode,
+                     IN KPROCESSOR_MODE Mode,
+                     IN NTSTATUS Status,
+                     IN ULONGLONG StartTime)
+{
+    PPERFTRACE_PAGE_FAULT_EVENT Event;
+
+    Event = PerfInfoReserveEvent(sizeof(PERFTRACE_PAGE_FAULT_EVENT));
+    if (!Event) return;
+
+    Event->Address = (ULONG_PTR)Address;
+    Event->Duration = Event->Header.Timestamp - StartTime;
+    Event->Status = Status;
+    Event->FaultCode = FaultCode;
+    Event->ThreadId = HandleToUlong(PsGetCurrentThreadId());
+    Event->Mode = Mode;
+
+    PerfInfoCommitEvent(Event, sizeof(PERFTRACE_PAGE_FAULT_EVENT), PERFTRACE_EVENT_PAGE_FAULT);
+}
+
+/*
+ * Called for each stack location as an IRP completes; logs the disk driver's
+ * read or write and returns TRUE, so that the stack location of a partition
+ * sitting on the same disk doesn't log the transfer a second time.
+ */
+BOOLEAN
+NTAPI
+PerfInfoLogDiskIo(IN PIRP Irp,
+                  IN PIO_STACK_LOCATION StackPtr)
+{
+    PPERFTRACE_DISK_IO_EVENT Event;
+
+    if (!(StackPtr->DeviceObject) ||
+        (StackPtr->DeviceObject->DeviceType != FILE_DEVICE_DISK) ||
+        ((StackPtr->MajorFunction != IRP_MJ_READ) &&
+         (StackPtr->MajorFunction != IRP_MJ_WRITE)))
+    {
+        return FALSE;
+    }
+
+    Event = PerfInfoReserveEvent(sizeof(PERFTRACE_DISK_IO_EVENT));
+    if (!Event) return TRUE;
+
+    /* Read and write parameters share the same layout */
+    Event->DeviceObject = (ULONG_PTR)StackPtr->DeviceObject;
+    Event->FileObject = (ULONG_PTR)StackPtr->FileObject;
+    Event->Irp = (ULONG_PTR)Irp;
+    Event->ByteOffset = StackPtr->Parameters.Read.ByteOffset.QuadPart;
+    Event->Length = StackPtr->Parameters.Read.Length;
+    Event->Status = Irp->IoStatus.Status;
+    Event->Information = (ULONG)Irp->IoStatus.Information;
+    Event->IrpFlags = Irp->Flags;
+    Event->ThreadId = Irp->Tail.Overlay.Thread ?
+                      HandleToUlong(Irp->Tail.Overlay.Thread->Cid.UniqueThread) : 0;
+    Event->MajorFunction = StackPtr->MajorFunction;
+
+    PerfInfoCommitEvent(Event, sizeof(PERFTRACE_DISK_IO_EVENT), PERFTRACE_EVENT_DISK_IO);
+    return TRUE;
+}
+
+VOID
+NTAPI
+PerfInfoLogRegistry(IN USHORT Operation,
+                    IN PVOID KeyControlBlock,
+                    IN NTSTATUS Status,
+                    IN ULONGLONG StartTime)
+{
+    PPERFTRACE_REGISTRY_EVENT Event;
+
+    Event = PerfInfoReserveEvent(sizeof(PERFTRACE_REGISTRY_EVENT));
+    if (!Event) return;
+
+    Event->KeyControlBlock = (ULONG_PTR)KeyControlBlock;
+    Event->Duration = Event->Header.Timestamp - StartTime;
+    Event->Status = Status;
+    Event->Operation = Operation;
+    Event->ThreadId = HandleToUlong(PsGetCurrentThreadId());
+    Event->ProcessId = HandleToUlong(PsGetCurrentProcessId());
+
+    PerfInfoCommitEvent(Event, sizeof(PERFTRACE_REGISTRY_EVENT), PERFTRACE_EVENT_REGISTRY);
+}
+
+VOID
+NTAPI
+PerfInfoLogProcess(IN PEPROCESS Process,
+                   IN BOOLEAN Create)
+{
+    PPERFTRACE_PROCESS_EVENT Event;
+
+    Event = PerfInfoReserveEvent(sizeof(PERFTRACE_PROCESS_EVENT));
+    if (!Event) return;
+
+    Event->ProcessId = HandleToUlong(Process->UniqueProcessId);
+    Event->ParentId = HandleToUlong(Process->InheritedFromUniqueProcessId);
+    Event->ExitStatus = Create ? STATUS_SUCCESS : Process->ExitStatus;
+    RtlCopyMemory(Event->ImageFileName, Process->ImageFileName, sizeof(Event->ImageFileName));
+
+    PerfInfoCommitEvent(Event,
+                        sizeof(PERFTRACE_PROCESS_EVENT),
+                        Create ? PERFTRACE_EVENT_PROCESS_CREATE : PERFTRACE_EVENT_PROCESS_EXIT);
+}
+
+VOID
+NTAPI
+PerfInfoLogThread(IN PETHREAD Thread,
+                  IN BOOLEAN Create,
+                  IN NTSTATUS ExitStatus)
+{
+    PPERFTRACE_THREAD_EVENT Event;
+
+    Event = PerfInfoReserveEvent(sizeof(PERFTRACE_THREAD_EVENT));
+    if (!Event) return;
+
+    Event->ThreadId = HandleToUlong(Thread->Cid.UniqueThread);
+    Event->ProcessId = HandleToUlong(Thread->Cid.UniqueProcess);
+    Event->ExitStatus = ExitStatus;
+
+    /* User threads record where the caller asked them to start */
+    Event->StartAddress = Thread->Win32StartAddress ?
+                          (ULONG_PTR)Thread->Win32StartAddress :
+                          (ULONG_PTR)Thread->StartAddress;
+
+    PerfInfoCommitEvent(Event,
+                        sizeof(PERFTRACE_THREAD_EVENT),
+                        Create ? PERFTRACE_EVENT_THREAD_CREATE : PERFTRACE_EVENT_THREAD_EXIT);
+}
+
+/* EOF */
@@ -974,6 +974,46 @@ typedef struct _SYSTEM_CALL_TIME_INFORMATION
 // Class 11 - See RTL_PROCESS_MODULES
 
 // Class 12 - See RTL_PROCESS_LOCKS
+//
+// When lock profiling has been enabled by setting this class, ReactOS
+// appends a SYSTEM_LOCK_PROFILE_INFORMATION block, 8-byte aligned, right
+// after the last RTL_PROCESS_LOCK_INFORMATION entry. Wait times are in
+// microseconds and Histogram[i] counts the waits that took less than
+// 2^(i+1) us, the last bucket taking everything longer.
+//
+#define LOCK_PROFILE_RESOURCES                              0x01
+#define LOCK_PROFILE_PUSH_LOCKS                             0x02
+#define LOCK_PROFILE_FAST_MUTEXES                           0x04
+#define LOCK_PROFILE_ALL                                    0x07
+
+#define LOCK_PROFILE_TYPE_PUSH_LOCK                         2
+#define LOCK_PROFILE_TYPE_FAST_MUTEX                        3
+
+#define LOCK_PROFILE_SIGNATURE                              'forP'
+#define LOCK_PROFILE_BUCKETS                                20
+#define LOCK_PROFILE_CALLERS                                4
+
+typedef struct _SYSTEM_LOCK_PROFILE_ENTRY
+{
+    PVOID Address;
+    USHORT Type;
+    USHORT Reserved;
+    ULONG Waits;
+    ULONGLONG TotalWaitTime;
+    ULONGLONG MaxWaitTime;
+    ULONG Histogram[LOCK_PROFILE_BUCKETS];
+    PVOID OwnerCallers[LOCK_PROFILE_CALLERS];
+    ULONG OwnerCallerHits[LOCK_PROFILE_CALLERS];
+} SYSTEM_LOCK_PROFILE_ENTRY, *PSYSTEM_LOCK_PROFILE_ENTRY;
+
+typedef struct _SYSTEM_LOCK_PROFILE_INFORMATION
+{
+    ULONG Signature;
+    ULONG Flags;
+    ULONG NumberOfEntries;
+    ULONG DroppedWaits;
+    SYSTEM_LOCK_PROFILE_ENTRY Entries[1];
+} SYSTEM_LOCK_PROFILE_INFORMATION, *PSYSTEM_LOCK_PROFILE_INFORMATION;
 
 // Class 13 - See RTL_PROCESS_BACKTRACES
 
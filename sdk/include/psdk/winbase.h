@@ -205,6 +205,7 @@ extern "C" {
 #define COPY_FILE_FAIL_IF_EXISTS 0x00000001
 #define COPY_FILE_RESTARTABLE 0x00000002
 #define COPY_FILE_OPEN_SOURCE_FOR_WRITE 0x00000004
+#define COPY_FILE_NO_BUFFERING 0x00001000
 #define FILE_FLAG_WRITE_THROUGH	0x80000000
 #define FILE_FLAG_OVERLAPPED	1073741824
 #define FILE_FLAG_NO_BUFFERING	536870912
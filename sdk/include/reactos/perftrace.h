@@ -0,0 +1,176 @@
+/*
+ * PROJECT:         ReactOS Kernel
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            sdk/include/reactos/perftrace.h
+ * PURPOSE:         Binary format of the kernel event trace
+ *
+ * The same records come out of the kernel, get written to disk by ktrace and
+ * are read back on the build host by ktrdump, so everything here has a fixed
+ * size and pointers are always stored as 64-bit values.
+ */
+
+#ifndef REACTOS_PERFTRACE_H_INCLUDED
+#define REACTOS_PERFTRACE_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PERFTRACE_MAGIC                 0x6372544B /* "KTrc" */
+#define PERFTRACE_VERSION               1
+
+/* Event groups, passed in PERFTRACE_CONTROL.Groups */
+#define PERFTRACE_GROUP_CSWITCH         0x01
+#define PERFTRACE_GROUP_PAGE_FAULT      0x02
+#define PERFTRACE_GROUP_DISK_IO         0x04
+#define PERFTRACE_GROUP_REGISTRY        0x08
+#define PERFTRACE_GROUP_PROCESS         0x10
+#define PERFTRACE_GROUP_ALL             0x1F
+
+/* Size of each processor's buffer when none is asked for, and the bounds */
+#define PERFTRACE_DEFAULT_BUFFER_SIZE   (256 * 1024)
+#define PERFTRACE_MIN_BUFFER_SIZE       (16 * 1024)
+#define PERFTRACE_MAX_BUFFER_SIZE       (16 * 1024 * 1024)
+
+/* Event types */
+#define PERFTRACE_EVENT_PADDING         0
+#define PERFTRACE_EVENT_CSWITCH         1
+#define PERFTRACE_EVENT_PAGE_FAULT      2
+#define PERFTRACE_EVENT_DISK_IO         3
+#define PERFTRACE_EVENT_REGISTRY        4
+#define PERFTRACE_EVENT_PROCESS_CREATE  5
+#define PERFTRACE_EVENT_PROCESS_EXIT    6
+#define PERFTRACE_EVENT_THREAD_CREATE   7
+#define PERFTRACE_EVENT_THREAD_EXIT     8
+#define PERFTRACE_EVENT_MAX             9
+
+/* Registry operations */
+#define PERFTRACE_REG_QUERY_KEY         0
+#define PERFTRACE_REG_ENUMERATE_KEY     1
+#define PERFTRACE_REG_DELETE_KEY        2
+#define PERFTRACE_REG_QUERY_VALUE       3
+#define PERFTRACE_REG_ENUMERATE_VALUE   4
+#define PERFTRACE_REG_SET_VALUE         5
+#define PERFTRACE_REG_DELETE_VALUE      6
+
+/*
+ * Every record starts with this header and is a multiple of 8 bytes long.
+ * Size and Type share the first ULONG, which the kernel writes last: a zero
+ * there means the record is still being filled in.
+ */
+typedef struct _PERFTRACE_EVENT_HEADER
+{
+    USHORT Size;
+    USHORT Type;
+    USHORT Processor;
+    USHORT Reserved;
+    ULONGLONG Timestamp;
+} PERFTRACE_EVENT_HEADER, *PPERFTRACE_EVENT_HEADER;
+
+typedef struct _PERFTRACE_CSWITCH_EVENT
+{
+    PERFTRACE_EVENT_HEADER Header;
+    ULONG OldThreadId;
+    ULONG OldProcessId;
+    ULONG NewThreadId;
+    ULONG NewProcessId;
+    UCHAR OldThreadState;
+    UCHAR OldWaitReason;
+    CHAR OldPriority;
+    CHAR NewPriority;
+    ULONG Reserved;
+} PERFTRACE_CSWITCH_EVENT, *PPERFTRACE_CSWITCH_EVENT;
+
+typedef struct _PERFTRACE_PAGE_FAULT_EVENT
+{
+    PERFTRACE_EVENT_HEADER Header;
+    ULONGLONG Address;
+    ULONGLONG Duration;
+    LONG Status;
+    ULONG FaultCode;
+    ULONG ThreadId;
+    UCHAR Mode;
+    UCHAR Reserved[3];
+} PERFTRACE_PAGE_FAULT_EVENT, *PPERFTRACE_PAGE_FAULT_EVENT;
+
+typedef struct _PERFTRACE_DISK_IO_EVENT
+{
+    PERFTRACE_EVENT_HEADER Header;
+    ULONGLONG DeviceObject;
+    ULONGLONG FileObject;
+    ULONGLONG Irp;
+    ULONGLONG ByteOffset;
+    ULONG Length;
+    LONG Status;
+    ULONG Information;
+    ULONG IrpFlags;
+    ULONG ThreadId;
+    UCHAR MajorFunction;
+    UCHAR Reserved[3];
+} PERFTRACE_DISK_IO_EVENT, *PPERFTRACE_DISK_IO_EVENT;
+
+typedef struct _PERFTRACE_REGISTRY_EVENT
+{
+    PERFTRACE_EVENT_HEADER Header;
+    ULONGLONG KeyControlBlock;
+    ULONGLONG Duration;
+    LONG Status;
+    USHORT Operation;
+    USHORT Reserved;
+    ULONG ThreadId;
+    ULONG ProcessId;
+} PERFTRACE_REGISTRY_EVENT, *PPERFTRACE_REGISTRY_EVENT;
+
+typedef struct _PERFTRACE_PROCESS_EVENT
+{
+    PERFTRACE_EVENT_HEADER Header;
+    ULONG ProcessId;
+    ULONG ParentId;
+    LONG ExitStatus;
+    ULONG Reserved;
+    CHAR ImageFileName[16];
+} PERFTRACE_PROCESS_EVENT, *PPERFTRACE_PROCESS_EVENT;
+
+typedef struct _PERFTRACE_THREAD_EVENT
+{
+    PERFTRACE_EVENT_HEADER Header;
+    ULONG ThreadId;
+    ULONG ProcessId;
+    LONG ExitStatus;
+    ULONG Reserved;
+    ULONGLONG StartAddress;
+} PERFTRACE_THREAD_EVENT, *PPERFTRACE_THREAD_EVENT;
+
+/*
+ * NtSetSystemInformation(SystemPerformanceTraceInformation) input. Groups
+ * selects what to trace, zero stops tracing. BufferSize is the size of each
+ * processor's buffer; it only counts the first time tracing is started.
+ */
+typedef struct _PERFTRACE_CONTROL
+{
+    ULONG Groups;
+    ULONG BufferSize;
+} PERFTRACE_CONTROL, *PPERFTRACE_CONTROL;
+
+/*
+ * NtQuerySystemInformation(SystemPerformanceTraceInformation) output, and the
+ * unit ktrace appends to its trace file. DataLength bytes of records follow;
+ * records of one processor are in order, but processors are not interleaved.
+ */
+typedef struct _PERFTRACE_BUFFER_HEADER
+{
+    ULONG Magic;
+    USHORT Version;
+    USHORT NumberOfProcessors;
+    ULONG Groups;
+    ULONG DataLength;
+    ULONGLONG TimestampFrequency;
+    ULONG EventsLost;
+    ULONG Reserved;
+} PERFTRACE_BUFFER_HEADER, *PPERFTRACE_BUFFER_HEADER;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REACTOS_PERFTRACE_H_INCLUDED */
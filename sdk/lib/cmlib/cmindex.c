@@ -645,31 +645,40 @@ static HCELL_INDEX
 NTAPI
 CmpFindSubKeyByHash(IN PHHIVE Hive,
                     IN PCM_KEY_FAST_INDEX FastIndex,
-                    IN PCUNICODE_STRING SearchName)
+                    IN PCUNICODE_STRING SearchName,
+                    IN ULONG HashKey)
 {
-    ULONG HashKey, i;
-    PCM_INDEX FastEntry;
+    PCM_INDEX List = FastIndex->List;
+    ULONG Count = FastIndex->Count;
+    ULONG i = 0, Last;
 
     /* Make sure it's really a hash */
     ASSERT(FastIndex->Signature == CM_KEY_HASH_LEAF);
 
-    /* Compute the hash key for the name */
-    HashKey = CmpComputeHashKey(0, SearchName, FALSE);
-
-    /* Loop all the entries */
-    for (i = 0; i < FastIndex->Count; i++)
+    while (i < Count)
     {
-        /* Get the entry */
-        FastEntry = &FastIndex->List[i];
+        /*
+         * Skip four entries at a time while none of their hashes match. This
+         * only reads the leaf itself; the key cells, which are spread all over
+         * the hive, are only touched for real candidates below.
+         */
+        while ((i + 4 <= Count) &&
+               !((List[i].HashKey == HashKey) |
+                 (List[i + 1].HashKey == HashKey) |
+                 (List[i + 2].HashKey == HashKey) |
+                 (List[i + 3].HashKey == HashKey)))
+        {
+            i += 4;
+        }
 
-        /* Compare the hash first */
-        if (FastEntry->HashKey == HashKey)
+        /* Do a full compare of whatever matched in this group */
+        for (Last = min(i + 4, Count); i < Last; i++)
         {
-            /* Go ahead for a full compare */
-            if (!(CmpDoCompareKeyName(Hive, SearchName, FastEntry->Cell)))
+            if ((List[i].HashKey == HashKey) &&
+                !(CmpDoCompareKeyName(Hive, SearchName, List[i].Cell)))
             {
                 /* It matched, return the cell */
-                return FastEntry->Cell;
+                return List[i].Cell;
             }
         }
     }
@@ -687,7 +696,8 @@ CmpFindSubKeyByName(IN PHHIVE Hive,
     ULONG i;
     PCM_KEY_INDEX IndexRoot;
     HCELL_INDEX SubKey, CellToRelease;
-    ULONG Found;
+    ULONG Found, HashKey = 0;
+    BOOLEAN HashComputed = FALSE;
 
     /* Loop each storage type */
     for (i = 0; i < Hive->StorageTypeCount; i++)
@@ -747,10 +757,18 @@ CmpFindSubKeyByName(IN PHHIVE Hive,
             }
             else
             {
+                /* The hash is the same for every leaf, compute it once */
+                if (!HashComputed)
+                {
+                    HashKey = CmpComputeHashKey(0, SearchName, FALSE);
+                    HashComputed = TRUE;
+                }
+
                 /* Find the subkey in the hash */
                 SubKey = CmpFindSubKeyByHash(Hive,
                                              (PCM_KEY_FAST_INDEX)IndexRoot,
-                                             SearchName);
+                                             SearchName,
+                                             HashKey);
 
                 /* Release the previous cell */
                 ASSERT(CellToRelease != HCELL_NIL);
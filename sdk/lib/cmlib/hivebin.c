@@ -63,6 +63,7 @@ HvpAddBin(
         RegistryHive->Storage[Storage].BlockList[OldBlockListSize + i].BlockAddress =
             ((ULONG_PTR)Bin + (i * HBLOCK_SIZE));
         RegistryHive->Storage[Storage].BlockList[OldBlockListSize + i].BinAddress = (ULONG_PTR)Bin;
+        RegistryHive->Storage[Storage].BlockList[OldBlockListSize + i].MemAlloc = (i == 0) ? (ULONG)BinSize : 0;
     }
 
     /* Initialize a free block in this heap. */
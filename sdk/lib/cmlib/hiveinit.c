@@ -59,18 +59,17 @@ HvpFreeHiveBins(
 
     for (Storage = 0; Storage < Hive->StorageTypeCount; Storage++)
     {
-        Bin = NULL;
         for (i = 0; i < Hive->Storage[Storage].Length; i++)
         {
-            if (Hive->Storage[Storage].BlockList[i].BinAddress == (ULONG_PTR)NULL)
-                continue;
-            if (Hive->Storage[Storage].BlockList[i].BinAddress != (ULONG_PTR)Bin)
+            /* Only the first block of an allocation frees it */
+            if (Hive->Storage[Storage].BlockList[i].MemAlloc != 0)
             {
                 Bin = (PHBIN)Hive->Storage[Storage].BlockList[i].BinAddress;
-                Hive->Free((PHBIN)Hive->Storage[Storage].BlockList[i].BinAddress, 0);
+                Hive->Free(Bin, Hive->Storage[Storage].BlockList[i].MemAlloc);
             }
             Hive->Storage[Storage].BlockList[i].BinAddress = (ULONG_PTR)NULL;
             Hive->Storage[Storage].BlockList[i].BlockAddress = (ULONG_PTR)NULL;
+            Hive->Storage[Storage].BlockList[i].MemAlloc = 0;
         }
 
         if (Hive->Storage[Storage].Length)
@@ -209,123 +208,173 @@ HvpCreateHive(
 }
 
 /**
- * @name HvpInitializeMemoryHive
+ * @name HvpInitializeHiveBins
  *
- * Internal helper function to initialize hive descriptor structure for
- * an existing hive stored in memory. The data of the hive is copied
- * and it is prepared for read/write access.
+ * Internal helper function to build the stable block list and the dirty
+ * vector of a hive whose base block is already set up, from the
+ * BaseBlock->Length bytes of bins at HiveBins.
  *
- * @see HvInitialize
+ * With CopyBins, each bin gets its own allocation and HiveBins stays owned
+ * by the caller. Otherwise the bins are used where they are and, on success,
+ * the hive takes over HiveBins, which must come from Hive->Allocate.
  */
-NTSTATUS CMAPI
-HvpInitializeMemoryHive(
+static NTSTATUS CMAPI
+HvpInitializeHiveBins(
     PHHIVE Hive,
-    PHBASE_BLOCK ChunkBase,
-    IN PCUNICODE_STRING FileName OPTIONAL)
+    PUCHAR HiveBins,
+    BOOLEAN CopyBins)
 {
-    SIZE_T BlockIndex;
+    PHMAP_ENTRY BlockList;
+    ULONG BlockIndex;
+    ULONG BlockCount;
     PHBIN Bin, NewBin;
     ULONG i;
     ULONG BitmapSize;
     PULONG BitmapBuffer;
-    SIZE_T ChunkSize;
-
-    ChunkSize = ChunkBase->Length;
-    DPRINT("ChunkSize: %lx\n", ChunkSize);
-
-    if (ChunkSize < sizeof(HBASE_BLOCK) ||
-        !HvpVerifyHiveHeader(ChunkBase))
-    {
-        DPRINT1("Registry is corrupt: ChunkSize %lu < sizeof(HBASE_BLOCK) %lu, "
-                "or HvpVerifyHiveHeader() failed\n", ChunkSize, sizeof(HBASE_BLOCK));
-        return STATUS_REGISTRY_CORRUPT;
-    }
-
-    /* Allocate the base block */
-    Hive->BaseBlock = HvpAllocBaseBlockAligned(Hive, FALSE, TAG_CM);
-    if (Hive->BaseBlock == NULL)
-        return STATUS_NO_MEMORY;
-
-    RtlCopyMemory(Hive->BaseBlock, ChunkBase, sizeof(HBASE_BLOCK));
-
-    /* Setup hive data */
-    Hive->Version = ChunkBase->Minor;
 
     /*
-     * Build a block list from the in-memory chunk and copy the data as
-     * we go.
+     * Build a block list from the bins, copying the data as we go
+     * if we have to.
      */
 
-    Hive->Storage[Stable].Length = (ULONG)(ChunkSize / HBLOCK_SIZE);
-    Hive->Storage[Stable].BlockList =
-        Hive->Allocate(Hive->Storage[Stable].Length *
-                       sizeof(HMAP_ENTRY), FALSE, TAG_CM);
-    if (Hive->Storage[Stable].BlockList == NULL)
+    Hive->Storage[Stable].Length = Hive->BaseBlock->Length / HBLOCK_SIZE;
+    BlockList = Hive->Allocate(Hive->Storage[Stable].Length *
+                               sizeof(HMAP_ENTRY), FALSE, TAG_CM);
+    if (BlockList == NULL)
     {
         DPRINT1("Allocating block list failed\n");
-        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
+        Hive->Storage[Stable].Length = 0;
         return STATUS_NO_MEMORY;
     }
+    RtlZeroMemory(BlockList, Hive->Storage[Stable].Length * sizeof(HMAP_ENTRY));
+    Hive->Storage[Stable].BlockList = BlockList;
 
     for (BlockIndex = 0; BlockIndex < Hive->Storage[Stable].Length; )
     {
-        Bin = (PHBIN)((ULONG_PTR)ChunkBase + (BlockIndex + 1) * HBLOCK_SIZE);
+        Bin = (PHBIN)(HiveBins + BlockIndex * HBLOCK_SIZE);
+        BlockCount = Bin->Size / HBLOCK_SIZE;
         if (Bin->Signature != HV_BIN_SIGNATURE ||
-           (Bin->Size % HBLOCK_SIZE) != 0)
+           (Bin->Size % HBLOCK_SIZE) != 0 ||
+            BlockCount == 0 ||
+            BlockCount > Hive->Storage[Stable].Length - BlockIndex)
         {
             DPRINT1("Invalid bin at BlockIndex %lu, Signature 0x%x, Size 0x%x\n",
                     (unsigned long)BlockIndex, (unsigned)Bin->Signature, (unsigned)Bin->Size);
-            Hive->Free(Hive->Storage[Stable].BlockList, 0);
-            Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
-            return STATUS_REGISTRY_CORRUPT;
+            goto Corrupt;
         }
 
-        NewBin = Hive->Allocate(Bin->Size, TRUE, TAG_CM);
-        if (NewBin == NULL)
+        if (CopyBins)
         {
-            Hive->Free(Hive->Storage[Stable].BlockList, 0);
-            Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
-            return STATUS_NO_MEMORY;
-        }
+            NewBin = Hive->Allocate(Bin->Size, TRUE, TAG_CM);
+            if (NewBin == NULL)
+                goto NoMemory;
+
+            RtlCopyMemory(NewBin, Bin, Bin->Size);
 
-        Hive->Storage[Stable].BlockList[BlockIndex].BinAddress = (ULONG_PTR)NewBin;
-        Hive->Storage[Stable].BlockList[BlockIndex].BlockAddress = (ULONG_PTR)NewBin;
+            /* Each bin is an allocation of its own */
+            BlockList[BlockIndex].MemAlloc = Bin->Size;
+        }
+        else
+        {
+            NewBin = Bin;
 
-        RtlCopyMemory(NewBin, Bin, Bin->Size);
+            /* The first bin owns the whole image */
+            if (BlockIndex == 0)
+                BlockList[BlockIndex].MemAlloc = Hive->BaseBlock->Length;
+        }
 
-        if (Bin->Size > HBLOCK_SIZE)
+        for (i = 0; i < BlockCount; i++)
         {
-            for (i = 1; i < Bin->Size / HBLOCK_SIZE; i++)
-            {
-                Hive->Storage[Stable].BlockList[BlockIndex + i].BinAddress = (ULONG_PTR)NewBin;
-                Hive->Storage[Stable].BlockList[BlockIndex + i].BlockAddress =
-                    ((ULONG_PTR)NewBin + (i * HBLOCK_SIZE));
-            }
+            BlockList[BlockIndex + i].BinAddress = (ULONG_PTR)NewBin;
+            BlockList[BlockIndex + i].BlockAddress =
+                ((ULONG_PTR)NewBin + (i * HBLOCK_SIZE));
         }
 
-        BlockIndex += Bin->Size / HBLOCK_SIZE;
+        BlockIndex += BlockCount;
     }
 
     if (HvpCreateHiveFreeCellList(Hive))
-    {
-        HvpFreeHiveBins(Hive);
-        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
-        return STATUS_NO_MEMORY;
-    }
+        goto NoMemory;
 
     BitmapSize = ROUND_UP(Hive->Storage[Stable].Length,
                           sizeof(ULONG) * 8) / 8;
     BitmapBuffer = (PULONG)Hive->Allocate(BitmapSize, TRUE, TAG_CM);
     if (BitmapBuffer == NULL)
-    {
-        HvpFreeHiveBins(Hive);
-        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
-        return STATUS_NO_MEMORY;
-    }
+        goto NoMemory;
 
     RtlInitializeBitMap(&Hive->DirtyVector, BitmapBuffer, BitmapSize * 8);
     RtlClearAllBits(&Hive->DirtyVector);
 
+    return STATUS_SUCCESS;
+
+NoMemory:
+    /* Don't let HvpFreeHiveBins free the bins we were given */
+    if (!CopyBins)
+        BlockList[0].MemAlloc = 0;
+    HvpFreeHiveBins(Hive);
+    Hive->Storage[Stable].Length = 0;
+    Hive->Storage[Stable].BlockList = NULL;
+    return STATUS_NO_MEMORY;
+
+Corrupt:
+    if (!CopyBins)
+        BlockList[0].MemAlloc = 0;
+    HvpFreeHiveBins(Hive);
+    Hive->Storage[Stable].Length = 0;
+    Hive->Storage[Stable].BlockList = NULL;
+    return STATUS_REGISTRY_CORRUPT;
+}
+
+/**
+ * @name HvpInitializeMemoryHive
+ *
+ * Internal helper function to initialize hive descriptor structure for
+ * an existing hive stored in memory. The data of the hive is copied
+ * and it is prepared for read/write access.
+ *
+ * @see HvInitialize
+ */
+NTSTATUS CMAPI
+HvpInitializeMemoryHive(
+    PHHIVE Hive,
+    PHBASE_BLOCK ChunkBase,
+    IN PCUNICODE_STRING FileName OPTIONAL)
+{
+    NTSTATUS Status;
+    SIZE_T ChunkSize;
+
+    ChunkSize = ChunkBase->Length;
+    DPRINT("ChunkSize: %lx\n", ChunkSize);
+
+    if (ChunkSize < sizeof(HBASE_BLOCK) ||
+        !HvpVerifyHiveHeader(ChunkBase))
+    {
+        DPRINT1("Registry is corrupt: ChunkSize %lu < sizeof(HBASE_BLOCK) %lu, "
+                "or HvpVerifyHiveHeader() failed\n", ChunkSize, sizeof(HBASE_BLOCK));
+        return STATUS_REGISTRY_CORRUPT;
+    }
+
+    /* Allocate the base block */
+    Hive->BaseBlock = HvpAllocBaseBlockAligned(Hive, FALSE, TAG_CM);
+    if (Hive->BaseBlock == NULL)
+        return STATUS_NO_MEMORY;
+
+    RtlCopyMemory(Hive->BaseBlock, ChunkBase, sizeof(HBASE_BLOCK));
+
+    /* Setup hive data */
+    Hive->Version = ChunkBase->Minor;
+
+    /* The caller keeps its buffer, so the bins have to be copied */
+    Status = HvpInitializeHiveBins(Hive,
+                                   (PUCHAR)ChunkBase + HBLOCK_SIZE,
+                                   TRUE);
+    if (!NT_SUCCESS(Status))
+    {
+        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
+        Hive->BaseBlock = NULL;
+        return Status;
+    }
+
     HvpInitFileName(Hive->BaseBlock, FileName);
 
     return STATUS_SUCCESS;
@@ -419,9 +468,8 @@ HvLoadHive(IN PHHIVE Hive,
     PHBASE_BLOCK BaseBlock = NULL;
     ULONG Result;
     LARGE_INTEGER TimeStamp;
-    ULONG Offset = 0;
+    ULONG Offset;
     PVOID HiveData;
-    ULONG FileSize;
 
     /* Get the hive header */
     Result = HvpGetHiveHeader(Hive, &BaseBlock, &TimeStamp);
@@ -454,38 +502,52 @@ HvLoadHive(IN PHHIVE Hive,
     Hive->BaseBlock = BaseBlock;
     Hive->Version = BaseBlock->Minor;
 
-    /* Allocate a buffer large enough to hold the hive */
-    FileSize = HBLOCK_SIZE + BaseBlock->Length; // == sizeof(HBASE_BLOCK) + BaseBlock->Length;
-    HiveData = Hive->Allocate(FileSize, TRUE, TAG_CM);
+    if (BaseBlock->Length == 0 || (BaseBlock->Length % HBLOCK_SIZE) != 0)
+    {
+        Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+        Hive->BaseBlock = NULL;
+        return STATUS_REGISTRY_CORRUPT;
+    }
+
+    /*
+     * Read the bins in one go into a buffer that the hive then keeps using
+     * as is, instead of copying every bin into an allocation of its own.
+     */
+    HiveData = Hive->Allocate(BaseBlock->Length, TRUE, TAG_CM);
     if (!HiveData)
     {
         Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+        Hive->BaseBlock = NULL;
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    /* Now read the whole hive */
+    Offset = HBLOCK_SIZE; // == sizeof(HBASE_BLOCK)
     Result = Hive->FileRead(Hive,
                             HFILE_TYPE_PRIMARY,
                             &Offset,
                             HiveData,
-                            FileSize);
+                            BaseBlock->Length);
     if (!Result)
     {
-        Hive->Free(HiveData, FileSize);
+        Hive->Free(HiveData, BaseBlock->Length);
         Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+        Hive->BaseBlock = NULL;
         return STATUS_NOT_REGISTRY_FILE;
     }
 
-    // This is a HACK!
-    /* Free our base block... it's usless in this implementation */
-    Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
-
-    /* Initialize the hive directly from memory */
-    Status = HvpInitializeMemoryHive(Hive, HiveData, FileName);
+    /* Initialize the hive directly on top of the bins we just read */
+    Status = HvpInitializeHiveBins(Hive, HiveData, FALSE);
     if (!NT_SUCCESS(Status))
-        Hive->Free(HiveData, FileSize);
+    {
+        Hive->Free(HiveData, BaseBlock->Length);
+        Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+        Hive->BaseBlock = NULL;
+        return Status;
+    }
 
-    return Status;
+    HvpInitFileName(BaseBlock, FileName);
+
+    return STATUS_SUCCESS;
 }
 
 /**
@@ -9,6 +9,56 @@
 #define NDEBUG
 #include <debug.h>
 
+/*
+ * Returns the number of blocks, starting at *BlockIndex, that can be written
+ * with a single FileWrite: blocks that are dirty (or any blocks, if OnlyDirty
+ * is FALSE) and whose data follows each other in memory. *BlockIndex is moved
+ * to the first block of the run. Zero means there is nothing left to write.
+ */
+static ULONG CMAPI
+HvpFindWriteRun(
+    PHHIVE RegistryHive,
+    BOOLEAN OnlyDirty,
+    PULONG BlockIndex)
+{
+    PHMAP_ENTRY BlockList = RegistryHive->Storage[Stable].BlockList;
+    ULONG Length = RegistryHive->Storage[Stable].Length;
+    ULONG StartIndex = *BlockIndex;
+    ULONG EndIndex;
+
+    if (StartIndex >= Length)
+    {
+        return 0;
+    }
+
+    if (OnlyDirty)
+    {
+        StartIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, StartIndex);
+        if (StartIndex == ~0U || StartIndex < *BlockIndex || StartIndex >= Length)
+        {
+            return 0;
+        }
+    }
+
+    /* Bins are allocated in one piece, so runs usually span whole bins */
+    for (EndIndex = StartIndex + 1; EndIndex < Length; EndIndex++)
+    {
+        if (OnlyDirty && !RtlCheckBit(&RegistryHive->DirtyVector, EndIndex))
+        {
+            break;
+        }
+
+        if (BlockList[EndIndex].BlockAddress !=
+            BlockList[EndIndex - 1].BlockAddress + HBLOCK_SIZE)
+        {
+            break;
+        }
+    }
+
+    *BlockIndex = StartIndex;
+    return EndIndex - StartIndex;
+}
+
 static BOOLEAN CMAPI
 HvpWriteLog(
     PHHIVE RegistryHive)
@@ -19,7 +69,7 @@ HvpWriteLog(
     PUCHAR Buffer;
     PUCHAR Ptr;
     ULONG BlockIndex;
-    ULONG LastIndex;
+    ULONG BlockCount;
     PVOID BlockPtr;
     BOOLEAN Success;
     static ULONG PrintCount = 0;
@@ -78,30 +128,24 @@ HvpWriteLog(
         return FALSE;
     }
 
-    /* Write dirty blocks */
+    /* Write dirty blocks, one write per run of contiguous ones */
     FileOffset = BufferSize;
     BlockIndex = 0;
-    while (BlockIndex < RegistryHive->Storage[Stable].Length)
+    while ((BlockCount = HvpFindWriteRun(RegistryHive, TRUE, &BlockIndex)) != 0)
     {
-        LastIndex = BlockIndex;
-        BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-        if (BlockIndex == ~0U || BlockIndex < LastIndex)
-        {
-            break;
-        }
-
         BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
 
-        /* Write hive block */
+        /* Write hive blocks */
         Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                         &FileOffset, BlockPtr, HBLOCK_SIZE);
+                                          &FileOffset, BlockPtr,
+                                          BlockCount * HBLOCK_SIZE);
         if (!Success)
         {
             return FALSE;
         }
 
-        BlockIndex++;
-        FileOffset += HBLOCK_SIZE;
+        BlockIndex += BlockCount;
+        FileOffset += BlockCount * HBLOCK_SIZE;
     }
 
     Success = RegistryHive->FileSetSize(RegistryHive, HFILE_TYPE_LOG, FileOffset, FileOffset);
@@ -150,7 +194,7 @@ HvpWriteHive(
 {
     ULONG FileOffset;
     ULONG BlockIndex;
-    ULONG LastIndex;
+    ULONG BlockCount;
     PVOID BlockPtr;
     BOOLEAN Success;
 
@@ -183,30 +227,21 @@ HvpWriteHive(
     }
 
     BlockIndex = 0;
-    while (BlockIndex < RegistryHive->Storage[Stable].Length)
+    while ((BlockCount = HvpFindWriteRun(RegistryHive, OnlyDirty, &BlockIndex)) != 0)
     {
-        if (OnlyDirty)
-        {
-            LastIndex = BlockIndex;
-            BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-            if (BlockIndex == ~0U || BlockIndex < LastIndex)
-            {
-                break;
-            }
-        }
-
         BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
         FileOffset = (BlockIndex + 1) * HBLOCK_SIZE;
 
-        /* Write hive block */
+        /* Write hive blocks */
         Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_PRIMARY,
-                                          &FileOffset, BlockPtr, HBLOCK_SIZE);
+                                          &FileOffset, BlockPtr,
+                                          BlockCount * HBLOCK_SIZE);
         if (!Success)
         {
             return FALSE;
         }
 
-        BlockIndex++;
+        BlockIndex += BlockCount;
     }
 
     Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_PRIMARY, NULL, 0);
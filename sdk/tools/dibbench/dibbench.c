@@ -0,0 +1,680 @@
+/*
+ * PROJECT:         ReactOS DibLib Row Kernel Benchmark
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            sdk/tools/dibbench/dibbench.c
+ * PURPOSE:         Checks the DibLib and AlphaBlend row kernels against
+ *                  per-pixel loops and measures their speed
+ *
+ * The reference loops read, combine and write one pixel at a time the way
+ * the generic DibLib_BitBlt.h functions and the DIB_xxBPP_AlphaBlend
+ * functions do. Every kernel set built for this processor has to match them
+ * bit for bit, including the bytes around the destination row, for all
+ * widths and misalignments tried.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <typedefs.h>
+
+#include "../../../win32ss/gdi/diblib/RowKernels.h"
+#include "../../../win32ss/gdi/dib/blendrow.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define GUARD_SIZE      32
+#define MAX_TEST_WIDTH  80
+#define BENCH_WIDTH     1920
+#define BENCH_HEIGHT    1080
+
+typedef enum _ROW_OP
+{
+    OpCopy,
+    OpXor,
+    OpAnd,
+    OpNot,
+    OpFill,
+    OpXorFill,
+    OpCount
+} ROW_OP;
+
+static const char *OpNames[OpCount] =
+{
+    "SRCCOPY", "SRCINVERT", "SRCAND", "DSTINVERT", "PATCOPY", "PATINVERT"
+};
+
+static const ULONG FormatBpp[] = { 8, 16, 24, 32 };
+
+/* The fixed EXLATEOBJ translations as EXLATEOBJ_bGetShiftMask describes
+   them, plus one EXLATEOBJ_iXlateShiftAndMask between bitfields */
+static const struct
+{
+    const char *Name;
+    DIB_SHIFTMASK ShiftMask;
+} Xlates[] =
+{
+    {"trivial",    {{0, 0, 0},    {0xFFFFFFFF, 0, 0}}},
+    {"RGBtoBGR",   {{0, 16, 0},   {0xFF00FF00, 0x00FF00FF, 0}}},
+    {"RGBto555",   {{7, 26, 13},  {0x7C00, 0x3E0, 0x1F}}},
+    {"RGBto565",   {{8, 27, 13},  {0xF800, 0x7E0, 0x1F}}},
+    {"BGRto555",   {{29, 26, 23}, {0x1F, 0x3E0, 0x7C00}}},
+    {"BGRto565",   {{29, 27, 24}, {0x1F, 0x7E0, 0xF800}}},
+    {"565to555bf", {{31, 31, 0},  {0x7C00, 0x3E0, 0x1F}}},
+};
+
+static ULONG Seed = 12345;
+
+static ULONG Random(void)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return (Seed >> 8) ^ (Seed << 13);
+}
+
+static void FillRandom(BYTE *Buffer, size_t Size)
+{
+    size_t i;
+    for (i = 0; i < Size; i++)
+        Buffer[i] = (BYTE)Random();
+}
+
+/** Reference implementations *************************************************/
+
+static ULONG ReadPixel(const BYTE *Pixel, ULONG Bpp)
+{
+    switch (Bpp)
+    {
+        case 8: return Pixel[0];
+        case 16: return Pixel[0] | (Pixel[1] << 8);
+        case 24: return Pixel[0] | (Pixel[1] << 8) | (Pixel[2] << 16);
+        default: return Pixel[0] | (Pixel[1] << 8) | (Pixel[2] << 16) | ((ULONG)Pixel[3] << 24);
+    }
+}
+
+static void WritePixel(BYTE *Pixel, ULONG Bpp, ULONG Color)
+{
+    ULONG i;
+    for (i = 0; i < Bpp / 8; i++)
+        Pixel[i] = (BYTE)(Color >> (i * 8));
+}
+
+/* EXLATEOBJ_iXlateShiftAndMask */
+static ULONG RefShiftMask(ULONG Color, const DIB_SHIFTMASK *ShiftMask)
+{
+    ULONG Result = 0, Shift, i;
+
+    for (i = 0; i < 3; i++)
+    {
+        Shift = ShiftMask->aulShift[i] % 32;
+        Result |= (Shift ? (Color << Shift) | (Color >> (32 - Shift)) : Color) & ShiftMask->aulMask[i];
+    }
+    return Result;
+}
+
+static void RefRow(ROW_OP Op, ULONG Bpp, BYTE *Dest, const BYTE *Source, ULONG Color, ULONG Width)
+{
+    ULONG x, D, S;
+
+    for (x = 0; x < Width; x++)
+    {
+        D = ReadPixel(Dest, Bpp);
+        S = (Op == OpFill || Op == OpXorFill) ? Color : (Op == OpNot ? 0 : ReadPixel(Source, Bpp));
+        switch (Op)
+        {
+            case OpCopy: case OpFill: D = S; break;
+            case OpXor: case OpXorFill: D ^= S; break;
+            case OpAnd: D &= S; break;
+            default: D = ~D; break;
+        }
+        WritePixel(Dest, Bpp, D);
+        Dest += Bpp / 8;
+        Source += Bpp / 8;
+    }
+}
+
+static void RefConvert(ULONG SrcBpp, ULONG DstBpp, BYTE *Dest, const BYTE *Source,
+                       ULONG Width, const DIB_SHIFTMASK *ShiftMask)
+{
+    ULONG x;
+
+    for (x = 0; x < Width; x++)
+    {
+        WritePixel(Dest, DstBpp, RefShiftMask(ReadPixel(Source, SrcBpp), ShiftMask));
+        Dest += DstBpp / 8;
+        Source += SrcBpp / 8;
+    }
+}
+
+static BYTE Clamp(ULONG Value, ULONG Max)
+{
+    return (BYTE)(Value > Max ? Max : Value);
+}
+
+/* DIB_32BPP_AlphaBlend and DIB_24BPP_AlphaBlend for a 32 bpp source (Bytes
+   4 and 3) and DIB_16BPP_AlphaBlend after its translation to RGB */
+static void RefBlend(ULONG iDest, BYTE *Dest, const BYTE *Source, ULONG Width,
+                     ULONG ConstAlpha, int SourceAlpha)
+{
+    ULONG x, i, Alpha, Alpha5, Alpha6, Src[4], D;
+
+    for (x = 0; x < Width; x++, Source += 4)
+    {
+        for (i = 0; i < 4; i++)
+            Src[i] = (Source[i] * ConstAlpha) / 255;
+        Alpha = SourceAlpha ? Src[3] : ConstAlpha;
+
+        switch (iDest)
+        {
+            case DIB_BLEND_DEST_32BPP:
+            case DIB_BLEND_DEST_24BPP:
+                for (i = 0; i < (iDest == DIB_BLEND_DEST_32BPP ? 4u : 3u); i++, Dest++)
+                    *Dest = Clamp((*Dest * (255 - Alpha)) / 255 + Src[i], 255);
+                break;
+
+            case DIB_BLEND_DEST_565:
+                Alpha5 = Alpha >> 3;
+                Alpha6 = Alpha >> 2;
+                D = Dest[0] | (Dest[1] << 8);
+                D = (Clamp((((D >> 11) & 0x1F) * (31 - Alpha5)) / 31 + (Src[2] >> 3), 31) << 11) |
+                    (Clamp((((D >> 5) & 0x3F) * (63 - Alpha6)) / 63 + (Src[1] >> 2), 63) << 5) |
+                    Clamp(((D & 0x1F) * (31 - Alpha5)) / 31 + (Src[0] >> 3), 31);
+                WritePixel(Dest, 16, D);
+                Dest += 2;
+                break;
+
+            default:
+                Alpha5 = Alpha >> 3;
+                D = Dest[0] | (Dest[1] << 8);
+                D = (D & 0x8000) |
+                    (Clamp((((D >> 10) & 0x1F) * (31 - Alpha5)) / 31 + (Src[2] >> 3), 31) << 10) |
+                    (Clamp((((D >> 5) & 0x1F) * (31 - Alpha5)) / 31 + (Src[1] >> 3), 31) << 5) |
+                    Clamp(((D & 0x1F) * (31 - Alpha5)) / 31 + (Src[0] >> 3), 31);
+                WritePixel(Dest, 16, D);
+                Dest += 2;
+                break;
+        }
+    }
+}
+
+/* Translations from win32ss/gdi/eng/xlateobj.c, to check the table above */
+static ULONG XlateRGBtoBGR(ULONG c) { return (c & 0xff00ff00) | ((c & 0x00ff00ff) >> 16) | ((c & 0x00ff00ff) << 16); }
+static ULONG XlateRGBto555(ULONG c) { return ((c << 7) & 0x7C00) | ((c >> 6) & 0x3E0) | ((c >> 19) & 0x1F); }
+static ULONG XlateRGBto565(ULONG c) { return ((c << 8) & 0xF800) | ((c >> 5) & 0x7E0) | ((c >> 19) & 0x1F); }
+static ULONG XlateBGRto555(ULONG c) { return ((c >> 3) & 0x1F) | ((c >> 6) & 0x3E0) | ((c >> 9) & 0x7C00); }
+static ULONG XlateBGRto565(ULONG c) { return ((c >> 3) & 0x1F) | ((c >> 5) & 0x7E0) | ((c >> 8) & 0xF800); }
+
+/** Checks ********************************************************************/
+
+static int CheckXlateTable(void)
+{
+    static ULONG (*const Functions[])(ULONG) =
+    {
+        NULL, XlateRGBtoBGR, XlateRGBto555, XlateRGBto565, XlateBGRto555, XlateBGRto565
+    };
+    ULONG i, n, Color;
+    int Errors = 0;
+
+    for (i = 1; i < sizeof(Functions) / sizeof(Functions[0]); i++)
+    {
+        for (n = 0; n < 100000; n++)
+        {
+            Color = Random();
+            if (Functions[i](Color) != RefShiftMask(Color, &Xlates[i].ShiftMask))
+            {
+                printf("xlate %s differs for 0x%08x\n", Xlates[i].Name, Color);
+                Errors++;
+                break;
+            }
+        }
+    }
+    return Errors;
+}
+
+static int CompareRows(const char *Kernels, const char *What, ULONG Width, ULONG Offset,
+                       const BYTE *Expected, const BYTE *Actual, size_t Size)
+{
+    if (!memcmp(Expected, Actual, Size))
+        return 0;
+
+    printf("%s: %s differs at width %u, offset %u\n", Kernels, What, Width, Offset);
+    return 1;
+}
+
+static int CheckKernels(const char *Name, const DIB_ROW_KERNELS *Kernels)
+{
+    static BYTE Source[GUARD_SIZE + MAX_TEST_WIDTH * 4 + GUARD_SIZE];
+    static BYTE Expected[GUARD_SIZE + MAX_TEST_WIDTH * 4 + GUARD_SIZE];
+    static BYTE Actual[GUARD_SIZE + MAX_TEST_WIDTH * 4 + GUARD_SIZE];
+    BYTE Pattern[DIB_FILL_PATTERN_SIZE];
+    ULONG f, s, d, x, Width, Offset, Bpp, Color, cj;
+    const DIB_SHIFTMASK *ShiftMask;
+    char What[64];
+    int Errors = 0;
+    ROW_OP Op;
+
+    for (f = 0; f < sizeof(FormatBpp) / sizeof(FormatBpp[0]); f++)
+    {
+        Bpp = FormatBpp[f];
+        for (Width = 0; Width <= MAX_TEST_WIDTH; Width++)
+        {
+            for (Offset = 0; Offset < 16; Offset += 3)
+            {
+                for (Op = 0; Op < OpCount; Op++)
+                {
+                    FillRandom(Source, sizeof(Source));
+                    FillRandom(Expected, sizeof(Expected));
+                    memcpy(Actual, Expected, sizeof(Actual));
+                    Color = Random();
+                    cj = Width * Bpp / 8;
+
+                    RefRow(Op, Bpp, Expected + GUARD_SIZE + Offset, Source + GUARD_SIZE, Color, Width);
+
+                    Dib_vBuildFillPattern(Pattern, Color, Bpp / 8);
+                    switch (Op)
+                    {
+                        case OpCopy: Kernels->pfnCopy(Actual + GUARD_SIZE + Offset, Source + GUARD_SIZE, cj); break;
+                        case OpXor: Kernels->pfnXor(Actual + GUARD_SIZE + Offset, Source + GUARD_SIZE, cj); break;
+                        case OpAnd: Kernels->pfnAnd(Actual + GUARD_SIZE + Offset, Source + GUARD_SIZE, cj); break;
+                        case OpNot: Kernels->pfnNot(Actual + GUARD_SIZE + Offset, cj); break;
+                        case OpFill: Kernels->pfnFill(Actual + GUARD_SIZE + Offset, Pattern, cj); break;
+                        default: Kernels->pfnXorFill(Actual + GUARD_SIZE + Offset, Pattern, cj); break;
+                    }
+
+                    sprintf(What, "%s %u bpp", OpNames[Op], Bpp);
+                    Errors += CompareRows(Name, What, Width, Offset, Expected, Actual, sizeof(Actual));
+                }
+            }
+        }
+    }
+
+    for (s = 16; s <= 32; s += 8)
+    {
+        for (d = 16; d <= 32; d += 8)
+        {
+            for (x = 0; x < sizeof(Xlates) / sizeof(Xlates[0]); x++)
+            {
+                ShiftMask = &Xlates[x].ShiftMask;
+                for (Width = 0; Width <= MAX_TEST_WIDTH; Width++)
+                {
+                    for (Offset = 0; Offset < 16; Offset += 5)
+                    {
+                        /* Put the source row right at the end of its buffer,
+                           so reading past it would show up under ASan */
+                        BYTE *SourceRow = Source + sizeof(Source) - Width * s / 8;
+
+                        FillRandom(Source, sizeof(Source));
+                        FillRandom(Expected, sizeof(Expected));
+                        memcpy(Actual, Expected, sizeof(Actual));
+
+                        RefConvert(s, d, Expected + GUARD_SIZE + Offset, SourceRow, Width, ShiftMask);
+                        Kernels->apfnConvert[DIB_CONVERT_INDEX(d)][DIB_CONVERT_INDEX(s)](
+                            Actual + GUARD_SIZE + Offset, SourceRow, Width, ShiftMask);
+
+                        sprintf(What, "%u to %u bpp %s", s, d, Xlates[x].Name);
+                        Errors += CompareRows(Name, What, Width, Offset, Expected, Actual, sizeof(Actual));
+                    }
+                }
+            }
+        }
+    }
+
+    /* Equal surface blits copy to a lower address within the same row */
+    for (Width = 0; Width <= MAX_TEST_WIDTH * 4; Width++)
+    {
+        for (Offset = 1; Offset <= 67; Offset += (Offset < 4) ? 1 : 16)
+        {
+            if (Offset > Width)
+                break;
+
+            FillRandom(Expected, sizeof(Expected));
+            memcpy(Actual, Expected, sizeof(Actual));
+
+            memmove(Expected + GUARD_SIZE, Expected + GUARD_SIZE + Offset, Width - Offset);
+            Kernels->pfnCopy(Actual + GUARD_SIZE, Actual + GUARD_SIZE + Offset, Width - Offset);
+
+            sprintf(What, "overlapping %s", OpNames[OpCopy]);
+            Errors += CompareRows(Name, What, Width, Offset, Expected, Actual, sizeof(Actual));
+        }
+    }
+
+    printf("%s kernels: %s\n", Name, Errors ? "FAILED" : "bit exact");
+    return Errors;
+}
+
+static const char *BlendDestNames[DIB_BLEND_DEST_COUNT] = { "32 bpp", "24 bpp", "565", "555" };
+static const ULONG BlendDestBytes[DIB_BLEND_DEST_COUNT] = { 4, 3, 2, 2 };
+
+/* Mixes fully transparent and opaque pixels into the random ones, the
+   kernels treat those separately */
+static void FillBlendSource(BYTE *Buffer, ULONG cPixels)
+{
+    ULONG i;
+
+    FillRandom(Buffer, cPixels * 4);
+    for (i = 0; i < cPixels; i++, Buffer += 4)
+    {
+        switch (Random() % 4)
+        {
+            case 0: memset(Buffer, 0, 4); break;
+            case 1: Buffer[3] = 255; break;
+        }
+    }
+}
+
+static int CheckBlendKernels(const char *Name, const DIB_BLEND_KERNELS *Kernels)
+{
+    static const ULONG ConstAlphas[] = { 255, 254, 128, 1, 0 };
+    static BYTE Source[MAX_TEST_WIDTH * 4];
+    static BYTE Expected[GUARD_SIZE + MAX_TEST_WIDTH * 4 + GUARD_SIZE];
+    static BYTE Actual[GUARD_SIZE + MAX_TEST_WIDTH * 4 + GUARD_SIZE];
+    ULONG iDest, c, Width, Offset;
+    char What[64];
+    int Errors = 0, SourceAlpha;
+
+    for (iDest = 0; iDest < DIB_BLEND_DEST_COUNT; iDest++)
+    {
+        for (SourceAlpha = 0; SourceAlpha < 2; SourceAlpha++)
+        {
+            for (c = 0; c < sizeof(ConstAlphas) / sizeof(ConstAlphas[0]); c++)
+            {
+                for (Width = 0; Width <= MAX_TEST_WIDTH; Width++)
+                {
+                    /* 16 bpp rows are always aligned on 2 bytes */
+                    for (Offset = 0; Offset < 16; Offset += (BlendDestBytes[iDest] == 2) ? 2 : 3)
+                    {
+                        FillBlendSource(Source, Width);
+                        FillRandom(Expected, sizeof(Expected));
+                        memcpy(Actual, Expected, sizeof(Actual));
+
+                        RefBlend(iDest, Expected + GUARD_SIZE + Offset, Source, Width,
+                                 ConstAlphas[c], SourceAlpha);
+                        Kernels->apfnBlend[iDest][SourceAlpha](Actual + GUARD_SIZE + Offset, Source,
+                                                               Width, ConstAlphas[c]);
+
+                        sprintf(What, "blend to %s, %s alpha %u", BlendDestNames[iDest],
+                                SourceAlpha ? "source" : "constant", ConstAlphas[c]);
+                        Errors += CompareRows(Name, What, Width, Offset, Expected, Actual, sizeof(Actual));
+                    }
+                }
+            }
+        }
+    }
+
+    printf("%s blend kernels: %s\n", Name, Errors ? "FAILED" : "bit exact");
+    return Errors;
+}
+
+/** Benchmark *****************************************************************/
+
+typedef struct _BENCH_SURFACES
+{
+    BYTE *Source;
+    BYTE *Dest;
+    ULONG Iterations;
+} BENCH_SURFACES;
+
+static double Seconds(clock_t Start)
+{
+    double Elapsed = (double)(clock() - Start) / CLOCKS_PER_SEC;
+    return Elapsed > 0 ? Elapsed : 1.0 / CLOCKS_PER_SEC;
+}
+
+/* Megapixels per second for one operation over the whole surface */
+static double BenchRef(BENCH_SURFACES *Surfaces, ROW_OP Op, ULONG Bpp)
+{
+    ULONG i, y, cjDelta = BENCH_WIDTH * 4;
+    clock_t Start = clock();
+
+    for (i = 0; i < Surfaces->Iterations; i++)
+        for (y = 0; y < BENCH_HEIGHT; y++)
+            RefRow(Op, Bpp, Surfaces->Dest + y * cjDelta, Surfaces->Source + y * cjDelta, 0x123456, BENCH_WIDTH);
+
+    return (double)BENCH_WIDTH * BENCH_HEIGHT * Surfaces->Iterations / Seconds(Start) / 1e6;
+}
+
+static double BenchRow(BENCH_SURFACES *Surfaces, const DIB_ROW_KERNELS *Kernels, ROW_OP Op, ULONG Bpp)
+{
+    ULONG i, y, cjDelta = BENCH_WIDTH * 4, cj = BENCH_WIDTH * Bpp / 8;
+    BYTE Pattern[DIB_FILL_PATTERN_SIZE];
+    BYTE *Dest, *Source;
+    clock_t Start;
+
+    Dib_vBuildFillPattern(Pattern, 0x123456, Bpp / 8);
+    Start = clock();
+    for (i = 0; i < Surfaces->Iterations; i++)
+    {
+        for (y = 0; y < BENCH_HEIGHT; y++)
+        {
+            Dest = Surfaces->Dest + y * cjDelta;
+            Source = Surfaces->Source + y * cjDelta;
+            switch (Op)
+            {
+                case OpCopy: Kernels->pfnCopy(Dest, Source, cj); break;
+                case OpXor: Kernels->pfnXor(Dest, Source, cj); break;
+                case OpAnd: Kernels->pfnAnd(Dest, Source, cj); break;
+                case OpNot: Kernels->pfnNot(Dest, cj); break;
+                case OpFill: Kernels->pfnFill(Dest, Pattern, cj); break;
+                default: Kernels->pfnXorFill(Dest, Pattern, cj); break;
+            }
+        }
+    }
+
+    return (double)BENCH_WIDTH * BENCH_HEIGHT * Surfaces->Iterations / Seconds(Start) / 1e6;
+}
+
+static double BenchConvert(BENCH_SURFACES *Surfaces, const DIB_ROW_KERNELS *Kernels,
+                           ULONG SrcBpp, ULONG DstBpp, const DIB_SHIFTMASK *ShiftMask)
+{
+    ULONG i, y, cjDelta = BENCH_WIDTH * 4;
+    clock_t Start = clock();
+
+    for (i = 0; i < Surfaces->Iterations; i++)
+    {
+        for (y = 0; y < BENCH_HEIGHT; y++)
+        {
+            if (Kernels)
+            {
+                Kernels->apfnConvert[DIB_CONVERT_INDEX(DstBpp)][DIB_CONVERT_INDEX(SrcBpp)](
+                    Surfaces->Dest + y * cjDelta, Surfaces->Source + y * cjDelta, BENCH_WIDTH, ShiftMask);
+            }
+            else
+            {
+                RefConvert(SrcBpp, DstBpp, Surfaces->Dest + y * cjDelta,
+                           Surfaces->Source + y * cjDelta, BENCH_WIDTH, ShiftMask);
+            }
+        }
+    }
+
+    return (double)BENCH_WIDTH * BENCH_HEIGHT * Surfaces->Iterations / Seconds(Start) / 1e6;
+}
+
+static double BenchBlend(BENCH_SURFACES *Surfaces, const DIB_BLEND_KERNELS *Kernels,
+                         ULONG iDest, int SourceAlpha, ULONG ConstAlpha)
+{
+    ULONG i, y, cjDelta = BENCH_WIDTH * 4;
+    clock_t Start = clock();
+
+    for (i = 0; i < Surfaces->Iterations; i++)
+    {
+        for (y = 0; y < BENCH_HEIGHT; y++)
+        {
+            if (Kernels)
+            {
+                Kernels->apfnBlend[iDest][SourceAlpha](Surfaces->Dest + y * cjDelta,
+                                                       Surfaces->Source + y * cjDelta,
+                                                       BENCH_WIDTH, ConstAlpha);
+            }
+            else
+            {
+                RefBlend(iDest, Surfaces->Dest + y * cjDelta, Surfaces->Source + y * cjDelta,
+                         BENCH_WIDTH, ConstAlpha, SourceAlpha);
+            }
+        }
+    }
+
+    return (double)BENCH_WIDTH * BENCH_HEIGHT * Surfaces->Iterations / Seconds(Start) / 1e6;
+}
+
+static void RunBlendBenchmark(BENCH_SURFACES *Surfaces, int HaveSse2)
+{
+    static const struct { int SourceAlpha; ULONG ConstAlpha; const char *Name; } Blends[] =
+    {
+        {1, 255, "per pixel"}, {1, 128, "per pixel * 128"}, {0, 128, "constant 128"}
+    };
+    ULONG iDest, i;
+
+    /* An icon-like source: a quarter transparent, a quarter opaque */
+    FillBlendSource(Surfaces->Source, BENCH_WIDTH * BENCH_HEIGHT);
+
+    for (iDest = 0; iDest < DIB_BLEND_DEST_COUNT; iDest++)
+    {
+        for (i = 0; i < sizeof(Blends) / sizeof(Blends[0]); i++)
+        {
+            printf("blend %-6s %-13s %10.0f %10.0f", BlendDestNames[iDest], Blends[i].Name,
+                   BenchBlend(Surfaces, NULL, iDest, Blends[i].SourceAlpha, Blends[i].ConstAlpha),
+                   BenchBlend(Surfaces, &gDibBlendKernelsC, iDest, Blends[i].SourceAlpha, Blends[i].ConstAlpha));
+#ifdef _DIB_BLEND_SSE2
+            if (HaveSse2)
+            {
+                printf(" %10.0f", BenchBlend(Surfaces, &gDibBlendKernelsSse2, iDest,
+                                             Blends[i].SourceAlpha, Blends[i].ConstAlpha));
+            }
+#endif
+            printf("\n");
+        }
+    }
+}
+
+static void RunBenchmark(ULONG Iterations, int HaveSse2)
+{
+    static const struct { ULONG Src, Dst, Xlate; } Conversions[] =
+    {
+        {32, 32, 1}, {32, 24, 0}, {24, 32, 0}, {32, 16, 5}, {24, 16, 4}, {16, 16, 6}
+    };
+    BENCH_SURFACES Surfaces;
+    ULONG f, i;
+    ROW_OP Op;
+
+    Surfaces.Iterations = Iterations;
+    Surfaces.Source = malloc(BENCH_WIDTH * 4 * BENCH_HEIGHT);
+    Surfaces.Dest = malloc(BENCH_WIDTH * 4 * BENCH_HEIGHT);
+    if (!Surfaces.Source || !Surfaces.Dest)
+    {
+        fprintf(stderr, "dibbench: out of memory\n");
+        free(Surfaces.Source);
+        free(Surfaces.Dest);
+        return;
+    }
+    FillRandom(Surfaces.Source, BENCH_WIDTH * 4 * BENCH_HEIGHT);
+    FillRandom(Surfaces.Dest, BENCH_WIDTH * 4 * BENCH_HEIGHT);
+
+    printf("\n%ux%u, %u iterations, megapixels per second\n", BENCH_WIDTH, BENCH_HEIGHT, Iterations);
+    printf("%-24s %10s %10s %10s\n", "operation", "per pixel", "C rows", HaveSse2 ? "SSE2 rows" : "");
+
+    for (f = 1; f < sizeof(FormatBpp) / sizeof(FormatBpp[0]); f++)
+    {
+        for (Op = 0; Op < OpCount; Op++)
+        {
+            printf("%-10s %2u bpp      %10.0f %10.0f", OpNames[Op], FormatBpp[f],
+                   BenchRef(&Surfaces, Op, FormatBpp[f]),
+                   BenchRow(&Surfaces, &gDibRowKernelsC, Op, FormatBpp[f]));
+#ifdef _DIBLIB_SSE2
+            if (HaveSse2)
+                printf(" %10.0f", BenchRow(&Surfaces, &gDibRowKernelsSse2, Op, FormatBpp[f]));
+#endif
+            printf("\n");
+        }
+    }
+
+    for (i = 0; i < sizeof(Conversions) / sizeof(Conversions[0]); i++)
+    {
+        const DIB_SHIFTMASK *ShiftMask = &Xlates[Conversions[i].Xlate].ShiftMask;
+
+        printf("%2u->%2u bpp %-13s %10.0f %10.0f", Conversions[i].Src, Conversions[i].Dst,
+               Xlates[Conversions[i].Xlate].Name,
+               BenchConvert(&Surfaces, NULL, Conversions[i].Src, Conversions[i].Dst, ShiftMask),
+               BenchConvert(&Surfaces, &gDibRowKernelsC, Conversions[i].Src, Conversions[i].Dst, ShiftMask));
+#ifdef _DIBLIB_SSE2
+        if (HaveSse2)
+        {
+            printf(" %10.0f", BenchConvert(&Surfaces, &gDibRowKernelsSse2,
+                                           Conversions[i].Src, Conversions[i].Dst, ShiftMask));
+        }
+#endif
+        printf("\n");
+    }
+
+    RunBlendBenchmark(&Surfaces, HaveSse2);
+
+    free(Surfaces.Source);
+    free(Surfaces.Dest);
+}
+
+static int HostHasSse2(void)
+{
+#if !defined(_DIBLIB_SSE2)
+    return 0;
+#elif defined(_MSC_VER)
+    int Info[4];
+    __cpuid(Info, 1);
+    return (Info[3] >> 26) & 1;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static void Usage(void)
+{
+    printf("Usage: dibbench [-t] [-n iterations]\n"
+           "  -t  only check the kernels, don't run the benchmark\n"
+           "  -n  passes over a %ux%u surface per measurement, 20 by default\n",
+           BENCH_WIDTH, BENCH_HEIGHT);
+}
+
+int main(int argc, char *argv[])
+{
+    ULONG Iterations = 20;
+    int TestOnly = 0, HaveSse2, Errors, arg;
+
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (!strcmp(argv[arg], "-t"))
+        {
+            TestOnly = 1;
+        }
+        else if (!strcmp(argv[arg], "-n") && arg + 1 < argc)
+        {
+            Iterations = strtoul(argv[++arg], NULL, 0);
+            if (!Iterations) Iterations = 1;
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    HaveSse2 = HostHasSse2();
+    Dib_vInitRowKernels((BOOLEAN)HaveSse2);
+    DIB_vInitBlendKernels((BOOLEAN)HaveSse2);
+    printf("Selected %s kernels\n", gpDibRowKernels == &gDibRowKernelsC ? "C" : "SSE2");
+
+    Errors = CheckXlateTable();
+    Errors += CheckKernels("C", &gDibRowKernelsC);
+#ifdef _DIBLIB_SSE2
+    if (HaveSse2)
+        Errors += CheckKernels("SSE2", &gDibRowKernelsSse2);
+#endif
+    Errors += CheckBlendKernels("C", &gDibBlendKernelsC);
+#ifdef _DIB_BLEND_SSE2
+    if (HaveSse2)
+        Errors += CheckBlendKernels("SSE2", &gDibBlendKernelsSse2);
+#endif
+
+    if (!Errors && !TestOnly)
+        RunBenchmark(Iterations, HaveSse2);
+
+    return Errors ? 1 : 0;
+}
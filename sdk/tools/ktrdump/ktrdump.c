@@ -0,0 +1,502 @@
+/*
+ * PROJECT:         ReactOS Kernel Event Trace Decoder
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            sdk/tools/ktrdump/ktrdump.c
+ * PURPOSE:         Turns a trace recorded by ktrace into a timeline or JSON
+ *
+ * The JSON output is in the Trace Event Format, which chrome://tracing and
+ * Perfetto load as is: every processor gets a track showing the threads it
+ * ran, and the other events show up on the thread that caused them.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <typedefs.h>
+#include <reactos/perftrace.h>
+
+#define IRP_MJ_READ     0x03
+
+/* Pseudo process holding the per-processor tracks in the JSON output */
+#define CPU_TRACK_PID   0xFFFFFFFF
+
+typedef struct _EVENT_ENTRY
+{
+    ULONGLONG Timestamp;
+    ULONG Sequence;
+    PPERFTRACE_EVENT_HEADER Header;
+} EVENT_ENTRY, *PEVENT_ENTRY;
+
+typedef struct _CPU_STATE
+{
+    ULONGLONG SwitchTime;
+    ULONG ThreadId;
+    ULONG ProcessId;
+    int Valid;
+} CPU_STATE, *PCPU_STATE;
+
+static double Frequency;
+static ULONGLONG BaseTime;
+static int FirstJsonEvent = 1;
+
+/* Thread id to process id, learned from context switches and thread events */
+static PULONG ThreadOwners;
+static ULONG ThreadOwnersSize;
+
+static const char *RegistryOperations[] =
+{
+    "QueryKey", "EnumerateKey", "DeleteKey", "QueryValue",
+    "EnumerateValue", "SetValue", "DeleteValue"
+};
+
+static
+void
+Usage(void)
+{
+    printf("Decodes a kernel event trace recorded by ktrace.\n"
+           "Syntax: ktrdump [-j] <trace file> [output file]\n"
+           "  -j  write JSON in the Trace Event Format instead of a timeline\n");
+}
+
+static
+void
+SetThreadOwner(ULONG ThreadId, ULONG ProcessId)
+{
+    ULONG Index = ThreadId / 4, NewSize;
+    PULONG NewOwners;
+
+    if (Index >= ThreadOwnersSize)
+    {
+        NewSize = ThreadOwnersSize ? ThreadOwnersSize : 1024;
+        while (NewSize <= Index) NewSize *= 2;
+
+        NewOwners = realloc(ThreadOwners, NewSize * sizeof(ULONG));
+        if (!NewOwners) return;
+        memset(NewOwners + ThreadOwnersSize, 0, (NewSize - ThreadOwnersSize) * sizeof(ULONG));
+        ThreadOwners = NewOwners;
+        ThreadOwnersSize = NewSize;
+    }
+
+    ThreadOwners[Index] = ProcessId;
+}
+
+static
+ULONG
+GetThreadOwner(ULONG ThreadId)
+{
+    return (ThreadId / 4 < ThreadOwnersSize) ? ThreadOwners[ThreadId / 4] : 0;
+}
+
+static
+double
+TicksToMicroseconds(ULONGLONG Ticks)
+{
+    return Frequency ? (double)Ticks * 1000000.0 / Frequency : (double)Ticks;
+}
+
+static
+double
+TimeOf(ULONGLONG Timestamp)
+{
+    return TicksToMicroseconds(Timestamp - BaseTime);
+}
+
+static
+int
+CompareEvents(const void *a, const void *b)
+{
+    const EVENT_ENTRY *Left = a, *Right = b;
+
+    /* Processors are drained one after the other, keep their own order */
+    if (Left->Timestamp != Right->Timestamp)
+        return (Left->Timestamp < Right->Timestamp) ? -1 : 1;
+    if (Left->Sequence != Right->Sequence)
+        return (Left->Sequence < Right->Sequence) ? -1 : 1;
+    return 0;
+}
+
+static
+void
+CopyImageName(char *Name, const CHAR *ImageFileName)
+{
+    size_t i;
+
+    /* The kernel doesn't terminate names that fill the whole field */
+    for (i = 0; i < 16 && ImageFileName[i]; i++)
+    {
+        Name[i] = (ImageFileName[i] == '"' || ImageFileName[i] == '\\') ? '_' : ImageFileName[i];
+    }
+    Name[i] = '\0';
+}
+
+static
+void
+JsonEvent(FILE *Out, const char *Format, ...)
+{
+    va_list Args;
+
+    fputs(FirstJsonEvent ? "\n" : ",\n", Out);
+    FirstJsonEvent = 0;
+
+    va_start(Args, Format);
+    vfprintf(Out, Format, Args);
+    va_end(Args);
+}
+
+static
+void
+DumpTimeline(FILE *Out, PPERFTRACE_EVENT_HEADER Header)
+{
+    char Name[17];
+
+    fprintf(Out, "%14.3f  CPU%-2u ", TimeOf(Header->Timestamp), Header->Processor);
+
+    switch (Header->Type)
+    {
+        case PERFTRACE_EVENT_CSWITCH:
+        {
+            PPERFTRACE_CSWITCH_EVENT Event = (PPERFTRACE_CSWITCH_EVENT)Header;
+            fprintf(Out, "CSwitch      %lu.%lu (pri %d, state %u, wait %u) -> %lu.%lu (pri %d)\n",
+                    (unsigned long)Event->OldProcessId, (unsigned long)Event->OldThreadId,
+                    Event->OldPriority, Event->OldThreadState, Event->OldWaitReason,
+                    (unsigned long)Event->NewProcessId, (unsigned long)Event->NewThreadId,
+                    Event->NewPriority);
+            break;
+        }
+
+        case PERFTRACE_EVENT_PAGE_FAULT:
+        {
+            PPERFTRACE_PAGE_FAULT_EVENT Event = (PPERFTRACE_PAGE_FAULT_EVENT)Header;
+            fprintf(Out, "PageFault    tid %lu addr 0x%llx code 0x%lx %s status 0x%08lx %.3f us\n",
+                    (unsigned long)Event->ThreadId, (unsigned long long)Event->Address,
+                    (unsigned long)Event->FaultCode, Event->Mode ? "user" : "kernel",
+                    (unsigned long)Event->Status, TicksToMicroseconds(Event->Duration));
+            break;
+        }
+
+        case PERFTRACE_EVENT_DISK_IO:
+        {
+            PPERFTRACE_DISK_IO_EVENT Event = (PPERFTRACE_DISK_IO_EVENT)Header;
+            fprintf(Out, "Disk%-5s    tid %lu dev 0x%llx offset 0x%llx length %lu status 0x%08lx irp 0x%llx\n",
+                    (Event->MajorFunction == IRP_MJ_READ) ? "Read" : "Write",
+                    (unsigned long)Event->ThreadId, (unsigned long long)Event->DeviceObject,
+                    (unsigned long long)Event->ByteOffset, (unsigned long)Event->Length,
+                    (unsigned long)Event->Status, (unsigned long long)Event->Irp);
+            break;
+        }
+
+        case PERFTRACE_EVENT_REGISTRY:
+        {
+            PPERFTRACE_REGISTRY_EVENT Event = (PPERFTRACE_REGISTRY_EVENT)Header;
+            fprintf(Out, "Registry     %lu.%lu %s kcb 0x%llx status 0x%08lx %.3f us\n",
+                    (unsigned long)Event->ProcessId, (unsigned long)Event->ThreadId,
+                    (Event->Operation < sizeof(RegistryOperations) / sizeof(RegistryOperations[0])) ?
+                        RegistryOperations[Event->Operation] : "?",
+                    (unsigned long long)Event->KeyControlBlock, (unsigned long)Event->Status,
+                    TicksToMicroseconds(Event->Duration));
+            break;
+        }
+
+        case PERFTRACE_EVENT_PROCESS_CREATE:
+        case PERFTRACE_EVENT_PROCESS_EXIT:
+        {
+            PPERFTRACE_PROCESS_EVENT Event = (PPERFTRACE_PROCESS_EVENT)Header;
+            CopyImageName(Name, Event->ImageFileName);
+            fprintf(Out, "Process%-5s pid %lu parent %lu %s status 0x%08lx\n",
+                    (Header->Type == PERFTRACE_EVENT_PROCESS_CREATE) ? "Start" : "End",
+                    (unsigned long)Event->ProcessId, (unsigned long)Event->ParentId,
+                    Name, (unsigned long)Event->ExitStatus);
+            break;
+        }
+
+        case PERFTRACE_EVENT_THREAD_CREATE:
+        case PERFTRACE_EVENT_THREAD_EXIT:
+        {
+            PPERFTRACE_THREAD_EVENT Event = (PPERFTRACE_THREAD_EVENT)Header;
+            fprintf(Out, "Thread%-5s  %lu.%lu start 0x%llx status 0x%08lx\n",
+                    (Header->Type == PERFTRACE_EVENT_THREAD_CREATE) ? "Start" : "End",
+                    (unsigned long)Event->ProcessId, (unsigned long)Event->ThreadId,
+                    (unsigned long long)Event->StartAddress, (unsigned long)Event->ExitStatus);
+            break;
+        }
+
+        default:
+            fprintf(Out, "Unknown      type %u size %u\n", Header->Type, Header->Size);
+            break;
+    }
+}
+
+static
+void
+DumpJson(FILE *Out, PPERFTRACE_EVENT_HEADER Header, PCPU_STATE Cpus, ULONG NumberOfCpus)
+{
+    char Name[17];
+    double Time = TimeOf(Header->Timestamp);
+
+    switch (Header->Type)
+    {
+        case PERFTRACE_EVENT_CSWITCH:
+        {
+            PPERFTRACE_CSWITCH_EVENT Event = (PPERFTRACE_CSWITCH_EVENT)Header;
+            PCPU_STATE Cpu;
+
+            SetThreadOwner(Event->OldThreadId, Event->OldProcessId);
+            SetThreadOwner(Event->NewThreadId, Event->NewProcessId);
+            if (Header->Processor >= NumberOfCpus) break;
+
+            /* Close the slice of the thread that ran until now */
+            Cpu = &Cpus[Header->Processor];
+            if (Cpu->Valid)
+            {
+                JsonEvent(Out,
+                          "{\"name\":\"%lu.%lu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                          "\"pid\":%lu,\"tid\":%u,\"args\":{\"pid\":%lu,\"tid\":%lu}}",
+                          (unsigned long)Cpu->ProcessId, (unsigned long)Cpu->ThreadId,
+                          TimeOf(Cpu->SwitchTime), Time - TimeOf(Cpu->SwitchTime),
+                          (unsigned long)CPU_TRACK_PID, Header->Processor,
+                          (unsigned long)Cpu->ProcessId, (unsigned long)Cpu->ThreadId);
+            }
+
+            Cpu->SwitchTime = Header->Timestamp;
+            Cpu->ThreadId = Event->NewThreadId;
+            Cpu->ProcessId = Event->NewProcessId;
+            Cpu->Valid = 1;
+
+            JsonEvent(Out,
+                      "{\"name\":\"CSwitch\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu,"
+                      "\"args\":{\"cpu\":%u,\"newTid\":%lu,\"newPid\":%lu,\"state\":%u,\"waitReason\":%u,"
+                      "\"priority\":%d}}",
+                      Time, (unsigned long)Event->OldProcessId, (unsigned long)Event->OldThreadId,
+                      Header->Processor, (unsigned long)Event->NewThreadId,
+                      (unsigned long)Event->NewProcessId, Event->OldThreadState,
+                      Event->OldWaitReason, Event->OldPriority);
+            break;
+        }
+
+        case PERFTRACE_EVENT_PAGE_FAULT:
+        {
+            PPERFTRACE_PAGE_FAULT_EVENT Event = (PPERFTRACE_PAGE_FAULT_EVENT)Header;
+            double Duration = TicksToMicroseconds(Event->Duration);
+
+            /* The event is logged when the fault has been handled */
+            JsonEvent(Out,
+                      "{\"name\":\"PageFault\",\"cat\":\"mm\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                      "\"pid\":%lu,\"tid\":%lu,\"args\":{\"address\":\"0x%llx\",\"code\":%lu,"
+                      "\"user\":%s,\"status\":\"0x%08lx\"}}",
+                      Time - Duration, Duration,
+                      (unsigned long)GetThreadOwner(Event->ThreadId), (unsigned long)Event->ThreadId,
+                      (unsigned long long)Event->Address, (unsigned long)Event->FaultCode,
+                      Event->Mode ? "true" : "false", (unsigned long)Event->Status);
+            break;
+        }
+
+        case PERFTRACE_EVENT_DISK_IO:
+        {
+            PPERFTRACE_DISK_IO_EVENT Event = (PPERFTRACE_DISK_IO_EVENT)Header;
+
+            JsonEvent(Out,
+                      "{\"name\":\"Disk%s\",\"cat\":\"io\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                      "\"pid\":%lu,\"tid\":%lu,\"args\":{\"device\":\"0x%llx\",\"offset\":%llu,"
+                      "\"length\":%lu,\"status\":\"0x%08lx\",\"irp\":\"0x%llx\"}}",
+                      (Event->MajorFunction == IRP_MJ_READ) ? "Read" : "Write", Time,
+                      (unsigned long)GetThreadOwner(Event->ThreadId), (unsigned long)Event->ThreadId,
+                      (unsigned long long)Event->DeviceObject, (unsigned long long)Event->ByteOffset,
+                      (unsigned long)Event->Length, (unsigned long)Event->Status,
+                      (unsigned long long)Event->Irp);
+            break;
+        }
+
+        case PERFTRACE_EVENT_REGISTRY:
+        {
+            PPERFTRACE_REGISTRY_EVENT Event = (PPERFTRACE_REGISTRY_EVENT)Header;
+            double Duration = TicksToMicroseconds(Event->Duration);
+
+            JsonEvent(Out,
+                      "{\"name\":\"%s\",\"cat\":\"registry\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                      "\"pid\":%lu,\"tid\":%lu,\"args\":{\"kcb\":\"0x%llx\",\"status\":\"0x%08lx\"}}",
+                      (Event->Operation < sizeof(RegistryOperations) / sizeof(RegistryOperations[0])) ?
+                          RegistryOperations[Event->Operation] : "Registry",
+                      Time - Duration, Duration,
+                      (unsigned long)Event->ProcessId, (unsigned long)Event->ThreadId,
+                      (unsigned long long)Event->KeyControlBlock, (unsigned long)Event->Status);
+            break;
+        }
+
+        case PERFTRACE_EVENT_PROCESS_CREATE:
+        case PERFTRACE_EVENT_PROCESS_EXIT:
+        {
+            PPERFTRACE_PROCESS_EVENT Event = (PPERFTRACE_PROCESS_EVENT)Header;
+
+            CopyImageName(Name, Event->ImageFileName);
+            if (Header->Type == PERFTRACE_EVENT_PROCESS_CREATE)
+            {
+                JsonEvent(Out,
+                          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,\"args\":{\"name\":\"%s\"}}",
+                          (unsigned long)Event->ProcessId, Name);
+            }
+
+            JsonEvent(Out,
+                      "{\"name\":\"Process%s\",\"cat\":\"ps\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%.3f,"
+                      "\"pid\":%lu,\"tid\":0,\"args\":{\"image\":\"%s\",\"parent\":%lu,\"status\":\"0x%08lx\"}}",
+                      (Header->Type == PERFTRACE_EVENT_PROCESS_CREATE) ? "Start" : "End", Time,
+                      (unsigned long)Event->ProcessId, Name, (unsigned long)Event->ParentId,
+                      (unsigned long)Event->ExitStatus);
+            break;
+        }
+
+        case PERFTRACE_EVENT_THREAD_CREATE:
+        case PERFTRACE_EVENT_THREAD_EXIT:
+        {
+            PPERFTRACE_THREAD_EVENT Event = (PPERFTRACE_THREAD_EVENT)Header;
+
+            SetThreadOwner(Event->ThreadId, Event->ProcessId);
+            JsonEvent(Out,
+                      "{\"name\":\"Thread%s\",\"cat\":\"ps\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                      "\"pid\":%lu,\"tid\":%lu,\"args\":{\"start\":\"0x%llx\",\"status\":\"0x%08lx\"}}",
+                      (Header->Type == PERFTRACE_EVENT_THREAD_CREATE) ? "Start" : "End", Time,
+                      (unsigned long)Event->ProcessId, (unsigned long)Event->ThreadId,
+                      (unsigned long long)Event->StartAddress, (unsigned long)Event->ExitStatus);
+            break;
+        }
+    }
+}
+
+static
+void
+NameCpuTracks(FILE *Out, ULONG NumberOfCpus)
+{
+    ULONG i;
+
+    JsonEvent(Out,
+              "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,\"args\":{\"name\":\"Processors\"}}",
+              (unsigned long)CPU_TRACK_PID);
+    for (i = 0; i < NumberOfCpus; i++)
+    {
+        JsonEvent(Out,
+                  "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%lu,\"args\":{\"name\":\"CPU %lu\"}}",
+                  (unsigned long)CPU_TRACK_PID, (unsigned long)i, (unsigned long)i);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    PPERFTRACE_BUFFER_HEADER Chunk;
+    PPERFTRACE_EVENT_HEADER Header;
+    PEVENT_ENTRY Events;
+    PCPU_STATE Cpus = NULL;
+    PUCHAR Data;
+    FILE *In, *Out = stdout;
+    long Size;
+    size_t Offset, Position;
+    ULONG Count = 0, Lost = 0, NumberOfCpus = 0, i;
+    int Json = 0, arg = 1;
+
+    if (arg < argc && !strcmp(argv[arg], "-j"))
+    {
+        Json = 1;
+        arg++;
+    }
+
+    if (arg >= argc || argc - arg > 2)
+    {
+        Usage();
+        return 1;
+    }
+
+    /* Traces are small enough to be read in one go */
+    In = fopen(argv[arg], "rb");
+    if (!In)
+    {
+        fprintf(stderr, "ktrdump: cannot open %s\n", argv[arg]);
+        return 1;
+    }
+    fseek(In, 0, SEEK_END);
+    Size = ftell(In);
+    fseek(In, 0, SEEK_SET);
+
+    Data = malloc(Size ? Size : 1);
+    if (!Data || fread(Data, 1, Size, In) != (size_t)Size)
+    {
+        fprintf(stderr, "ktrdump: cannot read %s\n", argv[arg]);
+        fclose(In);
+        return 1;
+    }
+    fclose(In);
+
+    /* Every record takes at least a header, so this is always enough */
+    Events = malloc((Size / sizeof(PERFTRACE_EVENT_HEADER) + 1) * sizeof(EVENT_ENTRY));
+    if (!Events) return 1;
+
+    for (Offset = 0; Offset + sizeof(PERFTRACE_BUFFER_HEADER) <= (size_t)Size;
+         Offset += sizeof(PERFTRACE_BUFFER_HEADER) + Chunk->DataLength)
+    {
+        Chunk = (PPERFTRACE_BUFFER_HEADER)(Data + Offset);
+        if (Chunk->Magic != PERFTRACE_MAGIC || Chunk->Version != PERFTRACE_VERSION ||
+            Offset + sizeof(PERFTRACE_BUFFER_HEADER) + Chunk->DataLength > (size_t)Size)
+        {
+            fprintf(stderr, "ktrdump: %s is damaged at offset 0x%lx\n", argv[arg], (unsigned long)Offset);
+            break;
+        }
+
+        if (!Frequency) Frequency = (double)Chunk->TimestampFrequency;
+        if (Chunk->NumberOfProcessors > NumberOfCpus) NumberOfCpus = Chunk->NumberOfProcessors;
+        Lost += Chunk->EventsLost;
+
+        for (Position = 0; Position + sizeof(PERFTRACE_EVENT_HEADER) <= Chunk->DataLength;
+             Position += Header->Size)
+        {
+            Header = (PPERFTRACE_EVENT_HEADER)((PUCHAR)(Chunk + 1) + Position);
+            if (Header->Size < sizeof(PERFTRACE_EVENT_HEADER) || Position + Header->Size > Chunk->DataLength)
+            {
+                fprintf(stderr, "ktrdump: bad record at offset 0x%lx\n",
+                        (unsigned long)(Offset + sizeof(PERFTRACE_BUFFER_HEADER) + Position));
+                break;
+            }
+
+            Events[Count].Timestamp = Header->Timestamp;
+            Events[Count].Sequence = Count;
+            Events[Count].Header = Header;
+            Count++;
+        }
+    }
+
+    qsort(Events, Count, sizeof(EVENT_ENTRY), CompareEvents);
+    BaseTime = Count ? Events[0].Timestamp : 0;
+
+    if (arg + 1 < argc)
+    {
+        Out = fopen(argv[arg + 1], "w");
+        if (!Out)
+        {
+            fprintf(stderr, "ktrdump: cannot create %s\n", argv[arg + 1]);
+            return 1;
+        }
+    }
+
+    if (Json)
+    {
+        Cpus = calloc(NumberOfCpus ? NumberOfCpus : 1, sizeof(CPU_STATE));
+        if (!Cpus) return 1;
+
+        fprintf(Out, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"eventsLost\":%lu},\"traceEvents\":[",
+                (unsigned long)Lost);
+        NameCpuTracks(Out, NumberOfCpus);
+        for (i = 0; i < Count; i++) DumpJson(Out, Events[i].Header, Cpus, NumberOfCpus);
+        fprintf(Out, "\n]}\n");
+    }
+    else
+    {
+        fprintf(Out, "%lu events on %lu processors, %lu lost, %s\n",
+                (unsigned long)Count, (unsigned long)NumberOfCpus, (unsigned long)Lost,
+                Frequency ? "times in microseconds" : "times in ticks");
+        for (i = 0; i < Count; i++) DumpTimeline(Out, Events[i].Header);
+    }
+
+    if (Out != stdout) fclose(Out);
+    free(Cpus);
+    free(Events);
+    free(Data);
+    free(ThreadOwners);
+    return 0;
+}
@@ -30,29 +30,495 @@
 
 #include "mkhive.h"
 
+/* Bins are emitted with this size, unless a cell needs a bigger one */
+#define BIN_SIZE            (16 * HBLOCK_SIZE)
+
+/* Same rounding as HvAllocateCell */
+#define CELL_ALIGNMENT      16
+
+/* Same limits as the ones CmpAddSubKey converts or splits a leaf at */
+#define MAX_FAST_INDEX_PER_LEAF                         \
+    ((HBLOCK_SIZE - (sizeof(HBIN) + sizeof(HCELL) +     \
+                     FIELD_OFFSET(CM_KEY_FAST_INDEX, List))) / sizeof(CM_INDEX))
+
+#define MAX_INDEX_PER_LEAF                              \
+    ((HBLOCK_SIZE - (sizeof(HBIN) + sizeof(HCELL) +     \
+                     FIELD_OFFSET(CM_KEY_INDEX, List))) / sizeof(HCELL_INDEX) - 1)
+
+/*
+ * The hive is written in two walks over the staging hive that allocate the
+ * very same cells: the first one only lays them out, which gives the size of
+ * the file and the new index of every key, the second one fills them in a
+ * buffer of that size. Keys are stored depth-first, each one followed by its
+ * values and its subkey index, and bins never need to grow.
+ */
+typedef struct _HIVE_WRITER
+{
+    PHHIVE Hive;            /* Staging hive being exported */
+    PUCHAR Bins;            /* Output bins, NULL while laying them out */
+    ULONG BinOffset;        /* Current bin */
+    ULONG BinEnd;
+    ULONG Offset;           /* Next free cell in the current bin */
+    PHCELL_INDEX CellMap;   /* New index of the staging key and security cells */
+    ULONG KeyCount;
+    ULONG ValueCount;
+} HIVE_WRITER, *PHIVE_WRITER;
+
+#define CELL_MAP_INDEX(Cell) ((Cell) / 8)
+
+/* FUNCTIONS ****************************************************************/
+
+static VOID
+BinCloseBin(
+    IN PHIVE_WRITER Writer,
+    IN BOOLEAN LastBin)
+{
+    PHBIN Bin;
+    PHCELL FreeCell;
+
+    /* Do not waste a whole bin at the end of the file */
+    if (LastBin)
+    {
+        Writer->BinEnd = Writer->BinOffset +
+                         ROUND_UP(Writer->Offset - Writer->BinOffset, HBLOCK_SIZE);
+    }
+
+    if (!Writer->Bins)
+        return;
+
+    Bin = (PHBIN)(Writer->Bins + Writer->BinOffset);
+    Bin->Size = Writer->BinEnd - Writer->BinOffset;
+
+    /* What is left of the bin becomes a free cell */
+    if (Writer->Offset < Writer->BinEnd)
+    {
+        FreeCell = (PHCELL)(Writer->Bins + Writer->Offset);
+        FreeCell->Size = (LONG)(Writer->BinEnd - Writer->Offset);
+    }
+}
+
+static PVOID
+BinAllocateCell(
+    IN PHIVE_WRITER Writer,
+    IN ULONG Size,
+    OUT PHCELL_INDEX Cell)
+{
+    PHBIN Bin;
+    PHCELL CellHeader;
+    ULONG BinSize;
+
+    Size = ROUND_UP(Size + sizeof(HCELL), CELL_ALIGNMENT);
+
+    if (Writer->Offset + Size > Writer->BinEnd)
+    {
+        if (Writer->BinEnd != 0)
+            BinCloseBin(Writer, FALSE);
+
+        BinSize = ROUND_UP(Size + sizeof(HBIN), HBLOCK_SIZE);
+        if (BinSize < BIN_SIZE)
+            BinSize = BIN_SIZE;
+
+        Writer->BinOffset = Writer->BinEnd;
+        Writer->BinEnd += BinSize;
+        Writer->Offset = Writer->BinOffset + sizeof(HBIN);
+
+        if (Writer->Bins)
+        {
+            Bin = (PHBIN)(Writer->Bins + Writer->BinOffset);
+            Bin->Signature = HV_BIN_SIGNATURE;
+            Bin->FileOffset = Writer->BinOffset;
+            Bin->Size = BinSize;
+        }
+    }
+
+    *Cell = Writer->Offset;
+    Writer->Offset += Size;
+
+    if (!Writer->Bins)
+        return NULL;
+
+    CellHeader = (PHCELL)(Writer->Bins + *Cell);
+    CellHeader->Size = -(LONG)Size;
+    return CellHeader + 1;
+}
+
+static VOID
+BinWriteSecurity(
+    IN PHIVE_WRITER Writer,
+    IN HCELL_INDEX FirstCell)
+{
+    PCM_KEY_SECURITY Security, NewSecurity;
+    HCELL_INDEX Cell = FirstCell;
+    ULONG Size;
+
+    /* All the security cells of a hive are linked together */
+    do
+    {
+        Security = (PCM_KEY_SECURITY)HvGetCell(Writer->Hive, Cell);
+        Size = FIELD_OFFSET(CM_KEY_SECURITY, Descriptor) + Security->DescriptorLength;
+
+        NewSecurity = BinAllocateCell(Writer, Size, &Writer->CellMap[CELL_MAP_INDEX(Cell)]);
+        if (NewSecurity)
+        {
+            RtlCopyMemory(NewSecurity, Security, Size);
+            NewSecurity->Flink = Writer->CellMap[CELL_MAP_INDEX(Security->Flink)];
+            NewSecurity->Blink = Writer->CellMap[CELL_MAP_INDEX(Security->Blink)];
+
+            /* Counted again while the keys are written */
+            NewSecurity->ReferenceCount = 0;
+        }
+
+        Cell = Security->Flink;
+    } while (Cell != FirstCell);
+}
+
+static HCELL_INDEX
+BinWriteValue(
+    IN PHIVE_WRITER Writer,
+    IN HCELL_INDEX Cell)
+{
+    PCM_KEY_VALUE Value, NewValue;
+    HCELL_INDEX NewCell, DataCell;
+    PVOID Data;
+    ULONG Size;
+
+    Value = (PCM_KEY_VALUE)HvGetCell(Writer->Hive, Cell);
+    Size = FIELD_OFFSET(CM_KEY_VALUE, Name) + Value->NameLength;
+
+    NewValue = BinAllocateCell(Writer, Size, &NewCell);
+    if (NewValue)
+    {
+        RtlCopyMemory(NewValue, Value, Size);
+        if (Value->DataLength == 0)
+            NewValue->Data = HCELL_NIL;
+    }
+    Writer->ValueCount++;
+
+    /* Small data is stored in the value cell itself */
+    if (!(Value->DataLength & CM_KEY_VALUE_SPECIAL_SIZE) && Value->DataLength != 0)
+    {
+        Data = BinAllocateCell(Writer, Value->DataLength, &DataCell);
+        if (Data)
+        {
+            RtlCopyMemory(Data, HvGetCell(Writer->Hive, Value->Data), Value->DataLength);
+            NewValue->Data = DataCell;
+        }
+    }
+
+    return NewCell;
+}
+
+static HCELL_INDEX
+BinWriteLeaf(
+    IN PHIVE_WRITER Writer,
+    IN PCM_KEY_NODE KeyNode,
+    IN USHORT Signature,
+    IN ULONG First,
+    IN ULONG Count)
+{
+    PCM_KEY_INDEX Leaf;
+    PCM_KEY_FAST_INDEX FastLeaf;
+    PCM_KEY_NODE SubKeyNode;
+    HCELL_INDEX LeafCell, SubKeyCell;
+    WCHAR NameBuffer[256];
+    UNICODE_STRING Name;
+    ULONG EntrySize, i, j;
+
+    EntrySize = (Signature == CM_KEY_INDEX_LEAF) ? sizeof(HCELL_INDEX) : sizeof(CM_INDEX);
+
+    Leaf = BinAllocateCell(Writer,
+                           FIELD_OFFSET(CM_KEY_INDEX, List) + Count * EntrySize,
+                           &LeafCell);
+    if (!Leaf)
+        return LeafCell;
+
+    Leaf->Signature = Signature;
+    Leaf->Count = (USHORT)Count;
+    FastLeaf = (PCM_KEY_FAST_INDEX)Leaf;
+
+    /* CmpAddSubKey kept the staging index sorted, so this one is too */
+    for (i = 0; i < Count; i++)
+    {
+        SubKeyCell = CmpFindSubKeyByNumber(Writer->Hive, KeyNode, First + i);
+
+        if (Signature == CM_KEY_INDEX_LEAF)
+        {
+            Leaf->List[i] = Writer->CellMap[CELL_MAP_INDEX(SubKeyCell)];
+            continue;
+        }
+
+        FastLeaf->List[i].Cell = Writer->CellMap[CELL_MAP_INDEX(SubKeyCell)];
+
+        SubKeyNode = (PCM_KEY_NODE)HvGetCell(Writer->Hive, SubKeyCell);
+        if (SubKeyNode->Flags & KEY_COMP_NAME)
+        {
+            Name.Length = CmpCompressedNameSize(SubKeyNode->Name, SubKeyNode->NameLength);
+            CmpCopyCompressedName(NameBuffer, sizeof(NameBuffer),
+                                  SubKeyNode->Name, SubKeyNode->NameLength);
+            Name.Buffer = NameBuffer;
+        }
+        else
+        {
+            Name.Length = SubKeyNode->NameLength;
+            Name.Buffer = SubKeyNode->Name;
+        }
+        Name.MaximumLength = Name.Length;
+
+        if (Signature == CM_KEY_HASH_LEAF)
+        {
+            FastLeaf->List[i].HashKey = CmpComputeHashKey(0, &Name, FALSE);
+            continue;
+        }
+
+        /* Same name hint as CmpAddToLeaf */
+        j = min(Name.Length / sizeof(WCHAR), 4);
+        for (; j > 0; j--)
+        {
+            if ((USHORT)Name.Buffer[j - 1] > (UCHAR)-1)
+                break;
+            FastLeaf->List[i].NameHint[j - 1] = (UCHAR)Name.Buffer[j - 1];
+        }
+    }
+
+    return LeafCell;
+}
+
+static HCELL_INDEX
+BinWriteIndex(
+    IN PHIVE_WRITER Writer,
+    IN PCM_KEY_NODE KeyNode)
+{
+    ULONG Count = KeyNode->SubKeyCounts[Stable];
+    PCM_KEY_INDEX Root;
+    HCELL_INDEX RootCell, LeafCell;
+    USHORT Signature;
+    ULONG LeafCount, i;
+
+    /* Use the leaves CmpAddSubKey would have used for this hive version */
+    if (Writer->Hive->Version >= 5)
+        Signature = CM_KEY_HASH_LEAF;
+    else if (Count <= MAX_FAST_INDEX_PER_LEAF)
+        Signature = CM_KEY_FAST_LEAF;
+    else
+        Signature = CM_KEY_INDEX_LEAF;
+
+    if (Count <= MAX_INDEX_PER_LEAF)
+        return BinWriteLeaf(Writer, KeyNode, Signature, 0, Count);
+
+    /* Spread the subkeys evenly over leaves below an index root */
+    LeafCount = (Count + MAX_INDEX_PER_LEAF - 1) / MAX_INDEX_PER_LEAF;
+
+    Root = BinAllocateCell(Writer,
+                           FIELD_OFFSET(CM_KEY_INDEX, List) + LeafCount * sizeof(HCELL_INDEX),
+                           &RootCell);
+    if (Root)
+    {
+        Root->Signature = CM_KEY_INDEX_ROOT;
+        Root->Count = (USHORT)LeafCount;
+    }
+
+    for (i = 0; i < LeafCount; i++)
+    {
+        LeafCell = BinWriteLeaf(Writer,
+                                KeyNode,
+                                Signature,
+                                i * Count / LeafCount,
+                                (i + 1) * Count / LeafCount - i * Count / LeafCount);
+        if (Root)
+            Root->List[i] = LeafCell;
+    }
+
+    return RootCell;
+}
+
+static HCELL_INDEX
+BinWriteKey(
+    IN PHIVE_WRITER Writer,
+    IN HCELL_INDEX Cell,
+    IN HCELL_INDEX Parent)
+{
+    PHHIVE Hive = Writer->Hive;
+    PCM_KEY_NODE KeyNode, NewKeyNode;
+    PCM_KEY_SECURITY NewSecurity;
+    PCELL_DATA ValueList;
+    PHCELL_INDEX NewValueList;
+    HCELL_INDEX NewCell, ListCell, ValueCell;
+    PVOID Class;
+    ULONG Size, i;
+
+    KeyNode = (PCM_KEY_NODE)HvGetCell(Hive, Cell);
+    Size = FIELD_OFFSET(CM_KEY_NODE, Name) + KeyNode->NameLength;
+
+    NewKeyNode = BinAllocateCell(Writer, Size, &NewCell);
+    Writer->CellMap[CELL_MAP_INDEX(Cell)] = NewCell;
+    Writer->KeyCount++;
+
+    if (NewKeyNode)
+    {
+        RtlCopyMemory(NewKeyNode, KeyNode, Size);
+        NewKeyNode->Parent = Parent;
+
+        /* Volatile keys are not saved */
+        NewKeyNode->SubKeyCounts[Volatile] = 0;
+        NewKeyNode->SubKeyLists[Volatile] = HCELL_NIL;
+        NewKeyNode->SubKeyLists[Stable] = HCELL_NIL;
+        NewKeyNode->ValueList.List = HCELL_NIL;
+        NewKeyNode->Class = HCELL_NIL;
+
+        if (KeyNode->Security != HCELL_NIL)
+        {
+            NewKeyNode->Security = Writer->CellMap[CELL_MAP_INDEX(KeyNode->Security)];
+            NewSecurity = (PCM_KEY_SECURITY)(Writer->Bins + NewKeyNode->Security + sizeof(HCELL));
+            NewSecurity->ReferenceCount++;
+        }
+    }
+
+    if (KeyNode->Class != HCELL_NIL && KeyNode->ClassLength != 0)
+    {
+        Class = BinAllocateCell(Writer, KeyNode->ClassLength, &ListCell);
+        if (Class)
+        {
+            RtlCopyMemory(Class, HvGetCell(Hive, KeyNode->Class), KeyNode->ClassLength);
+            NewKeyNode->Class = ListCell;
+        }
+    }
+
+    if (KeyNode->ValueList.Count != 0)
+    {
+        ValueList = (PCELL_DATA)HvGetCell(Hive, KeyNode->ValueList.List);
+
+        NewValueList = BinAllocateCell(Writer,
+                                       KeyNode->ValueList.Count * sizeof(HCELL_INDEX),
+                                       &ListCell);
+        if (NewValueList)
+            NewKeyNode->ValueList.List = ListCell;
+
+        for (i = 0; i < KeyNode->ValueList.Count; i++)
+        {
+            ValueCell = BinWriteValue(Writer, ValueList->u.KeyList[i]);
+            if (NewValueList)
+                NewValueList[i] = ValueCell;
+        }
+    }
+
+    if (KeyNode->SubKeyCounts[Stable] != 0)
+    {
+        ListCell = BinWriteIndex(Writer, KeyNode);
+        if (NewKeyNode)
+            NewKeyNode->SubKeyLists[Stable] = ListCell;
+
+        for (i = 0; i < KeyNode->SubKeyCounts[Stable]; i++)
+        {
+            BinWriteKey(Writer, CmpFindSubKeyByNumber(Hive, KeyNode, i), NewCell);
+        }
+    }
+
+    return NewCell;
+}
+
+static HCELL_INDEX
+BinWriteHive(
+    IN PHIVE_WRITER Writer,
+    IN PUCHAR Bins)
+{
+    PCM_KEY_NODE RootNode;
+    HCELL_INDEX RootCell;
+
+    Writer->Bins = Bins;
+    Writer->BinOffset = Writer->BinEnd = Writer->Offset = 0;
+    Writer->KeyCount = Writer->ValueCount = 0;
+
+    RootNode = (PCM_KEY_NODE)HvGetCell(Writer->Hive, Writer->Hive->BaseBlock->RootCell);
+    if (RootNode->Security != HCELL_NIL)
+        BinWriteSecurity(Writer, RootNode->Security);
+
+    RootCell = BinWriteKey(Writer, Writer->Hive->BaseBlock->RootCell, RootNode->Parent);
+    BinCloseBin(Writer, TRUE);
+
+    return RootCell;
+}
+
 BOOL
 ExportBinaryHive(
     IN PCSTR FileName,
-    IN PCMHIVE CmHive)
+    IN PCMHIVE CmHive,
+    OUT PULONG FileSize OPTIONAL)
 {
+    HIVE_WRITER Writer;
+    PHBASE_BLOCK BaseBlock;
+    PUCHAR Buffer;
+    HCELL_INDEX RootCell;
+    SIZE_T CellMapSize;
+    ULONG Length;
     FILE *File;
     BOOL ret;
 
     printf("  Creating binary hive: %s\n", FileName);
 
+    Writer.Hive = &CmHive->Hive;
+    CellMapSize = CELL_MAP_INDEX(Writer.Hive->Storage[Stable].Length * HBLOCK_SIZE) *
+                  sizeof(HCELL_INDEX);
+    Writer.CellMap = malloc(CellMapSize);
+    if (Writer.CellMap == NULL)
+    {
+        printf("    Out of memory\n");
+        return FALSE;
+    }
+    memset(Writer.CellMap, 0xFF, CellMapSize);
+
+    /* Lay the hive out, then fill a buffer of the right size */
+    BinWriteHive(&Writer, NULL);
+    Length = Writer.BinEnd;
+
+    Buffer = calloc(1, HBLOCK_SIZE + Length);
+    if (Buffer == NULL)
+    {
+        printf("    Out of memory\n");
+        free(Writer.CellMap);
+        return FALSE;
+    }
+
+    RootCell = BinWriteHive(&Writer, Buffer + HBLOCK_SIZE);
+    ASSERT(Writer.BinEnd == Length);
+
+    BaseBlock = (PHBASE_BLOCK)Buffer;
+    RtlCopyMemory(BaseBlock, Writer.Hive->BaseBlock, sizeof(HBASE_BLOCK));
+    BaseBlock->Sequence1++;
+    BaseBlock->Sequence2 = BaseBlock->Sequence1;
+    KeQuerySystemTime(&BaseBlock->TimeStamp);
+    BaseBlock->Type = HFILE_TYPE_PRIMARY;
+    BaseBlock->RootCell = RootCell;
+    BaseBlock->Length = Length;
+    BaseBlock->CheckSum = HvpHiveHeaderChecksum(BaseBlock);
+
     /* Create new hive file */
     File = fopen(FileName, "wb");
     if (File == NULL)
     {
         printf("    Error creating/opening file\n");
+        free(Buffer);
+        free(Writer.CellMap);
         return FALSE;
     }
 
-    fseek(File, 0, SEEK_SET);
-
-    CmHive->FileHandles[HFILE_TYPE_PRIMARY] = (HANDLE)File;
-    ret = HvWriteHive(&CmHive->Hive);
+    ret = (fwrite(Buffer, 1, HBLOCK_SIZE + Length, File) == HBLOCK_SIZE + Length);
     fclose(File);
+
+    if (ret)
+    {
+        printf("    %u keys, %u values, %u bytes\n",
+               (ULONG)Writer.KeyCount, (ULONG)Writer.ValueCount, (ULONG)(HBLOCK_SIZE + Length));
+    }
+    else
+    {
+        printf("    Error writing file\n");
+    }
+
+    if (FileSize)
+        *FileSize = HBLOCK_SIZE + Length;
+
+    free(Buffer);
+    free(Writer.CellMap);
     return ret;
 }
 
@@ -29,6 +29,7 @@
 BOOL
 ExportBinaryHive(
     IN PCSTR FileName,
-    IN PCMHIVE Hive);
+    IN PCMHIVE Hive,
+    OUT PULONG FileSize OPTIONAL);
 
 /* EOF */
@@ -28,6 +28,7 @@
 #include <limits.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "mkhive.h"
 
@@ -83,9 +84,31 @@ void convert_path(char *dst, char *src)
     dst[i] = 0;
 }
 
+static const struct
+{
+    PCSTR FileName;
+    PCMHIVE Hive;
+} Hives[] =
+{
+    { "default",  &DefaultHive },
+    { "sam",      &SamHive },
+    { "security", &SecurityHive },
+    { "software", &SoftwareHive },
+    { "system",   &SystemHive },
+    { "BCD",      &BcdHive },
+};
+
+static double
+elapsed_seconds(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
 int main (int argc, char *argv[])
 {
     char FileName[PATH_MAX];
+    clock_t StartTime, ImportTime;
+    ULONG HiveSize, TotalSize;
     int i;
 
     if (argc < 3)
@@ -96,6 +119,8 @@ int main (int argc, char *argv[])
 
     printf ("Binary hive maker\n");
 
+    StartTime = clock ();
+
     RegInitializeRegistry ();
 
     for (i = 2; i < argc; i++)
@@ -107,57 +132,28 @@ int main (int argc, char *argv[])
         }
     }
 
-    convert_path (FileName, argv[1]);
-    strcat (FileName, DIR_SEPARATOR_STRING);
-    strcat (FileName, "default");
-    if (!ExportBinaryHive (FileName, &DefaultHive))
-    {
-        return 1;
-    }
+    printf ("  Imported %d inf files in %.2f s\n", argc - 2, elapsed_seconds (StartTime));
 
-    convert_path (FileName, argv[1]);
-    strcat (FileName, DIR_SEPARATOR_STRING);
-    strcat (FileName, "sam");
-    if (!ExportBinaryHive (FileName, &SamHive))
-    {
-        return 1;
-    }
+    ImportTime = clock ();
+    TotalSize = 0;
 
-    convert_path (FileName, argv[1]);
-    strcat (FileName, DIR_SEPARATOR_STRING);
-    strcat (FileName, "security");
-    if (!ExportBinaryHive (FileName, &SecurityHive))
+    for (i = 0; i < sizeof(Hives) / sizeof(Hives[0]); i++)
     {
-        return 1;
-    }
-
-    convert_path (FileName, argv[1]);
-    strcat (FileName, DIR_SEPARATOR_STRING);
-    strcat (FileName, "software");
-    if (!ExportBinaryHive (FileName, &SoftwareHive))
-    {
-        return 1;
-    }
-
-    convert_path (FileName, argv[1]);
-    strcat (FileName, DIR_SEPARATOR_STRING);
-    strcat (FileName, "system");
-    if (!ExportBinaryHive (FileName, &SystemHive))
-    {
-        return 1;
+        convert_path (FileName, argv[1]);
+        strcat (FileName, DIR_SEPARATOR_STRING);
+        strcat (FileName, Hives[i].FileName);
+        if (!ExportBinaryHive (FileName, Hives[i].Hive, &HiveSize))
+        {
+            return 1;
+        }
+        TotalSize += HiveSize;
     }
 
-    convert_path (FileName, argv[1]);
-    strcat (FileName, DIR_SEPARATOR_STRING);
-    strcat (FileName, "BCD");
-    if (!ExportBinaryHive (FileName, &BcdHive))
-    {
-        return 1;
-    }
+    printf ("  Wrote %u bytes of hives in %.2f s\n", (ULONG)TotalSize, elapsed_seconds (ImportTime));
 
     RegShutdownRegistry ();
 
-    printf ("  Done.\n");
+    printf ("  Done in %.2f s.\n", elapsed_seconds (StartTime));
 
     return 0;
 }
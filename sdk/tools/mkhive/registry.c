@@ -348,6 +348,119 @@ CreateInMemoryStructure(
 
 LIST_ENTRY CmiReparsePointsHead;
 
+/*
+ * Cache of the key path components resolved so far. The INF files open keys
+ * by their full path, one line at a time, so the same parents are looked up
+ * over and over; an entry maps a parent key and a component name to the
+ * (reparsed) child key.
+ */
+typedef struct _KEY_CACHE_ENTRY
+{
+    struct _KEY_CACHE_ENTRY *Next;
+    ULONG Hash;
+    PCMHIVE ParentHive;
+    HCELL_INDEX ParentCellOffset;
+    PCMHIVE RegistryHive;
+    HCELL_INDEX KeyCellOffset;
+    USHORT NameLength;
+    WCHAR Name[ANYSIZE_ARRAY];
+} KEY_CACHE_ENTRY, *PKEY_CACHE_ENTRY;
+
+#define KEY_CACHE_BUCKETS 4096
+
+static PKEY_CACHE_ENTRY KeyCache[KEY_CACHE_BUCKETS];
+
+static ULONG
+RegpHashKeyName(
+    IN PCMHIVE ParentHive,
+    IN HCELL_INDEX ParentCellOffset,
+    IN PCUNICODE_STRING KeyName)
+{
+    return CmpComputeHashKey((ULONG)(ULONG_PTR)ParentHive ^ ParentCellOffset,
+                             KeyName,
+                             FALSE);
+}
+
+static PKEY_CACHE_ENTRY
+RegpLookupKeyCache(
+    IN ULONG Hash,
+    IN PCMHIVE ParentHive,
+    IN HCELL_INDEX ParentCellOffset,
+    IN PCUNICODE_STRING KeyName)
+{
+    PKEY_CACHE_ENTRY Entry;
+    USHORT i;
+
+    for (Entry = KeyCache[Hash % KEY_CACHE_BUCKETS]; Entry; Entry = Entry->Next)
+    {
+        if (Entry->Hash != Hash ||
+            Entry->ParentHive != ParentHive ||
+            Entry->ParentCellOffset != ParentCellOffset ||
+            Entry->NameLength != KeyName->Length)
+        {
+            continue;
+        }
+
+        for (i = 0; i < KeyName->Length / sizeof(WCHAR); i++)
+        {
+            if (RtlUpcaseUnicodeChar(Entry->Name[i]) !=
+                RtlUpcaseUnicodeChar(KeyName->Buffer[i]))
+            {
+                break;
+            }
+        }
+
+        if (i == KeyName->Length / sizeof(WCHAR))
+            return Entry;
+    }
+
+    return NULL;
+}
+
+static VOID
+RegpInsertKeyCache(
+    IN ULONG Hash,
+    IN PCMHIVE ParentHive,
+    IN HCELL_INDEX ParentCellOffset,
+    IN PCUNICODE_STRING KeyName,
+    IN PCMHIVE RegistryHive,
+    IN HCELL_INDEX KeyCellOffset)
+{
+    PKEY_CACHE_ENTRY Entry;
+
+    /* The cache is only an accelerator, just skip it when out of memory */
+    Entry = (PKEY_CACHE_ENTRY)malloc(FIELD_OFFSET(KEY_CACHE_ENTRY, Name) + KeyName->Length);
+    if (!Entry)
+        return;
+
+    Entry->Hash = Hash;
+    Entry->ParentHive = ParentHive;
+    Entry->ParentCellOffset = ParentCellOffset;
+    Entry->RegistryHive = RegistryHive;
+    Entry->KeyCellOffset = KeyCellOffset;
+    Entry->NameLength = KeyName->Length;
+    memcpy(Entry->Name, KeyName->Buffer, KeyName->Length);
+
+    Entry->Next = KeyCache[Hash % KEY_CACHE_BUCKETS];
+    KeyCache[Hash % KEY_CACHE_BUCKETS] = Entry;
+}
+
+static VOID
+RegpFlushKeyCache(VOID)
+{
+    PKEY_CACHE_ENTRY Entry;
+    ULONG i;
+
+    for (i = 0; i < KEY_CACHE_BUCKETS; i++)
+    {
+        while ((Entry = KeyCache[i]) != NULL)
+        {
+            KeyCache[i] = Entry->Next;
+            free(Entry);
+        }
+    }
+}
+
 static LONG
 RegpOpenOrCreateKey(
     IN HKEY hParentKey,
@@ -363,11 +476,13 @@ RegpOpenOrCreateKey(
     PREPARSE_POINT CurrentReparsePoint;
     PMEMKEY CurrentKey;
     PCMHIVE ParentRegistryHive;
+    PCMHIVE RegistryHive;
     HCELL_INDEX ParentCellOffset;
     PCM_KEY_NODE ParentKeyCell;
     PLIST_ENTRY Ptr;
-    PCM_KEY_NODE SubKeyCell;
     HCELL_INDEX BlockOffset;
+    PKEY_CACHE_ENTRY CacheEntry;
+    ULONG Hash;
 
     DPRINT("RegpCreateOpenKey('%S')\n", KeyName);
 
@@ -408,12 +523,27 @@ RegpOpenOrCreateKey(
             }
         }
 
+        /* Most keys were already walked through, try the cache first */
+        Hash = RegpHashKeyName(ParentRegistryHive, ParentCellOffset, &KeyString);
+        CacheEntry = RegpLookupKeyCache(Hash, ParentRegistryHive, ParentCellOffset, &KeyString);
+        if (CacheEntry)
+        {
+            ParentRegistryHive = CacheEntry->RegistryHive;
+            ParentCellOffset = CacheEntry->KeyCellOffset;
+            if (End)
+                LocalKeyName = End + 1;
+            else
+                break;
+            continue;
+        }
+
         ParentKeyCell = (PCM_KEY_NODE)HvGetCell(&ParentRegistryHive->Hive, ParentCellOffset);
         if (!ParentKeyCell)
             return STATUS_UNSUCCESSFUL;
 
         VERIFY_KEY_CELL(ParentKeyCell);
 
+        RegistryHive = ParentRegistryHive;
         BlockOffset = CmpFindSubKeyByName(&ParentRegistryHive->Hive, ParentKeyCell, &KeyString);
         if (BlockOffset != HCELL_NIL)
         {
@@ -427,7 +557,7 @@ RegpOpenOrCreateKey(
                 if (CurrentReparsePoint->SourceHive == ParentRegistryHive &&
                     CurrentReparsePoint->SourceKeyCellOffset == BlockOffset)
                 {
-                    ParentRegistryHive = CurrentReparsePoint->DestinationHive;
+                    RegistryHive = CurrentReparsePoint->DestinationHive;
                     BlockOffset = CurrentReparsePoint->DestinationKeyCellOffset;
                     break;
                 }
@@ -442,12 +572,24 @@ RegpOpenOrCreateKey(
                                   Volatile,
                                   &BlockOffset);
         }
+        else
+        {
+            Status = STATUS_OBJECT_NAME_NOT_FOUND;
+        }
 
         HvReleaseCell(&ParentRegistryHive->Hive, ParentCellOffset);
 
         if (!NT_SUCCESS(Status))
             return ERROR_UNSUCCESSFUL;
 
+        RegpInsertKeyCache(Hash,
+                           ParentRegistryHive,
+                           ParentCellOffset,
+                           &KeyString,
+                           RegistryHive,
+                           BlockOffset);
+
+        ParentRegistryHive = RegistryHive;
         ParentCellOffset = BlockOffset;
         if (End)
             LocalKeyName = End + 1;
@@ -821,6 +963,9 @@ ConnectRegistry(
     ReparsePoint->DestinationHive = NewKey->RegistryHive;
     ReparsePoint->DestinationKeyCellOffset = NewKey->KeyCellOffset;
     InsertTailList(&CmiReparsePointsHead, &ReparsePoint->ListEntry);
+
+    /* The cache still resolves the path to the key we just redirected */
+    RegpFlushKeyCache();
     return TRUE;
 }
 
@@ -906,6 +1051,7 @@ RegInitializeRegistry(VOID)
     ReparsePoint->DestinationHive = ControlSetKey->RegistryHive;
     ReparsePoint->DestinationKeyCellOffset = ControlSetKey->KeyCellOffset;
     InsertTailList(&CmiReparsePointsHead, &ReparsePoint->ListEntry);
+    RegpFlushKeyCache();
 }
 
 VOID
@@ -913,6 +1059,7 @@ RegShutdownRegistry(VOID)
 {
     /* FIXME: clean up the complete hive */
 
+    RegpFlushKeyCache();
     free(RootKey);
 }
 
@@ -31,7 +31,16 @@ static DRVFN DrvFunctionTable[] =
    {INDEX_DrvGetModes, (PFN)DrvGetModes},
    {INDEX_DrvSetPalette, (PFN)DrvSetPalette},
    {INDEX_DrvSetPointerShape, (PFN)DrvSetPointerShape},
-   {INDEX_DrvMovePointer, (PFN)DrvMovePointer}
+   {INDEX_DrvMovePointer, (PFN)DrvMovePointer},
+   {INDEX_DrvBitBlt, (PFN)DrvBitBlt},
+   {INDEX_DrvCopyBits, (PFN)DrvCopyBits},
+   {INDEX_DrvStretchBltROP, (PFN)DrvStretchBltROP},
+   {INDEX_DrvPaint, (PFN)DrvPaint},
+   {INDEX_DrvLineTo, (PFN)DrvLineTo},
+   {INDEX_DrvAlphaBlend, (PFN)DrvAlphaBlend},
+   {INDEX_DrvTransparentBlt, (PFN)DrvTransparentBlt},
+   {INDEX_DrvGradientFill, (PFN)DrvGradientFill},
+   {INDEX_DrvSynchronizeSurface, (PFN)DrvSynchronizeSurface}
 
 };
 
@@ -91,6 +100,7 @@ DrvEnablePDEV(
    PPDEV ppdev;
    GDIINFO GdiInfo;
    DEVINFO DevInfo;
+   ULONG AccelerationLevel;
 
    ppdev = EngAllocMem(FL_ZERO_MEMORY, sizeof(PDEV), ALLOC_TAG);
    if (ppdev == NULL)
@@ -100,6 +110,18 @@ DrvEnablePDEV(
 
    ppdev->hDriver = hDriver;
 
+   /*
+    * Draw into a system memory shadow of the screen unless the user lowered
+    * the acceleration level of the display.
+    */
+
+   if (!EngQueryDeviceAttribute(hdev, QDA_ACCELERATION_LEVEL, NULL, 0,
+                                &AccelerationLevel, sizeof(ULONG)))
+   {
+      AccelerationLevel = 0;
+   }
+   ppdev->ShadowEnabled = (AccelerationLevel == 0);
+
    if (!IntInitScreenInfo(ppdev, pdm, &GdiInfo, &DevInfo))
    {
       EngFreeMem(ppdev);
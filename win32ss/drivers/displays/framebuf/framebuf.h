@@ -48,6 +48,18 @@ typedef struct _PDEV
    HPALETTE DefaultPalette;
    PALETTEENTRY *PaletteEntries;
 
+   /* Shadow framebuffer support */
+   BOOL ShadowEnabled;
+   HSURF hSurfShadow;
+   SURFOBJ *ShadowObj;
+   BOOL ShadowDirty;
+   RECTL DirtyRect;
+   ULONG FlushCount;
+   ULONGLONG FlushPixels;
+   LONGLONG FlushTime;
+   LONGLONG FlushTimeMax;
+   LONGLONG CounterFrequency;
+
 #ifdef EXPERIMENTAL_MOUSE_CURSOR_SUPPORT
    VIDEO_POINTER_ATTRIBUTES PointerAttributes;
    XLATEOBJ *PointerXlateObject;
@@ -70,6 +82,13 @@ typedef struct _PDEV
 #define DEVICE_NAME	L"framebuf"
 #define ALLOC_TAG	'FUBF'
 
+#define SHADOW_HOOKS	(HOOK_BITBLT | HOOK_COPYBITS | HOOK_STRETCHBLTROP | \
+			 HOOK_PAINT | HOOK_LINETO | HOOK_ALPHABLEND | \
+			 HOOK_TRANSPARENTBLT | HOOK_GRADIENTFILL | HOOK_SYNCHRONIZE)
+
+/* Number of flushes between two statistics dumps in checked builds */
+#define SHADOW_STATS_INTERVAL	1024
+
 
 DHPDEV APIENTRY
 DrvEnablePDEV(
@@ -160,4 +179,22 @@ IntSetPalette(
    IN ULONG iStart,
    IN ULONG cColors);
 
+HSURF
+ShadowEnable(
+   IN PPDEV ppdev,
+   IN SIZEL ScreenSize,
+   IN ULONG BitmapType);
+
+VOID
+ShadowDisable(
+   IN PPDEV ppdev);
+
+VOID
+ShadowInvalidate(
+   IN PPDEV ppdev);
+
+VOID
+ShadowFlush(
+   IN PPDEV ppdev);
+
 #endif /* _FRAMEBUF_PCH_ */
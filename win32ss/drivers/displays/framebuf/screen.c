@@ -306,7 +306,7 @@ IntInitScreenInfo(
    pDevInfo->cxDither = 0;
    pDevInfo->cyDither = 0;
    pDevInfo->hpalDefault = 0;
-   pDevInfo->flGraphicsCaps2 = 0;
+   pDevInfo->flGraphicsCaps2 = ppdev->ShadowEnabled ? GCAPS2_SYNCFLUSH : 0;
 
    if (ppdev->BitsPerPixel == 8)
    {
@@ -0,0 +1,576 @@
+/*
+ * PROJECT:     ReactOS Generic Framebuffer Display Driver
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     System memory shadow of the primary surface
+ * COPYRIGHT:   Copyright 2026 agent (agent@local)
+ */
+
+/*
+ * Shadow framebuffer
+ *
+ * When the shadow is enabled the primary surface is device managed and all
+ * drawing goes to a copy of the screen in system memory, so that operations
+ * reading the destination never touch the uncached video memory. Each hook
+ * below renders into the shadow with the matching Eng function, records the
+ * rectangle it touched and copies that rectangle to the frame buffer.
+ */
+
+#include "framebuf.h"
+
+#if DBG
+static VOID
+ShadowDebugPrint(
+   IN PCHAR Format,
+   ...)
+{
+   va_list ap;
+   va_start(ap, Format);
+   EngDebugPrint("FRAMEBUF: ", Format, ap);
+   va_end(ap);
+}
+#endif
+
+/*
+ * Returns the PDEV owning a device managed surface, or NULL if the surface
+ * is an engine bitmap.
+ */
+
+static PPDEV
+ShadowGetDevice(
+   IN SURFOBJ *pso)
+{
+   if (pso != NULL && pso->iType == STYPE_DEVICE)
+   {
+      return (PPDEV)pso->dhsurf;
+   }
+
+   return NULL;
+}
+
+static SURFOBJ *
+ShadowGetSurface(
+   IN SURFOBJ *pso)
+{
+   PPDEV ppdev = ShadowGetDevice(pso);
+
+   return (ppdev != NULL) ? ppdev->ShadowObj : pso;
+}
+
+/*
+ * Adds a rectangle, clipped to the clip bounds and the screen, to the area
+ * that has to be copied to video memory on the next flush.
+ */
+
+static VOID
+ShadowAddDirtyRect(
+   IN PPDEV ppdev,
+   IN CLIPOBJ *pco,
+   IN RECTL *prcl)
+{
+   RECTL Rect;
+
+   /* Stretching and line bounds may come in either order */
+   Rect.left = min(prcl->left, prcl->right);
+   Rect.right = max(prcl->left, prcl->right);
+   Rect.top = min(prcl->top, prcl->bottom);
+   Rect.bottom = max(prcl->top, prcl->bottom);
+
+   if (pco != NULL && pco->iDComplexity != DC_TRIVIAL)
+   {
+      Rect.left = max(Rect.left, pco->rclBounds.left);
+      Rect.top = max(Rect.top, pco->rclBounds.top);
+      Rect.right = min(Rect.right, pco->rclBounds.right);
+      Rect.bottom = min(Rect.bottom, pco->rclBounds.bottom);
+   }
+
+   Rect.left = max(Rect.left, 0);
+   Rect.top = max(Rect.top, 0);
+   Rect.right = min(Rect.right, (LONG)ppdev->ScreenWidth);
+   Rect.bottom = min(Rect.bottom, (LONG)ppdev->ScreenHeight);
+
+   if (Rect.left >= Rect.right || Rect.top >= Rect.bottom)
+   {
+      return;
+   }
+
+   if (!ppdev->ShadowDirty)
+   {
+      ppdev->DirtyRect = Rect;
+      ppdev->ShadowDirty = TRUE;
+   }
+   else
+   {
+      ppdev->DirtyRect.left = min(ppdev->DirtyRect.left, Rect.left);
+      ppdev->DirtyRect.top = min(ppdev->DirtyRect.top, Rect.top);
+      ppdev->DirtyRect.right = max(ppdev->DirtyRect.right, Rect.right);
+      ppdev->DirtyRect.bottom = max(ppdev->DirtyRect.bottom, Rect.bottom);
+   }
+}
+
+/*
+ * Copies the dirty rectangle from the shadow to video memory. The frame
+ * buffer is only ever written, one scanline after the other.
+ */
+
+VOID
+ShadowFlush(
+   IN PPDEV ppdev)
+{
+   ULONG BytesPerPixel;
+   ULONG LineBytes;
+   ULONG Lines;
+   PBYTE Source;
+   PBYTE Destination;
+   LONGLONG StartTime;
+   LONGLONG StopTime;
+
+   if (!ppdev->ShadowDirty)
+   {
+      return;
+   }
+
+   EngQueryPerformanceCounter(&StartTime);
+
+   BytesPerPixel = (ppdev->BitsPerPixel + 7) >> 3;
+   LineBytes = (ppdev->DirtyRect.right - ppdev->DirtyRect.left) * BytesPerPixel;
+   Lines = ppdev->DirtyRect.bottom - ppdev->DirtyRect.top;
+
+   Source = (PBYTE)ppdev->ShadowObj->pvScan0 +
+            ppdev->DirtyRect.top * ppdev->ShadowObj->lDelta +
+            ppdev->DirtyRect.left * BytesPerPixel;
+   Destination = (PBYTE)ppdev->ScreenPtr +
+                 ppdev->DirtyRect.top * ppdev->ScreenDelta +
+                 ppdev->DirtyRect.left * BytesPerPixel;
+
+   if (LineBytes == ppdev->ScreenDelta &&
+       ppdev->ShadowObj->lDelta == (LONG)ppdev->ScreenDelta)
+   {
+      /* Whole scanlines are contiguous on both sides */
+      memcpy(Destination, Source, LineBytes * Lines);
+   }
+   else
+   {
+      for (; Lines != 0; Lines--)
+      {
+         memcpy(Destination, Source, LineBytes);
+         Source += ppdev->ShadowObj->lDelta;
+         Destination += ppdev->ScreenDelta;
+      }
+   }
+
+   EngQueryPerformanceCounter(&StopTime);
+
+   /* Frame time statistics */
+   ppdev->FlushCount++;
+   ppdev->FlushPixels += (ULONGLONG)(ppdev->DirtyRect.right - ppdev->DirtyRect.left) *
+                         (ppdev->DirtyRect.bottom - ppdev->DirtyRect.top);
+   ppdev->FlushTime += StopTime - StartTime;
+   if (StopTime - StartTime > ppdev->FlushTimeMax)
+   {
+      ppdev->FlushTimeMax = StopTime - StartTime;
+   }
+
+#if DBG
+   if ((ppdev->FlushCount % SHADOW_STATS_INTERVAL) == 0 && ppdev->CounterFrequency != 0)
+   {
+      ShadowDebugPrint("%lu flushes, %I64u pixels, %I64u us average, %I64u us max\n",
+                       ppdev->FlushCount,
+                       ppdev->FlushPixels,
+                       (ULONGLONG)(ppdev->FlushTime * 1000000 / ppdev->CounterFrequency) /
+                          ppdev->FlushCount,
+                       (ULONGLONG)(ppdev->FlushTimeMax * 1000000 / ppdev->CounterFrequency));
+   }
+#endif
+
+   ppdev->ShadowDirty = FALSE;
+}
+
+/*
+ * ShadowEnable
+ *
+ * Allocates the system memory copy of the screen and the device managed
+ * primary surface the engine draws to.
+ */
+
+HSURF
+ShadowEnable(
+   IN PPDEV ppdev,
+   IN SIZEL ScreenSize,
+   IN ULONG BitmapType)
+{
+   HSURF hSurface;
+
+   ppdev->hSurfShadow = (HSURF)EngCreateBitmap(ScreenSize, ppdev->ScreenDelta,
+                                               BitmapType, BMF_TOPDOWN, NULL);
+   if (ppdev->hSurfShadow == NULL)
+   {
+      return NULL;
+   }
+
+   ppdev->ShadowObj = EngLockSurface(ppdev->hSurfShadow);
+   if (ppdev->ShadowObj == NULL)
+   {
+      EngDeleteSurface(ppdev->hSurfShadow);
+      ppdev->hSurfShadow = NULL;
+      return NULL;
+   }
+
+   hSurface = EngCreateDeviceSurface((DHSURF)ppdev, ScreenSize, BitmapType);
+   if (hSurface == NULL)
+   {
+      ShadowDisable(ppdev);
+      return NULL;
+   }
+
+   ppdev->ShadowDirty = FALSE;
+   ppdev->FlushCount = 0;
+   ppdev->FlushPixels = 0;
+   ppdev->FlushTime = 0;
+   ppdev->FlushTimeMax = 0;
+   EngQueryPerformanceFrequency(&ppdev->CounterFrequency);
+
+   /* The new mode left the frame buffer undefined, bring it in sync */
+   ShadowInvalidate(ppdev);
+   ShadowFlush(ppdev);
+
+   return hSurface;
+}
+
+VOID
+ShadowDisable(
+   IN PPDEV ppdev)
+{
+   if (ppdev->ShadowObj != NULL)
+   {
+      EngUnlockSurface(ppdev->ShadowObj);
+      ppdev->ShadowObj = NULL;
+   }
+
+   if (ppdev->hSurfShadow != NULL)
+   {
+      EngDeleteSurface(ppdev->hSurfShadow);
+      ppdev->hSurfShadow = NULL;
+   }
+}
+
+/*
+ * ShadowInvalidate
+ *
+ * Marks the whole screen dirty, used after the video memory contents have
+ * been lost to a mode change.
+ */
+
+VOID
+ShadowInvalidate(
+   IN PPDEV ppdev)
+{
+   RECTL Rect;
+
+   Rect.left = 0;
+   Rect.top = 0;
+   Rect.right = ppdev->ScreenWidth;
+   Rect.bottom = ppdev->ScreenHeight;
+   ShadowAddDirtyRect(ppdev, NULL, &Rect);
+}
+
+/*
+ * DrvBitBlt
+ *
+ * Status
+ *    @implemented
+ */
+
+BOOL APIENTRY
+DrvBitBlt(
+   IN SURFOBJ *psoTrg,
+   IN SURFOBJ *psoSrc,
+   IN SURFOBJ *psoMask,
+   IN CLIPOBJ *pco,
+   IN XLATEOBJ *pxlo,
+   IN RECTL *prclTrg,
+   IN POINTL *pptlSrc,
+   IN POINTL *pptlMask,
+   IN BRUSHOBJ *pbo,
+   IN POINTL *pptlBrush,
+   IN ROP4 rop4)
+{
+   PPDEV ppdev = ShadowGetDevice(psoTrg);
+   BOOL Result;
+
+   Result = EngBitBlt(ShadowGetSurface(psoTrg), ShadowGetSurface(psoSrc),
+                      psoMask, pco, pxlo, prclTrg, pptlSrc, pptlMask,
+                      pbo, pptlBrush, rop4);
+
+   if (Result && ppdev != NULL)
+   {
+      ShadowAddDirtyRect(ppdev, pco, prclTrg);
+      ShadowFlush(ppdev);
+   }
+
+   return Result;
+}
+
+/*
+ * DrvCopyBits
+ *
+ * Status
+ *    @implemented
+ */
+
+BOOL APIENTRY
+DrvCopyBits(
+   IN SURFOBJ *psoDest,
+   IN SURFOBJ *psoSrc,
+   IN CLIPOBJ *pco,
+   IN XLATEOBJ *pxlo,
+   IN RECTL *prclDest,
+   IN POINTL *pptlSrc)
+{
+   PPDEV ppdev = ShadowGetDevice(psoDest);
+   BOOL Result;
+
+   Result = EngCopyBits(ShadowGetSurface(psoDest), ShadowGetSurface(psoSrc),
+                        pco, pxlo, prclDest, pptlSrc);
+
+   if (Result && ppdev != NULL)
+   {
+      ShadowAddDirtyRect(ppdev, pco, prclDest);
+      ShadowFlush(ppdev);
+   }
+
+   return Result;
+}
+
+/*
+ * DrvStretchBltROP
+ *
+ * Status
+ *    @implemented
+ */
+
+BOOL APIENTRY
+DrvStretchBltROP(
+   IN SURFOBJ *psoDest,
+   IN SURFOBJ *psoSrc,
+   IN SURFOBJ *psoMask,
+   IN CLIPOBJ *pco,
+   IN XLATEOBJ *pxlo,
+   IN COLORADJUSTMENT *pca,
+   IN POINTL *pptlHTOrg,
+   IN RECTL *prclDest,
+   IN RECTL *prclSrc,
+   IN POINTL *pptlMask,
+   IN ULONG iMode,
+   IN BRUSHOBJ *pbo,
+   IN DWORD rop4)
+{
+   PPDEV ppdev = ShadowGetDevice(psoDest);
+   BOOL Result;
+
+   Result = EngStretchBltROP(ShadowGetSurface(psoDest), ShadowGetSurface(psoSrc),
+                             psoMask, pco, pxlo, pca, pptlHTOrg, prclDest,
+                             prclSrc, pptlMask, iMode, pbo, rop4);
+
+   if (Result && ppdev != NULL)
+   {
+      ShadowAddDirtyRect(ppdev, pco, prclDest);
+      ShadowFlush(ppdev);
+   }
+
+   return Result;
+}
+
+/*
+ * DrvPaint
+ *
+ * Status
+ *    @implemented
+ */
+
+BOOL APIENTRY
+DrvPaint(
+   IN SURFOBJ *pso,
+   IN CLIPOBJ *pco,
+   IN BRUSHOBJ *pbo,
+   IN POINTL *pptlBrushOrg,
+   IN MIX mix)
+{
+   PPDEV ppdev = ShadowGetDevice(pso);
+   BOOL Result;
+
+   Result = EngPaint(ShadowGetSurface(pso), pco, pbo, pptlBrushOrg, mix);
+
+   if (Result && ppdev != NULL)
+   {
+      ShadowAddDirtyRect(ppdev, NULL, &pco->rclBounds);
+      ShadowFlush(ppdev);
+   }
+
+   return Result;
+}
+
+/*
+ * DrvLineTo
+ *
+ * Status
+ *    @implemented
+ */
+
+BOOL APIENTRY
+DrvLineTo(
+   IN SURFOBJ *pso,
+   IN CLIPOBJ *pco,
+   IN BRUSHOBJ *pbo,
+   IN LONG x1,
+   IN LONG y1,
+   IN LONG x2,
+   IN LONG y2,
+   IN RECTL *prclBounds,
+   IN MIX mix)
+{
+   PPDEV ppdev = ShadowGetDevice(pso);
+   RECTL Bounds;
+   BOOL Result;
+
+   Result = EngLineTo(ShadowGetSurface(pso), pco, pbo, x1, y1, x2, y2,
+                      prclBounds, mix);
+
+   if (Result && ppdev != NULL)
+   {
+      /* The end points are inclusive */
+      Bounds.left = min(x1, x2);
+      Bounds.top = min(y1, y2);
+      Bounds.right = max(x1, x2) + 1;
+      Bounds.bottom = max(y1, y2) + 1;
+      ShadowAddDirtyRect(ppdev, pco, &Bounds);
+      ShadowFlush(ppdev);
+   }
+
+   return Result;
+}
+
+/*
+ * DrvAlphaBlend
+ *
+ * Status
+ *    @implemented
+ */
+
+BOOL APIENTRY
+DrvAlphaBlend(
+   IN SURFOBJ *psoDest,
+   IN SURFOBJ *psoSrc,
+   IN CLIPOBJ *pco,
+   IN XLATEOBJ *pxlo,
+   IN RECTL *prclDest,
+   IN RECTL *prclSrc,
+   IN BLENDOBJ *pBlendObj)
+{
+   PPDEV ppdev = ShadowGetDevice(psoDest);
+   BOOL Result;
+
+   Result = EngAlphaBlend(ShadowGetSurface(psoDest), ShadowGetSurface(psoSrc),
+                          pco, pxlo, prclDest, prclSrc, pBlendObj);
+
+   if (Result && ppdev != NULL)
+   {
+      ShadowAddDirtyRect(ppdev, pco, prclDest);
+      ShadowFlush(ppdev);
+   }
+
+   return Result;
+}
+
+/*
+ * DrvTransparentBlt
+ *
+ * Status
+ *    @implemented
+ */
+
+BOOL APIENTRY
+DrvTransparentBlt(
+   IN SURFOBJ *psoDst,
+   IN SURFOBJ *psoSrc,
+   IN CLIPOBJ *pco,
+   IN XLATEOBJ *pxlo,
+   IN RECTL *prclDst,
+   IN RECTL *prclSrc,
+   IN ULONG iTransColor,
+   IN ULONG ulReserved)
+{
+   PPDEV ppdev = ShadowGetDevice(psoDst);
+   BOOL Result;
+
+   Result = EngTransparentBlt(ShadowGetSurface(psoDst), ShadowGetSurface(psoSrc),
+                              pco, pxlo, prclDst, prclSrc, iTransColor,
+                              ulReserved);
+
+   if (Result && ppdev != NULL)
+   {
+      ShadowAddDirtyRect(ppdev, pco, prclDst);
+      ShadowFlush(ppdev);
+   }
+
+   return Result;
+}
+
+/*
+ * DrvGradientFill
+ *
+ * Status
+ *    @implemented
+ */
+
+BOOL APIENTRY
+DrvGradientFill(
+   IN SURFOBJ *psoDest,
+   IN CLIPOBJ *pco,
+   IN XLATEOBJ *pxlo,
+   IN TRIVERTEX *pVertex,
+   IN ULONG nVertex,
+   IN PVOID pMesh,
+   IN ULONG nMesh,
+   IN RECTL *prclExtents,
+   IN POINTL *pptlDitherOrg,
+   IN ULONG ulMode)
+{
+   PPDEV ppdev = ShadowGetDevice(psoDest);
+   BOOL Result;
+
+   Result = EngGradientFill(ShadowGetSurface(psoDest), pco, pxlo, pVertex,
+                            nVertex, pMesh, nMesh, prclExtents, pptlDitherOrg,
+                            ulMode);
+
+   if (Result && ppdev != NULL)
+   {
+      ShadowAddDirtyRect(ppdev, pco, prclExtents);
+      ShadowFlush(ppdev);
+   }
+
+   return Result;
+}
+
+/*
+ * DrvSynchronizeSurface
+ *
+ * Called by GDI before it accesses the surface itself. Any pending part of
+ * the shadow is written out to video memory.
+ *
+ * Status
+ *    @implemented
+ */
+
+VOID APIENTRY
+DrvSynchronizeSurface(
+   IN SURFOBJ *pso,
+   IN RECTL *prcl,
+   IN FLONG fl)
+{
+   PPDEV ppdev = ShadowGetDevice(pso);
+
+   if (ppdev != NULL)
+   {
+      ShadowFlush(ppdev);
+   }
+}
@@ -24,7 +24,8 @@
  * DrvEnableSurface
  *
  * Create engine bitmap around frame buffer and set the video mode requested
- * when PDEV was initialized.
+ * when PDEV was initialized. With the shadow framebuffer enabled the engine
+ * bitmap lives in system memory and the primary surface is device managed.
  *
  * Status
  *    @implemented
@@ -96,21 +97,31 @@ DrvEnableSurface(
    ScreenSize.cx = ppdev->ScreenWidth;
    ScreenSize.cy = ppdev->ScreenHeight;
 
-   hSurface = (HSURF)EngCreateBitmap(ScreenSize, ppdev->ScreenDelta, BitmapType,
-                                     (ppdev->ScreenDelta > 0) ? BMF_TOPDOWN : 0,
-                                     ppdev->ScreenPtr);
+   if (ppdev->ShadowEnabled)
+   {
+      hSurface = ShadowEnable(ppdev, ScreenSize, BitmapType);
+   }
+   else
+   {
+      hSurface = (HSURF)EngCreateBitmap(ScreenSize, ppdev->ScreenDelta, BitmapType,
+                                        (ppdev->ScreenDelta > 0) ? BMF_TOPDOWN : 0,
+                                        ppdev->ScreenPtr);
+   }
    if (hSurface == NULL)
    {
       return FALSE;
    }
 
    /*
-    * Associate the surface with our device.
+    * Associate the surface with our device. With the shadow in place GDI
+    * has to go through our hooks to reach the screen.
     */
 
-   if (!EngAssociateSurface(hSurface, ppdev->hDevEng, 0))
+   if (!EngAssociateSurface(hSurface, ppdev->hDevEng,
+                            ppdev->ShadowEnabled ? SHADOW_HOOKS : 0))
    {
       EngDeleteSurface(hSurface);
+      ShadowDisable(ppdev);
       return FALSE;
    }
 
@@ -139,6 +150,7 @@ DrvDisableSurface(
 
    EngDeleteSurface(ppdev->hSurfEng);
    ppdev->hSurfEng = NULL;
+   ShadowDisable(ppdev);
 
 #ifdef EXPERIMENTAL_MOUSE_CURSOR_SUPPORT
    /* Clear all mouse pointer surfaces. */
@@ -186,6 +198,13 @@ DrvAssertMode(
 	     IntSetPalette(dhpdev, ppdev->PaletteEntries, 0, 256);
       }
 
+      /* The mode switch cleared the screen, repaint it from the shadow */
+      if (ppdev->ShadowObj != NULL)
+      {
+         ShadowInvalidate(ppdev);
+         ShadowFlush(ppdev);
+      }
+
       return Result;
 
    }
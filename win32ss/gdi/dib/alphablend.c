@@ -121,3 +121,45 @@ DIB_XXBPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
   return TRUE;
 }
 
+
+/*
+ * Blends with the row kernels when the source is a 32 bpp surface that isn't
+ * stretched. The caller has checked that the colour translation leaves the
+ * source pixels as the kernel for iDest expects them. Returns FALSE without
+ * touching the destination otherwise.
+ */
+BOOLEAN
+DIB_bAlphaBlendRows(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
+                    RECTL* SourceRect, BLENDFUNCTION BlendFunc, ULONG iDest)
+{
+  static const UCHAR ajBytesPerDest[DIB_BLEND_DEST_COUNT] = {4, 3, 2, 2};
+  PFN_DIB_BLENDROW pfnBlend;
+  PBYTE pjDest, pjSource;
+  LONG cx, cy;
+
+  if (Source->iBitmapFormat != BMF_32BPP)
+    return FALSE;
+
+  cx = DestRect->right - DestRect->left;
+  cy = DestRect->bottom - DestRect->top;
+  if (SourceRect->right - SourceRect->left != cx ||
+      SourceRect->bottom - SourceRect->top != cy)
+  {
+    return FALSE;
+  }
+
+  pfnBlend = gpDibBlendKernels->apfnBlend[iDest][(BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0];
+  pjDest = (PBYTE)Dest->pvScan0 + DestRect->top * Dest->lDelta +
+           DestRect->left * ajBytesPerDest[iDest];
+  pjSource = (PBYTE)Source->pvScan0 + SourceRect->top * Source->lDelta +
+             (SourceRect->left << 2);
+
+  while (cy-- > 0)
+  {
+    pfnBlend(pjDest, pjSource, cx, BlendFunc.SourceConstantAlpha);
+    pjDest += Dest->lDelta;
+    pjSource += Source->lDelta;
+  }
+
+  return TRUE;
+}
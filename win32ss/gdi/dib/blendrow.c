@@ -0,0 +1,259 @@
+/*
+ * PROJECT:         Win32 subsystem
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            win32ss/gdi/dib/blendrow.c
+ * PURPOSE:         AlphaBlend row kernels for 32 bpp sources
+ */
+
+#ifdef DIBLIB_HOST
+#include <typedefs.h>
+#else
+#include <stdarg.h>
+#include <windef.h>
+#endif
+
+#include "blendrow.h"
+
+#ifdef _DIB_BLEND_SSE2
+#include <emmintrin.h>
+#endif
+
+/* Source bytes of a BGRA pixel */
+#define DIB_B 0
+#define DIB_G 1
+#define DIB_R 2
+#define DIB_A 3
+
+const DIB_BLEND_KERNELS *gpDibBlendKernels = &gDibBlendKernelsC;
+
+static __inline ULONG
+DibClamp(ULONG ulValue, ULONG ulMax)
+{
+    return (ulValue > ulMax) ? ulMax : ulValue;
+}
+
+/*
+ * One pixel of DIB_32BPP_AlphaBlend (cChannels 4) or DIB_24BPP_AlphaBlend
+ * (cChannels 3). With a constant alpha of 255 a fully transparent source
+ * leaves the destination alone and an opaque one replaces it, so these
+ * two are done without the arithmetic.
+ */
+static __inline VOID
+DibBlendPixel(BYTE *pjDest, const BYTE *pjSource, ULONG ulConstAlpha,
+              BOOLEAN bSourceAlpha, ULONG cChannels)
+{
+    ULONG i, ulAlpha;
+
+    if (bSourceAlpha)
+    {
+        if (*(const ULONG*)pjSource == 0)
+            return;
+
+        if ((ulConstAlpha == 255) && (pjSource[DIB_A] == 255))
+        {
+            for (i = 0; i < cChannels; i++)
+                pjDest[i] = pjSource[i];
+            return;
+        }
+
+        ulAlpha = (pjSource[DIB_A] * ulConstAlpha) / 255;
+    }
+    else
+    {
+        ulAlpha = ulConstAlpha;
+    }
+
+    for (i = 0; i < cChannels; i++)
+    {
+        pjDest[i] = (BYTE)DibClamp((pjDest[i] * (255 - ulAlpha)) / 255 +
+                                   (pjSource[i] * ulConstAlpha) / 255, 255);
+    }
+}
+
+/* One pixel of DIB_16BPP_AlphaBlend, which blends in the destination depth */
+static __inline VOID
+DibBlendPixel16(BYTE *pjDest, const BYTE *pjSource, ULONG ulConstAlpha,
+                BOOLEAN bSourceAlpha, BOOLEAN b565)
+{
+    ULONG ulRed, ulGreen, ulBlue, ulAlpha, ulAlpha5, ulAlpha6, ulDest;
+
+    if (bSourceAlpha && (*(const ULONG*)pjSource == 0))
+        return;
+
+    ulRed = (pjSource[DIB_R] * ulConstAlpha) / 255;
+    ulGreen = (pjSource[DIB_G] * ulConstAlpha) / 255;
+    ulBlue = (pjSource[DIB_B] * ulConstAlpha) / 255;
+    ulAlpha = bSourceAlpha ? (pjSource[DIB_A] * ulConstAlpha) / 255 : ulConstAlpha;
+    ulAlpha5 = ulAlpha >> 3;
+
+    ulDest = *(USHORT*)pjDest;
+    if (b565)
+    {
+        ulAlpha6 = ulAlpha >> 2;
+        ulRed = DibClamp((((ulDest >> 11) & 0x1F) * (31 - ulAlpha5)) / 31 + (ulRed >> 3), 31);
+        ulGreen = DibClamp((((ulDest >> 5) & 0x3F) * (63 - ulAlpha6)) / 63 + (ulGreen >> 2), 63);
+        ulBlue = DibClamp(((ulDest & 0x1F) * (31 - ulAlpha5)) / 31 + (ulBlue >> 3), 31);
+        ulDest = (ulRed << 11) | (ulGreen << 5) | ulBlue;
+    }
+    else
+    {
+        /* The top bit is kept as it is */
+        ulRed = DibClamp((((ulDest >> 10) & 0x1F) * (31 - ulAlpha5)) / 31 + (ulRed >> 3), 31);
+        ulGreen = DibClamp((((ulDest >> 5) & 0x1F) * (31 - ulAlpha5)) / 31 + (ulGreen >> 3), 31);
+        ulBlue = DibClamp(((ulDest & 0x1F) * (31 - ulAlpha5)) / 31 + (ulBlue >> 3), 31);
+        ulDest = (ulDest & 0x8000) | (ulRed << 10) | (ulGreen << 5) | ulBlue;
+    }
+    *(USHORT*)pjDest = (USHORT)ulDest;
+}
+
+#define __DIB_BLENDROW(name, cjDest, pixel)                                    \
+static VOID                                                                    \
+name(BYTE *pjDest, const BYTE *pjSource, ULONG cPixels, ULONG ulConstAlpha)   \
+{                                                                              \
+    for (; cPixels > 0; cPixels--, pjDest += cjDest, pjSource += 4)            \
+    {                                                                          \
+        pixel;                                                                 \
+    }                                                                          \
+}
+
+__DIB_BLENDROW(DibBlendRow32_Const, 4, DibBlendPixel(pjDest, pjSource, ulConstAlpha, FALSE, 4))
+__DIB_BLENDROW(DibBlendRow32_Alpha, 4, DibBlendPixel(pjDest, pjSource, ulConstAlpha, TRUE, 4))
+__DIB_BLENDROW(DibBlendRow24_Const, 3, DibBlendPixel(pjDest, pjSource, ulConstAlpha, FALSE, 3))
+__DIB_BLENDROW(DibBlendRow24_Alpha, 3, DibBlendPixel(pjDest, pjSource, ulConstAlpha, TRUE, 3))
+__DIB_BLENDROW(DibBlendRow565_Const, 2, DibBlendPixel16(pjDest, pjSource, ulConstAlpha, FALSE, TRUE))
+__DIB_BLENDROW(DibBlendRow565_Alpha, 2, DibBlendPixel16(pjDest, pjSource, ulConstAlpha, TRUE, TRUE))
+__DIB_BLENDROW(DibBlendRow555_Const, 2, DibBlendPixel16(pjDest, pjSource, ulConstAlpha, FALSE, FALSE))
+__DIB_BLENDROW(DibBlendRow555_Alpha, 2, DibBlendPixel16(pjDest, pjSource, ulConstAlpha, TRUE, FALSE))
+
+const DIB_BLEND_KERNELS gDibBlendKernelsC =
+{
+    {
+        {DibBlendRow32_Const, DibBlendRow32_Alpha},
+        {DibBlendRow24_Const, DibBlendRow24_Alpha},
+        {DibBlendRow565_Const, DibBlendRow565_Alpha},
+        {DibBlendRow555_Const, DibBlendRow555_Alpha},
+    }
+};
+
+#ifdef _DIB_BLEND_SSE2
+
+/* x / 255, rounded down like the C division, for 0 <= x <= 255 * 255 */
+static __inline __m128i
+_DibDiv255(__m128i xmm)
+{
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(xmm, _mm_set1_epi16(1)),
+                                        _mm_srli_epi16(xmm, 8)), 8);
+}
+
+/* Blends 2 unpacked pixels: D = min(D * (255 - alpha) / 255 + S, 255) */
+static __inline __m128i
+_DibBlend2(__m128i xmmDest, __m128i xmmSource, __m128i xmmInvAlpha)
+{
+    return _mm_add_epi16(_DibDiv255(_mm_mullo_epi16(xmmDest, xmmInvAlpha)), xmmSource);
+}
+
+/*
+ * Four pixels at a time, in 16 bit lanes. The per-pixel alpha is the scaled
+ * source alpha broadcast over the lanes of its pixel, and the final pack
+ * saturates at 255, which is the Clamp8 of the C loops.
+ */
+static VOID
+DibBlendRow32_Alpha_Sse2(BYTE *pjDest, const BYTE *pjSource, ULONG cPixels, ULONG ulConstAlpha)
+{
+    const __m128i xmmZero = _mm_setzero_si128();
+    const __m128i xmm255 = _mm_set1_epi16(255);
+    const __m128i xmmConst = _mm_set1_epi16((SHORT)ulConstAlpha);
+    const __m128i xmmAlphaMask = _mm_set1_epi32((LONG)0xFF000000);
+    __m128i xmmSource, xmmDest, xmmSourceLo, xmmSourceHi, xmmAlphaLo, xmmAlphaHi;
+
+    for (; cPixels >= 4; cPixels -= 4, pjDest += 16, pjSource += 16)
+    {
+        xmmSource = _mm_loadu_si128((const __m128i*)pjSource);
+
+        /* Fully transparent, nothing to do */
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(xmmSource, xmmZero)) == 0xFFFF)
+            continue;
+
+        /* Fully opaque, a copy */
+        if ((ulConstAlpha == 255) &&
+            (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(xmmSource, xmmAlphaMask),
+                                               xmmAlphaMask)) == 0xFFFF))
+        {
+            _mm_storeu_si128((__m128i*)pjDest, xmmSource);
+            continue;
+        }
+
+        xmmSourceLo = _mm_unpacklo_epi8(xmmSource, xmmZero);
+        xmmSourceHi = _mm_unpackhi_epi8(xmmSource, xmmZero);
+        if (ulConstAlpha != 255)
+        {
+            xmmSourceLo = _DibDiv255(_mm_mullo_epi16(xmmSourceLo, xmmConst));
+            xmmSourceHi = _DibDiv255(_mm_mullo_epi16(xmmSourceHi, xmmConst));
+        }
+
+        xmmAlphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(xmmSourceLo, 0xFF), 0xFF);
+        xmmAlphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(xmmSourceHi, 0xFF), 0xFF);
+
+        xmmDest = _mm_loadu_si128((const __m128i*)pjDest);
+        xmmDest = _mm_packus_epi16(
+            _DibBlend2(_mm_unpacklo_epi8(xmmDest, xmmZero), xmmSourceLo, _mm_sub_epi16(xmm255, xmmAlphaLo)),
+            _DibBlend2(_mm_unpackhi_epi8(xmmDest, xmmZero), xmmSourceHi, _mm_sub_epi16(xmm255, xmmAlphaHi)));
+        _mm_storeu_si128((__m128i*)pjDest, xmmDest);
+    }
+
+    DibBlendRow32_Alpha(pjDest, pjSource, cPixels, ulConstAlpha);
+}
+
+static VOID
+DibBlendRow32_Const_Sse2(BYTE *pjDest, const BYTE *pjSource, ULONG cPixels, ULONG ulConstAlpha)
+{
+    const __m128i xmmZero = _mm_setzero_si128();
+    const __m128i xmmConst = _mm_set1_epi16((SHORT)ulConstAlpha);
+    const __m128i xmmInvAlpha = _mm_set1_epi16((SHORT)(255 - ulConstAlpha));
+    __m128i xmmSource, xmmDest;
+
+    for (; cPixels >= 4; cPixels -= 4, pjDest += 16, pjSource += 16)
+    {
+        xmmSource = _mm_loadu_si128((const __m128i*)pjSource);
+        xmmDest = _mm_loadu_si128((const __m128i*)pjDest);
+        xmmDest = _mm_packus_epi16(
+            _DibBlend2(_mm_unpacklo_epi8(xmmDest, xmmZero),
+                       _DibDiv255(_mm_mullo_epi16(_mm_unpacklo_epi8(xmmSource, xmmZero), xmmConst)),
+                       xmmInvAlpha),
+            _DibBlend2(_mm_unpackhi_epi8(xmmDest, xmmZero),
+                       _DibDiv255(_mm_mullo_epi16(_mm_unpackhi_epi8(xmmSource, xmmZero), xmmConst)),
+                       xmmInvAlpha));
+        _mm_storeu_si128((__m128i*)pjDest, xmmDest);
+    }
+
+    DibBlendRow32_Const(pjDest, pjSource, cPixels, ulConstAlpha);
+}
+
+/* The 24 and 16 bpp destinations gain most from skipping the per-pixel
+   GetPixel / XLATEOBJ calls, they share the C kernels */
+const DIB_BLEND_KERNELS gDibBlendKernelsSse2 =
+{
+    {
+        {DibBlendRow32_Const_Sse2, DibBlendRow32_Alpha_Sse2},
+        {DibBlendRow24_Const, DibBlendRow24_Alpha},
+        {DibBlendRow565_Const, DibBlendRow565_Alpha},
+        {DibBlendRow555_Const, DibBlendRow555_Alpha},
+    }
+};
+
+#endif /* _DIB_BLEND_SSE2 */
+
+VOID
+DIB_vInitBlendKernels(BOOLEAN bSse2)
+{
+#ifdef _DIB_BLEND_SSE2
+    if (bSse2)
+    {
+        gpDibBlendKernels = &gDibBlendKernelsSse2;
+        return;
+    }
+#endif
+    gpDibBlendKernels = &gDibBlendKernelsC;
+}
+
+/* EOF */
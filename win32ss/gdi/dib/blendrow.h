@@ -0,0 +1,42 @@
+
+/*
+ * Row kernels for AlphaBlend with a 32 bpp BGRA source.
+ *
+ * Each kernel blends one unstretched row exactly like the per-pixel loops in
+ * DIB_32BPP_AlphaBlend, DIB_24BPP_AlphaBlend and DIB_16BPP_AlphaBlend do,
+ * including their rounding and clamping. Like diblib/RowKernels.h this file
+ * only needs the base types, so sdk/tools/dibbench can check the kernels
+ * against those loops on the host.
+ */
+
+#pragma once
+
+/* Same restriction as the DibLib row kernels: the i386 kernel doesn't
+   preserve the XMM registers across a context switch */
+#if defined(_M_AMD64) || defined(__x86_64__)
+#define _DIB_BLEND_SSE2 1
+#endif
+
+/* Destination formats of the kernel table */
+#define DIB_BLEND_DEST_32BPP  0
+#define DIB_BLEND_DEST_24BPP  1
+#define DIB_BLEND_DEST_565    2
+#define DIB_BLEND_DEST_555    3
+#define DIB_BLEND_DEST_COUNT  4
+
+typedef VOID (*PFN_DIB_BLENDROW)(BYTE *pjDest, const BYTE *pjSource, ULONG cPixels, ULONG ulConstAlpha);
+
+typedef struct _DIB_BLEND_KERNELS
+{
+    /* Indexed by [iDest][bSourceAlpha], bSourceAlpha being AC_SRC_ALPHA */
+    PFN_DIB_BLENDROW apfnBlend[DIB_BLEND_DEST_COUNT][2];
+} DIB_BLEND_KERNELS, *PDIB_BLEND_KERNELS;
+
+extern const DIB_BLEND_KERNELS gDibBlendKernelsC;
+#ifdef _DIB_BLEND_SSE2
+extern const DIB_BLEND_KERNELS gDibBlendKernelsSse2;
+#endif
+extern const DIB_BLEND_KERNELS *gpDibBlendKernels;
+
+VOID
+DIB_vInitBlendKernels(BOOLEAN bSse2);
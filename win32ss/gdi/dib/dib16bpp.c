@@ -583,6 +583,7 @@ DIB_16BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
   UCHAR Alpha;
   EXLATEOBJ* pexlo;
   EXLATEOBJ exloSrcRGB;
+  ULONG aulShift[3], aulMask[3];
 
   DPRINT("DIB_16BPP_AlphaBlend: srcRect: (%d,%d)-(%d,%d), dstRect: (%d,%d)-(%d,%d)\n",
     SourceRect->left, SourceRect->top, SourceRect->right, SourceRect->bottom,
@@ -620,6 +621,19 @@ DIB_16BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
   pexlo = CONTAINING_RECORD(ColorTranslation, EXLATEOBJ, xlo);
   EXLATEOBJ_vInitialize(&exloSrcRGB, pexlo->ppalSrc, &gpalRGB, 0, 0, 0);
 
+  /* The row kernels take BGRA sources, which the translation to RGB only
+     swaps red and blue of */
+  if (EXLATEOBJ_bGetShiftMask(&exloSrcRGB, aulShift, aulMask) &&
+      aulShift[0] == 0 && aulShift[1] == 16 && aulShift[2] == 0 &&
+      aulMask[0] == 0xFF00FF00 && aulMask[1] == 0x00FF00FF && aulMask[2] == 0 &&
+      DIB_bAlphaBlendRows(Dest, Source, DestRect, SourceRect, BlendFunc,
+                          (pexlo->ppalDst->flFlags & PAL_RGB16_555) ?
+                          DIB_BLEND_DEST_555 : DIB_BLEND_DEST_565))
+  {
+    EXLATEOBJ_vCleanup(&exloSrcRGB);
+    return TRUE;
+  }
+
   if (pexlo->ppalDst->flFlags & PAL_RGB16_555)
   {
       NICEPIXEL16_555 DstPixel16;
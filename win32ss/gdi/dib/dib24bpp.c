@@ -499,6 +499,13 @@ DIB_24BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
       return FALSE;
    }
 
+   /* Unstretched 32 bpp sources that need no translation are done by rows */
+   if ((!ColorTranslation || (ColorTranslation->flXlate & XO_TRIVIAL)) &&
+       DIB_bAlphaBlendRows(Dest, Source, DestRect, SourceRect, BlendFunc, DIB_BLEND_DEST_24BPP))
+   {
+      return TRUE;
+   }
+
    Dst = (PUCHAR)((ULONG_PTR)Dest->pvScan0 + (DestRect->top * Dest->lDelta) +
                              (DestRect->left * 3));
    //SrcBpp = BitsPerFormat(Source->iBitmapFormat);
@@ -379,6 +379,13 @@ DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
     return FALSE;
   }
 
+  /* Unstretched 32 bpp sources that need no translation are done by rows */
+  if ((!ColorTranslation || (ColorTranslation->flXlate & XO_TRIVIAL)) &&
+      DIB_bAlphaBlendRows(Dest, Source, DestRect, SourceRect, BlendFunc, DIB_BLEND_DEST_32BPP))
+  {
+    return TRUE;
+  }
+
   Dst = (PULONG)((ULONG_PTR)Dest->pvScan0 + (DestRect->top * Dest->lDelta) +
     (DestRect->left << 2));
   SrcBpp = BitsPerFormat(Source->iBitmapFormat);
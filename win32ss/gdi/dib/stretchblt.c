@@ -13,6 +13,363 @@
 #define NDEBUG
 #include <debug.h>
 
+/*
+ * Pixel access for the SRCCOPY and HALFTONE kernels below. Rows are
+ * addressed once per scanline, so the kernels never go through the
+ * DIB_GetPixel/DIB_PutPixel function pointers.
+ */
+#define STRETCH_READ_8(pj, x)      ((ULONG)((PBYTE)(pj))[x])
+#define STRETCH_READ_16(pj, x)     ((ULONG)((PUSHORT)(pj))[x])
+#define STRETCH_READ_24(pj, x)     ((ULONG)(pj)[(x) * 3] | \
+                                    ((ULONG)(pj)[(x) * 3 + 1] << 8) | \
+                                    ((ULONG)(pj)[(x) * 3 + 2] << 16))
+#define STRETCH_READ_32(pj, x)     (((PULONG)(pj))[x])
+
+#define STRETCH_WRITE_8(pj, x, c)  (((PBYTE)(pj))[x] = (BYTE)(c))
+#define STRETCH_WRITE_16(pj, x, c) (((PUSHORT)(pj))[x] = (USHORT)(c))
+#define STRETCH_WRITE_24(pj, x, c) ((pj)[(x) * 3] = (BYTE)(c), \
+                                    (pj)[(x) * 3 + 1] = (BYTE)((c) >> 8), \
+                                    (pj)[(x) * 3 + 2] = (BYTE)((c) >> 16))
+#define STRETCH_WRITE_32(pj, x, c) (((PULONG)(pj))[x] = (c))
+
+/* Integer DDA: advances the source coordinate by Num/Denom per destination pixel */
+typedef struct _STRETCH_DDA
+{
+  LONG lStep;
+  LONG lFrac;
+  LONG lDenom;
+} STRETCH_DDA, *PSTRETCH_DDA;
+
+#define STRETCH_DDA_INIT(dda, Num, Denom) \
+  ((dda).lStep = (Num) / (Denom), (dda).lFrac = (Num) % (Denom), (dda).lDenom = (Denom))
+
+#define STRETCH_DDA_ADVANCE(dda, s, err)  \
+  do {                                    \
+    (s) += (dda).lStep;                   \
+    (err) += (dda).lFrac;                 \
+    if ((err) >= (dda).lDenom)            \
+    {                                     \
+      (err) -= (dda).lDenom;              \
+      (s)++;                              \
+    }                                     \
+  } while (0)
+
+typedef VOID (*PFN_STRETCH_ROW)(PBYTE, PBYTE, LONG, PSTRETCH_DDA, XLATEOBJ*);
+
+/*
+ * Stretches one scanline. Consecutive destination pixels that sample the
+ * same source value reuse the last translated colour, which makes
+ * enlarging with a palette translation nearly as cheap as a plain copy.
+ */
+#define DEFINE_STRETCH_ROW(SrcBpp, DstBpp)                                   \
+static VOID                                                                  \
+DIB_StretchRow_S##SrcBpp##_D##DstBpp(PBYTE pjDest, PBYTE pjSource, LONG cx,  \
+                                     PSTRETCH_DDA pdda, XLATEOBJ *pxlo)      \
+{                                                                            \
+  LONG x, sx = 0, lErr = 0;                                                  \
+  ULONG ulSource, ulLast, ulColor;                                           \
+                                                                             \
+  ulLast = STRETCH_READ_##SrcBpp(pjSource, 0);                               \
+  ulColor = pxlo ? XLATEOBJ_iXlate(pxlo, ulLast) : ulLast;                   \
+                                                                             \
+  for (x = 0; x < cx; x++)                                                   \
+  {                                                                          \
+    ulSource = STRETCH_READ_##SrcBpp(pjSource, sx);                          \
+    if (ulSource != ulLast)                                                  \
+    {                                                                        \
+      ulLast = ulSource;                                                     \
+      ulColor = pxlo ? XLATEOBJ_iXlate(pxlo, ulSource) : ulSource;           \
+    }                                                                        \
+    STRETCH_WRITE_##DstBpp(pjDest, x, ulColor);                              \
+    STRETCH_DDA_ADVANCE(*pdda, sx, lErr);                                    \
+  }                                                                          \
+}
+
+DEFINE_STRETCH_ROW(8, 8)
+DEFINE_STRETCH_ROW(8, 16)
+DEFINE_STRETCH_ROW(8, 24)
+DEFINE_STRETCH_ROW(8, 32)
+DEFINE_STRETCH_ROW(16, 8)
+DEFINE_STRETCH_ROW(16, 16)
+DEFINE_STRETCH_ROW(16, 24)
+DEFINE_STRETCH_ROW(16, 32)
+DEFINE_STRETCH_ROW(24, 8)
+DEFINE_STRETCH_ROW(24, 16)
+DEFINE_STRETCH_ROW(24, 24)
+DEFINE_STRETCH_ROW(24, 32)
+DEFINE_STRETCH_ROW(32, 8)
+DEFINE_STRETCH_ROW(32, 16)
+DEFINE_STRETCH_ROW(32, 24)
+DEFINE_STRETCH_ROW(32, 32)
+
+/* Indexed by [source format - BMF_8BPP][destination format - BMF_8BPP] */
+static const PFN_STRETCH_ROW gapfnStretchRow[4][4] =
+{
+  { DIB_StretchRow_S8_D8,  DIB_StretchRow_S8_D16,  DIB_StretchRow_S8_D24,  DIB_StretchRow_S8_D32 },
+  { DIB_StretchRow_S16_D8, DIB_StretchRow_S16_D16, DIB_StretchRow_S16_D24, DIB_StretchRow_S16_D32 },
+  { DIB_StretchRow_S24_D8, DIB_StretchRow_S24_D16, DIB_StretchRow_S24_D24, DIB_StretchRow_S24_D32 },
+  { DIB_StretchRow_S32_D8, DIB_StretchRow_S32_D16, DIB_StretchRow_S32_D24, DIB_StretchRow_S32_D32 },
+};
+
+static BOOLEAN
+DIB_StretchBltCanUseKernel(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
+                           RECTL *DestRect, RECTL *SourceRect)
+{
+  if (DestSurf->iBitmapFormat < BMF_8BPP || DestSurf->iBitmapFormat > BMF_32BPP ||
+      SourceSurf->iBitmapFormat < BMF_8BPP || SourceSurf->iBitmapFormat > BMF_32BPP)
+  {
+    return FALSE;
+  }
+
+  /* Mirroring and empty rectangles are left to the generic code */
+  if (DestRect->right <= DestRect->left || DestRect->bottom <= DestRect->top ||
+      SourceRect->right <= SourceRect->left || SourceRect->bottom <= SourceRect->top)
+  {
+    return FALSE;
+  }
+
+  /* The generic code skips source pixels outside the bitmap, the kernels don't */
+  if (SourceRect->left < 0 || SourceRect->top < 0 ||
+      SourceRect->right > SourceSurf->sizlBitmap.cx ||
+      SourceRect->bottom > abs(SourceSurf->sizlBitmap.cy))
+  {
+    return FALSE;
+  }
+
+  /* Overlapping stretches need the pixel-by-pixel semantics */
+  return DestSurf->pvScan0 != SourceSurf->pvScan0;
+}
+
+/*
+ * SRCCOPY stretch without mask or pattern. Sampling is identical to the
+ * generic loop (sx = left + dx * SrcWidth / DstWidth), but computed with an
+ * integer DDA, and destination rows that sample the same source row are
+ * replicated with a single copy.
+ */
+static BOOLEAN
+DIB_XXBPP_StretchBltSrcCopy(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
+                            RECTL *DestRect, RECTL *SourceRect,
+                            XLATEOBJ *ColorTranslation)
+{
+  PFN_STRETCH_ROW pfnRow;
+  STRETCH_DDA ddaX, ddaY;
+  XLATEOBJ *pxlo;
+  PBYTE pjDestRow, pjLastDestRow = NULL;
+  LONG DstWidth, DstHeight, SrcWidth, SrcHeight;
+  LONG y, sy, syLast = -1, lErrY = 0;
+  ULONG cjDestPixel, cjSourcePixel, cjRow;
+
+  if (!DIB_StretchBltCanUseKernel(DestSurf, SourceSurf, DestRect, SourceRect))
+    return FALSE;
+
+  pfnRow = gapfnStretchRow[SourceSurf->iBitmapFormat - BMF_8BPP]
+                          [DestSurf->iBitmapFormat - BMF_8BPP];
+
+  pxlo = (ColorTranslation && !(ColorTranslation->flXlate & XO_TRIVIAL)) ?
+         ColorTranslation : NULL;
+
+  DstWidth = DestRect->right - DestRect->left;
+  DstHeight = DestRect->bottom - DestRect->top;
+  SrcWidth = SourceRect->right - SourceRect->left;
+  SrcHeight = SourceRect->bottom - SourceRect->top;
+
+  STRETCH_DDA_INIT(ddaX, SrcWidth, DstWidth);
+  STRETCH_DDA_INIT(ddaY, SrcHeight, DstHeight);
+
+  cjDestPixel = BitsPerFormat(DestSurf->iBitmapFormat) / 8;
+  cjSourcePixel = BitsPerFormat(SourceSurf->iBitmapFormat) / 8;
+  cjRow = DstWidth * cjDestPixel;
+
+  pjDestRow = (PBYTE)DestSurf->pvScan0 + DestRect->top * DestSurf->lDelta +
+              DestRect->left * cjDestPixel;
+  sy = SourceRect->top;
+
+  for (y = 0; y < DstHeight; y++)
+  {
+    if (sy == syLast)
+    {
+      RtlCopyMemory(pjDestRow, pjLastDestRow, cjRow);
+    }
+    else
+    {
+      pfnRow(pjDestRow,
+             (PBYTE)SourceSurf->pvScan0 + sy * SourceSurf->lDelta +
+             SourceRect->left * cjSourcePixel,
+             DstWidth, &ddaX, pxlo);
+      syLast = sy;
+      pjLastDestRow = pjDestRow;
+    }
+
+    pjDestRow += DestSurf->lDelta;
+    STRETCH_DDA_ADVANCE(ddaY, sy, lErrY);
+  }
+
+  return TRUE;
+}
+
+/*
+ * HALFTONE filtering works on two channels per 32-bit operation: blue/red
+ * in the low halves and green/alpha after shifting by 8. Weights are 8-bit,
+ * so intermediate products stay within 32 bits.
+ */
+static __inline ULONG
+DIB_LerpPixel(ULONG a, ULONG b, ULONG w)
+{
+  ULONG rb = (((a & 0x00FF00FF) * (256 - w) + (b & 0x00FF00FF) * w) >> 8) & 0x00FF00FF;
+  ULONG ag = ((((a >> 8) & 0x00FF00FF) * (256 - w) + ((b >> 8) & 0x00FF00FF) * w)) & 0xFF00FF00;
+  return rb | ag;
+}
+
+static __inline ULONG
+DIB_ReadHalftonePixel(PBYTE pjRow, LONG x, ULONG iFormat)
+{
+  return (iFormat == BMF_32BPP) ? STRETCH_READ_32(pjRow, x) : STRETCH_READ_24(pjRow, x);
+}
+
+/* Largest box footprint whose per-channel sums cannot overflow a ULONG */
+#define HALFTONE_MAX_BOX 0x10000
+
+/*
+ * SRCCOPY stretch for the HALFTONE stretch mode on 24/32 bpp surfaces.
+ * Enlarging uses bilinear interpolation with pixel centres aligned,
+ * shrinking averages the box of source pixels covered by each destination
+ * pixel. Returns FALSE if the surfaces are not supported, so the caller can
+ * fall back to COLORONCOLOR sampling.
+ */
+BOOLEAN
+DIB_XXBPP_StretchBltHalftone(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
+                             RECTL *DestRect, RECTL *SourceRect,
+                             XLATEOBJ *ColorTranslation)
+{
+  XLATEOBJ *pxlo;
+  PBYTE pjDestRow, pjSourceBase, pjRow0, pjRow1;
+  LONG DstWidth, DstHeight, SrcWidth, SrcHeight;
+  LONG x, y, sx, sy, x0, x1, y0, y1, xs, xe, ys, ye, i, j;
+  LONG fx, fy, lStepX, lStepY;
+  ULONG iSrcFormat, iDstFormat, ulColor, wx, wy, cPixels;
+  ULONG ulSum0, ulSum1, ulSum2, ulSum3, ulPixel;
+
+  iSrcFormat = SourceSurf->iBitmapFormat;
+  iDstFormat = DestSurf->iBitmapFormat;
+
+  if ((iSrcFormat != BMF_24BPP && iSrcFormat != BMF_32BPP) ||
+      (iDstFormat != BMF_24BPP && iDstFormat != BMF_32BPP))
+  {
+    return FALSE;
+  }
+
+  if (!DIB_StretchBltCanUseKernel(DestSurf, SourceSurf, DestRect, SourceRect))
+    return FALSE;
+
+  pxlo = (ColorTranslation && !(ColorTranslation->flXlate & XO_TRIVIAL)) ?
+         ColorTranslation : NULL;
+
+  DstWidth = DestRect->right - DestRect->left;
+  DstHeight = DestRect->bottom - DestRect->top;
+  SrcWidth = SourceRect->right - SourceRect->left;
+  SrcHeight = SourceRect->bottom - SourceRect->top;
+
+  if (((SrcWidth + DstWidth - 1) / DstWidth) *
+      ((SrcHeight + DstHeight - 1) / DstHeight) > HALFTONE_MAX_BOX)
+  {
+    return FALSE;
+  }
+
+  pjSourceBase = (PBYTE)SourceSurf->pvScan0 + SourceRect->top * SourceSurf->lDelta +
+                 SourceRect->left * (BitsPerFormat(iSrcFormat) / 8);
+  pjDestRow = (PBYTE)DestSurf->pvScan0 + DestRect->top * DestSurf->lDelta +
+              DestRect->left * (BitsPerFormat(iDstFormat) / 8);
+
+  if (DstWidth >= SrcWidth && DstHeight >= SrcHeight)
+  {
+    /* Bilinear, 16.16 fixed point source coordinates stepped per pixel */
+    lStepX = (LONG)(((LONGLONG)SrcWidth << 16) / DstWidth);
+    lStepY = (LONG)(((LONGLONG)SrcHeight << 16) / DstHeight);
+
+    fy = lStepY / 2 - 0x8000;
+    for (y = 0; y < DstHeight; y++, fy += lStepY)
+    {
+      sy = max(fy, 0);
+      y0 = min(sy >> 16, SrcHeight - 1);
+      y1 = min(y0 + 1, SrcHeight - 1);
+      wy = (sy >> 8) & 0xFF;
+      pjRow0 = pjSourceBase + y0 * SourceSurf->lDelta;
+      pjRow1 = pjSourceBase + y1 * SourceSurf->lDelta;
+
+      fx = lStepX / 2 - 0x8000;
+      for (x = 0; x < DstWidth; x++, fx += lStepX)
+      {
+        sx = max(fx, 0);
+        x0 = min(sx >> 16, SrcWidth - 1);
+        x1 = min(x0 + 1, SrcWidth - 1);
+        wx = (sx >> 8) & 0xFF;
+
+        ulColor = DIB_LerpPixel(
+                    DIB_LerpPixel(DIB_ReadHalftonePixel(pjRow0, x0, iSrcFormat),
+                                  DIB_ReadHalftonePixel(pjRow0, x1, iSrcFormat), wx),
+                    DIB_LerpPixel(DIB_ReadHalftonePixel(pjRow1, x0, iSrcFormat),
+                                  DIB_ReadHalftonePixel(pjRow1, x1, iSrcFormat), wx),
+                    wy);
+
+        if (pxlo) ulColor = XLATEOBJ_iXlate(pxlo, ulColor);
+
+        if (iDstFormat == BMF_32BPP)
+          STRETCH_WRITE_32(pjDestRow, x, ulColor);
+        else
+          STRETCH_WRITE_24(pjDestRow, x, ulColor);
+      }
+
+      pjDestRow += DestSurf->lDelta;
+    }
+  }
+  else
+  {
+    /* Box filter over the source footprint of each destination pixel */
+    for (y = 0; y < DstHeight; y++)
+    {
+      ys = y * SrcHeight / DstHeight;
+      ye = max((y + 1) * SrcHeight / DstHeight, ys + 1);
+
+      for (x = 0; x < DstWidth; x++)
+      {
+        xs = x * SrcWidth / DstWidth;
+        xe = max((x + 1) * SrcWidth / DstWidth, xs + 1);
+
+        ulSum0 = ulSum1 = ulSum2 = ulSum3 = 0;
+        for (j = ys; j < ye; j++)
+        {
+          pjRow0 = pjSourceBase + j * SourceSurf->lDelta;
+          for (i = xs; i < xe; i++)
+          {
+            ulPixel = DIB_ReadHalftonePixel(pjRow0, i, iSrcFormat);
+            ulSum0 += ulPixel & 0xFF;
+            ulSum1 += (ulPixel >> 8) & 0xFF;
+            ulSum2 += (ulPixel >> 16) & 0xFF;
+            ulSum3 += ulPixel >> 24;
+          }
+        }
+
+        cPixels = (xe - xs) * (ye - ys);
+        ulColor = ((ulSum0 + cPixels / 2) / cPixels) |
+                  (((ulSum1 + cPixels / 2) / cPixels) << 8) |
+                  (((ulSum2 + cPixels / 2) / cPixels) << 16) |
+                  (((ulSum3 + cPixels / 2) / cPixels) << 24);
+
+        if (pxlo) ulColor = XLATEOBJ_iXlate(pxlo, ulColor);
+
+        if (iDstFormat == BMF_32BPP)
+          STRETCH_WRITE_32(pjDestRow, x, ulColor);
+        else
+          STRETCH_WRITE_24(pjDestRow, x, ulColor);
+      }
+
+      pjDestRow += DestSurf->lDelta;
+    }
+  }
+
+  return TRUE;
+}
+
 BOOLEAN DIB_XXBPP_StretchBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf, SURFOBJ *MaskSurf,
                             SURFOBJ *PatternSurface,
                             RECTL *DestRect, RECTL *SourceRect,
@@ -50,6 +407,12 @@ BOOLEAN DIB_XXBPP_StretchBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf, SURFOBJ *Ma
 
   ASSERT(IS_VALID_ROP4(ROP));
 
+  if (ROP == ROP4_SRCCOPY && !MaskSurf &&
+      DIB_XXBPP_StretchBltSrcCopy(DestSurf, SourceSurf, DestRect, SourceRect, ColorTranslation))
+  {
+    return TRUE;
+  }
+
   fnDest_GetPixel = DibFunctionsForBitmapFormat[DestSurf->iBitmapFormat].DIB_GetPixel;
   fnDest_PutPixel = DibFunctionsForBitmapFormat[DestSurf->iBitmapFormat].DIB_PutPixel;
 
@@ -15,6 +15,9 @@ VOID
 FASTCALL
 Dib_BitBlt_DSTINVERT(PBLTDATA pBltData)
 {
+    if (Dib_bRowDestBlt(pBltData, gpDibRowKernels->pfnNot))
+        return;
+
     gapfnBitBlt_DSTINVERT[pBltData->siDst.iFormat](pBltData);
 }
 
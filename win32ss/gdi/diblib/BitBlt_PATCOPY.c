@@ -25,6 +25,9 @@ Dib_BitBlt_PATCOPY(PBLTDATA pBltData)
     if (pBltData->ulSolidColor != 0xFFFFFFFF)
     {
         /* Use the solid version of PATCOPY! */
+        if (Dib_bRowFillBlt(pBltData, gpDibRowKernels->pfnFill))
+            return;
+
         gapfnBitBlt_PATCOPY_Solid[pBltData->siDst.iFormat](pBltData);
     }
     else
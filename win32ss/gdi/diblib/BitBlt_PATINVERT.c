@@ -25,6 +25,9 @@ Dib_BitBlt_PATINVERT(PBLTDATA pBltData)
     if (pBltData->ulSolidColor != 0xFFFFFFFF)
     {
         /* Use the solid version of PATCOPY! */
+        if (Dib_bRowFillBlt(pBltData, gpDibRowKernels->pfnXorFill))
+            return;
+
         gapfnBitBlt_PATINVERT_Solid[pBltData->siDst.iFormat](pBltData);
     }
     else
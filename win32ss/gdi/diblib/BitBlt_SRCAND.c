@@ -16,7 +16,9 @@ VOID
 FASTCALL
 Dib_BitBlt_SRCAND(PBLTDATA pBltData)
 {
-    // TODO: XLATEless same-surface variants
+    if (Dib_bRowSourceBlt(pBltData, gpDibRowKernels->pfnAnd))
+        return;
+
     gapfnBitBlt_SRCAND[pBltData->siDst.iFormat][pBltData->siSrc.iFormat](pBltData);
 }
 
@@ -69,6 +69,18 @@ VOID
 FASTCALL
 Dib_BitBlt_SRCCOPY(PBLTDATA pBltData)
 {
+    /* Right to left copies within a row have their own functions above,
+       other equal surface copies can use the forward copy kernel */
+    if (pBltData->siDst.iFormat != 0)
+    {
+        /* Same format without translation or a shift and mask conversion */
+        if (Dib_bRowSourceBlt(pBltData, gpDibRowKernels->pfnCopy) ||
+            Dib_bRowConvertBlt(pBltData))
+        {
+            return;
+        }
+    }
+
     gapfnBitBlt_SRCCOPY[pBltData->siDst.iFormat][pBltData->siSrc.iFormat](pBltData);
 }
 
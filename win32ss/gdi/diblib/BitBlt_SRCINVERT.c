@@ -16,7 +16,9 @@ VOID
 FASTCALL
 Dib_BitBlt_SRCINVERT(PBLTDATA pBltData)
 {
-    // TODO: XLATEless same-surface variants
+    if (Dib_bRowSourceBlt(pBltData, gpDibRowKernels->pfnXor))
+        return;
+
     gapfnBitBlt_SRCINVERT[pBltData->siDst.iFormat][pBltData->siSrc.iFormat](pBltData);
 }
 
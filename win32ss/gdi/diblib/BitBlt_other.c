@@ -9,6 +9,9 @@ Dib_BitBlt_BLACKNESS(PBLTDATA pBltData)
 {
     /* Pass it to the colorfil function */
     pBltData->ulSolidColor = XLATEOBJ_iXlate(pBltData->pxlo, 0);
+    if (Dib_bRowFillBlt(pBltData, gpDibRowKernels->pfnFill))
+        return;
+
     gapfnBitBlt_PATCOPY_Solid[pBltData->siDst.iFormat](pBltData);
 }
 
@@ -18,6 +21,9 @@ Dib_BitBlt_WHITENESS(PBLTDATA pBltData)
 {
     /* Pass it to the colorfil function */
     pBltData->ulSolidColor = XLATEOBJ_iXlate(pBltData->pxlo, 0xFFFFFF);
+    if (Dib_bRowFillBlt(pBltData, gpDibRowKernels->pfnFill))
+        return;
+
     gapfnBitBlt_PATCOPY_Solid[pBltData->siDst.iFormat](pBltData);
 }
 
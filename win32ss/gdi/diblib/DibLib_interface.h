@@ -1,5 +1,6 @@
 
 #include "RopFunctions.h"
+#include "RowKernels.h"
 
 typedef struct
 {
@@ -29,6 +30,8 @@ typedef struct
     PFN_DOROP apfnDoRop[2];
     ULONG ulSolidColor;
     LONG dy;
+    BOOL bXlateShiftMask;
+    DIB_SHIFTMASK smXlate;
 } BLTDATA, *PBLTDATA;
 
 typedef
@@ -68,6 +71,11 @@ VOID FASTCALL Dib_MaskPatPaint(PBLTDATA pBltData);
 VOID FASTCALL Dib_MaskSrcPaint(PBLTDATA pBltData);
 VOID FASTCALL Dib_MaskBlt(PBLTDATA pBltData);
 
+BOOLEAN FASTCALL Dib_bRowSourceBlt(PBLTDATA pBltData, PFN_DIBROW_ROP pfnRow);
+BOOLEAN FASTCALL Dib_bRowDestBlt(PBLTDATA pBltData, PFN_DIBROW_DEST pfnRow);
+BOOLEAN FASTCALL Dib_bRowFillBlt(PBLTDATA pBltData, PFN_DIBROW_FILL pfnRow);
+BOOLEAN FASTCALL Dib_bRowConvertBlt(PBLTDATA pBltData);
+
 extern const UCHAR gajIndexPerRop[256];
 extern const PFN_DIBFUNCTION gapfnDibFunction[];
 extern const PFN_DIBFUNCTION gapfnMaskFunction[8];
@@ -0,0 +1,133 @@
+
+#include "DibLib.h"
+
+/* Bytes per pixel, indexed by the source / destination format */
+static const BYTE gajBytesPerFormat[7] = {0, 0, 0, 1, 2, 3, 4};
+
+/*
+ * The row kernels work on whole rows of bytes, so they can only be used for
+ * formats of 8 bpp and more and never for the right to left special case
+ * (iFormat 0 in the destination). Equal surface blits (iFormat 0 in the
+ * source) run left to right, which is safe with the forward kernels.
+ */
+
+BOOLEAN
+FASTCALL
+Dib_bRowSourceBlt(PBLTDATA pBltData, PFN_DIBROW_ROP pfnRow)
+{
+    ULONG cLines, cjRow;
+    PBYTE pjDestBase, pjSrcBase;
+
+    if (gajBytesPerFormat[pBltData->siDst.iFormat] == 0)
+        return FALSE;
+
+    /* Different surfaces need the same format and no color translation */
+    if ((pBltData->siSrc.iFormat != 0) &&
+        ((pBltData->siSrc.iFormat != pBltData->siDst.iFormat) ||
+         (pBltData->pxlo && !(pBltData->pxlo->flXlate & XO_TRIVIAL))))
+    {
+        return FALSE;
+    }
+
+    cjRow = pBltData->ulWidth * gajBytesPerFormat[pBltData->siDst.iFormat];
+    pjDestBase = pBltData->siDst.pjBase;
+    pjSrcBase = pBltData->siSrc.pjBase;
+
+    cLines = pBltData->ulHeight;
+    while (cLines--)
+    {
+        pfnRow(pjDestBase, pjSrcBase, cjRow);
+        pjDestBase += pBltData->siDst.cjAdvanceY;
+        pjSrcBase += pBltData->siSrc.cjAdvanceY;
+    }
+
+    return TRUE;
+}
+
+BOOLEAN
+FASTCALL
+Dib_bRowDestBlt(PBLTDATA pBltData, PFN_DIBROW_DEST pfnRow)
+{
+    ULONG cLines, cjRow;
+    PBYTE pjDestBase;
+
+    if (gajBytesPerFormat[pBltData->siDst.iFormat] == 0)
+        return FALSE;
+
+    cjRow = pBltData->ulWidth * gajBytesPerFormat[pBltData->siDst.iFormat];
+    pjDestBase = pBltData->siDst.pjBase;
+
+    cLines = pBltData->ulHeight;
+    while (cLines--)
+    {
+        pfnRow(pjDestBase, cjRow);
+        pjDestBase += pBltData->siDst.cjAdvanceY;
+    }
+
+    return TRUE;
+}
+
+BOOLEAN
+FASTCALL
+Dib_bRowFillBlt(PBLTDATA pBltData, PFN_DIBROW_FILL pfnRow)
+{
+    BYTE ajPattern[DIB_FILL_PATTERN_SIZE];
+    ULONG cLines, cjRow, cjPixel;
+    PBYTE pjDestBase;
+
+    cjPixel = gajBytesPerFormat[pBltData->siDst.iFormat];
+    if (cjPixel == 0)
+        return FALSE;
+
+    /* Replicate the solid color over the pattern */
+    Dib_vBuildFillPattern(ajPattern, pBltData->ulSolidColor, cjPixel);
+
+    cjRow = pBltData->ulWidth * cjPixel;
+    pjDestBase = pBltData->siDst.pjBase;
+
+    cLines = pBltData->ulHeight;
+    while (cLines--)
+    {
+        pfnRow(pjDestBase, ajPattern, cjRow);
+        pjDestBase += pBltData->siDst.cjAdvanceY;
+    }
+
+    return TRUE;
+}
+
+BOOLEAN
+FASTCALL
+Dib_bRowConvertBlt(PBLTDATA pBltData)
+{
+    ULONG cLines, iSrcFormat, iDstFormat;
+    PBYTE pjDestBase, pjSrcBase;
+    PFN_DIBROW_CONVERT pfnConvert;
+
+    /* Only translations that are a rotate and mask per channel */
+    if (!pBltData->bXlateShiftMask)
+        return FALSE;
+
+    /* Only between different surfaces of 16, 24 or 32 bpp */
+    iSrcFormat = pBltData->siSrc.iFormat;
+    iDstFormat = pBltData->siDst.iFormat;
+    if ((iSrcFormat < BMF_16BPP) || (iSrcFormat > BMF_32BPP) ||
+        (iDstFormat < BMF_16BPP) || (iDstFormat > BMF_32BPP))
+    {
+        return FALSE;
+    }
+
+    pfnConvert = gpDibRowKernels->apfnConvert[DIB_CONVERT_INDEX(pBltData->siDst.jBpp)]
+                                             [DIB_CONVERT_INDEX(pBltData->siSrc.jBpp)];
+    pjDestBase = pBltData->siDst.pjBase;
+    pjSrcBase = pBltData->siSrc.pjBase;
+
+    cLines = pBltData->ulHeight;
+    while (cLines--)
+    {
+        pfnConvert(pjDestBase, pjSrcBase, pBltData->ulWidth, &pBltData->smXlate);
+        pjDestBase += pBltData->siDst.cjAdvanceY;
+        pjSrcBase += pBltData->siSrc.cjAdvanceY;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,389 @@
+
+#include <string.h>
+#ifdef DIBLIB_HOST
+#include <typedefs.h>
+#else
+#include <stdarg.h>
+#include <windef.h>
+#endif
+
+#include "RowKernels.h"
+
+#ifdef _DIBLIB_SSE2
+#include <emmintrin.h>
+#endif
+
+#define _ReadRow_16(pj) (*(const USHORT*)(pj))
+#define _ReadRow_24(pj) ((pj)[0] | ((pj)[1] << 8) | ((pj)[2] << 16))
+#define _ReadRow_32(pj) (*(const ULONG*)(pj))
+
+#define _WriteRow_16(pj, ul) (void)(*(USHORT*)(pj) = (USHORT)(ul))
+#define _WriteRow_24(pj, ul) (void)(((pj)[0] = (BYTE)(ul)), ((pj)[1] = (BYTE)((ul) >> 8)), ((pj)[2] = (BYTE)((ul) >> 16)))
+#define _WriteRow_32(pj, ul) (void)(*(ULONG*)(pj) = (ul))
+
+const DIB_ROW_KERNELS *gpDibRowKernels = &gDibRowKernelsC;
+
+static __inline
+ULONG
+DibRotl(ULONG ul, ULONG cShift)
+{
+    return (ul << cShift) | (ul >> ((32 - cShift) & 31));
+}
+
+static __inline
+ULONG
+DibShiftMask(ULONG ul, const DIB_SHIFTMASK *psm)
+{
+    return (DibRotl(ul, psm->aulShift[0]) & psm->aulMask[0]) |
+           (DibRotl(ul, psm->aulShift[1]) & psm->aulMask[1]) |
+           (DibRotl(ul, psm->aulShift[2]) & psm->aulMask[2]);
+}
+
+VOID
+Dib_vBuildFillPattern(BYTE *pjPattern, ULONG ulColor, ULONG cjPixel)
+{
+    ULONG i;
+
+    for (i = 0; i < DIB_FILL_PATTERN_SIZE; i++)
+    {
+        pjPattern[i] = (BYTE)(ulColor >> ((i % cjPixel) * 8));
+    }
+}
+
+VOID
+Dib_vInitRowKernels(BOOLEAN bSse2)
+{
+#ifdef _DIBLIB_SSE2
+    if (bSse2)
+    {
+        gpDibRowKernels = &gDibRowKernelsSse2;
+        return;
+    }
+#else
+    (void)bSse2;
+#endif
+    gpDibRowKernels = &gDibRowKernelsC;
+}
+
+/** Portable kernels **********************************************************/
+
+/* Equal surface blits can copy within the same row */
+static
+VOID
+DibCopyRowC(BYTE *pjDest, const BYTE *pjSource, ULONG cjRow)
+{
+    memmove(pjDest, pjSource, cjRow);
+}
+
+static
+VOID
+DibXorRowC(BYTE *pjDest, const BYTE *pjSource, ULONG cjRow)
+{
+    for (; cjRow >= sizeof(ULONG); cjRow -= sizeof(ULONG))
+    {
+        *(ULONG*)pjDest ^= *(const ULONG*)pjSource;
+        pjDest += sizeof(ULONG);
+        pjSource += sizeof(ULONG);
+    }
+    while (cjRow--) *pjDest++ ^= *pjSource++;
+}
+
+static
+VOID
+DibAndRowC(BYTE *pjDest, const BYTE *pjSource, ULONG cjRow)
+{
+    for (; cjRow >= sizeof(ULONG); cjRow -= sizeof(ULONG))
+    {
+        *(ULONG*)pjDest &= *(const ULONG*)pjSource;
+        pjDest += sizeof(ULONG);
+        pjSource += sizeof(ULONG);
+    }
+    while (cjRow--) *pjDest++ &= *pjSource++;
+}
+
+static
+VOID
+DibNotRowC(BYTE *pjDest, ULONG cjRow)
+{
+    for (; cjRow >= sizeof(ULONG); cjRow -= sizeof(ULONG))
+    {
+        *(ULONG*)pjDest = ~*(ULONG*)pjDest;
+        pjDest += sizeof(ULONG);
+    }
+    while (cjRow--)
+    {
+        *pjDest = (BYTE)~*pjDest;
+        pjDest++;
+    }
+}
+
+static
+VOID
+DibFillRowC(BYTE *pjDest, const BYTE *pjPattern, ULONG cjRow)
+{
+    ULONG i;
+
+    for (; cjRow >= DIB_FILL_PATTERN_SIZE; cjRow -= DIB_FILL_PATTERN_SIZE)
+    {
+        memcpy(pjDest, pjPattern, DIB_FILL_PATTERN_SIZE);
+        pjDest += DIB_FILL_PATTERN_SIZE;
+    }
+    for (i = 0; i < cjRow; i++) pjDest[i] = pjPattern[i];
+}
+
+static
+VOID
+DibXorFillRowC(BYTE *pjDest, const BYTE *pjPattern, ULONG cjRow)
+{
+    for (; cjRow >= DIB_FILL_PATTERN_SIZE; cjRow -= DIB_FILL_PATTERN_SIZE)
+    {
+        DibXorRowC(pjDest, pjPattern, DIB_FILL_PATTERN_SIZE);
+        pjDest += DIB_FILL_PATTERN_SIZE;
+    }
+    DibXorRowC(pjDest, pjPattern, cjRow);
+}
+
+#define __DIB_CONVERT_C(src_bpp, dst_bpp) \
+static \
+VOID \
+DibConvertRow_S ## src_bpp ## _D ## dst_bpp ## _C( \
+    BYTE *pjDest, const BYTE *pjSource, ULONG cPixels, const DIB_SHIFTMASK *psm) \
+{ \
+    ULONG ulColor; \
+    while (cPixels--) \
+    { \
+        ulColor = DibShiftMask(_ReadRow_ ## src_bpp(pjSource), psm); \
+        _WriteRow_ ## dst_bpp(pjDest, ulColor); \
+        pjSource += src_bpp / 8; \
+        pjDest += dst_bpp / 8; \
+    } \
+}
+
+__DIB_CONVERT_C(16, 16)
+__DIB_CONVERT_C(16, 24)
+__DIB_CONVERT_C(16, 32)
+__DIB_CONVERT_C(24, 16)
+__DIB_CONVERT_C(24, 24)
+__DIB_CONVERT_C(24, 32)
+__DIB_CONVERT_C(32, 16)
+__DIB_CONVERT_C(32, 24)
+__DIB_CONVERT_C(32, 32)
+
+const DIB_ROW_KERNELS gDibRowKernelsC =
+{
+    DibCopyRowC,
+    DibXorRowC,
+    DibAndRowC,
+    DibNotRowC,
+    DibFillRowC,
+    DibXorFillRowC,
+    {
+        { DibConvertRow_S16_D16_C, DibConvertRow_S24_D16_C, DibConvertRow_S32_D16_C },
+        { DibConvertRow_S16_D24_C, DibConvertRow_S24_D24_C, DibConvertRow_S32_D24_C },
+        { DibConvertRow_S16_D32_C, DibConvertRow_S24_D32_C, DibConvertRow_S32_D32_C },
+    }
+};
+
+/** SSE2 kernels **************************************************************/
+
+#ifdef _DIBLIB_SSE2
+
+/* Runs a byte wise operation on 64 bytes per iteration, then 16 bytes,
+   then finishes the row with the portable kernel */
+#define __DIB_BINARY_SSE2(name, op, tail) \
+static \
+VOID \
+name(BYTE *pjDest, const BYTE *pjSource, ULONG cjRow) \
+{ \
+    __m128i a0, a1, a2, a3; \
+    for (; cjRow >= 64; cjRow -= 64) \
+    { \
+        a0 = op(_mm_loadu_si128((__m128i*)pjDest + 0), _mm_loadu_si128((const __m128i*)pjSource + 0)); \
+        a1 = op(_mm_loadu_si128((__m128i*)pjDest + 1), _mm_loadu_si128((const __m128i*)pjSource + 1)); \
+        a2 = op(_mm_loadu_si128((__m128i*)pjDest + 2), _mm_loadu_si128((const __m128i*)pjSource + 2)); \
+        a3 = op(_mm_loadu_si128((__m128i*)pjDest + 3), _mm_loadu_si128((const __m128i*)pjSource + 3)); \
+        _mm_storeu_si128((__m128i*)pjDest + 0, a0); \
+        _mm_storeu_si128((__m128i*)pjDest + 1, a1); \
+        _mm_storeu_si128((__m128i*)pjDest + 2, a2); \
+        _mm_storeu_si128((__m128i*)pjDest + 3, a3); \
+        pjDest += 64; \
+        pjSource += 64; \
+    } \
+    for (; cjRow >= 16; cjRow -= 16) \
+    { \
+        a0 = op(_mm_loadu_si128((__m128i*)pjDest), _mm_loadu_si128((const __m128i*)pjSource)); \
+        _mm_storeu_si128((__m128i*)pjDest, a0); \
+        pjDest += 16; \
+        pjSource += 16; \
+    } \
+    tail(pjDest, pjSource, cjRow); \
+}
+
+/* Plain copies and solid fills keep DibCopyRowC and DibFillRowC, since the
+   CRT memmove and memcpy measured faster than an unaligned SSE2 loop. */
+__DIB_BINARY_SSE2(DibXorRowSse2, _mm_xor_si128, DibXorRowC)
+__DIB_BINARY_SSE2(DibAndRowSse2, _mm_and_si128, DibAndRowC)
+
+static
+VOID
+DibNotRowSse2(BYTE *pjDest, ULONG cjRow)
+{
+    __m128i xmmOnes = _mm_set1_epi32(-1);
+
+    for (; cjRow >= 16; cjRow -= 16)
+    {
+        _mm_storeu_si128((__m128i*)pjDest,
+                         _mm_xor_si128(_mm_loadu_si128((__m128i*)pjDest), xmmOnes));
+        pjDest += 16;
+    }
+    DibNotRowC(pjDest, cjRow);
+}
+
+static
+VOID
+DibXorFillRowSse2(BYTE *pjDest, const BYTE *pjPattern, ULONG cjRow)
+{
+    __m128i p0 = _mm_loadu_si128((const __m128i*)pjPattern + 0);
+    __m128i p1 = _mm_loadu_si128((const __m128i*)pjPattern + 1);
+    __m128i p2 = _mm_loadu_si128((const __m128i*)pjPattern + 2);
+    __m128i *pxmm;
+
+    for (; cjRow >= DIB_FILL_PATTERN_SIZE; cjRow -= DIB_FILL_PATTERN_SIZE)
+    {
+        pxmm = (__m128i*)pjDest;
+        _mm_storeu_si128(pxmm + 0, _mm_xor_si128(_mm_loadu_si128(pxmm + 0), p0));
+        _mm_storeu_si128(pxmm + 1, _mm_xor_si128(_mm_loadu_si128(pxmm + 1), p1));
+        _mm_storeu_si128(pxmm + 2, _mm_xor_si128(_mm_loadu_si128(pxmm + 2), p2));
+        pjDest += DIB_FILL_PATTERN_SIZE;
+    }
+    DibXorRowC(pjDest, pjPattern, cjRow);
+}
+
+/* Load 4 pixels into the dwords of a vector. The 24 bpp load reads 16 bytes
+   for 12 bytes of pixels, so the caller keeps 2 pixels of slack in the row. */
+#define _DibLoad4_16(pj) \
+    _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(pj)), _mm_setzero_si128())
+#define _DibLoad4_24(pj) \
+    _DibUnpack24(_mm_loadu_si128((const __m128i*)(pj)))
+#define _DibLoad4_32(pj) \
+    _mm_loadu_si128((const __m128i*)(pj))
+
+#define _DibSlack_16 0
+#define _DibSlack_24 2
+#define _DibSlack_32 0
+
+static __inline
+__m128i
+_DibUnpack24(__m128i xmm)
+{
+    __m128i xmm01, xmm23;
+
+    xmm01 = _mm_unpacklo_epi32(xmm, _mm_srli_si128(xmm, 3));
+    xmm23 = _mm_unpacklo_epi32(_mm_srli_si128(xmm, 6), _mm_srli_si128(xmm, 9));
+
+    /* Drop the first byte of the next pixel from each dword */
+    return _mm_and_si128(_mm_unpacklo_epi64(xmm01, xmm23), _mm_set1_epi32(0x00FFFFFF));
+}
+
+static __inline
+VOID
+_DibStore4_16(BYTE *pjDest, __m128i xmm)
+{
+    /* Sign extend the low words, so the saturating pack keeps them as is */
+    xmm = _mm_srai_epi32(_mm_slli_epi32(xmm, 16), 16);
+    _mm_storel_epi64((__m128i*)pjDest, _mm_packs_epi32(xmm, xmm));
+}
+
+static __inline
+VOID
+_DibStore4_24(BYTE *pjDest, __m128i xmm)
+{
+    const __m128i xmmLow = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+    const __m128i xmmHigh = _mm_set_epi32(0x0000FFFF, 0xFF000000, 0x0000FFFF, 0xFF000000);
+    const __m128i xmmLowQword = _mm_set_epi32(0, 0, -1, -1);
+
+    /* Pack each pair of pixels into the low 6 bytes of its qword */
+    xmm = _mm_or_si128(_mm_and_si128(xmm, xmmLow),
+                       _mm_and_si128(_mm_srli_epi64(xmm, 8), xmmHigh));
+
+    /* Move the upper pair down next to the lower one */
+    xmm = _mm_or_si128(_mm_and_si128(xmm, xmmLowQword),
+                       _mm_srli_si128(_mm_andnot_si128(xmmLowQword, xmm), 2));
+
+    _mm_storel_epi64((__m128i*)pjDest, xmm);
+    *(ULONG*)(pjDest + 8) = (ULONG)_mm_cvtsi128_si32(_mm_srli_si128(xmm, 8));
+}
+
+static __inline
+VOID
+_DibStore4_32(BYTE *pjDest, __m128i xmm)
+{
+    _mm_storeu_si128((__m128i*)pjDest, xmm);
+}
+
+static __inline
+__m128i
+_DibRotlMask(__m128i xmm, __m128i xmmShift, __m128i xmmShiftBack, __m128i xmmMask)
+{
+    return _mm_and_si128(_mm_or_si128(_mm_sll_epi32(xmm, xmmShift),
+                                      _mm_srl_epi32(xmm, xmmShiftBack)),
+                         xmmMask);
+}
+
+#define __DIB_CONVERT_SSE2(src_bpp, dst_bpp) \
+static \
+VOID \
+DibConvertRow_S ## src_bpp ## _D ## dst_bpp ## _Sse2( \
+    BYTE *pjDest, const BYTE *pjSource, ULONG cPixels, const DIB_SHIFTMASK *psm) \
+{ \
+    __m128i axmmShift[3], axmmShiftBack[3], axmmMask[3], xmm; \
+    ULONG i; \
+\
+    for (i = 0; i < 3; i++) \
+    { \
+        axmmShift[i] = _mm_cvtsi32_si128(psm->aulShift[i]); \
+        axmmShiftBack[i] = _mm_cvtsi32_si128(32 - psm->aulShift[i]); \
+        axmmMask[i] = _mm_set1_epi32(psm->aulMask[i]); \
+    } \
+\
+    for (; cPixels >= 4 + _DibSlack_ ## src_bpp; cPixels -= 4) \
+    { \
+        xmm = _DibLoad4_ ## src_bpp(pjSource); \
+        xmm = _mm_or_si128( \
+            _mm_or_si128(_DibRotlMask(xmm, axmmShift[0], axmmShiftBack[0], axmmMask[0]), \
+                         _DibRotlMask(xmm, axmmShift[1], axmmShiftBack[1], axmmMask[1])), \
+            _DibRotlMask(xmm, axmmShift[2], axmmShiftBack[2], axmmMask[2])); \
+        _DibStore4_ ## dst_bpp(pjDest, xmm); \
+        pjSource += 4 * src_bpp / 8; \
+        pjDest += 4 * dst_bpp / 8; \
+    } \
+\
+    DibConvertRow_S ## src_bpp ## _D ## dst_bpp ## _C(pjDest, pjSource, cPixels, psm); \
+}
+
+__DIB_CONVERT_SSE2(16, 16)
+__DIB_CONVERT_SSE2(16, 24)
+__DIB_CONVERT_SSE2(16, 32)
+__DIB_CONVERT_SSE2(24, 16)
+__DIB_CONVERT_SSE2(24, 24)
+__DIB_CONVERT_SSE2(24, 32)
+__DIB_CONVERT_SSE2(32, 16)
+__DIB_CONVERT_SSE2(32, 24)
+__DIB_CONVERT_SSE2(32, 32)
+
+const DIB_ROW_KERNELS gDibRowKernelsSse2 =
+{
+    DibCopyRowC,
+    DibXorRowSse2,
+    DibAndRowSse2,
+    DibNotRowSse2,
+    DibFillRowC,
+    DibXorFillRowSse2,
+    {
+        { DibConvertRow_S16_D16_Sse2, DibConvertRow_S24_D16_Sse2, DibConvertRow_S32_D16_Sse2 },
+        { DibConvertRow_S16_D24_Sse2, DibConvertRow_S24_D24_Sse2, DibConvertRow_S32_D24_Sse2 },
+        { DibConvertRow_S16_D32_Sse2, DibConvertRow_S24_D32_Sse2, DibConvertRow_S32_D32_Sse2 },
+    }
+};
+
+#endif /* _DIBLIB_SSE2 */
@@ -0,0 +1,61 @@
+
+/*
+ * Row kernels for the common ROPs and colour conversions.
+ *
+ * The kernels only see byte pointers and counts, they don't know about
+ * BLTDATA or XLATEOBJs, so that sdk/tools/dibbench can build this file and
+ * RowKernels.c on the host and compare them against the per-pixel loops.
+ */
+
+#pragma once
+
+/* The SSE2 kernels need the XMM registers to survive a context switch. The
+   amd64 kernel guarantees that, the i386 one does not (KeSaveFloatingPointState
+   only saves the x87 state), so there they stay disabled in win32k. */
+#if defined(_M_AMD64) || defined(__x86_64__)
+#define _DIBLIB_SSE2 1
+#endif
+
+/* Colour conversion as done by EXLATEOBJ_iXlateShiftAndMask:
+   each channel is rotated left by aulShift[i] and masked with aulMask[i] */
+typedef struct _DIB_SHIFTMASK
+{
+    ULONG aulShift[3];
+    ULONG aulMask[3];
+} DIB_SHIFTMASK, *PDIB_SHIFTMASK;
+
+/* Fill patterns hold 16 pixels, which is a whole number of 16 byte vectors
+   for every format from 8 to 32 bpp */
+#define DIB_FILL_PATTERN_SIZE 48
+
+typedef VOID (*PFN_DIBROW_ROP)(BYTE *pjDest, const BYTE *pjSource, ULONG cjRow);
+typedef VOID (*PFN_DIBROW_DEST)(BYTE *pjDest, ULONG cjRow);
+typedef VOID (*PFN_DIBROW_FILL)(BYTE *pjDest, const BYTE *pjPattern, ULONG cjRow);
+typedef VOID (*PFN_DIBROW_CONVERT)(BYTE *pjDest, const BYTE *pjSource, ULONG cPixels, const DIB_SHIFTMASK *psm);
+
+typedef struct _DIB_ROW_KERNELS
+{
+    PFN_DIBROW_ROP pfnCopy;         /* D = S */
+    PFN_DIBROW_ROP pfnXor;          /* D = D ^ S */
+    PFN_DIBROW_ROP pfnAnd;          /* D = D & S */
+    PFN_DIBROW_DEST pfnNot;         /* D = ~D */
+    PFN_DIBROW_FILL pfnFill;        /* D = P */
+    PFN_DIBROW_FILL pfnXorFill;     /* D = D ^ P */
+
+    /* Indexed by [iDstIndex][iSrcIndex], 0 = 16 bpp, 1 = 24 bpp, 2 = 32 bpp */
+    PFN_DIBROW_CONVERT apfnConvert[3][3];
+} DIB_ROW_KERNELS, *PDIB_ROW_KERNELS;
+
+#define DIB_CONVERT_INDEX(bpp) (((bpp) >> 3) - 2)
+
+extern const DIB_ROW_KERNELS gDibRowKernelsC;
+#ifdef _DIBLIB_SSE2
+extern const DIB_ROW_KERNELS gDibRowKernelsSse2;
+#endif
+extern const DIB_ROW_KERNELS *gpDibRowKernels;
+
+VOID
+Dib_vInitRowKernels(BOOLEAN bSse2);
+
+VOID
+Dib_vBuildFillPattern(BYTE *pjPattern, ULONG ulColor, ULONG cjPixel);
@@ -141,6 +141,9 @@ EngBitBlt(
     if (!pxlo) pxlo = &gexloTrivial.xlo;
     bltdata.pxlo = pxlo;
     bltdata.pfnXlate = XLATEOBJ_pfnXlate(pxlo);
+    bltdata.bXlateShiftMask = EXLATEOBJ_bGetShiftMask((PEXLATEOBJ)pxlo,
+                                                      bltdata.smXlate.aulShift,
+                                                      bltdata.smXlate.aulMask);
 
     /* Check if the ROP uses a source */
     if (ROP4_USES_SOURCE(rop4))
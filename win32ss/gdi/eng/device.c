@@ -246,6 +246,9 @@ EngpRegisterGraphicsDevice(
     // FIXME: initialize state flags
     pGraphicsDevice->StateFlags = 0;
 
+    /* Full acceleration unless the registry says otherwise */
+    pGraphicsDevice->ulAccelerationLevel = 0;
+
     /* Create the mode list */
     pGraphicsDevice->pDevModeList = NULL;
     if (!EngpPopulateDeviceModeList(pGraphicsDevice, pdmDefault))
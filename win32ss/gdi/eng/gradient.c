@@ -60,6 +60,8 @@ IntEngGradientFillRect(
     POINTL Translate;
     INTENG_ENTER_LEAVE EnterLeave;
     LONG y, dy, c[3], dc[3], ec[3], ic[3];
+    ULONG cjPixel, cjRow;
+    PBYTE pjRow, pjDest;
 
     v1 = (pVertex + gRect->UpperLeft);
     v2 = (pVertex + gRect->LowerRight);
@@ -87,6 +89,12 @@ IntEngGradientFillRect(
 
     if((v1->Red != v2->Red || v1->Green != v2->Green || v1->Blue != v2->Blue) && dy > 1)
     {
+        /* 8 bpp and up have whole bytes per pixel */
+        if (psoOutput->iBitmapFormat >= BMF_8BPP && psoOutput->iBitmapFormat <= BMF_32BPP)
+            cjPixel = BitsPerFormat(psoOutput->iBitmapFormat) / 8;
+        else
+            cjPixel = 0;
+
         CLIPOBJ_cEnumStart(pco, FALSE, CT_RECTANGLES, CD_RIGHTDOWN, 0);
         do
         {
@@ -104,18 +112,43 @@ IntEngGradientFillRect(
                         HVINITCOL(Green, 1);
                         HVINITCOL(Blue, 2);
 
+                        /* Every row looks the same, so with whole bytes per
+                           pixel only the top one is drawn pixel by pixel and
+                           then copied down, instead of a line per column */
                         for (y = rcSG.left; y < FillRect.right; y++)
                         {
                             if (y >= FillRect.left)
                             {
                                 Color = XLATEOBJ_iXlate(pxlo, RGB(c[0], c[1], c[2]));
-                                DibFunctionsForBitmapFormat[psoOutput->iBitmapFormat].DIB_VLine(
-                                    psoOutput, y + Translate.x, FillRect.top + Translate.y, FillRect.bottom + Translate.y, Color);
+                                if (cjPixel)
+                                {
+                                    DibFunctionsForBitmapFormat[psoOutput->iBitmapFormat].DIB_PutPixel(
+                                        psoOutput, y + Translate.x, FillRect.top + Translate.y, Color);
+                                }
+                                else
+                                {
+                                    DibFunctionsForBitmapFormat[psoOutput->iBitmapFormat].DIB_VLine(
+                                        psoOutput, y + Translate.x, FillRect.top + Translate.y, FillRect.bottom + Translate.y, Color);
+                                }
                             }
                             HVSTEPCOL(0);
                             HVSTEPCOL(1);
                             HVSTEPCOL(2);
                         }
+
+                        if (cjPixel && FillRect.left < FillRect.right)
+                        {
+                            cjRow = (FillRect.right - FillRect.left) * cjPixel;
+                            pjRow = (PBYTE)psoOutput->pvScan0 +
+                                    (FillRect.top + Translate.y) * psoOutput->lDelta +
+                                    (FillRect.left + Translate.x) * cjPixel;
+                            pjDest = pjRow;
+                            for (y = FillRect.top + 1; y < FillRect.bottom; y++)
+                            {
+                                pjDest += psoOutput->lDelta;
+                                RtlCopyMemory(pjDest, pjRow, cjRow);
+                            }
+                        }
                     }
                 }
 
@@ -735,6 +735,32 @@ EngGetDriverName(_In_ HDEV hdev)
     return ppdev->pldev->pGdiDriverInfo->DriverName.Buffer;
 }
 
+BOOL
+APIENTRY
+EngQueryDeviceAttribute(
+    _In_ HDEV hdev,
+    _In_ ENG_DEVICE_ATTRIBUTE devAttr,
+    _In_reads_bytes_(cjInSize) PVOID pvIn,
+    _In_ ULONG cjInSize,
+    _Out_writes_bytes_(cjOutSize) PVOID pvOut,
+    _In_ ULONG cjOutSize)
+{
+    PPDEVOBJ ppdev = (PPDEVOBJ)hdev;
+
+    ASSERT(ppdev);
+
+    if (devAttr != QDA_ACCELERATION_LEVEL || !pvOut || cjOutSize < sizeof(ULONG))
+    {
+        return FALSE;
+    }
+
+    /* Display devices carry the level read from their registry key */
+    *(PULONG)pvOut = ppdev->pGraphicsDevice ?
+                     ppdev->pGraphicsDevice->ulAccelerationLevel : 0;
+
+    return TRUE;
+}
+
 
 INT
 APIENTRY
@@ -76,6 +76,7 @@ typedef struct _GRAPHICS_DEVICE
     DWORD            ProtocolType;
     ULONG            iDefaultMode;
     ULONG            iCurrentMode;
+    ULONG            ulAccelerationLevel;            /* See QDA_ACCELERATION_LEVEL */
 } GRAPHICS_DEVICE, *PGRAPHICS_DEVICE;
 
 typedef struct _PDEVOBJ
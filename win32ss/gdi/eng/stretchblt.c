@@ -20,7 +20,8 @@ typedef BOOLEAN (APIENTRY *PSTRETCHRECTFUNC)(SURFOBJ* OutputObj,
                                             POINTL* MaskOrigin,
                                             BRUSHOBJ* pbo,
                                             POINTL* BrushOrigin,
-                                            ROP4 Rop4);
+                                            ROP4 Rop4,
+                                            ULONG Mode);
 
 static BOOLEAN APIENTRY
 CallDibStretchBlt(SURFOBJ* psoDest,
@@ -32,12 +33,20 @@ CallDibStretchBlt(SURFOBJ* psoDest,
                   POINTL* MaskOrigin,
                   BRUSHOBJ* pbo,
                   POINTL* BrushOrigin,
-                  ROP4 Rop4)
+                  ROP4 Rop4,
+                  ULONG Mode)
 {
     POINTL RealBrushOrigin;
     SURFOBJ* psoPattern;
     BOOL bResult;
 
+    /* Filtered stretching for plain copies, unsupported formats fall through */
+    if (Mode == HALFTONE && Rop4 == ROP4_SRCCOPY && !Mask && psoSource &&
+        DIB_XXBPP_StretchBltHalftone(psoDest, psoSource, OutputRect, InputRect, ColorTranslation))
+    {
+        return TRUE;
+    }
+
     if (BrushOrigin == NULL)
     {
         RealBrushOrigin.x = RealBrushOrigin.y = 0;
@@ -242,7 +251,7 @@ EngStretchBltROP(
         case DC_TRIVIAL:
             Ret = (*BltRectFunc)(psoOutput, psoInput, Mask,
                          ColorTranslation, &OutputRect, &InputRect, MaskOrigin,
-                         pbo, &AdjustedBrushOrigin, Rop4);
+                         pbo, &AdjustedBrushOrigin, Rop4, Mode);
             break;
         case DC_RECT:
             // Clip the blt to the clip rectangle
@@ -263,7 +272,8 @@ EngStretchBltROP(
                            MaskOrigin,
                            pbo,
                            &AdjustedBrushOrigin,
-                           Rop4);
+                           Rop4,
+                           Mode);
             }
             break;
         case DC_COMPLEX:
@@ -308,7 +318,8 @@ EngStretchBltROP(
                            MaskOrigin,
                            pbo,
                            &AdjustedBrushOrigin,
-                           Rop4);
+                           Rop4,
+                           Mode);
                     }
                 }
             }
@@ -371,7 +382,8 @@ IntEngStretchBlt(SURFOBJ *psoDest,
                  POINTL *pMaskOrigin,
                  BRUSHOBJ *pbo,
                  POINTL *BrushOrigin,
-                 DWORD Rop4)
+                 DWORD Rop4,
+                 ULONG iMode)
 {
     BOOLEAN ret;
     POINTL MaskOrigin = {0, 0};
@@ -491,7 +503,7 @@ IntEngStretchBlt(SURFOBJ *psoDest,
                                                  &OutputRect,
                                                  &InputRect,
                                                  &MaskOrigin,
-                                                 COLORONCOLOR,
+                                                 iMode,
                                                  pbo,
                                                  Rop4);
     }
@@ -508,7 +520,7 @@ IntEngStretchBlt(SURFOBJ *psoDest,
                                &OutputRect,
                                &InputRect,
                                &MaskOrigin,
-                               COLORONCOLOR,
+                               iMode,
                                pbo,
                                Rop4);
     }
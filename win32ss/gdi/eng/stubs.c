@@ -577,23 +577,6 @@ EngPlgBlt(
     return FALSE;
 }
 
-/*
- * @unimplemented
- */
-BOOL
-APIENTRY
-EngQueryDeviceAttribute(
-    IN HDEV Device,
-    IN ENG_DEVICE_ATTRIBUTE Attribute,
-    IN VOID *In,
-    IN ULONG InSize,
-    OUT VOID *Out,
-    OUT ULONG OutSize)
-{
-    UNIMPLEMENTED;
-    return FALSE;
-}
-
 /*
  * @unimplemented
  */
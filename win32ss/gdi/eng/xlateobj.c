@@ -644,6 +644,55 @@ VOID NTAPI EXLATEOBJ_vInitSrcMonoXlate(
                           crForegroundClr);
 }
 
+/* Describes the translation as one rotate and mask per channel, the way
+   EXLATEOBJ_iXlateShiftAndMask does it. Fails for table based translations. */
+BOOL
+NTAPI
+EXLATEOBJ_bGetShiftMask(
+    _In_ PEXLATEOBJ pexlo,
+    _Out_writes_(3) PULONG pulShift,
+    _Out_writes_(3) PULONG pulMask)
+{
+    static const struct
+    {
+        PFN_XLATE pfnXlate;
+        ULONG aulShift[3];
+        ULONG aulMask[3];
+    } aFixed[] =
+    {
+        {EXLATEOBJ_iXlateTrivial,  {0, 0, 0},    {0xFFFFFFFF, 0, 0}},
+        {EXLATEOBJ_iXlateRGBtoBGR, {0, 16, 0},   {0xFF00FF00, 0x00FF00FF, 0}},
+        {EXLATEOBJ_iXlateRGBto555, {7, 26, 13},  {0x7C00, 0x3E0, 0x1F}},
+        {EXLATEOBJ_iXlateRGBto565, {8, 27, 13},  {0xF800, 0x7E0, 0x1F}},
+        {EXLATEOBJ_iXlateBGRto555, {29, 26, 23}, {0x1F, 0x3E0, 0x7C00}},
+        {EXLATEOBJ_iXlateBGRto565, {29, 27, 24}, {0x1F, 0x7E0, 0xF800}},
+    };
+    ULONG i;
+
+    if (pexlo->pfnXlate == EXLATEOBJ_iXlateShiftAndMask)
+    {
+        pulShift[0] = pexlo->ulRedShift & 31;
+        pulShift[1] = pexlo->ulGreenShift & 31;
+        pulShift[2] = pexlo->ulBlueShift & 31;
+        pulMask[0] = pexlo->ulRedMask;
+        pulMask[1] = pexlo->ulGreenMask;
+        pulMask[2] = pexlo->ulBlueMask;
+        return TRUE;
+    }
+
+    for (i = 0; i < _countof(aFixed); i++)
+    {
+        if (pexlo->pfnXlate == aFixed[i].pfnXlate)
+        {
+            RtlCopyMemory(pulShift, aFixed[i].aulShift, sizeof(aFixed[i].aulShift));
+            RtlCopyMemory(pulMask, aFixed[i].aulMask, sizeof(aFixed[i].aulMask));
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 VOID
 NTAPI
 EXLATEOBJ_vCleanup(
@@ -79,6 +79,13 @@ EXLATEOBJ_vInitSrcMonoXlate(
     _In_ COLORREF crBackgroundClr,
     _In_ COLORREF crForegroundClr);
 
+BOOL
+NTAPI
+EXLATEOBJ_bGetShiftMask(
+    _In_ PEXLATEOBJ pexlo,
+    _Out_writes_(3) PULONG pulShift,
+    _Out_writes_(3) PULONG pulMask);
+
 VOID
 NTAPI
 EXLATEOBJ_vCleanup(
@@ -661,6 +661,85 @@ REGION_SetExtents(
     pReg->rdh.iType = RDH_RECTANGLES;
 }
 
+/*
+ * The rectangles of a region are stored in y-x banded order: bands do not
+ * overlap, are sorted by top, and every rectangle in a band shares the
+ * band's top and bottom. Both the tops and the bottoms are therefore
+ * nondecreasing over the whole buffer, and the rectangles of one band are
+ * sorted by left (and right). The buffer itself serves as a band index,
+ * so the helpers below locate bands and spans with a binary search.
+ */
+
+/* Returns the index of the first rect at or after iStart whose bottom is below y */
+static
+ULONG
+FASTCALL
+REGION_FindBand(
+    _In_ PREGION prgn,
+    _In_ ULONG iStart,
+    _In_ INT y)
+{
+    ULONG iLow = iStart, iHigh = prgn->rdh.nCount, iMid;
+
+    while (iLow < iHigh)
+    {
+        iMid = iLow + (iHigh - iLow) / 2;
+        if (prgn->Buffer[iMid].bottom > y)
+            iHigh = iMid;
+        else
+            iLow = iMid + 1;
+    }
+
+    return iLow;
+}
+
+/* Returns the index of the first rect at or after iStart whose top is at or below y */
+static
+ULONG
+FASTCALL
+REGION_FindBandTop(
+    _In_ PREGION prgn,
+    _In_ ULONG iStart,
+    _In_ INT y)
+{
+    ULONG iLow = iStart, iHigh = prgn->rdh.nCount, iMid;
+
+    while (iLow < iHigh)
+    {
+        iMid = iLow + (iHigh - iLow) / 2;
+        if (prgn->Buffer[iMid].top >= y)
+            iHigh = iMid;
+        else
+            iLow = iMid + 1;
+    }
+
+    return iLow;
+}
+
+/* Returns the index of the first rect in [iBand, iBandEnd) whose right is beyond x */
+static
+ULONG
+FASTCALL
+REGION_FindInBand(
+    _In_ PREGION prgn,
+    _In_ ULONG iBand,
+    _In_ ULONG iBandEnd,
+    _In_ INT x)
+{
+    ULONG iLow = iBand, iHigh = iBandEnd, iMid;
+
+    while (iLow < iHigh)
+    {
+        iMid = iLow + (iHigh - iLow) / 2;
+        if (prgn->Buffer[iMid].right > x)
+            iHigh = iMid;
+        else
+            iLow = iMid + 1;
+    }
+
+    return iLow;
+}
+
 // FIXME: This function needs review and testing
 /***********************************************************************
  *           REGION_CropRegion
@@ -686,22 +765,15 @@ REGION_CropRegion(
         goto empty;
     }
 
-    /* Skip all rects that are completely above our intersect rect */
-    for (clipa = 0; clipa < rgnSrc->rdh.nCount; clipa++)
-    {
-        /* bottom is exclusive, so break when we go above it */
-        if (rgnSrc->Buffer[clipa].bottom > rect->top) break;
-    }
+    /* Skip all rects that are completely above our intersect rect
+       (bottom is exclusive) */
+    clipa = REGION_FindBand(rgnSrc, 0, rect->top);
 
     /* Bail out, if there is nothing left */
     if (clipa == rgnSrc->rdh.nCount) goto empty;
 
     /* Find the last rect that is still within the intersect rect (exclusive) */
-    for (clipb = clipa; clipb < rgnSrc->rdh.nCount; clipb++)
-    {
-        /* bottom is exclusive, so stop, when we start at that y pos */
-        if (rgnSrc->Buffer[clipb].top >= rect->bottom) break;
-    }
+    clipb = REGION_FindBandTop(rgnSrc, clipa, rect->bottom);
 
     /* Bail out, if there is nothing left */
     if (clipb == clipa) goto empty;
@@ -971,6 +1043,7 @@ REGION_RegionOp(
     RECTL *r2BandEnd;                  /* End of current band in r2 */
     ULONG top;                         /* Top of non-overlapping band */
     ULONG bot;                         /* Bottom of non-overlapping band */
+    ULONG cjNewSize;                   /* Initial size of the new rect array */
 
     /* Initialization:
      *  set r1, r2, r1End and r2End appropriately, preserve the important
@@ -993,15 +1066,27 @@ REGION_RegionOp(
      * reallocate and copy the array, which is time consuming, yet we don't
      * have to worry about using too much memory. I hope to be able to
      * nuke the Xrealloc() at the end of this function eventually. */
-    newReg->rdh.nRgnSize = max(reg1->rdh.nCount + 1, reg2->rdh.nCount) * 2 * sizeof(RECT);
+    cjNewSize = max(reg1->rdh.nCount + 1, reg2->rdh.nCount) * 2 * sizeof(RECT);
 
-    newReg->Buffer = ExAllocatePoolWithTag(PagedPool,
-                                           newReg->rdh.nRgnSize,
-                                           TAG_REGION);
-    if (newReg->Buffer == NULL)
+    /* If the destination is a separate region whose pool buffer is already
+     * large enough, keep using it instead of allocating a new one. */
+    if ((newReg != reg1) && (newReg != reg2) &&
+        (oldRects != NULL) && (oldRects != &newReg->rdh.rcBound) &&
+        (newReg->rdh.nRgnSize >= cjNewSize))
     {
-        newReg->rdh.nRgnSize = 0;
-        return;
+        oldRects = NULL;
+    }
+    else
+    {
+        newReg->rdh.nRgnSize = cjNewSize;
+        newReg->Buffer = ExAllocatePoolWithTag(PagedPool,
+                                               newReg->rdh.nRgnSize,
+                                               TAG_REGION);
+        if (newReg->Buffer == NULL)
+        {
+            newReg->rdh.nRgnSize = 0;
+            return;
+        }
     }
 
     /* Initialize ybot and ytop.
@@ -1174,8 +1259,10 @@ REGION_RegionOp(
      * rectangles in the region. This never goes to 0, however...
      *
      * Only do this stuff if the number of rectangles allocated is more than
-     * twice the number of rectangles in the region (a simple optimization...). */
-    if ((newReg->rdh.nRgnSize > (2 * newReg->rdh.nCount * sizeof(RECT))) &&
+     * four times the number of rectangles in the region. The initial
+     * allocation above already reserves twice the expected count, so a
+     * factor of two would make nearly every operation reallocate and copy. */
+    if ((newReg->rdh.nRgnSize > (4 * newReg->rdh.nCount * sizeof(RECT))) &&
         (newReg->rdh.nCount > 2))
     {
         if (REGION_NOT_EMPTY(newReg))
@@ -1214,7 +1301,7 @@ REGION_RegionOp(
 
     newReg->rdh.iType = RDH_RECTANGLES;
 
-    if (oldRects != &newReg->rdh.rcBound)
+    if ((oldRects != NULL) && (oldRects != &newReg->rdh.rcBound))
         ExFreePoolWithTag(oldRects, TAG_REGION);
     return;
 }
@@ -2563,17 +2650,20 @@ REGION_PtInRegion(
     INT X,
     INT Y)
 {
-    ULONG i;
-    PRECT r;
+    ULONG i, iBandEnd;
 
     if (prgn->rdh.nCount > 0 && INRECT(prgn->rdh.rcBound, X, Y))
     {
-        r =  prgn->Buffer;
-        for (i = 0; i < prgn->rdh.nCount; i++)
-        {
-            if (INRECT(r[i], X, Y))
-                return TRUE;
-        }
+        /* Find the band containing Y */
+        i = REGION_FindBand(prgn, 0, Y);
+        if ((i == prgn->rdh.nCount) || (prgn->Buffer[i].top > Y))
+            return FALSE;
+
+        /* Find the first span in that band that ends right of X */
+        iBandEnd = REGION_FindBandTop(prgn, i, prgn->Buffer[i].bottom);
+        i = REGION_FindInBand(prgn, i, iBandEnd, X);
+
+        return (i < iBandEnd) && (prgn->Buffer[i].left <= X);
     }
 
     return FALSE;
@@ -2585,7 +2675,7 @@ REGION_RectInRegion(
     PREGION Rgn,
     const RECTL *rect)
 {
-    PRECTL pCurRect, pRectEnd;
+    ULONG i, iBandEnd, iSpan;
     RECT rc;
 
     /* Swap the coordinates to make right >= left and bottom >= top */
@@ -2615,24 +2705,17 @@ REGION_RectInRegion(
     /* This is (just) a useful optimization */
     if ((Rgn->rdh.nCount > 0) && EXTENTCHECK(&Rgn->rdh.rcBound, &rc))
     {
-        for (pCurRect = Rgn->Buffer, pRectEnd = pCurRect +
-                                                Rgn->rdh.nCount; pCurRect < pRectEnd; pCurRect++)
+        /* Walk the bands overlapping the rect vertically and look up the
+           first span of each band that ends right of its left edge */
+        for (i = REGION_FindBand(Rgn, 0, rc.top);
+             (i < Rgn->rdh.nCount) && (Rgn->Buffer[i].top < rc.bottom);
+             i = iBandEnd)
         {
-            if (pCurRect->bottom <= rc.top)
-                continue;             /* Not far enough down yet */
+            iBandEnd = REGION_FindBandTop(Rgn, i, Rgn->Buffer[i].bottom);
+            iSpan = REGION_FindInBand(Rgn, i, iBandEnd, rc.left);
 
-            if (pCurRect->top >= rc.bottom)
-                break;                /* Too far down */
-
-            if (pCurRect->right <= rc.left)
-                continue;              /* Not far enough over yet */
-
-            if (pCurRect->left >= rc.right)
-            {
-                continue;
-            }
-
-            return TRUE;
+            if ((iSpan < iBandEnd) && (Rgn->Buffer[iSpan].left < rc.right))
+                return TRUE;
         }
     }
 
@@ -75,6 +75,7 @@ InitDisplayDriver(
     HKEY hkey;
     DEVMODEW dmDefault;
     DWORD dwVga;
+    DWORD dwAccelerationLevel;
 
     TRACE("InitDisplayDriver(%S, %S);\n",
           pwszDeviceName, pwszRegKey);
@@ -134,6 +135,11 @@ InitDisplayDriver(
     Status = RegQueryValue(hkey, L"VgaCompatible", REG_DWORD, &dwVga, &cbSize);
     if (!NT_SUCCESS(Status)) dwVga = 0;
 
+    /* Query the acceleration level the driver should use */
+    cbSize = sizeof(DWORD);
+    Status = RegQueryValue(hkey, L"Acceleration.Level", REG_DWORD, &dwAccelerationLevel, &cbSize);
+    if (!NT_SUCCESS(Status)) dwAccelerationLevel = 0;
+
     /* Close the registry key */
     ZwClose(hkey);
 
@@ -148,6 +154,11 @@ InitDisplayDriver(
         pGraphicsDevice->StateFlags |= DISPLAY_DEVICE_VGA_COMPATIBLE;
     }
 
+    if (pGraphicsDevice)
+    {
+        pGraphicsDevice->ulAccelerationLevel = dwAccelerationLevel;
+    }
+
     return pGraphicsDevice;
 }
 
@@ -13,6 +13,10 @@
 #include <debug.h>
 #include <kdros.h>
 
+#ifdef _USE_DIBLIB_
+#include "../../gdi/diblib/DibLib_interface.h"
+#endif
+
 HANDLE hModuleWin;
 
 NTSTATUS ExitProcessCallback(PEPROCESS Process);
@@ -980,6 +984,14 @@ DriverEntry(
     NT_ROF(InitGdiHandleTable());
     NT_ROF(InitPaletteImpl());
 
+    /* Pick the AlphaBlend row kernels for this processor */
+    DIB_vInitBlendKernels(ExIsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE));
+
+#ifdef _USE_DIBLIB_
+    /* Pick the DibLib row kernels for this processor */
+    Dib_vInitRowKernels(ExIsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE));
+#endif
+
     /* Create stock objects, ie. precreated objects commonly
        used by win32 applications */
     CreateStockObjects();
@@ -18,6 +18,7 @@ VIS_ComputeVisibleRegion(
 {
    PREGION VisRgn, ClipRgn;
    PWND PreviousWindow, CurrentWindow, CurrentSibling;
+   RECTL rcClip;
 
    if (!Wnd || !(Wnd->style & WS_VISIBLE))
    {
@@ -60,9 +61,10 @@ VIS_ComputeVisibleRegion(
          return NULL;
       }
 
-      ClipRgn = IntSysCreateRectpRgnIndirect(&CurrentWindow->rcClient);
-      IntGdiCombineRgn(VisRgn, VisRgn, ClipRgn, RGN_AND);
-      REGION_Delete(ClipRgn);
+      /* Crop to the parent's client area in place, no temporary region needed */
+      rcClip = CurrentWindow->rcClient;
+      RECTL_vMakeWellOrdered(&rcClip);
+      REGION_CropRegion(VisRgn, VisRgn, &rcClip);
 
       if ((PreviousWindow->style & WS_CLIPSIBLINGS) ||
           (PreviousWindow == Wnd && ClipSiblings))
@@ -72,7 +74,16 @@ VIS_ComputeVisibleRegion(
                  CurrentSibling != PreviousWindow )
          {
             if ((CurrentSibling->style & WS_VISIBLE) &&
-                !(CurrentSibling->ExStyle & WS_EX_TRANSPARENT))
+                !(CurrentSibling->ExStyle & WS_EX_TRANSPARENT) &&
+                !(CurrentSibling->hrgnClip && !(CurrentSibling->style & WS_MINIMIZE)))
+            {
+               /* Plain rectangular sibling, subtract its window rect directly */
+               rcClip = CurrentSibling->rcWindow;
+               RECTL_vMakeWellOrdered(&rcClip);
+               REGION_SubtractRectFromRgn(VisRgn, VisRgn, &rcClip);
+            }
+            else if ((CurrentSibling->style & WS_VISIBLE) &&
+                     !(CurrentSibling->ExStyle & WS_EX_TRANSPARENT))
             {
                ClipRgn = IntSysCreateRectpRgnIndirect(&CurrentSibling->rcWindow);
                /* Combine it with the window region if available */
@@ -104,7 +115,16 @@ VIS_ComputeVisibleRegion(
       while (CurrentWindow)
       {
          if ((CurrentWindow->style & WS_VISIBLE) &&
-             !(CurrentWindow->ExStyle & WS_EX_TRANSPARENT))
+             !(CurrentWindow->ExStyle & WS_EX_TRANSPARENT) &&
+             !(CurrentWindow->hrgnClip && !(CurrentWindow->style & WS_MINIMIZE)))
+         {
+            /* Plain rectangular child, subtract its window rect directly */
+            rcClip = CurrentWindow->rcWindow;
+            RECTL_vMakeWellOrdered(&rcClip);
+            REGION_SubtractRectFromRgn(VisRgn, VisRgn, &rcClip);
+         }
+         else if ((CurrentWindow->style & WS_VISIBLE) &&
+                  !(CurrentWindow->ExStyle & WS_EX_TRANSPARENT))
          {
             ClipRgn = IntSysCreateRectpRgnIndirect(&CurrentWindow->rcWindow);
             /* Combine it with the window region if available */
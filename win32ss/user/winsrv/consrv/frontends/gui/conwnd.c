@@ -613,6 +613,7 @@ OnNcCreate(HWND hWnd, LPCREATESTRUCTW Create)
     GuiData->hMemDC  = CreateCompatibleDC(NULL);
     GuiData->hBitmap = NULL;
     GuiData->hSysPalette = NULL; /* Original system palette */
+    ConioInitRect(&GuiData->PendingRegion, 0, 0, -1, -1);
 
     /* Update the icons of the window */
     if (GuiData->hIcon != ghDefaultIcon)
@@ -995,6 +996,14 @@ OnPaint(PGUI_CONSOLE_DATA GuiData)
     /* Do nothing if the window is hidden */
     if (!GuiData->IsWindowVisible) return;
 
+    /* Apply the pending scroll before composing anything into the framebuffer */
+    if (GuiData->UpdatePending &&
+        ConDrvValidateConsoleUnsafe((PCONSOLE)GuiData->Console, CONSOLE_RUNNING, TRUE))
+    {
+        GuiFlushPendingUpdate(GuiData);
+        LeaveCriticalSection(&GuiData->Console->Lock);
+    }
+
     BeginPaint(GuiData->hWindow, &ps);
     if (ps.hdc != NULL &&
         ps.rcPaint.left < ps.rcPaint.right &&
@@ -1265,6 +1274,9 @@ OnTimer(PGUI_CONSOLE_DATA GuiData)
 
     Buff = GuiData->ActiveBuffer;
 
+    /* Send the output coalesced since the last frame to the screen */
+    GuiFlushPendingUpdate(GuiData);
+
     if (GetType(Buff) == TEXTMODE_BUFFER)
     {
         InvalidateCell(GuiData, Buff->CursorPosition.X, Buff->CursorPosition.Y);
@@ -1397,6 +1409,7 @@ OnNcDestroy(HWND hWnd)
         /* Free the terminal framebuffer */
         if (GuiData->hMemDC ) DeleteDC(GuiData->hMemDC);
         if (GuiData->hBitmap) DeleteObject(GuiData->hBitmap);
+        if (GuiData->DirtyLines) ConsoleFreeHeap(GuiData->DirtyLines);
         // if (GuiData->hSysPalette) DeleteObject(GuiData->hSysPalette);
         DeleteFonts(GuiData);
     }
@@ -2506,6 +2519,7 @@ ConWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
                 if (hold == GuiData->hBitmap) DeleteObject(GuiData->hBitmap);
             }
             GuiData->hBitmap = hnew;
+            GuiResetFramebufferCache(GuiData);
 
             /* Resize the window to the user's values */
             GuiData->WindowSizeLock = TRUE;
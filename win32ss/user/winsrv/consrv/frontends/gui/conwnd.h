@@ -37,6 +37,13 @@ typedef struct _CONSOLE_FONT
 #define FONT_UNDERLINE  0x02
 #define FONT_MAXNO      0x04
 
+/* Cells of a framebuffer row that must be redrawn; empty when Left > Right */
+typedef struct _GUI_DIRTY_SPAN
+{
+    SHORT Left;
+    SHORT Right;
+} GUI_DIRTY_SPAN, *PGUI_DIRTY_SPAN;
+
 typedef struct _GUI_CONSOLE_DATA
 {
     CRITICAL_SECTION Lock;
@@ -63,6 +70,18 @@ typedef struct _GUI_CONSOLE_DATA
     HBITMAP  hBitmap;           /* Console framebuffer                       */
     HPALETTE hSysPalette;       /* Handle to the original system palette     */
 
+/*** Text-mode framebuffer cache (see text.c), protected by the console lock ***/
+    PGUI_DIRTY_SPAN DirtyLines; /* One span per physical row of the screen buffer */
+    COORD   DirtyBufferSize;    /* Screen buffer size DirtyLines was set up for   */
+    PVOID   DirtyOwner;         /* Screen buffer, bitmap and font the framebuffer */
+    HBITMAP DirtyBitmap;        /* was composed with; a change means everything   */
+    HFONT   DirtyFont;          /* has to be redrawn                              */
+    COORD   CaretCell;          /* Cell where the caret was drawn in hMemDC       */
+    BOOLEAN CaretDrawn;
+    BOOLEAN UpdatePending;      /* The frame timer is armed for a pending update  */
+    UINT    PendingScroll;      /* Lines hMemDC and the window still have to scroll */
+    SMALL_RECT PendingRegion;   /* Region to invalidate at the next frame         */
+
     HICON hIcon;                /* Handle to the console's icon (big)   */
     HICON hIconSm;              /* Handle to the console's icon (small) */
 
@@ -345,6 +345,8 @@ GuiApplyUserSettings(PGUI_CONSOLE_DATA GuiData,
         GuiData->GuiInfo.WindowOrigin = pConInfo->WindowPosition;
         GuiConsoleMoveWindow(GuiData);
 
+        /* The colors and the font may have changed */
+        GuiResetFramebufferCache(GuiData);
         InvalidateRect(GuiData->hWindow, NULL, TRUE);
 
         /*
@@ -22,6 +22,7 @@
 // HACK!! Remove it when the hack in GuiWriteStream is fixed
 #define CONGUI_UPDATE_TIME    0
 #define CONGUI_UPDATE_TIMER   1
+#define CONGUI_FRAME_TIME     16    /* Streamed output reaches the screen at most once per frame */
 
 #define PM_CREATE_CONSOLE     (WM_APP + 1)
 #define PM_DESTROY_CONSOLE    (WM_APP + 2)
@@ -71,12 +72,43 @@ GuiConsoleMoveWindow(PGUI_CONSOLE_DATA GuiData)
     }
 }
 
+static VOID
+MergePendingRegion(PGUI_CONSOLE_DATA GuiData,
+                   SMALL_RECT* Region)
+{
+    PSMALL_RECT Pending = &GuiData->PendingRegion;
+
+    if (ConioIsRectEmpty(Pending))
+    {
+        *Pending = *Region;
+    }
+    else
+    {
+        Pending->Left   = min(Pending->Left  , Region->Left  );
+        Pending->Top    = min(Pending->Top   , Region->Top   );
+        Pending->Right  = max(Pending->Right , Region->Right );
+        Pending->Bottom = max(Pending->Bottom, Region->Bottom);
+    }
+}
+
 static VOID
 DrawRegion(PGUI_CONSOLE_DATA GuiData,
            SMALL_RECT* Region)
 {
     RECT RegionRect;
 
+    if (GetType(GuiData->ActiveBuffer) == TEXTMODE_BUFFER)
+    {
+        GuiMarkTextModeRegion(GuiData, (PTEXTMODE_SCREEN_BUFFER)GuiData->ActiveBuffer, Region);
+
+        /* While a scroll is pending, the window contents do not match the buffer yet */
+        if (GuiData->PendingScroll != 0)
+        {
+            MergePendingRegion(GuiData, Region);
+            return;
+        }
+    }
+
     SmallRectToRect(GuiData, &RegionRect, Region);
     /* Do not erase the background: it speeds up redrawing and reduce flickering */
     InvalidateRect(GuiData->hWindow, &RegionRect, FALSE);
@@ -645,8 +677,7 @@ GuiWriteStream(IN OUT PFRONTEND This,
 {
     PGUI_CONSOLE_DATA GuiData = This->Context;
     PCONSOLE_SCREEN_BUFFER Buff;
-    SHORT CursorEndX, CursorEndY;
-    RECT ScrollRect;
+    SMALL_RECT CellRect;
 
     if (NULL == GuiData || NULL == GuiData->hWindow) return;
 
@@ -656,45 +687,53 @@ GuiWriteStream(IN OUT PFRONTEND This,
     Buff = GuiData->ActiveBuffer;
     if (GetType(Buff) != TEXTMODE_BUFFER) return;
 
+    /*
+     * Coalesce this update with the pending ones. The update timer sends
+     * them to the screen at most once per frame, scrolling the framebuffer
+     * and the window once for all the lines scrolled in the meantime.
+     */
     if (0 != ScrolledLines)
     {
-        ScrollRect.left = 0;
-        ScrollRect.top = 0;
-        ScrollRect.right = Buff->ViewSize.X * GuiData->CharWidth;
-        ScrollRect.bottom = Region->Top * GuiData->CharHeight;
-
-        ScrollWindowEx(GuiData->hWindow,
-                       0,
-                       -(int)(ScrolledLines * GuiData->CharHeight),
-                       &ScrollRect,
-                       NULL,
-                       NULL,
-                       NULL,
-                       SW_INVALIDATE);
-    }
+        PSMALL_RECT Pending = &GuiData->PendingRegion;
 
-    DrawRegion(GuiData, Region);
+        GuiData->PendingScroll += ScrolledLines;
 
-    if (CursorStartX < Region->Left || Region->Right < CursorStartX
-            || CursorStartY < Region->Top || Region->Bottom < CursorStartY)
-    {
-        InvalidateCell(GuiData, CursorStartX, CursorStartY);
+        /* The region still pending has moved up with the text */
+        if (!ConioIsRectEmpty(Pending))
+        {
+            Pending->Top    = max(Pending->Top - (SHORT)ScrolledLines, 0);
+            Pending->Bottom = Pending->Bottom - (SHORT)ScrolledLines;
+            if (Pending->Bottom < 0) ConioInitRect(Pending, 0, 0, -1, -1);
+        }
+
+        /* So did the old cursor position */
+        CursorStartY -= (SHORT)ScrolledLines;
     }
 
-    CursorEndX = Buff->CursorPosition.X;
-    CursorEndY = Buff->CursorPosition.Y;
-    if ((CursorEndX < Region->Left || Region->Right < CursorEndX
-            || CursorEndY < Region->Top || Region->Bottom < CursorEndY)
-            && (CursorEndX != CursorStartX || CursorEndY != CursorStartY))
+    GuiMarkTextModeRegion(GuiData, (PTEXTMODE_SCREEN_BUFFER)Buff, Region);
+    MergePendingRegion(GuiData, Region);
+
+    /* Redraw the chars at the old and new cursor positions */
+    if (CursorStartY >= 0)
     {
-        InvalidateCell(GuiData, CursorEndX, CursorEndY);
+        ConioInitRect(&CellRect, CursorStartY, CursorStartX, CursorStartY, CursorStartX);
+        GuiMarkTextModeRegion(GuiData, (PTEXTMODE_SCREEN_BUFFER)Buff, &CellRect);
+        MergePendingRegion(GuiData, &CellRect);
     }
+    ConioInitRect(&CellRect, Buff->CursorPosition.Y, Buff->CursorPosition.X,
+                             Buff->CursorPosition.Y, Buff->CursorPosition.X);
+    GuiMarkTextModeRegion(GuiData, (PTEXTMODE_SCREEN_BUFFER)Buff, &CellRect);
+    MergePendingRegion(GuiData, &CellRect);
 
     // HACK!!
-    // Set up the update timer (very short interval) - this is a "hack" for getting the OS to
+    // Set up the update timer - this is a "hack" for getting the OS to
     // repaint the window without having it just freeze up and stay on the screen permanently.
     Buff->CursorBlinkOn = TRUE;
-    SetTimer(GuiData->hWindow, CONGUI_UPDATE_TIMER, CONGUI_UPDATE_TIME, NULL);
+    if (!GuiData->UpdatePending)
+    {
+        GuiData->UpdatePending = TRUE;
+        SetTimer(GuiData->hWindow, CONGUI_UPDATE_TIMER, CONGUI_FRAME_TIME, NULL);
+    }
 }
 
 /* static */ VOID NTAPI
@@ -772,6 +811,9 @@ GuiSetActiveScreenBuffer(IN OUT PFRONTEND This)
 
     ActiveBuffer = GuiData->ActiveBuffer;
 
+    /* The framebuffer now has to show another screen buffer */
+    GuiResetFramebufferCache(GuiData);
+
     /* Change the current palette */
     if (ActiveBuffer->PaletteHandle == NULL)
         hPalette = GuiData->hSysPalette;
@@ -1019,6 +1061,9 @@ GuiSetPalette(IN OUT PFRONTEND This,
     /* Realize the (logical) palette */
     RealizePalette(GuiData->hMemDC);
 
+    /* The colors of everything composed so far are stale */
+    GuiResetFramebufferCache(GuiData);
+
     /* Save the original system palette handle */
     if (GuiData->hSysPalette == NULL) GuiData->hSysPalette = OldPalette;
 
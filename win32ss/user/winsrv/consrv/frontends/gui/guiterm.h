@@ -64,3 +64,12 @@ InitFonts(PGUI_CONSOLE_DATA GuiData,
           ULONG  FontWeight);
 VOID
 DeleteFonts(PGUI_CONSOLE_DATA GuiData);
+
+VOID
+GuiResetFramebufferCache(PGUI_CONSOLE_DATA GuiData);
+VOID
+GuiMarkTextModeRegion(PGUI_CONSOLE_DATA GuiData,
+                      PTEXTMODE_SCREEN_BUFFER Buffer,
+                      PSMALL_RECT Region);
+VOID
+GuiFlushPendingUpdate(PGUI_CONSOLE_DATA GuiData);
@@ -339,6 +339,223 @@ GuiPasteToTextModeBuffer(PTEXTMODE_SCREEN_BUFFER Buffer,
     GlobalUnlock(hData);
 }
 
+/*
+ * Framebuffer cache
+ *
+ * hMemDC holds the whole active screen buffer, composed in buffer coordinates.
+ * A WM_PAINT only needs to compose the cells that changed since they were last
+ * drawn there, and then copies the framebuffer to the screen. The changed cells
+ * are tracked as one dirty span per row. Rows are indexed by their physical
+ * position in the circular buffer (i.e. including VirtualY), so that scrolling
+ * the buffer does not move the marks; the framebuffer itself is scrolled with
+ * a blit instead of being redrawn.
+ */
+
+#define IS_SPAN_EMPTY(Span) ((Span)->Left > (Span)->Right)
+
+static VOID
+MarkDirtySpan(PGUI_CONSOLE_DATA GuiData,
+              ULONG Row,
+              SHORT Left,
+              SHORT Right)
+{
+    PGUI_DIRTY_SPAN Span = &GuiData->DirtyLines[Row];
+
+    if (IS_SPAN_EMPTY(Span))
+    {
+        Span->Left  = Left;
+        Span->Right = Right;
+    }
+    else
+    {
+        Span->Left  = min(Span->Left , Left );
+        Span->Right = max(Span->Right, Right);
+    }
+}
+
+static BOOLEAN
+IsFramebufferCacheValid(PGUI_CONSOLE_DATA GuiData,
+                        PTEXTMODE_SCREEN_BUFFER Buffer)
+{
+    return (GuiData->DirtyLines  != NULL   &&
+            GuiData->DirtyOwner  == Buffer &&
+            GuiData->DirtyBitmap == GuiData->hBitmap &&
+            GuiData->DirtyFont   == GuiData->Font[FONT_NORMAL] &&
+            GuiData->DirtyBufferSize.X == Buffer->ScreenBufferSize.X &&
+            GuiData->DirtyBufferSize.Y == Buffer->ScreenBufferSize.Y);
+}
+
+/*
+ * Sets up the cache for the given screen buffer, marking everything dirty if
+ * the framebuffer was composed for something else. Returns FALSE if the cache
+ * cannot be used, in which case the caller must redraw everything it shows.
+ */
+static BOOLEAN
+PrepareFramebufferCache(PGUI_CONSOLE_DATA GuiData,
+                        PTEXTMODE_SCREEN_BUFFER Buffer)
+{
+    SHORT Row;
+
+    if (IsFramebufferCacheValid(GuiData, Buffer)) return TRUE;
+
+    if (GuiData->DirtyLines == NULL ||
+        GuiData->DirtyBufferSize.Y != Buffer->ScreenBufferSize.Y)
+    {
+        if (GuiData->DirtyLines) ConsoleFreeHeap(GuiData->DirtyLines);
+        GuiData->DirtyLines = ConsoleAllocHeap(0, Buffer->ScreenBufferSize.Y * sizeof(GUI_DIRTY_SPAN));
+        if (GuiData->DirtyLines == NULL)
+        {
+            GuiData->DirtyOwner = NULL;
+            return FALSE;
+        }
+    }
+
+    for (Row = 0; Row < Buffer->ScreenBufferSize.Y; Row++)
+    {
+        GuiData->DirtyLines[Row].Left  = 0;
+        GuiData->DirtyLines[Row].Right = Buffer->ScreenBufferSize.X - 1;
+    }
+
+    GuiData->DirtyBufferSize = Buffer->ScreenBufferSize;
+    GuiData->DirtyOwner  = Buffer;
+    GuiData->DirtyBitmap = GuiData->hBitmap;
+    GuiData->DirtyFont   = GuiData->Font[FONT_NORMAL];
+    GuiData->CaretDrawn  = FALSE;
+
+    return TRUE;
+}
+
+VOID
+GuiResetFramebufferCache(PGUI_CONSOLE_DATA GuiData)
+{
+    /* Everything gets redrawn at the next paint */
+    GuiData->DirtyOwner = NULL;
+}
+
+VOID
+GuiMarkTextModeRegion(PGUI_CONSOLE_DATA GuiData,
+                      PTEXTMODE_SCREEN_BUFFER Buffer,
+                      PSMALL_RECT Region)
+{
+    SHORT Left, Right, Top, Bottom, Line;
+
+    /* If the cache is not set up, everything is redrawn anyway */
+    if (!IsFramebufferCacheValid(GuiData, Buffer)) return;
+
+    Left   = max(Region->Left, 0);
+    Top    = max(Region->Top , 0);
+    Right  = min(Region->Right , Buffer->ScreenBufferSize.X - 1);
+    Bottom = min(Region->Bottom, Buffer->ScreenBufferSize.Y - 1);
+    if (Left > Right) return;
+
+    for (Line = Top; Line <= Bottom; Line++)
+    {
+        MarkDirtySpan(GuiData,
+                      (Line + Buffer->VirtualY) % Buffer->ScreenBufferSize.Y,
+                      Left, Right);
+    }
+}
+
+/*
+ * Sends the updates coalesced by GuiWriteStream to the screen: scrolls the
+ * framebuffer and the window by the pending number of lines, and invalidates
+ * the pending region. Must be called from the window thread, with the console
+ * locked, before anything gets composed into the framebuffer.
+ */
+VOID
+GuiFlushPendingUpdate(PGUI_CONSOLE_DATA GuiData)
+{
+    PTEXTMODE_SCREEN_BUFFER Buffer;
+    SMALL_RECT Region = GuiData->PendingRegion;
+    UINT Scroll = GuiData->PendingScroll;
+    RECT RegionRect;
+    SHORT Line;
+
+    GuiData->PendingScroll = 0;
+    ConioInitRect(&GuiData->PendingRegion, 0, 0, -1, -1);
+    GuiData->UpdatePending = FALSE;
+
+    if (GetType(GuiData->ActiveBuffer) != TEXTMODE_BUFFER) return;
+    Buffer = (PTEXTMODE_SCREEN_BUFFER)GuiData->ActiveBuffer;
+
+    if (Scroll != 0)
+    {
+        if (IsFramebufferCacheValid(GuiData, Buffer))
+        {
+            if (Scroll < (UINT)Buffer->ScreenBufferSize.Y)
+            {
+                /* Move the composed rows up instead of redrawing them */
+                BitBlt(GuiData->hMemDC,
+                       0, 0,
+                       Buffer->ScreenBufferSize.X * GuiData->CharWidth,
+                       (Buffer->ScreenBufferSize.Y - Scroll) * GuiData->CharHeight,
+                       GuiData->hMemDC,
+                       0, Scroll * GuiData->CharHeight,
+                       SRCCOPY);
+
+                /* The rows scrolled in at the bottom are new */
+                for (Line = Buffer->ScreenBufferSize.Y - Scroll; Line < Buffer->ScreenBufferSize.Y; Line++)
+                {
+                    MarkDirtySpan(GuiData,
+                                  (Line + Buffer->VirtualY) % Buffer->ScreenBufferSize.Y,
+                                  0, Buffer->ScreenBufferSize.X - 1);
+                }
+
+                /* The caret moved up with the text */
+                if (GuiData->CaretDrawn)
+                {
+                    if ((UINT)GuiData->CaretCell.Y >= Scroll)
+                        GuiData->CaretCell.Y -= Scroll;
+                    else
+                        GuiData->CaretDrawn = FALSE;
+                }
+            }
+            else
+            {
+                GuiResetFramebufferCache(GuiData);
+            }
+        }
+
+        ScrollWindowEx(GuiData->hWindow,
+                       0,
+                       -(int)(Scroll * GuiData->CharHeight),
+                       NULL,
+                       NULL,
+                       NULL,
+                       NULL,
+                       SW_INVALIDATE);
+    }
+
+    if (!ConioIsRectEmpty(&Region))
+    {
+        SmallRectToRect(GuiData, &RegionRect, &Region);
+        /* Do not erase the background: it speeds up redrawing and reduce flickering */
+        InvalidateRect(GuiData->hWindow, &RegionRect, FALSE);
+    }
+}
+
+/* Maximum number of cells drawn by a single ExtTextOutW call */
+#define TEXT_RUN_MAX    256
+
+static VOID
+SelectTextAttribute(PGUI_CONSOLE_DATA GuiData,
+                    WORD Attribute,
+                    PBOOLEAN IsUnderline)
+{
+    PCONSRV_CONSOLE Console = GuiData->Console;
+
+    SetTextColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, TextAttribFromAttrib(Attribute)));
+    SetBkColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, BkgdAttribFromAttrib(Attribute)));
+
+    /* Change underline state if needed */
+    if (!!(Attribute & COMMON_LVB_UNDERSCORE) != *IsUnderline)
+    {
+        *IsUnderline = !!(Attribute & COMMON_LVB_UNDERSCORE);
+        /* Select the new font */
+        SelectObject(GuiData->hMemDC, GuiData->Font[*IsUnderline ? FONT_BOLD : FONT_NORMAL]);
+    }
+}
+
 VOID
 GuiPaintTextModeBuffer(PTEXTMODE_SCREEN_BUFFER Buffer,
                        PGUI_CONSOLE_DATA GuiData,
@@ -349,14 +566,17 @@ GuiPaintTextModeBuffer(PTEXTMODE_SCREEN_BUFFER Buffer,
     // ASSERT(Console == GuiData->Console);
 
     ULONG TopLine, BottomLine, LeftChar, RightChar;
-    ULONG Line, Char, Start;
+    ULONG Line, Char, Start, End;
     PCHAR_INFO From;
     PWCHAR To;
+    WCHAR LineBuffer[TEXT_RUN_MAX]; // Buffer containing a run of cells having the same attribute
+    INT CellWidths[TEXT_RUN_MAX];   // Fixed advance of every cell, so GDI doesn't have to compute it
+    PGUI_DIRTY_SPAN Span;
     WORD LastAttribute, Attribute;
     ULONG CursorX, CursorY, CursorHeight;
     HBRUSH CursorBrush, OldBrush;
-    HFONT OldFont, NewFont;
-    BOOLEAN IsUnderline;
+    HFONT OldFont;
+    BOOLEAN IsUnderline, UseCache;
 
     SetRectEmpty(rcFramebuffer);
 
@@ -377,65 +597,100 @@ GuiPaintTextModeBuffer(PTEXTMODE_SCREEN_BUFFER Buffer,
     if (RightChar  >= (ULONG)Buffer->ScreenBufferSize.X) RightChar  = Buffer->ScreenBufferSize.X - 1;
     if (BottomLine >= (ULONG)Buffer->ScreenBufferSize.Y) BottomLine = Buffer->ScreenBufferSize.Y - 1;
 
-    LastAttribute = ConioCoordToPointer(Buffer, LeftChar, TopLine)->Attributes;
+    UseCache = PrepareFramebufferCache(GuiData, Buffer);
 
-    SetTextColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, TextAttribFromAttrib(LastAttribute)));
-    SetBkColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, BkgdAttribFromAttrib(LastAttribute)));
+    /* The caret drawn by the previous paint must be erased */
+    if (UseCache && GuiData->CaretDrawn)
+    {
+        MarkDirtySpan(GuiData,
+                      (GuiData->CaretCell.Y + Buffer->VirtualY) % Buffer->ScreenBufferSize.Y,
+                      GuiData->CaretCell.X, GuiData->CaretCell.X);
+        GuiData->CaretDrawn = FALSE;
+    }
+
+    for (Char = 0; Char < TEXT_RUN_MAX; Char++)
+        CellWidths[Char] = GuiData->CharWidth;
+
+    LastAttribute = ConioCoordToPointer(Buffer, LeftChar, TopLine)->Attributes;
 
     /* We use the underscore flag as a underline flag */
     IsUnderline = !!(LastAttribute & COMMON_LVB_UNDERSCORE);
     /* Select the new font */
-    NewFont = GuiData->Font[IsUnderline ? FONT_BOLD : FONT_NORMAL];
-    OldFont = SelectObject(GuiData->hMemDC, NewFont);
+    OldFont = SelectObject(GuiData->hMemDC, GuiData->Font[IsUnderline ? FONT_BOLD : FONT_NORMAL]);
+    SelectTextAttribute(GuiData, LastAttribute, &IsUnderline);
 
     for (Line = TopLine; Line <= BottomLine; Line++)
     {
-        WCHAR LineBuffer[80];   // Buffer containing a part or all the line to be displayed
-        From  = ConioCoordToPointer(Buffer, LeftChar, Line);    // Get the first code of the line
         Start = LeftChar;
-        To    = LineBuffer;
+        End   = RightChar;
 
-        for (Char = LeftChar; Char <= RightChar; Char++)
+        if (UseCache)
+        {
+            /* Only redraw the cells of this row that changed */
+            Span = &GuiData->DirtyLines[(Line + Buffer->VirtualY) % Buffer->ScreenBufferSize.Y];
+            if (IS_SPAN_EMPTY(Span)) continue;
+
+            Start = max(Start, (ULONG)Span->Left );
+            End   = min(End  , (ULONG)Span->Right);
+            if (Start > End) continue;
+
+            /* What is left outside of the painted area stays dirty */
+            if ((ULONG)Span->Left >= LeftChar && (ULONG)Span->Right <= RightChar)
+            {
+                Span->Left  = 0;
+                Span->Right = -1;
+            }
+            else if ((ULONG)Span->Left >= LeftChar)
+            {
+                Span->Left = (SHORT)(RightChar + 1);
+            }
+            else if ((ULONG)Span->Right <= RightChar)
+            {
+                Span->Right = (SHORT)(LeftChar - 1);
+            }
+        }
+
+        From = ConioCoordToPointer(Buffer, Start, Line);    // Get the first code of the run
+        To   = LineBuffer;
+
+        for (Char = Start; Char <= End; Char++)
         {
             /*
              * We flush the buffer if the new attribute is different
              * from the current one, or if the buffer is full.
              */
-            if (From->Attributes != LastAttribute || (Char - Start == sizeof(LineBuffer) / sizeof(WCHAR)))
+            if (From->Attributes != LastAttribute || (Char - Start == TEXT_RUN_MAX))
             {
-                TextOutW(GuiData->hMemDC,
-                         Start * GuiData->CharWidth,
-                         Line  * GuiData->CharHeight,
-                         LineBuffer,
-                         Char - Start);
+                if (Char > Start)
+                {
+                    ExtTextOutW(GuiData->hMemDC,
+                                Start * GuiData->CharWidth,
+                                Line  * GuiData->CharHeight,
+                                0, NULL,
+                                LineBuffer,
+                                Char - Start,
+                                CellWidths);
+                }
                 Start = Char;
                 To    = LineBuffer;
                 Attribute = From->Attributes;
                 if (Attribute != LastAttribute)
                 {
                     LastAttribute = Attribute;
-                    SetTextColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, TextAttribFromAttrib(LastAttribute)));
-                    SetBkColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, BkgdAttribFromAttrib(LastAttribute)));
-
-                    /* Change underline state if needed */
-                    if (!!(LastAttribute & COMMON_LVB_UNDERSCORE) != IsUnderline)
-                    {
-                        IsUnderline = !!(LastAttribute & COMMON_LVB_UNDERSCORE);
-                        /* Select the new font */
-                        NewFont = GuiData->Font[IsUnderline ? FONT_BOLD : FONT_NORMAL];
-                        /* OldFont = */ SelectObject(GuiData->hMemDC, NewFont);
-                    }
+                    SelectTextAttribute(GuiData, LastAttribute, &IsUnderline);
                 }
             }
 
             *(To++) = (From++)->Char.UnicodeChar;
         }
 
-        TextOutW(GuiData->hMemDC,
-                 Start * GuiData->CharWidth,
-                 Line  * GuiData->CharHeight,
-                 LineBuffer,
-                 RightChar - Start + 1);
+        ExtTextOutW(GuiData->hMemDC,
+                    Start * GuiData->CharWidth,
+                    Line  * GuiData->CharHeight,
+                    0, NULL,
+                    LineBuffer,
+                    End - Start + 1,
+                    CellWidths);
     }
 
     /* Restore the old font */
@@ -470,6 +725,11 @@ GuiPaintTextModeBuffer(PTEXTMODE_SCREEN_BUFFER Buffer,
 
             SelectObject(GuiData->hMemDC, OldBrush);
             DeleteObject(CursorBrush);
+
+            /* Remember it, so that the next paint erases it */
+            GuiData->CaretCell.X = (SHORT)CursorX;
+            GuiData->CaretCell.Y = (SHORT)CursorY;
+            GuiData->CaretDrawn  = UseCache;
         }
     }
 